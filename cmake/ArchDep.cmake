@@ -75,6 +75,34 @@ int main(int argc, char** argv) {
             UNSET(HAVE_AVX2 CACHE)
         ENDIF()
     ENDIF()
+    SET(ASM_CODE "vprold \$7, %zmm0, %zmm0")
+    ASM_OP(HAVE_AVX512 "avx512")
+    IF(HAVE_AVX512)
+        CHECK_C_SOURCE_COMPILES(
+                "
+#include <stddef.h>
+#pragma GCC push_options
+#pragma GCC target(\"avx512f\")
+#ifndef __AVX512F__
+#define __AVX512F__
+#endif
+
+#include <immintrin.h>
+static void foo(const char* a) __attribute__((__target__(\"avx512f\")));
+static void foo(const char* a)
+{
+	__m512i str = _mm512_loadu_si512((const void *)a);
+	str = _mm512_rol_epi32(str, 7);
+	_mm512_storeu_si512((void *)(char *)a, str);
+}
+int main(int argc, char** argv) {
+	foo(argv[0]);
+}" HAVE_AVX512_C_COMPILER)
+        IF(NOT HAVE_AVX512_C_COMPILER)
+            MESSAGE(STATUS "Your compiler has broken AVX512 support")
+            UNSET(HAVE_AVX512 CACHE)
+        ENDIF()
+    ENDIF()
     SET(ASM_CODE "vpaddq %xmm0, %xmm0, %xmm0")
     ASM_OP(HAVE_AVX "avx")
     SET(ASM_CODE "pmuludq %xmm0, %xmm0")
@@ -28,6 +28,7 @@ function(CheckSystemFeatures)
     check_symbol_exists(setbit sys/param.h PARAM_H_HAS_BITSET)
     check_symbol_exists(getaddrinfo "sys/types.h;sys/socket.h;netdb.h" HAVE_GETADDRINFO)
     check_symbol_exists(sched_yield "sched.h" HAVE_SCHED_YIELD)
+    check_symbol_exists(sched_setaffinity "sched.h" HAVE_SCHED_SETAFFINITY)
     check_symbol_exists(nftw "sys/types.h;ftw.h" HAVE_NFTW)
     check_symbol_exists(memrchr "string.h" HAVE_MEMRCHR)
 
@@ -150,11 +151,23 @@ int main (void)
                                 return ((int*)(&recvmmsg))[argc];
                               }" HAVE_RECVMMSG)
 
+        check_c_source_compiles("#define _GNU_SOURCE
+                              #include <sys/socket.h>
+                              int main (int argc, char **argv) {
+                                return ((int*)(&sendmmsg))[argc];
+                              }" HAVE_SENDMMSG)
+
         check_c_source_compiles("#define _GNU_SOURCE
                               #include <fcntl.h>
                               int main (int argc, char **argv) {
                                 return ((int*)(&readahead))[argc];
                               }" HAVE_READAHEAD)
+
+        check_c_source_compiles("#define _GNU_SOURCE
+                              #include <sys/sendfile.h>
+                              int main (int argc, char **argv) {
+                                return ((int*)(&sendfile))[argc];
+                              }" HAVE_SENDFILE)
     endif ()
 
     # Propagate variables to parent scope
@@ -176,6 +189,7 @@ int main (void)
     set(PARAM_H_HAS_BITSET ${PARAM_H_HAS_BITSET} PARENT_SCOPE)
     set(HAVE_GETADDRINFO ${HAVE_GETADDRINFO} PARENT_SCOPE)
     set(HAVE_SCHED_YIELD ${HAVE_SCHED_YIELD} PARENT_SCOPE)
+    set(HAVE_SCHED_SETAFFINITY ${HAVE_SCHED_SETAFFINITY} PARENT_SCOPE)
     set(HAVE_NFTW ${HAVE_NFTW} PARENT_SCOPE)
     set(HAVE_MEMRCHR ${HAVE_MEMRCHR} PARENT_SCOPE)
     set(HAVE_PCRE_JIT ${HAVE_PCRE_JIT} PARENT_SCOPE)
@@ -199,7 +213,9 @@ int main (void)
     # Linux-specific features propagation
     if (CMAKE_SYSTEM_NAME STREQUAL "Linux")
         set(HAVE_RECVMMSG ${HAVE_RECVMMSG} PARENT_SCOPE)
+        set(HAVE_SENDMMSG ${HAVE_SENDMMSG} PARENT_SCOPE)
         set(HAVE_READAHEAD ${HAVE_READAHEAD} PARENT_SCOPE)
+        set(HAVE_SENDFILE ${HAVE_SENDFILE} PARENT_SCOPE)
     endif ()
 endfunction()
 
@@ -50,4 +50,17 @@ typedef int (ACISM_ACTION)(int strnum, int textpos, void *context);
 int acism_lookup(ac_trie_t const *psp, const char *text, size_t len,
            ACISM_ACTION *cb, void *context, int *statep, bool caseless);
 
+// The machine is a flat blob, so it can be serialized as-is and later
+//  mapped back without rebuilding the automaton.
+
+size_t acism_serialized_size(ac_trie_t const *psp);
+size_t acism_serialize(ac_trie_t const *psp, unsigned char *out);
+
+// Creates a trie backed by a serialized region (e.g. an mmapped cache file).
+// The region must start at the mapping base; its ownership is transferred to
+//  the trie and it is munmapped by acism_destroy. Returns NULL when the
+//  region does not pass sanity checks.
+
+ac_trie_t* acism_load(void *mem, size_t len);
+
 #endif//ACISM_H
@@ -171,6 +171,7 @@ struct rdns_tcp_channel {
 	/* Chained set of the planned writes */
 	struct rdns_tcp_output_chain *output_chain;
 	unsigned cur_output_chains;
+	unsigned idle_periods; /** periodic ticks spent with no requests in flight */
 
 	void *async_read; /** async read event */
 	void *async_write; /** async write event */
@@ -218,6 +219,8 @@ struct rdns_fake_reply {
 };
 
 
+KHASH_DECLARE(rdns_tcp_zones_hash, char *, unsigned int);
+
 struct rdns_resolver {
 	struct rdns_server *servers;
 	struct rdns_async_context *async; /** async callbacks */
@@ -225,6 +228,8 @@ struct rdns_resolver {
 	struct rdns_upstream_context *ups;
 	struct rdns_plugin *curve_plugin;
 	struct rdns_fake_reply *fake_elts;
+	/** zones with chronically truncated UDP replies, queried over TCP at once */
+	khash_t(rdns_tcp_zones_hash) *tcp_preferred_zones;
 
 #ifdef __GNUC__
 	__attribute__((format(printf, 4, 0)))
@@ -60,6 +60,8 @@
 
 __KHASH_IMPL(rdns_requests_hash, kh_inline, int, struct rdns_request *, true,
 			 kh_int_hash_func, kh_int_hash_equal);
+__KHASH_IMPL(rdns_tcp_zones_hash, kh_inline, char *, unsigned int, true,
+			 kh_str_hash_func, kh_str_hash_equal);
 
 static int
 rdns_send_request(struct rdns_request *req, int fd, bool new_req)
@@ -455,6 +457,87 @@ rdns_process_tcp_connect(int fd, struct rdns_io_channel *ioc)
 	}
 }
 
+/*
+ * Zones that chronically truncate UDP replies are queried over TCP from the
+ * beginning, saving the wasted UDP round trip per request. Scores are decayed
+ * on each periodic tick, so a zone falls back to UDP when truncation stops.
+ */
+static const unsigned int rdns_tcp_zone_labels = 3;
+static const unsigned int rdns_tcp_zone_threshold = 3;
+static const unsigned int rdns_tcp_zone_max_score = 16;
+/* Periodic ticks before an idle TCP connection is reset */
+static const unsigned int rdns_tcp_idle_periods = 4;
+
+static const char *
+rdns_tcp_zone_key(const char *name)
+{
+	const char *p = name + strlen(name);
+	unsigned int labels = 0;
+
+	/*
+	 * Use at most the trailing labels as the zone key: DNSBL style requests
+	 * have unique leading labels whilst sharing the zone suffix
+	 */
+	while (p > name) {
+		p--;
+
+		if (*p == '.') {
+			if (++labels == rdns_tcp_zone_labels) {
+				return p + 1;
+			}
+		}
+	}
+
+	return name;
+}
+
+static void
+rdns_tcp_zone_mark_truncated(struct rdns_resolver *resolver, const char *name)
+{
+	const char *zone = rdns_tcp_zone_key(name);
+	khiter_t k;
+	int pr;
+
+	k = kh_get(rdns_tcp_zones_hash, resolver->tcp_preferred_zones, (char *) zone);
+
+	if (k == kh_end(resolver->tcp_preferred_zones)) {
+		char *key = strdup(zone);
+
+		if (key == NULL) {
+			return;
+		}
+
+		k = kh_put(rdns_tcp_zones_hash, resolver->tcp_preferred_zones, key, &pr);
+
+		if (pr <= 0) {
+			free(key);
+
+			return;
+		}
+
+		kh_value(resolver->tcp_preferred_zones, k) = 1;
+	}
+	else if (kh_value(resolver->tcp_preferred_zones, k) < rdns_tcp_zone_max_score) {
+		kh_value(resolver->tcp_preferred_zones, k)++;
+	}
+}
+
+static bool
+rdns_tcp_zone_prefers_tcp(struct rdns_resolver *resolver, const char *name)
+{
+	khiter_t k;
+
+	if (kh_size(resolver->tcp_preferred_zones) == 0) {
+		return false;
+	}
+
+	k = kh_get(rdns_tcp_zones_hash, resolver->tcp_preferred_zones,
+			   (char *) rdns_tcp_zone_key(name));
+
+	return k != kh_end(resolver->tcp_preferred_zones) &&
+		   kh_value(resolver->tcp_preferred_zones, k) >= rdns_tcp_zone_threshold;
+}
+
 static bool
 rdns_reschedule_req_over_tcp(struct rdns_request *req, struct rdns_server *serv)
 {
@@ -574,6 +657,8 @@ rdns_process_udp_read(int fd, struct rdns_io_channel *ioc)
 				REF_RELEASE(req);
 			}
 			else {
+				rdns_tcp_zone_mark_truncated(resolver, req->requested_names[0].name);
+
 				if (req->io->srv->tcp_io_cnt > 0) {
 					rdns_debug("truncated UDP reply for %s; schedule over TCP", req->requested_names[0].name);
 					/* Reschedule via TCP */
@@ -781,14 +866,39 @@ rdns_process_periodic(void *arg)
 	{
 		for (int i = 0; i < serv->tcp_io_cnt; i++) {
 			if (IS_CHANNEL_CONNECTED(serv->tcp_io_channels[i])) {
-				/* Disconnect channels with no requests in flight */
+				/*
+				 * Disconnect channels with no requests in flight, but merely
+				 * after a holdoff: chronically truncated zones reuse the
+				 * connection instead of paying connect+close per query
+				 */
 				if (kh_size(serv->tcp_io_channels[i]->requests) == 0) {
-					rdns_debug("reset inactive TCP connection to %s", serv->name);
-					rdns_ioc_tcp_reset(serv->tcp_io_channels[i]);
+					if (++serv->tcp_io_channels[i]->tcp->idle_periods >=
+						rdns_tcp_idle_periods) {
+						rdns_debug("reset inactive TCP connection to %s", serv->name);
+						rdns_ioc_tcp_reset(serv->tcp_io_channels[i]);
+					}
+				}
+				else {
+					serv->tcp_io_channels[i]->tcp->idle_periods = 0;
 				}
 			}
 		}
 	}
+
+	/* Decay truncation scores, so zones can return to plain UDP */
+	khiter_t k;
+
+	for (k = kh_begin(resolver->tcp_preferred_zones);
+		 k != kh_end(resolver->tcp_preferred_zones); k++) {
+		if (!kh_exist(resolver->tcp_preferred_zones, k)) {
+			continue;
+		}
+
+		if ((kh_value(resolver->tcp_preferred_zones, k) /= 2) == 0) {
+			free(kh_key(resolver->tcp_preferred_zones, k));
+			kh_del(rdns_tcp_zones_hash, resolver->tcp_preferred_zones, k);
+		}
+	}
 }
 
 static void
@@ -1245,6 +1355,28 @@ rdns_make_request_full(
 													  req->io->sock, req);
 	}
 	else {
+		if (serv->tcp_io_cnt > 0 &&
+			rdns_tcp_zone_prefers_tcp(resolver, req->requested_names[0].name)) {
+			/*
+			 * The zone truncates UDP replies chronically, so do not waste
+			 * the UDP round trip and go over TCP at once. The extra reference
+			 * compensates the channel swap inside the reschedule function.
+			 */
+			REF_RETAIN(req->io);
+
+			if (rdns_reschedule_req_over_tcp(req, serv)) {
+				rdns_debug("direct TCP request for %s: zone is chronically truncated",
+						   req->requested_names[0].name);
+				req->io->uses++;
+				REF_RETAIN(req->resolver);
+
+				return req;
+			}
+
+			REF_RELEASE(req->io);
+			/* Fall back to the ordinary UDP exchange */
+		}
+
 		/* Now send request to server */
 		do {
 			r = rdns_send_request(req, req->io->sock, true);
@@ -1503,6 +1635,12 @@ rdns_resolver_free(struct rdns_resolver *resolver)
 			free(serv);
 		}
 	}
+
+	char *zone;
+	kh_foreach_key(resolver->tcp_preferred_zones, zone, {
+		free(zone);
+	});
+	kh_destroy(rdns_tcp_zones_hash, resolver->tcp_preferred_zones);
 	free(resolver->async);
 	free(resolver);
 }
@@ -1520,6 +1658,7 @@ rdns_resolver_new(int flags)
 	new_resolver->logger = rdns_logger_internal;
 	new_resolver->log_data = new_resolver;
 	new_resolver->flags = flags;
+	new_resolver->tcp_preferred_zones = kh_init(rdns_tcp_zones_hash);
 
 	return new_resolver;
 }
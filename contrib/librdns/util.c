@@ -730,6 +730,7 @@ rdns_ioc_tcp_reset (struct rdns_io_channel *ioc)
 
 		ioc->tcp->cur_output_chains = 0;
 		ioc->tcp->output_chain = NULL;
+		ioc->tcp->idle_periods = 0;
 
 		ioc->flags &= ~RDNS_CHANNEL_CONNECTED;
 	}
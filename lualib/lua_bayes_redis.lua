@@ -42,8 +42,83 @@ local function gen_classify_functor(redis_params, classify_script_id)
   end
 end
 
-local function gen_learn_functor(redis_params, learn_script_id)
+local function gen_learn_functor(redis_params, learn_script_id, ev_base, batch_interval, batch_script_id)
+  -- Worker-local queue of coalesced autolearn increments: prefix -> element
+  -- with accumulated learns count and per-token deltas
+  local learn_queue
+  local nqueued = 0
+
+  local function flush_learn_queue(cfg)
+    for key, elt in pairs(learn_queue) do
+      local ntokens = 0
+      local tokens = {}
+
+      for tok, cnt in pairs(elt.tokens) do
+        ntokens = ntokens + 1
+        tokens[ntokens] = { tok, cnt }
+      end
+
+      lua_util.debugm(N, cfg, 'flush %s coalesced learns (%s distinct tokens) for %s',
+          elt.learns, ntokens, key)
+      lua_redis.exec_redis_script(batch_script_id,
+          { ev_base = ev_base, cfg = cfg, is_write = true, key = key },
+          function(err, _)
+            if err then
+              logger.errx(cfg, 'cannot flush coalesced learns for %s: %s', key, err)
+            end
+          end,
+          { key, tostring(elt.is_spam), elt.symbol,
+            ucl.to_format({ learns = elt.learns, tokens = tokens }, 'msgpack') })
+    end
+
+    learn_queue = {}
+    nqueued = 0
+  end
+
+  if batch_interval then
+    learn_queue = {}
+    rspamd_config:add_periodic(ev_base, batch_interval, function(cfg, _)
+      if nqueued > 0 then
+        flush_learn_queue(cfg)
+      end
+      return batch_interval
+    end)
+  end
+
   return function(task, expanded_key, id, is_spam, symbol, is_unlearn, stat_tokens, callback, maybe_text_tokens)
+    if batch_interval and not is_unlearn and task:has_flag('learn_auto') then
+      -- Coalesce autolearn increments locally and acknowledge the task at
+      -- once; deltas for the same token are summed up and flushed in one
+      -- batched transaction per prefix, which cuts Redis write load a lot
+      -- during spam storms. Tokens themselves are not stored in this mode.
+      local parser = ucl.parser()
+      local res, parse_err = parser:parse_text(stat_tokens, 'msgpack')
+
+      if res then
+        local input_tokens = parser:get_object()
+        local elt = learn_queue[expanded_key]
+
+        if not elt then
+          elt = { is_spam = is_spam, symbol = symbol, learns = 0, tokens = {} }
+          learn_queue[expanded_key] = elt
+        end
+
+        elt.learns = elt.learns + 1
+        for _, tok in ipairs(input_tokens) do
+          elt.tokens[tok] = (elt.tokens[tok] or 0) + 1
+        end
+
+        nqueued = nqueued + 1
+        lua_util.debugm(N, task, 'queued autolearn for %s (%s learns pending)',
+            expanded_key, nqueued)
+        callback(task, true)
+        return
+      end
+
+      lua_util.debugm(N, task, 'cannot unpack tokens for coalescing: %s; '
+          .. 'fallback to the immediate learn', parse_err)
+    end
+
     local function learn_redis_cb(err, data)
       lua_util.debugm(N, task, 'learn redis cb: %s, %s', err, data)
       if err then
@@ -125,6 +200,16 @@ exports.lua_bayes_init_statfile = function(classifier_ucl, statfile_ucl, symbol,
   local stat_script_id = lua_redis.load_redis_script_from_file("bayes_stat.lua", redis_params)
   local max_users = classifier_ucl.max_users or 1000
 
+  -- Optional coalescing of autolearn writes (off unless an interval is set)
+  local batch_interval = tonumber(classifier_ucl.learn_batch_interval or 0)
+  local batch_script_id
+
+  if batch_interval > 0 and ev_base then
+    batch_script_id = lua_redis.load_redis_script_from_file("bayes_learn_batch.lua", redis_params)
+  else
+    batch_interval = nil
+  end
+
   local current_data = {
     users = 0,
     revision = 0,
@@ -172,7 +257,8 @@ exports.lua_bayes_init_statfile = function(classifier_ucl, statfile_ucl, symbol,
     end)
   end
 
-  return gen_classify_functor(redis_params, classify_script_id), gen_learn_functor(redis_params, learn_script_id)
+  return gen_classify_functor(redis_params, classify_script_id),
+      gen_learn_functor(redis_params, learn_script_id, ev_base, batch_interval, batch_script_id)
 end
 
 local function gen_cache_check_functor(redis_params, check_script_id, conf)
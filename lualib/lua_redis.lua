@@ -245,6 +245,10 @@ local function redis_query_sentinel(ev_base, params, initialised)
       if read_upstreams then
         logger.infox(rspamd_config, 'sentinel %s: replace read servers with new list: %s',
             host:to_string(true), read_servers_str)
+        if params.read_servers then
+          -- Keep errors and latency of the servers retained across the switch
+          read_upstreams:carry_state(params.read_servers)
+        end
         params.read_servers = read_upstreams
         params.read_servers_str = read_servers_str
       end
@@ -259,6 +263,9 @@ local function redis_query_sentinel(ev_base, params, initialised)
       if write_upstreams then
         logger.infox(rspamd_config, 'sentinel %s: replace write servers with new list: %s',
             host:to_string(true), write_servers_str)
+        if params.write_servers then
+          write_upstreams:carry_state(params.write_servers)
+        end
         params.write_servers = write_upstreams
         params.write_servers_str = write_servers_str
 
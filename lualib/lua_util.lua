@@ -151,6 +151,36 @@ exports.str_endswith = function(s, suffix)
   return s:find(suffix, -suffix:len(), true) ~= nil
 end
 
+-- Transparently prefer the C implementations when the running rspamd
+-- provides them: the lpeg/string versions above are kept as fallbacks for
+-- older binaries and for lpeg separators in str_split
+if rspamd_util.str_trim then
+  exports.str_trim = rspamd_util.str_trim
+  exports.rspamd_str_trim = rspamd_util.str_trim
+end
+
+if rspamd_util.str_split then
+  local c_str_split = rspamd_util.str_split
+  local lpeg_str_split = rspamd_str_split
+  local function str_split(s, sep)
+    if sep == nil or type(sep) == 'string' then
+      return c_str_split(s, sep)
+    end
+    -- Separator is an lpeg object
+    return lpeg_str_split(s, sep)
+  end
+  exports.str_split = str_split
+  exports.rspamd_str_split = str_split
+end
+
+if rspamd_util.str_startswith then
+  exports.str_startswith = rspamd_util.str_startswith
+end
+
+if rspamd_util.str_endswith then
+  exports.str_endswith = rspamd_util.str_endswith
+end
+
 --[[[
 -- @function lua_util.round(number, decimalPlaces)
 -- Round number to fixed number of decimal points
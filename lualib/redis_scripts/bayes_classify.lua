@@ -7,8 +7,10 @@ local prefix = KEYS[1]
 local output_spam = {}
 local output_ham = {}
 
-local learned_ham = tonumber(redis.call('HGET', prefix, 'learns_ham')) or 0
-local learned_spam = tonumber(redis.call('HGET', prefix, 'learns_spam')) or 0
+-- Fetch both learn counters with a single command dispatch
+local learns = redis.call('HMGET', prefix, 'learns_ham', 'learns_spam')
+local learned_ham = tonumber(learns[1]) or 0
+local learned_spam = tonumber(learns[2]) or 0
 
 -- Output is a set of pairs (token_index, token_count), tokens that are not
 -- found are not filled.
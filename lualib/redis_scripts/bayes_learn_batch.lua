@@ -0,0 +1,23 @@
+-- Lua script to apply a batch of coalesced bayes learns
+-- This script accepts the following parameters:
+-- key1 - prefix for bayes tokens (e.g. for per-user classification)
+-- key2 - boolean is_spam
+-- key3 - string symbol
+-- key4 - table encoded in messagepack with `learns` count and `tokens`
+--        array of (token, count) pairs accumulated since the last flush
+
+local prefix = KEYS[1]
+local is_spam = KEYS[2] == 'true' and true or false
+local symbol = KEYS[3]
+local input = cmsgpack.unpack(KEYS[4])
+
+local hash_key = is_spam and 'S' or 'H'
+local learned_key = is_spam and 'learns_spam' or 'learns_ham'
+
+redis.call('SADD', symbol .. '_keys', prefix)
+redis.call('HSET', prefix, 'version', '2') -- new schema
+redis.call('HINCRBY', prefix, learned_key, input.learns)
+
+for _, pair in ipairs(input.tokens) do
+  redis.call('HINCRBY', pair[1], hash_key, pair[2])
+end
@@ -0,0 +1,201 @@
+--[[
+Copyright (c) 2026, Vsevolod Stakhov <vsevolod@rspamd.com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+]]--
+
+local rspamd_logger = require "rspamd_logger"
+local rspamd_util = require "rspamd_util"
+local ucl = require "ucl"
+local lua_util = require "lua_util"
+local argparse = require "argparse"
+
+local parser = argparse()
+    :name "rspamadm bench"
+    :description "Replay a mail corpus through a running rspamd and report latency"
+    :help_description_margin(32)
+
+parser:argument "corpus"
+      :description("Directory with messages to replay (e.g. a maildir cur/ folder)")
+      :args("+")
+parser:option "-c --connect"
+      :description("Connect to specific host")
+      :argname("<host>")
+      :default('localhost:11333')
+parser:option "-n --conns"
+      :description("Number of parallel connections")
+      :argname("<N>")
+      :convert(tonumber)
+      :default(10)
+parser:option "-t --timeout"
+      :description("Timeout for client connections")
+      :argname("<sec>")
+      :convert(tonumber)
+      :default(60)
+parser:option "-r --rspamc"
+      :description("Use specific rspamc path")
+      :argname("<path>")
+      :default('rspamc')
+parser:flag "-p --profile"
+      :description("Collect and aggregate per-symbol timings from the scan trace")
+parser:option "--top"
+      :description("Number of slowest symbols to report in profile mode")
+      :argname("<N>")
+      :convert(tonumber)
+      :default(20)
+
+local function scan_corpus(opts, path)
+  local profile_flag = opts.profile and '--profile' or ''
+  local rspamc_command = string.format("%s --connect %s -j --compact -n %s -t %.3f %s %s",
+      opts.rspamc, opts.connect, opts.conns, opts.timeout, profile_flag, path)
+  local result = assert(io.popen(rspamc_command))
+  result = result:read("*all")
+  return result
+end
+
+local function parse_results(raw)
+  local parsed = {}
+  local lines = lua_util.rspamd_str_split(raw, "\n")
+
+  for _, line in ipairs(lines) do
+    if line ~= "" then
+      local ucl_parser = ucl.parser()
+      local is_good, err = ucl_parser:parse_string(line)
+
+      if not is_good then
+        rspamd_logger.errx("parser error: %1", err)
+      else
+        table.insert(parsed, ucl_parser:get_object())
+      end
+    end
+  end
+
+  return parsed
+end
+
+local function percentile(sorted, p)
+  local idx = math.max(1, math.ceil(#sorted * p))
+  return sorted[math.min(idx, #sorted)]
+end
+
+local function print_latency(times)
+  table.sort(times)
+
+  local sum = 0
+  for _, t in ipairs(times) do
+    sum = sum + t
+  end
+
+  print(string.format("Latency (seconds): mean %.4f, min %.4f, max %.4f",
+      sum / #times, times[1], times[#times]))
+  print(string.format("Percentiles: p50 %.4f, p90 %.4f, p99 %.4f, p999 %.4f",
+      percentile(times, 0.50), percentile(times, 0.90),
+      percentile(times, 0.99), percentile(times, 0.999)))
+end
+
+local function print_actions(results)
+  local actions = {}
+
+  for _, res in ipairs(results) do
+    if res.action then
+      actions[res.action] = (actions[res.action] or 0) + 1
+    end
+  end
+
+  print("Actions:")
+  for act, cnt in pairs(actions) do
+    print(string.format("\t%s: %d (%.1f%%)", act, cnt, cnt * 100.0 / #results))
+  end
+end
+
+local function print_profile(results, top)
+  -- Aggregate per-symbol wall clock from the profile section of replies
+  local agg = {}
+
+  for _, res in ipairs(results) do
+    for sym, t in pairs(res.profile or {}) do
+      local cur = agg[sym]
+      if cur then
+        cur.total = cur.total + t
+        cur.count = cur.count + 1
+      else
+        agg[sym] = { total = t, count = 1 }
+      end
+    end
+  end
+
+  local sorted_syms = {}
+  for sym, st in pairs(agg) do
+    table.insert(sorted_syms, { sym = sym, total = st.total, count = st.count })
+  end
+  table.sort(sorted_syms, function(a, b)
+    return a.total > b.total
+  end)
+
+  print(string.format("Top %d symbols by total time:", top))
+  for i = 1, math.min(top, #sorted_syms) do
+    local s = sorted_syms[i]
+    print(string.format("\t%s: total %.4f, mean %.6f, hits %d",
+        s.sym, s.total, s.total / s.count, s.count))
+  end
+end
+
+local function handler(args)
+  local opts = parser:parse(args)
+
+  local results = {}
+  local start_time = rspamd_util.get_time()
+
+  for _, path in ipairs(opts.corpus) do
+    rspamd_logger.messagex("Scanning corpus %s...", path)
+    local raw = scan_corpus(opts, path)
+
+    for _, res in ipairs(parse_results(raw)) do
+      table.insert(results, res)
+    end
+  end
+
+  local elapsed = rspamd_util.get_time() - start_time
+
+  if #results == 0 then
+    rspamd_logger.errx("no results; is rspamd running on %s?", opts.connect)
+    os.exit(1)
+  end
+
+  local times = {}
+  for _, res in ipairs(results) do
+    if res.scan_time then
+      table.insert(times, tonumber(res.scan_time))
+    end
+  end
+
+  print(string.format("Scanned %d messages in %.2f seconds: %.1f msg/sec with %d connections",
+      #results, elapsed, #results / elapsed, opts.conns))
+
+  if #times > 0 then
+    print_latency(times)
+  end
+
+  print_actions(results)
+
+  if opts.profile then
+    print_profile(results, opts.top)
+  end
+end
+
+return {
+  name = 'bench',
+  aliases = { 'benchmark' },
+  handler = handler,
+  description = parser._description
+}
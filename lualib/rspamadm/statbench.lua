@@ -0,0 +1,206 @@
+--[[
+Copyright (c) 2026, Vsevolod Stakhov <vsevolod@rspamd.com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+]]--
+
+local rspamd_task = require "rspamd_task"
+local rspamd_util = require "rspamd_util"
+local rspamd_logger = require "rspamd_logger"
+local argparse = require "argparse"
+
+local parser = argparse()
+    :name "rspamadm statbench"
+    :description "Replay a message corpus through the statistics pipeline and report throughput"
+    :help_description_margin(30)
+
+parser:argument "corpus"
+      :description("mbox file or directory with messages")
+      :args "+"
+parser:option "-c --config"
+      :description("Path to config file")
+      :argname("<cfg>")
+      :default(rspamd_paths["CONFDIR"] .. "/" .. "rspamd.conf")
+parser:option "-n --number"
+      :description("Limit the number of messages to process")
+      :argname("<N>")
+      :convert(tonumber)
+parser:flag "-v --verbose"
+      :description("Print per-message timings")
+
+local function load_config(opts)
+  local _r, err = rspamd_config:load_ucl(opts.config)
+
+  if not _r then
+    rspamd_logger.errx('cannot parse %s: %s', opts.config, err)
+    os.exit(1)
+  end
+
+  _r, err = rspamd_config:parse_rcl({ 'logging', 'worker' })
+  if not _r then
+    rspamd_logger.errx('cannot process %s: %s', opts.config, err)
+    os.exit(1)
+  end
+end
+
+-- Split an mbox file into individual messages on `From ` separators
+local function read_mbox(fname)
+  local fd = io.open(fname, 'r')
+
+  if not fd then
+    rspamd_logger.errx('cannot open %s', fname)
+    return {}
+  end
+
+  local messages = {}
+  local cur
+
+  for line in fd:lines() do
+    if line:sub(1, 5) == 'From ' then
+      if cur then
+        messages[#messages + 1] = table.concat(cur, '\n')
+      end
+      cur = {}
+    elseif cur then
+      cur[#cur + 1] = line
+    end
+  end
+
+  if cur and #cur > 0 then
+    messages[#messages + 1] = table.concat(cur, '\n')
+  end
+
+  fd:close()
+
+  return messages
+end
+
+local function read_corpus(elts)
+  local messages = {}
+
+  for _, elt in ipairs(elts) do
+    local err, st = rspamd_util.stat(elt)
+
+    if err then
+      rspamd_logger.errx('cannot stat %s: %s', elt, err)
+    elseif st.type == 'directory' then
+      for _, fname in ipairs(rspamd_util.glob(elt .. '/*')) do
+        local fd = io.open(fname, 'r')
+        if fd then
+          messages[#messages + 1] = fd:read('*a')
+          fd:close()
+        end
+      end
+    else
+      for _, msg in ipairs(read_mbox(elt)) do
+        messages[#messages + 1] = msg
+      end
+    end
+  end
+
+  return messages
+end
+
+local function percentile(sorted, p)
+  if #sorted == 0 then
+    return 0
+  end
+
+  local idx = math.max(1, math.min(#sorted, math.ceil(#sorted * p)))
+
+  return sorted[idx]
+end
+
+local function handler(args)
+  local opts = parser:parse(args)
+
+  load_config(opts)
+
+  local messages = read_corpus(opts.corpus)
+
+  if opts.number and #messages > opts.number then
+    for i = #messages, opts.number + 1, -1 do
+      messages[i] = nil
+    end
+  end
+
+  if #messages == 0 then
+    parser:error('no messages found in the corpus')
+  end
+
+  local total_tokens = 0
+  local total_bytes = 0
+  local parse_time = 0.0
+  local tokenize_times = {}
+  local nfailed = 0
+
+  local t_start = rspamd_util.get_ticks()
+
+  for i, msg in ipairs(messages) do
+    local task = rspamd_task.create(rspamd_config, rspamadm_ev_base)
+    task:set_session(rspamadm_session)
+    task:set_resolver(rspamadm_dns_resolver)
+
+    local t0 = rspamd_util.get_ticks()
+
+    if task:load_from_string(msg) and task:process_message() then
+      local t1 = rspamd_util.get_ticks()
+      local tokens = task:get_stat_tokens()
+      local t2 = rspamd_util.get_ticks()
+
+      parse_time = parse_time + (t1 - t0)
+      tokenize_times[#tokenize_times + 1] = t2 - t1
+      total_tokens = total_tokens + (tokens and #tokens or 0)
+      total_bytes = total_bytes + #msg
+
+      if opts.verbose then
+        rspamd_logger.messagex('message %s: %s tokens, parse %.3fms, tokenize %.3fms',
+            i, tokens and #tokens or 0, (t1 - t0) * 1000.0, (t2 - t1) * 1000.0)
+      end
+    else
+      nfailed = nfailed + 1
+    end
+
+    task:destroy()
+  end
+
+  local elapsed = rspamd_util.get_ticks() - t_start
+  local nprocessed = #messages - nfailed
+
+  table.sort(tokenize_times)
+
+  local tokenize_time = 0.0
+  for _, t in ipairs(tokenize_times) do
+    tokenize_time = tokenize_time + t
+  end
+
+  rspamd_logger.messagex('processed %s messages (%s failed) in %.2fs: %.1f msg/sec',
+      nprocessed, nfailed, elapsed, nprocessed / elapsed)
+  rspamd_logger.messagex('parsing: %.2fs total; tokenization: %.2fs total, %s tokens (%.0f tokens/sec)',
+      parse_time, tokenize_time, total_tokens,
+      tokenize_time > 0 and (total_tokens / tokenize_time) or 0)
+  rspamd_logger.messagex('corpus size: %s bytes (%.1f MB/sec through the pipeline)',
+      total_bytes, total_bytes / elapsed / 1024.0 / 1024.0)
+  rspamd_logger.messagex('tokenize latency: p50 %.3fms, p90 %.3fms, p99 %.3fms, max %.3fms',
+      percentile(tokenize_times, 0.5) * 1000.0,
+      percentile(tokenize_times, 0.9) * 1000.0,
+      percentile(tokenize_times, 0.99) * 1000.0,
+      (tokenize_times[#tokenize_times] or 0) * 1000.0)
+end
+
+return {
+  name = 'statbench',
+  aliases = { 'stat_bench' },
+  handler = handler,
+  description = parser._description
+}
@@ -69,6 +69,9 @@ static int flag = 0;
 static const char *fuzzy_symbol = nullptr;
 static const char *dictionary = nullptr;
 static int max_requests = 8;
+/* Sliding window of the requests that are in flight */
+static int inflight_requests = 0;
+static struct ev_loop *inflight_event_loop = nullptr;
 static double timeout = 10.0;
 static gboolean pass_all;
 static gboolean tty = FALSE;
@@ -1931,6 +1934,15 @@ rspamc_client_cb(struct rspamd_client_connection *conn,
 	rspamd_client_destroy(conn);
 	delete cbdata;
 
+	if (inflight_requests > 0) {
+		inflight_requests--;
+
+		if (inflight_event_loop != nullptr && inflight_requests < max_requests) {
+			/* A slot in the requests window is free, resume submission */
+			ev_break(inflight_event_loop, EVBREAK_ONE);
+		}
+	}
+
 	if (err) {
 		retcode = EXIT_FAILURE;
 	}
@@ -2059,7 +2071,6 @@ static void
 rspamc_process_dir(struct ev_loop *ev_base, const struct rspamc_command &cmd,
 				   const std::string &name, GQueue *attrs)
 {
-	static auto cur_req = 0;
 	auto *d = opendir(name.c_str());
 
 	if (d != nullptr) {
@@ -2146,12 +2157,15 @@ rspamc_process_dir(struct ev_loop *ev_base, const struct rspamc_command &cmd,
 				}
 
 				rspamc_process_input(ev_base, cmd, in, fpath, attrs);
-				cur_req++;
+				inflight_requests++;
 				fclose(in);
 
-				if (cur_req >= max_requests) {
-					cur_req = 0;
-					/* Wait for completion */
+				if (inflight_requests >= max_requests) {
+					/*
+					 * Wait for a single completion and refill the window
+					 * instead of draining all requests
+					 */
+					inflight_event_loop = ev_base;
 					ev_loop(ev_base, 0);
 				}
 			}
@@ -2163,6 +2177,8 @@ rspamc_process_dir(struct ev_loop *ev_base, const struct rspamc_command &cmd,
 	}
 
 	closedir(d);
+	/* Drain the requests that are still in flight */
+	inflight_event_loop = nullptr;
 	ev_loop(ev_base, 0);
 }
 
@@ -2304,8 +2320,6 @@ int main(int argc, char **argv, char **env)
 		}
 	}
 	else {
-		auto cur_req = 0;
-
 		/* Process files from arguments and `files_list` */
 		std::vector<std::string> files;
 		files.reserve(argc - start_argc);
@@ -2346,9 +2360,7 @@ int main(int argc, char **argv, char **env)
 					exit(EXIT_FAILURE);
 				}
 				if (S_ISDIR(st.st_mode)) {
-					/* Directories are processed with a separate limit */
 					rspamc_process_dir(event_loop, cmd, file.c_str(), kwattrs);
-					cur_req = 0;
 				}
 				else {
 					in = fopen(file.c_str(), "r");
@@ -2357,12 +2369,12 @@ int main(int argc, char **argv, char **env)
 						exit(EXIT_FAILURE);
 					}
 					rspamc_process_input(event_loop, cmd, in, file.c_str(), kwattrs);
-					cur_req++;
+					inflight_requests++;
 					fclose(in);
 				}
-				if (cur_req >= max_requests) {
-					cur_req = 0;
-					/* Wait for completion */
+				if (inflight_requests >= max_requests) {
+					/* Wait for a single completion and refill the window */
+					inflight_event_loop = event_loop;
 					ev_loop(event_loop, 0);
 				}
 			}
@@ -2373,6 +2385,8 @@ int main(int argc, char **argv, char **env)
 		}
 	}
 
+	/* Drain the requests that are still in flight */
+	inflight_event_loop = nullptr;
 	ev_loop(event_loop, 0);
 
 	g_queue_free_full(kwattrs, rspamc_kwattr_free);
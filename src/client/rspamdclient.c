@@ -56,6 +56,9 @@ struct rspamd_client_request {
 	struct rspamd_client_connection *conn;
 	struct rspamd_http_message *msg;
 	GString *input;
+	/* Mapped zstd dictionary, needed to decompress the reply as well */
+	void *comp_dictionary;
+	gsize comp_dictionary_len;
 	rspamd_client_callback cb;
 	gpointer ud;
 };
@@ -77,6 +80,9 @@ rspamd_client_request_free(struct rspamd_client_request *req)
 		if (req->input) {
 			g_string_free(req->input, TRUE);
 		}
+		if (req->comp_dictionary) {
+			munmap(req->comp_dictionary, req->comp_dictionary_len);
+		}
 
 		g_free(req);
 	}
@@ -160,6 +166,12 @@ rspamd_client_finish_handler(struct rspamd_http_connection *conn,
 				zstream = ZSTD_createDStream();
 				ZSTD_initDStream(zstream);
 
+				if (req->comp_dictionary) {
+					/* The server compresses replies with the same dictionary */
+					ZSTD_DCtx_loadDictionary(zstream, req->comp_dictionary,
+											 req->comp_dictionary_len);
+				}
+
 				zin.pos = 0;
 				zin.src = msg->body_buf.begin;
 				zin.size = msg->body_buf.len;
@@ -398,7 +410,9 @@ rspamd_client_command(struct rspamd_client_connection *conn,
 					return FALSE;
 				}
 
-				dict_id = -1;
+				dict_id = rspamd_zstd_dictionary_id(dict, dict_len);
+				req->comp_dictionary = dict;
+				req->comp_dictionary_len = dict_len;
 			}
 
 			body = rspamd_fstring_sized_new(ZSTD_compressBound(input->len));
@@ -408,8 +422,6 @@ rspamd_client_command(struct rspamd_client_connection *conn,
 												dict, dict_len,
 												1);
 
-			munmap(dict, dict_len);
-
 			if (ZSTD_isError(body->len)) {
 				g_set_error(err, RCLIENT_ERROR, ferror(in), "compression error");
 				g_free(req);
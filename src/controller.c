@@ -146,6 +146,14 @@ struct rspamd_controller_worker_ctx {
 	/* Cached versions of the passwords */
 	rspamd_ftok_t cached_password;
 	rspamd_ftok_t cached_enable_password;
+	/*
+	 * Digests of recently rejected password attempts: a client polling with
+	 * stale credentials would otherwise run the full PBKDF on every request,
+	 * stalling the event loop for all concurrent connections
+	 */
+	unsigned char failed_auth_digests[8][rspamd_cryptobox_HASHBYTES];
+	unsigned int failed_auth_cnt;
+	unsigned int failed_auth_pos;
 	/* HTTP server */
 	struct rspamd_http_context *http_ctx;
 	struct rspamd_http_connection_router *http;
@@ -279,8 +287,10 @@ rspamd_check_encrypted_password(struct rspamd_controller_worker_ctx *ctx,
 	gsize salt_len = 0, key_len = 0;
 	gboolean ret = TRUE;
 	unsigned char *local_key;
+	unsigned char attempt_digest[rspamd_cryptobox_HASHBYTES];
 	rspamd_ftok_t *cache;
 	gpointer m;
+	unsigned int i;
 
 	/* First of all check cached versions to save resources */
 	if (is_enable && ctx->cached_enable_password.len != 0) {
@@ -357,6 +367,28 @@ check_uncached:
 			return FALSE;
 		}
 
+		/*
+		 * The digest is keyed by the stored hash string, so changing the
+		 * configured password invalidates remembered rejections
+		 */
+		rspamd_cryptobox_hash(attempt_digest,
+							  (const unsigned char *) password->begin,
+							  password->len,
+							  (const unsigned char *) check, strlen(check));
+
+		for (i = 0; i < ctx->failed_auth_cnt; i++) {
+			if (rspamd_constant_memcmp(ctx->failed_auth_digests[i],
+									   attempt_digest,
+									   rspamd_cryptobox_HASHBYTES)) {
+				msg_info_ctx("incorrect or absent password has been specified "
+							 "(a cached rejected attempt)");
+				g_free(salt_decoded);
+				g_free(key_decoded);
+
+				return FALSE;
+			}
+		}
+
 		local_key = g_alloca(pbkdf->key_len);
 		rspamd_cryptobox_pbkdf(password->begin, password->len,
 							   salt_decoded, salt_len,
@@ -366,6 +398,16 @@ check_uncached:
 		if (!rspamd_constant_memcmp(key_decoded, local_key, pbkdf->key_len)) {
 			msg_info_ctx("incorrect or absent password has been specified");
 			ret = FALSE;
+
+			/* Remember the rejection to skip the PBKDF on repeats */
+			memcpy(ctx->failed_auth_digests[ctx->failed_auth_pos],
+				   attempt_digest, rspamd_cryptobox_HASHBYTES);
+			ctx->failed_auth_pos = (ctx->failed_auth_pos + 1) %
+								   G_N_ELEMENTS(ctx->failed_auth_digests);
+
+			if (ctx->failed_auth_cnt < G_N_ELEMENTS(ctx->failed_auth_digests)) {
+				ctx->failed_auth_cnt++;
+			}
 		}
 
 		g_free(salt_decoded);
@@ -1450,10 +1492,28 @@ rspamd_controller_handle_legacy_history(
 
 	top = ucl_object_typed_new(UCL_ARRAY);
 
-	/* Set lock on history */
+	/*
+	 * Copy rows under a seqlock: a row with an odd version is being written
+	 * by some scanner, and a version change during the copy means a torn
+	 * read; such rows are merely skipped, so readers never perturb writers
+	 */
 	copied_rows = g_malloc(sizeof(*copied_rows) * ctx->srv->history->nrows);
-	memcpy(copied_rows, ctx->srv->history->rows,
-		   sizeof(*copied_rows) * ctx->srv->history->nrows);
+
+	for (i = 0; i < ctx->srv->history->nrows; i++) {
+		struct roll_history_row *src = &ctx->srv->history->rows[i];
+		unsigned int v = g_atomic_int_get(&src->version);
+
+		if (v & 1) {
+			copied_rows[i].completed = FALSE;
+			continue;
+		}
+
+		memcpy(&copied_rows[i], src, sizeof(*src));
+
+		if (g_atomic_int_get(&src->version) != v) {
+			copied_rows[i].completed = FALSE;
+		}
+	}
 
 	/* Go through all rows */
 	row_num = ctx->srv->history->cur_row;
@@ -1529,6 +1589,11 @@ rspamd_controller_handle_legacy_history(
 								  ucl_object_fromdouble(row->scan_time),
 								  "scan_time", 0, false);
 
+			if (row->timings[0] != '\0') {
+				ucl_object_insert_key(obj, ucl_object_fromstring(row->timings),
+									  "timings", 0, false);
+			}
+
 			if (row->user[0] != '\0') {
 				ucl_object_insert_key(obj, ucl_object_fromstring(row->user),
 									  "user", 0, false);
@@ -2704,6 +2769,26 @@ rspamd_controller_stat_cleanup_task(void *ud)
  * headers: Password
  * reply: json data
  */
+#ifdef WITH_MEM_PROFILE
+static void
+rspamd_controller_mem_profile_ucl(const struct rspamd_mempool_tag_stat *st,
+								  gpointer ud)
+{
+	ucl_object_t *sub = (ucl_object_t *) ud, *elt;
+
+	elt = ucl_object_typed_new(UCL_OBJECT);
+	ucl_object_insert_key(elt, ucl_object_fromint(st->live_bytes),
+						  "live_bytes", 0, false);
+	ucl_object_insert_key(elt, ucl_object_fromint(st->total_bytes),
+						  "total_bytes", 0, false);
+	ucl_object_insert_key(elt, ucl_object_fromint(st->live_pools),
+						  "live_pools", 0, false);
+	ucl_object_insert_key(elt, ucl_object_fromint(st->total_pools),
+						  "total_pools", 0, false);
+	ucl_object_insert_key(sub, elt, st->tagname, 0, true);
+}
+#endif
+
 static int
 rspamd_controller_handle_stat_common(
 	struct rspamd_http_connection_entry *conn_ent,
@@ -2817,6 +2902,12 @@ rspamd_controller_handle_stat_common(
 	ucl_object_insert_key(top,
 						  ucl_object_fromint(mem_st.fragmented_size), "fragmented", 0, false);
 
+#ifdef WITH_MEM_PROFILE
+	sub = ucl_object_typed_new(UCL_OBJECT);
+	rspamd_mempool_tag_stat_foreach(rspamd_controller_mem_profile_ucl, sub);
+	ucl_object_insert_key(top, sub, "mem_profile", 0, false);
+#endif
+
 	if (do_reset) {
 		session->ctx->srv->stat->messages_scanned = 0;
 		session->ctx->srv->stat->messages_learned = 0;
@@ -3461,7 +3552,12 @@ rspamd_controller_finish_handler(struct rspamd_http_connection_entry *conn_ent)
 {
 	struct rspamd_controller_session *session = conn_ent->ud;
 
+#ifndef HAVE_ATOMIC_BUILTINS
 	session->ctx->worker->srv->stat->control_connections_count++;
+#else
+	__atomic_add_fetch(&session->ctx->worker->srv->stat->control_connections_count,
+					   1, __ATOMIC_RELEASE);
+#endif
 
 	if (session->task != NULL) {
 		rspamd_session_destroy(session->task->s);
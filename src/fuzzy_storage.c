@@ -47,6 +47,7 @@
 #define DEFAULT_UPDATES_MAXFAIL 3
 #define DEFAULT_MAX_BUCKETS 2000
 #define DEFAULT_BUCKET_TTL 3600
+#define DEFAULT_CHECK_CACHE_TTL 10
 #define DEFAULT_BUCKET_MASK 24
 /* Update stats on keys each 1 hour */
 #define KEY_STAT_INTERVAL 3600.0
@@ -80,6 +81,8 @@ struct fuzzy_global_stat {
 	uint64_t invalid_requests;
 	/**< amount of delayed hashes found				*/
 	uint64_t delayed_hashes;
+	/**< amount of check requests served from the local cache	*/
+	uint64_t cached_checks;
 };
 
 struct fuzzy_key_stat {
@@ -91,6 +94,8 @@ struct fuzzy_key_stat {
 	/* Store averages for checked/matched per minute */
 	struct rspamd_counter_data checked_ctr;
 	struct rspamd_counter_data matched_ctr;
+	/* Smoothed time between receiving a check and replying to it */
+	struct rspamd_counter_data check_latency_ctr;
 	double last_checked_time;
 	uint64_t last_checked_count;
 	uint64_t last_matched_count;
@@ -124,6 +129,32 @@ fuzzy_kp_equal(gconstpointer a, gconstpointer b)
 	return (memcmp(pa, pb, RSPAMD_FUZZY_KEYLEN) == 0);
 }
 
+static unsigned int
+fuzzy_check_cache_hash(gconstpointer p)
+{
+	return (unsigned int) rspamd_cryptobox_fast_hash(p,
+													 rspamd_cryptobox_HASHBYTES, rspamd_hash_seed());
+}
+
+static gboolean
+fuzzy_check_cache_equal(gconstpointer a, gconstpointer b)
+{
+	return (memcmp(a, b, rspamd_cryptobox_HASHBYTES) == 0);
+}
+
+static unsigned int
+fuzzy_peer_pk_hash(gconstpointer p)
+{
+	return (unsigned int) rspamd_cryptobox_fast_hash(p,
+													 rspamd_cryptobox_MAX_PKBYTES, rspamd_hash_seed());
+}
+
+static gboolean
+fuzzy_peer_pk_equal(gconstpointer a, gconstpointer b)
+{
+	return (memcmp(a, b, rspamd_cryptobox_MAX_PKBYTES) == 0);
+}
+
 enum fuzzy_key_op {
 	FUZZY_KEY_READ = 0x1u << 0,
 	FUZZY_KEY_WRITE = 0x1u << 1,
@@ -199,13 +230,20 @@ struct rspamd_fuzzy_storage_ctx {
 	gboolean read_only;
 	gboolean dedicated_update_worker;
 	struct rspamd_keypair_cache *keypair_cache;
+	/* Remote pubkeys reused across requests coming from the same peer */
+	rspamd_lru_hash_t *peer_pk_cache;
 	struct rspamd_http_context *http_ctx;
 	rspamd_lru_hash_t *errors_ips;
 	rspamd_lru_hash_t *ratelimit_buckets;
+	/* Hot digests memoised to avoid troubling the backend */
+	rspamd_lru_hash_t *check_cache;
 	struct rspamd_fuzzy_backend *backend;
 	GArray *updates_pending;
 	unsigned int updates_failed;
 	unsigned int updates_maxfail;
+	/* Replies deferred while draining a recvmmsg bundle (sendmmsg merely) */
+	GPtrArray *reply_batch;
+	int reply_batch_fd;
 	/* Used to send data between workers */
 	int peer_fd;
 
@@ -217,6 +255,10 @@ struct rspamd_fuzzy_storage_ctx {
 	double leaky_bucket_burst;
 	double leaky_bucket_rate;
 
+	/* Check replies cache */
+	unsigned int check_cache_max;
+	unsigned int check_cache_ttl;
+
 	struct rspamd_worker *worker;
 	const ucl_object_t *skip_map;
 	struct rspamd_hash_map_helper *skip_hashes;
@@ -235,10 +277,23 @@ enum fuzzy_cmd_type {
 	CMD_ENCRYPTED_SHINGLE
 };
 
+/*
+ * Accumulates replies of all commands carved from one batch datagram;
+ * the last session released flushes the whole bundle in a single sendto
+ */
+struct fuzzy_batch_reply_state {
+	rspamd_inet_addr_t *addr;
+	int fd;
+	unsigned int awaited;
+	gsize used;
+	unsigned char data[RSPAMD_FUZZY_BATCH_MAX * sizeof(struct rspamd_fuzzy_encrypted_reply)];
+};
+
 struct fuzzy_session {
 	struct rspamd_worker *worker;
 	rspamd_inet_addr_t *addr;
 	struct rspamd_fuzzy_storage_ctx *ctx;
+	struct fuzzy_batch_reply_state *batch;
 
 	struct rspamd_fuzzy_shingle_cmd cmd;       /* Can handle both shingles and non-shingles */
 	struct rspamd_fuzzy_encrypted_reply reply; /* Again: contains everything */
@@ -927,17 +982,15 @@ rspamd_fuzzy_reply_io(EV_P_ ev_io *w, int revents)
 	REF_RELEASE(session);
 }
 
-static void
-rspamd_fuzzy_write_reply(struct fuzzy_session *session)
+static gsize
+rspamd_fuzzy_reply_data(struct fuzzy_session *session, gconstpointer *pdata)
 {
-	gssize r;
 	gsize len;
-	gconstpointer data;
 
 	if (session->cmd_type == CMD_ENCRYPTED_NORMAL ||
 		session->cmd_type == CMD_ENCRYPTED_SHINGLE) {
 		/* Encrypted reply */
-		data = &session->reply;
+		*pdata = &session->reply;
 
 		if (session->epoch > RSPAMD_FUZZY_EPOCH10) {
 			len = sizeof(session->reply);
@@ -947,7 +1000,7 @@ rspamd_fuzzy_write_reply(struct fuzzy_session *session)
 		}
 	}
 	else {
-		data = &session->reply.rep;
+		*pdata = &session->reply.rep;
 
 		if (session->epoch > RSPAMD_FUZZY_EPOCH10) {
 			len = sizeof(session->reply.rep);
@@ -957,6 +1010,42 @@ rspamd_fuzzy_write_reply(struct fuzzy_session *session)
 		}
 	}
 
+	return len;
+}
+
+static void
+rspamd_fuzzy_write_reply(struct fuzzy_session *session)
+{
+	gssize r;
+	gsize len;
+	gconstpointer data;
+
+	if (session->batch != NULL) {
+		/* Accumulate the reply; the bundle is flushed when all commands
+		 * of the batch datagram have been released */
+		len = rspamd_fuzzy_reply_data(session, &data);
+
+		if (session->batch->used + len <= sizeof(session->batch->data)) {
+			memcpy(session->batch->data + session->batch->used, data, len);
+			session->batch->used += len;
+		}
+
+		return;
+	}
+
+#ifdef HAVE_SENDMMSG
+	if (session->ctx->reply_batch != NULL &&
+		session->fd == session->ctx->reply_batch_fd &&
+		session->addr != NULL) {
+		/* Defer the reply: the whole bundle is sent with a single sendmmsg */
+		REF_RETAIN(session);
+		g_ptr_array_add(session->ctx->reply_batch, session);
+
+		return;
+	}
+#endif
+
+	len = rspamd_fuzzy_reply_data(session, &data);
 	r = rspamd_inet_address_sendto(session->fd, data, len, 0,
 								   session->addr);
 
@@ -980,7 +1069,8 @@ rspamd_fuzzy_update_key_stat(gboolean matched,
 							 struct fuzzy_key_stat *key_stat,
 							 unsigned int cmd,
 							 struct rspamd_fuzzy_reply *res,
-							 ev_tstamp timestamp)
+							 ev_tstamp timestamp,
+							 ev_tstamp latency)
 {
 	if (!matched && res->v1.value != 0) {
 		key_stat->errors++;
@@ -993,6 +1083,10 @@ rspamd_fuzzy_update_key_stat(gboolean matched,
 				key_stat->matched++;
 			}
 
+			if (latency >= 0) {
+				rspamd_set_counter_ema(&key_stat->check_latency_ctr, latency, 0.5f);
+			}
+
 			if (G_UNLIKELY(key_stat->last_checked_time == 0.0)) {
 				key_stat->last_checked_time = timestamp;
 				key_stat->last_checked_count = key_stat->checked;
@@ -1030,6 +1124,9 @@ rspamd_fuzzy_update_stats(struct rspamd_fuzzy_storage_ctx *ctx,
 						  struct rspamd_fuzzy_reply *res,
 						  ev_tstamp timestamp)
 {
+	/* Receipt to reply distance, as the clients observe it */
+	ev_tstamp latency = ev_now(ctx->event_loop) - timestamp;
+
 	ctx->stat.fuzzy_hashes_checked[epoch]++;
 
 	if (matched) {
@@ -1043,7 +1140,8 @@ rspamd_fuzzy_update_stats(struct rspamd_fuzzy_storage_ctx *ctx,
 	}
 
 	if (key) {
-		rspamd_fuzzy_update_key_stat(matched, key->stat, cmd, res, timestamp);
+		rspamd_fuzzy_update_key_stat(matched, key->stat, cmd, res, timestamp,
+									 latency);
 
 		if (matched || ((cmd == FUZZY_WRITE || cmd == FUZZY_DEL) && res->v1.value == 0)) {
 			/* Update per flag stats */
@@ -1059,7 +1157,8 @@ rspamd_fuzzy_update_stats(struct rspamd_fuzzy_storage_ctx *ctx,
 			}
 
 			flag_stat = &kh_value(key->flags_stat, k);
-			rspamd_fuzzy_update_key_stat(matched, flag_stat, cmd, res, timestamp);
+			rspamd_fuzzy_update_key_stat(matched, flag_stat, cmd, res, timestamp,
+										 latency);
 		}
 	}
 
@@ -1451,6 +1550,33 @@ rspamd_fuzzy_check_callback(struct rspamd_fuzzy_reply *result, void *ud)
 	REF_RELEASE(session);
 }
 
+static void
+rspamd_fuzzy_check_backend_callback(struct rspamd_fuzzy_reply *result, void *ud)
+{
+	struct fuzzy_session *session = ud;
+	struct rspamd_fuzzy_storage_ctx *ctx = session->ctx;
+
+	/*
+	 * Memoise raw backend replies for exact digest checks; shingles lookups
+	 * are probabilistic, so they are never served from the cache.
+	 * Lua handlers, delay logic and refresh are applied per-request on hits.
+	 */
+	if (ctx->check_cache &&
+		(session->cmd_type == CMD_NORMAL || session->cmd_type == CMD_ENCRYPTED_NORMAL)) {
+		unsigned char *key;
+		struct rspamd_fuzzy_reply *cached;
+
+		key = g_malloc(sizeof(session->cmd.basic.digest));
+		memcpy(key, session->cmd.basic.digest, sizeof(session->cmd.basic.digest));
+		cached = g_malloc(sizeof(*cached));
+		memcpy(cached, result, sizeof(*cached));
+		rspamd_lru_hash_insert(ctx->check_cache, key, cached,
+							   (time_t) session->timestamp, ctx->check_cache_ttl);
+	}
+
+	rspamd_fuzzy_check_callback(result, session);
+}
+
 static void
 rspamd_fuzzy_process_command(struct fuzzy_session *session)
 {
@@ -1701,9 +1827,26 @@ rspamd_fuzzy_process_command(struct fuzzy_session *session)
 		}
 
 		if (is_rate_allowed) {
-			REF_RETAIN(session);
-			rspamd_fuzzy_backend_check(session->ctx->backend, cmd,
-									   rspamd_fuzzy_check_callback, session);
+			struct rspamd_fuzzy_reply *cached = NULL;
+
+			if (session->ctx->check_cache && !is_shingle) {
+				cached = rspamd_lru_hash_lookup(session->ctx->check_cache,
+												cmd->digest, (time_t) session->timestamp);
+			}
+
+			if (cached) {
+				/* Hot digest: serve the memoised backend reply */
+				memcpy(&result, cached, sizeof(result));
+				result.v1.tag = cmd->tag;
+				session->ctx->stat.cached_checks++;
+				REF_RETAIN(session);
+				rspamd_fuzzy_check_callback(&result, session);
+			}
+			else {
+				REF_RETAIN(session);
+				rspamd_fuzzy_backend_check(session->ctx->backend, cmd,
+										   rspamd_fuzzy_check_backend_callback, session);
+			}
 		}
 		else {
 			/* Should be 429 but we keep compatibility */
@@ -1748,6 +1891,11 @@ rspamd_fuzzy_process_command(struct fuzzy_session *session)
 				cmd->version |= RSPAMD_FUZZY_FLAG_WEAK;
 			}
 
+			if (session->ctx->check_cache) {
+				/* A pending modification makes the memoised reply stale */
+				rspamd_lru_hash_remove(session->ctx->check_cache, cmd->digest);
+			}
+
 			/* Noop backends must skip all updates logic as irrelevant */
 			if (!rspamd_fuzzy_backend_is_noop(session->ctx->backend)) {
 				if (session->worker->index == 0 || session->ctx->peer_fd == -1) {
@@ -1872,17 +2020,41 @@ rspamd_fuzzy_decrypt_command(struct fuzzy_session *s, unsigned char *buf, gsize
 		return FALSE;
 	}
 
-	/* Now process the remote pubkey */
-	rk = rspamd_pubkey_from_bin(hdr.pubkey, sizeof(hdr.pubkey), RSPAMD_KEYPAIR_KEX);
+	/* Now process the remote pubkey, reusing the parsed object if possible */
+	rk = NULL;
 
-	if (rk == NULL) {
-		msg_err("bad key; ip=%s",
-				rspamd_inet_address_to_string(s->addr));
-		return FALSE;
+	if (s->ctx->peer_pk_cache != NULL) {
+		rk = rspamd_lru_hash_lookup(s->ctx->peer_pk_cache, hdr.pubkey,
+									(time_t) s->timestamp);
+	}
+
+	if (rk != NULL) {
+		rk = rspamd_pubkey_ref(rk);
+	}
+	else {
+		rk = rspamd_pubkey_from_bin(hdr.pubkey, sizeof(hdr.pubkey),
+									RSPAMD_KEYPAIR_KEX);
+
+		if (rk == NULL) {
+			msg_err("bad key; ip=%s",
+					rspamd_inet_address_to_string(s->addr));
+			return FALSE;
+		}
+
+		if (s->ctx->peer_pk_cache != NULL) {
+			unsigned char *pk_cpy = g_malloc(sizeof(hdr.pubkey));
+
+			memcpy(pk_cpy, hdr.pubkey, sizeof(hdr.pubkey));
+			rspamd_lru_hash_insert(s->ctx->peer_pk_cache, pk_cpy,
+								   rspamd_pubkey_ref(rk),
+								   (time_t) s->timestamp, 0);
+		}
 	}
 
 	/* Try to get the cached NM */
-	rspamd_keypair_cache_process(s->ctx->keypair_cache, key->key, rk);
+	if (rspamd_pubkey_get_nm(rk, key->key) == NULL) {
+		rspamd_keypair_cache_process(s->ctx->keypair_cache, key->key, rk);
+	}
 
 	/* Now decrypt request */
 	if (!rspamd_cryptobox_decrypt_nm_inplace(buf, buflen, hdr.nonce,
@@ -2141,6 +2313,30 @@ fuzzy_session_destroy(gpointer d)
 {
 	struct fuzzy_session *session = d;
 
+	if (session->batch != NULL) {
+		struct fuzzy_batch_reply_state *batch = session->batch;
+
+		if (--batch->awaited == 0) {
+			if (batch->used > 0) {
+				gssize r;
+
+				while ((r = rspamd_inet_address_sendto(batch->fd,
+													   batch->data, batch->used, 0,
+													   batch->addr)) == -1) {
+					if (errno != EINTR) {
+						/* Merely drop the bundle: clients retransmit */
+						msg_debug("error while writing batch reply: %s",
+								  strerror(errno));
+						break;
+					}
+				}
+			}
+
+			rspamd_inet_address_free(batch->addr);
+			g_free(batch);
+		}
+	}
+
 	rspamd_inet_address_free(session->addr);
 	rspamd_explicit_memzero(session->nm, sizeof(session->nm));
 	session->worker->nconns--;
@@ -2160,7 +2356,7 @@ fuzzy_session_destroy(gpointer d)
 	g_free(session);
 }
 
-#define FUZZY_INPUT_BUFLEN 1024
+#define FUZZY_INPUT_BUFLEN 4096
 #ifdef HAVE_RECVMMSG
 #define MSGVEC_LEN 16
 #else
@@ -2174,6 +2370,159 @@ union sa_union {
 	struct sockaddr_un su;
 	struct sockaddr_storage ss;
 };
+
+#ifdef HAVE_SENDMMSG
+/*
+ * Send all replies deferred during a recvmmsg bundle with as few syscalls
+ * as possible; sessions that could not be sent are degraded to the plain
+ * per-session path that arms a write watcher on EAGAIN
+ */
+static void
+rspamd_fuzzy_reply_batch_flush(struct rspamd_fuzzy_storage_ctx *ctx, int fd)
+{
+	GPtrArray *batch = ctx->reply_batch;
+	struct fuzzy_session *session;
+	struct mmsghdr msgs[MSGVEC_LEN];
+	struct iovec iovs[MSGVEC_LEN];
+	unsigned int i, nsent = 0;
+	gssize r;
+
+	/* Stop diverting replies before performing any real sends */
+	ctx->reply_batch = NULL;
+
+	while (nsent < batch->len) {
+		unsigned int cnt = MIN(batch->len - nsent, G_N_ELEMENTS(msgs));
+
+		memset(msgs, 0, sizeof(*msgs) * cnt);
+
+		for (i = 0; i < cnt; i++) {
+			gconstpointer data;
+			socklen_t salen;
+
+			session = g_ptr_array_index(batch, nsent + i);
+			iovs[i].iov_len = rspamd_fuzzy_reply_data(session, &data);
+			iovs[i].iov_base = (void *) data;
+			msgs[i].msg_hdr.msg_name = rspamd_inet_address_get_sa(session->addr,
+																  &salen);
+			msgs[i].msg_hdr.msg_namelen = salen;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		r = sendmmsg(fd, msgs, cnt, 0);
+
+		if (r == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			/* Remaining sessions are retried individually below */
+			break;
+		}
+
+		nsent += r;
+
+		if ((unsigned int) r < cnt) {
+			/* Socket buffer is full, fall back to the per-session path */
+			break;
+		}
+	}
+
+	for (i = nsent; i < batch->len; i++) {
+		rspamd_fuzzy_write_reply(g_ptr_array_index(batch, i));
+	}
+
+	for (i = 0; i < batch->len; i++) {
+		session = g_ptr_array_index(batch, i);
+		REF_RELEASE(session);
+	}
+
+	g_ptr_array_free(batch, TRUE);
+}
+#endif
+
+/*
+ * Carve individual commands out of a batch datagram; each one is processed
+ * as an ordinary session and the replies are bundled by the shared state.
+ * Ownership of `addr` is transferred here.
+ */
+static void
+rspamd_fuzzy_process_batch(struct rspamd_worker *worker,
+						   struct rspamd_fuzzy_storage_ctx *ctx,
+						   int fd, rspamd_inet_addr_t *addr,
+						   unsigned char *buf, gsize buflen)
+{
+	struct rspamd_fuzzy_batch_hdr hdr;
+	uint16_t frame_lens[RSPAMD_FUZZY_BATCH_MAX];
+	struct fuzzy_batch_reply_state *batch;
+	struct fuzzy_session *session;
+	unsigned char *p = buf;
+	gsize remain = buflen, total = 0;
+	unsigned int i;
+
+	memcpy(&hdr, p, sizeof(hdr));
+	p += sizeof(hdr);
+	remain -= sizeof(hdr);
+
+	if (hdr.version != RSPAMD_FUZZY_BATCH_VERSION || hdr.count == 0 ||
+		hdr.count > RSPAMD_FUZZY_BATCH_MAX ||
+		remain < hdr.count * sizeof(uint16_t)) {
+		ctx->stat.invalid_requests++;
+		msg_debug("invalid fuzzy batch header of size %z received", buflen);
+		rspamd_inet_address_free(addr);
+
+		return;
+	}
+
+	memcpy(frame_lens, p, hdr.count * sizeof(uint16_t));
+	p += hdr.count * sizeof(uint16_t);
+	remain -= hdr.count * sizeof(uint16_t);
+
+	for (i = 0; i < hdr.count; i++) {
+		frame_lens[i] = GUINT16_FROM_LE(frame_lens[i]);
+		total += frame_lens[i];
+	}
+
+	if (total != remain) {
+		ctx->stat.invalid_requests++;
+		msg_debug("invalid fuzzy batch of size %z received: %z bytes of frames "
+				  "announced but %z available",
+				  buflen, total, remain);
+		rspamd_inet_address_free(addr);
+
+		return;
+	}
+
+	batch = g_malloc0(sizeof(*batch));
+	batch->fd = fd;
+	batch->addr = addr;
+	batch->awaited = hdr.count;
+
+	for (i = 0; i < hdr.count; i++) {
+		session = g_malloc0(sizeof(*session));
+		REF_INIT_RETAIN(session, fuzzy_session_destroy);
+		session->worker = worker;
+		session->fd = fd;
+		session->ctx = ctx;
+		session->timestamp = ev_now(ctx->event_loop);
+		session->addr = rspamd_inet_address_copy(addr, NULL);
+		session->batch = batch;
+		worker->nconns++;
+
+		if (rspamd_fuzzy_cmd_from_wire(p, frame_lens[i], session)) {
+			rspamd_fuzzy_process_command(session);
+		}
+		else {
+			ctx->stat.invalid_requests++;
+			msg_debug("invalid fuzzy command of size %d received in batch",
+					  (int) frame_lens[i]);
+		}
+
+		p += frame_lens[i];
+		REF_RELEASE(session);
+	}
+}
+
 /*
  * Accept new connection and construct task
  */
@@ -2241,6 +2590,14 @@ accept_fuzzy_socket(EV_P_ ev_io *w, int revents)
 			r = 1;       /* Assume that we have received a single message */
 #endif
 
+#ifdef HAVE_SENDMMSG
+			/* Divert synchronous replies to answer the bundle in one syscall */
+			if (r > 1 && ctx->reply_batch == NULL) {
+				ctx->reply_batch = g_ptr_array_sized_new(r);
+				ctx->reply_batch_fd = w->fd;
+			}
+#endif
+
 			for (int i = 0; i < r; i++) {
 				rspamd_inet_addr_t *client_addr;
 
@@ -2252,6 +2609,21 @@ accept_fuzzy_socket(EV_P_ ev_io *w, int revents)
 					client_addr = NULL;
 				}
 
+				/* Each message can have its length in case of recvmmsg */
+#ifdef HAVE_RECVMMSG
+				msg_len = msg[i].msg_len;
+#endif
+
+				if (client_addr != NULL &&
+					msg_len >= (gssize) sizeof(struct rspamd_fuzzy_batch_hdr) &&
+					memcmp(iovs[i].iov_base, fuzzy_batch_magic,
+						   sizeof(fuzzy_batch_magic)) == 0) {
+					/* Ownership of client_addr is transferred */
+					rspamd_fuzzy_process_batch(worker, ctx, w->fd, client_addr,
+											   iovs[i].iov_base, msg_len);
+					continue;
+				}
+
 				session = g_malloc0(sizeof(*session));
 				REF_INIT_RETAIN(session, fuzzy_session_destroy);
 				session->worker = worker;
@@ -2261,11 +2633,6 @@ accept_fuzzy_socket(EV_P_ ev_io *w, int revents)
 				session->addr = client_addr;
 				worker->nconns++;
 
-				/* Each message can have its length in case of recvmmsg */
-#ifdef HAVE_RECVMMSG
-				msg_len = msg[i].msg_len;
-#endif
-
 				if (rspamd_fuzzy_cmd_from_wire(iovs[i].iov_base,
 											   msg_len, session)) {
 					/* Check shingles count sanity */
@@ -2295,6 +2662,13 @@ accept_fuzzy_socket(EV_P_ ev_io *w, int revents)
 
 				REF_RELEASE(session);
 			}
+
+#ifdef HAVE_SENDMMSG
+			if (ctx->reply_batch != NULL) {
+				rspamd_fuzzy_reply_batch_flush(ctx, w->fd);
+			}
+#endif
+
 #ifdef HAVE_RECVMMSG
 			/* Stop reading as we are using recvmmsg instead of recvmsg */
 			break;
@@ -2330,7 +2704,7 @@ rspamd_fuzzy_storage_sync(struct rspamd_main *rspamd_main,
 	rep.reply.fuzzy_sync.status = 0;
 	rep.type = RSPAMD_CONTROL_FUZZY_SYNC;
 
-	if (ctx->backend && worker->index == 0) {
+	if (ctx->backend && worker->index == 0 && !ctx->read_only) {
 		rspamd_fuzzy_process_updates_queue(ctx, local_db_name, FALSE);
 		rspamd_fuzzy_backend_start_update(ctx->backend, ctx->sync_timeout,
 										  rspamd_fuzzy_storage_periodic_callback, ctx);
@@ -2452,7 +2826,7 @@ rspamd_fuzzy_storage_reload(struct rspamd_main *rspamd_main,
 		rep.reply.reload.status = 0;
 	}
 
-	if (ctx->backend && worker->index == 0) {
+	if (ctx->backend && worker->index == 0 && !ctx->read_only) {
 		rspamd_fuzzy_backend_start_update(ctx->backend, ctx->sync_timeout,
 										  rspamd_fuzzy_storage_periodic_callback, ctx);
 	}
@@ -2480,6 +2854,8 @@ rspamd_fuzzy_storage_stat_key(const struct fuzzy_key_stat *key_stat)
 						  "matched", 0, false);
 	ucl_object_insert_key(res, ucl_object_fromdouble(key_stat->matched_ctr.mean),
 						  "matched_per_hour", 0, false);
+	ucl_object_insert_key(res, ucl_object_fromdouble(key_stat->check_latency_ctr.mean),
+						  "check_latency_avg", 0, false);
 	ucl_object_insert_key(res, ucl_object_fromint(key_stat->added),
 						  "added", 0, false);
 	ucl_object_insert_key(res, ucl_object_fromint(key_stat->deleted),
@@ -2599,6 +2975,11 @@ rspamd_fuzzy_stat_to_ucl(struct rspamd_fuzzy_storage_ctx *ctx, gboolean ip_stat)
 						  "delayed_hashes",
 						  0,
 						  false);
+	ucl_object_insert_key(obj,
+						  ucl_object_fromint(ctx->stat.cached_checks),
+						  "cached_checks",
+						  0,
+						  false);
 
 	if (ctx->errors_ips && ip_stat) {
 		gpointer k, v;
@@ -3250,6 +3631,7 @@ init_fuzzy(struct rspamd_config *cfg)
 	ctx->leaky_bucket_burst = NAN;
 	ctx->leaky_bucket_rate = NAN;
 	ctx->delay = NAN;
+	ctx->check_cache_ttl = DEFAULT_CHECK_CACHE_TTL;
 	ctx->default_forbidden_ids = kh_init(fuzzy_key_ids_set);
 	ctx->weak_ids = kh_init(fuzzy_key_ids_set);
 
@@ -3468,6 +3850,25 @@ init_fuzzy(struct rspamd_config *cfg)
 									  0,
 									  "Don't really ban on ratelimit reaching, just log");
 
+	/* Check cache */
+	rspamd_rcl_register_worker_option(cfg,
+									  type,
+									  "check_cache_size",
+									  rspamd_rcl_parse_struct_integer,
+									  ctx,
+									  G_STRUCT_OFFSET(struct rspamd_fuzzy_storage_ctx, check_cache_max),
+									  RSPAMD_CL_FLAG_UINT,
+									  "Maximum number of hot digests whose check replies are cached in memory "
+									  "(default: 0, disabled)");
+	rspamd_rcl_register_worker_option(cfg,
+									  type,
+									  "check_cache_ttl",
+									  rspamd_rcl_parse_struct_time,
+									  ctx,
+									  G_STRUCT_OFFSET(struct rspamd_fuzzy_storage_ctx, check_cache_ttl),
+									  RSPAMD_CL_FLAG_TIME_INTEGER,
+									  "Time to live for a cached check reply (default: " G_STRINGIFY(DEFAULT_CHECK_CACHE_TTL) " seconds)");
+
 
 	return ctx;
 }
@@ -3494,6 +3895,11 @@ rspamd_fuzzy_peer_io(EV_P_ ev_io *w, int revents)
 			break;
 		}
 		else {
+			if (ctx->check_cache) {
+				rspamd_lru_hash_remove(ctx->check_cache,
+									   cmd.cmd.normal.digest);
+			}
+
 			g_array_append_val(ctx->updates_pending, cmd);
 		}
 	}
@@ -3592,6 +3998,11 @@ start_fuzzy(struct rspamd_worker *worker)
 	if (ctx->keypair_cache_size > 0) {
 		/* Create keypairs cache */
 		ctx->keypair_cache = rspamd_keypair_cache_new(ctx->keypair_cache_size);
+		/* Parsed remote pubkeys are reused along with the NM cache */
+		ctx->peer_pk_cache = rspamd_lru_hash_new_full(ctx->keypair_cache_size,
+													  g_free,
+													  (GDestroyNotify) rspamd_pubkey_unref,
+													  fuzzy_peer_pk_hash, fuzzy_peer_pk_equal);
 	}
 
 
@@ -3607,7 +4018,16 @@ start_fuzzy(struct rspamd_worker *worker)
 	rspamd_fuzzy_backend_count(ctx->backend, fuzzy_count_callback, ctx);
 
 
-	if (worker->index == 0) {
+	if (worker->index == 0 && ctx->read_only) {
+		/*
+		 * Read replica: never load the update machinery, so the backend is
+		 * merely a snapshot that an external synchronisation process can
+		 * replace and refresh via the reload control command
+		 */
+		msg_info_config("worker runs as a read-only replica; no local updates, "
+						"expiration or sync will be performed");
+	}
+	else if (worker->index == 0) {
 		ctx->updates_pending = g_array_sized_new(FALSE, FALSE,
 												 sizeof(struct fuzzy_peer_cmd), 1024);
 		rspamd_fuzzy_backend_start_update(ctx->backend, ctx->sync_timeout,
@@ -3742,6 +4162,12 @@ start_fuzzy(struct rspamd_worker *worker)
 													  NULL, fuzzy_rl_bucket_free,
 													  rspamd_inet_address_hash, rspamd_inet_address_equal);
 
+	if (ctx->check_cache_max > 0) {
+		ctx->check_cache = rspamd_lru_hash_new_full(ctx->check_cache_max,
+													g_free, g_free,
+													fuzzy_check_cache_hash, fuzzy_check_cache_equal);
+	}
+
 	rspamd_fuzzy_maybe_load_ratelimits(ctx);
 
 	/* Maps events */
@@ -3808,7 +4234,8 @@ start_fuzzy(struct rspamd_worker *worker)
 		close(ctx->peer_fd);
 	}
 
-	if (worker->index == 0 && ctx->updates_pending->len > 0) {
+	if (worker->index == 0 && ctx->updates_pending != NULL &&
+		ctx->updates_pending->len > 0) {
 
 		msg_info_config("start another event loop to sync fuzzy storage");
 
@@ -3823,7 +4250,7 @@ start_fuzzy(struct rspamd_worker *worker)
 
 	rspamd_fuzzy_backend_close(ctx->backend);
 
-	if (worker->index == 0) {
+	if (worker->index == 0 && ctx->updates_pending != NULL) {
 		g_array_free(ctx->updates_pending, TRUE);
 		ctx->updates_pending = NULL;
 	}
@@ -3832,6 +4259,10 @@ start_fuzzy(struct rspamd_worker *worker)
 		rspamd_keypair_cache_destroy(ctx->keypair_cache);
 	}
 
+	if (ctx->peer_pk_cache) {
+		rspamd_lru_hash_destroy(ctx->peer_pk_cache);
+	}
+
 	if (ctx->ratelimit_buckets) {
 		/* Try the best to save ratelimits from the proper worker */
 		if ((!ctx->dedicated_update_worker && worker->index == 0) ||
@@ -3842,6 +4273,10 @@ start_fuzzy(struct rspamd_worker *worker)
 		rspamd_lru_hash_destroy(ctx->ratelimit_buckets);
 	}
 
+	if (ctx->check_cache) {
+		rspamd_lru_hash_destroy(ctx->check_cache);
+	}
+
 	struct rspamd_lua_fuzzy_script *cur, *tmp;
 
 	LL_FOREACH_SAFE(ctx->lua_pre_handlers, cur, tmp)
@@ -327,7 +327,19 @@ rspamd_rs_compile(struct hs_helper_ctx *ctx, struct rspamd_worker *worker,
 	}
 #endif
 
-	if (!rspamd_hs_helper_cleanup_dir(ctx, forced)) {
+	/*
+	 * Expressions are sharded into per-class cache files named by a hash of
+	 * their contents, so a changed class simply stops matching its old file:
+	 * validity-driven cleanup removes merely the stale shards, and the compile
+	 * step skips classes whose files are still valid. Scrubbing the whole dir
+	 * on a forced request would turn a single map update into a full rebuild
+	 * of every scope, so we reserve that for RSPAMD_FORCE_HS_SCRUB (e.g. to
+	 * recover from a corrupted cache dir); the forced flag still enforces
+	 * reload notifications for all workers.
+	 */
+	gboolean scrub_all = forced && getenv("RSPAMD_FORCE_HS_SCRUB") != NULL;
+
+	if (!rspamd_hs_helper_cleanup_dir(ctx, scrub_all)) {
 		msg_warn("cannot cleanup cache dir '%s'", ctx->hs_dir);
 	}
 
@@ -351,7 +363,7 @@ rspamd_hs_helper_reload(struct rspamd_main *rspamd_main,
 	struct rspamd_control_reply rep;
 	struct hs_helper_ctx *ctx = ud;
 
-	msg_info("recompiling hyperscan expressions after receiving reload command");
+	msg_info("recompiling changed hyperscan expression classes after receiving reload command");
 	memset(&rep, 0, sizeof(rep));
 	rep.type = RSPAMD_CONTROL_RECOMPILE;
 	rep.reply.recompile.status = 0;
@@ -336,6 +336,7 @@ static base64_impl_t base64_list[] = {
 };
 
 static const base64_impl_t *base64_ref = &base64_list[0];
+static const base64_impl_t *base64_opt = &base64_list[0];
 
 const char *
 base64_load(void)
@@ -355,6 +356,7 @@ base64_load(void)
 		}
 	}
 
+	base64_opt = opt_impl;
 
 	return opt_impl->desc;
 }
@@ -363,13 +365,18 @@ gboolean
 rspamd_cryptobox_base64_decode(const char *in, gsize inlen,
 							   unsigned char *out, gsize *outlen)
 {
-	const base64_impl_t *opt_impl = base64_ref;
-
-	for (int i = G_N_ELEMENTS(base64_list) - 1; i > 0; i--) {
-		if (base64_list[i].enabled && base64_list[i].min_len <= inlen) {
-			opt_impl = &base64_list[i];
-			break;
+	/* The best implementation is selected once at load time */
+	const base64_impl_t *opt_impl = base64_opt;
+
+	if (G_UNLIKELY(inlen < opt_impl->min_len)) {
+		/* Input is too short for the preferred codec, degrade gracefully */
+		for (int i = G_N_ELEMENTS(base64_list) - 1; i > 0; i--) {
+			if (base64_list[i].enabled && base64_list[i].min_len <= inlen) {
+				return base64_list[i].decode(in, inlen, out, outlen);
+			}
 		}
+
+		opt_impl = base64_ref;
 	}
 
 	return opt_impl->decode(in, inlen, out, outlen);
@@ -0,0 +1,224 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include "cryptobox.h"
+#include "chacha.h"
+#include "platform_config.h"
+
+#if defined(HAVE_AVX512) && defined(RSPAMD_HAS_TARGET_ATTR) && defined(__x86_64__)
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+#ifndef __AVX512F__
+#define __AVX512F__
+#endif
+
+#include <immintrin.h>
+
+/* Scalar implementation used for the tail and for hchacha */
+void chacha_blocks_ref(chacha_state_internal *state, const unsigned char *in,
+					   unsigned char *out, size_t bytes);
+void hchacha_ref(const unsigned char key[32], const unsigned char iv[16],
+				 unsigned char out[32], size_t rounds);
+
+/* "expand 32-byte k", as 4 little endian 32-bit unsigned integers */
+static const uint32_t chacha_constants[4] = {
+	0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+
+void chacha_blocks_avx512(chacha_state_internal *state, const unsigned char *in,
+						  unsigned char *out, size_t bytes)
+	__attribute__((__target__("avx512f")));
+
+/*
+ * Four blocks per iteration: each zmm register keeps one row of the state
+ * for four consecutive blocks, so a column round is plain lane-wise 32 bit
+ * arithmetic and vprold gives the rotates in a single instruction; the
+ * diagonal rounds merely shuffle words within each 128 bit lane
+ */
+void chacha_blocks_avx512(chacha_state_internal *state, const unsigned char *in,
+						  unsigned char *out, size_t bytes)
+{
+	if (bytes >= 256) {
+		const __m512i ctr_lanes = _mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0);
+		const __m128i ctr_step = _mm_set_epi64x(0, 4);
+		__m128i r1, r2, r3;
+		__m512i k0, k1;
+		size_t rounds = state->rounds;
+		uint64_t ctr;
+
+		r1 = _mm_loadu_si128((const __m128i *) (state->s + 0));
+		r2 = _mm_loadu_si128((const __m128i *) (state->s + 16));
+		r3 = _mm_loadu_si128((const __m128i *) (state->s + 32));
+		k0 = _mm512_broadcast_i32x4(r1);
+		k1 = _mm512_broadcast_i32x4(r2);
+
+		do {
+			__m512i a, b, c, d, d0;
+			size_t i;
+
+			a = _mm512_broadcast_i32x4(
+				_mm_loadu_si128((const __m128i *) chacha_constants));
+			b = k0;
+			c = k1;
+			/* Counters of the four lanes differ merely by the block index */
+			d0 = _mm512_add_epi64(_mm512_broadcast_i32x4(r3), ctr_lanes);
+			d = d0;
+
+			i = rounds;
+			do {
+				/* Column round */
+				a = _mm512_add_epi32(a, b);
+				d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 16);
+				c = _mm512_add_epi32(c, d);
+				b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 12);
+				a = _mm512_add_epi32(a, b);
+				d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 8);
+				c = _mm512_add_epi32(c, d);
+				b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 7);
+
+				/* Diagonalise */
+				b = _mm512_shuffle_epi32(b, (_MM_PERM_ENUM) 0x39);
+				c = _mm512_shuffle_epi32(c, (_MM_PERM_ENUM) 0x4e);
+				d = _mm512_shuffle_epi32(d, (_MM_PERM_ENUM) 0x93);
+
+				/* Diagonal round */
+				a = _mm512_add_epi32(a, b);
+				d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 16);
+				c = _mm512_add_epi32(c, d);
+				b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 12);
+				a = _mm512_add_epi32(a, b);
+				d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 8);
+				c = _mm512_add_epi32(c, d);
+				b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 7);
+
+				b = _mm512_shuffle_epi32(b, (_MM_PERM_ENUM) 0x93);
+				c = _mm512_shuffle_epi32(c, (_MM_PERM_ENUM) 0x4e);
+				d = _mm512_shuffle_epi32(d, (_MM_PERM_ENUM) 0x39);
+
+				i -= 2;
+			} while (i);
+
+			a = _mm512_add_epi32(a,
+								 _mm512_broadcast_i32x4(_mm_loadu_si128(
+									 (const __m128i *) chacha_constants)));
+			b = _mm512_add_epi32(b, k0);
+			c = _mm512_add_epi32(c, k1);
+			d = _mm512_add_epi32(d, d0);
+
+			/* The extract intrinsics require immediate lane numbers */
+#define chacha_avx512_store_xor(lane)                                                \
+	do {                                                                             \
+		const unsigned char *ip = in + (lane) *64;                                   \
+		unsigned char *op = out + (lane) *64;                                        \
+		_mm_storeu_si128((__m128i *) (op + 0),                                       \
+						 _mm_xor_si128(_mm512_extracti32x4_epi32(a, (lane)),         \
+									   _mm_loadu_si128((const __m128i *) (ip + 0))));  \
+		_mm_storeu_si128((__m128i *) (op + 16),                                      \
+						 _mm_xor_si128(_mm512_extracti32x4_epi32(b, (lane)),         \
+									   _mm_loadu_si128((const __m128i *) (ip + 16)))); \
+		_mm_storeu_si128((__m128i *) (op + 32),                                      \
+						 _mm_xor_si128(_mm512_extracti32x4_epi32(c, (lane)),         \
+									   _mm_loadu_si128((const __m128i *) (ip + 32)))); \
+		_mm_storeu_si128((__m128i *) (op + 48),                                      \
+						 _mm_xor_si128(_mm512_extracti32x4_epi32(d, (lane)),         \
+									   _mm_loadu_si128((const __m128i *) (ip + 48)))); \
+	} while (0)
+#define chacha_avx512_store(lane)                                             \
+	do {                                                                      \
+		unsigned char *op = out + (lane) *64;                                 \
+		_mm_storeu_si128((__m128i *) (op + 0),                                \
+						 _mm512_extracti32x4_epi32(a, (lane)));               \
+		_mm_storeu_si128((__m128i *) (op + 16),                               \
+						 _mm512_extracti32x4_epi32(b, (lane)));               \
+		_mm_storeu_si128((__m128i *) (op + 32),                               \
+						 _mm512_extracti32x4_epi32(c, (lane)));               \
+		_mm_storeu_si128((__m128i *) (op + 48),                               \
+						 _mm512_extracti32x4_epi32(d, (lane)));               \
+	} while (0)
+
+			if (in) {
+				chacha_avx512_store_xor(0);
+				chacha_avx512_store_xor(1);
+				chacha_avx512_store_xor(2);
+				chacha_avx512_store_xor(3);
+				in += 256;
+			}
+			else {
+				chacha_avx512_store(0);
+				chacha_avx512_store(1);
+				chacha_avx512_store(2);
+				chacha_avx512_store(3);
+			}
+
+			/* 64 bit little endian counter in the low quadword */
+			r3 = _mm_add_epi64(r3, ctr_step);
+			out += 256;
+			bytes -= 256;
+		} while (bytes >= 256);
+
+		ctr = (uint64_t) _mm_cvtsi128_si64(r3);
+		memcpy(state->s + 32, &ctr, sizeof(ctr));
+	}
+
+	/* Partial blocks and anything shorter than four blocks */
+	if (bytes) {
+		chacha_blocks_ref(state, in, out, bytes);
+	}
+}
+
+void hchacha_avx512(const unsigned char key[32], const unsigned char iv[16],
+					unsigned char out[32], size_t rounds)
+{
+	/* A single block, vectorisation gains nothing here */
+	hchacha_ref(key, iv, out, rounds);
+}
+
+void chacha_avx512(const chacha_key *key, const chacha_iv *iv,
+				   const unsigned char *in, unsigned char *out, size_t inlen,
+				   size_t rounds)
+{
+	chacha_state_internal state;
+
+	memcpy(state.s + 0, key->b, 32);
+	memset(state.s + 32, 0, 8);
+	memcpy(state.s + 40, iv->b, 8);
+	state.rounds = rounds;
+	chacha_blocks_avx512(&state, in, out, inlen);
+	rspamd_explicit_memzero(state.s, 48);
+}
+
+void xchacha_avx512(const chacha_key *key, const chacha_iv24 *iv,
+					const unsigned char *in, unsigned char *out, size_t inlen,
+					size_t rounds)
+{
+	chacha_state_internal state;
+
+	hchacha_ref(key->b, iv->b, &state.s[0], rounds);
+	memset(state.s + 32, 0, 8);
+	memcpy(state.s + 40, iv->b + 16, 8);
+	state.rounds = rounds;
+	chacha_blocks_avx512(&state, in, out, inlen);
+	rspamd_explicit_memzero(state.s, 48);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
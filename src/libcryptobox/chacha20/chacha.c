@@ -54,6 +54,10 @@ typedef struct chacha_impl_t {
 		(cpuflags), desc, chacha_##ext, xchacha_##ext, chacha_blocks_##ext, hchacha_##ext \
 	}
 
+#if defined(HAVE_AVX512) && defined(RSPAMD_HAS_TARGET_ATTR) && defined(__x86_64__)
+CHACHA_DECLARE(avx512)
+#define CHACHA_AVX512 CHACHA_IMPL(CPUID_AVX512F, "avx512", avx512)
+#endif
 #if defined(HAVE_AVX2) && defined(__x86_64__)
 CHACHA_DECLARE(avx2)
 #define CHACHA_AVX2 CHACHA_IMPL(CPUID_AVX2, "avx2", avx2)
@@ -72,6 +76,9 @@ CHACHA_DECLARE(ref)
 
 static const chacha_impl_t chacha_list[] = {
 	CHACHA_GENERIC,
+#if defined(CHACHA_AVX512) && defined(__x86_64__)
+	CHACHA_AVX512,
+#endif
 #if defined(CHACHA_AVX2) && defined(__x86_64__)
 	CHACHA_AVX2,
 #endif
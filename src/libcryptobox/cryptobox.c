@@ -53,6 +53,8 @@ unsigned cpu_config = 0;
 
 static gboolean cryptobox_loaded = FALSE;
 
+static const char *fasthash_load(void);
+
 static const unsigned char n0[16] = {0};
 
 #define CRYPTOBOX_ALIGNMENT 16
@@ -135,6 +137,12 @@ rspamd_cryptobox_test_instr(int instr)
 	case CPUID_AVX2:
 		ret = __builtin_cpu_supports("avx2");
 		break;
+#endif
+#ifdef HAVE_AVX512
+	case CPUID_AVX512F:
+		/* Also implies that the OS saves zmm state */
+		ret = __builtin_cpu_supports("avx512f");
+		break;
 #endif
 	}
 
@@ -212,6 +220,12 @@ rspamd_cryptobox_test_instr(int instr)
 	case CPUID_AVX2:
 		__asm__ volatile("vpaddq %ymm0, %ymm0, %ymm0");
 		break;
+#endif
+#ifdef HAVE_AVX512
+	case CPUID_AVX512F:
+		/* Traps as well if the OS does not save zmm state */
+		__asm__ volatile("vpxord %zmm0, %zmm0, %zmm0");
+		break;
 #endif
 	default:
 		return FALSE;
@@ -300,6 +314,12 @@ rspamd_cryptobox_init(void)
 						cpu_config |= CPUID_AVX2;
 					}
 				}
+
+				if ((cpu[1] & ((uint32_t) 1 << 16))) {
+					if (rspamd_cryptobox_test_instr(CPUID_AVX512F)) {
+						cpu_config |= CPUID_AVX512F;
+					}
+				}
 			}
 		}
 	}
@@ -333,6 +353,9 @@ rspamd_cryptobox_init(void)
 			case CPUID_RDRAND:
 				rspamd_printf_gstring(buf, "rdrand, ");
 				break;
+			case CPUID_AVX512F:
+				rspamd_printf_gstring(buf, "avx512f, ");
+				break;
 			default:
 				break; /* Silence warning */
 			}
@@ -351,6 +374,7 @@ rspamd_cryptobox_init(void)
 
 	ctx->chacha20_impl = chacha_load();
 	ctx->base64_impl = base64_load();
+	ctx->fasthash_impl = fasthash_load();
 #if defined(HAVE_USABLE_OPENSSL) && (OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER))
 	/* Needed for old openssl api, not sure about LibreSSL */
 	ERR_load_EC_strings();
@@ -1268,11 +1292,131 @@ rspamd_cryptobox_fast_hash_final(rspamd_cryptobox_fast_hash_state_t *st)
 /**
 * One in all function
 */
+static uint64_t
+rspamd_fasthash_xxh3(const void *data, gsize len, uint64_t seed)
+{
+	return XXH3_64bits_withSeed(data, len, seed);
+}
+
+static uint64_t
+rspamd_fasthash_t1ha2(const void *data, gsize len, uint64_t seed)
+{
+	return t1ha2_atonce(data, len, seed);
+}
+
+/*
+ * The machdep hash is explicitly not portable (callers that persist hashes
+ * use the _specific variants), so we are free to pick the kernel that is
+ * actually fastest on the host CPU instead of guessing from the compile
+ * target. Short keys (hash table probes) and long buffers (shingles input,
+ * map digests) favour different kernels on different CPUs, hence the
+ * dispatch is per size class; the long buffer candidates are all wide
+ * multi-lane designs internally. Both slots default to xxhash3 until
+ * rspamd_cryptobox_init has run the selection
+ */
+#define RSPAMD_FASTHASH_WIDE_THRESHOLD 256
+
+static struct rspamd_fasthash_dispatch {
+	uint64_t (*short_fn)(const void *data, gsize len, uint64_t seed);
+	uint64_t (*wide_fn)(const void *data, gsize len, uint64_t seed);
+} fasthash_dispatch = {
+	.short_fn = rspamd_fasthash_xxh3,
+	.wide_fn = rspamd_fasthash_xxh3,
+};
+
+static const struct rspamd_fasthash_candidate {
+	const char *name;
+	uint64_t (*fn)(const void *data, gsize len, uint64_t seed);
+} fasthash_candidates[] = {
+	{"xxh3", rspamd_fasthash_xxh3},
+	{"t1ha2", rspamd_fasthash_t1ha2},
+};
+
+static uint64_t
+fasthash_bench(uint64_t (*fn)(const void *, gsize, uint64_t),
+			   const unsigned char *buf, gsize buflen, gsize chunk)
+{
+	uint64_t best = UINT64_MAX;
+	volatile uint64_t sink = 0;
+	struct timespec ts;
+	unsigned int round, pass;
+	gsize i;
+
+	/* Take the best of a few rounds to shrug off scheduling noise */
+	for (round = 0; round < 3; round++) {
+		uint64_t t0, elapsed;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		t0 = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+		for (pass = 0; pass < 16; pass++) {
+			for (i = 0; i + chunk <= buflen; i += chunk) {
+				sink ^= fn(buf + i, chunk, sink);
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		elapsed = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec - t0;
+		best = MIN(best, elapsed);
+	}
+
+	(void) sink;
+
+	return best;
+}
+
+static const char *
+fasthash_load(void)
+{
+	static char impl_name[64];
+	unsigned char buf[8192];
+	unsigned int i, best_short = 0, best_wide = 0;
+	uint64_t cost, best_cost;
+	gsize blen;
+
+	for (blen = 0; blen < sizeof(buf); blen++) {
+		buf[blen] = (unsigned char) (blen * 2654435761U >> 16);
+	}
+
+	best_cost = UINT64_MAX;
+	for (i = 0; i < G_N_ELEMENTS(fasthash_candidates); i++) {
+		cost = fasthash_bench(fasthash_candidates[i].fn, buf, sizeof(buf), 32);
+
+		if (cost < best_cost) {
+			best_cost = cost;
+			best_short = i;
+		}
+	}
+
+	best_cost = UINT64_MAX;
+	for (i = 0; i < G_N_ELEMENTS(fasthash_candidates); i++) {
+		cost = fasthash_bench(fasthash_candidates[i].fn, buf, sizeof(buf),
+							  sizeof(buf));
+
+		if (cost < best_cost) {
+			best_cost = cost;
+			best_wide = i;
+		}
+	}
+
+	fasthash_dispatch.short_fn = fasthash_candidates[best_short].fn;
+	fasthash_dispatch.wide_fn = fasthash_candidates[best_wide].fn;
+	g_snprintf(impl_name, sizeof(impl_name), "%s(short),%s(wide)",
+			   fasthash_candidates[best_short].name,
+			   fasthash_candidates[best_wide].name);
+
+	return impl_name;
+}
+
 static inline uint64_t
 rspamd_cryptobox_fast_hash_machdep(const void *data,
 								   gsize len, uint64_t seed)
 {
-	return XXH3_64bits_withSeed(data, len, seed);
+	if (len >= RSPAMD_FASTHASH_WIDE_THRESHOLD) {
+		return fasthash_dispatch.wide_fn(data, len, seed);
+	}
+
+	return fasthash_dispatch.short_fn(data, len, seed);
 }
 
 static inline uint64_t
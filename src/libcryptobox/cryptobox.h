@@ -61,6 +61,7 @@ struct rspamd_cryptobox_segment {
 #define CPUID_SSE41 0x20
 #define CPUID_SSE42 0x40
 #define CPUID_RDRAND 0x80
+#define CPUID_AVX512F 0x100
 
 typedef unsigned char rspamd_pk_t[rspamd_cryptobox_MAX_PKBYTES];
 typedef unsigned char rspamd_sk_t[rspamd_cryptobox_MAX_SKBYTES];
@@ -77,6 +78,7 @@ struct rspamd_cryptobox_library_ctx {
 	char *cpu_extensions;
 	const char *chacha20_impl;
 	const char *base64_impl;
+	const char *fasthash_impl;
 	unsigned long cpu_config;
 };
 
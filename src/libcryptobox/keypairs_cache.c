@@ -17,54 +17,87 @@
 #include "keypairs_cache.h"
 #include "keypair_private.h"
 #include "libutil/util.h"
-#include "hash.h"
+
+/*
+ * The cache is a fixed-size cuckoo table with two candidate slots per key
+ * taken from the two halves of the 64 bit pair hash. Lookups are merely two
+ * probes with no allocation and no LRU bookkeeping, which matters for
+ * HTTPCrypt connection setup under burst load. Reclamation of evicted
+ * entries is handled by the nm refcount: connections that still use a
+ * shared key keep it alive after it has left the table.
+ */
+
+#define RSPAMD_KEYPAIR_CACHE_MAX_KICKS 8
 
 struct rspamd_keypair_elt {
+	/* NULL designates an empty slot */
 	struct rspamd_cryptobox_nm *nm;
 	unsigned char pair[rspamd_cryptobox_HASHBYTES * 2];
 };
 
 struct rspamd_keypair_cache {
-	rspamd_lru_hash_t *hash;
+	struct rspamd_keypair_elt *slots;
+	unsigned int nslots;
 };
 
-static void
-rspamd_keypair_destroy(gpointer ptr)
+static inline void
+rspamd_keypair_cache_slots(const struct rspamd_keypair_cache *c,
+						   const unsigned char *pair,
+						   unsigned int *h1, unsigned int *h2)
 {
-	struct rspamd_keypair_elt *elt = (struct rspamd_keypair_elt *) ptr;
+	uint64_t h;
 
-	REF_RELEASE(elt->nm);
-	g_free(elt);
+	h = rspamd_cryptobox_fast_hash(pair, rspamd_cryptobox_HASHBYTES * 2,
+								   rspamd_hash_seed());
+	*h1 = h & (c->nslots - 1);
+	*h2 = (h >> 32) & (c->nslots - 1);
 }
 
-static unsigned int
-rspamd_keypair_hash(gconstpointer ptr)
+static void
+rspamd_keypair_cache_store(struct rspamd_keypair_cache *c,
+						   const struct rspamd_keypair_elt *elt)
 {
-	struct rspamd_keypair_elt *elt = (struct rspamd_keypair_elt *) ptr;
+	struct rspamd_keypair_elt cur = *elt, tmp;
+	unsigned int i, h1, h2, victim;
 
-	return rspamd_cryptobox_fast_hash(elt->pair, sizeof(elt->pair),
-									  rspamd_hash_seed());
-}
+	for (i = 0; i < RSPAMD_KEYPAIR_CACHE_MAX_KICKS; i++) {
+		rspamd_keypair_cache_slots(c, cur.pair, &h1, &h2);
 
-static gboolean
-rspamd_keypair_equal(gconstpointer p1, gconstpointer p2)
-{
-	struct rspamd_keypair_elt *e1 = (struct rspamd_keypair_elt *) p1,
-							  *e2 = (struct rspamd_keypair_elt *) p2;
+		if (c->slots[h1].nm == NULL) {
+			c->slots[h1] = cur;
+			return;
+		}
+		if (c->slots[h2].nm == NULL) {
+			c->slots[h2] = cur;
+			return;
+		}
 
-	return memcmp(e1->pair, e2->pair, sizeof(e1->pair)) == 0;
+		/* Displace an occupant, alternating buckets to make progress */
+		victim = (i & 1) ? h2 : h1;
+		tmp = c->slots[victim];
+		c->slots[victim] = cur;
+		cur = tmp;
+	}
+
+	/* Both chains are dense, the last displaced entry is evicted */
+	REF_RELEASE(cur.nm);
 }
 
 struct rspamd_keypair_cache *
 rspamd_keypair_cache_new(unsigned int max_items)
 {
 	struct rspamd_keypair_cache *c;
+	unsigned int nslots = 2;
 
 	g_assert(max_items > 0);
 
+	while (nslots < max_items) {
+		nslots *= 2;
+	}
+
 	c = g_malloc0(sizeof(*c));
-	c->hash = rspamd_lru_hash_new_full(max_items, NULL,
-									   rspamd_keypair_destroy, rspamd_keypair_hash, rspamd_keypair_equal);
+	c->nslots = nslots;
+	c->slots = g_malloc0(sizeof(*c->slots) * nslots);
 
 	return c;
 }
@@ -73,58 +106,72 @@ void rspamd_keypair_cache_process(struct rspamd_keypair_cache *c,
 								  struct rspamd_cryptobox_keypair *lk,
 								  struct rspamd_cryptobox_pubkey *rk)
 {
-	struct rspamd_keypair_elt search, *new;
+	struct rspamd_keypair_elt elt, *found = NULL;
+	unsigned int h1, h2;
 
 	g_assert(lk != NULL);
 	g_assert(rk != NULL);
 	g_assert(rk->type == lk->type);
 	g_assert(rk->type == RSPAMD_KEYPAIR_KEX);
 
-	memset(&search, 0, sizeof(search));
-	memcpy(search.pair, rk->id, rspamd_cryptobox_HASHBYTES);
-	memcpy(&search.pair[rspamd_cryptobox_HASHBYTES], lk->id,
+	memcpy(elt.pair, rk->id, rspamd_cryptobox_HASHBYTES);
+	memcpy(&elt.pair[rspamd_cryptobox_HASHBYTES], lk->id,
 		   rspamd_cryptobox_HASHBYTES);
-	new = rspamd_lru_hash_lookup(c->hash, &search, time(NULL));
+	rspamd_keypair_cache_slots(c, elt.pair, &h1, &h2);
+
+	if (c->slots[h1].nm != NULL &&
+		memcmp(c->slots[h1].pair, elt.pair, sizeof(elt.pair)) == 0) {
+		found = &c->slots[h1];
+	}
+	else if (c->slots[h2].nm != NULL &&
+			 memcmp(c->slots[h2].pair, elt.pair, sizeof(elt.pair)) == 0) {
+		found = &c->slots[h2];
+	}
 
 	if (rk->nm) {
 		REF_RELEASE(rk->nm);
 		rk->nm = NULL;
 	}
 
-	if (new == NULL) {
-		new = g_malloc0(sizeof(*new));
-
-		if (posix_memalign((void **) &new->nm, 32, sizeof(*new->nm)) != 0) {
+	if (found == NULL) {
+		if (posix_memalign((void **) &elt.nm, 32, sizeof(*elt.nm)) != 0) {
 			abort();
 		}
 
-		REF_INIT_RETAIN(new->nm, rspamd_cryptobox_nm_dtor);
-
-		memcpy(new->pair, rk->id, rspamd_cryptobox_HASHBYTES);
-		memcpy(&new->pair[rspamd_cryptobox_HASHBYTES], lk->id,
-			   rspamd_cryptobox_HASHBYTES);
-		memcpy(&new->nm->sk_id, lk->id, sizeof(uint64_t));
+		REF_INIT_RETAIN(elt.nm, rspamd_cryptobox_nm_dtor);
+		memcpy(&elt.nm->sk_id, lk->id, sizeof(uint64_t));
 
 		struct rspamd_cryptobox_pubkey_25519 *rk_25519 =
 			RSPAMD_CRYPTOBOX_PUBKEY_25519(rk);
 		struct rspamd_cryptobox_keypair_25519 *sk_25519 =
 			RSPAMD_CRYPTOBOX_KEYPAIR_25519(lk);
 
-		rspamd_cryptobox_nm(new->nm->nm, rk_25519->pk, sk_25519->sk);
+		rspamd_cryptobox_nm(elt.nm->nm, rk_25519->pk, sk_25519->sk);
 
-		rspamd_lru_hash_insert(c->hash, new, new, time(NULL), -1);
-	}
+		rk->nm = elt.nm;
+		REF_RETAIN(rk->nm);
 
-	g_assert(new != NULL);
-
-	rk->nm = new->nm;
-	REF_RETAIN(rk->nm);
+		/* The table keeps its own reference whilst the entry is resident */
+		rspamd_keypair_cache_store(c, &elt);
+	}
+	else {
+		rk->nm = found->nm;
+		REF_RETAIN(rk->nm);
+	}
 }
 
 void rspamd_keypair_cache_destroy(struct rspamd_keypair_cache *c)
 {
+	unsigned int i;
+
 	if (c != NULL) {
-		rspamd_lru_hash_destroy(c->hash);
+		for (i = 0; i < c->nslots; i++) {
+			if (c->slots[i].nm != NULL) {
+				REF_RELEASE(c->slots[i].nm);
+			}
+		}
+
+		g_free(c->slots);
 		g_free(c);
 	}
 }
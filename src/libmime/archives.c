@@ -19,6 +19,7 @@
 #include "task.h"
 #include "archives.h"
 #include "libmime/mime_encoding.h"
+#include "libmime/mime_parser.h"
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 #include <unicode/utf16.h>
@@ -169,6 +170,25 @@ rspamd_archive_file_try_utf(struct rspamd_task *task,
 	return true;
 }
 
+static gboolean
+rspamd_archive_file_list_overflow(struct rspamd_task *task,
+								  struct rspamd_archive *arch)
+{
+	if (task->cfg && task->cfg->max_archive_files > 0 &&
+		arch->files->len >= task->cfg->max_archive_files) {
+		if (!(arch->flags & RSPAMD_ARCHIVE_TRUNCATED)) {
+			msg_info_task("stop listing %s archive after %ud files (limit reached)",
+						  rspamd_archive_type_str(arch->type),
+						  arch->files->len);
+			arch->flags |= RSPAMD_ARCHIVE_TRUNCATED;
+		}
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 static void
 rspamd_archive_process_zip(struct rspamd_task *task,
 						   struct rspamd_mime_part *part)
@@ -253,6 +273,10 @@ rspamd_archive_process_zip(struct rspamd_task *task,
 	while (cd < start + cd_offset + cd_size) {
 		uint16_t flags;
 
+		if (rspamd_archive_file_list_overflow(task, arch)) {
+			break;
+		}
+
 		/* Read central directory record */
 		if (eocd - cd < cd_basic_len ||
 			memcmp(cd, cd_magic, sizeof(cd_magic)) != 0) {
@@ -449,6 +473,10 @@ rspamd_archive_process_rar_v4(struct rspamd_task *task, const unsigned char *sta
 								  arch);
 
 	while (p < end) {
+		if (rspamd_archive_file_list_overflow(task, arch)) {
+			goto end;
+		}
+
 		/* Crc16 */
 		start_section = p;
 		RAR_SKIP_BYTES(sizeof(uint16_t));
@@ -660,6 +688,11 @@ rspamd_archive_process_rar(struct rspamd_task *task,
 
 	while (p < end) {
 		gboolean has_extra = FALSE;
+
+		if (rspamd_archive_file_list_overflow(task, arch)) {
+			goto end;
+		}
+
 		/* Read the next header */
 		/* Crc 32 */
 		RAR_SKIP_BYTES(sizeof(uint32_t));
@@ -1590,6 +1623,11 @@ rspamd_7zip_read_files_info(struct rspamd_task *task,
 			}
 			else {
 				for (i = 0; i < nfiles; i++) {
+					if (rspamd_archive_file_list_overflow(task, arch)) {
+						p = NULL;
+						goto end;
+					}
+
 					/* Zero terminated wchar_t: happy converting... */
 					/* First, find terminator */
 					const unsigned char *fend = NULL, *tp = p;
@@ -1683,6 +1721,10 @@ rspamd_7zip_read_next_section(struct rspamd_task *task,
 			struct archive_entry *ae;
 
 			while (archive_read_next_header(a, &ae) == ARCHIVE_OK) {
+				if (rspamd_archive_file_list_overflow(task, arch)) {
+					break;
+				}
+
 				const char *name = archive_entry_pathname_utf8(ae);
 				if (name) {
 					msg_debug_archive("7zip: found file %s", name);
@@ -1951,7 +1993,22 @@ set:
 }
 
 static gboolean
-rspamd_archive_cheat_detect(struct rspamd_mime_part *part, const char *str,
+rspamd_archive_magic_matches(struct rspamd_task *task,
+							 struct rspamd_mime_part *part,
+							 const unsigned char *magic_start, gsize magic_len)
+{
+	unsigned char buf[64];
+	gsize r;
+
+	/* Peek merely the head of the part to avoid decoding the whole content */
+	r = rspamd_mime_part_peek_parsed_data(task, part, buf, sizeof(buf));
+
+	return r > magic_len && memcmp(buf, magic_start, magic_len) == 0;
+}
+
+static gboolean
+rspamd_archive_cheat_detect(struct rspamd_task *task,
+							struct rspamd_mime_part *part, const char *str,
 							const unsigned char *magic_start, gsize magic_len)
 {
 	struct rspamd_content_type *ct;
@@ -1966,9 +2023,8 @@ rspamd_archive_cheat_detect(struct rspamd_mime_part *part, const char *str,
 											 str, strlen(str)) != -1) {
 			/* We still need to check magic, see #1848 */
 			if (magic_start != NULL) {
-				if (part->parsed_data.len > magic_len &&
-					memcmp(part->parsed_data.begin,
-						   magic_start, magic_len) == 0) {
+				if (rspamd_archive_magic_matches(task, part,
+												 magic_start, magic_len)) {
 					return TRUE;
 				}
 				/* No magic, refuse this type of archive */
@@ -1989,9 +2045,8 @@ rspamd_archive_cheat_detect(struct rspamd_mime_part *part, const char *str,
 			if (rspamd_lc_cmp(p, str, strlen(str)) == 0) {
 				if (*(p - 1) == '.') {
 					if (magic_start != NULL) {
-						if (part->parsed_data.len > magic_len &&
-							memcmp(part->parsed_data.begin,
-								   magic_start, magic_len) == 0) {
+						if (rspamd_archive_magic_matches(task, part,
+														 magic_start, magic_len)) {
 							return TRUE;
 						}
 						/* No magic, refuse this type of archive */
@@ -2004,16 +2059,14 @@ rspamd_archive_cheat_detect(struct rspamd_mime_part *part, const char *str,
 		}
 
 		if (magic_start != NULL) {
-			if (part->parsed_data.len > magic_len &&
-				memcmp(part->parsed_data.begin, magic_start, magic_len) == 0) {
+			if (rspamd_archive_magic_matches(task, part, magic_start, magic_len)) {
 				return TRUE;
 			}
 		}
 	}
 	else {
 		if (magic_start != NULL) {
-			if (part->parsed_data.len > magic_len &&
-				memcmp(part->parsed_data.begin, magic_start, magic_len) == 0) {
+			if (rspamd_archive_magic_matches(task, part, magic_start, magic_len)) {
 				return TRUE;
 			}
 		}
@@ -2034,21 +2087,26 @@ void rspamd_archives_process(struct rspamd_task *task)
 	PTR_ARRAY_FOREACH(MESSAGE_FIELD(task, parts), i, part)
 	{
 		if (part->part_type == RSPAMD_MIME_PART_UNDEFINED) {
-			if (part->parsed_data.len > 0) {
-				if (rspamd_archive_cheat_detect(part, "zip",
-												zip_magic, sizeof(zip_magic))) {
+			if (part->parsed_data.len > 0 ||
+				(part->flags & RSPAMD_MIME_PART_LAZY_DECODE)) {
+				if (rspamd_archive_cheat_detect(task, part, "zip",
+												zip_magic, sizeof(zip_magic)) &&
+					rspamd_mime_part_ensure_parsed_data(task, part)) {
 					rspamd_archive_process_zip(task, part);
 				}
-				else if (rspamd_archive_cheat_detect(part, "rar",
-													 rar_magic, sizeof(rar_magic))) {
+				else if (rspamd_archive_cheat_detect(task, part, "rar",
+													 rar_magic, sizeof(rar_magic)) &&
+						 rspamd_mime_part_ensure_parsed_data(task, part)) {
 					rspamd_archive_process_rar(task, part);
 				}
-				else if (rspamd_archive_cheat_detect(part, "7z",
-													 sz_magic, sizeof(sz_magic))) {
+				else if (rspamd_archive_cheat_detect(task, part, "7z",
+													 sz_magic, sizeof(sz_magic)) &&
+						 rspamd_mime_part_ensure_parsed_data(task, part)) {
 					rspamd_archive_process_7zip(task, part);
 				}
-				else if (rspamd_archive_cheat_detect(part, "gz",
-													 gz_magic, sizeof(gz_magic))) {
+				else if (rspamd_archive_cheat_detect(task, part, "gz",
+													 gz_magic, sizeof(gz_magic)) &&
+						 rspamd_mime_part_ensure_parsed_data(task, part)) {
 					rspamd_archive_process_gzip(task, part);
 				}
 
@@ -742,55 +742,9 @@ rspamd_content_type_parse(const char *in,
 				res->flags |= RSPAMD_CONTENT_TYPE_BROKEN;
 				RSPAMD_FTOK_ASSIGN(&res->subtype, "alternative");
 			}
-
-			/* PKCS7 smime */
-			RSPAMD_FTOK_ASSIGN(&srch, "pkcs7-mime");
-			if (rspamd_substring_search(res->subtype.begin, res->subtype.len,
-										srch.begin, srch.len) != -1) {
-				res->flags |= RSPAMD_CONTENT_TYPE_SMIME;
-			}
 		}
 
-		RSPAMD_FTOK_ASSIGN(&srch, "multipart");
-
-		if (rspamd_ftok_casecmp(&res->type, &srch) == 0) {
-			res->flags |= RSPAMD_CONTENT_TYPE_MULTIPART;
-
-			RSPAMD_FTOK_ASSIGN(&srch, "encrypted");
-			if (rspamd_ftok_casecmp(&res->subtype, &srch) == 0) {
-				res->flags |= RSPAMD_CONTENT_TYPE_ENCRYPTED;
-			}
-		}
-		else {
-			RSPAMD_FTOK_ASSIGN(&srch, "text");
-
-			if (rspamd_ftok_casecmp(&res->type, &srch) == 0) {
-				res->flags |= RSPAMD_CONTENT_TYPE_TEXT;
-			}
-			else {
-				RSPAMD_FTOK_ASSIGN(&srch, "message");
-
-				if (rspamd_ftok_casecmp(&res->type, &srch) == 0) {
-					RSPAMD_FTOK_ASSIGN(&srch, "delivery-status");
-
-					if (rspamd_ftok_casecmp(&res->subtype, &srch) == 0) {
-						res->flags |= RSPAMD_CONTENT_TYPE_TEXT | RSPAMD_CONTENT_TYPE_DSN;
-					}
-					else {
-						RSPAMD_FTOK_ASSIGN(&srch, "notification");
-
-						if (rspamd_substring_search_caseless(res->subtype.begin,
-															 res->subtype.len, srch.begin, srch.len) != -1) {
-							res->flags |= RSPAMD_CONTENT_TYPE_TEXT |
-										  RSPAMD_CONTENT_TYPE_DSN;
-						}
-						else {
-							res->flags |= RSPAMD_CONTENT_TYPE_MESSAGE;
-						}
-					}
-				}
-			}
-		}
+		res->flags |= rspamd_content_type_classify(&res->type, &res->subtype);
 	}
 	else {
 		msg_warn_pool("cannot parse content type: %*s", (int) len, cpy);
@@ -98,6 +98,16 @@ void rspamd_content_type_add_param(rspamd_mempool_t *pool,
 struct rspamd_content_type *rspamd_content_type_parse(const char *in,
 													  gsize len, rspamd_mempool_t *pool);
 
+/**
+ * Classify a lowercased type/subtype pair (e.g. multipart, text or DSN
+ * detection); does not deal with broken content type fixups
+ * @param type
+ * @param subtype
+ * @return combination of rspamd_content_type_flags to be added to a content type
+ */
+unsigned int rspamd_content_type_classify(const rspamd_ftok_t *type,
+										  const rspamd_ftok_t *subtype);
+
 /**
  * Adds new param for content disposition header
  * @param pool
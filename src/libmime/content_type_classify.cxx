@@ -0,0 +1,85 @@
+/*
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "libmime/content_type.h"
+
+#include "contrib/frozen/include/frozen/unordered_map.h"
+#include "contrib/frozen/include/frozen/string.h"
+
+#include <string_view>
+
+namespace rspamd::mime {
+
+enum class ct_type_class {
+	multipart,
+	text,
+	message,
+};
+
+/*
+ * Type and subtype come from the parser already lowercased, so a single
+ * constexpr perfect hash probe replaces the former chain of case
+ * insensitive comparisons performed for every part of every message
+ */
+constexpr auto ct_type_map = frozen::make_unordered_map<frozen::string, ct_type_class>({
+	{"multipart", ct_type_class::multipart},
+	{"text", ct_type_class::text},
+	{"message", ct_type_class::message},
+});
+
+}// namespace rspamd::mime
+
+unsigned int rspamd_content_type_classify(const rspamd_ftok_t *type,
+										  const rspamd_ftok_t *subtype)
+{
+	using namespace rspamd::mime;
+	unsigned int flags = 0;
+	auto sub = subtype->len > 0 ? std::string_view{subtype->begin, subtype->len}
+								: std::string_view{};
+
+	/* PKCS7 smime */
+	if (sub.find("pkcs7-mime") != std::string_view::npos) {
+		flags |= RSPAMD_CONTENT_TYPE_SMIME;
+	}
+
+	auto it = ct_type_map.find(frozen::string{type->begin, type->len});
+
+	if (it != ct_type_map.end()) {
+		switch (it->second) {
+		case ct_type_class::multipart:
+			flags |= RSPAMD_CONTENT_TYPE_MULTIPART;
+
+			if (sub == "encrypted") {
+				flags |= RSPAMD_CONTENT_TYPE_ENCRYPTED;
+			}
+			break;
+		case ct_type_class::text:
+			flags |= RSPAMD_CONTENT_TYPE_TEXT;
+			break;
+		case ct_type_class::message:
+			if (sub == "delivery-status" ||
+				sub.find("notification") != std::string_view::npos) {
+				flags |= RSPAMD_CONTENT_TYPE_TEXT | RSPAMD_CONTENT_TYPE_DSN;
+			}
+			else {
+				flags |= RSPAMD_CONTENT_TYPE_MESSAGE;
+			}
+			break;
+		}
+	}
+
+	return flags;
+}
@@ -20,6 +20,63 @@
 #include "printf.h"
 #include "smtp_parsers.h"
 
+/*
+ * Character classes of the parsing states below; a single table lookup
+ * replaces the per-state branch chains on the hot path, as To/Cc headers
+ * with hundreds of recipients are fairly common
+ */
+enum {
+	RSPAMD_EADDR_CLASS_NAME = (1 << 0),    /* terminates a display name run */
+	RSPAMD_EADDR_CLASS_QUOTED = (1 << 1),  /* significant inside quoted strings */
+	RSPAMD_EADDR_CLASS_ADDR = (1 << 2),    /* significant inside angled addr */
+	RSPAMD_EADDR_CLASS_COMMENT = (1 << 3), /* significant for the comments strip pass */
+};
+
+static const unsigned char eaddr_class[256] = {
+	['"'] = RSPAMD_EADDR_CLASS_NAME | RSPAMD_EADDR_CLASS_QUOTED |
+			RSPAMD_EADDR_CLASS_COMMENT,
+	['<'] = RSPAMD_EADDR_CLASS_NAME | RSPAMD_EADDR_CLASS_QUOTED,
+	[','] = RSPAMD_EADDR_CLASS_NAME,
+	['@'] = RSPAMD_EADDR_CLASS_NAME | RSPAMD_EADDR_CLASS_QUOTED |
+			RSPAMD_EADDR_CLASS_ADDR,
+	['>'] = RSPAMD_EADDR_CLASS_ADDR,
+	['\\'] = RSPAMD_EADDR_CLASS_QUOTED | RSPAMD_EADDR_CLASS_COMMENT,
+	['('] = RSPAMD_EADDR_CLASS_COMMENT,
+	[')'] = RSPAMD_EADDR_CLASS_COMMENT,
+};
+
+/*
+ * Returns a pointer to the next character significant for the classes given,
+ * or `end`; insignificant runs are traversed four bytes per iteration
+ */
+static inline const char *
+rspamd_email_address_skip_plain(const char *p, const char *end,
+								unsigned char cls)
+{
+	while (p + 4 <= end) {
+		if (eaddr_class[(unsigned char) p[0]] & cls) {
+			return p;
+		}
+		if (eaddr_class[(unsigned char) p[1]] & cls) {
+			return p + 1;
+		}
+		if (eaddr_class[(unsigned char) p[2]] & cls) {
+			return p + 2;
+		}
+		if (eaddr_class[(unsigned char) p[3]] & cls) {
+			return p + 3;
+		}
+
+		p += 4;
+	}
+
+	while (p < end && !(eaddr_class[(unsigned char) *p] & cls)) {
+		p++;
+	}
+
+	return p;
+}
+
 static void
 rspamd_email_address_unescape(struct rspamd_email_address *addr)
 {
@@ -95,7 +152,9 @@ void rspamd_email_address_free(struct rspamd_email_address *addr)
 			g_free((void *) addr->user);
 		}
 
-		g_free(addr);
+		if (!(addr->flags & RSPAMD_EMAIL_ADDR_POOL_ALLOCATED)) {
+			g_free(addr);
+		}
 	}
 }
 
@@ -108,8 +167,8 @@ rspamd_email_address_add(rspamd_mempool_t *pool,
 	struct rspamd_email_address *elt;
 	unsigned int nlen;
 
-	elt = g_malloc0(sizeof(*elt));
-	rspamd_mempool_notify_alloc(pool, sizeof(*elt));
+	/* Addresses are allocated from the task arena and die with it */
+	elt = rspamd_mempool_alloc0(pool, sizeof(*elt));
 
 	if (addr != NULL) {
 		memcpy(elt, addr, sizeof(*addr));
@@ -123,6 +182,8 @@ rspamd_email_address_add(rspamd_mempool_t *pool,
 		elt->flags |= RSPAMD_EMAIL_ADDR_EMPTY;
 	}
 
+	elt->flags |= RSPAMD_EMAIL_ADDR_POOL_ALLOCATED;
+
 	if ((elt->flags & RSPAMD_EMAIL_ADDR_QUOTED) && elt->addr[0] == '"') {
 		if (elt->flags & RSPAMD_EMAIL_ADDR_HAS_BACKSLASH) {
 			/* We also need to unquote user */
@@ -282,6 +343,22 @@ rspamd_email_address_from_mime(rspamd_mempool_t *pool, const char *hdr,
 
 	while (p < end) {
 		if (state == parse_name) {
+			/* Bulk copy (or skip within a comment) the insignificant run */
+			t = rspamd_email_address_skip_plain(p, end,
+												RSPAMD_EADDR_CLASS_COMMENT);
+
+			if (t > p) {
+				if (obraces == 0) {
+					g_string_append_len(cpy, p, t - p);
+				}
+
+				p = t;
+
+				if (p == end) {
+					break;
+				}
+			}
+
 			if (*p == '\\') {
 				if (obraces == 0) {
 					g_string_append_c(cpy, *p);
@@ -312,6 +389,18 @@ rspamd_email_address_from_mime(rspamd_mempool_t *pool, const char *hdr,
 			}
 		}
 		else {
+			t = rspamd_email_address_skip_plain(p, end,
+												RSPAMD_EADDR_CLASS_COMMENT);
+
+			if (t > p) {
+				g_string_append_len(cpy, p, t - p);
+				p = t;
+
+				if (p == end) {
+					break;
+				}
+			}
+
 			/* Quoted elt */
 			if (*p == '\\') {
 				g_string_append_c(cpy, *p);
@@ -340,6 +429,13 @@ rspamd_email_address_from_mime(rspamd_mempool_t *pool, const char *hdr,
 	while (p < end) {
 		switch (state) {
 		case parse_name:
+			if (!(eaddr_class[(unsigned char) *p] & RSPAMD_EADDR_CLASS_NAME)) {
+				/* The name span is accumulated from `c`, merely advance */
+				p = rspamd_email_address_skip_plain(p, end,
+													RSPAMD_EADDR_CLASS_NAME);
+				break;
+			}
+
 			if (*p == '"') {
 				/* We need to strip last spaces and update `ns` */
 				if (p > c) {
@@ -414,6 +510,12 @@ rspamd_email_address_from_mime(rspamd_mempool_t *pool, const char *hdr,
 			p++;
 			break;
 		case parse_quoted:
+			if (!(eaddr_class[(unsigned char) *p] & RSPAMD_EADDR_CLASS_QUOTED)) {
+				p = rspamd_email_address_skip_plain(p, end,
+													RSPAMD_EADDR_CLASS_QUOTED);
+				break;
+			}
+
 			if (*p == '\\') {
 				if (p > c) {
 					g_string_append_len(ns, c, p - c);
@@ -443,6 +545,12 @@ rspamd_email_address_from_mime(rspamd_mempool_t *pool, const char *hdr,
 			p++;
 			break;
 		case parse_addr:
+			if (!(eaddr_class[(unsigned char) *p] & RSPAMD_EADDR_CLASS_ADDR)) {
+				p = rspamd_email_address_skip_plain(p, end,
+													RSPAMD_EADDR_CLASS_ADDR);
+				break;
+			}
+
 			if (*p == '>') {
 				int check = rspamd_email_address_check_and_add(c, p - c + 1,
 															   res, pool, ns, max_elements);
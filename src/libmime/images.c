@@ -17,6 +17,7 @@
 #include "images.h"
 #include "task.h"
 #include "message.h"
+#include "mime_parser.h"
 #include "libserver/html/html.h"
 
 #define msg_debug_images(...) rspamd_conditional_debug_fast(NULL, NULL,                                               \
@@ -32,6 +33,8 @@ INIT_LOG_MODULE(images)
 #include <math.h>
 
 #define RSPAMD_NORMALIZED_DIM 64
+/* Images with larger dimensions are not decoded at all (decompression bombs) */
+#define RSPAMD_IMAGE_MAX_DIM 8192
 
 static rspamd_lru_hash_t *images_hash = NULL;
 #endif
@@ -52,7 +55,7 @@ bool rspamd_images_process_mime_part_maybe(struct rspamd_task *task,
 	if (part->part_type == RSPAMD_MIME_PART_UNDEFINED) {
 		if (part->detected_type &&
 			strcmp(part->detected_type, "image") == 0 &&
-			part->parsed_data.len > 0) {
+			rspamd_mime_part_ensure_parsed_data(task, part)) {
 
 			return process_image(task, part);
 		}
@@ -459,6 +462,15 @@ void rspamd_image_normalize(struct rspamd_task *task, struct rspamd_image *img)
 		return;
 	}
 
+	if (img->height > RSPAMD_IMAGE_MAX_DIM || img->width > RSPAMD_IMAGE_MAX_DIM) {
+		/* Dimensions are sniffed from the header, so no decoding happened yet */
+		msg_info_task("skip normalisation for image %T: dimensions %ud x %ud "
+					  "are larger than %d",
+					  img->filename, img->width, img->height,
+					  RSPAMD_IMAGE_MAX_DIM);
+		return;
+	}
+
 	if (img->data->len > task->cfg->max_pic_size) {
 		return;
 	}
@@ -518,19 +530,28 @@ void rspamd_image_normalize(struct rspamd_task *task, struct rspamd_image *img)
 		 * So on each iteration we move by 16 pixels and calculate 2 elements of
 		 * signature
 		 */
+		/*
+		 * All indices are within the normalised 64x64 image, so pixels can
+		 * be gathered via the unchecked gd accessors, avoiding a function
+		 * call with bounds checks per pixel
+		 */
+		int truecolor = gdImageTrueColor(dst);
+
 		for (i = 0; i < RSPAMD_NORMALIZED_DIM; i += 8) {
 			for (j = 0; j < RSPAMD_NORMALIZED_DIM; j += 8) {
 				int p[8][8];
 
 				for (k = 0; k < 8; k++) {
-					p[k][0] = gdImageGetPixel(dst, i + k, j);
-					p[k][1] = gdImageGetPixel(dst, i + k, j + 1);
-					p[k][2] = gdImageGetPixel(dst, i + k, j + 2);
-					p[k][3] = gdImageGetPixel(dst, i + k, j + 3);
-					p[k][4] = gdImageGetPixel(dst, i + k, j + 4);
-					p[k][5] = gdImageGetPixel(dst, i + k, j + 5);
-					p[k][6] = gdImageGetPixel(dst, i + k, j + 6);
-					p[k][7] = gdImageGetPixel(dst, i + k, j + 7);
+					if (truecolor) {
+						for (l = 0; l < 8; l++) {
+							p[k][l] = gdImageTrueColorPixel(dst, i + k, j + l);
+						}
+					}
+					else {
+						for (l = 0; l < 8; l++) {
+							p[k][l] = gdImagePalettePixel(dst, i + k, j + l);
+						}
+					}
 				}
 
 				rspamd_image_dct_block(p,
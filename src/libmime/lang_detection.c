@@ -17,6 +17,7 @@
 #include "lang_detection.h"
 #include "lang_detection_fasttext.h"
 #include "libserver/logger.h"
+#include "libutil/hash.h"
 #include "libcryptobox/cryptobox.h"
 #include "libutil/multipattern.h"
 #include "ucl.h"
@@ -80,6 +81,7 @@ enum rspamd_language_category {
 
 struct rspamd_language_elt {
 	const char *name; /* e.g. "en" or "ru" */
+	unsigned int id;  /* sequential id used to index per-task scoring arrays */
 	int flags;        /* enum rspamd_language_elt_flags */
 	enum rspamd_language_category category;
 	unsigned int trigrams_words;
@@ -691,6 +693,7 @@ rspamd_language_detector_read_file(struct rspamd_config *cfg,
 						   rspamd_language_detector_print_flags(nelt));
 
 	int ret;
+	nelt->id = kh_size(d->languages);
 	khiter_t k = kh_put(rspamd_languages_hash, d->languages, nelt->name, &ret);
 	g_assert(ret > 0); /* must be unique */
 	kh_value(d->languages, k) = nelt;
@@ -1079,6 +1082,7 @@ rspamd_language_detector_process_ngramm_full(struct rspamd_task *task,
 											 struct rspamd_lang_detector *d,
 											 UChar32 *window,
 											 khash_t(rspamd_candidates_hash) * candidates,
+											 struct rspamd_lang_detector_res **cand_cache,
 											 khash_t(rspamd_trigram_hash) * trigrams)
 {
 	unsigned int i;
@@ -1103,13 +1107,12 @@ rspamd_language_detector_process_ngramm_full(struct rspamd_task *task,
 				continue;
 			}
 
-			k = kh_get(rspamd_candidates_hash, candidates, elt->elt->name);
-			if (k != kh_end(candidates)) {
-				cand = kh_value(candidates, k);
-			}
-			else {
-				cand = NULL;
-			}
+			/*
+			 * Candidates are updated once per language per trigram, so we
+			 * resolve them via a flat array indexed by the language id
+			 * instead of hashing the language name for every update
+			 */
+			cand = cand_cache[elt->elt->id];
 
 #ifdef NGRAMMS_DEBUG
 			msg_err("gramm: %s, lang: %s, prob: %.3f", chain->utf,
@@ -1124,6 +1127,7 @@ rspamd_language_detector_process_ngramm_full(struct rspamd_task *task,
 				k = kh_put(rspamd_candidates_hash, candidates, elt->elt->name,
 						   &ret);
 				kh_value(candidates, k) = cand;
+				cand_cache[elt->elt->id] = cand;
 			}
 			else {
 				/* Update guess */
@@ -1138,6 +1142,7 @@ rspamd_language_detector_detect_word(struct rspamd_task *task,
 									 struct rspamd_lang_detector *d,
 									 rspamd_stat_token_t *tok,
 									 khash_t(rspamd_candidates_hash) * candidates,
+									 struct rspamd_lang_detector_res **cand_cache,
 									 khash_t(rspamd_trigram_hash) * trigrams)
 {
 	const unsigned int wlen = 3;
@@ -1147,7 +1152,7 @@ rspamd_language_detector_detect_word(struct rspamd_task *task,
 	/* Split words */
 	while ((cur = rspamd_language_detector_next_ngramm(tok, window, wlen, cur)) != -1) {
 		rspamd_language_detector_process_ngramm_full(task,
-													 d, window, candidates, trigrams);
+													 d, window, candidates, cand_cache, trigrams);
 	}
 }
 
@@ -1230,6 +1235,7 @@ rspamd_language_detector_detect_type(struct rspamd_task *task,
 {
 	unsigned int nparts = MIN(words->len, nwords);
 	goffset *selected_words;
+	struct rspamd_lang_detector_res **cand_cache;
 	rspamd_stat_token_t *tok;
 	unsigned int i;
 	uint64_t seed;
@@ -1240,18 +1246,23 @@ rspamd_language_detector_detect_type(struct rspamd_task *task,
 	rspamd_language_detector_random_select(words, nparts, selected_words, &seed);
 	msg_debug_lang_det("randomly selected %d words", nparts);
 
+	/* Scratch array to resolve candidates by language id within the hot loop */
+	cand_cache = g_new0(struct rspamd_lang_detector_res *,
+						kh_size(d->languages));
+
 	for (i = 0; i < nparts; i++) {
 		tok = &g_array_index(words, rspamd_stat_token_t,
 							 selected_words[i]);
 
 		if (tok->unicode.len >= 3) {
 			rspamd_language_detector_detect_word(task, d, tok, candidates,
-												 d->trigrams[cat]);
+												 cand_cache, d->trigrams[cat]);
 		}
 	}
 
 	/* Filter negligible candidates */
 	rspamd_language_detector_filter_negligible(task, candidates);
+	g_free(cand_cache);
 	g_free(selected_words);
 }
 
@@ -1524,6 +1535,49 @@ rspamd_language_detector_unicode_scripts(struct rspamd_task *task,
 	*pspecial = nspecial;
 }
 
+/*
+ * Cache of detection results keyed by text part digest: quarantine re-scans
+ * and mailing list traffic present identical bodies over and over, and the
+ * language of a part obviously cannot change between scans; workers are
+ * single threaded, hence a static cache is safe
+ */
+#define LANG_DET_CACHE_SIZE 128
+#define LANG_DET_CACHE_TTL 300
+/* How many bytes of the part digest we use as the cache key */
+#define LANG_DET_CACHE_KEYLEN 16
+
+struct rspamd_lang_cached_result {
+	char lang[16];
+};
+
+static guint
+rspamd_lang_det_cache_hash(gconstpointer p)
+{
+	return (guint) rspamd_cryptobox_fast_hash(p, LANG_DET_CACHE_KEYLEN,
+											  rspamd_hash_seed());
+}
+
+static gboolean
+rspamd_lang_det_cache_equal(gconstpointer a, gconstpointer b)
+{
+	return memcmp(a, b, LANG_DET_CACHE_KEYLEN) == 0;
+}
+
+static rspamd_lru_hash_t *
+rspamd_lang_det_cache(void)
+{
+	static rspamd_lru_hash_t *cache = NULL;
+
+	if (cache == NULL) {
+		cache = rspamd_lru_hash_new_full(LANG_DET_CACHE_SIZE,
+										 g_free, g_free,
+										 rspamd_lang_det_cache_hash,
+										 rspamd_lang_det_cache_equal);
+	}
+
+	return cache;
+}
+
 static inline void
 rspamd_language_detector_set_language(struct rspamd_task *task,
 									  struct rspamd_mime_text_part *part,
@@ -1837,6 +1891,36 @@ rspamd_language_detector_detect(struct rspamd_task *task,
 		return FALSE;
 	}
 
+	if (part->mime_part != NULL) {
+		struct rspamd_lang_cached_result *cached;
+
+		cached = rspamd_lru_hash_lookup(rspamd_lang_det_cache(),
+										part->mime_part->digest, time(NULL));
+
+		if (cached != NULL) {
+			struct rspamd_language_elt *elt = NULL;
+			const char *code;
+			khiter_t k;
+
+			/* Prefer the interned name as the cache entry can be evicted */
+			k = kh_get(rspamd_languages_hash, d->languages, cached->lang);
+
+			if (k != kh_end(d->languages)) {
+				elt = kh_value(d->languages, k);
+				code = elt->name;
+			}
+			else {
+				code = rspamd_mempool_strdup(task->task_pool, cached->lang);
+			}
+
+			rspamd_language_detector_set_language(task, part, code, elt);
+			msg_debug_lang_det("reused cached language %s for part of length %z",
+							   code, part->utf_stripped_content->len);
+
+			return TRUE;
+		}
+	}
+
 	start_ticks = rspamd_get_ticks(TRUE);
 
 	unsigned int nchinese = 0, nspecial = 0;
@@ -2076,6 +2160,18 @@ rspamd_language_detector_detect(struct rspamd_task *task,
 		}
 	}
 
+	if (ret && part->language != NULL && part->mime_part != NULL) {
+		struct rspamd_lang_cached_result *cached;
+		unsigned char *key;
+
+		cached = g_malloc0(sizeof(*cached));
+		rspamd_strlcpy(cached->lang, part->language, sizeof(cached->lang));
+		key = g_malloc(LANG_DET_CACHE_KEYLEN);
+		memcpy(key, part->mime_part->digest, LANG_DET_CACHE_KEYLEN);
+		rspamd_lru_hash_insert(rspamd_lang_det_cache(), key, cached,
+							   time(NULL), LANG_DET_CACHE_TTL);
+	}
+
 	end_ticks = rspamd_get_ticks(TRUE);
 	msg_debug_lang_det("detected languages in %.0f ticks",
 					   (end_ticks - start_ticks));
@@ -20,6 +20,7 @@
 #include "fasttext/fasttext.h"
 #include "libserver/cfg_file.h"
 #include "libserver/logger.h"
+#include "libutil/util.h"
 #include "contrib/fmt/include/fmt/base.h"
 #include "stat_api.h"
 #include <exception>
@@ -40,6 +41,7 @@ class fasttext_langdet {
 private:
 	fasttext::FastText ft;
 	std::string model_fname;
+	double load_time = 0.0; /* in seconds */
 	bool loaded = false;
 
 public:
@@ -53,9 +55,21 @@ public:
 
 			if (model) {
 				try {
+					auto load_start = rspamd_get_ticks(FALSE);
+					/* loadModel accepts both plain and quantized (.ftz) models */
 					ft.loadModel(ucl_object_tostring(model));
+					load_time = rspamd_get_ticks(FALSE) - load_start;
 					loaded = true;
 					model_fname = std::string{ucl_object_tostring(model)};
+					/*
+					 * The model matrices live on the allocator's heap, so
+					 * their hugepage residency depends on the system THP
+					 * policy; log it, so TLB behaviour can be verified
+					 */
+					msg_info_config("loaded fasttext model %s in %.2f seconds; "
+									"%Hz of the process is hugepage backed",
+									model_fname.c_str(), load_time,
+									rspamd_get_hugepages_rss());
 				} catch (std::exception &e) {
 					auto err_message = fmt::format("cannot load fasttext model: {}", e.what());
 					msg_err_config("%s", err_message.c_str());
@@ -131,8 +145,11 @@ public:
 			return not_loaded;
 		}
 		else {
-			return fmt::format("fasttext model {}: {} languages, {} tokens", model_fname,
-							   ft.getDictionary()->nlabels(), ft.getDictionary()->ntokens());
+			return fmt::format("fasttext model {}{}: {} languages, {} tokens; loaded in {:.1f}ms",
+							   model_fname,
+							   ft.isQuant() ? " (quantized)" : "",
+							   ft.getDictionary()->nlabels(), ft.getDictionary()->ntokens(),
+							   load_time * 1e3);
 		}
 	}
 };
@@ -201,7 +218,12 @@ rspamd_fasttext_predict_result_t rspamd_lang_detection_fasttext_detect(void *ud,
 
 	msg_debug_lang_det("fasttext: got %z word tokens from %ud words", words_vec.size(), utf_words->len);
 
+	auto pred_start = rspamd_get_ticks(TRUE);
 	auto *res = real_model->detect_language(words_vec, k);
+	auto pred_time = rspamd_get_ticks(TRUE) - pred_start;
+
+	msg_debug_lang_det("fasttext: predicted %z languages in %.2fms",
+					   res ? res->size() : 0, pred_time * 1e3);
 
 	return (rspamd_fasttext_predict_result_t) res;
 #endif
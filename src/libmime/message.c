@@ -56,6 +56,8 @@ static const char gtube_pattern_no_action[] = "AJS*C4JDBQADN1.NSBN3*2IDNEN*"
 											  "GTUBE-STANDARD-ANTI-UBE-TEST-EMAIL*C.34X";
 struct rspamd_multipattern *gtube_matcher = NULL;
 static const uint64_t words_hash_seed = 0xdeadbabe;
+/* Rolling per-process statistic of urls per message, used as a sizing hint */
+static struct rspamd_counter_data rspamd_message_urls_ema;
 
 static void
 free_byte_array_callback(void *pointer)
@@ -838,6 +840,17 @@ rspamd_message_part_can_be_parsed_as_text(struct rspamd_task *task,
 	return res;
 }
 
+static gboolean
+rspamd_message_mem_watermark_reached(struct rspamd_task *task)
+{
+	if (task->cfg == NULL || task->cfg->max_task_pool_size == 0) {
+		return FALSE;
+	}
+
+	return rspamd_mempool_get_used_size(task->task_pool) >
+		   task->cfg->max_task_pool_size;
+}
+
 static gboolean
 rspamd_message_process_text_part_maybe(struct rspamd_task *task,
 									   struct rspamd_mime_part *mime_part,
@@ -853,6 +866,8 @@ rspamd_message_process_text_part_maybe(struct rspamd_task *task,
 		flags |= RSPAMD_MIME_TEXT_PART_ATTACHMENT;
 	}
 
+	rspamd_mime_part_ensure_parsed_data(task, mime_part);
+
 	text_part = rspamd_mempool_alloc0(task->task_pool,
 									  sizeof(struct rspamd_mime_text_part));
 	text_part->mime_part = mime_part;
@@ -968,6 +983,7 @@ rspamd_message_from_data(struct rspamd_task *task, const unsigned char *start,
 	part->raw_data.len = len;
 	part->parsed_data.begin = start;
 	part->parsed_data.len = len;
+	part->task = task;
 	part->part_number = MESSAGE_FIELD(task, parts)->len;
 	part->urls = g_ptr_array_new();
 	part->raw_headers = rspamd_message_headers_new();
@@ -1122,6 +1138,9 @@ rspamd_message_dtor(struct rspamd_message *msg)
 	g_ptr_array_unref(msg->text_parts);
 	g_ptr_array_unref(msg->parts);
 
+	/* Feed the rolling urls count statistic used to pre-size the set */
+	rspamd_set_counter_ema(&rspamd_message_urls_ema,
+						   (float) kh_size(msg->urls), 0.1f);
 	kh_destroy(rspamd_url_hash, msg->urls);
 }
 
@@ -1134,6 +1153,20 @@ rspamd_message_new(struct rspamd_task *task)
 
 	msg->raw_headers = rspamd_message_headers_new();
 	msg->urls = kh_init(rspamd_url_hash);
+
+	if (rspamd_message_urls_ema.number > 16) {
+		/*
+		 * Pre-size the urls set for roughly the 95th percentile of the
+		 * urls count seen so far, avoiding rehashing during parsing
+		 */
+		unsigned int hint = (unsigned int) (rspamd_message_urls_ema.mean +
+											2.0f * sqrtf(rspamd_message_urls_ema.stddev));
+
+		if (hint > 4) {
+			kh_resize(rspamd_url_hash, msg->urls, hint + hint / 3);
+		}
+	}
+
 	msg->parts = g_ptr_array_sized_new(4);
 	msg->text_parts = g_ptr_array_sized_new(2);
 	msg->task = task;
@@ -1436,7 +1469,8 @@ void rspamd_message_process(struct rspamd_task *task)
 
 	PTR_ARRAY_FOREACH(MESSAGE_FIELD(task, parts), i, part)
 	{
-		if (magic_func_pos != -1 && part->parsed_data.len > 0) {
+		if (magic_func_pos != -1 &&
+			rspamd_mime_part_ensure_parsed_data(task, part)) {
 			struct rspamd_mime_part **pmime;
 			struct rspamd_task **ptask;
 
@@ -1507,8 +1541,9 @@ void rspamd_message_process(struct rspamd_task *task)
 		}
 
 		/* Now detect content */
-		if (content_func_pos != -1 && part->parsed_data.len > 0 &&
-			part->part_type == RSPAMD_MIME_PART_UNDEFINED) {
+		if (content_func_pos != -1 &&
+			part->part_type == RSPAMD_MIME_PART_UNDEFINED &&
+			rspamd_mime_part_ensure_parsed_data(task, part)) {
 			struct rspamd_mime_part **pmime;
 			struct rspamd_task **ptask;
 
@@ -1549,6 +1584,21 @@ void rspamd_message_process(struct rspamd_task *task)
 	g_array_sort(detected_text_parts, rspamd_mime_text_part_position_compare_func);
 	/* One more iteration to process text parts in a more specific order */
 	for (i = 0; i < detected_text_parts->len; i++) {
+		if (rspamd_message_mem_watermark_reached(task)) {
+			/*
+			 * Pathological messages are degraded instead of ballooning the
+			 * worker: remaining text parts are left raw (no HTML parsing and
+			 * no tokenization); the fact is recorded in the task flags
+			 */
+			task->flags |= RSPAMD_TASK_FLAG_MEM_DEGRADED;
+			msg_warn_task("task pool uses %z bytes that exceeds watermark %z; "
+						  "skip processing of %ud remaining text parts",
+						  rspamd_mempool_get_used_size(task->task_pool),
+						  task->cfg->max_task_pool_size,
+						  detected_text_parts->len - i);
+			break;
+		}
+
 		part = g_ptr_array_index(MESSAGE_FIELD(task, parts),
 								 g_array_index(detected_text_parts, struct rspamd_mime_part_text_position, i).pos);
 		rspamd_message_process_text_part_maybe(task, part,
@@ -1575,6 +1625,54 @@ void rspamd_message_process(struct rspamd_task *task)
 	double *var;
 	unsigned int total_words = 0;
 
+	/*
+	 * For 2 parts messages (the common multipart/alternative case) detect
+	 * the language on the preferred part merely and propagate it to the
+	 * other one before words are extracted: alternatives carry the same
+	 * content, so the second detection pass is redundant
+	 */
+	if (MESSAGE_FIELD(task, text_parts)->len == 2) {
+		p1 = g_ptr_array_index(MESSAGE_FIELD(task, text_parts), 0);
+		p2 = g_ptr_array_index(MESSAGE_FIELD(task, text_parts), 1);
+
+		if (p1->mime_part->parent_part) {
+			rspamd_ftok_t srch;
+
+			srch.begin = "alternative";
+			srch.len = 11;
+
+			if (rspamd_ftok_cmp(&p1->mime_part->parent_part->ct->subtype, &srch) == 0 &&
+				!IS_TEXT_PART_EMPTY(p1) && !IS_TEXT_PART_EMPTY(p2)) {
+				struct rspamd_mime_text_part *sel, *other;
+
+				/* Prefer HTML as text part is not displayed normally */
+				if (IS_TEXT_PART_HTML(p1)) {
+					sel = p1;
+				}
+				else if (IS_TEXT_PART_HTML(p2)) {
+					sel = p2;
+				}
+				else {
+					sel = (p1->utf_content.len > p2->utf_content.len) ? p1 : p2;
+				}
+
+				other = (sel == p1) ? p2 : p1;
+
+				rspamd_mime_part_detect_language(task, sel);
+
+				if (sel->language && sel->language[0]) {
+					/* Propagate language */
+					if (other->languages) {
+						g_ptr_array_unref(other->languages);
+					}
+
+					other->language = sel->language;
+					other->languages = sel->languages ? g_ptr_array_ref(sel->languages) : NULL;
+				}
+			}
+		}
+	}
+
 	PTR_ARRAY_FOREACH(MESSAGE_FIELD(task, text_parts), i, text_part)
 	{
 		if (!text_part->language) {
@@ -1604,47 +1702,10 @@ void rspamd_message_process(struct rspamd_task *task)
 				if (!IS_TEXT_PART_EMPTY(p1) && !IS_TEXT_PART_EMPTY(p2) &&
 					p1->normalized_hashes && p2->normalized_hashes) {
 					/*
-					 * We also detect language on one part and propagate it to
-					 * another one
+					 * Language is detected on the preferred part and
+					 * propagated to the other one before words extraction,
+					 * see above
 					 */
-					struct rspamd_mime_text_part *sel;
-
-					/* Prefer HTML as text part is not displayed normally */
-					if (IS_TEXT_PART_HTML(p1)) {
-						sel = p1;
-					}
-					else if (IS_TEXT_PART_HTML(p2)) {
-						sel = p2;
-					}
-					else {
-						if (p1->utf_content.len > p2->utf_content.len) {
-							sel = p1;
-						}
-						else {
-							sel = p2;
-						}
-					}
-
-					if (sel->language && sel->language[0]) {
-						/* Propagate language */
-						if (sel == p1) {
-							if (p2->languages) {
-								g_ptr_array_unref(p2->languages);
-							}
-
-							p2->language = sel->language;
-							p2->languages = g_ptr_array_ref(sel->languages);
-						}
-						else {
-							if (p1->languages) {
-								g_ptr_array_unref(p1->languages);
-							}
-
-							p1->language = sel->language;
-							p1->languages = g_ptr_array_ref(sel->languages);
-						}
-					}
-
 					tw = p1->normalized_hashes->len + p2->normalized_hashes->len;
 
 					if (tw > 0) {
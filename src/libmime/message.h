@@ -34,6 +34,7 @@ enum rspamd_mime_part_flags {
 	RSPAMD_MIME_PART_BAD_CTE = (1u << 4u),
 	RSPAMD_MIME_PART_MISSING_CTE = (1u << 5u),
 	RSPAMD_MIME_PART_NO_TEXT_EXTRACTION = (1u << 6u),
+	RSPAMD_MIME_PART_LAZY_DECODE = (1u << 7u),
 };
 
 enum rspamd_mime_part_type {
@@ -86,8 +87,9 @@ struct rspamd_mime_part {
 	char *detected_ext;
 	struct rspamd_content_disposition *cd;
 	rspamd_ftok_t raw_data;
-	rspamd_ftok_t parsed_data;
+	rspamd_ftok_t parsed_data; /* empty when RSPAMD_MIME_PART_LAZY_DECODE is set */
 	struct rspamd_mime_part *parent_part;
+	struct rspamd_task *task; /* backlink used to materialise lazily decoded content */
 
 	struct rspamd_mime_header *headers_order;
 	struct rspamd_mime_headers_table *raw_headers;
@@ -138,6 +140,12 @@ struct rspamd_mime_text_part {
 	rspamd_ftok_t utf_content;        /* utf8 encoded processed content */
 	GByteArray *utf_raw_content;      /* utf raw content */
 	GByteArray *utf_stripped_content; /* utf content with no newlines */
+	/*
+	 * Canonical tokens of the part: the text is tokenized merely once and
+	 * each word carries its raw span, unicode and normalized forms, stem and
+	 * flags; statistics, fuzzy shingles, language detection and chartable
+	 * all consume this array and must never tokenize the content again
+	 */
 	GArray *normalized_hashes;        /* Array of uint64_t */
 	GArray *utf_words;                /* Array of rspamd_stat_token_t */
 	UText utf_stripped_text;          /* Used by libicu to represent the utf8 content */
@@ -159,6 +167,7 @@ struct rspamd_mime_text_part {
 	unsigned int capital_letters;
 	unsigned int numeric_characters;
 	unsigned int unicode_scripts;
+	unsigned int invalid_utf8_bytes; /**< bytes replaced when enforcing utf8 */
 };
 
 struct rspamd_message_raw_headers_content {
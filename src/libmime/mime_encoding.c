@@ -205,6 +205,31 @@ rspamd_mime_get_converter_cached(const char *enc,
 	return conv;
 }
 
+/*
+ * Scratch buffer reused for UTF-16 pivots during charset conversion;
+ * workers are single threaded, so a static grow-only buffer is safe and
+ * saves a malloc/free pair for every converted part
+ */
+static UChar *
+rspamd_mime_conv_scratch(gsize nchars)
+{
+	static UChar *scratch_buf = NULL;
+	static gsize scratch_size = 0;
+
+	if (nchars > scratch_size) {
+		gsize newsize = MAX(scratch_size, 8192);
+
+		while (newsize < nchars) {
+			newsize *= 2;
+		}
+
+		scratch_buf = g_realloc(scratch_buf, newsize * sizeof(UChar));
+		scratch_size = newsize;
+	}
+
+	return scratch_buf;
+}
+
 static void
 rspamd_mime_encoding_substitute_init(void)
 {
@@ -339,7 +364,7 @@ rspamd_mime_text_to_utf8(rspamd_mempool_t *pool,
 	RSPAMD_FTOK_FROM_STR(&cset_tok, in_enc);
 
 	if (rspamd_mime_charset_utf_check(&cset_tok, input, len,
-									  FALSE)) {
+									  FALSE, NULL)) {
 		d = rspamd_mempool_alloc(pool, len);
 		memcpy(d, input, len);
 		if (olen) {
@@ -360,7 +385,7 @@ rspamd_mime_text_to_utf8(rspamd_mempool_t *pool,
 		return NULL;
 	}
 
-	tmp_buf = g_new(UChar, len + 1);
+	tmp_buf = rspamd_mime_conv_scratch(len + 1);
 	uc_err = U_ZERO_ERROR;
 	r = rspamd_converter_to_uchars(conv, tmp_buf, len + 1, input, len, &uc_err);
 
@@ -368,7 +393,6 @@ rspamd_mime_text_to_utf8(rspamd_mempool_t *pool,
 		g_set_error(err, rspamd_charset_conv_error_quark(), EINVAL,
 					"cannot convert data to unicode from %s: %s",
 					in_enc, u_errorName(uc_err));
-		g_free(tmp_buf);
 
 		return NULL;
 	}
@@ -383,14 +407,12 @@ rspamd_mime_text_to_utf8(rspamd_mempool_t *pool,
 		g_set_error(err, rspamd_charset_conv_error_quark(), EINVAL,
 					"cannot convert data from unicode from %s: %s",
 					in_enc, u_errorName(uc_err));
-		g_free(tmp_buf);
 
 		return NULL;
 	}
 
 	msg_debug_pool("converted from %s to UTF-8 inlen: %z, outlen: %d",
 				   in_enc, len, r);
-	g_free(tmp_buf);
 
 	if (olen) {
 		*olen = r;
@@ -425,7 +447,7 @@ rspamd_mime_text_part_utf8_convert(struct rspamd_task *task,
 		return FALSE;
 	}
 
-	tmp_buf = g_new(UChar, input->len + 1);
+	tmp_buf = rspamd_mime_conv_scratch(input->len + 1);
 	uc_err = U_ZERO_ERROR;
 	uc_len = rspamd_converter_to_uchars(conv,
 										tmp_buf,
@@ -438,7 +460,6 @@ rspamd_mime_text_part_utf8_convert(struct rspamd_task *task,
 		g_set_error(err, rspamd_charset_conv_error_quark(), EINVAL,
 					"cannot convert data to unicode from %s: %s",
 					charset, u_errorName(uc_err));
-		g_free(tmp_buf);
 
 		return FALSE;
 	}
@@ -454,7 +475,6 @@ rspamd_mime_text_part_utf8_convert(struct rspamd_task *task,
 		g_set_error(err, rspamd_charset_conv_error_quark(), EINVAL,
 					"cannot convert data from unicode from %s: %s",
 					charset, u_errorName(uc_err));
-		g_free(tmp_buf);
 
 		return FALSE;
 	}
@@ -473,7 +493,6 @@ rspamd_mime_text_part_utf8_convert(struct rspamd_task *task,
 													  sizeof(*text_part->utf_raw_content) + sizeof(gpointer) * 4);
 	text_part->utf_raw_content->data = d;
 	text_part->utf_raw_content->len = r;
-	g_free(tmp_buf);
 
 	return TRUE;
 }
@@ -512,7 +531,7 @@ rspamd_mime_to_utf8_byte_array(GByteArray *in,
 	RSPAMD_FTOK_FROM_STR(&charset_tok, enc);
 
 	if (rspamd_mime_charset_utf_check(&charset_tok, (char *) in->data, in->len,
-									  FALSE)) {
+									  FALSE, NULL)) {
 		g_byte_array_set_size(out, in->len);
 		memcpy(out->data, in->data, out->len);
 
@@ -526,15 +545,13 @@ rspamd_mime_to_utf8_byte_array(GByteArray *in,
 		return FALSE;
 	}
 
-	tmp_buf = g_new(UChar, in->len + 1);
+	tmp_buf = rspamd_mime_conv_scratch(in->len + 1);
 	uc_err = U_ZERO_ERROR;
 	r = rspamd_converter_to_uchars(conv,
 								   tmp_buf, in->len + 1,
 								   in->data, in->len, &uc_err);
 
 	if (!U_SUCCESS(uc_err)) {
-		g_free(tmp_buf);
-
 		return FALSE;
 	}
 
@@ -545,52 +562,18 @@ rspamd_mime_to_utf8_byte_array(GByteArray *in,
 	r = ucnv_fromUChars(utf8_converter, out->data, dlen, tmp_buf, r, &uc_err);
 
 	if (!U_SUCCESS(uc_err)) {
-		g_free(tmp_buf);
-
 		return FALSE;
 	}
 
-	g_free(tmp_buf);
 	out->len = r;
 
 	return TRUE;
 }
 
-void rspamd_mime_charset_utf_enforce(char *in, gsize len)
+gsize rspamd_mime_charset_utf_enforce(char *in, gsize len)
 {
-	char *p, *end;
-	goffset err_offset;
-	UChar32 uc = 0;
-
-	/* Now we validate input and replace bad characters with '?' symbol */
-	p = in;
-	end = in + len;
-
-	while (p < end && len > 0 && (err_offset = rspamd_fast_utf8_validate(p, len)) > 0) {
-		err_offset--; /* As it returns it 1 indexed */
-		int32_t cur_offset = err_offset;
-
-		while (cur_offset < len) {
-			int32_t tmp = cur_offset;
-
-			U8_NEXT(p, cur_offset, len, uc);
-
-			if (uc > 0) {
-				/* Fill string between err_offset and tmp with `?` character */
-				memset(p + err_offset, '?', tmp - err_offset);
-				break;
-			}
-		}
-
-		if (uc < 0) {
-			/* Fill till the end */
-			memset(p + err_offset, '?', len - err_offset);
-			break;
-		}
-
-		p += cur_offset;
-		len = end - p;
-	}
+	/* Validate input and replace bad bytes with '?' symbol in one pass */
+	return rspamd_fast_utf8_enforce((unsigned char *) in, len);
 }
 
 const char *
@@ -678,10 +661,15 @@ rspamd_mime_charset_find_by_content_maybe_split(const char *in, gsize inlen)
 
 gboolean
 rspamd_mime_charset_utf_check(rspamd_ftok_t *charset,
-							  char *in, gsize len, gboolean content_check)
+							  char *in, gsize len, gboolean content_check,
+							  gsize *invalid_bytes)
 {
 	const char *real_charset;
 
+	if (invalid_bytes) {
+		*invalid_bytes = 0;
+	}
+
 	if (utf_compatible_re == NULL) {
 		utf_compatible_re = rspamd_regexp_new(
 			"^(?:utf-?8.*)|(?:us-ascii)|(?:ascii)|(?:ansi.*)|(?:CSASCII)$",
@@ -715,7 +703,11 @@ rspamd_mime_charset_utf_check(rspamd_ftok_t *charset,
 					}
 				}
 
-				rspamd_mime_charset_utf_enforce(in, len);
+				gsize nrep = rspamd_mime_charset_utf_enforce(in, len);
+
+				if (invalid_bytes) {
+					*invalid_bytes = nrep;
+				}
 			}
 		}
 
@@ -829,8 +821,12 @@ void rspamd_mime_text_part_maybe_convert(struct rspamd_task *task,
 	RSPAMD_FTOK_FROM_STR(&charset_tok, charset);
 
 	if (!valid_utf8) {
+		gsize invalid_bytes = 0;
+
 		if (rspamd_mime_charset_utf_check(&charset_tok, part_content->data,
-										  part_content->len, !checked)) {
+										  part_content->len, !checked,
+										  &invalid_bytes)) {
+			text_part->invalid_utf8_bytes = invalid_bytes;
 			SET_PART_UTF(text_part);
 			text_part->utf_raw_content = part_content;
 			text_part->real_charset = UTF8_CHARSET;
@@ -86,19 +86,22 @@ void rspamd_mime_text_part_maybe_convert(struct rspamd_task *task,
  * @param charset
  * @param in
  * @param len
+ * @param invalid_bytes number of bytes repaired (may be NULL)
  * @return
  */
 gboolean rspamd_mime_charset_utf_check(rspamd_ftok_t *charset,
 									   char *in, gsize len,
-									   gboolean content_check);
+									   gboolean content_check,
+									   gsize *invalid_bytes);
 
 /**
  * Ensure that all characters in string are valid utf8 chars or replace them
  * with '?'
  * @param in
  * @param len
+ * @return number of replaced bytes
  */
-void rspamd_mime_charset_utf_enforce(char *in, gsize len);
+gsize rspamd_mime_charset_utf_enforce(char *in, gsize len);
 
 /**
   * Gets cached converter
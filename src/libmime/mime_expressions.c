@@ -20,6 +20,7 @@
 #include "rspamd.h"
 #include "message.h"
 #include "mime_expressions.h"
+#include "libmime/mime_parser.h"
 #include "libserver/html/html.h"
 #include "lua/lua_common.h"
 #include "utlist.h"
@@ -2120,12 +2121,16 @@ compare_subtype(struct rspamd_task *task, struct rspamd_content_type *ct,
 }
 
 static gboolean
-compare_len(struct rspamd_mime_part *part, unsigned int min, unsigned int max)
+compare_len(struct rspamd_task *task, struct rspamd_mime_part *part,
+			unsigned int min, unsigned int max)
 {
 	if (min == 0 && max == 0) {
 		return TRUE;
 	}
 
+	/* The decoded length is not known until the part is materialised */
+	rspamd_mime_part_ensure_parsed_data(task, part);
+
 	if (min == 0) {
 		return part->parsed_data.len <= max;
 	}
@@ -2169,7 +2174,7 @@ common_has_content_part(struct rspamd_task *task,
 
 			/* Also check subtype and length of the part */
 			if (r && param_subtype) {
-				r = compare_len(part, min_len, max_len) &&
+				r = compare_len(task, part, min_len, max_len) &&
 					compare_subtype(task, ct, param_subtype);
 
 				return r;
@@ -2183,13 +2188,13 @@ common_has_content_part(struct rspamd_task *task,
 			if (rspamd_ftok_casecmp(&ct->type, &srch) == 0) {
 				if (param_subtype) {
 					if (compare_subtype(task, ct, param_subtype)) {
-						if (compare_len(part, min_len, max_len)) {
+						if (compare_len(task, part, min_len, max_len)) {
 							return TRUE;
 						}
 					}
 				}
 				else {
-					if (compare_len(part, min_len, max_len)) {
+					if (compare_len(task, part, min_len, max_len)) {
 						return TRUE;
 					}
 				}
@@ -2278,7 +2283,7 @@ rspamd_is_empty_body(struct rspamd_task *task,
 
 	PTR_ARRAY_FOREACH(MESSAGE_FIELD(task, parts), i, part)
 	{
-		if (part->parsed_data.len > 0) {
+		if (rspamd_mime_part_ensure_parsed_data(task, part)) {
 			return FALSE;
 		}
 	}
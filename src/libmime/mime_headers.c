@@ -33,6 +33,38 @@ struct rspamd_mime_headers_table {
 	ref_entry_t ref;
 };
 
+static void
+rspamd_mime_header_decode_value(struct rspamd_task *task,
+								struct rspamd_mime_header *rh)
+{
+	gboolean broken_utf = FALSE;
+
+	rh->decoded = rspamd_mime_header_decode(task->task_pool,
+											rh->value, strlen(rh->value), &broken_utf);
+
+	if (broken_utf) {
+		task->flags |= RSPAMD_TASK_FLAG_BAD_UNICODE;
+	}
+
+	if (rh->decoded == NULL) {
+		/* As we strip comments in place... */
+		rh->decoded = rspamd_mempool_strdup(task->task_pool, "");
+	}
+
+	/* We also validate utf8 and replace all non-valid utf8 chars */
+	rspamd_mime_charset_utf_enforce(rh->decoded, strlen(rh->decoded));
+}
+
+char *
+rspamd_mime_header_get_decoded(struct rspamd_mime_header *rh)
+{
+	if (rh->decoded == NULL && rh->task != NULL && rh->value != NULL) {
+		rspamd_mime_header_decode_value(rh->task, rh);
+	}
+
+	return rh->decoded;
+}
+
 static void
 rspamd_mime_header_check_special(struct rspamd_task *task,
 								 struct rspamd_mime_header *rh)
@@ -50,6 +82,7 @@ rspamd_mime_header_check_special(struct rspamd_task *task,
 
 	switch (h) {
 	case 0x88705DC4D9D61ABULL: /* received */
+		rspamd_mime_header_get_decoded(rh);
 		if (rspamd_received_header_parse(task, rh->decoded, strlen(rh->decoded), rh)) {
 			rh->flags |= RSPAMD_HEADER_RECEIVED;
 		}
@@ -81,7 +114,7 @@ rspamd_mime_header_check_special(struct rspamd_task *task,
 	case 0x43A558FC7C240226ULL: /* message-id */ {
 
 		rh->flags = RSPAMD_HEADER_MESSAGE_ID | RSPAMD_HEADER_UNIQUE;
-		p = rh->decoded;
+		p = rspamd_mime_header_get_decoded(rh);
 		len = rspamd_strip_smtp_comments_inplace(rh->decoded, strlen(p));
 		rh->decoded[len] = '\0'; /* Zero terminate after stripping */
 		/* Strip surrounding spaces */
@@ -121,12 +154,13 @@ rspamd_mime_header_check_special(struct rspamd_task *task,
 	}
 	case 0xB91D3910358E8212ULL: /* subject */
 		if (MESSAGE_FIELD(task, subject) == NULL) {
-			MESSAGE_FIELD(task, subject) = rh->decoded;
+			MESSAGE_FIELD(task, subject) = rspamd_mime_header_get_decoded(rh);
 		}
 		rh->flags = RSPAMD_HEADER_SUBJECT | RSPAMD_HEADER_UNIQUE;
 		break;
 	case 0xEE4AA2EAAC61D6F4ULL: /* return-path */
 		if (task->from_envelope == NULL) {
+			rspamd_mime_header_get_decoded(rh);
 			task->from_envelope = rspamd_email_address_from_smtp(rh->decoded,
 																 strlen(rh->decoded));
 		}
@@ -134,7 +168,7 @@ rspamd_mime_header_check_special(struct rspamd_task *task,
 		break;
 	case 0xB9EEFAD2E93C2161ULL: /* delivered-to */
 		if (task->deliver_to == NULL) {
-			task->deliver_to = rh->decoded;
+			task->deliver_to = rspamd_mime_header_get_decoded(rh);
 		}
 		rh->flags = RSPAMD_HEADER_DELIVERED_TO;
 		break;
@@ -223,6 +257,7 @@ void rspamd_mime_headers_process(struct rspamd_task *task,
 			if (*p == ':') {
 				nh = rspamd_mempool_alloc0(task->task_pool,
 										   sizeof(struct rspamd_mime_header));
+				nh->task = task;
 				l = p - c;
 				tmp = rspamd_mempool_alloc(task->task_pool, l + 1);
 				rspamd_null_safe_copy(c, l, tmp, l + 1);
@@ -386,22 +421,12 @@ void rspamd_mime_headers_process(struct rspamd_task *task,
 
 			nh->value = tmp;
 
-			gboolean broken_utf = FALSE;
-
-			nh->decoded = rspamd_mime_header_decode(task->task_pool,
-													nh->value, strlen(tmp), &broken_utf);
-
-			if (broken_utf) {
-				task->flags |= RSPAMD_TASK_FLAG_BAD_UNICODE;
-			}
-
-			if (nh->decoded == NULL) {
-				/* As we strip comments in place... */
-				nh->decoded = rspamd_mempool_strdup(task->task_pool, "");
-			}
-
-			/* We also validate utf8 and replace all non-valid utf8 chars */
-			rspamd_mime_charset_utf_enforce(nh->decoded, strlen(nh->decoded));
+			/*
+			 * RFC2047 decoding and utf8 normalisation of the value are
+			 * deferred until the header is actually looked up, as the
+			 * majority of headers are never read by any rule
+			 */
+			nh->decoded = NULL;
 			nh->order = norder++;
 			rspamd_mime_header_add(task, &target->htb, order_ptr, nh, check_newlines);
 			nh = NULL;
@@ -932,7 +957,7 @@ rspamd_message_get_header_from_hash(struct rspamd_mime_headers_table *hdrs,
 
 	khiter_t k;
 	khash_t(rspamd_mime_headers_htb) *htb = &hdrs->htb;
-	struct rspamd_mime_header *hdr;
+	struct rspamd_mime_header *hdr, *cur;
 
 	if (htb) {
 		k = kh_get(rspamd_mime_headers_htb, htb, (char *) field);
@@ -943,6 +968,12 @@ rspamd_message_get_header_from_hash(struct rspamd_mime_headers_table *hdrs,
 
 		hdr = kh_value(htb, k);
 
+		/* Materialise deferred decoding for all instances of this header */
+		DL_FOREACH(hdr, cur)
+		{
+			rspamd_mime_header_get_decoded(cur);
+		}
+
 		if (!need_modified) {
 			if (hdr->flags & RSPAMD_HEADER_NON_EXISTING) {
 				return NULL;
@@ -1277,6 +1308,7 @@ void rspamd_message_set_modified_header(struct rspamd_task *task,
 						task->task_pool, sizeof(*nhdr));
 
 					nhdr->flags |= RSPAMD_HEADER_ADDED;
+					nhdr->task = task;
 					nhdr->name = hdr_elt->name;
 					nhdr->value = rspamd_mempool_alloc(task->task_pool,
 													   raw_len + 1);
@@ -64,10 +64,11 @@ struct rspamd_mime_header {
 	char *name; /* Also used for key */
 	char *value;
 	char *separator;
-	char *decoded;
+	char *decoded;                             /* NULL until materialised for lazily decoded headers */
 	struct rspamd_mime_header *modified_chain; /* Headers modified during transform */
 	struct rspamd_mime_header *prev, *next;    /* Headers with the same name */
 	struct rspamd_mime_header *ord_next;       /* Overall order of headers, slist */
+	struct rspamd_task *task;                  /* Backlink used to decode the value on demand */
 };
 
 struct rspamd_mime_headers_table;
@@ -96,6 +97,14 @@ void rspamd_mime_headers_process(struct rspamd_task *task,
 char *rspamd_mime_header_decode(rspamd_mempool_t *pool, const char *in,
 								gsize inlen, gboolean *invalid_utf);
 
+/**
+ * Get rfc2047 decoded and utf8 normalised value of a header, materialising
+ * it if decoding has been deferred at parsing time
+ * @param rh
+ * @return decoded value (can be NULL merely for foreign headers with no task backlink)
+ */
+char *rspamd_mime_header_get_decoded(struct rspamd_mime_header *rh);
+
 /**
  * Encode mime header if needed
  * @param in
@@ -568,7 +568,9 @@ rspamd_mime_part_get_cd(struct rspamd_task *task, struct rspamd_mime_part *part)
 	part->cd = cd;
 }
 
-void rspamd_mime_parser_calc_digest(struct rspamd_mime_part *part)
+static void
+rspamd_mime_parser_calc_digest_data(struct rspamd_mime_part *part,
+									const char *begin, gsize len)
 {
 	/* Blake2b applied to string 'rspamd' */
 	static const unsigned char hash_key[] = {
@@ -638,29 +640,26 @@ void rspamd_mime_parser_calc_digest(struct rspamd_mime_part *part)
 		0xfe,
 	};
 
-	if (part->parsed_data.len > 0) {
+	if (len > 0) {
 		rspamd_cryptobox_hash(part->digest,
-							  part->parsed_data.begin, part->parsed_data.len,
+							  begin, len,
 							  hash_key, sizeof(hash_key));
 	}
 }
 
-static enum rspamd_mime_parse_error
-rspamd_mime_parse_normal_part(struct rspamd_task *task,
-							  struct rspamd_mime_part *part,
-							  struct rspamd_mime_parser_ctx *st,
-							  struct rspamd_content_type *ct,
-							  GError **err)
+void rspamd_mime_parser_calc_digest(struct rspamd_mime_part *part)
+{
+	rspamd_mime_parser_calc_digest_data(part, part->parsed_data.begin,
+										part->parsed_data.len);
+}
+
+static void
+rspamd_mime_part_decode_data(struct rspamd_task *task,
+							 struct rspamd_mime_part *part)
 {
 	rspamd_fstring_t *parsed;
 	gssize r;
 
-	g_assert(part != NULL);
-
-	rspamd_mime_part_get_cte(task, part->raw_headers, part,
-							 part->ct && !(part->ct->flags & RSPAMD_CONTENT_TYPE_MESSAGE));
-	rspamd_mime_part_get_cd(task, part);
-
 	switch (part->cte) {
 	case RSPAMD_CTE_7BIT:
 	case RSPAMD_CTE_8BIT:
@@ -733,17 +732,23 @@ rspamd_mime_parse_normal_part(struct rspamd_task *task,
 										  (rspamd_mempool_destruct_t) rspamd_fstring_free, parsed);
 		}
 		break;
-	case RSPAMD_CTE_B64:
-		parsed = rspamd_fstring_sized_new(part->raw_data.len / 4 * 3 + 12);
+	case RSPAMD_CTE_B64: {
+		unsigned char *dec;
+		gsize dec_len = 0;
+
+		/*
+		 * The simd decoder writes the output in a single pass, so we can
+		 * decode straight into the task pool with no intermediate buffer
+		 */
+		dec = rspamd_mempool_alloc(task->task_pool,
+								   part->raw_data.len / 4 * 3 + 12);
 		rspamd_cryptobox_base64_decode(part->raw_data.begin,
 									   part->raw_data.len,
-									   parsed->str, &parsed->len);
-		part->parsed_data.begin = parsed->str;
-		part->parsed_data.len = parsed->len;
-		rspamd_mempool_notify_alloc(task->task_pool, parsed->len);
-		rspamd_mempool_add_destructor(task->task_pool,
-									  (rspamd_mempool_destruct_t) rspamd_fstring_free, parsed);
+									   dec, &dec_len);
+		part->parsed_data.begin = (const char *) dec;
+		part->parsed_data.len = dec_len;
 		break;
+	}
 	case RSPAMD_CTE_UUE:
 		parsed = rspamd_fstring_sized_new(part->raw_data.len / 4 * 3 + 12);
 		r = rspamd_decode_uue_buf(part->raw_data.begin, part->raw_data.len,
@@ -772,14 +777,141 @@ rspamd_mime_parse_normal_part(struct rspamd_task *task,
 	default:
 		g_assert_not_reached();
 	}
+}
+
+gboolean
+rspamd_mime_part_ensure_parsed_data(struct rspamd_task *task,
+									struct rspamd_mime_part *part)
+{
+	if (part->flags & RSPAMD_MIME_PART_LAZY_DECODE) {
+		part->flags &= ~RSPAMD_MIME_PART_LAZY_DECODE;
+		rspamd_mime_part_decode_data(task, part);
+		/* Switch to the canonical digest over the decoded content */
+		rspamd_mime_parser_calc_digest(part);
+		msg_debug_mime("lazily decoded data part %T/%T of length %z (%z orig), %s cte",
+					   &part->ct->type, &part->ct->subtype, part->parsed_data.len,
+					   part->raw_data.len, rspamd_cte_to_string(part->cte));
+	}
+
+	return part->parsed_data.len > 0;
+}
+
+gsize rspamd_mime_part_peek_parsed_data(struct rspamd_task *task,
+										struct rspamd_mime_part *part,
+										unsigned char *buf, gsize buflen)
+{
+	unsigned char tmp[512];
+	gsize head_len, outlen;
+	gssize r;
+
+	if (!(part->flags & RSPAMD_MIME_PART_LAZY_DECODE)) {
+		head_len = MIN(buflen, part->parsed_data.len);
+
+		if (head_len > 0) {
+			memcpy(buf, part->parsed_data.begin, head_len);
+		}
+
+		return head_len;
+	}
+
+	buflen = MIN(buflen, sizeof(tmp) / 4);
+
+	if (part->cte == RSPAMD_CTE_B64) {
+		/* Transfer lines are usually wrapped, so take some spare input */
+		head_len = MIN(part->raw_data.len, ((buflen + 2) / 3) * 4 + 78);
+		outlen = sizeof(tmp);
+		/* Decoding a prefix of the input produces a prefix of the output */
+		rspamd_cryptobox_base64_decode(part->raw_data.begin, head_len,
+									   tmp, &outlen);
+
+		if (outlen > 0) {
+			outlen = MIN(outlen, buflen);
+			memcpy(buf, tmp, outlen);
+
+			return outlen;
+		}
+	}
+	else if (part->cte == RSPAMD_CTE_QP) {
+		head_len = MIN(part->raw_data.len, sizeof(tmp));
+		r = rspamd_decode_qp_buf(part->raw_data.begin, head_len,
+								 tmp, sizeof(tmp));
+
+		if (r > 0) {
+			if (head_len < part->raw_data.len && r > 2) {
+				/* The tail could have been cut inside an encoded sequence */
+				r -= 2;
+			}
+
+			head_len = MIN((gsize) r, buflen);
+			memcpy(buf, tmp, head_len);
+
+			return head_len;
+		}
+	}
+
+	/* Cannot decode a bounded prefix, materialise the whole part */
+	if (rspamd_mime_part_ensure_parsed_data(task, part)) {
+		head_len = MIN(buflen, part->parsed_data.len);
+		memcpy(buf, part->parsed_data.begin, head_len);
+
+		return head_len;
+	}
+
+	return 0;
+}
+
+static enum rspamd_mime_parse_error
+rspamd_mime_parse_normal_part(struct rspamd_task *task,
+							  struct rspamd_mime_part *part,
+							  struct rspamd_mime_parser_ctx *st,
+							  struct rspamd_content_type *ct,
+							  GError **err)
+{
+	g_assert(part != NULL);
+
+	rspamd_mime_part_get_cte(task, part->raw_headers, part,
+							 part->ct && !(part->ct->flags & RSPAMD_CONTENT_TYPE_MESSAGE));
+	rspamd_mime_part_get_cd(task, part);
+	part->task = task;
+
+	if ((part->cte == RSPAMD_CTE_QP || part->cte == RSPAMD_CTE_B64 ||
+		 part->cte == RSPAMD_CTE_UUE) &&
+		part->ct != NULL &&
+		!(part->ct->flags & (RSPAMD_CONTENT_TYPE_TEXT |
+							 RSPAMD_CONTENT_TYPE_MESSAGE |
+							 RSPAMD_CONTENT_TYPE_SMIME |
+							 RSPAMD_CONTENT_TYPE_MISSING |
+							 RSPAMD_CONTENT_TYPE_BROKEN)) &&
+		!(ct && (ct->flags & RSPAMD_CONTENT_TYPE_SMIME))) {
+		/*
+		 * Encoded attachment content is frequently never read, so defer the
+		 * decoding until the first real accessor. The digest is calculated
+		 * over the raw form here (still unique per content) and is replaced
+		 * by the canonical one over the decoded form on materialisation.
+		 */
+		part->flags |= RSPAMD_MIME_PART_LAZY_DECODE;
+		rspamd_mime_parser_calc_digest_data(part, part->raw_data.begin,
+											part->raw_data.len);
+	}
+	else {
+		rspamd_mime_part_decode_data(task, part);
+		rspamd_mime_parser_calc_digest(part);
+	}
 
 	part->part_number = MESSAGE_FIELD(task, parts)->len;
 	part->urls = g_ptr_array_new();
 	g_ptr_array_add(MESSAGE_FIELD(task, parts), part);
-	msg_debug_mime("parsed data part %T/%T of length %z (%z orig), %s cte",
-				   &part->ct->type, &part->ct->subtype, part->parsed_data.len,
-				   part->raw_data.len, rspamd_cte_to_string(part->cte));
-	rspamd_mime_parser_calc_digest(part);
+
+	if (part->flags & RSPAMD_MIME_PART_LAZY_DECODE) {
+		msg_debug_mime("deferred decoding of data part %T/%T of length %z, %s cte",
+					   &part->ct->type, &part->ct->subtype, part->raw_data.len,
+					   rspamd_cte_to_string(part->cte));
+	}
+	else {
+		msg_debug_mime("parsed data part %T/%T of length %z (%z orig), %s cte",
+					   &part->ct->type, &part->ct->subtype, part->parsed_data.len,
+					   part->raw_data.len, rspamd_cte_to_string(part->cte));
+	}
 
 	if (ct && (ct->flags & RSPAMD_CONTENT_TYPE_SMIME)) {
 		CMS_ContentInfo *cms;
@@ -907,6 +1039,7 @@ rspamd_mime_process_multipart_node(struct rspamd_task *task,
 
 	npart = rspamd_mempool_alloc0(task->task_pool,
 								  sizeof(struct rspamd_mime_part));
+	npart->task = task;
 	npart->parent_part = multipart;
 	npart->raw_headers = rspamd_message_headers_new();
 	npart->headers_order = NULL;
@@ -1459,6 +1592,7 @@ rspamd_mime_parse_message(struct rspamd_task *task,
 	/* Allocate real part */
 	npart = rspamd_mempool_alloc0(task->task_pool,
 								  sizeof(struct rspamd_mime_part));
+	npart->task = task;
 
 	if (part == NULL) {
 		/* Top level message */
@@ -38,6 +38,26 @@ enum rspamd_mime_parse_error rspamd_mime_parse_task(struct rspamd_task *task,
 
 void rspamd_mime_parser_calc_digest(struct rspamd_mime_part *part);
 
+/**
+ * Materialises the decoded content of a part whose decoding was deferred at
+ * parse time (RSPAMD_MIME_PART_LAZY_DECODE); recalculates the part digest
+ * over the decoded form. Does nothing for already decoded parts.
+ * @return TRUE if the part has non-empty decoded content
+ */
+gboolean rspamd_mime_part_ensure_parsed_data(struct rspamd_task *task,
+											 struct rspamd_mime_part *part);
+
+/**
+ * Copies up to `buflen` leading bytes of the decoded content into `buf`
+ * without materialising a lazily decoded part when a bounded prefix can be
+ * decoded cheaply (e.g. for magic bytes checks). Falls back to the full
+ * decoding otherwise.
+ * @return number of bytes stored in `buf`
+ */
+gsize rspamd_mime_part_peek_parsed_data(struct rspamd_task *task,
+										struct rspamd_mime_part *part,
+										unsigned char *buf, gsize buflen);
+
 
 #ifdef __cplusplus
 }
@@ -625,16 +625,48 @@ private:
 		return storage.size() - orig_size;
 	}
 
+	inline auto append_filtered_cp(UChar32 uc) -> void
+	{
+		if (filter_func) {
+			uc = filter_func(uc);
+		}
+
+		if (uc == 0) {
+			/* Special case, ignore it */
+			flags = flags | mime_string_flags::MIME_STRING_SEEN_ZEROES;
+		}
+		else {
+			char tmp[4];
+			std::int32_t o = 0;
+			U8_APPEND_UNSAFE(tmp, o, uc);
+			storage.append(tmp, o);
+		}
+	}
+
 	auto append_c_string_filtered(const CharT *str, std::size_t len) -> std::size_t
 	{
 		std::int32_t i = 0;// We have to use int32_t here as old libicu is brain-damaged
 		UChar32 uc;
-		char tmp[4];
 		auto orig_size = storage.size();
-		/* Slow path */
 
 		storage.reserve(len + storage.size());
 
+		/*
+		 * Validate the whole input in a single simd pass first: on valid
+		 * input (the overwhelming majority) we can then decode with the
+		 * unchecked macros and skip the per codepoint validity branch,
+		 * merely applying the filter
+		 */
+		if (rspamd_fast_utf8_validate((const unsigned char *) str, len) == 0) {
+			while (i < len) {
+				U8_NEXT_UNSAFE(str, i, uc);
+				append_filtered_cp(uc);
+			}
+
+			return storage.size() - orig_size;
+		}
+
+		/* Slow path with per codepoint checks */
 		while (i < len) {
 			U8_NEXT(str, i, len, uc);
 
@@ -644,19 +676,7 @@ private:
 				flags = flags | mime_string_flags::MIME_STRING_SEEN_INVALID;
 			}
 			else {
-				if (filter_func) {
-					uc = filter_func(uc);
-				}
-
-				if (uc == 0) {
-					/* Special case, ignore it */
-					flags = flags | mime_string_flags::MIME_STRING_SEEN_ZEROES;
-				}
-				else {
-					std::int32_t o = 0;
-					U8_APPEND_UNSAFE(tmp, o, uc);
-					storage.append(tmp, o);
-				}
+				append_filtered_cp(uc);
 			}
 		}
 
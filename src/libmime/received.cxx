@@ -15,6 +15,7 @@
  */
 
 #include "config.h"
+#include "libcryptobox/cryptobox.h"
 #include "libserver/url.h"
 #include "lua/lua_common.h"
 #include "libserver/cfg_file.h"
@@ -106,7 +107,13 @@ received_process_part(const std::string_view &data,
 				ebraces++;
 
 				if (ebraces >= obraces) {
-					if (type != received_part_type::RSPAMD_RECEIVED_PART_UNKNOWN) {
+					/*
+					 * Merely the first comment of the `from` part is ever
+					 * consumed afterwards, so we do not materialise the
+					 * rest (TLS descriptions, envelope-from and so on)
+					 */
+					if (type == received_part_type::RSPAMD_RECEIVED_PART_FROM &&
+						npart.comments.empty()) {
 						if (p > c) {
 							npart.comments.emplace_back(received_char_filter);
 							auto &comment = npart.comments.back();
@@ -406,7 +413,8 @@ received_spill(const std::string_view &in,
 	(rspamd_inet_address_parse_flags)(RSPAMD_INET_ADDRESS_PARSE_REMOTE | RSPAMD_INET_ADDRESS_PARSE_NO_UNIX)
 
 static auto
-received_process_rdns(rspamd_mempool_t *pool,
+received_process_rdns(received_header_chain &chain,
+					  rspamd_mempool_t *pool,
 					  const std::string_view &in,
 					  mime_string &dest) -> bool
 {
@@ -419,6 +427,16 @@ received_process_rdns(rspamd_mempool_t *pool,
 		return false;
 	}
 
+	if (auto interned = chain.lookup_token(in); interned.has_value()) {
+		if (interned->empty()) {
+			return false;
+		}
+
+		dest.assign_copy(interned.value());
+
+		return true;
+	}
+
 	if (*p == '[' && *(end - 1) == ']' && in.size() > 2) {
 		/* We have enclosed ip address */
 		auto *addr = rspamd_parse_inet_address_pool(p + 1,
@@ -437,6 +455,7 @@ received_process_rdns(rspamd_mempool_t *pool,
 			}
 
 			dest.assign_copy(std::string_view{addr_str});
+			chain.remember_token(in, dest.as_view());
 
 			return true;
 		}
@@ -463,16 +482,20 @@ received_process_rdns(rspamd_mempool_t *pool,
 		if (p == end || (seen_dot && (g_ascii_isspace(*p) || *p == '[' || *p == '('))) {
 			/* All data looks like a hostname */
 			dest.assign_copy(std::string_view{in.data(), hlen});
+			chain.remember_token(in, dest.as_view());
 
 			return true;
 		}
 	}
 
+	chain.remember_token(in, "");
+
 	return false;
 }
 
 static auto
-received_process_host_tcpinfo(rspamd_mempool_t *pool,
+received_process_host_tcpinfo(received_header_chain &chain,
+							  rspamd_mempool_t *pool,
 							  received_header &rh,
 							  const std::string_view &in) -> bool
 {
@@ -534,7 +557,7 @@ received_process_host_tcpinfo(rspamd_mempool_t *pool,
 						/* Process with rDNS */
 						auto rdns_substr = in.substr(0, obrace_pos);
 
-						if (received_process_rdns(pool, rdns_substr, rh.real_hostname)) {
+						if (received_process_rdns(chain, pool, rdns_substr, rh.real_hostname)) {
 							ret = true;
 						}
 					}
@@ -542,7 +565,7 @@ received_process_host_tcpinfo(rspamd_mempool_t *pool,
 			}
 			else {
 				/* Hostname or some crap, sigh... */
-				if (received_process_rdns(pool, in, rh.real_hostname)) {
+				if (received_process_rdns(chain, pool, in, rh.real_hostname)) {
 					ret = true;
 				}
 			}
@@ -553,7 +576,8 @@ received_process_host_tcpinfo(rspamd_mempool_t *pool,
 }
 
 static void
-received_process_from(rspamd_mempool_t *pool,
+received_process_from(received_header_chain &chain,
+					  rspamd_mempool_t *pool,
 					  const received_part &rpart,
 					  received_header &rh)
 {
@@ -571,14 +595,14 @@ received_process_from(rspamd_mempool_t *pool,
 		if (!rpart.comments.empty()) {
 			/* We can have info within comment as part of RFC */
 			received_process_host_tcpinfo(
-				pool, rh,
+				chain, pool, rh,
 				rpart.comments[0].as_view());
 		}
 
 		if (rh.real_ip.size() == 0) {
 			/* Try to do the same with data */
 			if (received_process_host_tcpinfo(
-					pool, rh,
+					chain, pool, rh,
 					rpart.data.as_view())) {
 				seen_ip_in_data = true;
 			}
@@ -587,12 +611,12 @@ received_process_from(rspamd_mempool_t *pool,
 		if (!seen_ip_in_data) {
 			if (rh.real_ip.size() != 0) {
 				/* Get announced hostname (usually helo) */
-				received_process_rdns(pool,
+				received_process_rdns(chain, pool,
 									  rpart.data.as_view(),
 									  rh.from_hostname);
 			}
 			else {
-				received_process_host_tcpinfo(pool,
+				received_process_host_tcpinfo(chain, pool,
 											  rh, rpart.data.as_view());
 			}
 		}
@@ -601,7 +625,7 @@ received_process_from(rspamd_mempool_t *pool,
 		/* rpart->dlen = 0 */
 		if (!rpart.comments.empty()) {
 			received_process_host_tcpinfo(
-				pool, rh,
+				chain, pool, rh,
 				rpart.comments[0].as_view());
 		}
 	}
@@ -658,10 +682,10 @@ received_header_parse(received_header_chain &chain, rspamd_mempool_t *pool,
 	for (const auto &part: parts) {
 		switch (part.type) {
 		case received_part_type::RSPAMD_RECEIVED_PART_FROM:
-			received_process_from(pool, part, rh);
+			received_process_from(chain, pool, part, rh);
 			break;
 		case received_part_type::RSPAMD_RECEIVED_PART_BY:
-			received_process_rdns(pool,
+			received_process_rdns(chain, pool,
 								  part.data.as_view(),
 								  rh.by_hostname);
 			break;
@@ -848,6 +872,33 @@ received_export_to_lua(received_header_chain *chain, lua_State *L) -> bool
 		lua_rawseti(L, -2, i++);
 	}
 
+	/*
+	 * Fingerprint of the relay path: the ordered hop IPs plus the flags that
+	 * affect trust decisions. Messages traversing the same fixed topology get
+	 * the same fingerprint, so policy code can memoise per-path conclusions
+	 * instead of re-walking the chain for every message. Hostnames are NOT
+	 * covered: conclusions that depend on per-hop hostnames (or on external
+	 * data that can change at runtime) must not be keyed by this value alone
+	 */
+	auto fp = static_cast<uint64_t>(chain->size());
+
+	for (const auto &rh: chain->as_vector()) {
+		if (!rh.real_ip.empty()) {
+			fp = rspamd_cryptobox_fast_hash(rh.real_ip.data(), rh.real_ip.size(), fp);
+		}
+
+		auto fl = static_cast<std::uint32_t>(rh.flags &
+											 (received_flags::ARTIFICIAL |
+											  received_flags::AUTHENTICATED |
+											  received_flags::SSL));
+		fp = rspamd_cryptobox_fast_hash(&fl, sizeof(fl), fp);
+	}
+
+	char fp_buf[32];
+	auto fp_len = rspamd_snprintf(fp_buf, sizeof(fp_buf), "%xL", fp);
+	lua_pushlstring(L, fp_buf, fp_len);
+	lua_setfield(L, -2, "fingerprint");
+
 	return true;
 }
 
@@ -25,7 +25,9 @@
 #include "libmime/email_addr.h"
 #include "libserver/task.h"
 #include "contrib/ankerl/unordered_dense.h"
+#include "libutil/cxx/hash_util.hxx"
 #include <vector>
+#include <string>
 #include <string_view>
 #include <utility>
 #include <optional>
@@ -302,12 +304,35 @@ public:
 		return headers;
 	}
 
+	/*
+	 * Relay generated tokens (e.g. our own relay names) repeat across the
+	 * hops of a chain, so we memoise the processed result per raw token;
+	 * an empty cached value is a negative result
+	 */
+	auto lookup_token(const std::string_view &tok) const -> std::optional<std::string_view>
+	{
+		auto it = tokens_cache.find(tok);
+
+		if (it != tokens_cache.end()) {
+			return std::string_view{it->second};
+		}
+
+		return std::nullopt;
+	}
+	auto remember_token(const std::string_view &tok, const std::string_view &result) -> void
+	{
+		tokens_cache.emplace(std::string{tok}, std::string{result});
+	}
+
 private:
 	static auto received_header_chain_pool_dtor(void *ptr) -> void
 	{
 		delete static_cast<received_header_chain *>(ptr);
 	}
 	std::vector<received_header> headers;
+	ankerl::unordered_dense::map<std::string, std::string,
+								 rspamd::smart_str_hash, rspamd::smart_str_equal>
+		tokens_cache;
 };
 
 }// namespace rspamd::mime
@@ -614,6 +614,85 @@ rspamd_task_insert_result_full(struct rspamd_task *task,
 	return ret;
 }
 
+/*
+ * Per worker interning of frequent short options: plugins tend to attach the
+ * same strings ("mx_missing", tld names and so on) to symbols on every task,
+ * so sanitised copies are kept once per worker process in a dedicated arena
+ * instead of being duplicated in each task pool. The arena is bounded and
+ * never evicts, hence interned pointers stay valid for the worker lifetime
+ * and need no reference counting.
+ */
+#define RSPAMD_OPT_INTERN_MAX_LEN 64
+#define RSPAMD_OPT_INTERN_MAX_ENTRIES 4096
+
+static khash_t(rspamd_options_hash) *opt_intern_hash = NULL;
+static rspamd_mempool_t *opt_intern_pool = NULL;
+
+static const char *
+rspamd_task_option_intern(const char *val, gsize vlen, gboolean insert)
+{
+	struct rspamd_symbol_option srch, *ent;
+	khiter_t k;
+	int r;
+
+	srch.option = (char *) val;
+	srch.optlen = vlen;
+
+	if (opt_intern_hash != NULL) {
+		k = kh_get(rspamd_options_hash, opt_intern_hash, &srch);
+
+		if (k != kh_end(opt_intern_hash)) {
+			return kh_key(opt_intern_hash, k)->option;
+		}
+	}
+
+	if (!insert) {
+		return NULL;
+	}
+
+	if (opt_intern_hash == NULL) {
+		opt_intern_pool = rspamd_mempool_new(rspamd_mempool_suggest_size(),
+											 "opt_intern", 0);
+		opt_intern_hash = kh_init(rspamd_options_hash);
+	}
+	else if (kh_size(opt_intern_hash) >= RSPAMD_OPT_INTERN_MAX_ENTRIES) {
+		/* Table is full, keep the hot set intact and give up */
+		return NULL;
+	}
+
+	ent = rspamd_mempool_alloc0(opt_intern_pool, sizeof(*ent));
+	ent->optlen = vlen;
+	ent->option = rspamd_mempool_alloc(opt_intern_pool, vlen + 1);
+	memcpy(ent->option, val, vlen);
+	ent->option[vlen] = '\0';
+	kh_put(rspamd_options_hash, opt_intern_hash, ent, &r);
+
+	return ent->option;
+}
+
+/*
+ * Most symbols carry a handful of options at most, so the dedup hash is
+ * built lazily: short lists are scanned directly and the hash is allocated
+ * solely when the list outgrows this threshold
+ */
+#define RSPAMD_OPTS_HASH_THRESHOLD 4
+
+static inline struct rspamd_symbol_option *
+rspamd_task_find_option_list(struct rspamd_symbol_result *res,
+							 const char *val, gsize vlen)
+{
+	struct rspamd_symbol_option *opt;
+
+	DL_FOREACH(res->opts_head, opt)
+	{
+		if (opt->optlen == vlen && memcmp(opt->option, val, vlen) == 0) {
+			return opt;
+		}
+	}
+
+	return NULL;
+}
+
 static char *
 rspamd_task_option_safe_copy(struct rspamd_task *task,
 							 const char *val,
@@ -740,10 +819,6 @@ rspamd_task_add_result_option(struct rspamd_task *task,
 				continue;
 			}
 
-			if (!cur->options) {
-				cur->options = kh_init(rspamd_options_hash);
-			}
-
 			if (vlen + cur->opts_len > task->cfg->max_opts_len) {
 				/* Add truncated option */
 				msg_info_task("cannot add more options to symbol %s when adding option %s",
@@ -754,26 +829,80 @@ rspamd_task_add_result_option(struct rspamd_task *task,
 			}
 
 			if (!(cur->sym && (cur->sym->flags & RSPAMD_SYMBOL_FLAG_ONEPARAM))) {
+				gboolean found;
 
-				srch.option = (char *) val;
-				srch.optlen = vlen;
-				k = kh_get(rspamd_options_hash, cur->options, &srch);
+				if (cur->options) {
+					srch.option = (char *) val;
+					srch.optlen = vlen;
+					k = kh_get(rspamd_options_hash, cur->options, &srch);
+					found = (k != kh_end(cur->options));
+				}
+				else {
+					found = rspamd_task_find_option_list(cur, val, vlen) != NULL;
+				}
+
+				if (!found) {
+					/* Check the worker wide interned copy to avoid a per task one */
+					opt_cpy = NULL;
+					cpy_len = vlen;
+
+					if (vlen <= RSPAMD_OPT_INTERN_MAX_LEN) {
+						opt_cpy = (char *) rspamd_task_option_intern(val, vlen, FALSE);
+					}
 
-				if (k == kh_end(cur->options)) {
-					opt_cpy = rspamd_task_option_safe_copy(task, val, vlen, &cpy_len);
-					if (cpy_len != vlen) {
-						srch.option = (char *) opt_cpy;
-						srch.optlen = cpy_len;
-						k = kh_get(rspamd_options_hash, cur->options, &srch);
+					if (opt_cpy == NULL) {
+						opt_cpy = rspamd_task_option_safe_copy(task, val, vlen, &cpy_len);
+						if (cpy_len != vlen) {
+							/* The sanitised content can collide with an existing option */
+							if (cur->options) {
+								srch.option = (char *) opt_cpy;
+								srch.optlen = cpy_len;
+								k = kh_get(rspamd_options_hash, cur->options, &srch);
+								found = (k != kh_end(cur->options));
+							}
+							else {
+								found = rspamd_task_find_option_list(cur, opt_cpy,
+																	 cpy_len) != NULL;
+							}
+						}
+						else if (vlen <= RSPAMD_OPT_INTERN_MAX_LEN &&
+								 memcmp(opt_cpy, val, vlen) == 0) {
+							/* Sanitisation was an identity, so the option can be interned */
+							const char *interned = rspamd_task_option_intern(opt_cpy,
+																			 cpy_len, TRUE);
+
+							if (interned != NULL) {
+								opt_cpy = (char *) interned;
+							}
+						}
 					}
 					/* Append new options */
-					if (k == kh_end(cur->options)) {
+					if (!found) {
 						opt = rspamd_mempool_alloc0(task->task_pool, sizeof(*opt));
 						opt->optlen = cpy_len;
 						opt->option = opt_cpy;
 
-						kh_put(rspamd_options_hash, cur->options, opt, &r);
+						if (cur->options == NULL &&
+							cur->nopts >= RSPAMD_OPTS_HASH_THRESHOLD) {
+							struct rspamd_symbol_option *list_opt;
+
+							/* The list has outgrown linear scans, promote it */
+							cur->options = kh_init(rspamd_options_hash);
+							kh_resize(rspamd_options_hash, cur->options,
+									  cur->nopts + 1);
+
+							DL_FOREACH(cur->opts_head, list_opt)
+							{
+								kh_put(rspamd_options_hash, cur->options, list_opt, &r);
+							}
+						}
+
+						if (cur->options) {
+							kh_put(rspamd_options_hash, cur->options, opt, &r);
+						}
+
 						DL_APPEND(cur->opts_head, opt);
+						cur->nopts++;
 
 						if (s == cur) {
 							ret = TRUE;
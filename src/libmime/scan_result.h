@@ -57,6 +57,7 @@ struct rspamd_symbol_result {
 	const char *name;
 	struct rspamd_symbol *sym; /**< symbol configuration					*/
 	gssize opts_len;           /**< total size of all options (negative if truncated option is added) */
+	unsigned int nopts;        /**< number of options						*/
 	unsigned int nshots;
 	int flags;
 	struct rspamd_symbol_result *next; /**< for shadow results */
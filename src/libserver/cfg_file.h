@@ -68,6 +68,7 @@ enum rspamd_log_cfg_flags {
 	RSPAMD_LOG_FLAG_ENFORCED = (1u << 5u),
 	RSPAMD_LOG_FLAG_SEVERITY = (1u << 6u),
 	RSPAMD_LOG_FLAG_JSON = (1u << 7u),
+	RSPAMD_LOG_FLAG_BINARY = (1u << 8u),
 };
 
 struct rspamd_worker_log_pipe {
@@ -214,6 +215,10 @@ struct rspamd_worker_conf {
 	ucl_object_t *options;                     /**< other worker's options								*/
 	struct rspamd_worker_lua_script *scripts;  /**< registered lua scripts								*/
 	gboolean enabled;
+	gboolean pin_to_cpu;         /**< pin spawned workers to CPU cores round-robin		*/
+	gboolean pin_to_node;        /**< pin spawned workers to NUMA nodes round-robin		*/
+	double last_respawn;         /**< when a worker of this conf was respawned last		*/
+	unsigned int respawn_count;  /**< consecutive respawns without a quiet period		*/
 	ref_entry_t ref;
 };
 
@@ -363,18 +368,22 @@ struct rspamd_config {
 	gboolean enable_experimental;                            /**< Enable experimental plugins						*/
 	gboolean disable_pcre_jit;                               /**< Disable pcre JIT									*/
 	gboolean own_lua_state;                                  /**< True if we have created lua_state internally		*/
+	gboolean disable_doc_strings;                            /**< Do not collect documentation strings on config parsing */
 	gboolean soft_reject_on_timeout;                         /**< If true emit soft reject on task timeout (if not reject) */
 	gboolean public_groups_only;                             /**< Output merely public groups everywhere				*/
 	enum rspamd_gtube_patterns_policy gtube_patterns_policy; /**< Enable test patterns								*/
 	gboolean enable_css_parser;                              /**< Enable css parsing in HTML							*/
 	gboolean enable_mime_utf;                                /**< Enable utf8 mime parsing							*/
+	gboolean enable_re_hit_stats;                            /**< Enable shared per-regexp hit counters in re cache	*/
 
 	gsize max_cores_size;        /**< maximum size occupied by rspamd core files			*/
 	gsize max_cores_count;       /**< maximum number of core files						*/
 	char *cores_dir;             /**< directory for core files							*/
 	gsize max_message;           /**< maximum size for messages							*/
+	gsize max_task_pool_size;    /**< watermark of task pool memory to degrade processing (0 for unlimited) */
 	gsize max_pic_size;          /**< maximum size for a picture to process				*/
 	gsize images_cache_size;     /**< size of LRU cache for DCT data from images			*/
+	gsize max_archive_files;     /**< maximum number of files listed per archive (0 for unlimited) */
 	double task_timeout;         /**< maximum message processing time					*/
 	int default_max_shots;       /**< default maximum count of symbols hits permitted (-1 for unlimited) */
 	int32_t heartbeats_loss_max; /**< number of heartbeats lost to consider worker's termination */
@@ -385,6 +394,7 @@ struct rspamd_config {
 	int log_level;                                      /**< log level trigger									*/
 	char *log_file;                                     /**< path to logfile in case of file logging			*/
 	gboolean log_buffered;                              /**< whether logging is buffered						*/
+	gboolean log_async;                                 /**< drain log lines via a background flusher thread	*/
 	gboolean log_silent_workers;                        /**< silence info messages from workers					*/
 	uint32_t log_buf_size;                              /**< length of log buffer								*/
 	const ucl_object_t *debug_ip_map;                   /**< turn on debugging for specified ip addresses       */
@@ -416,6 +426,7 @@ struct rspamd_config {
 	GHashTable *cfg_params;                          /**< all cfg params indexed by its name in this structure */
 	char *dynamic_conf;                              /**< path to dynamic configuration						*/
 	ucl_object_t *current_dynamic_conf;              /**< currently loaded dynamic configuration				*/
+	GHashTable *dynamic_conf_index;                  /**< dynamic conf elements indexed by name				*/
 	int clock_res;                                   /**< resolution of clock used							*/
 
 	GList *maps;                      /**< maps active										*/
@@ -470,6 +481,10 @@ struct rspamd_config {
 	unsigned int max_blas_threads;   /**< maximum threads for openblas when learning ANN		*/
 	unsigned int max_opts_len;       /**< maximum length for all options for a symbol		*/
 	gsize max_html_len;              /**< maximum length of HTML document					*/
+	unsigned int max_html_tags;      /**< maximum number of HTML tags retained per document	*/
+	unsigned int cpu_sampler_hz;     /**< frequency of the SIGPROF symbols sampler (0 to disable)	*/
+	unsigned int verdict_cache_size; /**< per worker verdict cache elements (0 to disable)	*/
+	double verdict_cache_ttl;        /**< TTL of cached verdicts							*/
 
 	struct module_s **compiled_modules;   /**< list of compiled C modules							*/
 	struct worker_s **compiled_workers;   /**< list of compiled C modules							*/
@@ -518,6 +533,7 @@ enum rspamd_config_init_flags {
 	RSPAMD_CONFIG_INIT_DEFAULT = 0u,
 	RSPAMD_CONFIG_INIT_SKIP_LUA = (1u << 0u),
 	RSPAMD_CONFIG_INIT_WIPE_LUA_MEM = (1u << 1u),
+	RSPAMD_CONFIG_INIT_NO_DOC_STRINGS = (1u << 2u),
 };
 
 /**
@@ -637,6 +653,28 @@ void rspamd_ucl_add_conf_variables(struct ucl_parser *parser, GHashTable *vars);
  */
 gboolean rspamd_init_filters(struct rspamd_config *cfg, bool reconfig, bool strict);
 
+/**
+ * Enables recording of the startup phases durations
+ */
+void rspamd_config_profile_enable(void);
+
+/**
+ * Checks if the startup profiler has been enabled
+ */
+gboolean rspamd_config_profile_enabled(void);
+
+/**
+ * Records a named startup phase duration (in seconds); a no-op unless
+ * profiling has been enabled
+ */
+void rspamd_config_profile_add(const char *phase, double duration);
+
+/**
+ * Exports the recorded startup phases as an UCL object preserving the
+ * recording order; the caller owns the result
+ */
+ucl_object_t *rspamd_config_profile_export(void);
+
 /**
  * Add new symbol to the metric
  * @param cfg
@@ -289,6 +289,11 @@ rspamd_rcl_logging_handler(rspamd_mempool_t *pool, const ucl_object_t *obj,
 		cfg->log_flags |= RSPAMD_LOG_FLAG_JSON;
 	}
 
+	val = ucl_object_lookup_any(obj, "binary", "log_binary", nullptr);
+	if (val && ucl_object_toboolean(val)) {
+		cfg->log_flags |= RSPAMD_LOG_FLAG_BINARY;
+	}
+
 	val = ucl_object_lookup(obj, "log_re_cache");
 	if (val && ucl_object_toboolean(val)) {
 		cfg->log_flags |= RSPAMD_LOG_FLAG_RE_CACHE;
@@ -768,6 +773,8 @@ constexpr const auto known_worker_attributes = frozen::make_unordered_set<frozen
 	"max_files",
 	"max_core",
 	"enabled",
+	"pin_to_cpu",
+	"pin_to_node",
 });
 static gboolean
 rspamd_rcl_worker_handler(rspamd_mempool_t *pool, const ucl_object_t *obj,
@@ -1625,6 +1632,12 @@ struct rspamd_rcl_sections_map *
 rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 {
 	auto *top = new rspamd_rcl_sections_map;
+	/*
+	 * Documentation strings are consumed merely by rspamadm confighelp and
+	 * friends; the daemon skips their generation to avoid building a large
+	 * UCL tree on every start and reload
+	 */
+	auto *doc_strings = cfg->disable_doc_strings ? nullptr : cfg->doc_strings;
 	/*
 	 * Important notice:
 	 * the order of parsing is equal to order of this initialization, therefore
@@ -1641,7 +1654,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 											   UCL_OBJECT,
 											   FALSE,
 											   TRUE,
-											   cfg->doc_strings,
+											   doc_strings,
 											   "Configure rspamd logging");
 		/* Default handlers */
 		rspamd_rcl_add_default_handler(sub,
@@ -1650,6 +1663,12 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 									   G_STRUCT_OFFSET(struct rspamd_config, log_buf_size),
 									   RSPAMD_CL_FLAG_INT_32,
 									   "Size of log buffer in bytes (for file logging)");
+		rspamd_rcl_add_default_handler(sub,
+									   "log_async",
+									   rspamd_rcl_parse_struct_boolean,
+									   G_STRUCT_OFFSET(struct rspamd_config, log_async),
+									   0,
+									   "Drain log lines via a background flusher thread (for file logging)");
 		rspamd_rcl_add_default_handler(sub,
 									   "log_urls",
 									   rspamd_rcl_parse_struct_boolean,
@@ -1758,7 +1777,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 											   UCL_OBJECT,
 											   FALSE,
 											   TRUE,
-											   cfg->doc_strings,
+											   doc_strings,
 											   "Global Rspamd options");
 		rspamd_rcl_add_default_handler(sub,
 									   "cache_file",
@@ -1936,6 +1955,12 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 									   G_STRUCT_OFFSET(struct rspamd_config, enable_mime_utf),
 									   0,
 									   "Enable UTF8 mode for mime");
+		rspamd_rcl_add_default_handler(sub,
+									   "enable_re_hit_stats",
+									   rspamd_rcl_parse_struct_boolean,
+									   G_STRUCT_OFFSET(struct rspamd_config, enable_re_hit_stats),
+									   0,
+									   "Enable shared per-regexp hit counters in the regexp cache");
 		rspamd_rcl_add_default_handler(sub,
 									   "enable_experimental",
 									   rspamd_rcl_parse_struct_boolean,
@@ -1966,6 +1991,32 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 									   G_STRUCT_OFFSET(struct rspamd_config, max_word_len),
 									   RSPAMD_CL_FLAG_INT_SIZE,
 									   "Maximum length of the html part to be parsed");
+		rspamd_rcl_add_default_handler(sub,
+									   "max_html_tags",
+									   rspamd_rcl_parse_struct_integer,
+									   G_STRUCT_OFFSET(struct rspamd_config, max_html_tags),
+									   RSPAMD_CL_FLAG_UINT,
+									   "Maximum number of HTML tags retained when parsing a document");
+		rspamd_rcl_add_default_handler(sub,
+									   "cpu_sampler_hz",
+									   rspamd_rcl_parse_struct_integer,
+									   G_STRUCT_OFFSET(struct rspamd_config, cpu_sampler_hz),
+									   RSPAMD_CL_FLAG_UINT,
+									   "Frequency of the per-symbol CPU sampling profiler in Hz "
+									   "(0, disabled, by default)");
+		rspamd_rcl_add_default_handler(sub,
+									   "verdict_cache_size",
+									   rspamd_rcl_parse_struct_integer,
+									   G_STRUCT_OFFSET(struct rspamd_config, verdict_cache_size),
+									   RSPAMD_CL_FLAG_UINT,
+									   "Number of recent verdicts cached by message digest to short "
+									   "circuit duplicate scans (0, disabled, by default)");
+		rspamd_rcl_add_default_handler(sub,
+									   "verdict_cache_ttl",
+									   rspamd_rcl_parse_struct_time,
+									   G_STRUCT_OFFSET(struct rspamd_config, verdict_cache_ttl),
+									   RSPAMD_CL_FLAG_TIME_FLOAT,
+									   "TTL of cached verdicts (1 minute by default)");
 		rspamd_rcl_add_default_handler(sub,
 									   "words_decay",
 									   rspamd_rcl_parse_struct_integer,
@@ -2074,12 +2125,25 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 									   G_STRUCT_OFFSET(struct rspamd_config, max_message),
 									   RSPAMD_CL_FLAG_INT_SIZE,
 									   "Maximum size of the message to be scanned (50Mb by default)");
+		rspamd_rcl_add_default_handler(sub,
+									   "max_task_pool_size",
+									   rspamd_rcl_parse_struct_integer,
+									   G_STRUCT_OFFSET(struct rspamd_config, max_task_pool_size),
+									   RSPAMD_CL_FLAG_INT_SIZE,
+									   "Watermark of per-task pool memory after which text parts "
+									   "processing is degraded (unlimited by default)");
 		rspamd_rcl_add_default_handler(sub,
 									   "max_pic",
 									   rspamd_rcl_parse_struct_integer,
 									   G_STRUCT_OFFSET(struct rspamd_config, max_pic_size),
 									   RSPAMD_CL_FLAG_INT_SIZE,
 									   "Maximum size of the picture to be normalized (1Mb by default)");
+		rspamd_rcl_add_default_handler(sub,
+									   "max_archive_files",
+									   rspamd_rcl_parse_struct_integer,
+									   G_STRUCT_OFFSET(struct rspamd_config, max_archive_files),
+									   RSPAMD_CL_FLAG_INT_SIZE,
+									   "Maximum number of files listed per archive (8192 by default, 0 means unlimited)");
 		rspamd_rcl_add_default_handler(sub,
 									   "images_cache",
 									   rspamd_rcl_parse_struct_integer,
@@ -2222,7 +2286,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 		rspamd_rcl_add_section_doc(&top, sub, "neighbours", "name",
 								   rspamd_rcl_neighbours_handler,
 								   UCL_OBJECT, FALSE, TRUE,
-								   cfg->doc_strings,
+								   doc_strings,
 								   "List of members of Rspamd cluster");
 
 		/* New DNS configuration */
@@ -2321,7 +2385,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 											   UCL_OBJECT,
 											   FALSE,
 											   TRUE,
-											   cfg->doc_strings,
+											   doc_strings,
 											   "Actions configuration");
 		rspamd_rcl_add_default_handler(sub,
 									   "unknown_weight",
@@ -2352,12 +2416,12 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 											   UCL_OBJECT,
 											   FALSE,
 											   TRUE,
-											   cfg->doc_strings,
+											   doc_strings,
 											   "Symbol groups configuration");
 		rspamd_rcl_add_section_doc(&top, sub, "symbols", "name",
 								   rspamd_rcl_symbol_handler,
 								   UCL_OBJECT, FALSE, TRUE,
-								   cfg->doc_strings,
+								   doc_strings,
 								   "Symbols configuration");
 
 		/* Group part */
@@ -2384,7 +2448,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 											   UCL_OBJECT,
 											   FALSE,
 											   TRUE,
-											   cfg->doc_strings,
+											   doc_strings,
 											   "Workers common options");
 		rspamd_rcl_add_default_handler(sub,
 									   "count",
@@ -2410,6 +2474,18 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 									   G_STRUCT_OFFSET(struct rspamd_worker_conf, enabled),
 									   0,
 									   "Enable or disable a worker (true by default)");
+		rspamd_rcl_add_default_handler(sub,
+									   "pin_to_cpu",
+									   rspamd_rcl_parse_struct_boolean,
+									   G_STRUCT_OFFSET(struct rspamd_worker_conf, pin_to_cpu),
+									   0,
+									   "Pin workers to CPU cores round-robin (false by default)");
+		rspamd_rcl_add_default_handler(sub,
+									   "pin_to_node",
+									   rspamd_rcl_parse_struct_boolean,
+									   G_STRUCT_OFFSET(struct rspamd_worker_conf, pin_to_node),
+									   0,
+									   "Pin workers to NUMA nodes round-robin (false by default)");
 	}
 
 	if (!(skip_sections && g_hash_table_lookup(skip_sections, "modules"))) {
@@ -2422,7 +2498,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 								   UCL_OBJECT,
 								   FALSE,
 								   FALSE,
-								   cfg->doc_strings,
+								   doc_strings,
 								   "Lua plugins to load");
 	}
 
@@ -2436,7 +2512,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 											   UCL_OBJECT,
 											   FALSE,
 											   TRUE,
-											   cfg->doc_strings,
+											   doc_strings,
 											   "CLassifier options");
 		/* Default classifier is 'bayes' for now */
 		sub->default_key = "bayes";
@@ -2519,7 +2595,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 								   UCL_OBJECT,
 								   FALSE,
 								   TRUE,
-								   cfg->doc_strings,
+								   doc_strings,
 								   "Rspamd composite symbols");
 		rspamd_rcl_add_section_doc(&top, nullptr,
 								   "composites", nullptr,
@@ -2527,7 +2603,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 								   UCL_OBJECT,
 								   FALSE,
 								   TRUE,
-								   cfg->doc_strings,
+								   doc_strings,
 								   "Rspamd composite symbols");
 	}
 
@@ -2541,7 +2617,7 @@ rspamd_rcl_config_init(struct rspamd_config *cfg, GHashTable *skip_sections)
 								   UCL_STRING,
 								   FALSE,
 								   TRUE,
-								   cfg->doc_strings,
+								   doc_strings,
 								   "Lua files to load");
 	}
 
@@ -3378,6 +3454,10 @@ void rspamd_rcl_register_worker_option(struct rspamd_config *cfg,
 	nhandler.parser.user_struct = target;
 	nhandler.handler = handler;
 
+	if (cfg->disable_doc_strings) {
+		return;
+	}
+
 	const auto *doc_workers = ucl_object_lookup(cfg->doc_strings, "workers");
 
 	if (doc_workers == nullptr) {
@@ -4001,6 +4081,10 @@ rspamd_rcl_add_doc_by_path(struct rspamd_config *cfg,
 {
 	const auto *cur = cfg->doc_strings;
 
+	if (cfg->disable_doc_strings) {
+		return nullptr;
+	}
+
 	if (doc_path == nullptr) {
 		/* Assume top object */
 		return rspamd_rcl_add_doc_obj(cfg->doc_strings,
@@ -4107,6 +4191,10 @@ rspamd_rcl_add_doc_by_example(struct rspamd_config *cfg,
 							  const char *doc_name,
 							  const char *example_data, gsize example_len)
 {
+	if (cfg->disable_doc_strings) {
+		return nullptr;
+	}
+
 	auto parser = std::shared_ptr<ucl_parser>(ucl_parser_new(UCL_PARSER_NO_FILEVARS | UCL_PARSER_SAVE_COMMENTS), ucl_parser_free);
 
 	if (!ucl_parser_add_chunk(parser.get(), reinterpret_cast<const unsigned char *>(example_data), example_len)) {
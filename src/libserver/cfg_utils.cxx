@@ -64,6 +64,7 @@
 
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 #include "contrib/fmt/include/fmt/base.h"
 #include "cxx/util.hxx"
@@ -83,10 +84,12 @@
 #define DEFAULT_WORDS_DECAY 600
 #define DEFAULT_MAX_MESSAGE (50 * 1024 * 1024)
 #define DEFAULT_MAX_PIC (1 * 1024 * 1024)
+#define DEFAULT_MAX_ARCHIVE_FILES 8192
 #define DEFAULT_MAX_SHOTS 100
 #define DEFAULT_MAX_SESSIONS 100
 #define DEFAULT_MAX_WORKERS 4
 #define DEFAULT_MAX_HTML_SIZE DEFAULT_MAX_MESSAGE / 5 /* 10 Mb */
+#define DEFAULT_MAX_HTML_TAGS 8192
 /* Timeout for task processing */
 #define DEFAULT_TASK_TIMEOUT 8.0
 #define DEFAULT_LUA_GC_STEP 200
@@ -226,6 +229,7 @@ rspamd_config_new(enum rspamd_config_init_flags flags)
 	cfg->cfg_pool = pool;
 	cfg->dns_timeout = 1.0;
 	cfg->dns_retransmits = 5;
+	cfg->verdict_cache_ttl = 60.0;
 	/* 16 sockets per DNS server */
 	cfg->dns_io_per_server = 16;
 	cfg->unknown_weight = NAN;
@@ -303,6 +307,7 @@ rspamd_config_new(enum rspamd_config_init_flags flags)
 	cfg->min_word_len = DEFAULT_MIN_WORD;
 	cfg->max_word_len = DEFAULT_MAX_WORD;
 	cfg->max_html_len = DEFAULT_MAX_HTML_SIZE;
+	cfg->max_html_tags = DEFAULT_MAX_HTML_TAGS;
 
 	/* GC limits */
 	cfg->lua_gc_pause = DEFAULT_LUA_GC_PAUSE;
@@ -318,6 +323,10 @@ rspamd_config_new(enum rspamd_config_init_flags flags)
 		cfg->lua_thread_pool = (void *) lua_thread_pool_new(RSPAMD_LUA_CFG_STATE(cfg));
 	}
 
+	if (flags & RSPAMD_CONFIG_INIT_NO_DOC_STRINGS) {
+		cfg->disable_doc_strings = TRUE;
+	}
+
 	cfg->cache = rspamd_symcache_new(cfg);
 	cfg->ups_ctx = rspamd_upstreams_library_init();
 	cfg->re_cache = rspamd_re_cache_new();
@@ -331,6 +340,7 @@ rspamd_config_new(enum rspamd_config_init_flags flags)
 	cfg->max_message = DEFAULT_MAX_MESSAGE;
 	cfg->max_pic_size = DEFAULT_MAX_PIC;
 	cfg->images_cache_size = 256;
+	cfg->max_archive_files = DEFAULT_MAX_ARCHIVE_FILES;
 	cfg->monitored_ctx = rspamd_monitored_ctx_init();
 	cfg->neighbours = ucl_object_typed_new(UCL_OBJECT);
 	cfg->redis_pool = rspamd_redis_pool_init();
@@ -342,6 +352,7 @@ rspamd_config_new(enum rspamd_config_init_flags flags)
 
 	cfg->enable_css_parser = true;
 	cfg->enable_mime_utf = false;
+	cfg->enable_re_hit_stats = false;
 	cfg->script_modules = g_ptr_array_new();
 
 	REF_INIT_RETAIN(cfg, rspamd_config_free);
@@ -829,6 +840,7 @@ rspamd_config_post_load(struct rspamd_config *cfg,
 						enum rspamd_post_load_options opts)
 {
 	auto ret = tl::expected<void, std::string>{};
+	auto url_init_thread = std::thread{};
 
 	rspamd_adjust_clocks_resolution(cfg);
 	rspamd_logger_configure_modules(cfg->debug_modules);
@@ -888,12 +900,15 @@ rspamd_config_post_load(struct rspamd_config *cfg,
 			}
 		}
 
-		if (opts & RSPAMD_CONFIG_INIT_NO_TLD) {
-			rspamd_url_init(nullptr);
-		}
-		else {
-			rspamd_url_init(cfg->tld_file);
-		}
+		/*
+		 * Compilation of the TLD trie is independent from the symcache and
+		 * hyperscan cache initialisation below, so overlap the two slowest
+		 * startup stages; the thread is joined before anything can touch
+		 * the url scanner
+		 */
+		url_init_thread = std::thread{[tld = (opts & RSPAMD_CONFIG_INIT_NO_TLD) ? nullptr : cfg->tld_file]() {
+			rspamd_url_init(tld);
+		}};
 
 		rspamd_mempool_add_destructor(cfg->cfg_pool, rspamd_urls_config_dtor,
 									  nullptr);
@@ -932,6 +947,10 @@ rspamd_config_post_load(struct rspamd_config *cfg,
 		}
 	}
 
+	if (url_init_thread.joinable()) {
+		url_init_thread.join();
+	}
+
 	if (opts & RSPAMD_CONFIG_INIT_LIBS) {
 		/* Config other libraries */
 		auto libs_ret = rspamd_config_libs(cfg->libs_ctx, cfg);
@@ -1457,6 +1476,42 @@ rspamd_check_worker(struct rspamd_config *cfg, worker_t *wrk)
 	return ret;
 }
 
+/* Startup profiler state; meaningful merely in the process doing the load */
+static bool config_profile_on = false;
+static std::vector<std::pair<std::string, double>> config_profile_phases;
+
+void rspamd_config_profile_enable(void)
+{
+	config_profile_on = true;
+	config_profile_phases.clear();
+}
+
+gboolean
+rspamd_config_profile_enabled(void)
+{
+	return config_profile_on;
+}
+
+void rspamd_config_profile_add(const char *phase, double duration)
+{
+	if (config_profile_on) {
+		config_profile_phases.emplace_back(phase, duration);
+	}
+}
+
+ucl_object_t *
+rspamd_config_profile_export(void)
+{
+	auto *top = ucl_object_typed_new(UCL_OBJECT);
+
+	for (const auto &[phase, duration]: config_profile_phases) {
+		ucl_object_insert_key(top, ucl_object_fromdouble(duration),
+							  phase.c_str(), 0, true);
+	}
+
+	return top;
+}
+
 gboolean
 rspamd_init_filters(struct rspamd_config *cfg, bool reconfig, bool strict)
 {
@@ -1508,6 +1563,8 @@ rspamd_init_filters(struct rspamd_config *cfg, bool reconfig, bool strict)
 				}
 			}
 			else {
+				auto mod_ticks = rspamd_get_ticks(FALSE);
+
 				if (!mod->module_config_func(cfg, strict)) {
 					msg_err_config("config of %s failed", mod->name);
 					ret = FALSE;
@@ -1516,6 +1573,12 @@ rspamd_init_filters(struct rspamd_config *cfg, bool reconfig, bool strict)
 						return FALSE;
 					}
 				}
+
+				if (config_profile_on) {
+					rspamd_config_profile_add(
+						fmt::format("module/{}", mod->name).c_str(),
+						rspamd_get_ticks(FALSE) - mod_ticks);
+				}
 			}
 		}
 
@@ -2705,9 +2768,10 @@ rspamd_open_zstd_dictionary(const char *path)
 		return nullptr;
 	}
 
-	dict->id = -1;
+	dict->id = rspamd_zstd_dictionary_id(dict->dict, dict->size);
 
 	if (dict->id == 0) {
+		munmap(dict->dict, dict->size);
 		g_free(dict);
 
 		return nullptr;
@@ -2833,6 +2897,12 @@ rspamd_config_libs(struct rspamd_external_libs_ctx *ctx,
 		ctx->in_zstream = ZSTD_createDStream();
 		r = ZSTD_initDStream((ZSTD_DCtx *) ctx->in_zstream);
 
+		if (!ZSTD_isError(r) && ctx->in_dict) {
+			/* Survives session resets, so it is loaded merely once */
+			r = ZSTD_DCtx_loadDictionary((ZSTD_DCtx *) ctx->in_zstream,
+										 ctx->in_dict->dict, ctx->in_dict->size);
+		}
+
 		if (ZSTD_isError(r)) {
 			msg_err("cannot init decompression stream: %s",
 					ZSTD_getErrorName(r));
@@ -2844,6 +2914,11 @@ rspamd_config_libs(struct rspamd_external_libs_ctx *ctx,
 		ctx->out_zstream = ZSTD_createCStream();
 		r = ZSTD_initCStream((ZSTD_CCtx *) ctx->out_zstream, 1);
 
+		if (!ZSTD_isError(r) && ctx->out_dict) {
+			r = ZSTD_CCtx_loadDictionary((ZSTD_CCtx *) ctx->out_zstream,
+										 ctx->out_dict->dict, ctx->out_dict->size);
+		}
+
 		if (ZSTD_isError(r)) {
 			msg_err("cannot init compression stream: %s",
 					ZSTD_getErrorName(r));
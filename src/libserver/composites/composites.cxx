@@ -70,6 +70,12 @@ namespace rspamd::composites {
 
 static constexpr const double epsilon = 0.00001;
 
+/*
+ * Dense ids assigned to atoms at parse time; used to memoise atom results
+ * within a single evaluation round (one scan result of one task)
+ */
+static unsigned int rspamd_composite_atoms_count = 0;
+
 struct symbol_remove_data {
 	const char *sym;
 	struct rspamd_composite *comp;
@@ -85,12 +91,61 @@ struct composites_data {
 								 std::vector<symbol_remove_data>>
 		symbols_to_remove;
 	std::vector<bool> checked;
+	/*
+	 * Symcache ids of the inserted symbols: composite atoms mostly reference
+	 * symbols that are absent from the result, so a clear bit rejects an atom
+	 * with a couple of bitwise ops instead of a string hash lookup per
+	 * evaluation. A set bit is merely a hint (virtual siblings share the
+	 * parent id) and falls through to the real lookup
+	 */
+	std::vector<bool> present_ids;
+	/*
+	 * Atom results memoised within this round, keyed by the dense atom id;
+	 * NAN marks an atom that has not been evaluated yet. Composites that
+	 * share atoms with already evaluated ones thus pay for a vector load
+	 * instead of repeating symbol lookups and option matching
+	 */
+	std::vector<double> atom_memo;
+	unsigned int atom_evals = 0;
+	unsigned int memo_hits = 0;
+	bool maybe_unknown_symbols = false;
 
 	explicit composites_data(struct rspamd_task *task, struct rspamd_scan_result *mres)
 		: task(task), composite(nullptr), metric_res(mres)
 	{
 		checked.resize(rspamd_composites_manager_nelts(task->cfg->composites_manager) * 2,
 					   false);
+		atom_memo.resize(rspamd_composite_atoms_count, NAN);
+
+		rspamd_task_symbol_result_foreach(
+			task, mres,
+			+[](gpointer k, gpointer, gpointer ud) {
+				auto *self = static_cast<composites_data *>(ud);
+				auto id = rspamd_symcache_find_symbol(self->task->cfg->cache,
+													  (const char *) k);
+
+				if (id < 0) {
+					/* A symbol unknown to the cache disables fast rejection */
+					self->maybe_unknown_symbols = true;
+				}
+				else {
+					if (id >= (int) self->present_ids.size()) {
+						self->present_ids.resize(id + 1, false);
+					}
+
+					self->present_ids[id] = true;
+				}
+			},
+			this);
+	}
+
+	auto symbol_maybe_inserted(int id) const -> bool
+	{
+		if (id < 0 || maybe_unknown_symbols) {
+			return true;
+		}
+
+		return id < (int) present_ids.size() && present_ids[id];
 	}
 };
 
@@ -204,9 +259,16 @@ enum class rspamd_composite_atom_type {
 	ATOM_PLAIN
 };
 
+/* Atom symcache id that has not been resolved yet */
+constexpr int COMPOSITE_ATOM_ID_UNRESOLVED = -2;
+
 struct rspamd_composite_atom {
 	std::string symbol;
 	std::string_view norm_symbol;
+	/* Dense id of this atom, see rspamd_composite_atoms_count */
+	unsigned int atom_id = 0;
+	/* Dense symcache id of the symbol, resolved lazily on the first use */
+	int sym_id = COMPOSITE_ATOM_ID_UNRESOLVED;
 	rspamd_composite_atom_type comp_type = rspamd_composite_atom_type::ATOM_UNKNOWN;
 	const struct rspamd_composite *ncomp; /* underlying composite */
 	std::vector<rspamd_composite_option_match> opts;
@@ -345,6 +407,7 @@ rspamd_composite_expr_parse(const char *line, gsize len,
 	state = comp_state_read_symbol;
 
 	auto *atom = new rspamd_composite_atom;
+	atom->atom_id = rspamd_composite_atoms_count++;
 	auto *res = rspamd_mempool_alloc0_type(pool, rspamd_expression_atom_t);
 	res->len = clen;
 	res->str = line;
@@ -575,8 +638,23 @@ process_single_symbol(struct composites_data *cd,
 	struct rspamd_symbol_result *ms = nullptr;
 	double rc = 0;
 	struct rspamd_task *task = cd->task;
+	auto maybe_present = true;
 
-	if ((ms = rspamd_task_find_symbol_result(cd->task, sym.data(), cd->metric_res)) == nullptr) {
+	if (sym.data() == atom->norm_symbol.data()) {
+		/* A plain atom, not a group expansion: the cached id is usable */
+		if (G_UNLIKELY(atom->sym_id == COMPOSITE_ATOM_ID_UNRESOLVED)) {
+			atom->sym_id = rspamd_symcache_find_symbol(task->cfg->cache,
+													   sym.data());
+		}
+
+		maybe_present = cd->symbol_maybe_inserted(atom->sym_id);
+	}
+
+	if (maybe_present) {
+		ms = rspamd_task_find_symbol_result(cd->task, sym.data(), cd->metric_res);
+	}
+
+	if (ms == nullptr) {
 		msg_debug_composites("not found symbol %s in composite %s", sym.data(),
 							 cd->composite->sym.c_str());
 
@@ -700,6 +778,26 @@ rspamd_composite_expr_process(void *ud, rspamd_expression_atom_t *atom) -> doubl
 		return rc;
 	}
 
+	if (comp_atom->atom_id < cd->atom_memo.size()) {
+		auto memo = cd->atom_memo[comp_atom->atom_id];
+
+		if (!std::isnan(memo)) {
+			/*
+			 * Already evaluated within this round; the removal requests for
+			 * this atom were registered on the first evaluation
+			 */
+			cd->memo_hits++;
+			msg_debug_composites("%s: memoised result for atom %s in composite %s is %.4f",
+								 cd->metric_res->name,
+								 comp_atom->norm_symbol.data(),
+								 cd->composite->sym.c_str(), memo);
+
+			return memo;
+		}
+	}
+
+	cd->atom_evals++;
+
 	/* Note: sym is zero terminated as it is a view on std::string */
 	auto sym = comp_atom->norm_symbol;
 	auto group_process_functor = [&](auto cond, int sub_start) -> double {
@@ -778,6 +876,10 @@ rspamd_composite_expr_process(void *ud, rspamd_expression_atom_t *atom) -> doubl
 						 comp_atom->norm_symbol.data(),
 						 cd->composite->sym.c_str(), rc);
 
+	if (comp_atom->atom_id < cd->atom_memo.size()) {
+		cd->atom_memo[comp_atom->atom_id] = rc;
+	}
+
 	return rc;
 }
 
@@ -968,6 +1070,11 @@ composites_metric_callback(struct rspamd_task *task)
 										   task->cfg->cache,
 										   composites_foreach_callback,
 										   &cd);
+
+		msg_debug_composites("%s: composites round %z done: %d atoms evaluated, "
+							 "%d memoised",
+							 mres->name, comp_data_vec.size(),
+							 cd.atom_evals, cd.memo_hits);
 	}
 
 	for (const auto &cd: comp_data_vec) {
@@ -34,9 +34,9 @@ public:
 	using sel_shared_hash = smart_ptr_hash<css_selector>;
 	using sel_shared_eq = smart_ptr_equal<css_selector>;
 	using selector_ptr = std::unique_ptr<css_selector>;
-	using selectors_hash = ankerl::unordered_dense::map<selector_ptr, css_declarations_block_ptr,
+	using selectors_hash = ankerl::unordered_dense::map<selector_ptr, css_lazy_declarations_ptr,
 														sel_shared_hash, sel_shared_eq>;
-	using universal_selector_t = std::pair<selector_ptr, css_declarations_block_ptr>;
+	using universal_selector_t = std::pair<selector_ptr, css_lazy_declarations_ptr>;
 	selectors_hash tags_selector;
 	selectors_hash class_selectors;
 	selectors_hash id_selectors;
@@ -52,16 +52,18 @@ css_style_sheet::~css_style_sheet()
 }
 
 auto css_style_sheet::add_selector_rule(std::unique_ptr<css_selector> &&selector,
-										css_declarations_block_ptr decls) -> void
+										css_lazy_declarations_ptr decls) -> void
 {
 	impl::selectors_hash *target_hash = nullptr;
 
 	switch (selector->type) {
 	case css_selector::selector_type::SELECTOR_ALL:
 		if (pimpl->universal_selector) {
-			/* Another universal selector */
+			/* Another universal selector; duplicates are rare enough to afford
+			 * eager processing on merging */
 			msg_debug_css("redefined universal selector, merging rules");
-			pimpl->universal_selector->second->merge_block(*decls);
+			pimpl->universal_selector->second->materialise(pool)->merge_block(
+				*decls->materialise(pool));
 		}
 		else {
 			msg_debug_css("added universal selector");
@@ -100,7 +102,7 @@ auto css_style_sheet::add_selector_rule(std::unique_ptr<css_selector> &&selector
 			auto sel_str = selector->to_string().value_or("unknown");
 			msg_debug_css("found duplicate selector: %*s", (int) sel_str.size(),
 						  sel_str.data());
-			found_it->second->merge_block(*decls);
+			found_it->second->materialise(pool)->merge_block(*decls->materialise(pool));
 		}
 	}
 }
@@ -129,8 +131,11 @@ auto css_style_sheet::check_tag_block(const rspamd::html::html_tag *tag) -> rspa
 		auto found_id_sel = pimpl->id_selectors.find(css_selector{id_comp.value()});
 
 		if (found_id_sel != pimpl->id_selectors.end()) {
-			const auto &decl = *(found_id_sel->second);
-			res = decl.compile_to_block(pool);
+			const auto &decl = *(found_id_sel->second->materialise(pool));
+
+			if (!decl.get_rules().empty()) {
+				res = decl.compile_to_block(pool);
+			}
 		}
 	}
 
@@ -163,7 +168,31 @@ auto css_style_sheet::check_tag_block(const rspamd::html::html_tag *tag) -> rspa
 				css_selector{e, css_selector::selector_type::SELECTOR_CLASS});
 
 			if (found_class_sel != pimpl->class_selectors.end()) {
-				const auto &decl = *(found_class_sel->second);
+				const auto &decl = *(found_class_sel->second->materialise(pool));
+
+				if (!decl.get_rules().empty()) {
+					auto *tmp = decl.compile_to_block(pool);
+
+					if (res == nullptr) {
+						res = tmp;
+					}
+					else {
+						res->propagate_block(*tmp);
+					}
+				}
+			}
+		}
+	}
+
+	/* Tags part */
+	if (!pimpl->tags_selector.empty()) {
+		auto found_tag_sel = pimpl->tags_selector.find(
+			css_selector{static_cast<tag_id_t>(tag->id)});
+
+		if (found_tag_sel != pimpl->tags_selector.end()) {
+			const auto &decl = *(found_tag_sel->second->materialise(pool));
+
+			if (!decl.get_rules().empty()) {
 				auto *tmp = decl.compile_to_block(pool);
 
 				if (res == nullptr) {
@@ -176,13 +205,11 @@ auto css_style_sheet::check_tag_block(const rspamd::html::html_tag *tag) -> rspa
 		}
 	}
 
-	/* Tags part */
-	if (!pimpl->tags_selector.empty()) {
-		auto found_tag_sel = pimpl->tags_selector.find(
-			css_selector{static_cast<tag_id_t>(tag->id)});
+	/* Finally, universal selector */
+	if (pimpl->universal_selector) {
+		const auto &decl = *(pimpl->universal_selector->second->materialise(pool));
 
-		if (found_tag_sel != pimpl->tags_selector.end()) {
-			const auto &decl = *(found_tag_sel->second);
+		if (!decl.get_rules().empty()) {
 			auto *tmp = decl.compile_to_block(pool);
 
 			if (res == nullptr) {
@@ -194,28 +221,16 @@ auto css_style_sheet::check_tag_block(const rspamd::html::html_tag *tag) -> rspa
 		}
 	}
 
-	/* Finally, universal selector */
-	if (pimpl->universal_selector) {
-		auto *tmp = pimpl->universal_selector->second->compile_to_block(pool);
-
-		if (res == nullptr) {
-			res = tmp;
-		}
-		else {
-			res->propagate_block(*tmp);
-		}
-	}
-
 	return res;
 }
 
 auto css_parse_style(rspamd_mempool_t *pool,
 					 std::string_view input,
-					 std::shared_ptr<css_style_sheet> &&existing)
+					 css_style_sheet_ptr &&existing)
 	-> css_return_pair
 {
 	auto parse_res = rspamd::css::parse_css(pool, input,
-											std::forward<std::shared_ptr<css_style_sheet>>(existing));
+											std::forward<css_style_sheet_ptr>(existing));
 
 	if (parse_res.has_value()) {
 		return std::make_pair(parse_res.value(), css_parse_error());
@@ -21,6 +21,7 @@
 #include <string>
 #include <memory>
 #include "logger.h"
+#include "libutil/cxx/local_shared_ptr.hxx"
 #include "css_rule.hxx"
 #include "css_selector.hxx"
 
@@ -48,7 +49,7 @@ public:
 	css_style_sheet(rspamd_mempool_t *pool);
 	~css_style_sheet(); /* must be declared separately due to pimpl */
 	auto add_selector_rule(std::unique_ptr<css_selector> &&selector,
-						   css_declarations_block_ptr decls) -> void;
+						   css_lazy_declarations_ptr decls) -> void;
 
 	auto check_tag_block(const rspamd::html::html_tag *tag) -> rspamd::html::html_block *;
 
@@ -58,10 +59,15 @@ private:
 	std::unique_ptr<impl> pimpl;
 };
 
-using css_return_pair = std::pair<std::shared_ptr<css_style_sheet>, css_parse_error>;
+/*
+ * A style sheet is built and consumed within a single task on the event
+ * loop, so it is shared with a local (non-atomic) refcount
+ */
+using css_style_sheet_ptr = rspamd::local_shared_ptr<css_style_sheet>;
+using css_return_pair = std::pair<css_style_sheet_ptr, css_parse_error>;
 auto css_parse_style(rspamd_mempool_t *pool,
 					 std::string_view input,
-					 std::shared_ptr<css_style_sheet> &&existing) -> css_return_pair;
+					 css_style_sheet_ptr &&existing) -> css_return_pair;
 
 }// namespace rspamd::css
 
@@ -161,7 +161,7 @@ public:
 	 * This constructor captures existing via unique_ptr, but it does not
 	 * destruct it on errors (we assume that it is owned somewhere else)
 	 */
-	explicit css_parser(std::shared_ptr<css_style_sheet> &&existing, rspamd_mempool_t *pool)
+	explicit css_parser(css_style_sheet_ptr &&existing, rspamd_mempool_t *pool)
 		: style_object(existing), pool(pool)
 	{
 		error.type = css_parse_error_type::PARSE_ERROR_NO_ERROR;
@@ -177,7 +177,7 @@ public:
 	std::unique_ptr<css_consumed_block> consume_css_rule(const std::string_view &sv);
 	std::optional<css_parse_error> consume_input(const std::string_view &sv);
 
-	auto get_object_maybe(void) -> tl::expected<std::shared_ptr<css_style_sheet>, css_parse_error>
+	auto get_object_maybe(void) -> tl::expected<css_style_sheet_ptr, css_parse_error>
 	{
 		if (style_object) {
 			return style_object;
@@ -190,7 +190,7 @@ public:
 	static bool need_unescape(const std::string_view &sv);
 
 private:
-	std::shared_ptr<css_style_sheet> style_object;
+	css_style_sheet_ptr style_object;
 	std::unique_ptr<css_tokeniser> tokeniser;
 
 	css_parse_error error;
@@ -624,14 +624,14 @@ css_parser::consume_input(const std::string_view &sv)
 	}
 
 	if (!style_object) {
-		style_object = std::make_shared<css_style_sheet>(pool);
+		style_object = rspamd::local_make_shared<css_style_sheet>(pool);
 	}
 
 	for (auto &&rule: rules) {
 		/*
 		 * For now, we do not need any of the at rules, so we can safely ignore them
 		 */
-		auto &&children = rule->get_blocks_or_empty();
+		auto &children = rule->get_blocks_mutable();
 
 		if (children.size() > 1 &&
 			children[0]->tag == css_consumed_block::parser_tag_type::css_component) {
@@ -643,60 +643,56 @@ css_parser::consume_input(const std::string_view &sv)
 			if (simple_block != children.end()) {
 				/*
 				 * We have a component and a simple block,
-				 * so we can parse a selector and then extract
-				 * declarations from a simple block
+				 * so we can parse a selector and then keep the simple block
+				 * raw; its declarations are processed lazily on the first
+				 * match of the selector (most rules never match anything
+				 * in the real markup)
 				 */
 
 				/* First, tag all components as preamble */
-				auto selector_it = children.cbegin();
+				auto prelude_len = static_cast<std::size_t>(
+					std::distance(children.begin(), simple_block));
 
-				auto selector_token_functor = [&selector_it, &simple_block](void)
-					-> const css_consumed_block & {
-					for (;;) {
-						if (selector_it == simple_block) {
-							return css_parser_eof_block;
-						}
-
-						const auto &ret = (*selector_it);
-
-						++selector_it;
+				/* Try the single scan fast path for `.class`/`#id` style
+				 * selectors that dominate mail CSS */
+				auto maybe_simple = try_process_simple_selectors(pool, children,
+																 prelude_len);
 
-						return *ret;
-					}
-				};
+				auto selectors_vec = maybe_simple ? std::move(maybe_simple.value())
+												  : rspamd::css::selectors_vec{};
 
-				auto selectors_vec = process_selector_tokens(pool, selector_token_functor);
+				if (!maybe_simple) {
+					auto selector_it = children.begin();
 
-				if (selectors_vec.size() > 0) {
-					msg_debug_css("processed %d selectors", (int) selectors_vec.size());
-					auto decls_it = (*simple_block)->get_blocks_or_empty().cbegin();
-					auto decls_end = (*simple_block)->get_blocks_or_empty().cend();
-					auto declaration_token_functor = [&decls_it, &decls_end](void)
+					auto selector_token_functor = [&selector_it, &simple_block](void)
 						-> const css_consumed_block & {
 						for (;;) {
-							if (decls_it == decls_end) {
+							if (selector_it == simple_block) {
 								return css_parser_eof_block;
 							}
 
-							const auto &ret = (*decls_it);
+							const auto &ret = (*selector_it);
 
-							++decls_it;
+							++selector_it;
 
 							return *ret;
 						}
 					};
 
-					auto declarations_vec = process_declaration_tokens(pool,
-																	   declaration_token_functor);
+					selectors_vec = process_selector_tokens(pool, selector_token_functor);
+				}
 
-					if (declarations_vec && !declarations_vec->get_rules().empty()) {
-						msg_debug_css("processed %d rules",
-									  (int) declarations_vec->get_rules().size());
+				if (selectors_vec.size() > 0) {
+					msg_debug_css("processed %d selectors", (int) selectors_vec.size());
 
-						for (auto &&selector: selectors_vec) {
-							style_object->add_selector_rule(std::move(selector),
-															declarations_vec);
-						}
+					/* Steal the raw block from the parse tree */
+					auto lazy_decls = std::make_shared<css_lazy_declarations>(
+						std::move(*simple_block));
+					children.erase(simple_block);
+
+					for (auto &&selector: selectors_vec) {
+						style_object->add_selector_rule(std::move(selector),
+														lazy_decls);
 					}
 				}
 			}
@@ -776,10 +772,10 @@ auto get_rules_parser_functor(rspamd_mempool_t *pool,
  * Wrapper for the parser
  */
 auto parse_css(rspamd_mempool_t *pool, const std::string_view &st,
-			   std::shared_ptr<css_style_sheet> &&other)
-	-> tl::expected<std::shared_ptr<css_style_sheet>, css_parse_error>
+			   rspamd::local_shared_ptr<css_style_sheet> &&other)
+	-> tl::expected<rspamd::local_shared_ptr<css_style_sheet>, css_parse_error>
 {
-	css_parser parser(std::forward<std::shared_ptr<css_style_sheet>>(other), pool);
+	css_parser parser(std::forward<rspamd::local_shared_ptr<css_style_sheet>>(other), pool);
 	std::string_view processed_input;
 
 	if (css_parser::need_unescape(st)) {
@@ -877,7 +873,7 @@ TEST_SUITE("css")
 		/* We now merge all styles together */
 		SUBCASE("merged css parse")
 		{
-			std::shared_ptr<css_style_sheet> merged;
+			css_style_sheet_ptr merged;
 			for (const auto &c: cases) {
 				auto ret = parse_css(pool, c, std::move(merged));
 				merged.swap(ret.value());
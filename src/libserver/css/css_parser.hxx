@@ -25,6 +25,7 @@
 #include <string>
 
 #include "function2/function2.hpp"
+#include "libutil/cxx/local_shared_ptr.hxx"
 #include "css_tokeniser.hxx"
 #include "parse_error.hxx"
 #include "contrib/expected/expected.hpp"
@@ -132,6 +133,16 @@ public:
 		return empty_block_vec;
 	}
 
+	/* Mutable accessor, used to steal children for lazy rules processing */
+	auto get_blocks_mutable() -> std::vector<consumed_block_ptr> &
+	{
+		if (!is_blocks_vec()) {
+			content = std::vector<consumed_block_ptr>();
+		}
+
+		return std::get<std::vector<consumed_block_ptr>>(content);
+	}
+
 	auto is_token() const -> bool
 	{
 		return (std::holds_alternative<css_parser_token>(content));
@@ -214,8 +225,8 @@ class css_style_sheet;
  * Update the existing stylesheet with another stylesheet
  */
 auto parse_css(rspamd_mempool_t *pool, const std::string_view &st,
-			   std::shared_ptr<css_style_sheet> &&other)
-	-> tl::expected<std::shared_ptr<css_style_sheet>, css_parse_error>;
+			   rspamd::local_shared_ptr<css_style_sheet> &&other)
+	-> tl::expected<rspamd::local_shared_ptr<css_style_sheet>, css_parse_error>;
 
 /*
  * Creates a functor to consume css selectors sequence
@@ -225,7 +225,9 @@ auto process_declaration_tokens(rspamd_mempool_t *pool,
 	} state = parse_property;
 
 	auto seen_not = false;
-	ret = std::make_shared<css_declarations_block>();
+	/* Carry both the control block and the rules by the task arena */
+	ret = std::allocate_shared<css_declarations_block>(
+		rspamd::mempool_allocator<css_declarations_block>(pool), pool);
 
 	while (can_continue) {
 		const auto &next_tok = next_block_functor();
@@ -260,7 +262,8 @@ auto process_declaration_tokens(rspamd_mempool_t *pool,
 					}
 					else {
 						state = parse_value;
-						cur_rule = std::make_shared<css_rule>(cur_property);
+						cur_rule = std::allocate_shared<css_rule>(
+							rspamd::mempool_allocator<css_rule>(pool), pool, cur_property);
 					}
 				}
 			}
@@ -351,6 +354,53 @@ auto process_declaration_tokens(rspamd_mempool_t *pool,
 	return ret; /* copy elision */
 }
 
+auto css_lazy_declarations::materialise(rspamd_mempool_t *pool) -> const css_declarations_block_ptr &
+{
+	if (resolved) {
+		return resolved;
+	}
+
+	for (const auto &raw: raw_blocks) {
+		auto decls_it = raw->get_blocks_or_empty().cbegin();
+		auto decls_end = raw->get_blocks_or_empty().cend();
+		auto declaration_token_functor = [&decls_it, &decls_end](void)
+			-> const css_consumed_block & {
+			if (decls_it == decls_end) {
+				return css_parser_eof_block;
+			}
+
+			const auto &ret = (*decls_it);
+
+			++decls_it;
+
+			return *ret;
+		};
+
+		auto decls = process_declaration_tokens(pool,
+												std::move(declaration_token_functor));
+
+		if (decls && !decls->get_rules().empty()) {
+			if (!resolved) {
+				resolved = decls;
+			}
+			else {
+				resolved->merge_block(*decls);
+			}
+		}
+	}
+
+	/* Raw blocks are no longer needed, release tokens memory */
+	raw_blocks.clear();
+
+	if (!resolved) {
+		/* Cache a negative result as an empty block */
+		resolved = std::allocate_shared<css_declarations_block>(
+			rspamd::mempool_allocator<css_declarations_block>(pool), pool);
+	}
+
+	return resolved;
+}
+
 auto css_declarations_block::merge_block(const css_declarations_block &other, merge_type how) -> void
 {
 	const auto &other_rules = other.get_rules();
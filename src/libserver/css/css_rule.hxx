@@ -21,6 +21,7 @@
 #include "css_value.hxx"
 #include "css_property.hxx"
 #include "css_parser.hxx"
+#include "mem_pool.h"
 #include "contrib/ankerl/unordered_dense.h"
 #include "libutil/cxx/util.hxx"
 #include "libutil/cxx/hash_util.hxx"
@@ -36,7 +37,7 @@ namespace rspamd::css {
 
 class css_rule {
 	css_property prop;
-	using css_values_vec = std::vector<css_value>;
+	using css_values_vec = std::vector<css_value, rspamd::mempool_allocator<css_value>>;
 	css_values_vec values;
 
 public:
@@ -53,8 +54,9 @@ public:
 	{
 	}
 
-	explicit css_rule(const css_property &prop) noexcept
-		: prop(prop), values{}
+	/* Values are carried by the arena to avoid tiny heap allocations */
+	explicit css_rule(rspamd_mempool_t *pool, const css_property &prop) noexcept
+		: prop(prop), values(rspamd::mempool_allocator<css_value>(pool))
 	{
 	}
 
@@ -98,21 +100,58 @@ public:
 
 namespace rspamd::css {
 
+/*
+ * Hash and equality for rules in a declarations block; rules are compared
+ * by the property alone, so we can also look a rule up by a property
+ * without constructing a fake valueless rule
+ */
+struct css_rule_hash {
+	using is_transparent = void;
+	using is_avalanching = void;
+	auto operator()(const std::shared_ptr<css_rule> &rule) const
+	{
+		return std::hash<css_rule>()(*rule);
+	}
+	auto operator()(const css_property &prop) const
+	{
+		return std::hash<css_property>()(prop);
+	}
+};
+
+struct css_rule_equal {
+	using is_transparent = void;
+	auto operator()(const std::shared_ptr<css_rule> &a, const std::shared_ptr<css_rule> &b) const
+	{
+		return (*a) == (*b);
+	}
+	auto operator()(const std::shared_ptr<css_rule> &a, const css_property &b) const
+	{
+		return a->get_prop() == b;
+	}
+	auto operator()(const css_property &a, const std::shared_ptr<css_rule> &b) const
+	{
+		return a == b->get_prop();
+	}
+};
+
 /**
  * Class that is designed to hold css declaration (a set of rules)
  */
 class css_declarations_block {
 public:
 	using rule_shared_ptr = std::shared_ptr<css_rule>;
-	using rule_shared_hash = smart_ptr_hash<css_rule>;
-	using rule_shared_eq = smart_ptr_equal<css_rule>;
 	enum class merge_type {
 		merge_duplicate,
 		merge_parent,
 		merge_override
 	};
 
-	css_declarations_block() = default;
+	css_declarations_block() = delete;
+	/* All rules are placed into the pool arena and freed with it */
+	explicit css_declarations_block(rspamd_mempool_t *pool)
+		: rules(rspamd::mempool_allocator<rule_shared_ptr>(pool))
+	{
+	}
 	auto add_rule(rule_shared_ptr rule) -> bool;
 	auto merge_block(const css_declarations_block &other,
 					 merge_type how = merge_type::merge_duplicate) -> void;
@@ -128,7 +167,7 @@ public:
 	 */
 	auto has_property(const css_property &prop) const -> bool
 	{
-		return (rules.find(css_rule{prop}) != rules.end());
+		return (rules.find(prop) != rules.end());
 	}
 
 	/**
@@ -139,11 +178,43 @@ public:
 	auto compile_to_block(rspamd_mempool_t *pool) const -> rspamd::html::html_block *;
 
 private:
-	ankerl::unordered_dense::set<rule_shared_ptr, rule_shared_hash, rule_shared_eq> rules;
+	ankerl::unordered_dense::set<rule_shared_ptr, css_rule_hash, css_rule_equal,
+								 rspamd::mempool_allocator<rule_shared_ptr>>
+		rules;
 };
 
 using css_declarations_block_ptr = std::shared_ptr<css_declarations_block>;
 
+/**
+ * A declarations block that is processed lazily: it keeps the raw blocks
+ * consumed by the parser and converts them to css rules merely when some
+ * tag in the document actually matches the corresponding selector.
+ * Mail styles typically define far more rules than the markup ever
+ * references, so values for the dead rules are never parsed at all.
+ */
+class css_lazy_declarations {
+public:
+	css_lazy_declarations() = delete;
+	explicit css_lazy_declarations(css_consumed_block::consumed_block_ptr &&raw)
+	{
+		raw_blocks.push_back(std::move(raw));
+	}
+
+	/**
+	 * Process raw blocks into a declarations block on the first use;
+	 * subsequent calls return the cached result (might be an empty block)
+	 * @param pool
+	 * @return
+	 */
+	auto materialise(rspamd_mempool_t *pool) -> const css_declarations_block_ptr &;
+
+private:
+	std::vector<css_consumed_block::consumed_block_ptr> raw_blocks;
+	css_declarations_block_ptr resolved;
+};
+
+using css_lazy_declarations_ptr = std::shared_ptr<css_lazy_declarations>;
+
 auto process_declaration_tokens(rspamd_mempool_t *pool,
 								blocks_gen_functor &&next_token_functor)
 	-> css_declarations_block_ptr;
@@ -162,6 +162,117 @@ auto process_selector_tokens(rspamd_mempool_t *pool,
 	return ret; /* copy elision */
 }
 
+/*
+ * Workers are single threaded, so plain counters are enough here
+ */
+static std::uint64_t fast_path_hits = 0;
+static std::uint64_t slow_path_hits = 0;
+
+auto css_selectors_fast_path_stat() -> std::pair<std::uint64_t, std::uint64_t>
+{
+	return std::make_pair(fast_path_hits, slow_path_hits);
+}
+
+auto try_process_simple_selectors(rspamd_mempool_t *pool,
+								  const std::vector<css_consumed_block::consumed_block_ptr> &prelude,
+								  std::size_t prelude_len) -> std::optional<selectors_vec>
+{
+	selectors_vec ret;
+	std::unique_ptr<css_selector> cur_selector;
+	enum class simple_state {
+		expect_start,
+		expect_class_ident,
+		expect_comma,
+	} state = simple_state::expect_start;
+
+	for (std::size_t i = 0; i < prelude_len; i++) {
+		const auto &blk = *prelude[i];
+
+		if (blk.tag != css_consumed_block::parser_tag_type::css_component) {
+			slow_path_hits++;
+			return std::nullopt;
+		}
+
+		const auto &tok = blk.get_token_or_empty();
+
+		switch (state) {
+		case simple_state::expect_start:
+			if (tok.type == css_parser_token::token_type::hash_token) {
+				cur_selector = std::make_unique<css_selector>(
+					css_selector::selector_type::SELECTOR_ID);
+				cur_selector->value = tok.get_string_or_default("");
+				state = simple_state::expect_comma;
+			}
+			else if (tok.type == css_parser_token::token_type::delim_token &&
+					 tok.get_delim() == '.') {
+				state = simple_state::expect_class_ident;
+			}
+			else if (tok.type == css_parser_token::token_type::delim_token &&
+					 tok.get_delim() == '*') {
+				cur_selector = std::make_unique<css_selector>(
+					css_selector::selector_type::SELECTOR_ALL);
+				state = simple_state::expect_comma;
+			}
+			else if (tok.type == css_parser_token::token_type::ident_token) {
+				auto tag_id = html::html_tag_by_name(tok.get_string_or_default(""));
+
+				if (!tag_id) {
+					/* Unknown tags have odd continuation semantics, defer
+					 * them to the generic state machine */
+					slow_path_hits++;
+					return std::nullopt;
+				}
+
+				cur_selector = std::make_unique<css_selector>(tag_id.value());
+				state = simple_state::expect_comma;
+			}
+			else {
+				slow_path_hits++;
+				return std::nullopt;
+			}
+			break;
+		case simple_state::expect_class_ident:
+			if (tok.type == css_parser_token::token_type::ident_token) {
+				cur_selector = std::make_unique<css_selector>(
+					css_selector::selector_type::SELECTOR_CLASS);
+				cur_selector->value = tok.get_string_or_default("");
+				state = simple_state::expect_comma;
+			}
+			else {
+				slow_path_hits++;
+				return std::nullopt;
+			}
+			break;
+		case simple_state::expect_comma:
+			if (tok.type == css_parser_token::token_type::comma_token) {
+				msg_debug_css("attached selector (fast path): %s",
+							  cur_selector->debug_str().c_str());
+				ret.push_back(std::move(cur_selector));
+				state = simple_state::expect_start;
+			}
+			else {
+				/* Combinators, attributes and friends */
+				slow_path_hits++;
+				return std::nullopt;
+			}
+			break;
+		}
+	}
+
+	if (state != simple_state::expect_comma) {
+		/* Truncated selector, e.g. trailing comma or a lone dot */
+		slow_path_hits++;
+		return std::nullopt;
+	}
+
+	msg_debug_css("attached selector (fast path): %s",
+				  cur_selector->debug_str().c_str());
+	ret.push_back(std::move(cur_selector));
+	fast_path_hits++;
+
+	return ret;
+}
+
 auto css_selector::debug_str() const -> std::string
 {
 	std::string ret;
@@ -24,6 +24,8 @@
 #include <optional>
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <utility>
 
 #include "function2/function2.hpp"
 #include "parse_error.hxx"
@@ -109,6 +111,22 @@ auto process_selector_tokens(rspamd_mempool_t *pool,
 							 blocks_gen_functor &&next_token_functor)
 	-> selectors_vec;
 
+/*
+ * Single scan fast path for the dominant selector shapes in mail CSS:
+ * `.class`, `#id`, a bare tag and `*` (optionally comma separated).
+ * Returns std::nullopt for anything more complex, so the caller must
+ * fall back to the generic state machine above.
+ */
+auto try_process_simple_selectors(rspamd_mempool_t *pool,
+								  const std::vector<css_consumed_block::consumed_block_ptr> &prelude,
+								  std::size_t prelude_len) -> std::optional<selectors_vec>;
+
+/*
+ * Fast/slow path hit counters (per worker), allow to verify the fast path
+ * hit rate on real traffic
+ */
+auto css_selectors_fast_path_stat() -> std::pair<std::uint64_t, std::uint64_t>;
+
 }// namespace rspamd::css
 
 /* Selectors hashing */
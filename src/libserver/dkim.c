@@ -1748,6 +1748,70 @@ rspamd_get_dkim_key(rspamd_dkim_context_t *ctx,
 												   ctx->dns_key);
 }
 
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Returns the length of the prefix of `h` that needs no canonicalisation:
+ * no line breaks, and no whitespace at all when `ws` is set. Callers can
+ * then copy whole spans instead of shuffling bytes one by one; such runs
+ * dominate the body canonicalisation cost on large messages.
+ */
+static inline unsigned int
+rspamd_dkim_plain_span(const char *h, unsigned int len, gboolean ws)
+{
+	unsigned int i = 0;
+
+#if defined(__x86_64__)
+	if (len >= 16) {
+		const __m128i lower = _mm_set1_epi8(0x09 - 1);
+		const __m128i upper = _mm_set1_epi8(0x0D + 1);
+		const __m128i sp = _mm_set1_epi8(' ');
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+
+		while (i + 16 <= len) {
+			__m128i x = _mm_loadu_si128((const __m128i *) (h + i));
+			__m128i m;
+			int mask;
+
+			if (ws) {
+				/* 0x09..0x0D or space; 8bit octets are negative, hence excluded */
+				m = _mm_and_si128(_mm_cmpgt_epi8(x, lower),
+								  _mm_cmplt_epi8(x, upper));
+				m = _mm_or_si128(m, _mm_cmpeq_epi8(x, sp));
+			}
+			else {
+				m = _mm_or_si128(_mm_cmpeq_epi8(x, cr),
+								 _mm_cmpeq_epi8(x, lf));
+			}
+
+			mask = _mm_movemask_epi8(m);
+
+			if (mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+
+			i += 16;
+		}
+	}
+#endif
+
+	if (ws) {
+		while (i < len && !g_ascii_isspace(h[i])) {
+			i++;
+		}
+	}
+	else {
+		while (i < len && h[i] != '\r' && h[i] != '\n') {
+			i++;
+		}
+	}
+
+	return i;
+}
+
 static gboolean
 rspamd_dkim_relaxed_body_step(struct rspamd_dkim_common_ctx *ctx, EVP_MD_CTX *ck,
 							  const char **start, unsigned int size,
@@ -1814,6 +1878,25 @@ rspamd_dkim_relaxed_body_step(struct rspamd_dkim_common_ctx *ctx, EVP_MD_CTX *ck
 		}
 		else {
 			got_sp = FALSE;
+
+			/* Copy the whole plain span at once */
+			unsigned int span = MIN(len, inlen);
+
+			if ((gssize) span > octets_remain) {
+				span = octets_remain;
+			}
+
+			span = rspamd_dkim_plain_span(h, span, TRUE);
+
+			if (span > 1) {
+				memcpy(t, h, span);
+				t += span;
+				h += span;
+				inlen -= span;
+				len -= span;
+				octets_remain -= span;
+				continue;
+			}
 		}
 
 		*t++ = *h++;
@@ -1895,6 +1978,27 @@ rspamd_dkim_simple_body_step(struct rspamd_dkim_common_ctx *ctx,
 			break;
 		}
 
+		if (octets_remain > 0) {
+			/* Copy the whole line remnant at once */
+			unsigned int span = MIN(len, inlen);
+
+			if ((gssize) span > octets_remain) {
+				span = octets_remain;
+			}
+
+			span = rspamd_dkim_plain_span(h, span, FALSE);
+
+			if (span > 1) {
+				memcpy(t, h, span);
+				t += span;
+				h += span;
+				octets_remain -= span;
+				inlen -= span;
+				len -= span;
+				continue;
+			}
+		}
+
 		*t++ = *h++;
 		octets_remain--;
 		inlen--;
@@ -2646,6 +2750,86 @@ rspamd_dkim_type_to_string(enum rspamd_dkim_type t)
 	}
 }
 
+/*
+ * Signing canonicalisation diverges from the verifying one in a single case:
+ * relaxed canonicalisation of a non empty body without a trailing newline,
+ * where the signer appends CRLF whilst the verifier does not. Returns TRUE
+ * when this message hits that case, so a digest cached by a verify pass can
+ * be reused for signing by taking the CRLF variant
+ */
+static gboolean
+rspamd_dkim_sign_body_needs_crlf(struct rspamd_dkim_common_ctx *ctx,
+								 const char *body_start, const char *body_end)
+{
+	gboolean sign_crlf = FALSE, verify_crlf = FALSE;
+
+	if (ctx->body_canon_type != DKIM_CANON_RELAXED ||
+		body_start == NULL || body_end <= body_start) {
+		return FALSE;
+	}
+
+	(void) rspamd_dkim_skip_empty_lines(body_start, body_end,
+										ctx->body_canon_type, TRUE, &sign_crlf);
+	(void) rspamd_dkim_skip_empty_lines(body_start, body_end,
+										ctx->body_canon_type, FALSE, &verify_crlf);
+
+	return sign_crlf && !verify_crlf;
+}
+
+static void
+rspamd_dkim_bh_cache_fill(struct rspamd_task *task,
+						  struct rspamd_dkim_common_ctx *ctx,
+						  struct rspamd_dkim_cached_hash *cached_bh)
+{
+	unsigned char raw_digest[EVP_MAX_MD_SIZE];
+	EVP_MD_CTX *cpy_ctx;
+
+	/*
+	 * Finalise all variants of the body hash in one go whilst we still have
+	 * the streamed state: the normal digest plus the ones with CRLF and LF
+	 * appended that are used to tolerate broken line endings. Subsequent
+	 * signatures sharing the canonicalisation merely compare the cached
+	 * digests and never touch EVP again.
+	 */
+	cpy_ctx = EVP_MD_CTX_create();
+	EVP_MD_CTX_copy(cpy_ctx, ctx->body_hash);
+	EVP_DigestFinal_ex(cpy_ctx, raw_digest, NULL);
+	cached_bh->digest_normal = rspamd_mempool_alloc(task->task_pool,
+													sizeof(raw_digest));
+	memcpy(cached_bh->digest_normal, raw_digest, sizeof(raw_digest));
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+	EVP_MD_CTX_cleanup(cpy_ctx);
+#else
+	EVP_MD_CTX_reset(cpy_ctx);
+#endif
+	EVP_MD_CTX_copy(cpy_ctx, ctx->body_hash);
+	EVP_DigestUpdate(cpy_ctx, "\r\n", 2);
+	EVP_DigestFinal_ex(cpy_ctx, raw_digest, NULL);
+	cached_bh->digest_crlf = rspamd_mempool_alloc(task->task_pool,
+												  sizeof(raw_digest));
+	memcpy(cached_bh->digest_crlf, raw_digest, sizeof(raw_digest));
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+	EVP_MD_CTX_cleanup(cpy_ctx);
+#else
+	EVP_MD_CTX_reset(cpy_ctx);
+#endif
+	EVP_MD_CTX_copy(cpy_ctx, ctx->body_hash);
+	EVP_DigestUpdate(cpy_ctx, "\n", 1);
+	EVP_DigestFinal_ex(cpy_ctx, raw_digest, NULL);
+	cached_bh->digest_cr = rspamd_mempool_alloc(task->task_pool,
+												sizeof(raw_digest));
+	memcpy(cached_bh->digest_cr, raw_digest, sizeof(raw_digest));
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+	EVP_MD_CTX_cleanup(cpy_ctx);
+#else
+	EVP_MD_CTX_reset(cpy_ctx);
+#endif
+	EVP_MD_CTX_destroy(cpy_ctx);
+}
+
 /**
 * Check task for dkim context using dkim key
 * @param ctx dkim verify context
@@ -2661,7 +2845,6 @@ rspamd_dkim_check(rspamd_dkim_context_t *ctx,
 	const char *body_end, *body_start;
 	unsigned char raw_digest[EVP_MAX_MD_SIZE];
 	struct rspamd_dkim_cached_hash *cached_bh = NULL;
-	EVP_MD_CTX *cpy_ctx = NULL;
 	gsize dlen = 0;
 	struct rspamd_dkim_check_result *res;
 	unsigned int i;
@@ -2732,106 +2915,32 @@ rspamd_dkim_check(rspamd_dkim_context_t *ctx,
 	/* Use cached BH for all but arc seal, if it is not NULL we are not in arc seal mode */
 	if (cached_bh != NULL) {
 		if (!cached_bh->digest_normal) {
-			/* Copy md_ctx to deal with broken CRLF at the end */
-			cpy_ctx = EVP_MD_CTX_create();
-			EVP_MD_CTX_copy(cpy_ctx, ctx->common.body_hash);
-			EVP_DigestFinal_ex(cpy_ctx, raw_digest, NULL);
-
-			cached_bh->digest_normal = rspamd_mempool_alloc(task->task_pool,
-															sizeof(raw_digest));
-			memcpy(cached_bh->digest_normal, raw_digest, sizeof(raw_digest));
+			/* First signature with this canonicalisation, finalise all variants */
+			rspamd_dkim_bh_cache_fill(task, &ctx->common, cached_bh);
 		}
 
 		/* Check bh field */
 		if (memcmp(ctx->bh, cached_bh->digest_normal, ctx->bhlen) != 0) {
 			msg_debug_dkim(
-				"bh value mismatch: %*xs versus %*xs, try add LF; try adding CRLF",
+				"bh value mismatch: %*xs versus %*xs, try adding CRLF",
 				(int) dlen, ctx->bh,
-				(int) dlen, raw_digest);
-
-			if (cpy_ctx) {
-				/* Try add CRLF */
-#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
-				EVP_MD_CTX_cleanup(cpy_ctx);
-#else
-				EVP_MD_CTX_reset(cpy_ctx);
-#endif
-				EVP_MD_CTX_copy(cpy_ctx, ctx->common.body_hash);
-				EVP_DigestUpdate(cpy_ctx, "\r\n", 2);
-				EVP_DigestFinal_ex(cpy_ctx, raw_digest, NULL);
-				cached_bh->digest_crlf = rspamd_mempool_alloc(task->task_pool,
-															  sizeof(raw_digest));
-				memcpy(cached_bh->digest_crlf, raw_digest, sizeof(raw_digest));
-
-				if (memcmp(ctx->bh, raw_digest, ctx->bhlen) != 0) {
-					msg_debug_dkim(
-						"bh value mismatch after added CRLF: %*xs versus %*xs, try add LF",
-						(int) dlen, ctx->bh,
-						(int) dlen, raw_digest);
-
-					/* Try add LF */
-#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
-					EVP_MD_CTX_cleanup(cpy_ctx);
-#else
-					EVP_MD_CTX_reset(cpy_ctx);
-#endif
-					EVP_MD_CTX_copy(cpy_ctx, ctx->common.body_hash);
-					EVP_DigestUpdate(cpy_ctx, "\n", 1);
-					EVP_DigestFinal_ex(cpy_ctx, raw_digest, NULL);
-					cached_bh->digest_cr = rspamd_mempool_alloc(task->task_pool,
-																sizeof(raw_digest));
-					memcpy(cached_bh->digest_cr, raw_digest, sizeof(raw_digest));
-
-					if (memcmp(ctx->bh, raw_digest, ctx->bhlen) != 0) {
-						msg_debug_dkim("bh value mismatch after added LF: %*xs versus %*xs",
-									   (int) dlen, ctx->bh,
-									   (int) dlen, raw_digest);
-						res->fail_reason = "body hash did not verify";
-						res->rcode = DKIM_REJECT;
-					}
-				}
-			}
-			else if (cached_bh->digest_crlf) {
-				if (memcmp(ctx->bh, cached_bh->digest_crlf, ctx->bhlen) != 0) {
-					msg_debug_dkim("bh value mismatch after added CRLF: %*xs versus %*xs",
-								   (int) dlen, ctx->bh,
-								   (int) dlen, cached_bh->digest_crlf);
-
-					if (cached_bh->digest_cr) {
-						if (memcmp(ctx->bh, cached_bh->digest_cr, ctx->bhlen) != 0) {
-							msg_debug_dkim(
-								"bh value mismatch after added LF: %*xs versus %*xs",
-								(int) dlen, ctx->bh,
-								(int) dlen, cached_bh->digest_cr);
+				(int) dlen, cached_bh->digest_normal);
 
-							res->fail_reason = "body hash did not verify";
-							res->rcode = DKIM_REJECT;
-						}
-					}
-					else {
-
-						res->fail_reason = "body hash did not verify";
-						res->rcode = DKIM_REJECT;
-					}
-				}
-			}
-			else {
+			/* Tolerate broken line endings: try CRLF, then LF appended */
+			if (memcmp(ctx->bh, cached_bh->digest_crlf, ctx->bhlen) != 0) {
 				msg_debug_dkim(
-					"bh value mismatch: %*xs versus %*xs",
+					"bh value mismatch after added CRLF: %*xs versus %*xs, try add LF",
 					(int) dlen, ctx->bh,
-					(int) dlen, cached_bh->digest_normal);
-				res->fail_reason = "body hash did not verify";
-				res->rcode = DKIM_REJECT;
-			}
-		}
+					(int) dlen, cached_bh->digest_crlf);
 
-		if (cpy_ctx) {
-#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
-			EVP_MD_CTX_cleanup(cpy_ctx);
-#else
-			EVP_MD_CTX_reset(cpy_ctx);
-#endif
-			EVP_MD_CTX_destroy(cpy_ctx);
+				if (memcmp(ctx->bh, cached_bh->digest_cr, ctx->bhlen) != 0) {
+					msg_debug_dkim("bh value mismatch after added LF: %*xs versus %*xs",
+								   (int) dlen, ctx->bh,
+								   (int) dlen, cached_bh->digest_cr);
+					res->fail_reason = "body hash did not verify";
+					res->rcode = DKIM_REJECT;
+				}
+			}
 		}
 
 		if (res->rcode == DKIM_REJECT) {
@@ -3379,9 +3488,31 @@ rspamd_dkim_sign(struct rspamd_task *task, const char *selector,
 												dlen, TRUE);
 
 		if (!cached_bh->digest_normal) {
+			struct rspamd_dkim_cached_hash *verify_bh;
+
+			/*
+			 * A verify pass (e.g. ARC or DKIM checks before sealing) may
+			 * have canonicalised the very same body already, so reuse its
+			 * digests instead of streaming the body again
+			 */
+			verify_bh = rspamd_dkim_check_bh_cached(&ctx->common, task,
+													dlen, FALSE);
+
+			if (verify_bh->digest_normal) {
+				if (rspamd_dkim_sign_body_needs_crlf(&ctx->common,
+													 body_start, body_end)) {
+					cached_bh->digest_normal = verify_bh->digest_crlf;
+				}
+				else {
+					cached_bh->digest_normal = verify_bh->digest_normal;
+				}
+
+				msg_debug_task("reused dkim body hash canonicalised by a "
+							   "verify pass for signing");
+			}
 			/* Start canonization of body part */
-			if (!rspamd_dkim_canonize_body(task, &ctx->common, body_start, body_end,
-										   TRUE)) {
+			else if (!rspamd_dkim_canonize_body(task, &ctx->common, body_start,
+												body_end, TRUE)) {
 				return NULL;
 			}
 		}
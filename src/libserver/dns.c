@@ -23,13 +23,24 @@
 #include "contrib/libev/ev.h"
 #include "contrib/librdns/rdns.h"
 #include "contrib/librdns/dns_private.h"
-#include "contrib/librdns/rdns_ev.h"
+#include "libutil/timer_wheel.h"
 #include "unix-std.h"
 
 #include <unicode/uidna.h>
 
 static const char *M = "rspamd dns";
 
+/*
+ * In-process cache of positive replies: DNSBL style scans repeat the same
+ * queries within a burst of messages, so even a loopback round trip to the
+ * local recursor is worth saving. The cache lives per worker process: the
+ * fork model shares nothing writable, and the rdns reply structures cannot
+ * be moved into a shared segment anyway
+ */
+static const unsigned int default_replies_cache_size = 1024;
+/* Reply TTLs are honoured, but bounded to keep staleness in check */
+static const ev_tstamp default_replies_cache_max_ttl = 600.0;
+
 static struct rdns_upstream_elt *rspamd_dns_select_upstream(const char *name,
 															size_t len, void *ups_data);
 static struct rdns_upstream_elt *rspamd_dns_select_upstream_retransmit(
@@ -60,6 +71,12 @@ struct rspamd_dns_request_ud {
 	struct rspamd_symcache_dynamic_item *item;
 	struct rdns_request *req;
 	struct rdns_reply *reply;
+	struct rspamd_dns_resolver *resolver;
+	/* Coalescing of identical in-flight requests */
+	struct rspamd_dns_fail_cache_entry *inflight_key;
+	struct rspamd_dns_request_ud *primary;
+	struct rspamd_dns_request_ud *followers;
+	struct rspamd_dns_request_ud *next, *prev;
 };
 
 struct rspamd_dns_fail_cache_entry {
@@ -107,11 +124,83 @@ rspamd_dns_fail_equal(gconstpointer p1, gconstpointer p2)
 	return FALSE;
 }
 
+static struct rspamd_dns_fail_cache_entry *
+rspamd_dns_cache_entry_new(const char *name, gsize namelen,
+						   enum rdns_request_type type)
+{
+	struct rspamd_dns_fail_cache_entry *nentry;
+	char *target;
+
+	/* Allocate in a single entry to allow further free in a single call */
+	nentry = g_malloc(sizeof(*nentry) + namelen + 1);
+	target = ((char *) nentry) + sizeof(*nentry);
+	rspamd_strlcpy(target, name, namelen + 1);
+	nentry->type = type;
+	nentry->name = target;
+	nentry->namelen = namelen;
+
+	return nentry;
+}
+
+static ev_tstamp
+rspamd_dns_reply_cache_ttl(struct rspamd_dns_resolver *resolver,
+						   struct rdns_reply *reply)
+{
+	struct rdns_reply_entry *entry;
+	int32_t ttl = G_MAXINT32;
+
+	/* TTL-faithful: a reply lives merely as long as its shortest record */
+	DL_FOREACH(reply->entries, entry)
+	{
+		if (entry->ttl < ttl) {
+			ttl = entry->ttl;
+		}
+	}
+
+	if (ttl == G_MAXINT32 || ttl <= 0) {
+		return 0;
+	}
+
+	return MIN((ev_tstamp) ttl, resolver->replies_cache_max_ttl);
+}
+
 static void
 rspamd_dns_fin_cb(gpointer arg)
 {
 	struct rspamd_dns_request_ud *reqdata = (struct rspamd_dns_request_ud *) arg;
 
+	if (reqdata->primary != NULL) {
+		/* Uncouple a follower of a coalesced request */
+		DL_DELETE(reqdata->primary->followers, reqdata);
+		reqdata->primary = NULL;
+	}
+	else if (reqdata->inflight_key != NULL || reqdata->followers != NULL) {
+		/*
+		 * Primary of a coalesced request is being torn down before the reply
+		 * (e.g. on the session forced cleanup): stop accepting joiners and
+		 * finalise the remaining followers with the usual timeout semantics,
+		 * as the underlying rdns request is unscheduled below
+		 */
+		struct rspamd_dns_request_ud *cur, *tmp;
+
+		if (reqdata->inflight_key != NULL && reqdata->resolver != NULL) {
+			g_hash_table_remove(reqdata->resolver->inflight_reqs,
+								reqdata->inflight_key);
+			reqdata->inflight_key = NULL;
+		}
+
+		DL_FOREACH_SAFE(reqdata->followers, cur, tmp)
+		{
+			DL_DELETE(reqdata->followers, cur);
+			cur->primary = NULL;
+
+			if (cur->session) {
+				rspamd_session_remove_event(cur->session,
+											rspamd_dns_fin_cb, cur);
+			}
+		}
+	}
+
 	if (reqdata->item) {
 		rspamd_symcache_set_cur_item(reqdata->task, reqdata->item);
 	}
@@ -150,26 +239,40 @@ rspamd_dns_callback(struct rdns_reply *reply, gpointer ud)
 
 	reqdata->reply = reply;
 
+	if (reqdata->inflight_key != NULL && reqdata->resolver != NULL) {
+		/* Detach from the in-flight hash before any delivery */
+		g_hash_table_remove(reqdata->resolver->inflight_reqs,
+							reqdata->inflight_key);
+		reqdata->inflight_key = NULL;
+	}
+
+	if (reqdata->followers != NULL) {
+		/* Satisfy all the coalesced waiters with the same reply */
+		struct rspamd_dns_request_ud *cur, *tmp;
+
+		DL_FOREACH_SAFE(reqdata->followers, cur, tmp)
+		{
+			DL_DELETE(reqdata->followers, cur);
+			cur->primary = NULL;
+			cur->reply = reply;
+			/* Follower's own retained ref is released in the fin callback */
+			rspamd_session_remove_event(cur->session,
+										rspamd_dns_fin_cb, cur);
+		}
+	}
 
 	if (reqdata->session) {
-		if (reply->code == RDNS_RC_SERVFAIL &&
+		if ((reply->code == RDNS_RC_SERVFAIL ||
+			 reply->code == RDNS_RC_NXDOMAIN) &&
 			reqdata->task &&
 			reqdata->task->resolver->fails_cache) {
 
 			/* Add to cache... */
 			const char *name = reqdata->req->requested_names[0].name;
-			char *target;
-			gsize namelen;
 			struct rspamd_dns_fail_cache_entry *nentry;
 
-			/* Allocate in a single entry to allow further free in a single call */
-			namelen = strlen(name);
-			nentry = g_malloc(sizeof(nentry) + namelen + 1);
-			target = ((char *) nentry) + sizeof(nentry);
-			rspamd_strlcpy(target, name, namelen + 1);
-			nentry->type = reqdata->req->requested_names[0].type;
-			nentry->name = target;
-			nentry->namelen = namelen;
+			nentry = rspamd_dns_cache_entry_new(name, strlen(name),
+												reqdata->req->requested_names[0].type);
 
 			/* Rdns request is retained there */
 			rspamd_lru_hash_insert(reqdata->task->resolver->fails_cache,
@@ -177,6 +280,26 @@ rspamd_dns_callback(struct rdns_reply *reply, gpointer ud)
 								   reqdata->task->task_timestamp,
 								   reqdata->task->resolver->fails_cache_time);
 		}
+		else if (reply->code == RDNS_RC_NOERROR &&
+				 reply->entries != NULL &&
+				 reqdata->task &&
+				 reqdata->task->resolver->replies_cache) {
+			ev_tstamp ttl = rspamd_dns_reply_cache_ttl(reqdata->task->resolver,
+													   reply);
+
+			if (ttl > 0) {
+				const char *name = reqdata->req->requested_names[0].name;
+				struct rspamd_dns_fail_cache_entry *nentry;
+
+				nentry = rspamd_dns_cache_entry_new(name, strlen(name),
+													reqdata->req->requested_names[0].type);
+				/* The reply is kept alive by retaining its request */
+				rspamd_lru_hash_insert(reqdata->task->resolver->replies_cache,
+									   nentry, rdns_request_retain(reply->request),
+									   reqdata->task->task_timestamp,
+									   ttl);
+			}
+		}
 
 		/*
 		 * Ref event to avoid double unref by
@@ -260,6 +383,34 @@ rspamd_dns_resolver_request(struct rspamd_dns_resolver *resolver,
 	reqdata->session = session;
 	reqdata->cb = cb;
 	reqdata->ud = ud;
+	reqdata->resolver = resolver;
+
+	if (resolver->inflight_reqs != NULL && session != NULL) {
+		struct rspamd_dns_fail_cache_entry search;
+		struct rspamd_dns_request_ud *primary;
+
+		search.name = name;
+		search.namelen = nlen;
+		search.type = type;
+		primary = g_hash_table_lookup(resolver->inflight_reqs, &search);
+
+		if (primary != NULL) {
+			/* Join the in-flight request instead of sending a duplicate */
+			reqdata->req = rdns_request_retain(primary->req);
+			reqdata->primary = primary;
+			DL_APPEND(primary->followers, reqdata);
+			rspamd_session_add_event(session,
+									 (event_finalizer_t) rspamd_dns_fin_cb,
+									 reqdata,
+									 M);
+
+			if (real_name && pool == NULL) {
+				g_free(real_name);
+			}
+
+			return reqdata;
+		}
+	}
 
 	req = rdns_make_request_full(resolver->r, rspamd_dns_callback, reqdata,
 								 resolver->request_timeout, resolver->max_retransmits, 1, name,
@@ -284,6 +435,12 @@ rspamd_dns_resolver_request(struct rspamd_dns_resolver *resolver,
 		return NULL;
 	}
 
+	if (resolver->inflight_reqs != NULL) {
+		reqdata->inflight_key = rspamd_dns_cache_entry_new(name, nlen, type);
+		g_hash_table_insert(resolver->inflight_reqs, reqdata->inflight_key,
+							reqdata);
+	}
+
 	if (real_name && pool == NULL) {
 		g_free(real_name);
 	}
@@ -300,22 +457,53 @@ struct rspamd_dns_cached_delayed_cbdata {
 };
 
 static void
-rspamd_fail_cache_cb(EV_P_ ev_timer *w, int revents)
+rspamd_dns_cached_reply_cb(EV_P_ ev_timer *w, int revents)
 {
 	struct rspamd_dns_cached_delayed_cbdata *cbd =
 		(struct rspamd_dns_cached_delayed_cbdata *) w->data;
-	struct rdns_reply fake_reply;
 
 	ev_timer_stop(EV_A_ w);
-	memset(&fake_reply, 0, sizeof(fake_reply));
-	fake_reply.code = RDNS_RC_SERVFAIL;
-	fake_reply.request = cbd->req;
-	fake_reply.resolver = cbd->req->resolver;
-	fake_reply.requested_name = cbd->req->requested_names[0].name;
-	cbd->cb(&fake_reply, cbd->ud);
+
+	if (cbd->req->reply != NULL) {
+		/* Replay the cached reply as is (entries and rcode) */
+		cbd->cb(cbd->req->reply, cbd->ud);
+	}
+	else {
+		struct rdns_reply fake_reply;
+
+		memset(&fake_reply, 0, sizeof(fake_reply));
+		fake_reply.code = RDNS_RC_SERVFAIL;
+		fake_reply.request = cbd->req;
+		fake_reply.resolver = cbd->req->resolver;
+		fake_reply.requested_name = cbd->req->requested_names[0].name;
+		cbd->cb(&fake_reply, cbd->ud);
+	}
+
 	rdns_request_release(cbd->req);
 }
 
+static void
+rspamd_dns_schedule_cached_reply(struct rspamd_task *task,
+								 dns_callback_type cb,
+								 gpointer ud,
+								 struct rdns_request *req)
+{
+	struct rspamd_dns_cached_delayed_cbdata *cbd =
+		rspamd_mempool_alloc0(task->task_pool, sizeof(*cbd));
+
+	/*
+	 * We need to reply asynchronously to the API, so add a special
+	 * timer, uh-oh, and fire it
+	 */
+	ev_timer_init(&cbd->tm, rspamd_dns_cached_reply_cb, 0.0, 0.0);
+	cbd->task = task;
+	cbd->cb = cb;
+	cbd->ud = ud;
+	cbd->req = rdns_request_retain(req);
+	cbd->tm.data = cbd;
+	ev_timer_start(task->event_loop, &cbd->tm);
+}
+
 static gboolean
 make_dns_request_task_common(struct rspamd_task *task,
 							 dns_callback_type cb,
@@ -330,8 +518,7 @@ make_dns_request_task_common(struct rspamd_task *task,
 		return FALSE;
 	}
 
-	if (task->resolver->fails_cache) {
-		/* Search in failures cache */
+	if (task->resolver->replies_cache || task->resolver->fails_cache) {
 		struct rspamd_dns_fail_cache_entry search;
 		struct rdns_request *req;
 
@@ -339,21 +526,20 @@ make_dns_request_task_common(struct rspamd_task *task,
 		search.namelen = strlen(name);
 		search.type = type;
 
-		if ((req = rspamd_lru_hash_lookup(task->resolver->fails_cache,
+		/* Search in the positive replies cache */
+		if (task->resolver->replies_cache &&
+			(req = rspamd_lru_hash_lookup(task->resolver->replies_cache,
 										  &search, task->task_timestamp)) != NULL) {
-			/*
-			 * We need to reply with SERVFAIL again to the API, so add a special
-			 * timer, uh-oh, and fire it
-			 */
-			struct rspamd_dns_cached_delayed_cbdata *cbd =
-				rspamd_mempool_alloc0(task->task_pool, sizeof(*cbd));
-
-			ev_timer_init(&cbd->tm, rspamd_fail_cache_cb, 0.0, 0.0);
-			cbd->task = task;
-			cbd->cb = cb;
-			cbd->ud = ud;
-			cbd->req = rdns_request_retain(req);
-			cbd->tm.data = cbd;
+			rspamd_dns_schedule_cached_reply(task, cb, ud, req);
+
+			return TRUE;
+		}
+
+		/* Search in failures cache */
+		if (task->resolver->fails_cache &&
+			(req = rspamd_lru_hash_lookup(task->resolver->fails_cache,
+										  &search, task->task_timestamp)) != NULL) {
+			rspamd_dns_schedule_cached_reply(task, cb, ud, req);
 
 			return TRUE;
 		}
@@ -809,7 +995,7 @@ rspamd_dns_resolver_config_ucl(struct rspamd_config *cfg,
 							   const ucl_object_t *dns_section)
 {
 	const ucl_object_t *fake_replies, *fails_cache_size, *fails_cache_time,
-		*hosts;
+		*replies_cache_size, *replies_cache_max_ttl, *hosts;
 	static const ev_tstamp default_fails_cache_time = 10.0;
 
 	/* Process fake replies */
@@ -869,6 +1055,208 @@ rspamd_dns_resolver_config_ucl(struct rspamd_config *cfg,
 			g_free, (GDestroyNotify) rdns_request_release,
 			rspamd_dns_fail_hash, rspamd_dns_fail_equal);
 	}
+
+	replies_cache_size = ucl_object_lookup(dns_section, "replies_cache_size");
+	if (replies_cache_size && ucl_object_type(replies_cache_size) == UCL_INT) {
+		int64_t sz = ucl_object_toint(replies_cache_size);
+
+		rspamd_lru_hash_destroy(dns_resolver->replies_cache);
+		dns_resolver->replies_cache = NULL;
+
+		if (sz > 0) {
+			dns_resolver->replies_cache = rspamd_lru_hash_new_full(
+				sz,
+				g_free, (GDestroyNotify) rdns_request_release,
+				rspamd_dns_fail_hash, rspamd_dns_fail_equal);
+		}
+		/* Zero size disables the positive replies cache */
+	}
+
+	replies_cache_max_ttl = ucl_object_lookup(dns_section, "replies_cache_max_ttl");
+	if (replies_cache_max_ttl) {
+		dns_resolver->replies_cache_max_ttl =
+			ucl_object_todouble(replies_cache_max_ttl);
+	}
+}
+
+/*
+ * Event loop glue for rdns: IO and periodic events are plain libev watchers,
+ * but retransmit timeouts go through the coarse timer wheel, as at a high
+ * request rate they are by far the most churny timers in a worker and do not
+ * need exact ordering
+ */
+struct rspamd_dns_async_data {
+	struct ev_loop *event_loop;
+	struct rspamd_timer_wheel *wheel;
+};
+
+static void
+rspamd_dns_read_event(struct ev_loop *loop, ev_io *ev, int revents)
+{
+	rdns_process_read(ev->fd, ev->data);
+}
+
+static void
+rspamd_dns_write_event(struct ev_loop *loop, ev_io *ev, int revents)
+{
+	rdns_process_write(ev->fd, ev->data);
+}
+
+struct rspamd_dns_periodic_cbdata {
+	ev_timer ev;
+	rdns_periodic_callback cb;
+	void *cbdata;
+};
+
+static void
+rspamd_dns_periodic_event(struct ev_loop *loop, ev_timer *ev, int revents)
+{
+	struct rspamd_dns_periodic_cbdata *cbdata =
+		(struct rspamd_dns_periodic_cbdata *) ev->data;
+
+	cbdata->cb(cbdata->cbdata);
+}
+
+static void *
+rspamd_dns_add_read(void *priv_data, int fd, void *user_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+	ev_io *ev;
+
+	ev = g_malloc(sizeof(*ev));
+	ev_io_init(ev, rspamd_dns_read_event, fd, EV_READ);
+	ev->data = user_data;
+	ev_io_start(d->event_loop, ev);
+
+	return ev;
+}
+
+static void
+rspamd_dns_del_read(void *priv_data, void *ev_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+	ev_io *ev = (ev_io *) ev_data;
+
+	if (ev != NULL) {
+		ev_io_stop(d->event_loop, ev);
+		g_free(ev);
+	}
+}
+
+static void *
+rspamd_dns_add_write(void *priv_data, int fd, void *user_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+	ev_io *ev;
+
+	ev = g_malloc(sizeof(*ev));
+	ev_io_init(ev, rspamd_dns_write_event, fd, EV_WRITE);
+	ev->data = user_data;
+	ev_io_start(d->event_loop, ev);
+
+	return ev;
+}
+
+static void
+rspamd_dns_del_write(void *priv_data, void *ev_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+	ev_io *ev = (ev_io *) ev_data;
+
+	if (ev != NULL) {
+		ev_io_stop(d->event_loop, ev);
+		g_free(ev);
+	}
+}
+
+static void *
+rspamd_dns_add_timer(void *priv_data, double after, void *user_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+
+	return rspamd_timer_wheel_insert(d->wheel, after, rdns_process_timer,
+									 user_data);
+}
+
+static void
+rspamd_dns_repeat_timer(void *priv_data, void *ev_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+
+	if (ev_data != NULL) {
+		rspamd_timer_wheel_repeat(d->wheel,
+								  (struct rspamd_wheel_entry *) ev_data);
+	}
+}
+
+static void
+rspamd_dns_del_timer(void *priv_data, void *ev_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+
+	if (ev_data != NULL) {
+		rspamd_timer_wheel_remove(d->wheel,
+								  (struct rspamd_wheel_entry *) ev_data);
+	}
+}
+
+static void *
+rspamd_dns_add_periodic(void *priv_data, double after,
+						rdns_periodic_callback cb, void *user_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+	struct rspamd_dns_periodic_cbdata *cbdata;
+
+	cbdata = g_malloc(sizeof(*cbdata));
+	cbdata->cb = cb;
+	cbdata->cbdata = user_data;
+	ev_timer_init(&cbdata->ev, rspamd_dns_periodic_event, after, after);
+	cbdata->ev.data = cbdata;
+	ev_now_update_if_cheap(d->event_loop);
+	ev_timer_start(d->event_loop, &cbdata->ev);
+
+	return cbdata;
+}
+
+static void
+rspamd_dns_del_periodic(void *priv_data, void *ev_data)
+{
+	struct rspamd_dns_async_data *d = (struct rspamd_dns_async_data *) priv_data;
+	struct rspamd_dns_periodic_cbdata *cbdata =
+		(struct rspamd_dns_periodic_cbdata *) ev_data;
+
+	if (cbdata != NULL) {
+		ev_timer_stop(d->event_loop, &cbdata->ev);
+		g_free(cbdata);
+	}
+}
+
+static void
+rspamd_dns_resolver_bind(struct rspamd_dns_resolver *dns_resolver)
+{
+	static const struct rdns_async_context tmpl = {
+		.data = NULL,
+		.add_read = rspamd_dns_add_read,
+		.del_read = rspamd_dns_del_read,
+		.add_write = rspamd_dns_add_write,
+		.del_write = rspamd_dns_del_write,
+		.add_timer = rspamd_dns_add_timer,
+		.repeat_timer = rspamd_dns_repeat_timer,
+		.del_timer = rspamd_dns_del_timer,
+		.add_periodic = rspamd_dns_add_periodic,
+		.del_periodic = rspamd_dns_del_periodic,
+		.cleanup = NULL};
+	struct rdns_async_context *nctx;
+	struct rspamd_dns_async_data *d;
+
+	/* XXX: never got freed, as the resolver lives as long as the process */
+	nctx = g_malloc(sizeof(*nctx));
+	memcpy(nctx, &tmpl, sizeof(*nctx));
+	d = g_malloc(sizeof(*d));
+	d->event_loop = dns_resolver->event_loop;
+	d->wheel = dns_resolver->timeouts_wheel;
+	nctx->data = d;
+	rdns_resolver_async_bind(dns_resolver->r, nctx);
 }
 
 struct rspamd_dns_resolver *
@@ -892,12 +1280,22 @@ rspamd_dns_resolver_init(rspamd_logger_t *logger,
 
 	/* IDN translation is performed in Rspamd now */
 	dns_resolver->r = rdns_resolver_new(RDNS_RESOLVER_NOIDN);
+	dns_resolver->inflight_reqs = g_hash_table_new_full(rspamd_dns_fail_hash,
+														rspamd_dns_fail_equal,
+														g_free, NULL);
+	/* Enabled by default; the dns section can resize or disable it */
+	dns_resolver->replies_cache_max_ttl = default_replies_cache_max_ttl;
+	dns_resolver->replies_cache = rspamd_lru_hash_new_full(
+		default_replies_cache_size,
+		g_free, (GDestroyNotify) rdns_request_release,
+		rspamd_dns_fail_hash, rspamd_dns_fail_equal);
 
 	UErrorCode uc_err = U_ZERO_ERROR;
 
 	dns_resolver->uidna = uidna_openUTS46(UIDNA_DEFAULT, &uc_err);
 	g_assert(!U_FAILURE(uc_err));
-	rdns_bind_libev(dns_resolver->r, dns_resolver->event_loop);
+	dns_resolver->timeouts_wheel = rspamd_timer_wheel_new(ev_base, 0.1);
+	rspamd_dns_resolver_bind(dns_resolver);
 
 	if (cfg != NULL) {
 		rdns_resolver_set_log_level(dns_resolver->r, cfg->log_level);
@@ -991,6 +1389,14 @@ void rspamd_dns_resolver_deinit(struct rspamd_dns_resolver *resolver)
 			rspamd_lru_hash_destroy(resolver->fails_cache);
 		}
 
+		if (resolver->replies_cache) {
+			rspamd_lru_hash_destroy(resolver->replies_cache);
+		}
+
+		if (resolver->inflight_reqs) {
+			g_hash_table_unref(resolver->inflight_reqs);
+		}
+
 		uidna_close(resolver->uidna);
 
 		g_free(resolver);
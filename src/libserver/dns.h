@@ -32,13 +32,21 @@ extern "C" {
 struct rspamd_config;
 struct rspamd_task;
 struct event_loop;
+struct rspamd_timer_wheel;
 
 struct rspamd_dns_resolver {
 	struct rdns_resolver *r;
 	struct ev_loop *event_loop;
+	/* Coarse wheel for retransmit timeouts */
+	struct rspamd_timer_wheel *timeouts_wheel;
 	rspamd_lru_hash_t *fails_cache;
+	/* Positive replies cached honouring their own TTL */
+	rspamd_lru_hash_t *replies_cache;
+	/* In-flight requests coalesced by name and type */
+	GHashTable *inflight_reqs;
 	void *uidna;
 	double fails_cache_time;
+	double replies_cache_max_ttl;
 	struct upstream_list *ups;
 	struct rspamd_config *cfg;
 	double request_timeout;
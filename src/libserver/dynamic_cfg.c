@@ -28,6 +28,9 @@ struct config_json_buf {
 	struct rspamd_config *cfg;
 };
 
+/* Priority of the dynamic overrides over the static configuration */
+static const unsigned int dynamic_conf_priority = 3;
+
 /**
  * Apply configuration to the specified configuration
  * @param conf_metrics
@@ -41,7 +44,6 @@ apply_dynamic_conf(const ucl_object_t *top, struct rspamd_config *cfg)
 	ucl_object_iter_t it = NULL;
 	const char *name;
 	double nscore;
-	static const unsigned int priority = 3;
 
 	while ((cur_elt = ucl_object_iterate(top, &it, true))) {
 		if (ucl_object_type(cur_elt) != UCL_OBJECT) {
@@ -71,12 +73,10 @@ apply_dynamic_conf(const ucl_object_t *top, struct rspamd_config *cfg)
 
 					nscore = ucl_object_todouble(v);
 
-					/*
-					 * We use priority = 3 here
-					 */
 					rspamd_config_add_symbol(cfg,
 											 ucl_object_tostring(n), nscore, NULL, NULL,
-											 0, priority, cfg->default_max_shots);
+											 0, dynamic_conf_priority,
+											 cfg->default_max_shots);
 				}
 				else {
 					msg_info(
@@ -121,7 +121,8 @@ apply_dynamic_conf(const ucl_object_t *top, struct rspamd_config *cfg)
 					ucl_object_t *obj_tbl = ucl_object_typed_new(UCL_OBJECT);
 					ucl_object_insert_key(obj_tbl, ucl_object_fromdouble(nscore),
 										  "score", 0, false);
-					ucl_object_insert_key(obj_tbl, ucl_object_fromdouble(priority),
+					ucl_object_insert_key(obj_tbl,
+										  ucl_object_fromdouble(dynamic_conf_priority),
 										  "priority", 0, false);
 					rspamd_config_set_action_score(cfg, name, obj_tbl);
 					ucl_object_unref(obj_tbl);
@@ -142,6 +143,77 @@ apply_dynamic_conf(const ucl_object_t *top, struct rspamd_config *cfg)
 	}
 }
 
+static GHashTable *
+dynamic_conf_get_index(struct rspamd_config *cfg)
+{
+	if (cfg->dynamic_conf_index == NULL) {
+		cfg->dynamic_conf_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+														g_free, NULL);
+	}
+
+	return cfg->dynamic_conf_index;
+}
+
+static void
+dynamic_conf_index_elt(struct rspamd_config *cfg,
+					   const char *metric,
+					   const char *kind,
+					   const char *name,
+					   const ucl_object_t *val)
+{
+	g_hash_table_replace(dynamic_conf_get_index(cfg),
+						 g_strdup_printf("%s/%s/%s", metric, kind, name),
+						 (gpointer) val);
+}
+
+/**
+ * Rebuild the sparse index over the dynamic overrides, so subsequent lookups
+ * cost merely a single hash probe instead of a linear scan over ucl arrays
+ * @param cfg
+ */
+static void
+dynamic_conf_index_rebuild(struct rspamd_config *cfg)
+{
+	GHashTable *idx = dynamic_conf_get_index(cfg);
+	const ucl_object_t *cur_elt, *cur_nm, *it_val;
+	ucl_object_iter_t it = NULL;
+	static const char *kinds[] = {"symbols", "actions"};
+
+	g_hash_table_remove_all(idx);
+
+	while ((cur_elt = ucl_object_iterate(cfg->current_dynamic_conf, &it, true))) {
+		cur_nm = ucl_object_lookup(cur_elt, "metric");
+
+		if (!cur_nm || ucl_object_type(cur_nm) != UCL_STRING) {
+			continue;
+		}
+
+		const char *metric = ucl_object_tostring(cur_nm);
+
+		g_hash_table_replace(idx, g_strdup_printf("=%s", metric),
+							 (gpointer) cur_elt);
+
+		for (unsigned int i = 0; i < G_N_ELEMENTS(kinds); i++) {
+			const ucl_object_t *arr = ucl_object_lookup(cur_elt, kinds[i]);
+			ucl_object_iter_t nit = NULL;
+
+			if (!arr || ucl_object_type(arr) != UCL_ARRAY) {
+				continue;
+			}
+
+			while ((it_val = ucl_object_iterate(arr, &nit, true))) {
+				const ucl_object_t *n = ucl_object_lookup(it_val, "name");
+				const ucl_object_t *v = ucl_object_lookup(it_val, "value");
+
+				if (n && ucl_object_type(n) == UCL_STRING && v) {
+					dynamic_conf_index_elt(cfg, metric, kinds[i],
+										   ucl_object_tostring(n), v);
+				}
+			}
+		}
+	}
+}
+
 /* Callbacks for reading json dynamic rules */
 static char *
 json_config_read_cb(char *chunk,
@@ -216,6 +288,7 @@ json_config_fin_cb(struct map_cb_data *data, void **target)
 	ucl_object_unref(jb->cfg->current_dynamic_conf);
 	apply_dynamic_conf(top, jb->cfg);
 	jb->cfg->current_dynamic_conf = top;
+	dynamic_conf_index_rebuild(jb->cfg);
 
 	if (target) {
 		*target = data->cur_data;
@@ -248,6 +321,11 @@ json_config_dtor_cb(struct map_cb_data *data)
 			ucl_object_unref(jb->cfg->current_dynamic_conf);
 		}
 
+		if (jb->cfg && jb->cfg->dynamic_conf_index) {
+			g_hash_table_destroy(jb->cfg->dynamic_conf_index);
+			jb->cfg->dynamic_conf_index = NULL;
+		}
+
 		g_free(jb);
 	}
 }
@@ -272,6 +350,7 @@ void init_dynamic_config(struct rspamd_config *cfg)
 	jb->cfg = cfg;
 	*pjb = jb;
 	cfg->current_dynamic_conf = ucl_object_typed_new(UCL_ARRAY);
+	dynamic_conf_index_rebuild(cfg);
 	rspamd_mempool_add_destructor(cfg->cfg_pool,
 								  (rspamd_mempool_destruct_t) g_free,
 								  pjb);
@@ -377,7 +456,9 @@ dump_dynamic_config(struct rspamd_config *cfg)
 }
 
 static ucl_object_t *
-new_dynamic_metric(const char *metric_name, ucl_object_t *top)
+new_dynamic_metric(struct rspamd_config *cfg,
+				   const char *metric_name,
+				   ucl_object_t *top)
 {
 	ucl_object_t *metric;
 
@@ -391,62 +472,49 @@ new_dynamic_metric(const char *metric_name, ucl_object_t *top)
 						  "symbols", sizeof("symbols") - 1, false);
 
 	ucl_array_append(top, metric);
+	g_hash_table_replace(dynamic_conf_get_index(cfg),
+						 g_strdup_printf("=%s", metric_name),
+						 (gpointer) metric);
 
 	return metric;
 }
 
 static ucl_object_t *
-dynamic_metric_find_elt(const ucl_object_t *arr, const char *name)
+dynamic_metric_find_elt(struct rspamd_config *cfg,
+						const char *metric,
+						const char *kind,
+						const char *name)
 {
-	ucl_object_iter_t it = NULL;
-	const ucl_object_t *cur, *n;
-
-	it = ucl_object_iterate_new(arr);
+	char *key;
+	ucl_object_t *res;
 
-	while ((cur = ucl_object_iterate_safe(it, true)) != NULL) {
-		if (cur->type == UCL_OBJECT) {
-			n = ucl_object_lookup(cur, "name");
-			if (n && n->type == UCL_STRING &&
-				strcmp(name, ucl_object_tostring(n)) == 0) {
-				ucl_object_iterate_free(it);
+	key = g_strdup_printf("%s/%s/%s", metric, kind, name);
+	res = g_hash_table_lookup(dynamic_conf_get_index(cfg), key);
+	g_free(key);
 
-				return (ucl_object_t *) ucl_object_lookup(cur, "value");
-			}
-		}
-	}
-
-	ucl_object_iterate_free(it);
-
-	return NULL;
+	return res;
 }
 
 static ucl_object_t *
-dynamic_metric_find_metric(const ucl_object_t *arr, const char *metric)
+dynamic_metric_find_metric(struct rspamd_config *cfg, const char *metric)
 {
-	ucl_object_iter_t it = NULL;
-	const ucl_object_t *cur, *n;
+	char *key;
+	ucl_object_t *res;
 
-	it = ucl_object_iterate_new(arr);
+	key = g_strdup_printf("=%s", metric);
+	res = g_hash_table_lookup(dynamic_conf_get_index(cfg), key);
+	g_free(key);
 
-	while ((cur = ucl_object_iterate_safe(it, true)) != NULL) {
-		if (cur->type == UCL_OBJECT) {
-			n = ucl_object_lookup(cur, "metric");
-			if (n && n->type == UCL_STRING &&
-				strcmp(metric, ucl_object_tostring(n)) == 0) {
-				ucl_object_iterate_free(it);
-
-				return (ucl_object_t *) cur;
-			}
-		}
-	}
-
-	ucl_object_iterate_free(it);
-
-	return NULL;
+	return res;
 }
 
 static ucl_object_t *
-new_dynamic_elt(ucl_object_t *arr, const char *name, double value)
+new_dynamic_elt(struct rspamd_config *cfg,
+				const char *metric,
+				const char *kind,
+				ucl_object_t *arr,
+				const char *name,
+				double value)
 {
 	ucl_object_t *n;
 
@@ -457,6 +525,8 @@ new_dynamic_elt(ucl_object_t *arr, const char *name, double value)
 						  sizeof("value") - 1, false);
 
 	ucl_array_append(arr, n);
+	dynamic_conf_index_elt(cfg, metric, kind,
+						   name, ucl_object_lookup(n, "value"));
 
 	return n;
 }
@@ -583,26 +653,27 @@ add_dynamic_symbol(struct rspamd_config *cfg,
 		return FALSE;
 	}
 
-	metric = dynamic_metric_find_metric(cfg->current_dynamic_conf,
-										metric_name);
+	metric = dynamic_metric_find_metric(cfg, metric_name);
 	if (metric == NULL) {
-		metric = new_dynamic_metric(metric_name, cfg->current_dynamic_conf);
+		metric = new_dynamic_metric(cfg, metric_name, cfg->current_dynamic_conf);
 	}
 
 	syms = (ucl_object_t *) ucl_object_lookup(metric, "symbols");
 	if (syms != NULL) {
 		ucl_object_t *sym;
 
-		sym = dynamic_metric_find_elt(syms, symbol);
+		sym = dynamic_metric_find_elt(cfg, metric_name, "symbols", symbol);
 		if (sym) {
 			sym->value.dv = value;
 		}
 		else {
-			new_dynamic_elt(syms, symbol, value);
+			new_dynamic_elt(cfg, metric_name, "symbols", syms, symbol, value);
 		}
 	}
 
-	apply_dynamic_conf(cfg->current_dynamic_conf, cfg);
+	/* Apply merely the updated symbol, the rest of the overlay is intact */
+	rspamd_config_add_symbol(cfg, symbol, value, NULL, NULL,
+							 0, dynamic_conf_priority, cfg->default_max_shots);
 
 	return TRUE;
 }
@@ -620,8 +691,7 @@ remove_dynamic_symbol(struct rspamd_config *cfg,
 		return FALSE;
 	}
 
-	metric = dynamic_metric_find_metric(cfg->current_dynamic_conf,
-										metric_name);
+	metric = dynamic_metric_find_metric(cfg, metric_name);
 	if (metric == NULL) {
 		return FALSE;
 	}
@@ -630,7 +700,7 @@ remove_dynamic_symbol(struct rspamd_config *cfg,
 	if (syms != NULL) {
 		ucl_object_t *sym;
 
-		sym = dynamic_metric_find_elt(syms, symbol);
+		sym = dynamic_metric_find_elt(cfg, metric_name, "symbols", symbol);
 
 		if (sym) {
 			ret = ucl_array_delete((ucl_object_t *) syms, sym) != NULL;
@@ -642,6 +712,8 @@ remove_dynamic_symbol(struct rspamd_config *cfg,
 	}
 
 	if (ret) {
+		/* Removal cannot be applied incrementally, so replay the overlay */
+		dynamic_conf_index_rebuild(cfg);
 		apply_dynamic_conf(cfg->current_dynamic_conf, cfg);
 	}
 
@@ -676,26 +748,33 @@ add_dynamic_action(struct rspamd_config *cfg,
 		return FALSE;
 	}
 
-	metric = dynamic_metric_find_metric(cfg->current_dynamic_conf,
-										metric_name);
+	metric = dynamic_metric_find_metric(cfg, metric_name);
 	if (metric == NULL) {
-		metric = new_dynamic_metric(metric_name, cfg->current_dynamic_conf);
+		metric = new_dynamic_metric(cfg, metric_name, cfg->current_dynamic_conf);
 	}
 
 	acts = (ucl_object_t *) ucl_object_lookup(metric, "actions");
 	if (acts != NULL) {
 		ucl_object_t *act;
 
-		act = dynamic_metric_find_elt(acts, action_name);
+		act = dynamic_metric_find_elt(cfg, metric_name, "actions", action_name);
 		if (act) {
 			act->value.dv = value;
 		}
 		else {
-			new_dynamic_elt(acts, action_name, value);
+			new_dynamic_elt(cfg, metric_name, "actions", acts, action_name,
+							value);
 		}
 	}
 
-	apply_dynamic_conf(cfg->current_dynamic_conf, cfg);
+	/* Apply merely the updated action, the rest of the overlay is intact */
+	ucl_object_t *obj_tbl = ucl_object_typed_new(UCL_OBJECT);
+	ucl_object_insert_key(obj_tbl, ucl_object_fromdouble(value),
+						  "score", 0, false);
+	ucl_object_insert_key(obj_tbl, ucl_object_fromdouble(dynamic_conf_priority),
+						  "priority", 0, false);
+	rspamd_config_set_action_score(cfg, action_name, obj_tbl);
+	ucl_object_unref(obj_tbl);
 
 	return TRUE;
 }
@@ -714,8 +793,7 @@ remove_dynamic_action(struct rspamd_config *cfg,
 		return FALSE;
 	}
 
-	metric = dynamic_metric_find_metric(cfg->current_dynamic_conf,
-										metric_name);
+	metric = dynamic_metric_find_metric(cfg, metric_name);
 	if (metric == NULL) {
 		return FALSE;
 	}
@@ -725,7 +803,7 @@ remove_dynamic_action(struct rspamd_config *cfg,
 	if (acts != NULL) {
 		ucl_object_t *act;
 
-		act = dynamic_metric_find_elt(acts, action_name);
+		act = dynamic_metric_find_elt(cfg, metric_name, "actions", action_name);
 
 		if (act) {
 			ret = ucl_array_delete(acts, act) != NULL;
@@ -736,6 +814,8 @@ remove_dynamic_action(struct rspamd_config *cfg,
 	}
 
 	if (ret) {
+		/* Removal cannot be applied incrementally, so replay the overlay */
+		dynamic_conf_index_rebuild(cfg);
 		apply_dynamic_conf(cfg->current_dynamic_conf, cfg);
 	}
 
@@ -98,6 +98,8 @@ struct rspamd_fuzzy_redis_session {
 	char **argv;
 	gsize *argv_lens;
 	struct upstream *up;
+	/* Monotonic time when the check was issued, for upstream latency */
+	double sent_at;
 	unsigned char found_digest[rspamd_cryptobox_HASHBYTES];
 };
 
@@ -530,6 +532,7 @@ rspamd_fuzzy_backend_check_shingles(struct rspamd_fuzzy_redis_session *session)
 	}
 	else {
 		/* Add timeout */
+		session->sent_at = rspamd_get_ticks(FALSE);
 		session->timeout.data = session;
 		ev_now_update_if_cheap((struct ev_loop *) session->event_loop);
 		ev_timer_init(&session->timeout,
@@ -555,6 +558,12 @@ rspamd_fuzzy_redis_check_callback(redisAsyncContext *c, gpointer r,
 	if (c->err == 0 && reply != NULL) {
 		rspamd_upstream_ok(session->up);
 
+		if (session->sent_at > 0) {
+			rspamd_upstream_update_latency(session->up,
+										   rspamd_get_ticks(FALSE) - session->sent_at);
+			session->sent_at = 0;
+		}
+
 		if (reply->type == REDIS_REPLY_ARRAY && reply->elements >= 2) {
 			cur = reply->element[0];
 
@@ -692,11 +701,11 @@ void rspamd_fuzzy_backend_check_redis(struct rspamd_fuzzy_backend *bk,
 	session->up = rspamd_upstream_ref(up);
 	addr = rspamd_upstream_addr_next(up);
 	g_assert(addr != NULL);
-	session->ctx = rspamd_redis_pool_connect(backend->pool,
-											 backend->dbname,
-											 backend->username, backend->password,
-											 rspamd_inet_address_to_string(addr),
-											 rspamd_inet_address_get_port(addr));
+	session->ctx = rspamd_redis_pool_connect_shared(backend->pool,
+													backend->dbname,
+													backend->username, backend->password,
+													rspamd_inet_address_to_string(addr),
+													rspamd_inet_address_get_port(addr));
 
 	if (session->ctx == NULL) {
 		rspamd_upstream_fail(up, TRUE, strerror(errno));
@@ -720,6 +729,7 @@ void rspamd_fuzzy_backend_check_redis(struct rspamd_fuzzy_backend *bk,
 		}
 		else {
 			/* Add timeout */
+			session->sent_at = rspamd_get_ticks(FALSE);
 			session->timeout.data = session;
 			ev_now_update_if_cheap((struct ev_loop *) session->event_loop);
 			ev_timer_init(&session->timeout,
@@ -831,11 +841,11 @@ void rspamd_fuzzy_backend_count_redis(struct rspamd_fuzzy_backend *bk,
 	session->up = rspamd_upstream_ref(up);
 	addr = rspamd_upstream_addr_next(up);
 	g_assert(addr != NULL);
-	session->ctx = rspamd_redis_pool_connect(backend->pool,
-											 backend->dbname,
-											 backend->username, backend->password,
-											 rspamd_inet_address_to_string(addr),
-											 rspamd_inet_address_get_port(addr));
+	session->ctx = rspamd_redis_pool_connect_shared(backend->pool,
+													backend->dbname,
+													backend->username, backend->password,
+													rspamd_inet_address_to_string(addr),
+													rspamd_inet_address_get_port(addr));
 
 	if (session->ctx == NULL) {
 		rspamd_upstream_fail(up, TRUE, strerror(errno));
@@ -969,11 +979,11 @@ void rspamd_fuzzy_backend_version_redis(struct rspamd_fuzzy_backend *bk,
 	session->up = rspamd_upstream_ref(up);
 	addr = rspamd_upstream_addr_next(up);
 	g_assert(addr != NULL);
-	session->ctx = rspamd_redis_pool_connect(backend->pool,
-											 backend->dbname,
-											 backend->username, backend->password,
-											 rspamd_inet_address_to_string(addr),
-											 rspamd_inet_address_get_port(addr));
+	session->ctx = rspamd_redis_pool_connect_shared(backend->pool,
+													backend->dbname,
+													backend->username, backend->password,
+													rspamd_inet_address_to_string(addr),
+													rspamd_inet_address_get_port(addr));
 
 	if (session->ctx == NULL) {
 		rspamd_upstream_fail(up, FALSE, strerror(errno));
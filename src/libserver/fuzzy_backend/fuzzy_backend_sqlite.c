@@ -28,11 +28,17 @@ struct rspamd_fuzzy_backend_sqlite {
 	char id[MEMPOOL_UID_LEN];
 	gsize count;
 	gsize expired;
+	gsize deleted_since_vacuum;
+	int checkpointed_changes;
 	rspamd_mempool_t *pool;
 };
 
 static const double sql_sleep_time = 0.1;
 static const unsigned int max_retries = 10;
+/* Changes accumulated in the WAL before the update path checkpoints it itself */
+static const int wal_checkpoint_threshold = 10000;
+/* Deleted rows before the periodic sync considers a VACUUM worthwhile */
+static const gsize vacuum_threshold = 100000;
 
 #define msg_err_fuzzy_backend(...) rspamd_default_log_function(G_LOG_LEVEL_CRITICAL,                               \
 															   backend->pool->tag.tagname, backend->pool->tag.uid, \
@@ -99,6 +105,7 @@ enum rspamd_fuzzy_statement_idx {
 	RSPAMD_FUZZY_BACKEND_COUNT,
 	RSPAMD_FUZZY_BACKEND_EXPIRE,
 	RSPAMD_FUZZY_BACKEND_VACUUM,
+	RSPAMD_FUZZY_BACKEND_ANALYZE,
 	RSPAMD_FUZZY_BACKEND_DELETE_ORPHANED,
 	RSPAMD_FUZZY_BACKEND_ADD_SOURCE,
 	RSPAMD_FUZZY_BACKEND_VERSION,
@@ -187,6 +194,11 @@ static struct rspamd_fuzzy_stmts {
 		 .args = "",
 		 .stmt = NULL,
 		 .result = SQLITE_DONE},
+		{.idx = RSPAMD_FUZZY_BACKEND_ANALYZE,
+		 .sql = "ANALYZE;",
+		 .args = "",
+		 .stmt = NULL,
+		 .result = SQLITE_DONE},
 		{.idx = RSPAMD_FUZZY_BACKEND_DELETE_ORPHANED,
 		 .sql = "DELETE FROM shingles WHERE value=?1 AND number=?2;",
 		 .args = "II",
@@ -755,14 +767,25 @@ rspamd_fuzzy_backend_sqlite_finish_update(struct rspamd_fuzzy_backend_sqlite *ba
 			return FALSE;
 		}
 		else {
-			if (!rspamd_sqlite3_sync(backend->db, &wal_frames, &wal_checkpointed)) {
-				msg_warn_fuzzy_backend("cannot commit checkpoint: %s",
-									   sqlite3_errmsg(backend->db));
-			}
-			else if (wal_checkpointed > 0) {
-				msg_info_fuzzy_backend("total number of frames in the wal file: "
-									   "%d, checkpointed: %d",
-									   wal_frames, wal_checkpointed);
+			int total_changes = sqlite3_total_changes(backend->db);
+
+			/*
+			 * Defer the blocking WAL checkpoint to the periodic sync unless
+			 * the journal has accumulated a considerable amount of changes,
+			 * e.g. under learn storms
+			 */
+			if (total_changes - backend->checkpointed_changes > wal_checkpoint_threshold) {
+				if (!rspamd_sqlite3_sync(backend->db, &wal_frames, &wal_checkpointed)) {
+					msg_warn_fuzzy_backend("cannot commit checkpoint: %s",
+										   sqlite3_errmsg(backend->db));
+				}
+				else if (wal_checkpointed > 0) {
+					msg_info_fuzzy_backend("total number of frames in the wal file: "
+										   "%d, checkpointed: %d",
+										   wal_frames, wal_checkpointed);
+				}
+
+				backend->checkpointed_changes = total_changes;
 			}
 		}
 	}
@@ -828,6 +851,7 @@ rspamd_fuzzy_backend_sqlite_sync(struct rspamd_fuzzy_backend_sqlite *backend,
 	gboolean ret = FALSE;
 	int64_t expire_lim, expired;
 	int rc, i, orphaned_cnt = 0;
+	int wal_frames, wal_checkpointed;
 	GError *err = NULL;
 	static const char orphaned_shingles[] = "SELECT shingles.value,shingles.number "
 											"FROM shingles "
@@ -861,6 +885,7 @@ rspamd_fuzzy_backend_sqlite_sync(struct rspamd_fuzzy_backend_sqlite *backend,
 
 					if (expired > 0) {
 						backend->expired += expired;
+						backend->deleted_since_vacuum += expired;
 						msg_info_fuzzy_backend("expired %L hashes", expired);
 					}
 				}
@@ -943,6 +968,7 @@ rspamd_fuzzy_backend_sqlite_sync(struct rspamd_fuzzy_backend_sqlite *backend,
 													   RSPAMD_FUZZY_BACKEND_TRANSACTION_COMMIT);
 
 			if (ret == SQLITE_OK) {
+				backend->deleted_since_vacuum += orphaned_cnt;
 				msg_info_fuzzy_backend(
 					"deleted %ud orphaned shingles",
 					orphaned_cnt);
@@ -957,6 +983,37 @@ rspamd_fuzzy_backend_sqlite_sync(struct rspamd_fuzzy_backend_sqlite *backend,
 		}
 	}
 
+	/*
+	 * Checkpoint the WAL from the periodic path, so the update path merely
+	 * appends frames without blocking on the checkpoint itself
+	 */
+	if (rspamd_sqlite3_sync(backend->db, &wal_frames, &wal_checkpointed)) {
+		backend->checkpointed_changes = sqlite3_total_changes(backend->db);
+
+		if (wal_checkpointed > 0) {
+			msg_info_fuzzy_backend("total number of frames in the wal file: "
+								   "%d, checkpointed: %d",
+								   wal_frames, wal_checkpointed);
+		}
+	}
+
+	if (backend->deleted_since_vacuum >= vacuum_threshold) {
+		msg_info_fuzzy_backend("vacuum database after %z deletions",
+							   backend->deleted_since_vacuum);
+
+		/* VACUUM cannot be executed within a transaction */
+		if (rspamd_fuzzy_backend_sqlite_run_stmt(backend, TRUE,
+												 RSPAMD_FUZZY_BACKEND_VACUUM) == SQLITE_OK &&
+			rspamd_fuzzy_backend_sqlite_run_stmt(backend, TRUE,
+												 RSPAMD_FUZZY_BACKEND_ANALYZE) == SQLITE_OK) {
+			backend->deleted_since_vacuum = 0;
+		}
+		else {
+			msg_warn_fuzzy_backend("cannot vacuum database: %s",
+								   sqlite3_errmsg(backend->db));
+		}
+	}
+
 	return ret;
 }
 
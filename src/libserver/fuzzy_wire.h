@@ -120,6 +120,24 @@ RSPAMD_PACKED(rspamd_fuzzy_encrypted_reply)
 
 static const unsigned char fuzzy_encrypted_magic[4] = {'r', 's', 'f', 'e'};
 
+/*
+ * A batch frame packs several complete commands (with their own encryption
+ * envelopes and extensions) into a single datagram; the header is followed
+ * by `count` little endian uint16_t frame lengths and then by the frames
+ * themselves. All replies are returned concatenated in one datagram.
+ */
+#define RSPAMD_FUZZY_BATCH_VERSION 1
+#define RSPAMD_FUZZY_BATCH_MAX 8
+
+RSPAMD_PACKED(rspamd_fuzzy_batch_hdr)
+{
+	unsigned char magic[4];
+	uint8_t version;
+	uint8_t count;
+};
+
+static const unsigned char fuzzy_batch_magic[4] = {'r', 's', 'f', 'b'};
+
 enum rspamd_fuzzy_extension_type {
 	RSPAMD_FUZZY_EXT_SOURCE_DOMAIN = 'd',
 	RSPAMD_FUZZY_EXT_SOURCE_IP4 = '4',
@@ -1384,10 +1384,20 @@ auto html_process_input(struct rspamd_task *task,
 		overflow_input = true;
 	}
 
+	/*
+	 * The visible text cannot outgrow the input (html_append_parsed refuses
+	 * to append above this limit), so reserve the full size upfront: the
+	 * decoded text is then written exactly once instead of being copied
+	 * repeatedly as the buffer grows from its default small reservation
+	 */
+	hc->parsed.reserve(process_size);
+
+	auto tags_limit = (task->cfg && task->cfg->max_html_tags > 0) ? task->cfg->max_html_tags : rspamd::html::max_tags;
+
 	auto new_tag = [&](int flags = 0) -> struct html_tag *
 	{
 
-		if (hc->all_tags.size() > rspamd::html::max_tags) {
+		if (hc->all_tags.size() > tags_limit) {
 			hc->flags |= RSPAMD_HTML_FLAG_TOO_MANY_TAGS;
 
 			return nullptr;
@@ -2336,7 +2346,8 @@ rspamd_html_tag_by_id(int id)
 		const auto *td = rspamd::html::html_tags_defs.by_id(id);
 
 		if (td != nullptr) {
-			return td->name.c_str();
+			/* Names point at string literals, so they are NUL terminated */
+			return td->name.data();
 		}
 	}
 
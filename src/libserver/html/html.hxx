@@ -29,6 +29,7 @@
 #include <memory>
 #include <string>
 #include "function2/function2.hpp"
+#include "libutil/cxx/local_shared_ptr.hxx"
 
 namespace rspamd::css {
 /* Forward declaration */
@@ -48,7 +49,7 @@ struct html_content {
 	std::vector<std::unique_ptr<struct html_tag>> all_tags;
 	std::string parsed;
 	std::string invisible;
-	std::shared_ptr<css::css_style_sheet> css_style;
+	rspamd::local_shared_ptr<css::css_style_sheet> css_style;
 
 	/* Preallocate and reserve all internal structures */
 	html_content()
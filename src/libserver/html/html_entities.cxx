@@ -25,6 +25,10 @@
 #include <unicode/uchar.h>
 #include "libutil/cxx/util.hxx"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define DOCTEST_CONFIG_IMPLEMENTATION_IN_DLL
 #include "doctest/doctest.h"
 
@@ -2228,6 +2232,49 @@ public:
 
 static const html_entities_storage html_entities_defs;
 
+/*
+ * Finds the next byte that needs the decoding state machine: '&' always,
+ * plus any ASCII whitespace when space normalisation is requested. Entity
+ * free spans are skipped in 16-byte chunks where SSE2 is available.
+ */
+static auto
+find_entity_boundary(const char *p, const char *end, bool norm_spaces) -> const char *
+{
+#ifdef __SSE2__
+	const auto amp = _mm_set1_epi8('&');
+	const auto sp = _mm_set1_epi8(' ');
+	/* Whitespace range \t(9)..\r(13): 8 < x < 14, signed compare is fine
+	 * as UTF8 continuation bytes are negative and cannot be spaces */
+	const auto below_tab = _mm_set1_epi8(8);
+	const auto above_cr = _mm_set1_epi8(14);
+
+	while (end - p >= 16) {
+		auto in = _mm_loadu_si128((const __m128i *) p);
+		auto mask = _mm_cmpeq_epi8(in, amp);
+
+		if (norm_spaces) {
+			auto ws = _mm_or_si128(_mm_cmpeq_epi8(in, sp),
+								   _mm_and_si128(_mm_cmpgt_epi8(in, below_tab),
+												 _mm_cmplt_epi8(in, above_cr)));
+			mask = _mm_or_si128(mask, ws);
+		}
+
+		auto bits = _mm_movemask_epi8(mask);
+
+		if (bits != 0) {
+			return p + __builtin_ctz(bits);
+		}
+
+		p += 16;
+	}
+#endif
+	while (p < end && *p != '&' && !(norm_spaces && g_ascii_isspace(*p))) {
+		p++;
+	}
+
+	return p;
+}
+
 std::size_t
 decode_html_entitles_inplace(char *s, std::size_t len, bool norm_spaces)
 {
@@ -2461,6 +2508,21 @@ decode_html_entitles_inplace(char *s, std::size_t len, bool norm_spaces)
 	while (h - s < len && t <= h) {
 		switch (state) {
 		case parser_state::normal_content:
+			/* Bulk copy the span that cannot interest the state machine */
+			if (*h != '&' && !(norm_spaces && g_ascii_isspace(*h))) {
+				const auto *next = find_entity_boundary(h, end, norm_spaces);
+
+				if (next - h > 1) {
+					if (t != h) {
+						memmove(t, h, next - h);
+					}
+
+					t += next - h;
+					h += next - h;
+					break;
+				}
+			}
+
 			if (*h == '&') {
 				state = parser_state::ampersand;
 				seen_hash = false;
@@ -20,24 +20,27 @@
 #include "html_tags.h"
 #include "libutil/cxx/util.hxx"
 
-#include <string>
+#include <string_view>
+#include <utility>
 #include "contrib/ankerl/unordered_dense.h"
+#include "contrib/frozen/include/frozen/unordered_map.h"
+#include "contrib/frozen/include/frozen/string.h"
 
 namespace rspamd::html {
 
 struct html_tag_def {
-	std::string name;
+	std::string_view name;
 	tag_id_t id;
 	unsigned int flags;
 };
 
-#define TAG_DEF(id, name, flags) \
-	html_tag_def                 \
-	{                            \
-		(name), (id), (flags)    \
+#define TAG_DEF(id, name, flags)                       \
+	std::pair<frozen::string, html_tag_def>            \
+	{                                                  \
+		(name), html_tag_def { (name), (id), (flags) } \
 	}
 
-static const auto html_tag_defs_array = rspamd::array_of(
+static constexpr std::pair<frozen::string, html_tag_def> html_tag_defs_array[] = {
 	/* W3C defined elements */
 	TAG_DEF(Tag_A, "a", FL_HREF),
 	TAG_DEF(Tag_ABBR, "abbr", (CM_INLINE)),
@@ -139,29 +142,34 @@ static const auto html_tag_defs_array = rspamd::array_of(
 	TAG_DEF(Tag_UL, "ul", (CM_BLOCK | FL_BLOCK)),
 	TAG_DEF(Tag_VAR, "var", (CM_INLINE)),
 	TAG_DEF(Tag_XMP, "xmp", (CM_BLOCK)),
-	TAG_DEF(Tag_NEXTID, "nextid", (CM_HEAD | CM_EMPTY)));
+	TAG_DEF(Tag_NEXTID, "nextid", (CM_HEAD | CM_EMPTY)),
+};
+
+/*
+ * The tag set is static, so the name lookup is a compile time perfect hash:
+ * a single probe with no runtime hash table construction. Names in the defs
+ * array are already lowercase, matching the lowercased parser buffer.
+ */
+constexpr auto html_tag_by_name_map = frozen::make_unordered_map(html_tag_defs_array);
 
 class html_tags_storage {
-	ankerl::unordered_dense::map<std::string_view, html_tag_def> tag_by_name;
 	ankerl::unordered_dense::map<tag_id_t, html_tag_def> tag_by_id;
 
 public:
 	html_tags_storage()
 	{
-		tag_by_name.reserve(html_tag_defs_array.size());
-		tag_by_id.reserve(html_tag_defs_array.size());
+		tag_by_id.reserve(std::size(html_tag_defs_array));
 
-		for (const auto &t: html_tag_defs_array) {
-			tag_by_name[t.name] = t;
+		for (const auto &[_, t]: html_tag_defs_array) {
 			tag_by_id[t.id] = t;
 		}
 	}
 
 	auto by_name(std::string_view name) const -> const html_tag_def *
 	{
-		auto it = tag_by_name.find(name);
+		auto it = html_tag_by_name_map.find(frozen::string{name.data(), name.size()});
 
-		if (it != tag_by_name.end()) {
+		if (it != html_tag_by_name_map.end()) {
 			return &(it->second);
 		}
 
@@ -307,6 +307,42 @@ void html_check_displayed_url(rspamd_mempool_t *pool,
 	rspamd_normalise_unicode_inplace(url->ext->visible_part, &dlen);
 }
 
+/*
+ * Cheap pre-classifier for href values: rejects things that can never
+ * survive the final checks in html_process_url (fragment references and
+ * pseudo schemes that always end up as PROTOCOL_UNKNOWN), avoiding the
+ * decoding pass and the full rspamd_url_parse for them
+ */
+static auto
+html_url_quick_reject(std::string_view input) -> bool
+{
+	if (input.empty()) {
+		return true;
+	}
+
+	if (input.front() == '#') {
+		/* Fragment reference */
+		return true;
+	}
+
+	static constexpr std::string_view bad_schemes[] = {
+		"javascript:",
+		"vbscript:",
+		"data:",
+		"cid:",
+		"about:",
+	};
+
+	for (const auto &sc: bad_schemes) {
+		if (input.size() > sc.size() &&
+			g_ascii_strncasecmp(input.data(), sc.data(), sc.size()) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 auto html_process_url(rspamd_mempool_t *pool, std::string_view &input)
 	-> std::optional<struct rspamd_url *>
 {
@@ -323,6 +359,10 @@ auto html_process_url(rspamd_mempool_t *pool, std::string_view &input)
 	const auto *trimmed = rspamd_string_unicode_trim_inplace(input.data(), &sz);
 	input = {trimmed, sz};
 
+	if (html_url_quick_reject(input)) {
+		return std::nullopt;
+	}
+
 	const auto *start = input.data();
 	s = start;
 	dlen = 0;
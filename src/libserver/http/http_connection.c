@@ -35,8 +35,17 @@
 
 #include <openssl/err.h>
 
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
 #define ENCRYPTED_VERSION " HTTP/1.0"
 
+#ifdef HAVE_SENDFILE
+/* Minimal body length when zero-copy output beats a single sendmsg call */
+static const gsize http_body_sendfile_threshold = 65536;
+#endif
+
 struct _rspamd_http_privbuf {
 	rspamd_fstring_t *data;
 	const char *zc_buf;
@@ -76,6 +85,10 @@ struct rspamd_http_connection_private {
 	enum rspamd_http_priv_flags flags;
 	gsize wr_pos;
 	gsize wr_total;
+	/* Zero-copy body output for file backed messages; fd is owned by msg */
+	int sendfile_fd;
+	gsize sendfile_offs;
+	gsize sendfile_len;
 };
 
 static const rspamd_ftok_t key_header = {
@@ -447,8 +460,13 @@ rspamd_http_on_body(http_parser *parser, const char *at, size_t length)
 			return -1;
 		}
 
-		/* We might have some leftover in our private buffer */
-		if (pbuf->data->len == length) {
+		/*
+		 * We can switch to zero-copy mode when this chunk ends exactly at
+		 * the end of our private buffer, as the parser has then consumed
+		 * everything read so far; the typical case is the first read that
+		 * mixes headers with the beginning of the body
+		 */
+		if (at + length == pbuf->data->str + pbuf->data->len) {
 			/* Switch to zero-copy mode */
 			rspamd_http_switch_zc(pbuf, msg);
 		}
@@ -768,6 +786,40 @@ rspamd_http_write_helper(struct rspamd_http_connection *conn)
 		goto call_finish_handler;
 	}
 
+#ifdef HAVE_SENDFILE
+	if (priv->sendfile_len > 0 && !priv->ssl &&
+		priv->wr_pos >= priv->wr_total - priv->sendfile_len) {
+		/* Headers are flushed; stream the body directly from the page cache */
+		off_t off = priv->sendfile_offs +
+					(priv->wr_pos - (priv->wr_total - priv->sendfile_len));
+
+		r = sendfile(conn->fd, priv->sendfile_fd, &off,
+					 priv->wr_total - priv->wr_pos);
+
+		if (r == -1) {
+			err = g_error_new(HTTP_ERROR, 500, "IO write error: %s",
+							  strerror(errno));
+			rspamd_http_connection_ref(conn);
+			conn->error_handler(conn, err);
+			rspamd_http_connection_unref(conn);
+			g_error_free(err);
+
+			return;
+		}
+
+		priv->wr_pos += r;
+
+		if (priv->wr_pos >= priv->wr_total) {
+			goto call_finish_handler;
+		}
+
+		/* Want to write more */
+		priv->flags &= ~RSPAMD_HTTP_CONN_FLAG_RESETED;
+
+		return;
+	}
+#endif
+
 	start = &priv->out[0];
 	niov = priv->outlen;
 	remain = priv->wr_pos;
@@ -1301,6 +1353,7 @@ void rspamd_http_connection_reset(struct rspamd_http_connection *conn)
 		priv->out = NULL;
 	}
 
+	priv->sendfile_len = 0;
 	priv->flags |= RSPAMD_HTTP_CONN_FLAG_RESETED;
 }
 
@@ -1673,6 +1726,10 @@ int rspamd_http_message_write_header(const char *mime_type, gboolean encrypted,
 	const char *conn_type = "close";
 
 	if (conn->type == RSPAMD_HTTP_SERVER) {
+		if (msg->flags & RSPAMD_HTTP_FLAG_KEEP_ALIVE) {
+			conn_type = "keep-alive";
+		}
+
 		/* Format reply */
 		if (msg->method < HTTP_SYMBOLS) {
 			rspamd_ftok_t status;
@@ -1712,12 +1769,13 @@ int rspamd_http_message_write_header(const char *mime_type, gboolean encrypted,
 					meth_len =
 						rspamd_snprintf(repbuf, replen,
 										"HTTP/1.1 %d %T\r\n"
-										"Connection: close\r\n"
+										"Connection: %s\r\n"
 										"Server: %s\r\n"
 										"Date: %s\r\n"
 										"Content-Length: %z\r\n"
 										"Content-Type: %s", /* NO \r\n at the end ! */
-										msg->code, &status, priv->ctx->config.server_hdr,
+										msg->code, &status, conn_type,
+										priv->ctx->config.server_hdr,
 										datebuf,
 										bodylen, mime_type);
 				}
@@ -1725,11 +1783,12 @@ int rspamd_http_message_write_header(const char *mime_type, gboolean encrypted,
 					meth_len =
 						rspamd_snprintf(repbuf, replen,
 										"HTTP/1.1 %d %T\r\n"
-										"Connection: close\r\n"
+										"Connection: %s\r\n"
 										"Server: %s\r\n"
 										"Date: %s\r\n"
 										"Content-Length: %z", /* NO \r\n at the end ! */
-										msg->code, &status, priv->ctx->config.server_hdr,
+										msg->code, &status, conn_type,
+										priv->ctx->config.server_hdr,
 										datebuf,
 										bodylen);
 				}
@@ -1737,11 +1796,12 @@ int rspamd_http_message_write_header(const char *mime_type, gboolean encrypted,
 				/* External reply */
 				rspamd_printf_fstring(buf,
 									  "HTTP/1.1 200 OK\r\n"
-									  "Connection: close\r\n"
+									  "Connection: %s\r\n"
 									  "Server: %s\r\n"
 									  "Date: %s\r\n"
 									  "Content-Length: %z\r\n"
 									  "Content-Type: application/octet-stream\r\n",
+									  conn_type,
 									  priv->ctx->config.server_hdr,
 									  datebuf, enclen);
 			}
@@ -1750,12 +1810,13 @@ int rspamd_http_message_write_header(const char *mime_type, gboolean encrypted,
 					meth_len =
 						rspamd_printf_fstring(buf,
 											  "HTTP/1.1 %d %T\r\n"
-											  "Connection: close\r\n"
+											  "Connection: %s\r\n"
 											  "Server: %s\r\n"
 											  "Date: %s\r\n"
 											  "Content-Length: %z\r\n"
 											  "Content-Type: %s\r\n",
-											  msg->code, &status, priv->ctx->config.server_hdr,
+											  msg->code, &status, conn_type,
+											  priv->ctx->config.server_hdr,
 											  datebuf,
 											  bodylen, mime_type);
 				}
@@ -1763,11 +1824,12 @@ int rspamd_http_message_write_header(const char *mime_type, gboolean encrypted,
 					meth_len =
 						rspamd_printf_fstring(buf,
 											  "HTTP/1.1 %d %T\r\n"
-											  "Connection: close\r\n"
+											  "Connection: %s\r\n"
 											  "Server: %s\r\n"
 											  "Date: %s\r\n"
 											  "Content-Length: %z\r\n",
-											  msg->code, &status, priv->ctx->config.server_hdr,
+											  msg->code, &status, conn_type,
+											  priv->ctx->config.server_hdr,
 											  datebuf,
 											  bodylen);
 				}
@@ -2230,6 +2292,26 @@ rspamd_http_connection_write_message_common(struct rspamd_http_connection *conn,
 		}
 	}
 
+#ifdef HAVE_SENDFILE
+	priv->sendfile_len = 0;
+
+	if (pbody != NULL && !encrypted &&
+		!(conn->opts & RSPAMD_HTTP_CLIENT_SSL) &&
+		(msg->flags & RSPAMD_HTTP_FLAG_SHMEM) &&
+		msg->body_buf.c.shared.shm_fd != -1 &&
+		bodylen >= http_body_sendfile_threshold) {
+		/*
+		 * Plain file backed body: serve it with sendfile instead of copying
+		 * the mapped pages through the socket buffer; the fd outlives the
+		 * write as it is owned by the message
+		 */
+		priv->sendfile_fd = msg->body_buf.c.shared.shm_fd;
+		priv->sendfile_offs = msg->body_buf.begin - msg->body_buf.str;
+		priv->sendfile_len = bodylen;
+		pbody = NULL;
+	}
+#endif
+
 	peer_key = msg->peer_key;
 
 	priv->wr_total = bodylen + 2;
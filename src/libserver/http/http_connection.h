@@ -83,6 +83,10 @@ struct rspamd_storage_shmem {
  * Message is intended for SSL connection
  */
 #define RSPAMD_HTTP_FLAG_WANT_SSL (1 << 8)
+/**
+ * Reply will be followed by more requests on the same connection
+ */
+#define RSPAMD_HTTP_FLAG_KEEP_ALIVE (1 << 9)
 /**
  * Options for HTTP connection
  */
@@ -314,6 +314,37 @@ rspamd_http_message_set_body_from_fd(struct rspamd_http_message *msg,
 	return TRUE;
 }
 
+gboolean
+rspamd_http_message_body_to_shared(struct rspamd_http_message *msg)
+{
+	rspamd_fstring_t *normal;
+
+	if (msg->flags & RSPAMD_HTTP_FLAG_SHMEM) {
+		return TRUE;
+	}
+
+	normal = msg->body_buf.c.normal;
+
+	if (normal == NULL) {
+		return FALSE;
+	}
+
+	/* Detach the plain storage and respool it into a fresh shared segment */
+	msg->body_buf.c.shared.name = NULL;
+	msg->body_buf.c.shared.shm_fd = -1;
+	msg->body_buf.str = MAP_FAILED;
+	msg->flags |= RSPAMD_HTTP_FLAG_SHMEM;
+
+	if (!rspamd_http_message_set_body(msg, normal->str, normal->len)) {
+		/* Restore the plain body on failure */
+		return rspamd_http_message_set_body_from_fstring_steal(msg, normal);
+	}
+
+	rspamd_fstring_free(normal);
+
+	return TRUE;
+}
+
 gboolean
 rspamd_http_message_set_body_from_fstring_steal(struct rspamd_http_message *msg,
 												rspamd_fstring_t *fstr)
@@ -121,6 +121,15 @@ void rspamd_http_message_set_method(struct rspamd_http_message *msg,
 gboolean rspamd_http_message_set_body_from_fd(struct rspamd_http_message *msg,
 											  int fd);
 
+/**
+ * Spools a plain message's body into a shared memory segment, so the message
+ * could be handed off to a local peer with no copying; no-op for messages
+ * that are already shared
+ * @param msg
+ * @return TRUE if a message's body is backed by a shared segment
+ */
+gboolean rspamd_http_message_body_to_shared(struct rspamd_http_message *msg);
+
 /**
  * Uses rspamd_fstring_t as message's body, string is consumed by this operation
  * @param msg
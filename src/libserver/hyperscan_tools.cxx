@@ -24,6 +24,7 @@
 #include "contrib/fmt/include/fmt/base.h"
 #include "libutil/cxx/file_util.hxx"
 #include "libutil/cxx/error.hxx"
+#include "libutil/util.h"
 #include "hs.h"
 #include "logger.h"
 #include "worker_util.h"
@@ -371,6 +372,19 @@ hs_shared_from_unserialized(hs_known_files_cache &hs_cache, raii_mmaped_file &&m
 		return tl::make_unexpected(error{is_valid.error(), -1, error_category::IMPORTANT});
 	}
 
+	/*
+	 * The database is scanned in place for the process lifetime, so it is a
+	 * prime candidate for hugepage backing to cut dTLB walks; advisory, and
+	 * for file backed mappings it requires a kernel with read-only THP
+	 */
+	if (rspamd_madvise_hugepages(map.get_map(), map.get_size())) {
+		msg_debug_hyperscan("advised hugepages for %s (%Hz); %Hz of the process "
+							"is hugepage backed",
+							map.get_file().get_name().data(),
+							map.get_size(),
+							rspamd_get_hugepages_rss());
+	}
+
 	hs_cache.add_cached_file(map.get_file());
 	return tl::expected<hs_shared_database, error>{tl::in_place, std::move(map), db};
 }
@@ -390,6 +404,146 @@ hs_shared_from_serialized(hs_known_files_cache &hs_cache, raii_mmaped_file &&map
 	return tl::expected<hs_shared_database, error>{tl::in_place, target, map.get_file().get_name().data()};
 }
 
+/*
+ * The `.unser` companion file is being written by a concurrent process: we
+ * have either lost the creation race or opened the placeholder before the
+ * writer published the real content via rename(2). A private deserialized
+ * copy costs hundreds of megabytes per worker, so it pays off to wait for
+ * the writer to finish (bounded) and share the page cache backed mapping
+ * with the rest of the fleet instead.
+ */
+static auto
+hs_shared_await_unserialized(hs_known_files_cache &hs_cache,
+							 const std::string &unserialized_fname) -> tl::expected<hs_shared_database, error>
+{
+	static constexpr auto max_wait_attempts = 100;
+	static constexpr auto wait_interval_us = 50000; /* 50ms per attempt, up to 5s in total */
+
+	for (auto attempt = 0; attempt < max_wait_attempts; attempt++) {
+		g_usleep(wait_interval_us);
+
+		auto reopened = raii_file::open(unserialized_fname.c_str(), O_RDONLY);
+
+		if (reopened.has_value() && reopened.value().get_size() > 0) {
+			msg_debug_hyperscan("shared hyperscan database %s has been published by a concurrent "
+								"process after %d wait attempts",
+								unserialized_fname.c_str(), attempt + 1);
+			return raii_mmaped_file::mmap_shared(std::move(reopened.value()), PROT_READ)
+				.and_then([&]<class U>(U &&mmapped_unserialized) -> auto {
+					return hs_shared_from_unserialized(hs_cache, std::forward<U>(mmapped_unserialized));
+				});
+		}
+	}
+
+	return tl::make_unexpected(error{fmt::format("timed out waiting for {} to be published",
+												 unserialized_fname),
+									 ETIMEDOUT, error_category::IMPORTANT});
+}
+
+#if defined(HS_MAJOR) && defined(HS_MINOR) && HS_MAJOR >= 5 && HS_MINOR >= 4
+/*
+ * Materialises the `.unser` companion of a serialized database: the blob is
+ * deserialized once into a page aligned buffer, published atomically via
+ * mkstemp+rename under an exclusive lock and reopened read only. Every
+ * process afterwards merely mmaps the shared file instead of keeping a
+ * private deserialized copy on its heap.
+ */
+static auto
+hs_try_create_unserialized(const raii_mmaped_file &cached_serialized,
+						   std::int64_t offset,
+						   const std::string &unserialized_fname) -> tl::expected<raii_file, error>
+{
+	const auto *log_func = RSPAMD_LOG_FUNC;
+
+	return raii_locked_file::create(unserialized_fname.c_str(), O_CREAT | O_RDWR | O_EXCL,
+									00644)
+		.and_then([&](auto &&new_file_locked) -> tl::expected<raii_file, error> {
+			auto tmpfile_pattern = fmt::format("{}{}hsmp-XXXXXXXXXXXXXXXXXX",
+											   cached_serialized.get_file().get_dir(), G_DIR_SEPARATOR);
+			auto tmpfile = raii_locked_file::mkstemp(tmpfile_pattern.data(), O_CREAT | O_RDWR | O_EXCL,
+													 00644);
+
+			if (!tmpfile) {
+				return tl::make_unexpected(tmpfile.error());
+			}
+			else {
+				auto &tmpfile_checked = tmpfile.value();
+				// Store owned string
+				auto tmpfile_name = std::string{tmpfile_checked.get_name()};
+				std::size_t unserialized_size;
+
+				if (auto ret = hs_serialized_database_size(((const char *) cached_serialized.get_map()) + offset,
+														   cached_serialized.get_size() - offset, &unserialized_size);
+					ret != HS_SUCCESS) {
+					return tl::make_unexpected(error{
+						fmt::format("cannot get unserialized database size: {}", ret),
+						EINVAL,
+						error_category::IMPORTANT});
+				}
+
+				msg_debug_hyperscan_lambda("multipattern: create new database in %s; %Hz size",
+										   tmpfile_name.c_str(), unserialized_size);
+				void *buf;
+#ifdef HAVE_GETPAGESIZE
+				auto page_size = getpagesize();
+#else
+				auto page_size = sysconf(_SC_PAGESIZE);
+#endif
+				if (page_size == -1) {
+					page_size = 4096;
+				}
+				auto errcode = posix_memalign(&buf, page_size, unserialized_size);
+				if (errcode != 0 || buf == nullptr) {
+					return tl::make_unexpected(error{"Cannot allocate memory",
+													 errno, error_category::CRITICAL});
+				}
+
+				if (auto ret = hs_deserialize_database_at(((const char *) cached_serialized.get_map()) + offset,
+														  cached_serialized.get_size() - offset, (hs_database_t *) buf);
+					ret != HS_SUCCESS) {
+					return tl::make_unexpected(error{
+						fmt::format("cannot deserialize hyperscan database: {}", ret), ret});
+				}
+				else {
+					if (write(tmpfile_checked.get_fd(), buf, unserialized_size) == -1) {
+						free(buf);
+						return tl::make_unexpected(error{fmt::format("cannot write to {}: {}",
+																	 tmpfile_name, ::strerror(errno)),
+														 errno, error_category::CRITICAL});
+					}
+					else {
+						free(buf);
+						/*
+						* Unlink target file before renaming to avoid
+						* race condition.
+						* So what we have is that `new_file_locked`
+						* will have flock on that file, so it will be
+						* replaced after unlink safely, and also unlocked.
+						*/
+						(void) unlink(unserialized_fname.c_str());
+						if (rename(tmpfile_name.c_str(),
+								   unserialized_fname.c_str()) == -1) {
+							if (errno != EEXIST) {
+								msg_info_hyperscan_lambda("cannot rename %s -> %s: %s",
+														  tmpfile_name.c_str(),
+														  unserialized_fname.c_str(),
+														  strerror(errno));
+							}
+						}
+						else {
+							/* Unlock file but mark it as immortal first to avoid deletion */
+							tmpfile_checked.make_immortal();
+							(void) tmpfile_checked.unlock();
+						}
+					}
+				}
+				/* Reopen in RO mode */
+				return raii_file::open(unserialized_fname.c_str(), O_RDONLY);
+			};
+		});
+}
+#endif// defined(HS_MAJOR) && defined(HS_MINOR) && HS_MAJOR >= 5 && HS_MINOR >= 4
+
 auto load_cached_hs_file(const char *fname, std::int64_t offset = 0) -> tl::expected<hs_shared_database, error>
 {
 	auto &hs_cache = hs_known_files_cache::get();
@@ -402,92 +556,7 @@ auto load_cached_hs_file(const char *fname, std::int64_t offset = 0) -> tl::expe
 			}
 #if defined(HS_MAJOR) && defined(HS_MINOR) && HS_MAJOR >= 5 && HS_MINOR >= 4
 			auto unserialized_fname = fmt::format("{}.unser", fname);
-			auto unserialized_file = raii_locked_file::create(unserialized_fname.c_str(), O_CREAT | O_RDWR | O_EXCL,
-															  00644)
-										 .and_then([&](auto &&new_file_locked) -> tl::expected<raii_file, error> {
-											 auto tmpfile_pattern = fmt::format("{}{}hsmp-XXXXXXXXXXXXXXXXXX",
-																				cached_serialized.get_file().get_dir(), G_DIR_SEPARATOR);
-											 auto tmpfile = raii_locked_file::mkstemp(tmpfile_pattern.data(), O_CREAT | O_RDWR | O_EXCL,
-																					  00644);
-
-											 if (!tmpfile) {
-												 return tl::make_unexpected(tmpfile.error());
-											 }
-											 else {
-												 auto &tmpfile_checked = tmpfile.value();
-												 // Store owned string
-												 auto tmpfile_name = std::string{tmpfile_checked.get_name()};
-												 std::size_t unserialized_size;
-
-												 if (auto ret = hs_serialized_database_size(((const char *) cached_serialized.get_map()) + offset,
-																							cached_serialized.get_size() - offset, &unserialized_size);
-													 ret != HS_SUCCESS) {
-													 return tl::make_unexpected(error{
-														 fmt::format("cannot get unserialized database size: {}", ret),
-														 EINVAL,
-														 error_category::IMPORTANT});
-												 }
-
-												 msg_debug_hyperscan_lambda("multipattern: create new database in %s; %Hz size",
-																			tmpfile_name.c_str(), unserialized_size);
-												 void *buf;
-#ifdef HAVE_GETPAGESIZE
-												 auto page_size = getpagesize();
-#else
-												 auto page_size = sysconf(_SC_PAGESIZE);
-#endif
-												 if (page_size == -1) {
-													 page_size = 4096;
-												 }
-												 auto errcode = posix_memalign(&buf, page_size, unserialized_size);
-												 if (errcode != 0 || buf == nullptr) {
-													 return tl::make_unexpected(error{"Cannot allocate memory",
-																					  errno, error_category::CRITICAL});
-												 }
-
-												 if (auto ret = hs_deserialize_database_at(((const char *) cached_serialized.get_map()) + offset,
-																						   cached_serialized.get_size() - offset, (hs_database_t *) buf);
-													 ret != HS_SUCCESS) {
-													 return tl::make_unexpected(error{
-														 fmt::format("cannot deserialize hyperscan database: {}", ret), ret});
-												 }
-												 else {
-													 if (write(tmpfile_checked.get_fd(), buf, unserialized_size) == -1) {
-														 free(buf);
-														 return tl::make_unexpected(error{fmt::format("cannot write to {}: {}",
-																									  tmpfile_name, ::strerror(errno)),
-																						  errno, error_category::CRITICAL});
-													 }
-													 else {
-														 free(buf);
-														 /*
-														 * Unlink target file before renaming to avoid
-														 * race condition.
-														 * So what we have is that `new_file_locked`
-														 * will have flock on that file, so it will be
-														 * replaced after unlink safely, and also unlocked.
-														 */
-														 (void) unlink(unserialized_fname.c_str());
-														 if (rename(tmpfile_name.c_str(),
-																	unserialized_fname.c_str()) == -1) {
-															 if (errno != EEXIST) {
-																 msg_info_hyperscan_lambda("cannot rename %s -> %s: %s",
-																						   tmpfile_name.c_str(),
-																						   unserialized_fname.c_str(),
-																						   strerror(errno));
-															 }
-														 }
-														 else {
-															 /* Unlock file but mark it as immortal first to avoid deletion */
-															 tmpfile_checked.make_immortal();
-															 (void) tmpfile_checked.unlock();
-														 }
-													 }
-												 }
-												 /* Reopen in RO mode */
-												 return raii_file::open(unserialized_fname.c_str(), O_RDONLY);
-											 };
-										 })
+			auto unserialized_file = hs_try_create_unserialized(cached_serialized, offset, unserialized_fname)
 										 .or_else([&](auto unused) -> tl::expected<raii_file, error> {
 											 // Cannot create file, so try to open it in RO mode
 											 return raii_file::open(unserialized_fname.c_str(), O_RDONLY);
@@ -503,9 +572,13 @@ auto load_cached_hs_file(const char *fname, std::int64_t offset = 0) -> tl::expe
 					/*
 					 * This is a case when we have a file that is currently
 					 * being created by another process.
-					 * We cannot use it!
+					 * Wait for the writer to publish it; a private deserialized
+					 * copy is the last resort as it is not shared across workers.
 					 */
-					ret = hs_shared_from_serialized(hs_cache, std::forward<T>(cached_serialized), offset);
+					ret = hs_shared_await_unserialized(hs_cache, unserialized_fname)
+							  .or_else([&](auto &&) {
+								  return hs_shared_from_serialized(hs_cache, std::forward<T>(cached_serialized), offset);
+							  });
 				}
 				else {
 					ret = raii_mmaped_file::mmap_shared(std::move(unserialized_checked), PROT_READ)
@@ -514,6 +587,17 @@ auto load_cached_hs_file(const char *fname, std::int64_t offset = 0) -> tl::expe
 							  });
 				}
 			}
+			else if (unserialized_file.error().error_code == ENOENT) {
+				/*
+				 * Cannot create nor open the unserialized file: it might be
+				 * transiently missing between the writer's unlink and rename,
+				 * so give the writer a chance before deserializing privately
+				 */
+				ret = hs_shared_await_unserialized(hs_cache, unserialized_fname)
+						  .or_else([&](auto &&) {
+							  return hs_shared_from_serialized(hs_cache, std::forward<T>(cached_serialized), offset);
+						  });
+			}
 			else {
 				ret = hs_shared_from_serialized(hs_cache, std::forward<T>(cached_serialized), offset);
 			}
@@ -591,6 +675,36 @@ void rspamd_hyperscan_free(rspamd_hyperscan_t *db, bool invalid)
 	delete real_db;
 }
 
+bool rspamd_hyperscan_prepare_unserialized(const char *fname, goffset offset)
+{
+#if defined(HS_MAJOR) && defined(HS_MINOR) && HS_MAJOR >= 5 && HS_MINOR >= 4
+	auto unserialized_fname = fmt::format("{}.unser", fname);
+	auto ret = rspamd::util::raii_mmaped_file::mmap_shared(fname, O_RDONLY, PROT_READ, 0)
+				   .and_then([&](auto &&cached_serialized) -> tl::expected<rspamd::util::raii_file, rspamd::util::error> {
+					   if (cached_serialized.get_size() <= offset) {
+						   return tl::make_unexpected(rspamd::util::error{"Invalid offset", EINVAL,
+																		  rspamd::util::error_category::CRITICAL});
+					   }
+
+					   return rspamd::util::hs_try_create_unserialized(cached_serialized, offset,
+																	   unserialized_fname);
+				   });
+
+	if (ret.has_value()) {
+		msg_debug_hyperscan("prepared unserialized database %s",
+							unserialized_fname.c_str());
+		rspamd_hyperscan_notice_known(unserialized_fname.c_str());
+
+		return true;
+	}
+
+	msg_debug_hyperscan("cannot prepare unserialized database for %s: %s",
+						fname, ret.error().error_message.data());
+#endif
+
+	return false;
+}
+
 void rspamd_hyperscan_notice_known(const char *fname)
 {
 	rspamd::util::hs_known_files_cache::get().add_cached_file(fname);
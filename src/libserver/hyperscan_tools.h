@@ -54,6 +54,16 @@ hs_database_t *rspamd_hyperscan_get_database(rspamd_hyperscan_t *db);
  */
 void rspamd_hyperscan_free(rspamd_hyperscan_t *db, bool invalid);
 
+/**
+ * Prepares the unserialized companion for a serialized hyperscan file, so
+ * subsequent loads in other processes merely mmap it instead of running
+ * the expensive deserialization in their event loops
+ * @param fname path to the serialized file
+ * @param offset offset of the hyperscan blob within the file
+ * @return true if the companion file has been created
+ */
+bool rspamd_hyperscan_prepare_unserialized(const char *fname, goffset offset);
+
 /**
  * Notice a known hyperscan file (e.g. externally serialized)
  * @param fname
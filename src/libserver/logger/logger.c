@@ -1053,6 +1053,52 @@ void rspamd_log_fill_iov(struct rspamd_logger_iov_ctx *iov_ctx,
 	bool log_rspamadm = (logger->flags & RSPAMD_LOG_FLAG_RSPAMADM);
 	bool log_systemd = (logger->flags & RSPAMD_LOG_FLAG_SYSTEMD);
 	bool log_json = (logger->flags & RSPAMD_LOG_FLAG_JSON);
+	bool log_binary = (logger->flags & RSPAMD_LOG_FLAG_BINARY);
+
+	if (G_UNLIKELY(log_binary)) {
+		/* All human readable formatting is deferred to rspamadm logcat */
+		static struct rspamd_logger_bin_rec hdr;
+		const char *ptype = logger->process_type ? logger->process_type : "";
+		unsigned int niov = 0;
+
+		hdr.magic = RSPAMD_LOGGER_BIN_MAGIC;
+		hdr.ts = ts;
+		hdr.pid = logger->pid;
+		hdr.level_flags = level_flags;
+		hdr.mlen = mlen;
+		hdr.ptype_len = MIN(strlen(ptype), 255U);
+		hdr.id_len = id ? rspamd_log_id_strlen(id) : 0;
+		hdr.module_len = module ? MIN(strlen(module), 255U) : 0;
+		hdr.function_len = function ? MIN(strlen(function), 255U) : 0;
+		hdr.len = sizeof(hdr) + hdr.ptype_len + hdr.id_len +
+				  hdr.module_len + hdr.function_len + hdr.mlen;
+
+		iov_ctx->iov[niov].iov_base = &hdr;
+		iov_ctx->iov[niov++].iov_len = sizeof(hdr);
+
+		if (hdr.ptype_len > 0) {
+			iov_ctx->iov[niov].iov_base = (void *) ptype;
+			iov_ctx->iov[niov++].iov_len = hdr.ptype_len;
+		}
+		if (hdr.id_len > 0) {
+			iov_ctx->iov[niov].iov_base = (void *) id;
+			iov_ctx->iov[niov++].iov_len = hdr.id_len;
+		}
+		if (hdr.module_len > 0) {
+			iov_ctx->iov[niov].iov_base = (void *) module;
+			iov_ctx->iov[niov++].iov_len = hdr.module_len;
+		}
+		if (hdr.function_len > 0) {
+			iov_ctx->iov[niov].iov_base = (void *) function;
+			iov_ctx->iov[niov++].iov_len = hdr.function_len;
+		}
+
+		iov_ctx->iov[niov].iov_base = (void *) message;
+		iov_ctx->iov[niov++].iov_len = mlen;
+		iov_ctx->niov = niov;
+
+		return;
+	}
 
 	if (log_json) {
 		/* Some sanity to avoid too many branches */
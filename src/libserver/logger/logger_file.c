@@ -22,8 +22,15 @@
 
 #include "logger_private.h"
 
+#include <pthread.h>
+
 #define FILE_LOG_QUARK g_quark_from_static_string("file_logger")
 
+/* Default size of the asynchronous log ring (must be a power of two) */
+#define ASYNC_LOGBUF_LEN (1024U * 1024U)
+/* How long the flusher sleeps when the ring is empty, microseconds */
+#define ASYNC_FLUSH_TIMEOUT 50000
+
 struct rspamd_file_logger_priv {
 	int fd;
 	struct {
@@ -31,9 +38,20 @@ struct rspamd_file_logger_priv {
 		uint32_t used;
 		u_char *buf;
 	} io_buf;
+	struct {
+		u_char *buf;           /* Ring of complete formatted lines */
+		uint32_t size;         /* Power of two */
+		unsigned int head;     /* Free running producer offset */
+		unsigned int tail;     /* Free running consumer offset */
+		unsigned int dropped;  /* Lines discarded on ring overflow */
+		int stop;              /* Flusher termination request */
+		pthread_t flusher;
+		gboolean running;
+	} async;
 	gboolean throttling;
 	char *log_file;
 	gboolean is_buffered;
+	gboolean is_async;
 	gboolean log_severity;
 	time_t throttling_time;
 	uint32_t repeats;
@@ -153,6 +171,146 @@ direct_write_log_line(rspamd_logger_t *rspamd_log,
 	return true;
 }
 
+/*
+ * Copy a complete formatted line to the async ring; merely drops the line
+ * incrementing the overflow counter when there is not enough room, so the
+ * producer never blocks on the log file
+ */
+static bool
+file_log_ring_push(struct rspamd_file_logger_priv *priv,
+				   const struct iovec *iov, unsigned int iovcnt)
+{
+	unsigned int mask = priv->async.size - 1, head, tail, i;
+	gsize len = 0;
+
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	/* Solely the producer modifies the head */
+	head = priv->async.head;
+	tail = (unsigned int) g_atomic_int_get(&priv->async.tail);
+
+	if (len > (gsize) (priv->async.size - (head - tail))) {
+		g_atomic_int_inc(&priv->async.dropped);
+
+		return false;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		unsigned int pos = head & mask;
+		gsize contig = priv->async.size - pos;
+
+		if (iov[i].iov_len <= contig) {
+			memcpy(priv->async.buf + pos, iov[i].iov_base, iov[i].iov_len);
+		}
+		else {
+			memcpy(priv->async.buf + pos, iov[i].iov_base, contig);
+			memcpy(priv->async.buf, (u_char *) iov[i].iov_base + contig,
+				   iov[i].iov_len - contig);
+		}
+
+		head += iov[i].iov_len;
+	}
+
+	/* Publish complete lines merely */
+	g_atomic_int_set(&priv->async.head, head);
+
+	return true;
+}
+
+static void
+file_log_flusher_drain(struct rspamd_file_logger_priv *priv)
+{
+	unsigned int mask = priv->async.size - 1, head, tail, pos;
+	gsize rlen, contig;
+	glong r;
+	int d;
+
+	head = (unsigned int) g_atomic_int_get(&priv->async.head);
+	tail = priv->async.tail;
+
+	if (head != tail) {
+		pos = tail & mask;
+		rlen = head - tail;
+		contig = MIN(rlen, priv->async.size - pos);
+
+		do {
+			r = write(priv->fd, priv->async.buf + pos, contig);
+		} while (r == -1 && errno == EINTR);
+
+		if (r > 0 && rlen > contig) {
+			do {
+				r = write(priv->fd, priv->async.buf, rlen - contig);
+			} while (r == -1 && errno == EINTR);
+		}
+
+		/* Advance the tail even on write errors to avoid a stuck ring */
+		g_atomic_int_set(&priv->async.tail, head);
+	}
+
+	d = g_atomic_int_get(&priv->async.dropped);
+
+	if (d > 0) {
+		char tmpbuf[128];
+
+		g_atomic_int_add(&priv->async.dropped, -d);
+		r = rspamd_snprintf(tmpbuf, sizeof(tmpbuf),
+							"async log ring overflow: %d lines dropped\n", d);
+		(void) write(priv->fd, tmpbuf, r);
+	}
+}
+
+static void *
+file_log_flusher_thread(void *ud)
+{
+	struct rspamd_file_logger_priv *priv =
+		(struct rspamd_file_logger_priv *) ud;
+
+	for (;;) {
+		file_log_flusher_drain(priv);
+
+		if (g_atomic_int_get(&priv->async.stop)) {
+			/* Drain the remainder written whilst we were flushing */
+			file_log_flusher_drain(priv);
+			break;
+		}
+
+		g_usleep(ASYNC_FLUSH_TIMEOUT);
+	}
+
+	return NULL;
+}
+
+static void
+file_log_start_flusher(struct rspamd_file_logger_priv *priv)
+{
+	priv->async.head = 0;
+	priv->async.tail = 0;
+	priv->async.dropped = 0;
+	priv->async.stop = 0;
+
+	if (pthread_create(&priv->async.flusher, NULL, file_log_flusher_thread,
+					   priv) == 0) {
+		priv->async.running = TRUE;
+	}
+	else {
+		/* Fallback to synchronous writes */
+		priv->async.running = FALSE;
+		priv->is_async = FALSE;
+	}
+}
+
+static void
+file_log_stop_flusher(struct rspamd_file_logger_priv *priv)
+{
+	if (priv->async.running) {
+		g_atomic_int_set(&priv->async.stop, 1);
+		pthread_join(priv->async.flusher, NULL);
+		priv->async.running = FALSE;
+	}
+}
+
 /**
  * Fill buffer with message (limits must be checked BEFORE this call)
  */
@@ -198,6 +356,11 @@ file_log_helper(rspamd_logger_t *rspamd_log,
 	size_t len = 0;
 	unsigned int i;
 
+	if (priv->is_async) {
+		/* Lines are drained by the flusher thread */
+		return file_log_ring_push(priv, iov, iovcnt);
+	}
+
 	if (!priv->is_buffered) {
 		/* Write string directly */
 		return direct_write_log_line(rspamd_log, priv, (void *) iov, iovcnt,
@@ -321,7 +484,22 @@ rspamd_log_file_init(rspamd_logger_t *logger, struct rspamd_config *cfg,
 
 	priv = g_malloc0(sizeof(*priv));
 
-	if (cfg->log_buffered) {
+	if (cfg->log_async) {
+		priv->async.size = ASYNC_LOGBUF_LEN;
+
+		if (cfg->log_buf_size != 0) {
+			/* Round up to the next power of two */
+			priv->async.size = 1U;
+
+			while (priv->async.size < cfg->log_buf_size) {
+				priv->async.size <<= 1U;
+			}
+		}
+
+		priv->is_async = TRUE;
+		priv->async.buf = g_malloc(priv->async.size);
+	}
+	else if (cfg->log_buffered) {
 		if (cfg->log_buf_size != 0) {
 			priv->io_buf.size = cfg->log_buf_size;
 		}
@@ -345,6 +523,10 @@ rspamd_log_file_init(rspamd_logger_t *logger, struct rspamd_config *cfg,
 		return NULL;
 	}
 
+	if (priv->is_async) {
+		file_log_start_flusher(priv);
+	}
+
 	return priv;
 }
 
@@ -354,6 +536,8 @@ void rspamd_log_file_dtor(rspamd_logger_t *logger, gpointer arg)
 
 	rspamd_log_reset_repeated(logger, priv);
 	rspamd_log_flush(logger, priv);
+	/* Drain the remaining lines and terminate the flusher */
+	file_log_stop_flusher(priv);
 
 	if (priv->fd != -1) {
 		if (close(priv->fd) == -1) {
@@ -362,6 +546,7 @@ void rspamd_log_file_dtor(rspamd_logger_t *logger, gpointer arg)
 		}
 	}
 
+	g_free(priv->async.buf);
 	g_free(priv->log_file);
 	g_free(priv);
 }
@@ -503,6 +688,16 @@ bool rspamd_log_file_on_fork(rspamd_logger_t *logger, struct rspamd_config *cfg,
 {
 	struct rspamd_file_logger_priv *priv = (struct rspamd_file_logger_priv *) arg;
 
+	if (priv->is_async) {
+		/*
+		 * The flusher thread is not inherited over fork, so respawn it in the
+		 * child dropping the inherited ring content: the parent still owns and
+		 * flushes those lines
+		 */
+		priv->async.running = FALSE;
+		file_log_start_flusher(priv);
+	}
+
 	rspamd_log_reset_repeated(logger, priv);
 	rspamd_log_flush(logger, priv);
 
@@ -103,6 +103,26 @@ bool rspamd_log_file_log(const char *module, const char *id,
 bool rspamd_log_file_on_fork(rspamd_logger_t *logger, struct rspamd_config *cfg,
 							 gpointer arg, GError **err);
 
+/*
+ * On disk record of the binary log format: the header is written in the host
+ * byte order followed by the process type, id, module, function and message
+ * strings without terminators; rendering to text is deferred to
+ * `rspamadm logcat`
+ */
+#define RSPAMD_LOGGER_BIN_MAGIC 0x4C425352U /* RSBL */
+struct rspamd_logger_bin_rec {
+	uint32_t magic;
+	uint32_t len; /* Full record length including this header */
+	double ts;
+	int32_t pid;
+	int32_t level_flags;
+	uint32_t mlen;
+	uint8_t ptype_len;
+	uint8_t id_len;
+	uint8_t module_len;
+	uint8_t function_len;
+};
+
 struct rspamd_logger_iov_thrash_stack {
 	struct rspamd_logger_iov_thrash_stack *prev;
 	char data[0];
@@ -679,6 +679,38 @@ read_map_file_chunks(struct rspamd_map *map, struct map_cb_data *cbdata,
 	return TRUE;
 }
 
+/*
+ * Digests of (signature, key, payload) tuples that have already passed
+ * verification: signed maps refreshing on staggered timers mostly
+ * re-download unchanged content, and the elliptic curve part of the
+ * verification costs much more than a single digest pass over the payload
+ */
+#define RSPAMD_MAP_VERIFIED_CACHE_SIZE 64
+
+static unsigned char map_verified_digests[RSPAMD_MAP_VERIFIED_CACHE_SIZE]
+										 [rspamd_cryptobox_HASHBYTES];
+static unsigned int map_verified_cnt = 0;
+static unsigned int map_verified_pos = 0;
+
+static void
+rspamd_map_sig_digest(const unsigned char *sig, gsize siglen,
+					  const unsigned char *input, gsize inlen,
+					  struct rspamd_cryptobox_pubkey *pk,
+					  unsigned char *out)
+{
+	rspamd_cryptobox_hash_state_t st;
+	const unsigned char *pk_data;
+	unsigned int pk_len = 0;
+
+	pk_data = rspamd_pubkey_get_pk(pk, &pk_len);
+
+	rspamd_cryptobox_hash_init(&st, NULL, 0);
+	rspamd_cryptobox_hash_update(&st, sig, siglen);
+	rspamd_cryptobox_hash_update(&st, pk_data, pk_len);
+	rspamd_cryptobox_hash_update(&st, input, inlen);
+	rspamd_cryptobox_hash_final(&st, out);
+}
+
 static gboolean
 rspamd_map_check_sig_pk_mem(const unsigned char *sig,
 							gsize siglen,
@@ -688,7 +720,9 @@ rspamd_map_check_sig_pk_mem(const unsigned char *sig,
 							struct rspamd_cryptobox_pubkey *pk)
 {
 	GString *b32_key;
+	unsigned char digest[rspamd_cryptobox_HASHBYTES];
 	gboolean ret = TRUE;
+	unsigned int i;
 
 	if (siglen != crypto_sign_bytes()) {
 		msg_err_map("can't open signature for %s: invalid size: %z", map->name, siglen);
@@ -696,6 +730,21 @@ rspamd_map_check_sig_pk_mem(const unsigned char *sig,
 		ret = FALSE;
 	}
 
+	if (ret) {
+		rspamd_map_sig_digest(sig, siglen, input, inlen, pk, digest);
+
+		for (i = 0; i < map_verified_cnt; i++) {
+			if (memcmp(map_verified_digests[i], digest,
+					   rspamd_cryptobox_HASHBYTES) == 0) {
+				msg_debug_map("signature for %s has been verified already, "
+							  "content is unchanged",
+							  map->name);
+
+				return TRUE;
+			}
+		}
+	}
+
 	if (ret && !rspamd_cryptobox_verify(sig, siglen, input, inlen,
 										rspamd_pubkey_get_pk(pk, NULL))) {
 		msg_err_map("can't verify signature for %s: incorrect signature", map->name);
@@ -704,6 +753,16 @@ rspamd_map_check_sig_pk_mem(const unsigned char *sig,
 	}
 
 	if (ret) {
+		/* Remember the verified tuple to skip re-verification on refresh */
+		memcpy(map_verified_digests[map_verified_pos], digest,
+			   rspamd_cryptobox_HASHBYTES);
+		map_verified_pos = (map_verified_pos + 1) %
+						   RSPAMD_MAP_VERIFIED_CACHE_SIZE;
+
+		if (map_verified_cnt < RSPAMD_MAP_VERIFIED_CACHE_SIZE) {
+			map_verified_cnt++;
+		}
+
 		b32_key = rspamd_pubkey_print(pk,
 									  RSPAMD_KEYPAIR_ENCODING_DEFAULT,
 									  RSPAMD_KEYPAIR_PUBKEY);
@@ -1313,12 +1372,14 @@ rspamd_map_dns_callback(struct rdns_reply *reply, void *arg)
 		if (cbd->bk->protocol == MAP_PROTO_HTTPS) {
 			flags |= RSPAMD_HTTP_CLIENT_SSL;
 		}
-		cbd->conn = rspamd_http_connection_new_client(NULL,
-													  NULL,
-													  http_map_error,
-													  http_map_finish,
-													  flags,
-													  cbd->addr);
+		/* Reuse connections between map polls to avoid TCP+TLS handshakes */
+		cbd->conn = rspamd_http_connection_new_client_keepalive(NULL,
+																NULL,
+																http_map_error,
+																http_map_finish,
+																flags,
+																cbd->addr,
+																cbd->data->host);
 
 		if (cbd->conn != NULL) {
 			write_http_request(cbd);
@@ -1855,13 +1916,15 @@ check:
 			flags |= RSPAMD_HTTP_CLIENT_SSL;
 		}
 
-		cbd->conn = rspamd_http_connection_new_client(
+		/* Reuse connections between map polls to avoid TCP+TLS handshakes */
+		cbd->conn = rspamd_http_connection_new_client_keepalive(
 			NULL,
 			NULL,
 			http_map_error,
 			http_map_finish,
 			flags,
-			addr);
+			addr,
+			data->host);
 
 		if (cbd->conn != NULL) {
 			cbd->stage = http_map_http_conn;
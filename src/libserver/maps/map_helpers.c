@@ -41,7 +41,9 @@ static const char *const hash_fill = "1";
 struct rspamd_map_helper_value {
 	gsize hits;
 	gconstpointer key;
-	char value[]; /* Null terminated */
+	unsigned int gen; /* Generation of the last insertion, used for sweeping */
+	unsigned int idx; /* Index of the hit counter for hash maps */
+	char value[];     /* Null terminated */
 };
 
 #define rspamd_map_ftok_hash(t) (rspamd_icase_hash((t).begin, (t).len, rspamd_hash_seed()))
@@ -63,7 +65,27 @@ struct rspamd_hash_map_helper {
 	rspamd_mempool_t *pool;
 	khash_t(rspamd_map_hash) * htb;
 	struct rspamd_map *map;
-	rspamd_cryptobox_fast_hash_state_t hst;
+	uint64_t digest;     /* XOR of per-key hashes, invariant to insertion order */
+	unsigned int gen;    /* Incremented on each in-place update */
+	unsigned int leaked; /* Replaced or deleted entries still residing in the pool */
+	/*
+	 * Hit counters are kept aside from the entries: maps are built in the
+	 * main process before fork and inherited copy-on-write, so bumping a
+	 * counter inside an entry would gradually privatise the whole table in
+	 * every worker, whilst writes to this compact array dirty merely a few
+	 * pages
+	 */
+	gsize *hits;
+	unsigned int hits_alloc;
+	unsigned int nidx;
+	/*
+	 * Blocked bloom filter over the keys, rebuilt on each (re)load: multimap
+	 * rules probe dozens of maps per message with sub-percent hit rates, so
+	 * the common miss is answered from a single cache line instead of a
+	 * khash probe chasing the keys. NULL for an empty map
+	 */
+	uint64_t *bloom;
+	unsigned int bloom_nblocks; /* Power of two, 64 bytes per block */
 };
 
 struct rspamd_cdb_map_helper {
@@ -91,6 +113,88 @@ struct rspamd_regexp_map_helper {
 #endif
 };
 
+/*
+ * Keys of a hash map are summarised in a blocked bloom filter: a single
+ * 64-byte block is selected by the high bits of the key hash and 4 bits
+ * within it by the low ones, so a miss costs one cache line. Sized at
+ * ~32 keys per block the filter stays around 1% false positives
+ */
+#define MAP_BLOOM_BLOCK_WORDS 8
+#define MAP_BLOOM_KEYS_PER_BLOCK 32
+
+static inline uint64_t *
+rspamd_map_bloom_block(uint64_t *bloom, unsigned int nblocks, uint64_t h)
+{
+	return bloom + ((h >> 36) & (nblocks - 1)) * MAP_BLOOM_BLOCK_WORDS;
+}
+
+static inline void
+rspamd_map_bloom_set(uint64_t *bloom, unsigned int nblocks, uint64_t h)
+{
+	uint64_t *block = rspamd_map_bloom_block(bloom, nblocks, h);
+	unsigned int i, bit;
+
+	for (i = 0; i < 4; i++) {
+		bit = (h >> (i * 9)) & 511;
+		block[bit >> 6] |= 1ULL << (bit & 63);
+	}
+}
+
+static inline gboolean
+rspamd_map_bloom_check(const uint64_t *bloom, unsigned int nblocks, uint64_t h)
+{
+	const uint64_t *block = rspamd_map_bloom_block((uint64_t *) bloom, nblocks, h);
+	unsigned int i, bit;
+
+	for (i = 0; i < 4; i++) {
+		bit = (h >> (i * 9)) & 511;
+
+		if (!(block[bit >> 6] & (1ULL << (bit & 63)))) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+rspamd_map_helper_rebuild_bloom(struct rspamd_hash_map_helper *ht)
+{
+	rspamd_ftok_t tok;
+	unsigned int nblocks = 1;
+	khiter_t k;
+
+	g_free(ht->bloom);
+	ht->bloom = NULL;
+	ht->bloom_nblocks = 0;
+
+	if (kh_size(ht->htb) == 0) {
+		return;
+	}
+
+	while (nblocks * MAP_BLOOM_KEYS_PER_BLOCK < kh_size(ht->htb)) {
+		nblocks <<= 1;
+	}
+
+	ht->bloom = g_malloc0(nblocks * MAP_BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+	ht->bloom_nblocks = nblocks;
+	/*
+	 * The filter of a multi-million keys map spans several megabytes and is
+	 * probed on every lookup, so back it with hugepages where possible
+	 */
+	rspamd_madvise_hugepages(ht->bloom,
+							 nblocks * MAP_BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+
+	for (k = kh_begin(ht->htb); k != kh_end(ht->htb); ++k) {
+		if (!kh_exist(ht->htb, k)) {
+			continue;
+		}
+
+		tok = kh_key(ht->htb, k);
+		rspamd_map_bloom_set(ht->bloom, nblocks, rspamd_map_ftok_hash(tok));
+	}
+}
+
 /**
  * FSM for parsing lists
  */
@@ -584,6 +688,7 @@ void rspamd_map_helper_insert_hash(gpointer st, gconstpointer key, gconstpointer
 	gconstpointer nk;
 	gsize vlen;
 	int r;
+	unsigned int idx;
 	rspamd_ftok_t tok;
 	struct rspamd_map *map;
 
@@ -597,18 +702,44 @@ void rspamd_map_helper_insert_hash(gpointer st, gconstpointer key, gconstpointer
 		nk = rspamd_mempool_strdup(ht->pool, key);
 		tok.begin = nk;
 		k = kh_put(rspamd_map_hash, ht->htb, tok, &r);
+		ht->digest ^= rspamd_cryptobox_fast_hash(nk, tok.len, map_hash_seed);
+
+		if (ht->bloom) {
+			/* Keep the filter a superset during incremental updates */
+			rspamd_map_bloom_set(ht->bloom, ht->bloom_nblocks,
+								 rspamd_map_ftok_hash(tok));
+		}
+
+		/* Claim a new hit counter */
+		idx = ht->nidx++;
+
+		if (idx >= ht->hits_alloc) {
+			unsigned int nalloc = MAX(ht->hits_alloc * 2, 64);
+
+			ht->hits = g_realloc(ht->hits, nalloc * sizeof(gsize));
+			memset(ht->hits + ht->hits_alloc, 0,
+				   (nalloc - ht->hits_alloc) * sizeof(gsize));
+			ht->hits_alloc = nalloc;
+		}
 	}
 	else {
 		val = kh_value(ht->htb, k);
 
 		if (strcmp(value, val->value) == 0) {
 			/* Same element, skip */
+			val->gen = ht->gen;
 			return;
 		}
-		else {
+		else if (val->gen == ht->gen) {
+			/* A genuine duplicate within a single load */
 			msg_warn_map("duplicate hash entry found for map %s: %s (old value: '%s', new: '%s')",
 						 map->name, key, val->value, value);
 		}
+
+		/* The replaced value resides in the pool until a full rebuild */
+		ht->leaked++;
+		idx = val->idx;
+		ht->hits[idx] = 0;
 	}
 
 	/* Null termination due to alloc0 */
@@ -619,9 +750,9 @@ void rspamd_map_helper_insert_hash(gpointer st, gconstpointer key, gconstpointer
 	tok = kh_key(ht->htb, k);
 	nk = tok.begin;
 	val->key = nk;
+	val->gen = ht->gen;
+	val->idx = idx;
 	kh_value(ht->htb, k) = val;
-
-	rspamd_cryptobox_fast_hash_update(&ht->hst, nk, tok.len);
 }
 
 void rspamd_map_helper_insert_re(gpointer st, gconstpointer key, gconstpointer value)
@@ -758,7 +889,6 @@ rspamd_map_helper_new_hash(struct rspamd_map *map)
 	htb->htb = kh_init(rspamd_map_hash);
 	htb->pool = pool;
 	htb->map = map;
-	rspamd_cryptobox_fast_hash_init(&htb->hst, map_hash_seed);
 
 	return htb;
 }
@@ -771,6 +901,8 @@ void rspamd_map_helper_destroy_hash(struct rspamd_hash_map_helper *r)
 
 	rspamd_mempool_t *pool = r->pool;
 	kh_destroy(rspamd_map_hash, r->htb);
+	g_free(r->hits);
+	g_free(r->bloom);
 	memset(r, 0, sizeof(*r));
 	rspamd_mempool_delete(pool);
 }
@@ -786,12 +918,12 @@ rspamd_map_helper_traverse_hash(void *data,
 	struct rspamd_hash_map_helper *ht = data;
 
 	kh_foreach(ht->htb, tok, val, {
-		if (!cb(tok.begin, val->value, val->hits, cbdata)) {
+		if (!cb(tok.begin, val->value, ht->hits[val->idx], cbdata)) {
 			break;
 		}
 
 		if (reset_hits) {
-			val->hits = 0;
+			ht->hits[val->idx] = 0;
 		}
 	});
 }
@@ -932,7 +1064,27 @@ rspamd_kv_list_read(
 	gboolean final)
 {
 	if (data->cur_data == NULL) {
-		data->cur_data = rspamd_map_helper_new_hash(data->map);
+		struct rspamd_hash_map_helper *old =
+			(struct rspamd_hash_map_helper *) data->prev_data;
+
+		/*
+		 * Routine updates of large maps normally touch a handful of
+		 * entries, so when there is a single backend we apply the new
+		 * content onto the previous hash in place instead of building a
+		 * transient full copy: entries are stamped with a new generation
+		 * whilst parsing and the stale ones are swept out in the fin
+		 * callback. Replaced entries merely leak pool memory, hence fall
+		 * back to a full rebuild when too many of them have accumulated.
+		 */
+		if (old != NULL && data->map->backends->len == 1 &&
+			old->leaked * 2 < kh_size(old->htb)) {
+			old->gen++;
+			data->cur_data = old;
+			data->prev_data = NULL;
+		}
+		else {
+			data->cur_data = rspamd_map_helper_new_hash(data->map);
+		}
 	}
 
 	return rspamd_parse_kv_list(
@@ -952,21 +1104,69 @@ void rspamd_kv_list_fin(struct map_cb_data *data, void **target)
 	if (data->errored) {
 		/* Clean up the current data and do not touch prev data */
 		if (data->cur_data) {
-			msg_info_map("cleanup unfinished new data as error occurred for %s",
-						 map->name);
 			htb = (struct rspamd_hash_map_helper *) data->cur_data;
-			rspamd_map_helper_destroy_hash(htb);
+
+			if (htb->gen > 0) {
+				/*
+				 * The new content was applied onto the live hash in
+				 * place; keep it as is (partially updated at worst) and
+				 * let the next check reload the map
+				 */
+				msg_info_map("keep the current hash as error occurred for %s",
+							 map->name);
+			}
+			else {
+				msg_info_map("cleanup unfinished new data as error occurred for %s",
+							 map->name);
+				rspamd_map_helper_destroy_hash(htb);
+			}
+
 			data->cur_data = NULL;
 		}
 	}
 	else {
 		if (data->cur_data) {
 			htb = (struct rspamd_hash_map_helper *) data->cur_data;
-			msg_info_map("read hash of %d elements from %s", kh_size(htb->htb),
-						 map->name);
+
+			if (htb->gen > 0) {
+				/* Sweep the entries that are missing from the new content */
+				struct rspamd_map_helper_value *val;
+				rspamd_ftok_t tok;
+				khiter_t k;
+				unsigned int swept = 0;
+
+				for (k = kh_begin(htb->htb); k != kh_end(htb->htb); ++k) {
+					if (!kh_exist(htb->htb, k)) {
+						continue;
+					}
+
+					val = kh_value(htb->htb, k);
+
+					if (val->gen != htb->gen) {
+						tok = kh_key(htb->htb, k);
+						htb->digest ^= rspamd_cryptobox_fast_hash(tok.begin,
+																  tok.len, map_hash_seed);
+						kh_del(rspamd_map_hash, htb->htb, k);
+						htb->leaked++;
+						swept++;
+					}
+				}
+
+				msg_info_map("incrementally updated hash of %d elements "
+							 "(%d stale elements swept) from %s",
+							 kh_size(htb->htb), swept, map->name);
+			}
+			else {
+				msg_info_map("read hash of %d elements from %s", kh_size(htb->htb),
+							 map->name);
+			}
+
+			/* Resize for the final key set and drop the swept entries */
+			rspamd_map_helper_rebuild_bloom(htb);
+
 			data->map->traverse_function = rspamd_map_helper_traverse_hash;
 			data->map->nelts = kh_size(htb->htb);
-			data->map->digest = rspamd_cryptobox_fast_hash_final(&htb->hst);
+			data->map->digest = htb->digest;
 		}
 
 		if (target) {
@@ -1032,6 +1232,8 @@ void rspamd_radix_fin(struct map_cb_data *data, void **target)
 	else {
 		if (data->cur_data) {
 			r = (struct rspamd_radix_map_helper *) data->cur_data;
+			/* The map is complete, so compile it for faster lookups */
+			radix_compile_compressed(r->trie);
 			msg_info_map("read radix trie of %z elements: %s",
 						 radix_get_size(r->trie), radix_get_info(r->trie));
 			data->map->traverse_function = rspamd_map_helper_traverse_radix;
@@ -1608,11 +1810,18 @@ rspamd_match_hash_map(struct rspamd_hash_map_helper *map, const char *in,
 	tok.begin = in;
 	tok.len = len;
 
+	if (map->bloom &&
+		!rspamd_map_bloom_check(map->bloom, map->bloom_nblocks,
+								rspamd_map_ftok_hash(tok))) {
+		return NULL;
+	}
+
 	k = kh_get(rspamd_map_hash, map->htb, tok);
 
 	if (k != kh_end(map->htb)) {
 		val = kh_value(map->htb, k);
-		val->hits++;
+		/* Do not write to the entry itself to keep its page shared */
+		map->hits[val->idx]++;
 
 		return val->value;
 	}
@@ -27,6 +27,8 @@
 #define RSPAMD_MEMPOOL_SPF_RECORD "spf_record"
 #define RSPAMD_MEMPOOL_PRINCIPAL_RECIPIENT "principal_recipient"
 #define RSPAMD_MEMPOOL_PROFILE "profile"
+#define RSPAMD_MEMPOOL_STAGES_PROFILE "stages_profile"
+#define RSPAMD_MEMPOOL_VERDICT_CACHE "verdict_cache"
 #define RSPAMD_MEMPOOL_MILTER_REPLY "milter_reply"
 #define RSPAMD_MEMPOOL_DKIM_SIGNATURE "dkim-signature"
 #define RSPAMD_MEMPOOL_DMARC_CHECKS "dmarc_checks"
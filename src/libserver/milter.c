@@ -26,6 +26,9 @@
 #include "libserver/http/http_private.h"
 #include "libserver/protocol_internal.h"
 #include "libserver/cfg_file_private.h"
+#include "libserver/mempool_vars_internal.h"
+#include "libserver/task.h"
+#include "libutil/rspamd_simdutf.h"
 #include "libmime/scan_result.h"
 #include "libserver/worker_util.h"
 #include "utlist.h"
@@ -120,6 +123,12 @@ rspamd_milter_session_reset(struct rspamd_milter_session *session,
 			msg_debug_milter("cleanup message on abort");
 		}
 
+		if (priv->spool_msg) {
+			msg_debug_milter("cleanup spooled message on abort");
+			rspamd_http_message_unref(priv->spool_msg);
+			priv->spool_msg = NULL;
+		}
+
 		if (session->rcpts) {
 			PTR_ARRAY_FOREACH(session->rcpts, i, cur)
 			{
@@ -153,6 +162,7 @@ rspamd_milter_session_reset(struct rspamd_milter_session *session,
 		}
 
 		priv->cur_hdr = 0;
+		session->early_scan_phase = FALSE;
 	}
 
 	if (how & RSPAMD_MILTER_RESET_ADDR) {
@@ -350,8 +360,46 @@ rspamd_milter_process_command(struct rspamd_milter_session *session,
 		}
 
 		msg_debug_milter("got body chunk: %d bytes", (int) cmdlen);
-		session->message = rspamd_fstring_append(session->message,
-												 pos, cmdlen);
+
+		if (priv->spool_msg == NULL &&
+			session->message->len + cmdlen > RSPAMD_MILTER_SPOOL_THRESHOLD) {
+			/*
+			 * Large message: spool the accumulated data into a shmem segment
+			 * to avoid reallocation churn and to allow zero-copy handover;
+			 * on failure merely keep the in-memory accumulation
+			 */
+			priv->spool_msg = rspamd_http_new_message(HTTP_REQUEST);
+			priv->spool_msg->flags |= RSPAMD_HTTP_FLAG_SHMEM;
+
+			if (rspamd_http_message_set_body(priv->spool_msg,
+											 session->message->str,
+											 session->message->len)) {
+				msg_debug_milter("spooled %z bytes of a large message "
+								 "into a shmem segment",
+								 session->message->len);
+				session->message->len = 0;
+			}
+			else {
+				msg_warn_milter("cannot spool message into a shmem segment");
+				rspamd_http_message_unref(priv->spool_msg);
+				priv->spool_msg = NULL;
+			}
+		}
+
+		if (priv->spool_msg != NULL) {
+			if (!rspamd_http_message_append_body(priv->spool_msg,
+												 pos, cmdlen)) {
+				err = g_error_new(rspamd_milter_quark(), ENOMEM,
+								  "cannot append body chunk to a shmem segment");
+				rspamd_milter_on_protocol_error(session, priv, err);
+
+				return FALSE;
+			}
+		}
+		else {
+			session->message = rspamd_fstring_append(session->message,
+													 pos, cmdlen);
+		}
 		break;
 	case RSPAMD_MILTER_CMD_CONNECT:
 		msg_debug_milter("got connect command");
@@ -554,6 +602,7 @@ rspamd_milter_process_command(struct rspamd_milter_session *session,
 		break;
 	case RSPAMD_MILTER_CMD_BODYEOB:
 		msg_debug_milter("got eob command");
+		session->early_scan_phase = FALSE;
 		REF_RETAIN(session);
 		priv->fin_cb(priv->fd, session, priv->ud);
 		REF_RELEASE(session);
@@ -687,6 +736,20 @@ rspamd_milter_process_command(struct rspamd_milter_session *session,
 
 		session->message = rspamd_fstring_append(session->message,
 												 "\r\n", 2);
+
+		if (priv->early_scan && !session->early_scan_phase) {
+			/*
+			 * Ask for a verdict on envelope + headers before the body is
+			 * transferred; a conclusive verdict rejects the message here,
+			 * otherwise the MTA is told to continue and the full scan
+			 * happens at the end of the message as usual
+			 */
+			msg_debug_milter("schedule early scan on eoh");
+			session->early_scan_phase = TRUE;
+			REF_RETAIN(session);
+			priv->fin_cb(priv->fd, session, priv->ud);
+			REF_RELEASE(session);
+		}
 		break;
 	case RSPAMD_MILTER_CMD_OPTNEG:
 		if (cmdlen != sizeof(uint32_t) * 3) {
@@ -721,6 +784,11 @@ rspamd_milter_process_command(struct rspamd_milter_session *session,
 		actions |= RSPAMD_MILTER_ACTIONS_MASK;
 		protocol = RSPAMD_MILTER_FLAG_NOREPLY_MASK;
 
+		if (priv->early_scan) {
+			/* The MTA must wait for our reply to EOH in this mode */
+			protocol &= ~RSPAMD_MILTER_FLAG_NR_EOH;
+		}
+
 		return rspamd_milter_send_action(session, RSPAMD_MILTER_OPTNEG,
 										 version, actions, protocol);
 		break;
@@ -1224,6 +1292,7 @@ rspamd_milter_handle_socket(int fd, ev_tstamp timeout,
 	priv->pool = rspamd_mempool_new(rspamd_mempool_suggest_size(), "milter", 0);
 	priv->discard_on_reject = milter_ctx->discard_on_reject;
 	priv->quarantine_on_reject = milter_ctx->quarantine_on_reject;
+	priv->early_scan = milter_ctx->early_scan;
 	priv->ev.timeout = timeout;
 
 	rspamd_ev_watcher_init(&priv->ev, priv->fd, EV_READ | EV_WRITE,
@@ -1594,6 +1663,204 @@ rspamd_milter_macro_http(struct rspamd_milter_session *session,
 	}
 }
 
+/*
+ * Copies a header into the task pool and registers it as a request header,
+ * as rspamd_protocol_handle_headers would have done; returns the value token
+ */
+static rspamd_ftok_t *
+rspamd_milter_task_hdr(struct rspamd_task *task, const char *name,
+					   const char *value, gsize vlen)
+{
+	rspamd_ftok_t *hn_tok, *hv_tok, srch;
+
+	hn_tok = rspamd_mempool_alloc(task->task_pool, sizeof(*hn_tok));
+	hn_tok->begin = rspamd_mempool_strdup(task->task_pool, name);
+	hn_tok->len = strlen(name);
+
+	srch.begin = value;
+	srch.len = vlen;
+	hv_tok = rspamd_mempool_alloc(task->task_pool, sizeof(*hv_tok));
+	hv_tok->begin = rspamd_mempool_ftokdup(task->task_pool, &srch);
+	hv_tok->len = vlen;
+
+	rspamd_task_add_request_header(task, hn_tok, hv_tok);
+
+	return hv_tok;
+}
+
+/*
+ * Direct counterpart of rspamd_milter_macro_http: applies macros straight
+ * onto a task, keeping the protocol semantics of the headers that the HTTP
+ * path would have produced. Keep the macro mapping in sync with
+ * rspamd_milter_macro_http.
+ */
+static void
+rspamd_milter_macro_task(struct rspamd_milter_session *session,
+						 struct rspamd_task *task)
+{
+	rspamd_ftok_t *found, *hv, srch;
+	struct rspamd_milter_private *priv = session->priv;
+
+	if (!session->macros) {
+		return;
+	}
+
+	IF_MACRO("{i}")
+	{
+		hv = rspamd_milter_task_hdr(task, QUEUE_ID_HEADER,
+									found->begin, found->len);
+		task->queue_id = (char *) hv->begin;
+		rspamd_milter_task_hdr(task, LOG_TAG_HEADER,
+							   found->begin, found->len);
+
+		if (rspamd_fast_utf8_validate(found->begin, found->len) == 0) {
+			memcpy(task->task_pool->tag.uid, found->begin,
+				   MIN(found->len, sizeof(task->task_pool->tag.uid)));
+		}
+	}
+	else
+	{
+		IF_MACRO("i")
+		{
+			hv = rspamd_milter_task_hdr(task, QUEUE_ID_HEADER,
+										found->begin, found->len);
+			task->queue_id = (char *) hv->begin;
+			rspamd_milter_task_hdr(task, LOG_TAG_HEADER,
+								   found->begin, found->len);
+
+			if (rspamd_fast_utf8_validate(found->begin, found->len) == 0) {
+				memcpy(task->task_pool->tag.uid, found->begin,
+					   MIN(found->len, sizeof(task->task_pool->tag.uid)));
+			}
+		}
+	}
+
+	IF_MACRO("{v}")
+	{
+		rspamd_milter_task_hdr(task, USER_AGENT_HEADER,
+							   found->begin, found->len);
+	}
+	else
+	{
+		IF_MACRO("v")
+		{
+			rspamd_milter_task_hdr(task, USER_AGENT_HEADER,
+								   found->begin, found->len);
+		}
+	}
+
+	IF_MACRO("{cipher}")
+	{
+		rspamd_milter_task_hdr(task, TLS_CIPHER_HEADER,
+							   found->begin, found->len);
+		task->flags |= RSPAMD_TASK_FLAG_SSL;
+	}
+
+	IF_MACRO("{tls_version}")
+	{
+		rspamd_milter_task_hdr(task, TLS_VERSION_HEADER,
+							   found->begin, found->len);
+	}
+
+	IF_MACRO("{auth_authen}")
+	{
+		hv = rspamd_milter_task_hdr(task, USER_HEADER,
+									found->begin, found->len);
+		task->auth_user = (char *) hv->begin;
+	}
+
+	IF_MACRO("{rcpt_mailer}")
+	{
+		rspamd_milter_task_hdr(task, MAILER_HEADER,
+							   found->begin, found->len);
+	}
+
+	if (milter_ctx->client_ca_name) {
+		IF_MACRO("{cert_issuer}")
+		{
+			rspamd_milter_task_hdr(task, CERT_ISSUER_HEADER,
+								   found->begin, found->len);
+
+			if (found->len == strlen(milter_ctx->client_ca_name) &&
+				rspamd_cryptobox_memcmp(found->begin,
+										milter_ctx->client_ca_name, found->len) == 0) {
+				msg_debug_milter("process certificate issued by %T", found);
+				IF_MACRO("{cert_subject}")
+				{
+					hv = rspamd_milter_task_hdr(task, USER_HEADER,
+												found->begin, found->len);
+					task->auth_user = (char *) hv->begin;
+				}
+			}
+			else {
+				msg_debug_milter("skip certificate issued by %T", found);
+			}
+		}
+	}
+	else {
+		IF_MACRO("{cert_issuer}")
+		{
+			rspamd_milter_task_hdr(task, CERT_ISSUER_HEADER,
+								   found->begin, found->len);
+		}
+	}
+
+	if (!session->hostname || session->hostname->len == 0) {
+		IF_MACRO("{client_name}")
+		{
+			if (!(found->len == sizeof("unknown") - 1 &&
+				  memcmp(found->begin, "unknown",
+						 sizeof("unknown") - 1) == 0)) {
+				hv = rspamd_milter_task_hdr(task, HOSTNAME_HEADER,
+											found->begin, found->len);
+				task->hostname = hv->begin;
+			}
+			else {
+				msg_debug_milter("skip unknown hostname from being added");
+			}
+		}
+	}
+
+	IF_MACRO("{daemon_name}")
+	{
+		/* Postfix style */
+		hv = rspamd_milter_task_hdr(task, MTA_NAME_HEADER,
+									found->begin, found->len);
+		rspamd_mempool_set_variable(task->task_pool, RSPAMD_MEMPOOL_MTA_NAME,
+									(gpointer) hv->begin, NULL);
+	}
+	else
+	{
+		/* Sendmail style */
+		IF_MACRO("{j}")
+		{
+			hv = rspamd_milter_task_hdr(task, MTA_NAME_HEADER,
+										found->begin, found->len);
+			rspamd_mempool_set_variable(task->task_pool, RSPAMD_MEMPOOL_MTA_NAME,
+										(gpointer) hv->begin, NULL);
+		}
+		else
+		{
+			IF_MACRO("j")
+			{
+				hv = rspamd_milter_task_hdr(task, MTA_NAME_HEADER,
+											found->begin, found->len);
+				rspamd_mempool_set_variable(task->task_pool, RSPAMD_MEMPOOL_MTA_NAME,
+											(gpointer) hv->begin, NULL);
+			}
+		}
+	}
+}
+
+gboolean
+rspamd_milter_has_message(struct rspamd_milter_session *session)
+{
+	struct rspamd_milter_private *priv = session->priv;
+
+	return (session->message != NULL && session->message->len > 0) ||
+		   priv->spool_msg != NULL;
+}
+
 struct rspamd_http_message *
 rspamd_milter_to_http(struct rspamd_milter_session *session)
 {
@@ -1604,16 +1871,35 @@ rspamd_milter_to_http(struct rspamd_milter_session *session)
 
 	g_assert(session != NULL);
 
-	msg = rspamd_http_new_message(HTTP_REQUEST);
+	if (priv->spool_msg != NULL) {
+		/* Large message spooled into a shmem segment: take the message over */
+		msg = priv->spool_msg;
+		priv->spool_msg = NULL;
 
-	msg->url = rspamd_fstring_assign(msg->url, "/" MSG_CMD_CHECK_V2,
-									 sizeof("/" MSG_CMD_CHECK_V2) - 1);
+		if (session->message) {
+			rspamd_fstring_free(session->message);
+			session->message = NULL;
+		}
+	}
+	else {
+		msg = rspamd_http_new_message(HTTP_REQUEST);
 
-	if (session->message) {
-		rspamd_http_message_set_body_from_fstring_steal(msg, session->message);
-		session->message = NULL;
+		if (session->message) {
+			if (session->early_scan_phase) {
+				/* Body chunks will be appended to the buffer afterwards */
+				rspamd_http_message_set_body(msg, session->message->str,
+											 session->message->len);
+			}
+			else {
+				rspamd_http_message_set_body_from_fstring_steal(msg, session->message);
+				session->message = NULL;
+			}
+		}
 	}
 
+	msg->url = rspamd_fstring_assign(msg->url, "/" MSG_CMD_CHECK_V2,
+									 sizeof("/" MSG_CMD_CHECK_V2) - 1);
+
 	if (session->hostname && RSPAMD_FSTRING_LEN(session->hostname) > 0) {
 		if (!(session->hostname->len == sizeof("unknown") - 1 &&
 			  memcmp(RSPAMD_FSTRING_DATA(session->hostname), "unknown",
@@ -1661,6 +1947,142 @@ rspamd_milter_to_http(struct rspamd_milter_session *session)
 	return msg;
 }
 
+gboolean
+rspamd_milter_to_task(struct rspamd_milter_session *session,
+					  struct rspamd_task *task)
+{
+	struct rspamd_milter_private *priv = session->priv;
+	struct rspamd_email_address *rcpt, *addr;
+	rspamd_ftok_t *hv;
+	unsigned int i;
+
+	g_assert(session != NULL);
+
+	task->cmd = CMD_CHECK_V2;
+
+	if (priv->spool_msg != NULL) {
+		/* Large message spooled into a shmem segment: map it for the task */
+		struct rspamd_http_message *msg = priv->spool_msg;
+		const char *data;
+		gsize len;
+
+		priv->spool_msg = NULL;
+		data = rspamd_http_message_get_body(msg, &len);
+
+		if (data == NULL) {
+			msg_err_milter("cannot map spooled message body");
+			rspamd_http_message_unref(msg);
+
+			return FALSE;
+		}
+
+		task->msg.begin = data;
+		task->msg.len = len;
+		rspamd_mempool_add_destructor(task->task_pool,
+									  (rspamd_mempool_destruct_t) rspamd_http_message_unref,
+									  msg);
+
+		if (session->message) {
+			rspamd_fstring_free(session->message);
+			session->message = NULL;
+		}
+	}
+	else if (session->message != NULL && session->message->len > 0) {
+		if (session->early_scan_phase) {
+			/* Body chunks will be appended to the buffer afterwards */
+			char *cpy;
+
+			cpy = rspamd_mempool_alloc(task->task_pool, session->message->len);
+			memcpy(cpy, session->message->str, session->message->len);
+			task->msg.begin = cpy;
+			task->msg.len = session->message->len;
+		}
+		else {
+			/* The task borrows the accumulated buffer, so steal it from session */
+			task->msg.begin = session->message->str;
+			task->msg.len = session->message->len;
+			rspamd_mempool_add_destructor(task->task_pool,
+										  (rspamd_mempool_destruct_t) rspamd_fstring_free,
+										  session->message);
+			session->message = NULL;
+		}
+	}
+	else {
+		return FALSE;
+	}
+
+	if (session->hostname && RSPAMD_FSTRING_LEN(session->hostname) > 0) {
+		if (!(session->hostname->len == sizeof("unknown") - 1 &&
+			  memcmp(RSPAMD_FSTRING_DATA(session->hostname), "unknown",
+					 sizeof("unknown") - 1) == 0)) {
+			hv = rspamd_milter_task_hdr(task, HOSTNAME_HEADER,
+										RSPAMD_FSTRING_DATA(session->hostname),
+										RSPAMD_FSTRING_LEN(session->hostname));
+			task->hostname = hv->begin;
+		}
+		else {
+			msg_debug_milter("skip unknown hostname from being added");
+		}
+	}
+
+	if (session->helo && session->helo->len > 0) {
+		hv = rspamd_milter_task_hdr(task, HELO_HEADER,
+									RSPAMD_FSTRING_DATA(session->helo),
+									RSPAMD_FSTRING_LEN(session->helo));
+		task->helo = (char *) hv->begin;
+	}
+
+	if (session->from) {
+		rspamd_milter_task_hdr(task, FROM_HEADER, session->from->raw,
+							   session->from->raw_len);
+		/* Parse anew instead of borrowing, as the session may die earlier */
+		task->from_envelope = rspamd_email_address_from_smtp(session->from->raw,
+															 session->from->raw_len);
+
+		if (!task->from_envelope) {
+			msg_err_milter("bad from address: '%*s'",
+						   (int) session->from->raw_len, session->from->raw);
+			task->flags |= RSPAMD_TASK_FLAG_BROKEN_HEADERS;
+		}
+	}
+
+	if (session->rcpts) {
+		PTR_ARRAY_FOREACH(session->rcpts, i, rcpt)
+		{
+			rspamd_milter_task_hdr(task, RCPT_HEADER, rcpt->raw, rcpt->raw_len);
+			addr = rspamd_email_address_from_smtp(rcpt->raw, rcpt->raw_len);
+
+			if (addr) {
+				if (task->rcpt_envelope == NULL) {
+					task->rcpt_envelope = g_ptr_array_sized_new(
+						session->rcpts->len);
+				}
+
+				g_ptr_array_add(task->rcpt_envelope, addr);
+			}
+			else {
+				msg_err_milter("bad rcpt address: '%*s'",
+							   (int) rcpt->raw_len, rcpt->raw);
+				task->flags |= RSPAMD_TASK_FLAG_BROKEN_HEADERS;
+			}
+		}
+	}
+
+	if (session->addr && rspamd_inet_address_get_af(session->addr) != AF_UNIX) {
+		const char *ip_str = rspamd_inet_address_to_string_pretty(session->addr);
+
+		rspamd_milter_task_hdr(task, IP_ADDR_HEADER, ip_str, strlen(ip_str));
+		task->from_addr = rspamd_inet_address_copy(session->addr, NULL);
+	}
+	else {
+		task->flags |= RSPAMD_TASK_FLAG_NO_IP;
+	}
+
+	rspamd_milter_macro_task(session, task);
+
+	return TRUE;
+}
+
 void *
 rspamd_milter_update_userdata(struct rspamd_milter_session *session,
 							  void *ud)
@@ -50,6 +50,7 @@ struct rspamd_email_address;
 struct ev_loop;
 struct rspamd_http_message;
 struct rspamd_config;
+struct rspamd_task;
 
 struct rspamd_milter_context {
 	const char *spam_header;
@@ -61,6 +62,7 @@ struct rspamd_milter_context {
 	struct rspamd_config *cfg;
 	gboolean discard_on_reject;
 	gboolean quarantine_on_reject;
+	gboolean early_scan;
 };
 
 struct rspamd_milter_session {
@@ -72,6 +74,8 @@ struct rspamd_milter_session {
 	rspamd_fstring_t *hostname;
 	rspamd_fstring_t *message;
 	void *priv;
+	/* Early scan on EOH is in progress, the body has not been received yet */
+	gboolean early_scan_phase;
 	ref_entry_t ref;
 };
 
@@ -151,6 +155,14 @@ void rspamd_milter_session_unref(struct rspamd_milter_session *session);
 struct rspamd_milter_session *rspamd_milter_session_ref(
 	struct rspamd_milter_session *session);
 
+/**
+ * Checks if a session has some message data accumulated, either in memory
+ * or spooled into a shmem segment
+ * @param session
+ * @return
+ */
+gboolean rspamd_milter_has_message(struct rspamd_milter_session *session);
+
 /**
  * Converts milter session to HTTP session that is suitable for Rspamd
  * @param session
@@ -159,6 +171,17 @@ struct rspamd_milter_session *rspamd_milter_session_ref(
 struct rspamd_http_message *rspamd_milter_to_http(
 	struct rspamd_milter_session *session);
 
+/**
+ * Applies milter session directly to a task, bypassing the intermediate
+ * HTTP message representation; the message body is taken over from the
+ * session. Used when the message is scanned within the same process.
+ * @param session
+ * @param task
+ * @return
+ */
+gboolean rspamd_milter_to_task(struct rspamd_milter_session *session,
+							   struct rspamd_task *task);
+
 /**
  * Sends task results to the
  * @param session
@@ -69,6 +69,8 @@ struct rspamd_milter_private {
 	struct rspamd_milter_outbuf *out_chain;
 	struct ev_loop *event_loop;
 	rspamd_mempool_t *pool;
+	/* Shmem backed message body for large messages */
+	struct rspamd_http_message *spool_msg;
 	khash_t(milter_headers_hash_t) * headers;
 	int cur_hdr;
 	rspamd_milter_finish fin_cb;
@@ -79,6 +81,7 @@ struct rspamd_milter_private {
 	gboolean discard_on_reject;
 	gboolean quarantine_on_reject;
 	gboolean no_action;
+	gboolean early_scan;
 };
 
 enum rspamd_milter_io_cmd {
@@ -156,6 +159,8 @@ enum rspamd_milter_connect_proto {
 #define RSPAMD_MILTER_PROTO_VER 6
 
 #define RSPAMD_MILTER_MESSAGE_CHUNK 65536
+/* Messages above this size are spooled into a shmem segment */
+#define RSPAMD_MILTER_SPOOL_THRESHOLD (1024 * 1024)
 
 #define RSPAMD_MILTER_RCODE_REJECT "554"
 #define RSPAMD_MILTER_RCODE_TEMPFAIL "451"
@@ -63,6 +63,8 @@ struct rspamd_monitored {
 	double offline_time;
 	double total_offline_time;
 	double latency;
+	double lat_history[RSPAMD_MONITORED_LATENCY_SLOTS];
+	unsigned int lat_pos;
 	unsigned int nchecks;
 	unsigned int max_errors;
 	unsigned int cur_errors;
@@ -159,6 +161,8 @@ rspamd_monitored_propagate_success(struct rspamd_monitored *m, double lat)
 	double t;
 
 	m->cur_errors = 0;
+	m->lat_history[m->lat_pos % RSPAMD_MONITORED_LATENCY_SLOTS] = lat;
+	m->lat_pos++;
 
 	if (!m->alive) {
 		m->monitoring_mult = 1.0;
@@ -666,6 +670,23 @@ rspamd_monitored_latency(struct rspamd_monitored *m)
 	return m->latency;
 }
 
+unsigned int
+rspamd_monitored_latency_history(struct rspamd_monitored *m, double *out)
+{
+	unsigned int i, n;
+
+	g_assert(m != NULL);
+
+	n = MIN(m->lat_pos, RSPAMD_MONITORED_LATENCY_SLOTS);
+
+	for (i = 0; i < n; i++) {
+		out[i] = m->lat_history[(m->lat_pos - 1 - i) %
+								RSPAMD_MONITORED_LATENCY_SLOTS];
+	}
+
+	return n;
+}
+
 void rspamd_monitored_stop(struct rspamd_monitored *m)
 {
 	g_assert(m != NULL);
@@ -136,6 +136,18 @@ double rspamd_monitored_total_offline_time(struct rspamd_monitored *m);
  */
 double rspamd_monitored_latency(struct rspamd_monitored *m);
 
+#define RSPAMD_MONITORED_LATENCY_SLOTS 16
+/**
+ * Fills `out` with the latencies of the recent successful checks (in seconds),
+ * the newest first; `out` must have at least RSPAMD_MONITORED_LATENCY_SLOTS
+ * elements
+ * @param m
+ * @param out
+ * @return number of elements filled
+ */
+unsigned int rspamd_monitored_latency_history(struct rspamd_monitored *m,
+											  double *out);
+
 /**
  * Explicitly disable monitored object
  * @param m
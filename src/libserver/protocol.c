@@ -26,6 +26,7 @@
 #include "protocol_internal.h"
 #include "libserver/mempool_vars_internal.h"
 #include "libserver/worker_util.h"
+#include "libserver/re_cache.h"
 #include "rspamd_simdutf.h"
 #include "task.h"
 #include "lua/lua_classnames.h"
@@ -56,6 +57,9 @@ INIT_LOG_MODULE(protocol)
 															  G_STRFUNC,                                                    \
 															  __VA_ARGS__)
 
+/* Moving average of the emitted reply sizes to preallocate the emit buffer */
+static struct rspamd_counter_data reply_size_ema;
+
 static GQuark
 rspamd_protocol_quark(void)
 {
@@ -752,6 +756,20 @@ rspamd_protocol_handle_headers(struct rspamd_task *task,
 				msg_debug_protocol("read TLS cipher header, value: %T", hv_tok);
 			}
 			break;
+		case 'c':
+		case 'C':
+			IF_HEADER(CONNECTION_HEADER)
+			{
+				srch.begin = "keep-alive";
+				srch.len = 10;
+
+				msg_debug_protocol("read connection header, value: %T", hv_tok);
+
+				if (rspamd_ftok_casecmp(hv_tok, &srch) == 0) {
+					task->protocol_flags |= RSPAMD_TASK_PROTOCOL_FLAG_KEEP_ALIVE;
+				}
+			}
+			break;
 		default:
 			msg_debug_protocol("generic header: %T", hn_tok);
 			break;
@@ -1086,7 +1104,7 @@ rspamd_metric_symbol_ucl(struct rspamd_task *task, struct rspamd_symbol_result *
 							  "description", 0, false);
 	}
 
-	if (sym->options != NULL) {
+	if (sym->opts_head != NULL) {
 		ar = ucl_object_typed_new(UCL_ARRAY);
 
 		DL_FOREACH(sym->opts_head, opt)
@@ -1379,6 +1397,49 @@ rspamd_protocol_output_profiling(struct rspamd_task *task,
 	}
 
 	ucl_object_insert_key(top, prof, "profile", 0, false);
+
+	/* Wall clock time per processing stage, including async waits */
+	prof = ucl_object_typed_new(UCL_OBJECT);
+	tbl = rspamd_mempool_get_variable(task->task_pool,
+									  RSPAMD_MEMPOOL_STAGES_PROFILE);
+
+	if (tbl) {
+		g_hash_table_iter_init(&it, tbl);
+
+		while (g_hash_table_iter_next(&it, &k, &v)) {
+			val = *(double *) v;
+			ucl_object_insert_key(prof, ucl_object_fromdouble(val),
+								  (const char *) k, 0, false);
+		}
+	}
+
+	ucl_object_insert_key(top, prof, "stages", 0, false);
+
+	/* Cheap native counters; redis round trips are accounted in lua merely */
+	prof = ucl_object_typed_new(UCL_OBJECT);
+	ucl_object_insert_key(prof, ucl_object_fromint(task->dns_requests),
+						  "dns_requests", 0, false);
+
+	if (task->re_rt) {
+		const struct rspamd_re_cache_stat *re_stat =
+			rspamd_re_cache_get_stat(task->re_rt);
+
+		ucl_object_insert_key(prof, ucl_object_fromint(re_stat->regexp_checked),
+							  "regexp_checked", 0, false);
+		ucl_object_insert_key(prof, ucl_object_fromint(re_stat->regexp_matched),
+							  "regexp_matched", 0, false);
+		ucl_object_insert_key(prof, ucl_object_fromint(re_stat->bytes_scanned),
+							  "bytes_scanned", 0, false);
+	}
+
+	ucl_object_insert_key(top, prof, "counters", 0, false);
+
+	/* Scan trace ring is collected merely for profiled tasks */
+	prof = rspamd_symcache_runtime_export_trace(task);
+
+	if (prof) {
+		ucl_object_insert_key(top, prof, "symcache_trace", 0, false);
+	}
 }
 
 ucl_object_t *
@@ -1594,7 +1655,8 @@ void rspamd_protocol_http_reply(struct rspamd_http_message *msg,
 			restat->bytes_scanned);
 	}
 
-	reply = rspamd_fstring_sized_new(1000);
+	/* Preallocate from the recent average to avoid realloc driven copies */
+	reply = rspamd_fstring_sized_new(reply_size_ema.mean > 1000 ? (gsize) reply_size_ema.mean : 1000);
 
 	if (msg->method < HTTP_SYMBOLS && !RSPAMD_TASK_IS_SPAMC(task)) {
 		msg_debug_protocol("writing json reply");
@@ -1611,6 +1673,8 @@ void rspamd_protocol_http_reply(struct rspamd_http_message *msg,
 		}
 	}
 
+	rspamd_set_counter_ema(&reply_size_ema, RSPAMD_FSTRING_LEN(reply), 0.5f);
+
 	if (task->protocol_flags & RSPAMD_TASK_PROTOCOL_FLAG_BODY_BLOCK) {
 		/* Check if we need to insert a body block */
 		if (task->flags & RSPAMD_TASK_FLAG_MESSAGE_REWRITE) {
@@ -2011,6 +2075,10 @@ void rspamd_protocol_write_reply(struct rspamd_task *task, ev_tstamp timeout, st
 
 	msg = rspamd_http_new_message(HTTP_RESPONSE);
 
+	if (task->protocol_flags & RSPAMD_TASK_PROTOCOL_FLAG_KEEP_ALIVE) {
+		msg->flags |= RSPAMD_HTTP_FLAG_KEEP_ALIVE;
+	}
+
 	if (rspamd_http_connection_is_encrypted(task->http_conn)) {
 		msg_info_protocol("<%s> writing encrypted reply",
 						  MESSAGE_FIELD_CHECK(task, message_id));
@@ -2041,8 +2109,10 @@ void rspamd_protocol_write_reply(struct rspamd_task *task, ev_tstamp timeout, st
 
 		top = ucl_object_typed_new(UCL_OBJECT);
 		msg->code = 500 + task->err->code % 100;
-		msg->status = rspamd_fstring_new_init(task->err->message,
-											  strlen(task->err->message));
+		gsize err_len = strlen(task->err->message);
+		msg->status = rspamd_fstring_append(
+			rspamd_fstring_pool_new(task->task_pool, err_len),
+			task->err->message, err_len);
 		ucl_object_insert_key(top, ucl_object_fromstring(task->err->message),
 							  "error", 0, false);
 		ucl_object_insert_key(top,
@@ -2070,7 +2140,8 @@ void rspamd_protocol_write_reply(struct rspamd_task *task, ev_tstamp timeout, st
 	else {
 		rspamd_fstring_t *output;
 		struct rspamd_stat stat_copy;
-		msg->status = rspamd_fstring_new_init("OK", 2);
+		msg->status = rspamd_fstring_append(
+			rspamd_fstring_pool_new(task->task_pool, 2), "OK", 2);
 
 		switch (task->cmd) {
 		case CMD_CHECK:
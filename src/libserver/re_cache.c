@@ -121,6 +121,8 @@ struct rspamd_re_cache {
 
 	GPtrArray *re;
 	khash_t(lua_selectors_hash) * selectors;
+	/* Optional counters in a shared memory segment, indexed by cache id */
+	struct rspamd_re_cache_hit_stat *hit_stats;
 	ref_entry_t ref;
 	unsigned int nre;
 	unsigned int max_re_data;
@@ -476,6 +478,18 @@ void rspamd_re_cache_init(struct rspamd_re_cache *cache, struct rspamd_config *c
 
 	cache->L = cfg->lua_state;
 
+	if (cfg->enable_re_hit_stats && cache->re->len > 0) {
+		/*
+		 * Allocated in the shared part of the config pool before workers are
+		 * forked, so the counters aggregate hits from the whole fleet
+		 */
+		cache->hit_stats = rspamd_mempool_alloc0_shared(cfg->cfg_pool,
+														cache->re->len *
+															sizeof(*cache->hit_stats));
+		msg_info_re_cache("enabled shared hit counters for %d regexps",
+						  (int) cache->re->len);
+	}
+
 #ifdef WITH_HYPERSCAN
 	const char *platform = "generic";
 	rspamd_fstring_t *features = rspamd_fstring_new();
@@ -515,12 +529,42 @@ void rspamd_re_cache_init(struct rspamd_re_cache *cache, struct rspamd_config *c
 #endif
 }
 
+/*
+ * A single spare runtime per worker process: scanners allocate and free one
+ * runtime per task and the allocation is sized by the total number of
+ * regexps, so recycling it avoids a multi-kilobyte calloc on every message.
+ * The spare keeps a reference to its cache, hence a reconfiguration merely
+ * makes the cached pointer mismatch and the spare is dropped
+ */
+static struct rspamd_re_runtime *re_rt_spare = NULL;
+
 struct rspamd_re_runtime *
 rspamd_re_cache_runtime_new(struct rspamd_re_cache *cache)
 {
 	struct rspamd_re_runtime *rt;
 	g_assert(cache != NULL);
 
+	if (re_rt_spare != NULL) {
+		rt = re_rt_spare;
+		re_rt_spare = NULL;
+
+		if (rt->cache == cache) {
+			/* The spare's reference is transferred to the new runtime */
+			memset(rt->checked, 0, NBYTES(cache->nre) + cache->nre);
+			memset(&rt->stat, 0, sizeof(rt->stat));
+			rt->stat.regexp_total = cache->nre;
+#ifdef WITH_HYPERSCAN
+			rt->has_hs = cache->hyperscan_loaded;
+#endif
+
+			return rt;
+		}
+
+		/* Stale spare from a previous configuration */
+		REF_RELEASE(rt->cache);
+		g_free(rt);
+	}
+
 	rt = g_malloc0(sizeof(*rt) + NBYTES(cache->nre) + cache->nre);
 	rt->cache = cache;
 	REF_RETAIN(cache);
@@ -792,7 +836,28 @@ rspamd_re_cache_process_regexp_data(struct rspamd_re_runtime *rt,
 		setbit(rt->checked, re_id);
 	}
 	else {
+		g_assert(re_class->hs_scratch != NULL);
+		g_assert(re_class->hs_db != NULL);
+
+		/*
+		 * A single scan covers all hyperscan expressions of the class, so
+		 * we walk the buffers once sharing the callback data instead of
+		 * rebuilding it per buffer. Empty buffers cannot match in block
+		 * mode and are not worth a call into hyperscan at all: words
+		 * vectors and multipart messages are full of such placeholders.
+		 */
+		hs_database_t *hs_db = rspamd_hyperscan_get_database(re_class->hs_db);
+
+		cbdata.re = re;
+		cbdata.rt = rt;
+		cbdata.task = task;
+		cbdata.count = 1;
+
 		for (i = 0; i < count; i++) {
+			if (lens[i] == 0) {
+				continue;
+			}
+
 			/* For Hyperscan we can probably safely disable all those limits */
 #if 0
 			if (rt->cache->max_re_data > 0 && lens[i] > rt->cache->max_re_data) {
@@ -800,22 +865,10 @@ rspamd_re_cache_process_regexp_data(struct rspamd_re_runtime *rt,
 			}
 #endif
 			rt->stat.bytes_scanned += lens[i];
-		}
-
-		g_assert(re_class->hs_scratch != NULL);
-		g_assert(re_class->hs_db != NULL);
-
-		/* Go through hyperscan API */
-		for (i = 0; i < count; i++) {
 			cbdata.ins = &in[i];
-			cbdata.re = re;
-			cbdata.rt = rt;
 			cbdata.lens = &lens[i];
-			cbdata.count = 1;
-			cbdata.task = task;
 
-			if ((hs_scan(rspamd_hyperscan_get_database(re_class->hs_db),
-						 in[i], lens[i], 0,
+			if ((hs_scan(hs_db, in[i], lens[i], 0,
 						 re_class->hs_scratch,
 						 rspamd_re_cache_hyperscan_cb, &cbdata)) != HS_SUCCESS) {
 				ret = 0;
@@ -1543,13 +1596,53 @@ int rspamd_re_cache_process(struct rspamd_task *task,
 			return 0;
 		}
 
-		return rspamd_re_cache_exec_re(task, rt, re, re_class,
-									   is_strong);
+		int res = rspamd_re_cache_exec_re(task, rt, re, re_class,
+										  is_strong);
+
+		if (G_UNLIKELY(cache->hit_stats != NULL)) {
+			struct rspamd_re_cache_hit_stat *hs = &cache->hit_stats[re_id];
+
+#ifndef HAVE_ATOMIC_BUILTINS
+			hs->checked++;
+
+			if (res > 0) {
+				hs->matched += res;
+			}
+#else
+			__atomic_add_fetch(&hs->checked, 1, __ATOMIC_RELEASE);
+
+			if (res > 0) {
+				__atomic_add_fetch(&hs->matched, res, __ATOMIC_RELEASE);
+			}
+#endif
+		}
+
+		return res;
 	}
 
 	return 0;
 }
 
+void rspamd_re_cache_hit_stats_foreach(struct rspamd_re_cache *cache,
+									   rspamd_re_cache_hit_stats_cb_t cb,
+									   gpointer ud)
+{
+	struct rspamd_re_cache_elt *elt;
+	unsigned int i;
+
+	g_assert(cache != NULL);
+	g_assert(cb != NULL);
+
+	if (cache->hit_stats == NULL) {
+		return;
+	}
+
+	PTR_ARRAY_FOREACH(cache->re, i, elt)
+	{
+		cb(elt->re, &cache->hit_stats[i], ud);
+	}
+}
+
 int rspamd_re_cache_process_ffi(void *ptask,
 								void *pre,
 								int type,
@@ -1584,6 +1677,13 @@ void rspamd_re_cache_runtime_destroy(struct rspamd_re_runtime *rt)
 			g_free(sr.lenvec);
 		});
 		kh_destroy(selectors_results_hash, rt->sel_cache);
+		rt->sel_cache = NULL;
+	}
+
+	if (re_rt_spare == NULL) {
+		/* Park for reuse keeping the cache reference */
+		re_rt_spare = rt;
+		return;
 	}
 
 	REF_RELEASE(rt->cache);
@@ -2196,6 +2296,17 @@ rspamd_re_cache_compile_timer_cb(EV_P_ ev_timer *w, int revents)
 		}
 
 		close(fd);
+
+		/*
+		 * Pre-create the unserialized companion here, in the compiling
+		 * process, so scanning workers merely mmap the shared file and swap
+		 * the database pointers on reload instead of paying for the
+		 * deserialization in their event loops
+		 */
+		rspamd_hyperscan_prepare_unserialized(npath,
+											  RSPAMD_HS_MAGIC_LEN + sizeof(cache->plt) +
+												  sizeof(n) + n * 2 * sizeof(*hs_ids) +
+												  sizeof(crc));
 	}
 	else {
 		err = g_error_new(rspamd_re_cache_quark(),
@@ -118,6 +118,27 @@ struct rspamd_re_runtime *rspamd_re_cache_runtime_new(struct rspamd_re_cache *ca
 const struct rspamd_re_cache_stat *
 rspamd_re_cache_get_stat(struct rspamd_re_runtime *rt);
 
+/**
+ * Per-regexp hit counters shared between all workers over fork
+ * (enabled by the `enable_re_hit_stats` option)
+ */
+struct rspamd_re_cache_hit_stat {
+	uint64_t checked; /* Number of evaluations of the expression */
+	uint64_t matched; /* Total number of hits accumulated */
+};
+
+typedef void (*rspamd_re_cache_hit_stats_cb_t)(rspamd_regexp_t *re,
+											   const struct rspamd_re_cache_hit_stat *st,
+											   gpointer ud);
+
+/**
+ * Iterate over the shared hit counters of all cached regexps; does nothing
+ * when `enable_re_hit_stats` is not set in the configuration
+ */
+void rspamd_re_cache_hit_stats_foreach(struct rspamd_re_cache *cache,
+									   rspamd_re_cache_hit_stats_cb_t cb,
+									   gpointer ud);
+
 /**
  * Process regexp runtime and return the result for a specific regexp
  * @param task task object
@@ -55,6 +55,9 @@ struct redis_pool_connection {
 	ev_timer timeout;
 	char tag[MEMPOOL_UID_LEN];
 	rspamd_redis_pool_connection_state state;
+	/* Borrowers of a multiplexed connection; always 1 for exclusive ones */
+	unsigned borrowers = 1;
+	bool broken = false;
 
 	auto schedule_timeout() -> void;
 	~redis_pool_connection();
@@ -86,6 +89,8 @@ class redis_pool_elt {
 	std::list<redis_pool_connection_ptr> active;
 	std::list<redis_pool_connection_ptr> inactive;
 	std::list<redis_pool_connection_ptr> terminating;
+	/* The connection currently lent out to multiplexed borrowers, if any */
+	redis_pool_connection *shared_conn = nullptr;
 	std::string ip;
 	std::string db;
 	std::string username;
@@ -122,9 +127,19 @@ public:
 	}
 
 	auto new_connection() -> redisAsyncContext *;
+	auto new_shared_connection() -> redisAsyncContext *;
+
+	auto forget_shared(const redis_pool_connection *conn) -> void
+	{
+		if (shared_conn == conn) {
+			shared_conn = nullptr;
+		}
+	}
 
 	auto release_connection(const redis_pool_connection *conn) -> void
 	{
+		forget_shared(conn);
+
 		switch (conn->state) {
 		case rspamd_redis_pool_connection_state::RSPAMD_REDIS_POOL_CONN_ACTIVE:
 			active.erase(conn->elt_pos);
@@ -140,6 +155,7 @@ public:
 
 	auto move_to_inactive(redis_pool_connection *conn) -> void
 	{
+		forget_shared(conn);
 		inactive.splice(std::end(inactive), active, conn->elt_pos);
 		conn->elt_pos = std::prev(std::end(inactive));
 	}
@@ -210,6 +226,9 @@ private:
 class redis_pool final {
 	static constexpr const double default_timeout = 10.0;
 	static constexpr const unsigned default_max_conns = 100;
+	/* Pipelining depth for a multiplexed connection before a new one is opened */
+	static constexpr const unsigned max_shared_uses = 16;
+	friend class redis_pool_elt;
 
 	/* We want to have references integrity */
 	ankerl::unordered_dense::map<redisAsyncContext *,
@@ -244,6 +263,9 @@ public:
 	auto new_connection(const char *db, const char *username,
 						const char *password, const char *ip, int port) -> redisAsyncContext *;
 
+	auto new_shared_connection(const char *db, const char *username,
+							   const char *password, const char *ip, int port) -> redisAsyncContext *;
+
 	auto release_connection(redisAsyncContext *ctx,
 							enum rspamd_redis_pool_release_type how) -> void;
 
@@ -513,6 +535,30 @@ auto redis_pool_elt::new_connection() -> redisAsyncContext *
 	RSPAMD_UNREACHABLE;
 }
 
+auto redis_pool_elt::new_shared_connection() -> redisAsyncContext *
+{
+	if (shared_conn != nullptr && !shared_conn->broken &&
+		shared_conn->ctx != nullptr && shared_conn->ctx->err == REDIS_OK &&
+		shared_conn->borrowers < redis_pool::max_shared_uses) {
+		auto *conn = shared_conn;
+
+		conn->borrowers++;
+		msg_debug_rpool("multiplex connection %p to %s:%d; borrowers: %d",
+						conn->ctx, ip.c_str(), port, conn->borrowers);
+
+		return conn->ctx;
+	}
+
+	auto *nctx = new_connection();
+
+	if (nctx != nullptr) {
+		/* Both reuse and creation leave the connection at the front */
+		shared_conn = active.front().get();
+	}
+
+	return nctx;
+}
+
 auto redis_pool::new_connection(const char *db, const char *username,
 								const char *password, const char *ip, int port) -> redisAsyncContext *
 {
@@ -538,6 +584,30 @@ auto redis_pool::new_connection(const char *db, const char *username,
 	return nullptr;
 }
 
+auto redis_pool::new_shared_connection(const char *db, const char *username,
+									   const char *password, const char *ip, int port) -> redisAsyncContext *
+{
+	if (!wanna_die) {
+		auto key = redis_pool_elt::make_key(db, username, password, ip, port);
+		auto found_elt = elts_by_key.find(key);
+
+		if (found_elt != elts_by_key.end()) {
+			auto &elt = found_elt->second;
+
+			return elt.new_shared_connection();
+		}
+		else {
+			/* Need to create a pool */
+			auto nelt = elts_by_key.try_emplace(key,
+												this, db, username, password, ip, port);
+
+			return nelt.first->second.new_shared_connection();
+		}
+	}
+
+	return nullptr;
+}
+
 auto redis_pool::release_connection(redisAsyncContext *ctx,
 									enum rspamd_redis_pool_release_type how) -> void
 {
@@ -547,12 +617,31 @@ auto redis_pool::release_connection(redisAsyncContext *ctx,
 			auto *conn = conn_it->second;
 			g_assert(conn->state == rspamd_redis_pool_connection_state::RSPAMD_REDIS_POOL_CONN_ACTIVE);
 
+			if (conn->borrowers > 1) {
+				/* Multiplexed connection: the last borrower releases it */
+				conn->borrowers--;
+
+				if (how != RSPAMD_REDIS_RELEASE_DEFAULT || ctx->err != REDIS_OK) {
+					/* A broken connection must not be lent out again */
+					conn->broken = true;
+					conn->elt->forget_shared(conn);
+				}
+
+				msg_debug_rpool("defer release of multiplexed connection %p; "
+								"borrowers: %d",
+								conn->ctx, conn->borrowers);
+
+				return;
+			}
+
+			conn->borrowers = 0;
+
 			if (ctx->err != REDIS_OK) {
 				/* We need to terminate connection forcefully */
 				msg_debug_rpool("closed connection %p due to an error", conn->ctx);
 			}
 			else {
-				if (how == RSPAMD_REDIS_RELEASE_DEFAULT) {
+				if (how == RSPAMD_REDIS_RELEASE_DEFAULT && !conn->broken) {
 					/* Ensure that there are no callbacks attached to this conn */
 					if (ctx->replies.head == nullptr && (ctx->c.flags & REDIS_CONNECTED)) {
 						/* Just move it to the inactive queue */
@@ -621,6 +710,18 @@ rspamd_redis_pool_connect(void *p,
 }
 
 
+struct redisAsyncContext *
+rspamd_redis_pool_connect_shared(void *p,
+								 const char *db, const char *username,
+								 const char *password, const char *ip, int port)
+{
+	g_assert(p != NULL);
+	auto *pool = reinterpret_cast<class rspamd::redis_pool *>(p);
+
+	return pool->new_shared_connection(db, username, password, ip, port);
+}
+
+
 void rspamd_redis_pool_release_connection(void *p,
 										  struct redisAsyncContext *ctx, enum rspamd_redis_pool_release_type how)
 {
@@ -56,6 +56,25 @@ struct redisAsyncContext *rspamd_redis_pool_connect(
 	const char *db, const char *username, const char *password,
 	const char *ip, int port);
 
+/**
+ * Create or join a multiplexed redis connection: compatible read-only
+ * commands from several callers are pipelined over one context, which is
+ * released back to the pool when the last borrower releases it. Callers
+ * that need transactions or blocking commands must use
+ * rspamd_redis_pool_connect to get an exclusive context instead.
+ * @param pool
+ * @param db
+ * @param username
+ * @param password
+ * @param ip
+ * @param port
+ * @return
+ */
+struct redisAsyncContext *rspamd_redis_pool_connect_shared(
+	void *pool,
+	const char *db, const char *username, const char *password,
+	const char *ip, int port);
+
 enum rspamd_redis_pool_release_type {
 	RSPAMD_REDIS_RELEASE_DEFAULT = 0,
 	RSPAMD_REDIS_RELEASE_FATAL = 1,
@@ -70,6 +70,9 @@ rspamd_roll_history_new(rspamd_mempool_t *pool, unsigned int max_rows,
 struct history_metric_callback_data {
 	char *pos;
 	int remain;
+	char *timings_pos;
+	int timings_remain;
+	struct rspamd_task *task;
 };
 
 static void
@@ -88,6 +91,17 @@ roll_history_symbols_callback(gpointer key, gpointer value, void *user_data)
 		cb->pos += wr;
 		cb->remain -= wr;
 	}
+
+	if (cb->timings_remain > 0 && RSPAMD_TASK_IS_PROFILING(cb->task)) {
+		double *tm = rspamd_task_profile_get(cb->task, s->name);
+
+		if (tm != NULL) {
+			wr = rspamd_snprintf(cb->timings_pos, cb->timings_remain,
+								 "%s:%.4f, ", s->name, *tm);
+			cb->timings_pos += wr;
+			cb->timings_remain -= wr;
+		}
+	}
 }
 
 /**
@@ -119,6 +133,8 @@ void rspamd_roll_history_update(struct roll_history *history,
 	if (row_num < history->nrows) {
 		row = &history->rows[row_num];
 		g_atomic_int_set(&row->completed, FALSE);
+		/* Seqlock write begin: the version is odd whilst we fill the row */
+		g_atomic_int_inc(&row->version);
 	}
 	else {
 		/* Race condition */
@@ -155,6 +171,7 @@ void rspamd_roll_history_update(struct roll_history *history,
 
 	if (metric_res == NULL) {
 		row->symbols[0] = '\0';
+		row->timings[0] = '\0';
 		row->action = METRIC_ACTION_NOACTION;
 	}
 	else {
@@ -164,6 +181,10 @@ void rspamd_roll_history_update(struct roll_history *history,
 		row->required_score = rspamd_task_get_required_score(task, metric_res);
 		cbdata.pos = row->symbols;
 		cbdata.remain = sizeof(row->symbols);
+		cbdata.timings_pos = row->timings;
+		cbdata.timings_remain = sizeof(row->timings);
+		cbdata.task = task;
+		row->timings[0] = '\0';
 		rspamd_task_symbol_result_foreach(task, NULL,
 										  roll_history_symbols_callback,
 										  &cbdata);
@@ -173,11 +194,19 @@ void rspamd_roll_history_update(struct roll_history *history,
 			*cbdata.pos-- = '\0';
 			*cbdata.pos = '\0';
 		}
+		if (cbdata.timings_remain > 0 &&
+			cbdata.timings_pos != row->timings) {
+			*cbdata.timings_pos-- = '\0';
+			*cbdata.timings_pos-- = '\0';
+			*cbdata.timings_pos = '\0';
+		}
 	}
 
 	row->scan_time = task->time_real_finish - task->task_timestamp;
 	row->len = task->msg.len;
 	g_atomic_int_set(&row->completed, TRUE);
+	/* Seqlock write end: back to an even version, the row is now stable */
+	g_atomic_int_inc(&row->version);
 }
 
 /**
@@ -303,6 +332,13 @@ rspamd_roll_history_load(struct roll_history *history, const char *filename)
 							   sizeof(row->symbols));
 			}
 
+			elt = ucl_object_lookup(cur, "timings");
+
+			if (elt && ucl_object_type(elt) == UCL_STRING) {
+				rspamd_strlcpy(row->timings, ucl_object_tostring(elt),
+							   sizeof(row->timings));
+			}
+
 			elt = ucl_object_lookup(cur, "user");
 
 			if (elt && ucl_object_type(elt) == UCL_STRING) {
@@ -391,7 +427,7 @@ rspamd_roll_history_save(struct roll_history *history, const char *filename)
 	for (i = 0; i < history->nrows; i++) {
 		row = &history->rows[i];
 
-		if (!row->completed) {
+		if (!row->completed || (row->version & 1)) {
 			continue;
 		}
 
@@ -403,6 +439,11 @@ rspamd_roll_history_save(struct roll_history *history, const char *filename)
 							  "id", 0, false);
 		ucl_object_insert_key(elt, ucl_object_fromstring(row->symbols),
 							  "symbols", 0, false);
+
+		if (row->timings[0] != '\0') {
+			ucl_object_insert_key(elt, ucl_object_fromstring(row->timings),
+								  "timings", 0, false);
+		}
 		ucl_object_insert_key(elt, ucl_object_fromstring(row->user),
 							  "user", 0, false);
 		ucl_object_insert_key(elt, ucl_object_fromstring(row->from_addr),
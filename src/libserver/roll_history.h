@@ -40,6 +40,7 @@ struct roll_history_row {
 	ev_tstamp timestamp;
 	char message_id[HISTORY_MAX_ID];
 	char symbols[HISTORY_MAX_SYMBOLS];
+	char timings[HISTORY_MAX_SYMBOLS]; /* Per symbol timings when profiling is on */
 	char user[HISTORY_MAX_USER];
 	char from_addr[HISTORY_MAX_ADDR];
 	gsize len;
@@ -48,6 +49,7 @@ struct roll_history_row {
 	double required_score;
 	int action;
 	unsigned int completed;
+	unsigned int version; /* Seqlock: odd whilst the row is being written */
 };
 
 struct roll_history {
@@ -27,6 +27,10 @@
 #include <sys/resource.h>
 #endif
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
 #ifdef WITH_HYPERSCAN
 #include "hyperscan_tools.h"
 #endif
@@ -84,6 +88,23 @@ static const struct rspamd_control_cmd_match {
 	{.name = {.begin = "/fuzzysync", .len = sizeof("/fuzzysync") - 1}, .type = RSPAMD_CONTROL_FUZZY_SYNC},
 };
 
+/*
+ * Single-producer (main) single-consumer (worker) ring of control commands
+ * living in a shared anonymous mapping. It carries fire-and-forget broadcast
+ * commands only: no descriptors are attached and no replies are expected, so
+ * the per-command sendmsg/recvmsg round-trip and the serialisation through
+ * `control_events_pending` are not needed. The worker is woken up via an
+ * eventfd doorbell that coalesces kicks, hence a burst of commands costs a
+ * single wakeup.
+ */
+#define RSPAMD_CONTROL_RING_SIZE 64
+
+struct rspamd_control_ring {
+	gint head; /* Written by the main process */
+	gint tail; /* Written by the worker */
+	struct rspamd_control_command cmds[RSPAMD_CONTROL_RING_SIZE];
+};
+
 static void rspamd_control_ignore_io_handler(int fd, short what, void *ud);
 static void rspamd_control_stop_pending(struct rspamd_control_reply_elt *elt);
 
@@ -398,6 +419,88 @@ rspamd_control_fill_msghdr(struct rspamd_control_command *cmd,
 	msg->msg_iovlen = 1;
 }
 
+void rspamd_control_ring_create(struct rspamd_main *rspamd_main,
+								struct rspamd_worker *wrk)
+{
+	wrk->control_ring = NULL;
+	wrk->control_doorbell = -1;
+
+#ifdef __linux__
+	void *map;
+
+	map = mmap(NULL, sizeof(struct rspamd_control_ring),
+			   PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (map == MAP_FAILED) {
+		msg_warn_main("cannot mmap control ring for a worker: %s; "
+					  "will use the socket path",
+					  strerror(errno));
+
+		return;
+	}
+
+	wrk->control_doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (wrk->control_doorbell == -1) {
+		msg_warn_main("cannot create control ring doorbell: %s; "
+					  "will use the socket path",
+					  strerror(errno));
+		munmap(map, sizeof(struct rspamd_control_ring));
+
+		return;
+	}
+
+	memset(map, 0, sizeof(struct rspamd_control_ring));
+	wrk->control_ring = map;
+#endif
+}
+
+void rspamd_control_ring_destroy(struct rspamd_worker *wrk)
+{
+	if (wrk->control_ring != NULL) {
+		munmap(wrk->control_ring, sizeof(struct rspamd_control_ring));
+		wrk->control_ring = NULL;
+	}
+
+	if (wrk->control_doorbell != -1) {
+		close(wrk->control_doorbell);
+		wrk->control_doorbell = -1;
+	}
+}
+
+static gboolean
+rspamd_control_ring_enqueue(struct rspamd_worker *wrk,
+							struct rspamd_control_command *cmd)
+{
+	struct rspamd_control_ring *ring = wrk->control_ring;
+	unsigned int head, tail;
+	uint64_t one = 1;
+
+	if (ring == NULL || wrk->control_doorbell == -1) {
+		return FALSE;
+	}
+
+	head = (unsigned int) g_atomic_int_get(&ring->head);
+	tail = (unsigned int) g_atomic_int_get(&ring->tail);
+
+	if (head - tail >= RSPAMD_CONTROL_RING_SIZE) {
+		/* Full: the worker is not draining, fall back to the socket path */
+		return FALSE;
+	}
+
+	memcpy(&ring->cmds[head % RSPAMD_CONTROL_RING_SIZE], cmd, sizeof(*cmd));
+	/* Publish the command, then kick the doorbell */
+	g_atomic_int_set(&ring->head, (gint) (head + 1));
+
+	if (write(wrk->control_doorbell, &one, sizeof(one)) == -1) {
+		msg_debug_control("cannot kick control ring doorbell: %s",
+						  strerror(errno));
+	}
+
+	return TRUE;
+}
+
 static void
 rspamd_control_stop_pending(struct rspamd_control_reply_elt *elt)
 {
@@ -501,6 +604,19 @@ rspamd_control_broadcast_cmd(struct rspamd_main *rspamd_main,
 			continue;
 		}
 
+		/*
+		 * Fire-and-forget commands with no descriptor attached do not need
+		 * the reply round-trip, so try the shared ring first
+		 */
+		if (handler == rspamd_control_ignore_io_handler && attached_fd == -1 &&
+			rspamd_control_ring_enqueue(wrk, cmd)) {
+			msg_debug_control("sent command %d to the worker %P(%s) via the ring",
+							  (int) cmd->type,
+							  wrk->pid,
+							  g_quark_to_string(wrk->type));
+			continue;
+		}
+
 		rep_elt = g_malloc0(sizeof(*rep_elt));
 		rep_elt->worker = wrk;
 		rep_elt->wrk_pid = wrk->pid;
@@ -675,6 +791,8 @@ void rspamd_control_process_client_socket(struct rspamd_main *rspamd_main,
 
 struct rspamd_worker_control_data {
 	ev_io io_ev;
+	ev_io ring_ev;
+	int ring_reply_fd;
 	struct rspamd_worker *worker;
 	struct ev_loop *ev_base;
 	struct {
@@ -825,6 +943,55 @@ rspamd_control_default_worker_handler(EV_P_ ev_io *w, int revents)
 	}
 }
 
+static void
+rspamd_control_ring_worker_handler(EV_P_ ev_io *w, int revents)
+{
+	struct rspamd_worker_control_data *cd =
+		(struct rspamd_worker_control_data *) w->data;
+	struct rspamd_control_ring *ring = cd->worker->control_ring;
+	struct rspamd_control_command cmd;
+	uint64_t cnt;
+	unsigned int tail;
+
+	/* Reset the doorbell counter, kicks are coalesced */
+	(void) !read(w->fd, &cnt, sizeof(cnt));
+
+	for (;;) {
+		tail = (unsigned int) g_atomic_int_get(&ring->tail);
+
+		if (tail == (unsigned int) g_atomic_int_get(&ring->head)) {
+			break;
+		}
+
+		memcpy(&cmd, &ring->cmds[tail % RSPAMD_CONTROL_RING_SIZE],
+			   sizeof(cmd));
+		g_atomic_int_set(&ring->tail, (gint) (tail + 1));
+
+		if ((int) cmd.type >= 0 && cmd.type < RSPAMD_CONTROL_MAX) {
+			/*
+			 * Handlers write their reply to the fd given; the main process
+			 * does not wait for replies to ring commands, so they are merely
+			 * swallowed by the null descriptor
+			 */
+			if (cd->handlers[cmd.type].handler) {
+				cd->handlers[cmd.type].handler(cd->worker->srv,
+											   cd->worker,
+											   cd->ring_reply_fd,
+											   -1,
+											   &cmd,
+											   cd->handlers[cmd.type].ud);
+			}
+			else {
+				rspamd_control_default_cmd_handler(cd->ring_reply_fd, -1, cd,
+												   &cmd);
+			}
+		}
+		else {
+			msg_err("unknown command in the control ring: %d", (int) cmd.type);
+		}
+	}
+}
+
 void rspamd_control_worker_add_default_cmd_handlers(struct rspamd_worker *worker,
 													struct ev_loop *ev_base)
 {
@@ -833,12 +1000,29 @@ void rspamd_control_worker_add_default_cmd_handlers(struct rspamd_worker *worker
 	cd = g_malloc0(sizeof(*cd));
 	cd->worker = worker;
 	cd->ev_base = ev_base;
+	cd->ring_reply_fd = -1;
 
 	cd->io_ev.data = cd;
 	ev_io_init(&cd->io_ev, rspamd_control_default_worker_handler,
 			   worker->control_pipe[1], EV_READ);
 	ev_io_start(ev_base, &cd->io_ev);
 
+	if (worker->control_ring != NULL && worker->control_doorbell != -1) {
+		cd->ring_reply_fd = open("/dev/null", O_WRONLY);
+
+		if (cd->ring_reply_fd != -1) {
+			cd->ring_ev.data = cd;
+			ev_io_init(&cd->ring_ev, rspamd_control_ring_worker_handler,
+					   worker->control_doorbell, EV_READ);
+			ev_io_start(ev_base, &cd->ring_ev);
+		}
+		else {
+			/* No reply sink, so do not consume the ring at all */
+			msg_warn("cannot open /dev/null for control ring replies: %s",
+					 strerror(errno));
+		}
+	}
+
 	worker->control_data = cd;
 }
 
@@ -938,6 +1122,8 @@ rspamd_control_handle_on_fork(struct rspamd_srv_command *cmd,
 		child->srv_pipe[1] = -1;
 		child->control_pipe[0] = -1;
 		child->control_pipe[1] = -1;
+		child->control_ring = NULL;
+		child->control_doorbell = -1;
 		child->cf = parent->cf;
 		child->ppid = parent->pid;
 		REF_RETAIN(child->cf);
@@ -301,6 +301,24 @@ void rspamd_control_broadcast_srv_cmd(struct rspamd_main *rspamd_main,
 									  struct rspamd_control_command *cmd,
 									  pid_t except_pid);
 
+/**
+ * Create a shared memory command ring for a worker; called in the main
+ * process before fork. Fire-and-forget broadcast commands that carry no
+ * descriptor are then pushed to the ring with a single doorbell write
+ * instead of a socketpair round-trip. On failure (or on systems without
+ * eventfd) all commands merely keep using the socket path.
+ * @param rspamd_main
+ * @param wrk
+ */
+void rspamd_control_ring_create(struct rspamd_main *rspamd_main,
+								struct rspamd_worker *wrk);
+
+/**
+ * Dispose the main process side of a worker's command ring
+ * @param wrk
+ */
+void rspamd_control_ring_destroy(struct rspamd_worker *wrk);
+
 /**
  * Returns command from a specified string (case insensitive)
  * @param str
@@ -82,6 +82,7 @@ struct rspamd_symcache_item_stat {
 	struct rspamd_counter_data frequency_counter;
 	double avg_frequency;
 	double stddev_frequency;
+	uint64_t profile_samples; /**< CPU sampling profiler hits, all workers */
 };
 
 /**
@@ -107,6 +108,16 @@ void rspamd_symcache_save(struct rspamd_symcache *cache);
  */
 gboolean rspamd_symcache_init(struct rspamd_symcache *cache);
 
+/**
+ * Carry over runtime stats (timings, frequencies) from an old cache to a
+ * freshly created one on config reload, avoiding a cold restart of the
+ * symbols ordering
+ * @param cache new cache
+ * @param old_cache cache to inherit stats from
+ */
+void rspamd_symcache_inherit_stats(struct rspamd_symcache *cache,
+								   struct rspamd_symcache *old_cache);
+
 /**
  * Generic function to register a symbol
  * @param cache
@@ -159,6 +170,20 @@ gboolean rspamd_symcache_add_condition_delayed(struct rspamd_symcache *cache,
 											   const char *sym,
 											   lua_State *L, int cbref);
 
+/**
+ * Add a native guard to the specific symbol in cache: a cheap predicate over
+ * the task state evaluated in C, so a failed guard skips the Lua VM entry
+ * entirely. So symbol can be absent to the moment of addition.
+ * @param cache
+ * @param sym name of symbol
+ * @param guard guard specification: optional leading `!` negates the
+ * predicate, the rest is `header:<name>`, `mime` or `empty`
+ * @return TRUE if the specification is valid and the guard has been added
+ */
+gboolean rspamd_symcache_add_symbol_guard(struct rspamd_symcache *cache,
+										  const char *sym,
+										  const char *guard);
+
 /**
  * Find symbol in cache by id and returns its id resolving virtual symbols if
  * applicable
@@ -542,6 +567,22 @@ rspamd_symcache_item_stat(struct rspamd_symcache_item *item);
  */
 void rspamd_symcache_enable_profile(struct rspamd_task *task);
 
+/**
+ * Start the in-process CPU sampling profiler: SIGPROF ticks at the specified
+ * frequency are attributed to the symbol being executed and accumulated in
+ * the shared counters exported via the `counters` controller endpoint
+ * @param hz sampling frequency, clamped to [1, 1000]
+ * @return TRUE if the timer has been armed
+ */
+gboolean rspamd_symcache_activate_sampler(unsigned int hz);
+
+/**
+ * Export the scan trace ring collected for a profiled task as an UCL array,
+ * or NULL when no trace has been recorded
+ * @param task
+ */
+ucl_object_t *rspamd_symcache_runtime_export_trace(struct rspamd_task *task);
+
 struct rspamd_symcache_timeout_item {
 	double timeout;
 	const struct rspamd_symcache_item *item;
@@ -69,6 +69,7 @@ struct rspamd_spf_library_ctx {
 	unsigned int max_dns_nesting;
 	unsigned int max_dns_requests;
 	unsigned int min_cache_ttl;
+	unsigned int neg_cache_ttl;
 	gboolean disable_ipv6;
 	rspamd_lru_hash_t *spf_hash;
 };
@@ -169,6 +170,7 @@ RSPAMD_CONSTRUCTOR(rspamd_spf_lib_ctx_ctor)
 	spf_lib_ctx->max_dns_nesting = SPF_MAX_NESTING;
 	spf_lib_ctx->max_dns_requests = SPF_MAX_DNS_REQUESTS;
 	spf_lib_ctx->min_cache_ttl = SPF_MIN_CACHE_TTL;
+	spf_lib_ctx->neg_cache_ttl = SPF_NEG_CACHE_TTL;
 	spf_lib_ctx->disable_ipv6 = FALSE;
 }
 
@@ -206,6 +208,12 @@ void spf_library_config(const ucl_object_t *obj)
 		}
 	}
 
+	if ((value = ucl_object_find_key(obj, "neg_cache_ttl")) != NULL) {
+		if (ucl_object_toint_safe(value, &ival) && ival >= 0) {
+			spf_lib_ctx->neg_cache_ttl = ival;
+		}
+	}
+
 	if ((value = ucl_object_find_key(obj, "max_dns_nesting")) != NULL) {
 		if (ucl_object_toint_safe(value, &ival) && ival >= 0) {
 			spf_lib_ctx->max_dns_nesting = ival;
@@ -628,19 +636,35 @@ rspamd_spf_maybe_return(struct spf_record *rec)
 		flat = rspamd_spf_record_flatten(rec);
 		rspamd_spf_record_postprocess(flat, rec->task);
 
-		if (flat->ttl > 0 && flat->flags == 0) {
+		if (spf_lib_ctx->spf_hash) {
+			unsigned int cache_ttl = 0;
+
+			if (flat->ttl > 0 && flat->flags == 0) {
+				cache_ttl = flat->ttl;
+			}
+			else if (spf_lib_ctx->neg_cache_ttl > 0 &&
+					 !(flat->flags & RSPAMD_SPF_RESOLVED_TEMP_FAILED) &&
+					 (flat->flags & (RSPAMD_SPF_RESOLVED_NA |
+									 RSPAMD_SPF_RESOLVED_PERM_FAILED))) {
+				/*
+				 * Negative result: domains without SPF or with broken records
+				 * are otherwise re-resolved for every message, so cache them
+				 * for a short while; temporary failures are never cached
+				 */
+				cache_ttl = flat->ttl > 0 ? MIN(flat->ttl, spf_lib_ctx->neg_cache_ttl) : spf_lib_ctx->neg_cache_ttl;
+			}
 
-			if (spf_lib_ctx->spf_hash) {
+			if (cache_ttl > 0) {
 				rspamd_lru_hash_insert(spf_lib_ctx->spf_hash,
 									   g_strdup(flat->domain),
 									   spf_record_ref(flat),
-									   flat->timestamp, flat->ttl);
+									   flat->timestamp, cache_ttl);
 
 				msg_info_task("stored SPF record for %s (0x%xuL) in LRU cache for %d seconds, "
 							  "%d/%d elements in the cache",
 							  flat->domain,
 							  flat->digest,
-							  flat->ttl,
+							  cache_ttl,
 							  rspamd_lru_hash_size(spf_lib_ctx->spf_hash),
 							  rspamd_lru_hash_capacity(spf_lib_ctx->spf_hash));
 				cached = true;
@@ -83,6 +83,7 @@ typedef enum spf_action_e {
 #define SPF_MAX_NESTING 10
 #define SPF_MAX_DNS_REQUESTS 30
 #define SPF_MIN_CACHE_TTL (60 * 5) /* 5 minutes */
+#define SPF_NEG_CACHE_TTL 60       /* 1 minute for NA/permfail records */
 
 struct spf_addr {
 	unsigned char addr6[sizeof(struct in6_addr)];
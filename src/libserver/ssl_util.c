@@ -676,8 +676,31 @@ rspamd_ssl_connect_fd(struct rspamd_ssl_connection *conn, int fd,
 										 ev_now(conn->event_loop));
 	}
 
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	if (session && !SSL_SESSION_is_resumable(session)) {
+		/* Expired or otherwise unusable ticket, discard it */
+		msg_debug_ssl("drop stale session for %s", hostname);
+		rspamd_lru_hash_remove(conn->ssl_ctx->sessions, hostname);
+		session = NULL;
+	}
+#endif
+
 	if (session) {
 		SSL_set_session(conn->ssl, session);
+		msg_debug_ssl("resume session for %s", hostname);
+
+#ifdef TLS1_3_VERSION
+		if (SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION) {
+			/*
+			 * TLS 1.3 tickets are single use; SSL_set_session has grabbed
+			 * its own reference, so evict the ticket from the cache to avoid
+			 * replaying it on subsequent connections. The server sends fresh
+			 * tickets on the resumed connection that will repopulate the
+			 * cache via the new session callback.
+			 */
+			rspamd_lru_hash_remove(conn->ssl_ctx->sessions, hostname);
+		}
+#endif
 	}
 
 	SSL_set_app_data(conn->ssl, conn);
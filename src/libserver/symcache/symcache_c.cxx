@@ -58,6 +58,17 @@ void rspamd_symcache_save(struct rspamd_symcache *cache)
 	real_cache->save_items();
 }
 
+void rspamd_symcache_inherit_stats(struct rspamd_symcache *cache,
+								   struct rspamd_symcache *old_cache)
+{
+	auto *real_cache = C_API_SYMCACHE(cache);
+	auto *real_old_cache = C_API_SYMCACHE(old_cache);
+
+	if (real_cache && real_old_cache) {
+		real_cache->inherit_stats(*real_old_cache);
+	}
+}
+
 int rspamd_symcache_add_symbol(struct rspamd_symcache *cache,
 							   const char *name,
 							   int priority,
@@ -128,6 +139,22 @@ rspamd_symcache_add_condition_delayed(struct rspamd_symcache *cache,
 	return TRUE;
 }
 
+gboolean
+rspamd_symcache_add_symbol_guard(struct rspamd_symcache *cache,
+								 const char *sym, const char *guard)
+{
+	auto *real_cache = C_API_SYMCACHE(cache);
+
+	/* Validate the specification early, registration itself is delayed */
+	if (!rspamd::symcache::item_guard::from_string(guard)) {
+		return FALSE;
+	}
+
+	real_cache->add_delayed_guard(sym, guard);
+
+	return TRUE;
+}
+
 int rspamd_symcache_find_symbol(struct rspamd_symcache *cache,
 								const char *name)
 {
@@ -589,6 +616,23 @@ void rspamd_symcache_enable_profile(struct rspamd_task *task)
 	cache_runtime->set_profile_mode(true);
 }
 
+gboolean rspamd_symcache_activate_sampler(unsigned int hz)
+{
+	return rspamd::symcache::activate_cpu_sampler(hz);
+}
+
+ucl_object_t *
+rspamd_symcache_runtime_export_trace(struct rspamd_task *task)
+{
+	auto *cache_runtime = C_API_SYMCACHE_RUNTIME(task->symcache_runtime);
+
+	if (!cache_runtime) {
+		return nullptr;
+	}
+
+	return cache_runtime->export_trace(task);
+}
+
 unsigned int rspamd_symcache_item_async_inc_full(struct rspamd_task *task,
 												 struct rspamd_symcache_dynamic_item *item,
 												 const char *subsystem,
@@ -608,6 +652,8 @@ unsigned int rspamd_symcache_item_async_inc_full(struct rspamd_task *task,
 		/* Item is async */
 		static_item->internal_flags &= ~rspamd::symcache::cache_item::bit_sync;
 		real_dyn_item->status = rspamd::symcache::cache_item_status::pending;
+		cache_runtime->trace_transition(task, static_item->id,
+										rspamd::symcache::cache_item_status::pending);
 	}
 
 	return nevents;
@@ -189,28 +189,106 @@ auto symcache::init() -> bool
 
 	/* Deal with the delayed conditions */
 	msg_debug_cache("resolving delayed conditions: %d in list", (int) delayed_conditions->size());
+
+	/*
+	 * Group conditions by symbol, so each item is resolved just once; within
+	 * a group, identical closures (e.g. registered repeatedly by plugins for
+	 * the same symbol) are collapsed to a single condition instead of being
+	 * evaluated several times on every scan
+	 */
+	std::stable_sort(std::begin(*delayed_conditions), std::end(*delayed_conditions),
+					 [](const auto &c1, const auto &c2) {
+						 return c1.sym < c2.sym;
+					 });
+
+	cache_item *cond_item = nullptr;
+	std::string_view prev_cond_sym;
+	std::vector<int> seen_cond_refs;
+
 	for (const auto &delayed_cond: *delayed_conditions) {
-		auto it = get_item_by_name_mut(delayed_cond.sym, true);
+		if (cond_item == nullptr || prev_cond_sym != delayed_cond.sym) {
+			cond_item = get_item_by_name_mut(delayed_cond.sym, true);
+			prev_cond_sym = delayed_cond.sym;
+			seen_cond_refs.clear();
+		}
 
-		if (it == nullptr) {
+		if (cond_item == nullptr) {
 			msg_err_cache(
 				"cannot register delayed condition for %s",
 				delayed_cond.sym.c_str());
 			luaL_unref(delayed_cond.L, LUA_REGISTRYINDEX, delayed_cond.cbref);
+			continue;
 		}
-		else {
-			if (!it->add_condition(delayed_cond.L, delayed_cond.cbref)) {
-				msg_err_cache(
-					"cannot register delayed condition for %s: virtual parent; qed",
-					delayed_cond.sym.c_str());
-				g_abort();
+
+		/* Check if the very same closure is already attached to this symbol */
+		auto is_dup = false;
+		lua_rawgeti(delayed_cond.L, LUA_REGISTRYINDEX, delayed_cond.cbref);
+
+		for (auto seen_ref: seen_cond_refs) {
+			lua_rawgeti(delayed_cond.L, LUA_REGISTRYINDEX, seen_ref);
+
+			if (lua_rawequal(delayed_cond.L, -1, -2)) {
+				is_dup = true;
+				lua_pop(delayed_cond.L, 1);
+				break;
 			}
 
-			msg_debug_cache("added a condition to the symbol %s", it->symbol.c_str());
+			lua_pop(delayed_cond.L, 1);
+		}
+
+		lua_pop(delayed_cond.L, 1);
+
+		if (is_dup) {
+			msg_debug_cache("skip duplicate condition closure for symbol %s",
+							delayed_cond.sym.c_str());
+			luaL_unref(delayed_cond.L, LUA_REGISTRYINDEX, delayed_cond.cbref);
+			continue;
+		}
+
+		if (!cond_item->add_condition(delayed_cond.L, delayed_cond.cbref)) {
+			msg_err_cache(
+				"cannot register delayed condition for %s: virtual parent; qed",
+				delayed_cond.sym.c_str());
+			g_abort();
 		}
+
+		seen_cond_refs.push_back(delayed_cond.cbref);
+		msg_debug_cache("added a condition to the symbol %s", cond_item->symbol.c_str());
 	}
 	delayed_conditions.reset();
 
+	/* Deal with the delayed native guards */
+	msg_debug_cache("resolving delayed guards: %d in list", (int) delayed_guards->size());
+
+	for (const auto &delayed_guard: *delayed_guards) {
+		auto *guard_item = get_item_by_name_mut(delayed_guard.sym, true);
+
+		if (guard_item == nullptr) {
+			msg_err_cache("cannot register delayed guard for %s",
+						  delayed_guard.sym.c_str());
+			continue;
+		}
+
+		auto parsed_guard = item_guard::from_string(delayed_guard.guard);
+
+		if (!parsed_guard) {
+			msg_err_cache("invalid guard specification '%s' for %s",
+						  delayed_guard.guard.c_str(),
+						  delayed_guard.sym.c_str());
+			continue;
+		}
+
+		if (!guard_item->add_guard(std::move(*parsed_guard))) {
+			msg_err_cache("cannot register delayed guard for %s: virtual parent; qed",
+						  delayed_guard.sym.c_str());
+			g_abort();
+		}
+
+		msg_debug_cache("added a guard '%s' to the symbol %s",
+						delayed_guard.guard.c_str(), guard_item->symbol.c_str());
+	}
+	delayed_guards.reset();
+
 	msg_debug_cache("process dependencies");
 	for (const auto &[_id, it]: items_by_id) {
 		it->process_deps(*this);
@@ -230,6 +308,8 @@ auto symcache::init() -> bool
 	std::stable_sort(std::begin(postfilters), std::end(postfilters), postfilters_cmp);
 	std::stable_sort(std::begin(idempotent), std::end(idempotent), postfilters_cmp);
 
+	/* Static layering of the dependency graph, done once per config */
+	topology_sort();
 	resort();
 
 	/* Connect metric symbols with symcache symbols */
@@ -267,6 +347,64 @@ auto symcache::load_items() -> bool
 
 	const auto *hdr = (struct symcache_header *) cached_map->get_map();
 
+	if (memcmp(hdr->magic, symcache_magic_v3,
+			   sizeof(symcache_magic_v3)) == 0) {
+		/* Fixed layout profile: read records straight from the map, no parsing */
+		const auto nitems = hdr->nitems;
+
+		if (cached_map->get_size() < sizeof(*hdr) +
+										 nitems * sizeof(symcache_profile_elt)) {
+			msg_info_cache("cannot use file %s, truncated binary profile: "
+						   "%z bytes for %d items",
+						   cfg->cache_filename,
+						   (std::size_t) cached_map->get_size(), (int) nitems);
+			return false;
+		}
+
+		const auto *recs = reinterpret_cast<const symcache_profile_elt *>(hdr + 1);
+		ankerl::unordered_dense::map<std::uint64_t, const symcache_profile_elt *> by_hash;
+		by_hash.reserve(nitems);
+
+		for (auto i = 0u; i < nitems; i++) {
+			by_hash[recs[i].name_hash] = &recs[i];
+		}
+
+		for (const auto &[name, item]: items_by_symbol) {
+			auto rec_it = by_hash.find(t1ha2_atonce(name.data(), name.size(),
+													symcache_profile_hash_seed));
+
+			if (rec_it == by_hash.end()) {
+				continue;
+			}
+
+			const auto *rec = rec_it->second;
+			item->st->avg_time = rec->avg_time;
+			item->st->total_hits = rec->total_hits;
+			item->last_count = rec->total_hits;
+			item->st->avg_frequency = rec->avg_frequency;
+			item->st->stddev_frequency = rec->stddev_frequency;
+
+			if (item->is_virtual() && !item->is_ghost()) {
+				const auto &parent = item->get_parent(*this);
+
+				if (parent) {
+					if (parent->st->weight < item->st->weight) {
+						parent->st->weight = item->st->weight;
+					}
+					item->st->avg_time = parent->st->avg_time;
+				}
+			}
+
+			total_weight += fabs(item->st->weight);
+			total_hits += item->st->total_hits;
+		}
+
+		msg_debug_cache("loaded binary profile from %s: %d items",
+						cfg->cache_filename, (int) nitems);
+
+		return true;
+	}
+
 	if (memcmp(hdr->magic, symcache_magic,
 			   sizeof(symcache_magic)) != 0) {
 		msg_info_cache("cannot use file %s, bad magic", cfg->cache_filename);
@@ -398,7 +536,8 @@ bool symcache::save_items() const
 
 	struct symcache_header hdr;
 	memset(&hdr, 0, sizeof(hdr));
-	memcpy(hdr.magic, symcache_magic, sizeof(symcache_magic));
+	memcpy(hdr.magic, symcache_magic_v3, sizeof(symcache_magic_v3));
+	hdr.nitems = items_by_symbol.size();
 
 	if (write(file_sink->get_fd(), &hdr, sizeof(hdr)) == -1) {
 		msg_err_cache("cannot write to file %s, error %d, %s", cfg->cache_filename,
@@ -407,40 +546,62 @@ bool symcache::save_items() const
 		return false;
 	}
 
-	auto *top = ucl_object_typed_new(UCL_OBJECT);
+	/* Fixed layout records, written in a single chunk */
+	std::vector<symcache_profile_elt> recs;
+	recs.reserve(items_by_symbol.size());
 
 	for (const auto &it: items_by_symbol) {
 		auto item = it.second;
-		auto elt = ucl_object_typed_new(UCL_OBJECT);
-		ucl_object_insert_key(elt,
-							  ucl_object_fromdouble(round_to_hundreds(item->st->weight)),
-							  "weight", 0, false);
-		ucl_object_insert_key(elt,
-							  ucl_object_fromdouble(round_to_hundreds(item->st->time_counter.mean)),
-							  "time", 0, false);
-		ucl_object_insert_key(elt, ucl_object_fromint(item->st->total_hits),
-							  "count", 0, false);
-
-		auto *freq = ucl_object_typed_new(UCL_OBJECT);
-		ucl_object_insert_key(freq,
-							  ucl_object_fromdouble(round_to_hundreds(item->st->frequency_counter.mean)),
-							  "avg", 0, false);
-		ucl_object_insert_key(freq,
-							  ucl_object_fromdouble(round_to_hundreds(item->st->frequency_counter.stddev)),
-							  "stddev", 0, false);
-		ucl_object_insert_key(elt, freq, "frequency", 0, false);
-
-		ucl_object_insert_key(top, elt, it.first.data(), 0, true);
-	}
-
-	auto fp = fdopen(file_sink->get_fd(), "a");
-	auto *efunc = ucl_object_emit_file_funcs(fp);
-	auto ret = ucl_object_emit_full(top, UCL_EMIT_JSON_COMPACT, efunc, nullptr);
-	ucl_object_emit_funcs_free(efunc);
-	ucl_object_unref(top);
-	fclose(fp);
+		recs.emplace_back(symcache_profile_elt{
+			t1ha2_atonce(it.first.data(), it.first.size(),
+						 symcache_profile_hash_seed),
+			item->st->total_hits,
+			round_to_hundreds(item->st->time_counter.mean),
+			round_to_hundreds(item->st->frequency_counter.mean),
+			round_to_hundreds(item->st->frequency_counter.stddev),
+		});
+	}
 
-	return ret;
+	if (write(file_sink->get_fd(), recs.data(),
+			  recs.size() * sizeof(symcache_profile_elt)) == -1) {
+		msg_err_cache("cannot write to file %s, error %d, %s", cfg->cache_filename,
+					  errno, strerror(errno));
+
+		return false;
+	}
+
+	return true;
+}
+
+auto symcache::inherit_stats(const symcache &other) -> std::size_t
+{
+	std::size_t inherited = 0;
+
+	for (const auto &[name, item]: items_by_symbol) {
+		auto other_it = other.items_by_symbol.find(name);
+
+		if (other_it == other.items_by_symbol.end()) {
+			continue;
+		}
+
+		const auto *other_item = other_it->second;
+		item->st->avg_time = other_item->st->avg_time;
+		item->st->total_hits = other_item->st->total_hits;
+		item->st->time_counter = other_item->st->time_counter;
+		item->st->frequency_counter = other_item->st->frequency_counter;
+		item->st->avg_frequency = other_item->st->avg_frequency;
+		item->st->stddev_frequency = other_item->st->stddev_frequency;
+		item->last_count = other_item->last_count;
+		inherited++;
+	}
+
+	msg_info_cache("inherited stats for %z symbols out of %z from the previous cache",
+				   inherited, items_by_symbol.size());
+
+	/* Ranking inputs have changed, renew the ordering on the next scan */
+	cur_order_gen++;
+
+	return inherited;
 }
 
 auto symcache::metric_connect_cb(void *k, void *v, void *ud) -> void
@@ -582,24 +743,30 @@ auto symcache::add_dependency(int id_from, std::string_view to, int id_to, int v
 	}
 }
 
-auto symcache::resort() -> void
+auto order_generation::build_hot_view() -> void
+{
+	hot.clear();
+	hot.reserve(d.size());
+
+	for (const auto &it: d) {
+		hot.emplace_back(cache_item_hot_view{it.get(), it->id, it->flags, it->type,
+											 !it->deps.empty()});
+	}
+}
+
+static constexpr auto tsort_unmask(const cache_item *it) -> unsigned int
+{
+	return (it->order & ~((1u << 31) | (1u << 30)));
+}
+
+auto symcache::topology_sort() -> void
 {
 	auto log_func = RSPAMD_LOG_FUNC;
-	auto ord = std::make_shared<order_generation>(filters.size() +
-													  prefilters.size() +
-													  composites.size() +
-													  postfilters.size() +
-													  idempotent.size() +
-													  connfilters.size() +
-													  classifiers.size(),
-												  cur_order_gen);
 
 	for (auto &it: filters) {
 		if (it) {
-			total_hits += it->st->total_hits;
 			/* Unmask topological order */
 			it->order = 0;
-			ord->d.emplace_back(it->getptr());
 		}
 	}
 
@@ -608,10 +775,6 @@ auto symcache::resort() -> void
 		TEMP
 	};
 
-	constexpr auto tsort_unmask = [](cache_item *it) -> auto {
-		return (it->order & ~((1u << 31) | (1u << 30)));
-	};
-
 	/* Recursive topological sort helper */
 	const auto tsort_visit = [&](cache_item *it, unsigned cur_order, auto &&rec) {
 		constexpr auto tsort_mark = [](cache_item *it, tsort_mask how) {
@@ -662,19 +825,43 @@ auto symcache::resort() -> void
 		it->order = cur_order;
 		tsort_mark(it, tsort_mask::PERM);
 	};
+
+	msg_debug_cache("topologically sort %d filters", (int) filters.size());
+
+	for (const auto &it: filters) {
+		if (it && it->order == 0) {
+			tsort_visit(it, 0, tsort_visit);
+		}
+	}
+}
+
+auto symcache::resort() -> void
+{
+	auto log_func = RSPAMD_LOG_FUNC;
+	auto ord = rspamd::local_make_shared<order_generation>(filters.size() +
+															   prefilters.size() +
+															   composites.size() +
+															   postfilters.size() +
+															   idempotent.size() +
+															   connfilters.size() +
+															   classifiers.size(),
+														   cur_order_gen);
+
 	/*
-	 * Topological sort
+	 * The topological layering is static: it is computed once in `init()`
+	 * (the edge set only changes on config reload), so a resort is merely a
+	 * linear counting pass plus a re-rank by priority/frequency
 	 */
 	total_hits = 0;
-	auto used_items = ord->d.size();
-	msg_debug_cache("topologically sort %d filters", used_items);
 
-	for (const auto &it: ord->d) {
-		if (it->order == 0) {
-			tsort_visit(it.get(), 0, tsort_visit);
+	for (auto &it: filters) {
+		if (it) {
+			total_hits += it->st->total_hits;
+			ord->d.emplace_back(it->getptr());
 		}
 	}
 
+	auto used_items = ord->d.size();
 
 	/* Main sorting comparator */
 	constexpr auto score_functor = [](auto w, auto f, auto t) -> auto {
@@ -747,8 +934,13 @@ auto symcache::resort() -> void
 		ord->by_symbol.emplace(it->get_name(), i);
 		ord->by_cache_id[it->id] = i;
 	}
-	/* Finally set the current order */
-	std::swap(ord, items_by_order);
+
+	ord->build_hot_view();
+	/*
+	 * Finally publish the new epoch: running scans keep their stale
+	 * reference unperturbed whilst new scans pick the fresh ordering
+	 */
+	items_by_order = std::move(ord);
 }
 
 auto symcache::add_symbol_with_callback(std::string_view name,
@@ -881,6 +1073,11 @@ auto symcache::add_delayed_condition(std::string_view sym, int cbref) -> void
 	delayed_conditions->emplace_back(sym, cbref, (lua_State *) cfg->lua_state);
 }
 
+auto symcache::add_delayed_guard(std::string_view sym, std::string_view guard) -> void
+{
+	delayed_guards->emplace_back(sym, guard);
+}
+
 auto symcache::validate(bool strict) -> bool
 {
 	total_weight = 1.0;
@@ -1017,6 +1214,12 @@ auto symcache::counters() const -> ucl_object_t *
 				ucl_object_insert_key(obj,
 									  ucl_object_fromdouble(round_float(parent->st->avg_time, 3)),
 									  "time", 0, false);
+				ucl_object_insert_key(obj,
+									  ucl_object_fromdouble(round_float(parent->alloc_cd->mean, 0)),
+									  "allocated", 0, false);
+				ucl_object_insert_key(obj,
+									  ucl_object_fromint(parent->st->profile_samples),
+									  "samples", 0, false);
 			}
 			else {
 				ucl_object_insert_key(obj,
@@ -1031,6 +1234,12 @@ auto symcache::counters() const -> ucl_object_t *
 				ucl_object_insert_key(obj,
 									  ucl_object_fromdouble(0.0),
 									  "time", 0, false);
+				ucl_object_insert_key(obj,
+									  ucl_object_fromdouble(0.0),
+									  "allocated", 0, false);
+				ucl_object_insert_key(obj,
+									  ucl_object_fromint(0),
+									  "samples", 0, false);
 			}
 		}
 		else {
@@ -1046,6 +1255,12 @@ auto symcache::counters() const -> ucl_object_t *
 			ucl_object_insert_key(obj,
 								  ucl_object_fromdouble(round_float(item->st->avg_time, 3)),
 								  "time", 0, false);
+			ucl_object_insert_key(obj,
+								  ucl_object_fromdouble(round_float(item->alloc_cd->mean, 0)),
+								  "allocated", 0, false);
+			ucl_object_insert_key(obj,
+								  ucl_object_fromint(item->st->profile_samples),
+								  "samples", 0, false);
 		}
 
 		ucl_array_append(top, obj);
@@ -1103,13 +1318,15 @@ symcache::~symcache()
 
 auto symcache::maybe_resort() -> bool
 {
-	if (items_by_order->generation_id != cur_order_gen) {
+	auto cur_order = get_cache_order();
+
+	if (cur_order->generation_id != cur_order_gen) {
 		/*
 		 * Cache has been modified, need to resort it
 		 */
 		msg_info_cache("symbols cache has been modified since last check:"
 					   " old id: %ud, new id: %ud",
-					   items_by_order->generation_id, cur_order_gen);
+					   cur_order->generation_id, cur_order_gen);
 		resort();
 
 		return true;
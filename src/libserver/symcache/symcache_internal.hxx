@@ -22,6 +22,7 @@
 #define RSPAMD_SYMCACHE_INTERNAL_HXX
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <cstdint>
@@ -37,6 +38,7 @@
 #include "contrib/ankerl/unordered_dense.h"
 #include "contrib/expected/expected.hpp"
 #include "cfg_file.h"
+#include "libutil/cxx/local_shared_ptr.hxx"
 
 #include "symcache_id_list.hxx"
 
@@ -85,6 +87,8 @@ namespace rspamd::symcache {
 extern int rspamd_symcache_log_id;
 
 static const std::uint8_t symcache_magic[8] = {'r', 's', 'c', 2, 0, 0, 0, 0};
+/* Version 3 stores profile data as fixed layout records instead of UCL */
+static const std::uint8_t symcache_magic_v3[8] = {'r', 's', 'c', 3, 0, 0, 0, 0};
 
 struct symcache_header {
 	std::uint8_t magic[8];
@@ -93,8 +97,40 @@ struct symcache_header {
 	std::uint8_t unused[128];
 };
 
+/*
+ * A fixed layout profile record as stored in a version 3 cache file right
+ * after the header. Symbols are identified by a hash of their name, so the
+ * whole file can be read straight from the mmaped region with no parsing.
+ */
+struct symcache_profile_elt {
+	std::uint64_t name_hash;
+	std::uint64_t total_hits;
+	double avg_time;
+	double avg_frequency;
+	double stddev_frequency;
+};
+
+constexpr static std::uint64_t symcache_profile_hash_seed = 0xcafeb0dd5eedULL;
+
 struct cache_item;
 using cache_item_ptr = std::shared_ptr<cache_item>;
+enum class symcache_item_type;
+
+/**
+ * A packed copy of the scheduling relevant fields of a cache item.
+ * The scheduler iterates over a flat vector of these views instead of
+ * pointer-chasing shared_ptr allocations, keeping the hot loop within L1;
+ * `item` is the escape hatch back to the full item for the slow path.
+ */
+struct cache_item_hot_view {
+	cache_item *item;
+	int id;
+	int flags;
+	symcache_item_type type;
+	/* False for members of the independent ready-set: they can be
+	 * dispatched straight away without walking the dependency graph */
+	bool has_deps;
+};
 
 /**
  * This structure is intended to keep the current ordering for all symbols
@@ -108,6 +144,8 @@ using cache_item_ptr = std::shared_ptr<cache_item>;
 struct order_generation {
 	/* All items ordered */
 	std::vector<cache_item_ptr> d;
+	/* Flat SoA style view of the hot fields of `d`, same indexing */
+	std::vector<cache_item_hot_view> hot;
 	/* Mapping from symbol name to the position in the order array */
 	ankerl::unordered_dense::map<std::string_view, unsigned int> by_symbol;
 	/* Mapping from symbol id to the position in the order array */
@@ -123,13 +161,23 @@ struct order_generation {
 		by_cache_id.reserve(nelts);
 	}
 
+	/**
+	 * Rebuilds the flattened hot view from `d`; must be called once `d` is
+	 * fully sorted and before the ordering is published to scans
+	 */
+	auto build_hot_view() -> void;
+
 	auto size() const -> auto
 	{
 		return d.size();
 	}
 };
 
-using order_generation_ptr = std::shared_ptr<order_generation>;
+/*
+ * The ordering is copied on the scan path for every task; workers are
+ * single-threaded processes, so a local (non-atomic) refcount suffices
+ */
+using order_generation_ptr = rspamd::local_shared_ptr<order_generation>;
 
 
 struct delayed_cache_dependency {
@@ -154,6 +202,17 @@ public:
 	}
 };
 
+struct delayed_cache_guard {
+	std::string sym;
+	std::string guard; /* Textual specification, parsed on resolution */
+
+public:
+	delayed_cache_guard(std::string_view sym, std::string_view guard)
+		: sym(sym), guard(guard)
+	{
+	}
+};
+
 class delayed_symbol_elt {
 private:
 	std::variant<std::string, rspamd_regexp_t *> content;
@@ -262,7 +321,14 @@ private:
 	ankerl::unordered_dense::map<std::string_view, cache_item *> items_by_symbol;
 	ankerl::unordered_dense::map<int, cache_item_ptr> items_by_id;
 
-	/* Items sorted into some order */
+	/*
+	 * Items sorted into some order.
+	 * This pointer is published with release semantics on resort and read
+	 * with acquire semantics by running scans (RCU style): a scan started
+	 * before a resort keeps its own reference to the old epoch, whilst new
+	 * scans observe the fresh ordering with a single atomic load and no
+	 * locking whatsoever.
+	 */
 	order_generation_ptr items_by_order;
 	unsigned int cur_order_gen;
 
@@ -279,6 +345,7 @@ private:
 	/* These are stored within pointer to clean up after init */
 	std::unique_ptr<std::vector<delayed_cache_dependency>> delayed_deps;
 	std::unique_ptr<std::vector<delayed_cache_condition>> delayed_conditions;
+	std::unique_ptr<std::vector<delayed_cache_guard>> delayed_guards;
 	/* Delayed statically enabled or disabled symbols */
 	using delayed_symbol_names = ankerl::unordered_dense::set<delayed_symbol_elt,
 															  delayed_symbol_elt_hash, delayed_symbol_elt_equal>;
@@ -305,6 +372,7 @@ private:
 private:
 	/* Internal methods */
 	auto load_items() -> bool;
+	auto topology_sort() -> void;
 	auto resort() -> void;
 	auto get_item_specific_vector(const cache_item &) -> items_ptr_vec &;
 	/* Helper for g_hash_table_foreach */
@@ -324,6 +392,7 @@ public:
 		cache_id = rspamd_random_uint64_fast();
 		L = (lua_State *) cfg->lua_state;
 		delayed_conditions = std::make_unique<std::vector<delayed_cache_condition>>();
+		delayed_guards = std::make_unique<std::vector<delayed_cache_guard>>();
 		delayed_deps = std::make_unique<std::vector<delayed_cache_dependency>>();
 	}
 
@@ -482,6 +551,13 @@ public:
 	 */
 	auto add_delayed_condition(std::string_view sym, int cbref) -> void;
 
+	/**
+	 * Add a delayed native guard for a symbol that might not be registered yet
+	 * @param sym
+	 * @param guard textual guard specification
+	 */
+	auto add_delayed_guard(std::string_view sym, std::string_view guard) -> void;
+
 	/**
 	 * Returns number of symbols that needs to be checked in statistical algorithm
 	 * @return
@@ -507,6 +583,15 @@ public:
 	 */
 	auto validate(bool strict) -> bool;
 
+	/**
+	 * Carry over runtime stats from another (e.g. pre-reload) cache for all
+	 * symbols that still exist in this cache, so a config reload does not
+	 * reset frequencies and timings to zero
+	 * @param other cache to inherit from
+	 * @return number of symbols that inherited stats
+	 */
+	auto inherit_stats(const symcache &other) -> std::size_t;
+
 	/**
 	 * Returns counters for the cache
 	 * @return
@@ -606,10 +691,13 @@ public:
 	auto maybe_resort() -> bool;
 
 	/**
-	 * Returns current set of items ordered for sharing ownership
+	 * Returns current set of items ordered for sharing ownership.
+	 * Merely a refcount bump: the worker is single-threaded, so a scan
+	 * started before a resort keeps its reference to the old epoch whilst
+	 * new scans pick the fresh one from this pointer.
 	 * @return
 	 */
-	auto get_cache_order() const -> auto
+	auto get_cache_order() const -> order_generation_ptr
 	{
 		return items_by_order;
 	}
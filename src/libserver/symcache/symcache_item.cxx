@@ -19,6 +19,7 @@
 #include "symcache_item.hxx"
 #include "contrib/fmt/include/fmt/base.h"
 #include "libserver/task.h"
+#include "libmime/mime_headers.h"
 #include "libutil/cxx/util.hxx"
 #include <numeric>
 #include <functional>
@@ -237,6 +238,12 @@ auto cache_item::update_counters_check_peak(lua_State *L,
 	auto ret = false;
 	static const double decay_rate = 0.25;
 
+	/* Fold the process local shard into the shared counter */
+	if (local_hits > 0) {
+		g_atomic_int_add(&st->hits, (unsigned int) local_hits);
+		local_hits = 0;
+	}
+
 	st->total_hits += st->hits;
 	g_atomic_int_set(&st->hits, 0);
 
@@ -296,8 +303,11 @@ auto cache_item::inc_frequency(const char *sym_name, symcache &cache) -> void
 		}
 	}
 	else {
-		/* Symbol and sym name are the same */
-		g_atomic_int_inc(&st->hits);
+		/*
+		 * Symbol and sym name are the same; bump the process local shard,
+		 * the shared counter is updated on the periodic resort tick
+		 */
+		local_hits++;
 	}
 }
 
@@ -663,4 +673,47 @@ auto item_condition::check(std::string_view sym_name, struct rspamd_task *task)
 	return true;
 }
 
+auto item_guard::from_string(std::string_view spec) -> std::optional<item_guard>
+{
+	auto negated = false;
+
+	if (!spec.empty() && spec.front() == '!') {
+		negated = true;
+		spec.remove_prefix(1);
+	}
+
+	if (spec == "mime") {
+		return item_guard{guard_type::is_mime, negated};
+	}
+	else if (spec == "empty") {
+		return item_guard{guard_type::is_empty, negated};
+	}
+	else if (spec.size() > sizeof("header:") - 1 &&
+			 spec.substr(0, sizeof("header:") - 1) == "header:") {
+		return item_guard{guard_type::header_exists, negated,
+						  std::string{spec.substr(sizeof("header:") - 1)}};
+	}
+
+	return std::nullopt;
+}
+
+auto item_guard::check(struct rspamd_task *task) const -> bool
+{
+	auto ret = false;
+
+	switch (type) {
+	case guard_type::header_exists:
+		ret = rspamd_message_get_header_array(task, header.c_str(), FALSE) != nullptr;
+		break;
+	case guard_type::is_mime:
+		ret = RSPAMD_TASK_IS_MIME(task);
+		break;
+	case guard_type::is_empty:
+		ret = RSPAMD_TASK_IS_EMPTY(task);
+		break;
+	}
+
+	return negated ? !ret : ret;
+}
+
 }// namespace rspamd::symcache
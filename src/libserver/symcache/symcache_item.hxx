@@ -116,6 +116,36 @@ public:
 	auto check(std::string_view sym_name, struct rspamd_task *task) const -> bool;
 };
 
+/*
+ * A native guard evaluated before the symbol callback is called: a cheap
+ * predicate over the task state that avoids entering the Lua VM at all when
+ * a callback would return immediately anyway
+ */
+struct item_guard {
+	enum class guard_type : std::uint8_t {
+		header_exists,
+		is_mime,
+		is_empty,
+	};
+
+	guard_type type;
+	bool negated;
+	std::string header;
+
+	item_guard(guard_type type, bool negated, std::string header = "")
+		: type(type), negated(negated), header(std::move(header))
+	{
+	}
+
+	/**
+	 * Parse a guard specification: an optional leading `!` negates the
+	 * predicate, the rest is `header:<name>`, `mime` or `empty`
+	 */
+	static auto from_string(std::string_view spec) -> std::optional<item_guard>;
+
+	auto check(struct rspamd_task *task) const -> bool;
+};
+
 class normal_item {
 private:
 	symbol_func_t func = nullptr;
@@ -215,12 +245,21 @@ struct cache_item : std::enable_shared_from_this<cache_item> {
 	/* The following fields will live in shared memory */
 	struct rspamd_symcache_item_stat *st = nullptr;
 	struct rspamd_counter_data *cd = nullptr;
+	/* Lua bytes allocated by the callback, profiled runs solely */
+	struct rspamd_counter_data *alloc_cd = nullptr;
 
 	std::string symbol;
 
 	/* Unique id - counter */
 	int id;
 	std::uint64_t last_count = 0;
+	/*
+	 * Process local shard of the hits counter: incremented with a plain
+	 * store on the hot path and folded into the shared `st->hits` on the
+	 * periodic resort tick, so workers do not ping-pong the shared cache
+	 * line on every symbol hit
+	 */
+	std::uint64_t local_hits = 0;
 	symcache_item_type type;
 	int flags;
 
@@ -249,6 +288,9 @@ struct cache_item : std::enable_shared_from_this<cache_item> {
 								 rspamd::smart_str_hash, rspamd::smart_str_equal>
 		augmentations;
 
+	/* Native guards checked before the callback is entered */
+	std::vector<item_guard> guards;
+
 	/* Dependencies */
 	ankerl::unordered_dense::map<int, cache_dependency> deps;
 	/* Reverse dependencies */
@@ -380,6 +422,28 @@ public:
 		return false;
 	}
 
+	auto add_guard(item_guard &&guard) -> bool
+	{
+		if (!is_virtual()) {
+			guards.emplace_back(std::move(guard));
+
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Check all native guards for an item
+	 * @param task
+	 * @return
+	 */
+	auto check_guards(struct rspamd_task *task) const -> bool
+	{
+		return std::all_of(std::begin(guards), std::end(guards),
+						   [&](const auto &g) { return g.check(task); });
+	}
+
 	auto update_counters_check_peak(lua_State *L,
 									struct ev_loop *ev_loop,
 									double cur_time,
@@ -532,6 +596,7 @@ private:
 		exec_only_ids.reset();
 		st = rspamd_mempool_alloc0_shared_type(pool, std::remove_pointer_t<decltype(st)>);
 		cd = rspamd_mempool_alloc0_shared_type(pool, std::remove_pointer_t<decltype(cd)>);
+		alloc_cd = rspamd_mempool_alloc0_shared_type(pool, std::remove_pointer_t<decltype(alloc_cd)>);
 	}
 
 	/**
@@ -560,6 +625,7 @@ private:
 		exec_only_ids.reset();
 		st = rspamd_mempool_alloc0_shared_type(pool, std::remove_pointer_t<decltype(st)>);
 		cd = rspamd_mempool_alloc0_shared_type(pool, std::remove_pointer_t<decltype(cd)>);
+		alloc_cd = rspamd_mempool_alloc0_shared_type(pool, std::remove_pointer_t<decltype(alloc_cd)>);
 	}
 };
 
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "lua/lua_common.h"
 #include "symcache_internal.hxx"
 #include "symcache_item.hxx"
 #include "symcache_runtime.hxx"
@@ -24,9 +25,52 @@
 #include "libserver/worker_util.h"
 #include <limits>
 #include <cmath>
+#include <signal.h>
+#include <sys/time.h>
 
 namespace rspamd::symcache {
 
+/*
+ * Shared stat block of the symbol whose synchronous part is being executed;
+ * read from the SIGPROF handler, so it must be a plain volatile pointer
+ */
+static struct rspamd_symcache_item_stat *volatile cpu_sampler_cur_st = nullptr;
+
+static void
+cpu_sampler_tick(int)
+{
+	auto *st = cpu_sampler_cur_st;
+
+	if (st != nullptr) {
+		/* Counters are in shared memory, so avoid losing ticks of other workers */
+		__atomic_fetch_add(&st->profile_samples, (uint64_t) 1, __ATOMIC_RELAXED);
+	}
+}
+
+auto activate_cpu_sampler(unsigned int hz) -> bool
+{
+	struct sigaction sa;
+	struct itimerval tv;
+
+	hz = MIN(MAX(hz, 1U), 1000U);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = cpu_sampler_tick;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(SIGPROF, &sa, nullptr) == -1) {
+		return false;
+	}
+
+	memset(&tv, 0, sizeof(tv));
+	tv.it_interval.tv_sec = (1000000U / hz) / 1000000U;
+	tv.it_interval.tv_usec = (1000000U / hz) % 1000000U;
+	tv.it_value = tv.it_interval;
+
+	return setitimer(ITIMER_PROF, &tv, nullptr) != -1;
+}
+
 /* At least once per minute */
 constexpr static const auto PROFILE_MAX_TIME = 60.0;
 /* For messages larger than 2Mb enable profiling */
@@ -34,6 +78,19 @@ constexpr static const auto PROFILE_MESSAGE_SIZE_THRESHOLD = 1024ul * 1024 * 2;
 /* Enable profile at least once per this amount of messages processed */
 constexpr static const auto PROFILE_PROBABILITY = 0.01;
 
+/*
+ * Bytes currently held by the Lua allocator; deltas around a callback
+ * attribute allocation pressure to the specific rule
+ */
+static auto
+lua_allocated_bytes(struct rspamd_task *task) -> std::int64_t
+{
+	auto *L = (lua_State *) task->cfg->lua_state;
+
+	return (std::int64_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 +
+		   lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
 auto symcache_runtime::create(struct rspamd_task *task, symcache &cache) -> symcache_runtime *
 {
 	cache.maybe_resort();
@@ -52,6 +109,16 @@ auto symcache_runtime::create(struct rspamd_task *task, symcache &cache) -> symc
 	checkpoint->profile_start = now;
 	checkpoint->lim = rspamd_task_get_required_score(task, task->result);
 
+	if (task->cfg->task_timeout > 0) {
+		checkpoint->deadline = now + task->cfg->task_timeout;
+	}
+
+	if (G_UNLIKELY(RSPAMD_TASK_IS_PROFILING(task))) {
+		checkpoint->trace_ring = (struct cache_trace_entry *)
+			rspamd_mempool_alloc0(task->task_pool,
+								  sizeof(struct cache_trace_entry) * trace_ring_size);
+	}
+
 	/*
 	 * We enable profiling if the following conditions are met:
 	 * - we have not profiled for a long time
@@ -264,7 +331,8 @@ auto symcache_runtime::is_symbol_enabled(struct rspamd_task *task, const symcach
 				}
 
 				if (!item->is_virtual()) {
-					return std::get<normal_item>(item->specific).check_conditions(item->symbol, task);
+					return item->check_guards(task) &&
+						   std::get<normal_item>(item->specific).check_conditions(item->symbol, task);
 				}
 			}
 			else {
@@ -396,10 +464,21 @@ auto symcache_runtime::process_filters(struct rspamd_task *task, symcache &cache
 	auto all_done = true;
 	auto log_func = RSPAMD_LOG_FUNC;
 	auto has_passtrough = false;
+	auto remain_msec = std::numeric_limits<double>::max();
+
+	if (deadline > 0.0) {
+		ev_now_update_if_cheap(task->event_loop);
+		remain_msec = (deadline - ev_now(task->event_loop)) * 1e3;
+	}
 
-	for (const auto [idx, item]: rspamd::enumerate(order->d)) {
+	/*
+	 * Iterate over the flattened hot view to avoid chasing shared_ptr
+	 * allocations on the scheduling fast path; the full item is touched
+	 * merely when a symbol is actually executed
+	 */
+	for (const auto [idx, hot_view]: rspamd::enumerate(order->hot)) {
 		/* Exclude all non filters */
-		if (item->type != symcache_item_type::FILTER) {
+		if (hot_view.type != symcache_item_type::FILTER) {
 			/*
 			 * We use breaking the loop as we append non-filters to the end of the list
 			 * so, it is safe to stop processing immediately
@@ -409,7 +488,7 @@ auto symcache_runtime::process_filters(struct rspamd_task *task, symcache &cache
 
 		auto check_result = check_process_status(task);
 
-		if (!(item->flags & (SYMBOL_TYPE_FINE | SYMBOL_TYPE_IGNORE_PASSTHROUGH))) {
+		if (!(hot_view.flags & (SYMBOL_TYPE_FINE | SYMBOL_TYPE_IGNORE_PASSTHROUGH))) {
 			if (has_passtrough || check_result == check_status::passthrough) {
 				msg_debug_cache_task_lambda("task has already the passthrough result being set, ignore further checks");
 				has_passtrough = true;
@@ -428,7 +507,34 @@ auto symcache_runtime::process_filters(struct rspamd_task *task, symcache &cache
 		if (dyn_item->status == cache_item_status::not_started) {
 			all_done = false;
 
-			if (!check_item_deps(task, cache, item.get(),
+			/* Slow path: resolve the full item */
+			auto *item = hot_view.item;
+
+			/*
+			 * Deadline awareness: when the remaining scan budget cannot
+			 * accommodate the expected cost of an optional symbol (EWMA of
+			 * its execution time), prune it instead of blowing the p99.
+			 * Symbols that may affect the final result flow are exempt.
+			 */
+			if (deadline > 0.0 &&
+				!(hot_view.flags & (SYMBOL_TYPE_FINE | SYMBOL_TYPE_IGNORE_PASSTHROUGH))) {
+				if (remain_msec <= 0 || item->st->avg_time > remain_msec) {
+					msg_debug_cache_task("skip %s(%d): expected cost %.2fms "
+										 "exceeds remaining budget %.2fms",
+										 item->symbol.c_str(), item->id,
+										 item->st->avg_time, remain_msec);
+					dyn_item->status = cache_item_status::finished;
+					continue;
+				}
+			}
+
+			/*
+			 * Members of the ready-set (no dependency edges at all) are
+			 * dispatched straight away; the recursive graph walk is reserved
+			 * for items that do have dependencies
+			 */
+			if (hot_view.has_deps &&
+				!check_item_deps(task, cache, item,
 								 dyn_item, false)) {
 				msg_debug_cache_task("blocked execution of %d(%s) unless deps are "
 									 "resolved",
@@ -437,7 +543,7 @@ auto symcache_runtime::process_filters(struct rspamd_task *task, symcache &cache
 				continue;
 			}
 
-			process_symbol(task, cache, item.get(), dyn_item);
+			process_symbol(task, cache, item, dyn_item);
 
 			if (slow_status == slow_status::enabled) {
 				return false;
@@ -477,28 +583,46 @@ auto symcache_runtime::process_symbol(struct rspamd_task *task, symcache &cache,
 	/* Check has been started */
 	auto check = true;
 
-	if (!item->is_allowed(task, true) || !item->check_conditions(task)) {
+	if (!item->is_allowed(task, true) || !item->check_guards(task) ||
+		!item->check_conditions(task)) {
 		check = false;
 	}
 
 	if (check) {
 		dyn_item->status = cache_item_status::started;
+		trace_transition(task, item->id, cache_item_status::started);
 		msg_debug_cache_task("execute %s, %d; symbol type = %s", item->symbol.data(),
 							 item->id, item_type_to_str(item->type));
 
+		std::int64_t alloc_before = 0;
+
 		if (profile) {
 			ev_now_update_if_cheap(task->event_loop);
 			dyn_item->start_msec = (ev_now(task->event_loop) -
 									profile_start) *
 								   1e3;
+			alloc_before = lua_allocated_bytes(task);
 		}
 		dyn_item->async_events = 0;
 		cur_item = dyn_item;
 		items_inflight++;
 		/* Callback now must finalize itself */
 
+		cpu_sampler_cur_st = item->st;
+		auto called = item->call(task, dyn_item);
+		cpu_sampler_cur_st = nullptr;
 
-		if (item->call(task, dyn_item)) {
+		if (profile && rspamd_worker_is_scanner(task->worker)) {
+			/*
+			 * Merely the synchronous part of the callback is attributed;
+			 * GC runs can make the delta negative, so clamp it
+			 */
+			auto alloc_diff = lua_allocated_bytes(task) - alloc_before;
+			rspamd_set_counter(item->alloc_cd,
+							   alloc_diff > 0 ? (double) alloc_diff : 0.0);
+		}
+
+		if (called) {
 			cur_item = nullptr;
 
 			if (items_inflight == 0) {
@@ -741,6 +865,7 @@ auto symcache_runtime::finalize_item(struct rspamd_task *task, cache_dynamic_ite
 
 	msg_debug_cache_task("process finalize for item %s(%d)", item->symbol.c_str(), item->id);
 	dyn_item->status = cache_item_status::finished;
+	trace_transition(task, item->id, cache_item_status::finished);
 	items_inflight--;
 	cur_item = nullptr;
 
@@ -882,6 +1007,67 @@ auto symcache_runtime::process_item_rdeps(struct rspamd_task *task, cache_item *
 	}
 }
 
+auto symcache_runtime::trace_transition(struct rspamd_task *task, int id,
+										cache_item_status status) -> void
+{
+	if (G_LIKELY(trace_ring == nullptr)) {
+		return;
+	}
+
+	auto &entry = trace_ring[trace_pos++ & (trace_ring_size - 1)];
+	ev_now_update_if_cheap(task->event_loop);
+	entry.id = id;
+	entry.status = status;
+	entry.when_msec = (ev_now(task->event_loop) - profile_start) * 1e3;
+}
+
+auto symcache_runtime::export_trace(struct rspamd_task *task) -> ucl_object_t *
+{
+	if (trace_ring == nullptr || trace_pos == 0) {
+		return nullptr;
+	}
+
+	constexpr auto status_to_str = [](cache_item_status status) -> const char * {
+		switch (status) {
+		case cache_item_status::not_started:
+			return "not_started";
+		case cache_item_status::started:
+			return "started";
+		case cache_item_status::pending:
+			return "pending";
+		case cache_item_status::finished:
+			return "finished";
+		}
+
+		return "unknown";
+	};
+
+	auto *top = ucl_object_typed_new(UCL_ARRAY);
+	auto first = trace_pos > trace_ring_size ? trace_pos - trace_ring_size : 0U;
+
+	for (auto i = first; i < trace_pos; i++) {
+		const auto &entry = trace_ring[i & (trace_ring_size - 1)];
+		auto idx_maybe = rspamd::find_map(order->by_cache_id, entry.id);
+
+		if (!idx_maybe) {
+			continue;
+		}
+
+		const auto &item = order->d[idx_maybe.value()];
+		auto *obj = ucl_object_typed_new(UCL_OBJECT);
+		ucl_object_insert_key(obj,
+							  ucl_object_fromlstring(item->symbol.data(), item->symbol.size()),
+							  "symbol", 0, false);
+		ucl_object_insert_key(obj, ucl_object_fromstring(status_to_str(entry.status)),
+							  "state", 0, false);
+		ucl_object_insert_key(obj, ucl_object_fromdouble(entry.when_msec),
+							  "t", 0, false);
+		ucl_array_append(top, obj);
+	}
+
+	return top;
+}
+
 auto symcache_runtime::get_item_by_dynamic_item(cache_dynamic_item *dyn_item) const -> cache_item *
 {
 	auto idx = dyn_item - dynamic_items;
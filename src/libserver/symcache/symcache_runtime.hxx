@@ -51,6 +51,16 @@ struct cache_dynamic_item {
 static_assert(sizeof(cache_dynamic_item) == sizeof(std::uint64_t));
 static_assert(std::is_trivial_v<cache_dynamic_item>);
 
+/**
+ * A single entry of the per-task scan trace: which item changed its state
+ * and when (milliseconds relative to the scan start)
+ */
+struct cache_trace_entry {
+	std::uint32_t id;
+	cache_item_status status;
+	float when_msec;
+};
+
 
 class symcache_runtime {
 	unsigned items_inflight;
@@ -69,8 +79,18 @@ class symcache_runtime {
 
 	double profile_start;
 	double lim;
+	/* Absolute scan deadline (ev time); 0.0 if no budget is enforced */
+	double deadline;
 
 	struct cache_dynamic_item *cur_item;
+	/*
+	 * Fixed size trace ring allocated from the task pool for profiled scans
+	 * only (nullptr otherwise); records scheduling transitions so latency
+	 * outliers can be analysed without debug logs
+	 */
+	struct cache_trace_entry *trace_ring;
+	unsigned int trace_pos;
+	static constexpr auto trace_ring_size = 128U;
 	order_generation_ptr order;
 	/* Dynamically expanded as needed */
 	mutable struct cache_dynamic_item dynamic_items[];
@@ -207,6 +227,23 @@ public:
 	 */
 	auto process_item_rdeps(struct rspamd_task *task, cache_item *item) -> void;
 
+	/**
+	 * Record a state transition of an item into the trace ring; a no-op
+	 * unless the scan is profiled
+	 * @param task
+	 * @param id item id
+	 * @param status new status
+	 */
+	auto trace_transition(struct rspamd_task *task, int id, cache_item_status status) -> void;
+
+	/**
+	 * Export the recorded trace as an UCL array (or nullptr if no trace
+	 * has been collected for this scan)
+	 * @param task
+	 * @return
+	 */
+	auto export_trace(struct rspamd_task *task) -> ucl_object_t *;
+
 	/* XXX: a helper to allow hiding internal implementation of the slow timer structure */
 	auto unset_slow() -> void
 	{
@@ -216,6 +253,13 @@ public:
 	}
 };
 
+/**
+ * Arm the SIGPROF based CPU sampler of the calling process: ticks are
+ * attributed to the symbol being executed via its shared stat block
+ * @param hz sampling frequency, clamped to [1, 1000]
+ * @return true if the timer has been armed
+ */
+auto activate_cpu_sampler(unsigned int hz) -> bool;
 
 }// namespace rspamd::symcache
 
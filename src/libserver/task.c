@@ -27,6 +27,7 @@
 #include "utlist.h"
 #include "libserver/mempool_vars_internal.h"
 #include "libserver/cfg_file_private.h"
+#include "libutil/hash.h"
 #include "libmime/lang_detection.h"
 #include "libmime/scan_result_private.h"
 #include "lua/lua_classnames.h"
@@ -661,6 +662,221 @@ rspamd_task_select_processing_stage(struct rspamd_task *task, unsigned int stage
 	return RSPAMD_TASK_STAGE_DONE;
 }
 
+/*
+ * Accounts wall clock time spent in the previous processing stage, including
+ * all async events awaited before the stage could have been passed; used
+ * merely for profiled tasks
+ */
+static void
+rspamd_task_profile_stage(struct rspamd_task *task, unsigned int st)
+{
+	GHashTable *tbl;
+	double now, *pval;
+	const char *name;
+
+	if (st == task->profile_stage) {
+		return;
+	}
+
+	now = rspamd_get_ticks(FALSE);
+
+	if (task->profile_stage != 0) {
+		tbl = rspamd_mempool_get_variable(task->task_pool,
+										  RSPAMD_MEMPOOL_STAGES_PROFILE);
+
+		if (tbl == NULL) {
+			tbl = g_hash_table_new(rspamd_str_hash, rspamd_str_equal);
+			rspamd_mempool_set_variable(task->task_pool,
+										RSPAMD_MEMPOOL_STAGES_PROFILE,
+										tbl,
+										(rspamd_mempool_destruct_t) g_hash_table_unref);
+		}
+
+		name = rspamd_task_stage_name(task->profile_stage);
+		pval = g_hash_table_lookup(tbl, name);
+
+		if (pval == NULL) {
+			pval = rspamd_mempool_alloc(task->task_pool, sizeof(*pval));
+			*pval = 0.0;
+			g_hash_table_insert(tbl, (gpointer) name, pval);
+		}
+
+		*pval += now - task->profile_stage_ticks;
+	}
+
+	task->profile_stage = st;
+	task->profile_stage_ticks = now;
+}
+
+/*
+ * Cache of recent verdicts keyed by the whole message digest: the same message
+ * delivered to many recipients can replay the symbols of the first scan
+ * instead of running the filters again; workers are single threaded, hence a
+ * static cache is safe. Symbol options are not cached, merely names and
+ * weights
+ */
+#define VERDICT_CACHE_KEYLEN 16
+
+struct rspamd_cached_symbol {
+	char *name;
+	double weight;
+};
+
+struct rspamd_cached_verdict {
+	unsigned int nsyms;
+	struct rspamd_cached_symbol syms[];
+};
+
+static guint
+rspamd_verdict_cache_hash(gconstpointer p)
+{
+	return (guint) rspamd_cryptobox_fast_hash(p, VERDICT_CACHE_KEYLEN,
+											  rspamd_hash_seed());
+}
+
+static gboolean
+rspamd_verdict_cache_equal(gconstpointer a, gconstpointer b)
+{
+	return memcmp(a, b, VERDICT_CACHE_KEYLEN) == 0;
+}
+
+static void
+rspamd_verdict_cache_elt_dtor(gpointer p)
+{
+	struct rspamd_cached_verdict *cached = p;
+	unsigned int i;
+
+	for (i = 0; i < cached->nsyms; i++) {
+		g_free(cached->syms[i].name);
+	}
+
+	g_free(cached);
+}
+
+static rspamd_lru_hash_t *
+rspamd_task_verdict_cache(struct rspamd_config *cfg)
+{
+	static rspamd_lru_hash_t *cache = NULL;
+
+	if (cache == NULL) {
+		cache = rspamd_lru_hash_new_full(cfg->verdict_cache_size,
+										 g_free, rspamd_verdict_cache_elt_dtor,
+										 rspamd_verdict_cache_hash,
+										 rspamd_verdict_cache_equal);
+	}
+
+	return cache;
+}
+
+static gboolean
+rspamd_task_verdict_cacheable(struct rspamd_task *task)
+{
+	if (task->cfg == NULL || task->cfg->verdict_cache_size == 0 ||
+		task->message == NULL) {
+		return FALSE;
+	}
+
+	/* Authenticated senders and per user settings change scoring */
+	if (task->auth_user != NULL || task->settings != NULL) {
+		return FALSE;
+	}
+
+	if (task->flags & (RSPAMD_TASK_FLAG_SKIP | RSPAMD_TASK_FLAG_GTUBE |
+					   RSPAMD_TASK_FLAG_LEARN_SPAM | RSPAMD_TASK_FLAG_LEARN_HAM)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Try to replay a recently cached verdict for the message; returns TRUE on
+ * hit, when the filters and classifiers stages can be skipped entirely
+ */
+static gboolean
+rspamd_task_verdict_cache_check(struct rspamd_task *task)
+{
+	struct rspamd_cached_verdict *cached;
+	unsigned int i;
+
+	if (!rspamd_task_verdict_cacheable(task)) {
+		return FALSE;
+	}
+
+	/* The filters stage can be entered multiple times, check merely once */
+	if (rspamd_mempool_get_variable(task->task_pool,
+									RSPAMD_MEMPOOL_VERDICT_CACHE) != NULL) {
+		return FALSE;
+	}
+
+	rspamd_mempool_set_variable(task->task_pool, RSPAMD_MEMPOOL_VERDICT_CACHE,
+								task, NULL);
+
+	cached = rspamd_lru_hash_lookup(rspamd_task_verdict_cache(task->cfg),
+									MESSAGE_FIELD(task, digest), time(NULL));
+
+	if (cached == NULL) {
+		return FALSE;
+	}
+
+	for (i = 0; i < cached->nsyms; i++) {
+		rspamd_task_insert_result(task, cached->syms[i].name,
+								  cached->syms[i].weight, NULL);
+	}
+
+	msg_info_task("replayed cached verdict: %ud symbols", cached->nsyms);
+
+	return TRUE;
+}
+
+static void
+rspamd_task_verdict_cache_store(struct rspamd_task *task)
+{
+	struct rspamd_cached_verdict *cached;
+	struct rspamd_symbol_result *s;
+	unsigned char *key;
+	unsigned int nsyms = 0, i = 0;
+
+	if (!rspamd_task_verdict_cacheable(task) || task->result == NULL) {
+		return;
+	}
+
+	if (rspamd_lru_hash_lookup(rspamd_task_verdict_cache(task->cfg),
+							   MESSAGE_FIELD(task, digest), time(NULL)) != NULL) {
+		return;
+	}
+
+	kh_foreach_value(task->result->symbols, s, {
+		if (!(s->flags & RSPAMD_SYMBOL_RESULT_IGNORED)) {
+			nsyms++;
+		}
+	});
+
+	cached = g_malloc(sizeof(*cached) + nsyms * sizeof(cached->syms[0]));
+	cached->nsyms = nsyms;
+
+	kh_foreach_value(task->result->symbols, s, {
+		if (!(s->flags & RSPAMD_SYMBOL_RESULT_IGNORED)) {
+			cached->syms[i].name = g_strdup(s->name);
+
+			/* Insertion multiplies by the static weight, store the raw one */
+			if (s->sym != NULL && isnormal(*s->sym->weight_ptr)) {
+				cached->syms[i].weight = s->score / (*s->sym->weight_ptr);
+			}
+			else {
+				cached->syms[i].weight = s->score;
+			}
+
+			i++;
+		}
+	});
+
+	key = g_malloc(VERDICT_CACHE_KEYLEN);
+	memcpy(key, MESSAGE_FIELD(task, digest), VERDICT_CACHE_KEYLEN);
+	rspamd_lru_hash_insert(rspamd_task_verdict_cache(task->cfg), key, cached,
+						   time(NULL), (time_t) task->cfg->verdict_cache_ttl);
+}
+
 gboolean
 rspamd_task_process(struct rspamd_task *task, unsigned int stages)
 {
@@ -681,6 +897,10 @@ rspamd_task_process(struct rspamd_task *task, unsigned int stages)
 
 	st = rspamd_task_select_processing_stage(task, stages);
 
+	if (RSPAMD_TASK_IS_PROFILING(task)) {
+		rspamd_task_profile_stage(task, st);
+	}
+
 	switch (st) {
 	case RSPAMD_TASK_STAGE_CONNFILTERS:
 		all_done = rspamd_symcache_process_symbols(task, task->cfg->cache, st);
@@ -699,10 +919,21 @@ rspamd_task_process(struct rspamd_task *task, unsigned int stages)
 		break;
 
 	case RSPAMD_TASK_STAGE_PRE_FILTERS:
-	case RSPAMD_TASK_STAGE_FILTERS:
 		all_done = rspamd_symcache_process_symbols(task, task->cfg->cache, st);
 		break;
 
+	case RSPAMD_TASK_STAGE_FILTERS:
+		if (rspamd_task_verdict_cache_check(task)) {
+			/* Classifiers symbols are cached along with the rest */
+			task->processed_stages |= RSPAMD_TASK_STAGE_CLASSIFIERS_PRE |
+									  RSPAMD_TASK_STAGE_CLASSIFIERS |
+									  RSPAMD_TASK_STAGE_CLASSIFIERS_POST;
+		}
+		else {
+			all_done = rspamd_symcache_process_symbols(task, task->cfg->cache, st);
+		}
+		break;
+
 	case RSPAMD_TASK_STAGE_CLASSIFIERS:
 	case RSPAMD_TASK_STAGE_CLASSIFIERS_PRE:
 	case RSPAMD_TASK_STAGE_CLASSIFIERS_POST:
@@ -716,6 +947,7 @@ rspamd_task_process(struct rspamd_task *task, unsigned int stages)
 		break;
 
 	case RSPAMD_TASK_STAGE_COMPOSITES:
+		rspamd_task_verdict_cache_store(task);
 		rspamd_composites_process_task(task);
 		task->result->nresults_postfilters = task->result->nresults;
 		break;
@@ -1116,7 +1348,7 @@ rspamd_task_log_metric_res(struct rspamd_task *task,
 				if (lf->flags & RSPAMD_LOG_FMT_FLAG_SYMBOLS_PARAMS) {
 					rspamd_printf_fstring(&symbuf, "{");
 
-					if (sym->options) {
+					if (sym->opts_head) {
 						struct rspamd_symbol_option *opt;
 
 						j = 0;
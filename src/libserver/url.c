@@ -16,6 +16,7 @@
 
 #include "config.h"
 #include "url.h"
+#include "url_tld_dfa.h"
 #include "util.h"
 #include "rspamd.h"
 #include "message.h"
@@ -242,6 +243,7 @@ struct url_match_scanner {
 	GArray *matchers_strict;
 	struct rspamd_multipattern *search_trie_full;
 	struct rspamd_multipattern *search_trie_strict;
+	struct rspamd_tld_dfa *tld_dfa;
 	bool has_tld_file;
 };
 
@@ -529,6 +531,7 @@ void rspamd_url_deinit(void)
 
 		rspamd_multipattern_destroy(url_scanner->search_trie_strict);
 		g_array_free(url_scanner->matchers_strict, TRUE);
+		rspamd_tld_dfa_unload(url_scanner->tld_dfa);
 		g_free(url_scanner);
 
 		url_scanner = NULL;
@@ -546,6 +549,7 @@ void rspamd_url_init(const char *tld_file)
 	}
 
 	url_scanner = g_malloc(sizeof(struct url_match_scanner));
+	url_scanner->tld_dfa = NULL;
 
 	url_scanner->matchers_strict = g_array_sized_new(FALSE, TRUE,
 													 sizeof(struct url_matcher), G_N_ELEMENTS(static_matchers));
@@ -575,6 +579,32 @@ void rspamd_url_init(const char *tld_file)
 		if (ret) {
 			url_scanner->has_tld_file = true;
 		}
+
+		/*
+		 * A compiled companion produced by `rspamadm tldcompile` serves the
+		 * per-lookup tld resolution; the text file still feeds the search
+		 * trie used to find urls in text
+		 */
+		char dfa_path[PATH_MAX];
+		struct stat st_tld, st_dfa;
+
+		rspamd_snprintf(dfa_path, sizeof(dfa_path), "%s.dfa", tld_file);
+
+		if (stat(dfa_path, &st_dfa) != -1 && stat(tld_file, &st_tld) != -1 &&
+			st_dfa.st_mtime >= st_tld.st_mtime) {
+			GError *dfa_err = NULL;
+
+			url_scanner->tld_dfa = rspamd_tld_dfa_load(dfa_path, &dfa_err);
+
+			if (url_scanner->tld_dfa == NULL) {
+				msg_warn("cannot use compiled TLD DFA %s: %e", dfa_path,
+						 dfa_err);
+				g_error_free(dfa_err);
+			}
+			else {
+				msg_info("loaded compiled TLD DFA from %s", dfa_path);
+			}
+		}
 	}
 
 	if (url_scanner->matchers_full && url_scanner->matchers_full->len > 1000) {
@@ -686,6 +716,71 @@ static const unsigned int max_domain_length = 253;
 static const unsigned int max_dns_label = 63;
 static const unsigned int max_email_user = 64;
 
+/*
+ * Bulk-skip classes for the hot states of the web parser: a character in
+ * the class is consumed by the corresponding state with no side effects,
+ * so a run of them can be swallowed with a single table lookup per byte
+ * instead of a trip through the state machine branches
+ */
+enum {
+	SKIP_HOST = (1 << 0),
+	SKIP_PATH = (1 << 1),
+	SKIP_QUERY = (1 << 2),
+	SKIP_PART = (1 << 3),
+};
+
+static unsigned char url_skip_table[256];
+/* Bytes consumed via bulk skips and in total, to monitor the slow path rate */
+static uint64_t url_parse_spanned_bytes = 0;
+static uint64_t url_parse_total_bytes = 0;
+
+static void
+rspamd_url_skip_table_init(void)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		char c = (char) i;
+		unsigned char cls = 0;
+
+		if (i < 0x80 && (g_ascii_isalnum(c) ||
+						 c == '.' || c == '-' || c == '_' || c == '%')) {
+			cls |= SKIP_HOST;
+		}
+		if (!(c == '?' || c == '#' || is_url_end(c) || is_lwsp(c))) {
+			cls |= SKIP_PATH;
+		}
+		if (!(c == '#' || is_url_end(c) || is_lwsp(c))) {
+			cls |= SKIP_QUERY;
+		}
+		if (!(is_url_end(c) || is_lwsp(c))) {
+			cls |= SKIP_PART;
+		}
+
+		url_skip_table[i] = cls;
+	}
+}
+
+static inline const char *
+rspamd_url_skip_span(const char *p, const char *last, unsigned char cls)
+{
+	while (p < last && (url_skip_table[(unsigned char) *p] & cls)) {
+		p++;
+	}
+
+	return p;
+}
+
+void rspamd_url_parse_counters(uint64_t *spanned, uint64_t *total)
+{
+	if (spanned) {
+		*spanned = url_parse_spanned_bytes;
+	}
+	if (total) {
+		*total = url_parse_total_bytes;
+	}
+}
+
 static int
 rspamd_mailto_parse(struct http_parser_url *u,
 					const char *str, gsize len,
@@ -1053,6 +1148,13 @@ rspamd_web_parse(struct http_parser_url *u, const char *str, gsize len,
 		memset(u, 0, sizeof(*u));
 	}
 
+	/* 'a' belongs to every class, so zero means the table is not yet built */
+	if (G_UNLIKELY(url_skip_table['a'] == 0)) {
+		rspamd_url_skip_table_init();
+	}
+
+	url_parse_total_bytes += len;
+
 	while (p < last) {
 		t = *p;
 
@@ -1292,6 +1394,20 @@ rspamd_web_parse(struct http_parser_url *u, const char *str, gsize len,
 				/* Too large domain */
 				goto out;
 			}
+			if (url_skip_table[(unsigned char) t] & SKIP_HOST) {
+				const char *sp = rspamd_url_skip_span(p, last, SKIP_HOST);
+
+				/* The length limit above is checked once per byte */
+				if (sp - c > max_domain_length + 1) {
+					sp = c + max_domain_length + 1;
+				}
+
+				if (sp > p + 1) {
+					url_parse_spanned_bytes += sp - p;
+					p = sp;
+					continue;
+				}
+			}
 			if (t == '/' || t == '\\' || t == ':' || t == '?' || t == '#') {
 				if (p - c == 0) {
 					goto out;
@@ -1508,6 +1624,15 @@ rspamd_web_parse(struct http_parser_url *u, const char *str, gsize len,
 			}
 			break;
 		case parse_path:
+			if (url_skip_table[(unsigned char) t] & SKIP_PATH) {
+				const char *sp = rspamd_url_skip_span(p, last, SKIP_PATH);
+
+				if (sp > p + 1) {
+					url_parse_spanned_bytes += sp - p;
+					p = sp;
+					continue;
+				}
+			}
 			if (t == '?') {
 				if (p - c != 0) {
 					SET_U(u, UF_PATH);
@@ -1540,6 +1665,15 @@ rspamd_web_parse(struct http_parser_url *u, const char *str, gsize len,
 			p++;
 			break;
 		case parse_query:
+			if (url_skip_table[(unsigned char) t] & SKIP_QUERY) {
+				const char *sp = rspamd_url_skip_span(p, last, SKIP_QUERY);
+
+				if (sp > p + 1) {
+					url_parse_spanned_bytes += sp - p;
+					p = sp;
+					continue;
+				}
+			}
 			if (t == '#') {
 				if (p - c != 0) {
 					SET_U(u, UF_QUERY);
@@ -1564,6 +1698,15 @@ rspamd_web_parse(struct http_parser_url *u, const char *str, gsize len,
 			p++;
 			break;
 		case parse_part:
+			if (url_skip_table[(unsigned char) t] & SKIP_PART) {
+				const char *sp = rspamd_url_skip_span(p, last, SKIP_PART);
+
+				if (sp > p + 1) {
+					url_parse_spanned_bytes += sp - p;
+					p = sp;
+					continue;
+				}
+			}
 			if (!(parse_flags & RSPAMD_URL_PARSE_HREF) && is_url_end(t)) {
 				goto set;
 			}
@@ -2656,6 +2799,10 @@ rspamd_url_find_tld(const char *in, gsize inlen, rspamd_ftok_t *out)
 	g_assert(out != NULL);
 	g_assert(url_scanner != NULL);
 
+	if (url_scanner->tld_dfa) {
+		return rspamd_tld_dfa_search(url_scanner->tld_dfa, in, inlen, out);
+	}
+
 	cbdata.begin = in;
 	cbdata.len = inlen;
 	cbdata.out = out;
@@ -3782,6 +3929,86 @@ rspamd_url_host_hash(struct rspamd_url *url)
 	return 0;
 }
 
+void rspamd_url_get_digests(struct rspamd_url *u,
+							struct rspamd_url_digests *out)
+{
+	rspamd_cryptobox_fast_hash_state_t full_st, host_st, tld_st;
+	uint64_t seed = rspamd_hash_seed();
+	gsize cuts[6], tmp;
+	gsize hs = 0, he = 0, ts = 0, te = 0;
+	unsigned int i, j, ncuts = 0;
+
+	memset(out, 0, sizeof(*out));
+
+	if (u->urllen == 0) {
+		return;
+	}
+
+	if (u->hostlen > 0) {
+		hs = u->hostshift;
+		he = hs + u->hostlen;
+	}
+	if (u->tldlen > 0) {
+		ts = u->tldshift;
+		te = ts + u->tldlen;
+	}
+
+	rspamd_cryptobox_fast_hash_init(&full_st, seed);
+	rspamd_cryptobox_fast_hash_init(&host_st, seed);
+	rspamd_cryptobox_fast_hash_init(&tld_st, seed);
+
+	/*
+	 * Split the string at the part boundaries and feed each chunk to every
+	 * digest it belongs to, so the whole url is traversed merely once even
+	 * though three digests are produced
+	 */
+	cuts[ncuts++] = 0;
+	cuts[ncuts++] = u->urllen;
+
+	if (he > hs) {
+		cuts[ncuts++] = hs;
+		cuts[ncuts++] = he;
+	}
+	if (te > ts) {
+		cuts[ncuts++] = ts;
+		cuts[ncuts++] = te;
+	}
+
+	for (i = 1; i < ncuts; i++) {
+		for (j = i; j > 0 && cuts[j - 1] > cuts[j]; j--) {
+			tmp = cuts[j];
+			cuts[j] = cuts[j - 1];
+			cuts[j - 1] = tmp;
+		}
+	}
+
+	for (i = 1; i < ncuts; i++) {
+		gsize a = cuts[i - 1], b = cuts[i];
+
+		if (a == b || b > u->urllen) {
+			continue;
+		}
+
+		rspamd_cryptobox_fast_hash_update(&full_st, u->string + a, b - a);
+
+		if (he > hs && a >= hs && b <= he) {
+			rspamd_cryptobox_fast_hash_update(&host_st, u->string + a, b - a);
+		}
+		if (te > ts && a >= ts && b <= te) {
+			rspamd_cryptobox_fast_hash_update(&tld_st, u->string + a, b - a);
+		}
+	}
+
+	out->full_digest = rspamd_cryptobox_fast_hash_final(&full_st);
+
+	if (he > hs) {
+		out->host_digest = rspamd_cryptobox_fast_hash_final(&host_st);
+	}
+	if (te > ts) {
+		out->tld_digest = rspamd_cryptobox_fast_hash_final(&tld_st);
+	}
+}
+
 /* Compare two emails for building emails tree */
 static inline bool
 rspamd_emails_cmp(struct rspamd_url *u1, struct rspamd_url *u2)
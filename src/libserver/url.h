@@ -192,6 +192,33 @@ enum uri_errno rspamd_url_parse(struct rspamd_url *uri,
 								rspamd_mempool_t *pool,
 								enum rspamd_url_parse_flags flags);
 
+/*
+ * Obtain counters of bytes consumed by the bulk character-class skip in the
+ * url parser and of bytes parsed in total; the difference is what went
+ * through the slow per-state branches
+ * @param spanned storage for the bulk-skipped bytes counter (or NULL)
+ * @param total storage for the total parsed bytes counter (or NULL)
+ */
+void rspamd_url_parse_counters(uint64_t *spanned, uint64_t *total);
+
+/**
+ * Fast digests of the parts of a url that are commonly used as lookup keys
+ */
+struct rspamd_url_digests {
+	uint64_t full_digest; /* The whole normalised url */
+	uint64_t host_digest; /* Host part, zero if there is no host */
+	uint64_t tld_digest;  /* eTLD+1 part, zero if there is no tld */
+};
+
+/*
+ * Derive the full, host and tld digests of a url in a single traversal of
+ * its string instead of three separate hashing passes
+ * @param u url object
+ * @param out storage for the digests
+ */
+void rspamd_url_get_digests(struct rspamd_url *u,
+							struct rspamd_url_digests *out);
+
 /*
  * Try to extract url from a text
  * @param pool memory pool
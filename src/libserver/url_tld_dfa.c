@@ -0,0 +1,519 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "url_tld_dfa.h"
+#include "libutil/util.h"
+#include "unix-std.h"
+
+/*
+ * The blob stores a DFA over the reversed, lowercased suffixes from the
+ * publicsuffix list: a lookup walks the hostname from its last byte towards
+ * the start, so common endings (".com", ".co.uk") share DFA prefixes, and
+ * isomorphic subtrees are merged during compilation, which makes the
+ * automaton minimal for the (finite) suffix language. Nodes keep their
+ * edges as sorted 4-byte words, hence a transition is a binary search over
+ * at most a handful of cache lines.
+ */
+
+#define TLD_DFA_MAGIC "rstlddfa"
+#define TLD_DFA_VERSION 1u
+/* Node targets are packed into 24 bits of an edge word */
+#define TLD_DFA_MAX_NODES (1u << 24u)
+
+#define TLD_DFA_FLAG_ACCEPT (1u << 0u)
+#define TLD_DFA_FLAG_STAR (1u << 1u)
+
+struct rspamd_tld_dfa_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nnodes;
+	uint32_t nedges;
+	uint32_t root;
+};
+
+struct rspamd_tld_dfa_node {
+	uint32_t edge_off;
+	uint16_t nedges;
+	uint16_t flags;
+};
+
+struct rspamd_tld_dfa {
+	gpointer map;
+	gsize size;
+	const struct rspamd_tld_dfa_node *nodes;
+	const uint32_t *edges;
+	uint32_t nnodes;
+	uint32_t nedges;
+	uint32_t root;
+};
+
+static GQuark
+rspamd_tld_dfa_quark(void)
+{
+	return g_quark_from_static_string("tld_dfa");
+}
+
+/* Builder side */
+
+struct tld_dfa_build_node;
+
+struct tld_dfa_build_edge {
+	uint8_t ch;
+	struct tld_dfa_build_node *child;
+};
+
+struct tld_dfa_build_node {
+	GArray *edges; /* of struct tld_dfa_build_edge, sorted by ch */
+	unsigned int flags;
+	int id; /* assigned when the node is made canonical */
+};
+
+static struct tld_dfa_build_node *
+tld_dfa_build_node_new(void)
+{
+	struct tld_dfa_build_node *node;
+
+	node = g_malloc0(sizeof(*node));
+	node->edges = g_array_new(FALSE, FALSE, sizeof(struct tld_dfa_build_edge));
+	node->id = -1;
+
+	return node;
+}
+
+static void
+tld_dfa_build_node_free(struct tld_dfa_build_node *node)
+{
+	g_array_free(node->edges, TRUE);
+	g_free(node);
+}
+
+static struct tld_dfa_build_node *
+tld_dfa_build_insert(struct tld_dfa_build_node *node, uint8_t ch)
+{
+	struct tld_dfa_build_edge *e, ne;
+	unsigned int i;
+
+	for (i = 0; i < node->edges->len; i++) {
+		e = &g_array_index(node->edges, struct tld_dfa_build_edge, i);
+
+		if (e->ch == ch) {
+			return e->child;
+		}
+		if (e->ch > ch) {
+			break;
+		}
+	}
+
+	ne.ch = ch;
+	ne.child = tld_dfa_build_node_new();
+	g_array_insert_val(node->edges, i, ne);
+
+	return ne.child;
+}
+
+/*
+ * Bottom-up hash consing: each distinct (flags, edges) combination is kept
+ * merely once, so equivalent suffix tails collapse into shared states
+ */
+static struct tld_dfa_build_node *
+tld_dfa_canonicalize(struct tld_dfa_build_node *node, GHashTable *uniq,
+					 GPtrArray *ordered)
+{
+	struct tld_dfa_build_edge *e;
+	struct tld_dfa_build_node *existing;
+	GByteArray *sig;
+	GBytes *key;
+	unsigned int i;
+	uint32_t w;
+
+	for (i = 0; i < node->edges->len; i++) {
+		e = &g_array_index(node->edges, struct tld_dfa_build_edge, i);
+		e->child = tld_dfa_canonicalize(e->child, uniq, ordered);
+	}
+
+	sig = g_byte_array_new();
+	w = node->flags;
+	g_byte_array_append(sig, (const uint8_t *) &w, sizeof(w));
+
+	for (i = 0; i < node->edges->len; i++) {
+		e = &g_array_index(node->edges, struct tld_dfa_build_edge, i);
+		w = ((uint32_t) e->child->id << 8u) | e->ch;
+		g_byte_array_append(sig, (const uint8_t *) &w, sizeof(w));
+	}
+
+	key = g_byte_array_free_to_bytes(sig);
+	existing = g_hash_table_lookup(uniq, key);
+
+	if (existing != NULL) {
+		g_bytes_unref(key);
+		tld_dfa_build_node_free(node);
+
+		return existing;
+	}
+
+	node->id = ordered->len;
+	g_ptr_array_add(ordered, node);
+	g_hash_table_insert(uniq, key, node);
+
+	return node;
+}
+
+gboolean
+rspamd_tld_dfa_compile(const char *tld_file, const char *out_file,
+					   GError **err)
+{
+	FILE *f;
+	struct tld_dfa_build_node *root, *cur, *node;
+	struct tld_dfa_build_edge *e;
+	struct rspamd_tld_dfa_header hdr;
+	struct rspamd_tld_dfa_node snode;
+	GHashTable *uniq;
+	GPtrArray *ordered;
+	GByteArray *nodes_blob, *edges_blob;
+	char *linebuf = NULL, *p;
+	gsize buflen = 0;
+	gssize r, i;
+	unsigned int flags, j, nedges = 0;
+	gboolean ret = TRUE;
+	uint32_t w;
+
+	f = fopen(tld_file, "r");
+
+	if (f == NULL) {
+		g_set_error(err, rspamd_tld_dfa_quark(), errno,
+					"cannot open TLD file %s: %s", tld_file, strerror(errno));
+		return FALSE;
+	}
+
+	root = tld_dfa_build_node_new();
+
+	while ((r = getline(&linebuf, &buflen, f)) > 0) {
+		if (linebuf[0] == '/' || g_ascii_isspace(linebuf[0])) {
+			/* Skip comment or empty line */
+			continue;
+		}
+
+		g_strchomp(linebuf);
+
+		/* The runtime parser ignores '!' exceptions as well */
+		if (linebuf[0] == '!') {
+			continue;
+		}
+
+		flags = TLD_DFA_FLAG_ACCEPT;
+
+		if (linebuf[0] == '*') {
+			flags |= TLD_DFA_FLAG_STAR;
+			p = strchr(linebuf, '.');
+
+			if (p == NULL) {
+				continue;
+			}
+			p++;
+		}
+		else {
+			p = linebuf;
+		}
+
+		if (*p == '\0') {
+			continue;
+		}
+
+		/* Insert the suffix reversed, so lookups walk from the end */
+		cur = root;
+
+		for (i = strlen(p) - 1; i >= 0; i--) {
+			cur = tld_dfa_build_insert(cur,
+									   (uint8_t) g_ascii_tolower(p[i]));
+		}
+
+		cur->flags |= flags;
+	}
+
+	free(linebuf);
+	fclose(f);
+
+	uniq = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+								 (GDestroyNotify) g_bytes_unref, NULL);
+	ordered = g_ptr_array_new();
+	root = tld_dfa_canonicalize(root, uniq, ordered);
+
+	if (ordered->len >= TLD_DFA_MAX_NODES) {
+		g_set_error(err, rspamd_tld_dfa_quark(), EINVAL,
+					"too many DFA nodes: %d", ordered->len);
+		ret = FALSE;
+		goto cleanup;
+	}
+
+	nodes_blob = g_byte_array_new();
+	edges_blob = g_byte_array_new();
+
+	for (j = 0; j < ordered->len; j++) {
+		node = g_ptr_array_index(ordered, j);
+
+		snode.edge_off = nedges;
+		snode.nedges = node->edges->len;
+		snode.flags = node->flags;
+		g_byte_array_append(nodes_blob, (const uint8_t *) &snode,
+							sizeof(snode));
+
+		for (unsigned int k = 0; k < node->edges->len; k++) {
+			e = &g_array_index(node->edges, struct tld_dfa_build_edge, k);
+			w = ((uint32_t) e->child->id << 8u) | e->ch;
+			g_byte_array_append(edges_blob, (const uint8_t *) &w, sizeof(w));
+		}
+
+		nedges += node->edges->len;
+	}
+
+	memcpy(hdr.magic, TLD_DFA_MAGIC, sizeof(hdr.magic));
+	hdr.version = TLD_DFA_VERSION;
+	hdr.nnodes = ordered->len;
+	hdr.nedges = nedges;
+	hdr.root = root->id;
+
+	f = fopen(out_file, "w");
+
+	if (f == NULL) {
+		g_set_error(err, rspamd_tld_dfa_quark(), errno,
+					"cannot open output file %s: %s", out_file,
+					strerror(errno));
+		ret = FALSE;
+	}
+	else {
+		if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+			(nodes_blob->len > 0 &&
+			 fwrite(nodes_blob->data, nodes_blob->len, 1, f) != 1) ||
+			(edges_blob->len > 0 &&
+			 fwrite(edges_blob->data, edges_blob->len, 1, f) != 1)) {
+			g_set_error(err, rspamd_tld_dfa_quark(), errno,
+						"cannot write %s: %s", out_file, strerror(errno));
+			ret = FALSE;
+			unlink(out_file);
+		}
+
+		fclose(f);
+	}
+
+	g_byte_array_free(nodes_blob, TRUE);
+	g_byte_array_free(edges_blob, TRUE);
+
+cleanup:
+	for (j = 0; j < ordered->len; j++) {
+		tld_dfa_build_node_free(g_ptr_array_index(ordered, j));
+	}
+
+	g_ptr_array_free(ordered, TRUE);
+	g_hash_table_unref(uniq);
+
+	return ret;
+}
+
+/* Runtime side */
+
+struct rspamd_tld_dfa *
+rspamd_tld_dfa_load(const char *fname, GError **err)
+{
+	struct rspamd_tld_dfa *dfa;
+	const struct rspamd_tld_dfa_header *hdr;
+	const struct rspamd_tld_dfa_node *node;
+	gpointer map;
+	gsize size;
+	uint32_t i, j, prev;
+
+	map = rspamd_file_xmap(fname, PROT_READ, &size, TRUE);
+
+	if (map == NULL) {
+		g_set_error(err, rspamd_tld_dfa_quark(), errno,
+					"cannot map %s: %s", fname, strerror(errno));
+		return NULL;
+	}
+
+	if (size < sizeof(*hdr)) {
+		g_set_error(err, rspamd_tld_dfa_quark(), EINVAL,
+					"truncated TLD DFA %s", fname);
+		munmap(map, size);
+		return NULL;
+	}
+
+	hdr = (const struct rspamd_tld_dfa_header *) map;
+
+	if (memcmp(hdr->magic, TLD_DFA_MAGIC, sizeof(hdr->magic)) != 0 ||
+		hdr->version != TLD_DFA_VERSION ||
+		hdr->nnodes == 0 || hdr->nnodes >= TLD_DFA_MAX_NODES ||
+		hdr->root >= hdr->nnodes ||
+		size != sizeof(*hdr) +
+					hdr->nnodes * sizeof(struct rspamd_tld_dfa_node) +
+					hdr->nedges * sizeof(uint32_t)) {
+		g_set_error(err, rspamd_tld_dfa_quark(), EINVAL,
+					"invalid TLD DFA %s", fname);
+		munmap(map, size);
+		return NULL;
+	}
+
+	dfa = g_malloc0(sizeof(*dfa));
+	dfa->map = map;
+	dfa->size = size;
+	dfa->nnodes = hdr->nnodes;
+	dfa->nedges = hdr->nedges;
+	dfa->root = hdr->root;
+	dfa->nodes = (const struct rspamd_tld_dfa_node *) (hdr + 1);
+	dfa->edges = (const uint32_t *) (dfa->nodes + dfa->nnodes);
+
+	/* Full structural validation, done merely once at load time */
+	for (i = 0; i < dfa->nnodes; i++) {
+		node = &dfa->nodes[i];
+
+		if ((gsize) node->edge_off + node->nedges > dfa->nedges) {
+			goto invalid;
+		}
+
+		prev = 0;
+
+		for (j = 0; j < node->nedges; j++) {
+			uint32_t w = dfa->edges[node->edge_off + j];
+
+			if ((w >> 8u) >= dfa->nnodes) {
+				goto invalid;
+			}
+			if (j > 0 && (w & 0xffu) <= prev) {
+				/* Edges must be strictly ordered for binary search */
+				goto invalid;
+			}
+
+			prev = w & 0xffu;
+		}
+	}
+
+	return dfa;
+
+invalid:
+	g_set_error(err, rspamd_tld_dfa_quark(), EINVAL,
+				"broken TLD DFA %s", fname);
+	munmap(map, size);
+	g_free(dfa);
+
+	return NULL;
+}
+
+void rspamd_tld_dfa_unload(struct rspamd_tld_dfa *dfa)
+{
+	if (dfa != NULL) {
+		munmap(dfa->map, dfa->size);
+		g_free(dfa);
+	}
+}
+
+gboolean
+rspamd_tld_dfa_search(const struct rspamd_tld_dfa *dfa,
+					  const char *in, gsize inlen,
+					  rspamd_ftok_t *out)
+{
+	const struct rspamd_tld_dfa_node *node;
+	const char *p, *match = NULL, *pos;
+	uint32_t cur, lo, hi, mid, w = 0;
+	uint8_t c;
+	int ndots;
+	gboolean star = FALSE;
+
+	g_assert(in != NULL);
+	g_assert(out != NULL);
+
+	out->len = 0;
+
+	if (inlen == 0) {
+		return FALSE;
+	}
+
+	cur = dfa->root;
+	p = in + inlen;
+
+	while (p > in) {
+		c = (uint8_t) g_ascii_tolower(p[-1]);
+		node = &dfa->nodes[cur];
+		lo = node->edge_off;
+		hi = lo + node->nedges;
+
+		while (lo < hi) {
+			mid = (lo + hi) / 2u;
+			w = dfa->edges[mid];
+
+			if ((w & 0xffu) < c) {
+				lo = mid + 1;
+			}
+			else {
+				hi = mid;
+			}
+		}
+
+		if (lo == node->edge_off + node->nedges ||
+			((dfa->edges[lo]) & 0xffu) != c) {
+			break;
+		}
+
+		cur = dfa->edges[lo] >> 8u;
+		p--;
+
+		if ((dfa->nodes[cur].flags & TLD_DFA_FLAG_ACCEPT) &&
+			(p == in || p[-1] == '.')) {
+			/* A label-aligned suffix; deeper matches overwrite shorter ones */
+			match = p;
+			star = (dfa->nodes[cur].flags & TLD_DFA_FLAG_STAR) != 0;
+		}
+	}
+
+	if (match == NULL) {
+		return FALSE;
+	}
+
+	if (match == in) {
+		/* The whole hostname is a public suffix */
+		out->begin = in;
+		out->len = inlen;
+
+		return TRUE;
+	}
+
+	/*
+	 * Extend the suffix with the registrable labels, mirroring
+	 * rspamd_tld_trie_find_callback: one extra label normally, two for
+	 * wildcard entries
+	 */
+	ndots = star ? 2 : 1;
+	p = match - 2; /* Before the dot that precedes the suffix */
+	pos = in;
+
+	while (p >= in && ndots > 0) {
+		if (*p == '.') {
+			ndots--;
+			pos = p + 1;
+		}
+		else {
+			pos = p;
+		}
+
+		p--;
+	}
+
+	if (ndots == 0 || p == in - 1) {
+		out->begin = pos;
+		out->len = in + inlen - pos;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
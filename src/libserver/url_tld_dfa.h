@@ -0,0 +1,76 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SRC_LIBSERVER_URL_TLD_DFA_H_
+#define SRC_LIBSERVER_URL_TLD_DFA_H_
+
+#include "config.h"
+#include "fstring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Public suffix matching over a precompiled minimal DFA. The DFA is built
+ * offline from a publicsuffix-style TLD file by `rspamadm tldcompile`,
+ * stored as a flat binary blob and mapped read-only by the workers, so the
+ * suffix set is shared between processes with no startup build cost.
+ */
+
+struct rspamd_tld_dfa;
+
+/**
+ * Compile a publicsuffix-style TLD file into a binary DFA blob
+ * @param tld_file input file in the publicsuffix list format
+ * @param out_file output blob path
+ * @param err storage for error
+ * @return TRUE if the blob has been written
+ */
+gboolean rspamd_tld_dfa_compile(const char *tld_file, const char *out_file,
+								GError **err);
+
+/**
+ * Map a compiled blob read-only and validate its structure
+ * @param fname blob path
+ * @param err storage for error
+ * @return DFA handle or NULL
+ */
+struct rspamd_tld_dfa *rspamd_tld_dfa_load(const char *fname, GError **err);
+
+/**
+ * Unmap a previously loaded DFA
+ * @param dfa DFA handle
+ */
+void rspamd_tld_dfa_unload(struct rspamd_tld_dfa *dfa);
+
+/**
+ * Search for an eTLD+1 part of a hostname, mirroring the semantics of
+ * rspamd_url_find_tld
+ * @param dfa DFA handle
+ * @param in hostname
+ * @param inlen length of hostname
+ * @param out storage for the tld part found
+ * @return TRUE if a tld part has been found
+ */
+gboolean rspamd_tld_dfa_search(const struct rspamd_tld_dfa *dfa,
+							   const char *in, gsize inlen,
+							   rspamd_ftok_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_LIBSERVER_URL_TLD_DFA_H_ */
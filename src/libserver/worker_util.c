@@ -41,6 +41,9 @@
 #ifdef HAVE_LIBUTIL_H
 #include <libutil.h>
 #endif
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
 #include "zlib.h"
 
 #ifdef HAVE_UCONTEXT_H
@@ -56,6 +59,7 @@
 #endif
 
 #include "contrib/libev/ev.h"
+#include "libutil/libev_helper.h"
 #include "libstat/stat_api.h"
 #include "libserver/protocol_internal.h"
 
@@ -1057,6 +1061,65 @@ rspamd_maybe_reuseport_socket(struct rspamd_worker_listen_socket *ls)
 	return true;
 }
 
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(LINUX)
+#define RSPAMD_MAX_NUMA_NODES 64
+
+/**
+ * Reads the cpu list of a NUMA node from sysfs (e.g. "0-7,16-23") filling
+ * `cs` if it is not NULL; returns FALSE if the node does not exist
+ */
+static gboolean
+rspamd_numa_node_cpuset(unsigned int node, cpu_set_t *cs)
+{
+	char path[PATH_MAX], buf[1024];
+	char *p, *endptr;
+	gssize len;
+
+	rspamd_snprintf(path, sizeof(path),
+					"/sys/devices/system/node/node%ud/cpulist", node);
+
+	if (cs == NULL) {
+		return access(path, R_OK) == 0;
+	}
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		return FALSE;
+	}
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (len <= 0) {
+		return FALSE;
+	}
+
+	buf[len] = '\0';
+	p = buf;
+
+	while (*p != '\0' && g_ascii_isdigit(*p)) {
+		long first = strtol(p, &endptr, 10), last = first;
+
+		if (*endptr == '-') {
+			last = strtol(endptr + 1, &endptr, 10);
+		}
+
+		for (long i = first; i <= last && i < CPU_SETSIZE; i++) {
+			CPU_SET(i, cs);
+		}
+
+		if (*endptr != ',') {
+			break;
+		}
+
+		p = endptr + 1;
+	}
+
+	return CPU_COUNT(cs) > 0;
+}
+#endif
+
 /**
  * Handles worker after fork returned zero
  * @param wrk
@@ -1153,6 +1216,68 @@ rspamd_handle_child_fork(struct rspamd_worker *wrk,
 		cur = g_list_next(cur);
 	}
 
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(LINUX)
+	/*
+	 * Pin the worker to all cores of a single NUMA node selected round-robin
+	 * by its index. Memory is not migrated explicitly: pools and caches are
+	 * allocated after fork, so first-touch places them on the local node
+	 */
+	if (cf->pin_to_node) {
+		unsigned int nnodes = 0, node;
+		cpu_set_t cs;
+
+		while (nnodes < RSPAMD_MAX_NUMA_NODES &&
+			   rspamd_numa_node_cpuset(nnodes, NULL)) {
+			nnodes++;
+		}
+
+		if (nnodes > 1) {
+			node = wrk->index % nnodes;
+			CPU_ZERO(&cs);
+
+			if (!rspamd_numa_node_cpuset(node, &cs) ||
+				sched_setaffinity(0, sizeof(cs), &cs) == -1) {
+				msg_warn_main("cannot pin %s process to NUMA node %d: %s",
+							  cf->worker->name, node, strerror(errno));
+			}
+			else {
+				msg_info_main("pinned %s process to NUMA node %d",
+							  cf->worker->name, node);
+			}
+		}
+	}
+#endif
+
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(HAVE_SC_NPROCESSORS_ONLN)
+	/*
+	 * Pin the worker to a single core selected round-robin by its index;
+	 * that keeps each reuseport socket served from the same core and
+	 * avoids cross-CPU migration of the scanning loop
+	 */
+	if (cf->pin_to_cpu) {
+		long ncores = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (ncores > 0) {
+			cpu_set_t cs;
+
+			CPU_ZERO(&cs);
+			CPU_SET(wrk->index % (unsigned int) ncores, &cs);
+
+			if (sched_setaffinity(0, sizeof(cs), &cs) == -1) {
+				msg_warn_main("cannot pin %s process to CPU %d: %s",
+							  cf->worker->name,
+							  (int) (wrk->index % (unsigned int) ncores),
+							  strerror(errno));
+			}
+			else {
+				msg_info_main("pinned %s process to CPU %d",
+							  cf->worker->name,
+							  (int) (wrk->index % (unsigned int) ncores));
+			}
+		}
+	}
+#endif
+
 	/* Drop privileges */
 	rspamd_worker_drop_priv(rspamd_main);
 	/* Set limits */
@@ -1309,6 +1434,9 @@ rspamd_fork_worker(struct rspamd_main *rspamd_main,
 		rspamd_hard_terminate(rspamd_main);
 	}
 
+	/* Shared both by main and by the worker, hence created before fork */
+	rspamd_control_ring_create(rspamd_main, wrk);
+
 	if (cf->bind_conf) {
 		msg_info_main("prepare to fork process %s (%d); listen on: %s",
 					  cf->worker->name,
@@ -2427,6 +2555,25 @@ rspamd_worker_metrics_object(struct rspamd_config *cfg, struct rspamd_stat *stat
 	ucl_object_insert_key(top,
 						  ucl_object_fromint(mem_st.fragmented_size), "fragmented", 0, false);
 
+	const struct rspamd_ev_loop_stats *ev_st = rspamd_ev_watcher_stats();
+	ucl_object_t *loop_obj = ucl_object_typed_new(UCL_OBJECT);
+	ucl_object_t *buckets_ar = ucl_object_typed_new(UCL_ARRAY);
+
+	for (int i = 0; i < RSPAMD_EV_STATS_BUCKETS; i++) {
+		ucl_array_append(buckets_ar, ucl_object_fromint(ev_st->buckets[i]));
+	}
+
+	ucl_object_insert_key(loop_obj, buckets_ar, "buckets", 0, false);
+	ucl_object_insert_key(loop_obj,
+						  ucl_object_fromint(ev_st->total_calls), "calls", 0, false);
+	ucl_object_insert_key(loop_obj,
+						  ucl_object_fromdouble(ev_st->total_time), "total_time", 0, false);
+	ucl_object_insert_key(loop_obj,
+						  ucl_object_fromdouble(ev_st->max_time), "max_time", 0, false);
+	ucl_object_insert_key(loop_obj,
+						  ucl_object_fromdouble(ev_st->loop_lag), "lag", 0, false);
+	ucl_object_insert_key(top, loop_obj, "event_loop", 0, false);
+
 	return top;
 }
 
@@ -2533,6 +2680,55 @@ rspamd_metrics_to_prometheus_string(const ucl_object_t *top)
 							   "Memory pools: fragmented memory waste.",
 							   "fragmented");
 
+	const ucl_object_t *loop_obj = ucl_object_lookup(top, "event_loop");
+
+	if (loop_obj) {
+		const ucl_object_t *buckets_ar = ucl_object_lookup(loop_obj, "buckets"), *cur;
+		ucl_object_iter_t it = NULL;
+		uint64_t cumulative = 0, nbuckets = 0;
+		double le = 1e-4;
+
+		rspamd_printf_fstring(&output, "# HELP rspamd_ev_callback_duration_seconds "
+									   "Event loop callbacks execution time.\n");
+		rspamd_printf_fstring(&output, "# TYPE rspamd_ev_callback_duration_seconds histogram\n");
+
+		if (buckets_ar) {
+			nbuckets = ucl_array_size(buckets_ar);
+
+			while ((cur = ucl_object_iterate(buckets_ar, &it, true)) != NULL) {
+				cumulative += ucl_object_toint(cur);
+
+				/* The last bucket is a catch-all one, folded into +Inf below */
+				if (--nbuckets > 0) {
+					rspamd_printf_fstring(&output,
+										  "rspamd_ev_callback_duration_seconds_bucket{le=\"%.4f\"} %L\n",
+										  le, (int64_t) cumulative);
+					le *= 2.0;
+				}
+			}
+		}
+
+		rspamd_printf_fstring(&output,
+							  "rspamd_ev_callback_duration_seconds_bucket{le=\"+Inf\"} %L\n",
+							  (int64_t) cumulative);
+		rspamd_printf_fstring(&output, "rspamd_ev_callback_duration_seconds_sum %.6f\n",
+							  ucl_object_todouble(ucl_object_lookup(loop_obj, "total_time")));
+		rspamd_printf_fstring(&output, "rspamd_ev_callback_duration_seconds_count %L\n",
+							  ucl_object_toint(ucl_object_lookup(loop_obj, "calls")));
+
+		rspamd_printf_fstring(&output, "# HELP rspamd_ev_callback_duration_max_seconds "
+									   "Longest event loop callback seen.\n");
+		rspamd_printf_fstring(&output, "# TYPE rspamd_ev_callback_duration_max_seconds gauge\n");
+		rspamd_printf_fstring(&output, "rspamd_ev_callback_duration_max_seconds %.6f\n",
+							  ucl_object_todouble(ucl_object_lookup(loop_obj, "max_time")));
+
+		rspamd_printf_fstring(&output, "# HELP rspamd_ev_loop_lag_seconds "
+									   "Smoothed event loop iteration lag.\n");
+		rspamd_printf_fstring(&output, "# TYPE rspamd_ev_loop_lag_seconds gauge\n");
+		rspamd_printf_fstring(&output, "rspamd_ev_loop_lag_seconds %.6f\n",
+							  ucl_object_todouble(ucl_object_lookup(loop_obj, "lag")));
+	}
+
 	const ucl_object_t *acts_obj = ucl_object_lookup(top, "actions");
 
 	if (acts_obj) {
@@ -32,22 +32,26 @@
 
 namespace rspamd::stat::cdb {
 
+/* How often (in seconds) we stat the cdb file to detect a replaced generation */
+constexpr static const double cdb_refresh_interval = 60.0;
+
 /*
  * Utility class to share cdb instances over statfiles instances, as each
- * cdb has tokens for both ham and spam classes
+ * cdb has tokens for both ham and spam classes; each entry also remembers
+ * the inode of the mapped file to detect atomically replaced generations
  */
 class cdb_shared_storage {
 public:
 	using cdb_element_t = std::shared_ptr<struct cdb>;
 	cdb_shared_storage() = default;
 
-	auto get_cdb(const char *path) const -> std::optional<cdb_element_t>
+	auto get_cdb(const char *path) const -> std::optional<std::pair<cdb_element_t, ino_t>>
 	{
 		auto found = elts.find(path);
 
 		if (found != elts.end()) {
-			if (!found->second.expired()) {
-				return found->second.lock();
+			if (!found->second.cdbp.expired()) {
+				return std::make_pair(found->second.cdbp.lock(), found->second.inode);
 			}
 		}
 
@@ -61,37 +65,60 @@ public:
 		return ret;
 	}
 	/* Enclose cdb into storage */
-	auto push_cdb(const char *path, cdb_element_t cdbp) -> cdb_element_t
+	auto push_cdb(const char *path, cdb_element_t cdbp, ino_t inode) -> cdb_element_t
 	{
 		auto found = elts.find(path);
 
 		if (found != elts.end()) {
-			if (found->second.expired()) {
+			if (found->second.cdbp.expired()) {
 				/* OK, move in lieu of the expired weak pointer */
 
-				found->second = cdbp;
+				found->second.cdbp = cdbp;
+				found->second.inode = inode;
 				return cdbp;
 			}
 			else {
 				/*
 				 * Existing and not expired, return the existing one
 				 */
-				return found->second.lock();
+				return found->second.cdbp.lock();
 			}
 		}
 		else {
 			/* Not existing, make a weak ptr and return the original */
-			elts.emplace(path, std::weak_ptr<struct cdb>(cdbp));
+			elts.emplace(path, cdb_storage_elt{std::weak_ptr<struct cdb>(cdbp), inode});
 			return cdbp;
 		}
 	}
+	/*
+	 * Unconditionally replace the stored element with a new generation; the
+	 * old mmap stays alive until the last owning statfile drops its reference
+	 */
+	auto replace_cdb(const char *path, cdb_element_t cdbp, ino_t inode) -> cdb_element_t
+	{
+		auto found = elts.find(path);
+
+		if (found != elts.end()) {
+			found->second.cdbp = cdbp;
+			found->second.inode = inode;
+		}
+		else {
+			elts.emplace(path, cdb_storage_elt{std::weak_ptr<struct cdb>(cdbp), inode});
+		}
+
+		return cdbp;
+	}
 
 private:
+	struct cdb_storage_elt {
+		std::weak_ptr<struct cdb> cdbp;
+		ino_t inode = 0;
+	};
 	/*
 	 * We store weak pointers here to allow owning cdb statfiles to free
 	 * expensive cdb before this cache is terminated (e.g. on dynamic cdb reload)
 	 */
-	ankerl::unordered_dense::map<std::string, std::weak_ptr<struct cdb>> elts;
+	ankerl::unordered_dense::map<std::string, cdb_storage_elt> elts;
 
 	struct cdb_deleter {
 		void operator()(struct cdb *c) const
@@ -106,8 +133,9 @@ static cdb_shared_storage cdb_shared_storage;
 
 class ro_backend final {
 public:
-	explicit ro_backend(struct rspamd_statfile *_st, cdb_shared_storage::cdb_element_t _db)
-		: st(_st), db(std::move(_db))
+	explicit ro_backend(struct rspamd_statfile *_st, cdb_shared_storage::cdb_element_t _db,
+						std::string _path, ino_t _inode)
+		: st(_st), db(std::move(_db)), path(std::move(_path)), inode(_inode)
 	{
 	}
 	ro_backend() = delete;
@@ -120,6 +148,9 @@ public:
 	{
 		std::swap(st, other.st);
 		std::swap(db, other.db);
+		std::swap(path, other.path);
+		std::swap(inode, other.inode);
+		std::swap(last_check, other.last_check);
 		std::swap(loaded, other.loaded);
 		std::swap(learns_spam, other.learns_spam);
 		std::swap(learns_ham, other.learns_ham);
@@ -131,6 +162,7 @@ public:
 	}
 
 	auto load_cdb() -> tl::expected<bool, std::string>;
+	auto maybe_refresh(struct rspamd_task *task) -> void;
 	auto process_token(const rspamd_token_t *tok) const -> std::optional<float>;
 	constexpr auto is_spam() const -> bool
 	{
@@ -153,6 +185,9 @@ public:
 private:
 	struct rspamd_statfile *st;
 	cdb_shared_storage::cdb_element_t db;
+	std::string path;
+	ino_t inode = 0;
+	double last_check = 0.0;
 	bool loaded = false;
 	std::uint64_t learns_spam = 0;
 	std::uint64_t learns_ham = 0;
@@ -207,6 +242,40 @@ cdb_get_key_as_float_pair(struct cdb *cdb, T key) -> std::optional<std::pair<flo
 }
 
 
+/* Open and map a cdb file, returning the shared element and its inode */
+static auto
+load_cdb_file(const char *path) -> tl::expected<std::pair<cdb_shared_storage::cdb_element_t, ino_t>, std::string>
+{
+	auto fd = rspamd_file_xopen(path, O_RDONLY, 0, true);
+
+	if (fd == -1) {
+		return tl::make_unexpected(fmt::format("cannot open {}: {}",
+											   path, strerror(errno)));
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+
+		return tl::make_unexpected(fmt::format("cannot stat {}: {}",
+											   path, strerror(errno)));
+	}
+
+	auto cdbp = cdb_shared_storage::new_cdb();
+
+	if (cdb_init(cdbp.get(), fd) == -1) {
+		close(fd);
+
+		return tl::make_unexpected(fmt::format("cannot init cdb in {}: {}",
+											   path, strerror(errno)));
+	}
+
+	close(fd);
+
+	return std::make_pair(std::move(cdbp), st.st_ino);
+}
+
 auto ro_backend::load_cdb() -> tl::expected<bool, std::string>
 {
 	if (!db) {
@@ -248,6 +317,70 @@ auto ro_backend::load_cdb() -> tl::expected<bool, std::string>
 	return true;// expected
 }
 
+/*
+ * Detect an atomically replaced cdb file (rename over the old one) by
+ * comparing inodes and switch to the new generation without a restart;
+ * the check is throttled, and the old mmap is kept alive until the last
+ * statfile referencing it has switched over
+ */
+auto ro_backend::maybe_refresh(struct rspamd_task *task) -> void
+{
+	auto now = rspamd_get_calendar_ticks();
+
+	if (now - last_check < cdb_refresh_interval) {
+		return;
+	}
+
+	last_check = now;
+
+	struct stat sb;
+
+	if (stat(path.c_str(), &sb) == -1) {
+		/* Keep serving the old generation if the file has vanished */
+		msg_warn_task("cannot stat cdb file %s: %s; keep the loaded generation",
+					  path.c_str(), strerror(errno));
+		return;
+	}
+
+	if (sb.st_ino == inode) {
+		return;
+	}
+
+	/* Another statfile sharing this path might have loaded the new generation already */
+	auto cached_cdb_maybe = cdb_shared_storage.get_cdb(path.c_str());
+
+	if (cached_cdb_maybe && cached_cdb_maybe->second == sb.st_ino) {
+		db = cached_cdb_maybe->first;
+	}
+	else {
+		auto new_cdb_maybe = load_cdb_file(path.c_str());
+
+		if (!new_cdb_maybe) {
+			msg_warn_task("cannot reload cdb file %s: %s; keep the loaded generation",
+						  path.c_str(), new_cdb_maybe.error().c_str());
+			return;
+		}
+
+		db = cdb_shared_storage.replace_cdb(path.c_str(), new_cdb_maybe->first,
+											new_cdb_maybe->second);
+	}
+
+	inode = sb.st_ino;
+	loaded = false;
+
+	auto res = load_cdb();
+
+	if (!res) {
+		msg_warn_task("cannot load learn counts from the new cdb generation %s: %s",
+					  path.c_str(), res.error().c_str());
+	}
+	else {
+		msg_info_task("switched to a new generation of cdb statistics %s: "
+					  "%uL learns spam, %uL learns ham",
+					  path.c_str(), learns_spam, learns_ham);
+	}
+}
+
 auto ro_backend::process_token(const rspamd_token_t *tok) const -> std::optional<float>
 {
 	if (!loaded) {
@@ -308,31 +441,21 @@ auto open_cdb(struct rspamd_statfile *st) -> tl::expected<ro_backend, std::strin
 
 	auto cached_cdb_maybe = cdb_shared_storage.get_cdb(path);
 	cdb_shared_storage::cdb_element_t cdbp;
+	ino_t inode = 0;
 
 	if (!cached_cdb_maybe) {
+		auto new_cdb_maybe = load_cdb_file(path);
 
-		auto fd = rspamd_file_xopen(path, O_RDONLY, 0, true);
-
-		if (fd == -1) {
-			return tl::make_unexpected(fmt::format("cannot open {}: {}",
-												   path, strerror(errno)));
+		if (!new_cdb_maybe) {
+			return tl::make_unexpected(new_cdb_maybe.error());
 		}
 
-		cdbp = cdb_shared_storage::new_cdb();
-
-		if (cdb_init(cdbp.get(), fd) == -1) {
-			close(fd);
-
-			return tl::make_unexpected(fmt::format("cannot init cdb in {}: {}",
-												   path, strerror(errno)));
-		}
-
-		cdbp = cdb_shared_storage.push_cdb(path, cdbp);
-
-		close(fd);
+		inode = new_cdb_maybe->second;
+		cdbp = cdb_shared_storage.push_cdb(path, new_cdb_maybe->first, inode);
 	}
 	else {
-		cdbp = cached_cdb_maybe.value();
+		cdbp = cached_cdb_maybe->first;
+		inode = cached_cdb_maybe->second;
 	}
 
 	if (!cdbp) {
@@ -340,7 +463,7 @@ auto open_cdb(struct rspamd_statfile *st) -> tl::expected<ro_backend, std::strin
 											   path));
 	}
 
-	ro_backend bk{st, std::move(cdbp)};
+	ro_backend bk{st, std::move(cdbp), path, inode};
 
 	auto res = bk.load_cdb();
 
@@ -382,6 +505,11 @@ rspamd_cdb_runtime(struct rspamd_task *task,
 				   gpointer ctx,
 				   int _id)
 {
+	auto *cdbp = CDB_FROM_RAW(ctx);
+
+	/* Pick up a renamed-over cdb generation if any (the check is throttled) */
+	cdbp->maybe_refresh(task);
+
 	/* In CDB we don't have any dynamic stuff */
 	return ctx;
 }
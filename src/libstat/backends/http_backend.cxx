@@ -131,7 +131,7 @@ stat_tokens_to_msgpack(GPtrArray *tokens) -> std::vector<std::uint8_t>
 	 * [4 bytes be] - size of the array
 	 * [ 0xcf + <8 bytes BE integer>] * N - array elements
 	 */
-	ret.resize(tokens->len * (sizeof(std::uint64_t) + 1) + 5);
+	ret.reserve(tokens->len * (sizeof(std::uint64_t) + 1) + 5);
 	ret.push_back('\xdd');
 	std::uint32_t ulen = GUINT32_TO_BE(tokens->len);
 	std::copy((const std::uint8_t *) &ulen,
@@ -226,7 +226,7 @@ auto http_backends_collection::first_init(struct rspamd_stat_ctx *ctx,
 				return false;
 			}
 
-			if (!rspamd_upstreams_from_ucl(write_servers, rs, 80, this)) {
+			if (!rspamd_upstreams_from_ucl(write_servers, ws, 80, this)) {
 				rspamd_upstreams_destroy(write_servers);
 				return false;
 			}
@@ -550,6 +550,20 @@ rspamd_mmaped_file_preload(rspamd_mmaped_file_t *file)
 			pos += size;
 		}
 	}
+
+	/*
+	 * Lookups hash into random blocks, so keeping the sequential hint after
+	 * the initial prefetch would merely let the kernel drop pages behind us;
+	 * switch the mapping to random access for the statfile lifetime
+	 */
+	if (madvise((void *) file->map, file->len, MADV_RANDOM) == -1) {
+		msg_info("madvise failed: %s", strerror(errno));
+	}
+
+#ifdef MADV_HUGEPAGE
+	/* Reduce TLB pressure on large statfiles; ignored where unsupported */
+	(void) madvise((void *) file->map, file->len, MADV_HUGEPAGE);
+#endif
 }
 
 rspamd_mmaped_file_t *
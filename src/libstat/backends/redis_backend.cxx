@@ -19,6 +19,7 @@
 #include "stat_internal.h"
 #include "upstream.h"
 #include "libserver/mempool_vars_internal.h"
+#include "libutil/hash.h"
 #include "contrib/fmt/include/fmt/base.h"
 
 #include "libutil/cxx/error.hxx"
@@ -42,6 +43,8 @@ INIT_LOG_MODULE(stat_redis)
 #define REDIS_DEFAULT_TIMEOUT 0.5
 #define REDIS_STAT_TIMEOUT 30
 #define REDIS_MAX_USERS 1000
+#define REDIS_STAT_CACHE_SIZE 65536
+#define REDIS_STAT_CACHE_TTL 60
 
 struct redis_stat_ctx {
 	lua_State *L;
@@ -79,6 +82,63 @@ struct redis_stat_ctx {
 };
 
 
+/*
+ * Local read-through cache shared by all classifiers of a worker: campaign
+ * tokens repeat heavily for hours, so most token counters can be served
+ * without asking redis. Entries live for a short TTL and the whole cache is
+ * dropped on a successful learn as the counters become stale
+ */
+struct redis_stat_token_cache_entry {
+	float ham;
+	float spam;
+};
+
+struct redis_stat_learns_cache_entry {
+	std::uint64_t learned_ham;
+	std::uint64_t learned_spam;
+};
+
+static rspamd_lru_hash_t *redis_stat_token_cache = nullptr;
+static rspamd_lru_hash_t *redis_stat_learns_cache = nullptr;
+
+static auto
+rspamd_redis_stat_token_cache(void) -> rspamd_lru_hash_t *
+{
+	if (redis_stat_token_cache == nullptr) {
+		redis_stat_token_cache = rspamd_lru_hash_new_full(REDIS_STAT_CACHE_SIZE,
+														  g_free, g_free,
+														  rspamd_str_hash, rspamd_str_equal);
+	}
+
+	return redis_stat_token_cache;
+}
+
+static auto
+rspamd_redis_stat_learns_cache(void) -> rspamd_lru_hash_t *
+{
+	if (redis_stat_learns_cache == nullptr) {
+		redis_stat_learns_cache = rspamd_lru_hash_new_full(REDIS_MAX_USERS,
+														   g_free, g_free,
+														   rspamd_str_hash, rspamd_str_equal);
+	}
+
+	return redis_stat_learns_cache;
+}
+
+static auto
+rspamd_redis_stat_cache_invalidate(void) -> void
+{
+	if (redis_stat_token_cache != nullptr) {
+		rspamd_lru_hash_destroy(redis_stat_token_cache);
+		redis_stat_token_cache = nullptr;
+	}
+
+	if (redis_stat_learns_cache != nullptr) {
+		rspamd_lru_hash_destroy(redis_stat_learns_cache);
+		redis_stat_learns_cache = nullptr;
+	}
+}
+
 template<class T, std::enable_if_t<std::is_convertible_v<T, float>, bool> = true>
 struct redis_stat_runtime {
 	struct redis_stat_ctx *ctx;
@@ -94,6 +154,15 @@ struct redis_stat_runtime {
 
 	using result_type = std::vector<std::pair<int, T>>;
 
+	/*
+	 * Local cache support: results already recovered from the cache for both
+	 * classes and the mapping from the indexes actually sent to redis back to
+	 * the original token indexes (zero based)
+	 */
+	result_type *cached_spam = nullptr;
+	result_type *cached_ham = nullptr;
+	std::vector<unsigned int> fetch_map;
+
 private:
 	/* Called on connection termination */
 	static void rt_dtor(gpointer data)
@@ -111,6 +180,10 @@ private:
 		}
 
 		delete results;
+
+		/* Nulled when the ownership is transferred to results */
+		delete cached_spam;
+		delete cached_ham;
 	}
 
 public:
@@ -705,19 +778,23 @@ msgpack_str_len(std::size_t len) -> std::size_t
 }
 
 /*
- * Serialise stat tokens to message pack
+ * Serialise stat tokens to message pack; when `subset` is not NULL, merely the
+ * tokens with the listed indexes are emitted (used by the local cache to fetch
+ * the missing tokens only)
  */
 static char *
-rspamd_redis_serialize_tokens(struct rspamd_task *task, const char *prefix, GPtrArray *tokens, gsize *ser_len)
+rspamd_redis_serialize_tokens(struct rspamd_task *task, const char *prefix, GPtrArray *tokens,
+							  const std::vector<unsigned int> *subset, gsize *ser_len)
 {
 	/* Each token is int64_t that requires 10 bytes (2 int32_t) + 4 bytes array len + 1 byte array magic */
 	char max_int64_str[] = "18446744073709551615";
 	auto prefix_len = strlen(prefix);
 	std::size_t req_len = 5;
+	std::size_t nelts = subset ? subset->size() : tokens->len;
 	rspamd_token_t *tok;
 
 	/* Calculate required length */
-	req_len += tokens->len * (msgpack_str_len(sizeof(max_int64_str) + prefix_len) + 1);
+	req_len += nelts * (msgpack_str_len(sizeof(max_int64_str) + prefix_len) + 1);
 
 	auto *buf = (char *) rspamd_mempool_alloc(task->task_pool, req_len);
 	auto *p = buf;
@@ -725,21 +802,33 @@ rspamd_redis_serialize_tokens(struct rspamd_task *task, const char *prefix, GPtr
 	/* Array */
 	*p++ = (char) 0xdd;
 	/* Length in big-endian (4 bytes) */
-	*p++ = (char) ((tokens->len >> 24) & 0xff);
-	*p++ = (char) ((tokens->len >> 16) & 0xff);
-	*p++ = (char) ((tokens->len >> 8) & 0xff);
-	*p++ = (char) (tokens->len & 0xff);
+	*p++ = (char) ((nelts >> 24) & 0xff);
+	*p++ = (char) ((nelts >> 16) & 0xff);
+	*p++ = (char) ((nelts >> 8) & 0xff);
+	*p++ = (char) (nelts & 0xff);
 
 
-	int i;
 	auto numbuf_len = sizeof(max_int64_str) + prefix_len + 1;
 	auto *numbuf = (char *) g_alloca(numbuf_len);
 
-	PTR_ARRAY_FOREACH(tokens, i, tok)
-	{
+	auto emit_token = [&](rspamd_token_t *tok) {
 		std::size_t r = rspamd_snprintf(numbuf, numbuf_len, "%s_%uL", prefix, tok->data);
 		auto shift = msgpack_emit_str({numbuf, r}, p);
 		p += shift;
+	};
+
+	if (subset) {
+		for (auto idx: *subset) {
+			emit_token((rspamd_token_t *) g_ptr_array_index(tokens, idx));
+		}
+	}
+	else {
+		int i;
+
+		PTR_ARRAY_FOREACH(tokens, i, tok)
+		{
+			emit_token(tok);
+		}
 	}
 
 	*ser_len = p - buf;
@@ -830,14 +919,19 @@ rspamd_redis_classified(lua_State *L)
 		 * 6 - spam_tokens (pair<int, int>)
 		 */
 
+		auto nfetched = rt->fetch_map.size();
+		std::vector<float> got_ham(nfetched, 0.0f), got_spam(nfetched, 0.0f);
+
 		/*
-		 * We need to fill our runtime AND the opposite runtime
+		 * We need to fill our runtime AND the opposite runtime; results that
+		 * were served from the local cache are merged with the fetched ones,
+		 * remapping the subset indexes back to the original token indexes
 		 */
-		auto filler_func = [](redis_stat_runtime<float> *rt, lua_State *L, unsigned learned, int tokens_pos) {
-			rt->learned = learned;
-			redis_stat_runtime<float>::result_type *res;
-
-			res = new redis_stat_runtime<float>::result_type();
+		auto filler_func = [&](redis_stat_runtime<float> *dest, unsigned learned, int tokens_pos,
+							   redis_stat_runtime<float>::result_type *base,
+							   std::vector<float> &got) {
+			dest->learned = learned;
+			auto *res = base ? base : new redis_stat_runtime<float>::result_type();
 
 			for (lua_pushnil(L); lua_next(L, tokens_pos); lua_pop(L, 1)) {
 				lua_rawgeti(L, -1, 1);
@@ -848,10 +942,13 @@ rspamd_redis_classified(lua_State *L)
 				auto value = lua_tonumber(L, -1);
 				lua_pop(L, 1);
 
-				res->emplace_back(idx, value);
+				if (idx >= 1 && (std::size_t) idx <= rt->fetch_map.size()) {
+					got[idx - 1] = value;
+					res->emplace_back(rt->fetch_map[idx - 1] + 1, value);
+				}
 			}
 
-			rt->set_results(res);
+			dest->set_results(res);
 		};
 
 		auto opposite_rt_maybe = redis_stat_runtime<float>::maybe_recover_from_mempool(task,
@@ -864,15 +961,43 @@ rspamd_redis_classified(lua_State *L)
 			return 0;
 		}
 
+		auto learned_ham = lua_tointeger(L, 3), learned_spam = lua_tointeger(L, 4);
+
 		if (rt->stcf->is_spam) {
-			filler_func(rt, L, lua_tointeger(L, 4), 6);
-			filler_func(opposite_rt_maybe.value(), L, lua_tointeger(L, 3), 5);
+			filler_func(rt, learned_spam, 6, rt->cached_spam, got_spam);
+			filler_func(opposite_rt_maybe.value(), learned_ham, 5, rt->cached_ham, got_ham);
 		}
 		else {
-			filler_func(rt, L, lua_tointeger(L, 3), 5);
-			filler_func(opposite_rt_maybe.value(), L, lua_tointeger(L, 4), 6);
+			filler_func(rt, learned_ham, 5, rt->cached_ham, got_ham);
+			filler_func(opposite_rt_maybe.value(), learned_spam, 6, rt->cached_spam, got_spam);
+		}
+
+		/* Ownership of the cached vectors has been transferred to the results */
+		rt->cached_spam = nullptr;
+		rt->cached_ham = nullptr;
+
+		/* Remember the fetched counters in the local cache */
+		auto now = time(nullptr);
+		auto *tok_cache = rspamd_redis_stat_token_cache();
+
+		for (std::size_t i = 0; i < nfetched; i++) {
+			auto *tok = (rspamd_token_t *) g_ptr_array_index(rt->tokens, rt->fetch_map[i]);
+			auto key = fmt::format("{}_{}", rt->redis_object_expanded, tok->data);
+			auto *centry = g_new0(struct redis_stat_token_cache_entry, 1);
+
+			centry->ham = got_ham[i];
+			centry->spam = got_spam[i];
+			rspamd_lru_hash_insert(tok_cache, g_strdup(key.c_str()), centry,
+								   now, REDIS_STAT_CACHE_TTL);
 		}
 
+		auto *lentry = g_new0(struct redis_stat_learns_cache_entry, 1);
+		lentry->learned_ham = learned_ham;
+		lentry->learned_spam = learned_spam;
+		rspamd_lru_hash_insert(rspamd_redis_stat_learns_cache(),
+							   g_strdup(rt->redis_object_expanded), lentry,
+							   now, REDIS_STAT_CACHE_TTL);
+
 		/* Mark task as being processed */
 		task->flags |= RSPAMD_TASK_FLAG_HAS_SPAM_TOKENS | RSPAMD_TASK_FLAG_HAS_HAM_TOKENS;
 
@@ -914,11 +1039,96 @@ rspamd_redis_process_tokens(struct rspamd_task *task,
 		rt->id = id;
 		rt->tokens = g_ptr_array_ref(tokens);
 
+		/* Results may have been served from the local cache already */
+		if (rt->results) {
+			rt->process_tokens(tokens);
+		}
+
 		return TRUE;
 	}
 
+	/* Consult the local read-through cache before asking redis */
+	auto now = time(nullptr);
+	auto *tok_cache = rspamd_redis_stat_token_cache();
+
+	rt->cached_spam = new redis_stat_runtime<float>::result_type();
+	rt->cached_ham = new redis_stat_runtime<float>::result_type();
+	rt->fetch_map.reserve(tokens->len);
+
+	for (unsigned int i = 0; i < tokens->len; i++) {
+		auto *tok = (rspamd_token_t *) g_ptr_array_index(tokens, i);
+		auto key = fmt::format("{}_{}", rt->redis_object_expanded, tok->data);
+		auto *cached = (struct redis_stat_token_cache_entry *)
+			rspamd_lru_hash_lookup(tok_cache, key.c_str(), now);
+
+		if (cached != nullptr) {
+			/* Tokens with zero counters are merely absent from the results */
+			if (cached->spam > 0) {
+				rt->cached_spam->emplace_back(i + 1, cached->spam);
+			}
+			if (cached->ham > 0) {
+				rt->cached_ham->emplace_back(i + 1, cached->ham);
+			}
+		}
+		else {
+			rt->fetch_map.push_back(i);
+		}
+	}
+
+	auto *learns = (struct redis_stat_learns_cache_entry *)
+		rspamd_lru_hash_lookup(rspamd_redis_stat_learns_cache(),
+							   rt->redis_object_expanded, now);
+
+	if (learns != nullptr && rt->fetch_map.empty()) {
+		/* All counters are known locally, so we can serve the whole request */
+		auto opposite_rt_maybe = redis_stat_runtime<float>::maybe_recover_from_mempool(task,
+																					   rt->redis_object_expanded,
+																					   !rt->stcf->is_spam);
+
+		if (opposite_rt_maybe) {
+			auto *opposite_rt = opposite_rt_maybe.value();
+
+			rt->id = id;
+			rt->tokens = g_ptr_array_ref(tokens);
+
+			if (rt->stcf->is_spam) {
+				rt->learned = learns->learned_spam;
+				opposite_rt->learned = learns->learned_ham;
+				rt->set_results(rt->cached_spam);
+				opposite_rt->set_results(rt->cached_ham);
+			}
+			else {
+				rt->learned = learns->learned_ham;
+				opposite_rt->learned = learns->learned_spam;
+				rt->set_results(rt->cached_ham);
+				opposite_rt->set_results(rt->cached_spam);
+			}
+
+			rt->cached_spam = nullptr;
+			rt->cached_ham = nullptr;
+
+			task->flags |= RSPAMD_TASK_FLAG_HAS_SPAM_TOKENS | RSPAMD_TASK_FLAG_HAS_HAM_TOKENS;
+			/*
+			 * Merely our own results are processed here: the opposite runtime
+			 * is always processed after us and applies its results on its own
+			 * process_tokens call
+			 */
+			rt->process_tokens(tokens);
+
+			msg_debug_bayes("served %ud tokens for %s from the local cache",
+							tokens->len, rt->redis_object_expanded);
+
+			return TRUE;
+		}
+	}
+
+	msg_debug_bayes("local cache: %ud tokens found, %z to fetch for %s",
+					tokens->len - (unsigned int) rt->fetch_map.size(),
+					rt->fetch_map.size(), rt->redis_object_expanded);
+
 	gsize tokens_len;
-	char *tokens_buf = rspamd_redis_serialize_tokens(task, rt->redis_object_expanded, tokens, &tokens_len);
+	char *tokens_buf = rspamd_redis_serialize_tokens(task, rt->redis_object_expanded, tokens,
+													 &rt->fetch_map, &tokens_len);
 	rt->id = id;
 
 	lua_pushcfunction(L, &rspamd_lua_traceback);
@@ -979,7 +1189,8 @@ rspamd_redis_learned(lua_State *L)
 	bool result = lua_toboolean(L, 2);
 
 	if (result) {
-		/* TODO: write it */
+		/* Locally cached counters are stale now */
+		rspamd_redis_stat_cache_invalidate();
 	}
 	else {
 		/* Error message is on index 3 */
@@ -1008,7 +1219,8 @@ rspamd_redis_learn_tokens(struct rspamd_task *task,
 	}
 
 	gsize tokens_len;
-	char *tokens_buf = rspamd_redis_serialize_tokens(task, rt->redis_object_expanded, tokens, &tokens_len);
+	char *tokens_buf = rspamd_redis_serialize_tokens(task, rt->redis_object_expanded, tokens,
+													 nullptr, &tokens_len);
 
 	rt->id = id;
 
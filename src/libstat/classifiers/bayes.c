@@ -96,13 +96,35 @@ inv_chi_square(struct rspamd_task *task, double value, int freedom_deg)
 struct bayes_task_closure {
 	double ham_prob;
 	double spam_prob;
+	/*
+	 * Running products of per-token probabilities; folded into the log sums
+	 * above when they approach underflow, so we call log() once per a few
+	 * hundred tokens instead of twice per token
+	 */
+	double ham_prod;
+	double spam_prod;
 	double meta_skip_prob;
+	/* Loop invariants hoisted out of the per-token path */
+	double inv_spam_learns;
+	double inv_ham_learns;
+	int spam_id;
+	int ham_id;
 	uint64_t processed_tokens;
 	uint64_t total_hits;
 	uint64_t text_tokens;
 	struct rspamd_task *task;
 };
 
+/* Fold the running probability products into the log sums */
+static inline void
+bayes_fold_prob(struct bayes_task_closure *cl)
+{
+	cl->spam_prob += log(cl->spam_prod);
+	cl->ham_prob += log(cl->ham_prod);
+	cl->spam_prod = 1.0;
+	cl->ham_prod = 1.0;
+}
+
 /*
  * Mathematically we use pow(complexity, complexity), where complexity is the
  * window index
@@ -117,10 +139,7 @@ static void
 bayes_classify_token(struct rspamd_classifier *ctx,
 					 rspamd_token_t *tok, struct bayes_task_closure *cl)
 {
-	unsigned int i;
-	int id;
 	unsigned int spam_count = 0, ham_count = 0, total_count = 0;
-	struct rspamd_statfile *st;
 	struct rspamd_task *task;
 	const char *token_type = "txt";
 	double spam_prob, spam_freq, ham_freq, bayes_spam_prob, bayes_ham_prob,
@@ -151,20 +170,25 @@ bayes_classify_token(struct rspamd_classifier *ctx,
 		}
 	}
 
-	for (i = 0; i < ctx->statfiles_ids->len; i++) {
-		id = g_array_index(ctx->statfiles_ids, int, i);
-		st = g_ptr_array_index(ctx->ctx->statfiles, id);
-		g_assert(st != NULL);
-		val = tok->values[id];
+	/*
+	 * Statfile ids are resolved once per classification in bayes_classify,
+	 * so here we merely index the per-token contiguous values array
+	 */
+	if (cl->spam_id != -1) {
+		val = tok->values[cl->spam_id];
 
 		if (val > 0) {
-			if (st->stcf->is_spam) {
-				spam_count += val;
-			}
-			else {
-				ham_count += val;
-			}
+			spam_count = val;
+			total_count += val;
+			cl->total_hits += val;
+		}
+	}
+
+	if (cl->ham_id != -1) {
+		val = tok->values[cl->ham_id];
 
+		if (val > 0) {
+			ham_count = val;
 			total_count += val;
 			cl->total_hits += val;
 		}
@@ -172,8 +196,8 @@ bayes_classify_token(struct rspamd_classifier *ctx,
 
 	/* Probability for this token */
 	if (total_count >= ctx->cfg->min_token_hits) {
-		spam_freq = ((double) spam_count / MAX(1., (double) ctx->spam_learns));
-		ham_freq = ((double) ham_count / MAX(1., (double) ctx->ham_learns));
+		spam_freq = (double) spam_count * cl->inv_spam_learns;
+		ham_freq = (double) ham_count * cl->inv_ham_learns;
 		spam_prob = spam_freq / (spam_freq + ham_freq);
 		ham_prob = ham_freq / (spam_freq + ham_freq);
 
@@ -204,8 +228,13 @@ bayes_classify_token(struct rspamd_classifier *ctx,
 
 		bayes_ham_prob = PROB_COMBINE(ham_prob, total_count, w, 0.5);
 
-		cl->spam_prob += log(bayes_spam_prob);
-		cl->ham_prob += log(bayes_ham_prob);
+		cl->spam_prod *= bayes_spam_prob;
+		cl->ham_prod *= bayes_ham_prob;
+
+		if (cl->spam_prod < 1e-200 || cl->ham_prod < 1e-200) {
+			bayes_fold_prob(cl);
+		}
+
 		cl->processed_tokens++;
 
 		if (!(tok->flags & RSPAMD_STAT_TOKEN_FLAG_META)) {
@@ -281,6 +310,26 @@ bayes_classify(struct rspamd_classifier *ctx,
 
 	memset(&cl, 0, sizeof(cl));
 	cl.task = task;
+	cl.spam_prod = 1.0;
+	cl.ham_prod = 1.0;
+	cl.spam_id = -1;
+	cl.ham_id = -1;
+	cl.inv_spam_learns = 1.0 / MAX(1., (double) ctx->spam_learns);
+	cl.inv_ham_learns = 1.0 / MAX(1., (double) ctx->ham_learns);
+
+	/* Resolve statfile ids once instead of re-scanning them for every token */
+	for (i = 0; i < ctx->statfiles_ids->len; i++) {
+		id = g_array_index(ctx->statfiles_ids, int, i);
+		st = g_ptr_array_index(ctx->ctx->statfiles, id);
+		g_assert(st != NULL);
+
+		if (st->stcf->is_spam) {
+			cl.spam_id = id;
+		}
+		else {
+			cl.ham_id = id;
+		}
+	}
 
 	/* Check min learns */
 	if (ctx->cfg->min_learns > 0) {
@@ -331,6 +380,9 @@ bayes_classify(struct rspamd_classifier *ctx,
 		bayes_classify_token(ctx, tok, &cl);
 	}
 
+	/* Fold the remaining probability products into the final log sums */
+	bayes_fold_prob(&cl);
+
 	if (cl.processed_tokens == 0) {
 		msg_info_bayes("no tokens found in bayes database "
 					   "(%ud total tokens, %ud text tokens), ignore stats",
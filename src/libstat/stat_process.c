@@ -23,6 +23,7 @@
 #include "lua/lua_common.h"
 #include "lua/lua_classnames.h"
 #include "libserver/mempool_vars_internal.h"
+#include "libutil/hash.h"
 #include "utlist.h"
 #include <math.h>
 
@@ -32,6 +33,126 @@
 
 static const double similarity_threshold = 80.0;
 
+/*
+ * Cache of tokenization results keyed by text part digest: mailing list
+ * traffic re-sends identical bodies to many recipients, so duplicate parts
+ * can skip the tokenizer entirely; workers are single threaded, hence a
+ * static cache is safe
+ */
+#define STAT_TOKENS_CACHE_SIZE 128
+#define STAT_TOKENS_CACHE_TTL 60
+/* How many bytes of the part digest we use as the cache key */
+#define STAT_TOKENS_CACHE_KEYLEN 16
+
+struct rspamd_stat_cached_token {
+	uint64_t data;
+	unsigned int window_idx;
+	unsigned int flags;
+};
+
+struct rspamd_stat_cached_tokens {
+	unsigned int nelts;
+	struct rspamd_stat_cached_token elts[];
+};
+
+static guint
+rspamd_stat_tokens_cache_hash(gconstpointer p)
+{
+	return (guint) rspamd_cryptobox_fast_hash(p, STAT_TOKENS_CACHE_KEYLEN,
+											  rspamd_hash_seed());
+}
+
+static gboolean
+rspamd_stat_tokens_cache_equal(gconstpointer a, gconstpointer b)
+{
+	return memcmp(a, b, STAT_TOKENS_CACHE_KEYLEN) == 0;
+}
+
+static rspamd_lru_hash_t *
+rspamd_stat_tokens_cache(void)
+{
+	static rspamd_lru_hash_t *cache = NULL;
+
+	if (cache == NULL) {
+		cache = rspamd_lru_hash_new_full(STAT_TOKENS_CACHE_SIZE,
+										 g_free, g_free,
+										 rspamd_stat_tokens_cache_hash,
+										 rspamd_stat_tokens_cache_equal);
+	}
+
+	return cache;
+}
+
+/*
+ * Try to materialise tokens for a text part from the cache; returns FALSE
+ * when the part has not been seen recently and must be tokenized
+ */
+static gboolean
+rspamd_stat_tokenize_part_cached(struct rspamd_stat_ctx *st_ctx,
+								 struct rspamd_task *task,
+								 struct rspamd_mime_text_part *part)
+{
+	struct rspamd_stat_cached_tokens *cached;
+	rspamd_token_t *new_tok;
+	gsize token_size;
+	unsigned int i;
+
+	cached = rspamd_lru_hash_lookup(rspamd_stat_tokens_cache(),
+									part->mime_part->digest, time(NULL));
+
+	if (cached == NULL) {
+		return FALSE;
+	}
+
+	token_size = sizeof(rspamd_token_t) +
+				 sizeof(RSPAMD_TOKEN_VALUE_TYPE) * st_ctx->statfiles->len;
+
+	for (i = 0; i < cached->nelts; i++) {
+		new_tok = rspamd_mempool_alloc0(task->task_pool, token_size);
+		new_tok->data = cached->elts[i].data;
+		new_tok->window_idx = cached->elts[i].window_idx;
+		new_tok->flags = cached->elts[i].flags;
+		g_ptr_array_add(task->tokens, new_tok);
+	}
+
+	msg_debug_bayes("reused %ud cached tokens for part of length %z",
+					cached->nelts, part->utf_content.len);
+
+	return TRUE;
+}
+
+static void
+rspamd_stat_tokens_cache_store(struct rspamd_task *task,
+							   struct rspamd_mime_text_part *part,
+							   unsigned int start)
+{
+	struct rspamd_stat_cached_tokens *cached;
+	rspamd_token_t *tok;
+	unsigned char *key;
+	unsigned int i, nelts;
+
+	nelts = task->tokens->len - start;
+
+	if (nelts == 0) {
+		return;
+	}
+
+	cached = g_malloc(sizeof(*cached) + nelts * sizeof(cached->elts[0]));
+	cached->nelts = nelts;
+
+	for (i = 0; i < nelts; i++) {
+		tok = g_ptr_array_index(task->tokens, start + i);
+		cached->elts[i].data = tok->data;
+		cached->elts[i].window_idx = tok->window_idx;
+		cached->elts[i].flags = tok->flags;
+	}
+
+	key = g_malloc(STAT_TOKENS_CACHE_KEYLEN);
+	memcpy(key, part->mime_part->digest, STAT_TOKENS_CACHE_KEYLEN);
+	rspamd_lru_hash_insert(rspamd_stat_tokens_cache(), key, cached,
+						   time(NULL), STAT_TOKENS_CACHE_TTL);
+}
+
 static void
 rspamd_stat_tokenize_parts_metadata(struct rspamd_stat_ctx *st_ctx,
 									struct rspamd_task *task)
@@ -147,12 +268,29 @@ void rspamd_stat_process_tokenize(struct rspamd_stat_ctx *st_ctx,
 	rspamd_mempool_notify_alloc(task->task_pool, reserved_len * sizeof(gpointer));
 	pdiff = rspamd_mempool_get_variable(task->task_pool, "parts_distance");
 
+	/*
+	 * Learn tasks need the word references inside tokens (e.g. to store
+	 * token texts), so they always take the full tokenization path
+	 */
+	gboolean learn_task = task->flags & (RSPAMD_TASK_FLAG_LEARN_SPAM |
+										 RSPAMD_TASK_FLAG_LEARN_HAM |
+										 RSPAMD_TASK_FLAG_UNLEARN);
+
 	PTR_ARRAY_FOREACH(MESSAGE_FIELD(task, text_parts), i, part)
 	{
 		if (!IS_TEXT_PART_EMPTY(part) && part->utf_words != NULL) {
-			st_ctx->tokenizer->tokenize_func(st_ctx, task,
-											 part->utf_words, IS_TEXT_PART_UTF(part),
-											 NULL, task->tokens);
+			if (learn_task ||
+				!rspamd_stat_tokenize_part_cached(st_ctx, task, part)) {
+				unsigned int start = task->tokens->len;
+
+				st_ctx->tokenizer->tokenize_func(st_ctx, task,
+												 part->utf_words, IS_TEXT_PART_UTF(part),
+												 NULL, task->tokens);
+
+				if (!learn_task) {
+					rspamd_stat_tokens_cache_store(task, part, start);
+				}
+			}
 		}
 
 
@@ -277,10 +277,10 @@ int rspamd_tokenizer_osb(struct rspamd_stat_ctx *ctx,
 	rspamd_stat_token_t *token;
 	struct rspamd_osb_tokenizer_config *osb_cf;
 	uint64_t cur, seed;
-	struct token_pipe_entry *hashpipe;
+	struct token_pipe_entry *accepted;
 	uint32_t h1, h2;
 	gsize token_size;
-	unsigned int processed = 0, i, w, window_size, token_flags = 0;
+	unsigned int naccepted = 0, i, w, window_size, token_flags = 0;
 
 	if (words == NULL) {
 		return FALSE;
@@ -297,15 +297,17 @@ int rspamd_tokenizer_osb(struct rspamd_stat_ctx *ctx,
 		seed = osb_cf->seed;
 	}
 
-	hashpipe = g_alloca(window_size * sizeof(hashpipe[0]));
-	for (i = 0; i < window_size; i++) {
-		hashpipe[i].h = 0xfe;
-		hashpipe[i].t = NULL;
-	}
 	token_size = sizeof(rspamd_token_t) +
 				 sizeof(RSPAMD_TOKEN_VALUE_TYPE) * ctx->statfiles->len;
 	g_assert(token_size > 0);
 
+	/*
+	 * First pass: hash all words in one batch into a flat array, keeping the
+	 * hashing kernel tight instead of interleaving it with token allocation;
+	 * unigram tokens are emitted directly and do not take part in windows
+	 */
+	accepted = g_malloc(words->len * sizeof(accepted[0]));
+
 	for (w = 0; w < words->len; w++) {
 		token = &g_array_index(words, rspamd_stat_token_t, w);
 		token_flags = token->flags;
@@ -362,62 +364,61 @@ int rspamd_tokenizer_osb(struct rspamd_stat_ctx *ctx,
 			continue;
 		}
 
-#define ADD_TOKEN                                                                       \
-	do {                                                                                \
-		new_tok = rspamd_mempool_alloc0(task->task_pool, token_size);                   \
-		new_tok->flags = token_flags;                                                   \
-		new_tok->t1 = hashpipe[0].t;                                                    \
-		new_tok->t2 = hashpipe[i].t;                                                    \
-		if (osb_cf->ht == RSPAMD_OSB_HASH_COMPAT) {                                     \
-			h1 = ((uint32_t) hashpipe[0].h) * primes[0] +                               \
-				 ((uint32_t) hashpipe[i].h) * primes[i << 1];                           \
-			h2 = ((uint32_t) hashpipe[0].h) * primes[1] +                               \
-				 ((uint32_t) hashpipe[i].h) * primes[(i << 1) - 1];                     \
-			memcpy((unsigned char *) &new_tok->data, &h1, sizeof(h1));                  \
-			memcpy(((unsigned char *) &new_tok->data) + sizeof(h1), &h2, sizeof(h2));   \
-		}                                                                               \
-		else {                                                                          \
-			new_tok->data = hashpipe[0].h * primes[0] + hashpipe[i].h * primes[i << 1]; \
-		}                                                                               \
-		new_tok->window_idx = i;                                                        \
-		g_ptr_array_add(result, new_tok);                                               \
-	} while (0)
+		accepted[naccepted].h = cur;
+		accepted[naccepted].t = token;
+		naccepted++;
+	}
 
-		if (processed < window_size) {
-			/* Just fill a hashpipe */
-			++processed;
-			hashpipe[window_size - processed].h = cur;
-			hashpipe[window_size - processed].t = token;
-		}
-		else {
-			/* Shift hashpipe */
-			for (i = window_size - 1; i > 0; i--) {
-				hashpipe[i] = hashpipe[i - 1];
-			}
-			hashpipe[0].h = cur;
-			hashpipe[0].t = token;
+#define ADD_TOKEN(_p0, _pi)                                                        \
+	do {                                                                           \
+		new_tok = rspamd_mempool_alloc0(task->task_pool, token_size);              \
+		new_tok->flags = token_flags;                                              \
+		new_tok->t1 = (_p0)->t;                                                    \
+		new_tok->t2 = (_pi)->t;                                                    \
+		if (osb_cf->ht == RSPAMD_OSB_HASH_COMPAT) {                                \
+			h1 = ((uint32_t) (_p0)->h) * primes[0] +                               \
+				 ((uint32_t) (_pi)->h) * primes[i << 1];                           \
+			h2 = ((uint32_t) (_p0)->h) * primes[1] +                               \
+				 ((uint32_t) (_pi)->h) * primes[(i << 1) - 1];                     \
+			memcpy((unsigned char *) &new_tok->data, &h1, sizeof(h1));             \
+			memcpy(((unsigned char *) &new_tok->data) + sizeof(h1), &h2, sizeof(h2)); \
+		}                                                                          \
+		else {                                                                     \
+			new_tok->data = (_p0)->h * primes[0] + (_pi)->h * primes[i << 1];      \
+		}                                                                          \
+		new_tok->window_idx = i;                                                   \
+		g_ptr_array_add(result, new_tok);                                          \
+	} while (0)
 
-			processed++;
+	/*
+	 * Second pass: emit sliding window combinations indexing the flat array;
+	 * this produces exactly the same tokens as the former shifting hashpipe
+	 * (including its tail behaviour for texts shorter than the window) but
+	 * without moving the pipe contents for every word
+	 */
+	if (naccepted > window_size) {
+		for (w = window_size; w < naccepted; w++) {
+			token_flags = accepted[w].t->flags;
 
 			for (i = 1; i < window_size; i++) {
-				if (!(hashpipe[i].t->flags & RSPAMD_STAT_TOKEN_FLAG_EXCEPTION)) {
-					ADD_TOKEN;
+				if (!(accepted[w - i].t->flags & RSPAMD_STAT_TOKEN_FLAG_EXCEPTION)) {
+					ADD_TOKEN(&accepted[w], &accepted[w - i]);
 				}
 			}
 		}
 	}
+	else if (naccepted > 1) {
+		/* Short text: combine the penultimate word with its predecessors */
+		unsigned int last = naccepted - 2;
 
-	if (processed > 1 && processed <= window_size) {
-		processed--;
-		memmove(hashpipe, &hashpipe[window_size - processed],
-				processed * sizeof(hashpipe[0]));
-
-		for (i = 1; i < processed; i++) {
-			ADD_TOKEN;
+		for (i = 1; i <= last; i++) {
+			ADD_TOKEN(&accepted[last], &accepted[last - i]);
 		}
 	}
 
 #undef ADD_TOKEN
 
+	g_free(accepted);
+
 	return TRUE;
 }
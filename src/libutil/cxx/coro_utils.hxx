@@ -0,0 +1,381 @@
+/*
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSPAMD_CORO_UTILS_HXX
+#define RSPAMD_CORO_UTILS_HXX
+#pragma once
+
+#include "config.h"
+#include "mem_pool.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Minimal stackless coroutine layer for internal async operations.
+ *
+ * A `task<T>` is lazy: nothing runs until it is resumed or awaited, and a
+ * task awaiting another task is resumed via symmetric transfer, so chains of
+ * async operations do not grow the stack. Coroutines whose first argument is
+ * an `rspamd_mempool_t *` get their frame allocated from that pool,
+ * collapsing the per-event heap records of a callback chain into a single
+ * allocation that is released together with the pool (for scan paths, the
+ * task pool). `suspend_with` adapts the callback style C APIs (dns, http,
+ * redis) without touching them: the functor receives the coroutine handle
+ * that the completion callback has to resume from the event loop.
+ */
+
+namespace rspamd::coro {
+
+namespace detail {
+
+struct frame_header {
+	rspamd_mempool_t *pool;
+};
+
+constexpr std::size_t frame_offset =
+	((sizeof(frame_header) + alignof(std::max_align_t) - 1) /
+	 alignof(std::max_align_t)) *
+	alignof(std::max_align_t);
+
+inline void *alloc_frame(std::size_t sz, rspamd_mempool_t *pool)
+{
+	void *raw;
+
+	if (pool != nullptr) {
+		raw = rspamd_mempool_alloc(pool, sz + frame_offset);
+	}
+	else {
+		raw = ::operator new(sz + frame_offset);
+	}
+
+	static_cast<frame_header *>(raw)->pool = pool;
+
+	return static_cast<char *>(raw) + frame_offset;
+}
+
+inline void free_frame(void *p) noexcept
+{
+	auto *raw = static_cast<char *>(p) - frame_offset;
+
+	if (reinterpret_cast<frame_header *>(raw)->pool == nullptr) {
+		::operator delete(raw);
+	}
+	/* Pool backed frames are released together with their pool */
+}
+
+struct promise_base;
+
+struct final_awaiter {
+	promise_base *promise;
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept;
+	void await_resume() const noexcept
+	{
+	}
+};
+
+/* Continuation bookkeeping shared by all promises */
+struct promise_base {
+	std::coroutine_handle<> continuation = std::noop_coroutine();
+	std::exception_ptr eptr;
+
+	auto initial_suspend() const noexcept
+	{
+		return std::suspend_always{};
+	}
+
+	auto final_suspend() noexcept
+	{
+		return final_awaiter{this};
+	}
+
+	void unhandled_exception() noexcept
+	{
+		eptr = std::current_exception();
+	}
+
+	/* Frames of coroutines with a leading pool argument live in that pool */
+	template<typename... Args>
+	static void *operator new(std::size_t sz, rspamd_mempool_t *pool, Args &&...)
+	{
+		return alloc_frame(sz, pool);
+	}
+	static void *operator new(std::size_t sz)
+	{
+		return alloc_frame(sz, nullptr);
+	}
+	static void operator delete(void *p) noexcept
+	{
+		free_frame(p);
+	}
+	static void operator delete(void *p, std::size_t) noexcept
+	{
+		free_frame(p);
+	}
+	template<typename... Args>
+	static void operator delete(void *p, rspamd_mempool_t *, Args &&...) noexcept
+	{
+		free_frame(p);
+	}
+};
+
+inline std::coroutine_handle<>
+final_awaiter::await_suspend(std::coroutine_handle<>) const noexcept
+{
+	/* Symmetric transfer to whoever awaits us */
+	return promise->continuation;
+}
+
+}// namespace detail
+
+template<typename T = void>
+struct task {
+	struct promise_type : detail::promise_base {
+		std::optional<T> value;
+
+		auto get_return_object()
+		{
+			return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+		}
+
+		void return_value(T v)
+		{
+			value.emplace(std::move(v));
+		}
+	};
+
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	task() = default;
+	explicit task(handle_type h)
+		: coro(h)
+	{
+	}
+	task(task &&other) noexcept
+		: coro(std::exchange(other.coro, {}))
+	{
+	}
+	task &operator=(task &&other) noexcept
+	{
+		if (this != &other) {
+			destroy();
+			coro = std::exchange(other.coro, {});
+		}
+
+		return *this;
+	}
+	task(const task &) = delete;
+	task &operator=(const task &) = delete;
+	~task()
+	{
+		destroy();
+	}
+
+	void destroy() noexcept
+	{
+		if (coro) {
+			coro.destroy();
+			coro = {};
+		}
+	}
+
+	/* Starts or continues the task from plain (non coroutine) code */
+	void resume()
+	{
+		coro.resume();
+	}
+
+	bool done() const noexcept
+	{
+		return !coro || coro.done();
+	}
+
+	/* Result of a finished task; rethrows an escaped exception */
+	T result()
+	{
+		if (coro.promise().eptr) {
+			std::rethrow_exception(coro.promise().eptr);
+		}
+
+		return std::move(*coro.promise().value);
+	}
+
+	auto operator co_await() noexcept
+	{
+		struct awaiter {
+			handle_type coro;
+
+			bool await_ready() const noexcept
+			{
+				return !coro || coro.done();
+			}
+			auto await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				coro.promise().continuation = h;
+
+				return coro;
+			}
+			T await_resume()
+			{
+				if (coro.promise().eptr) {
+					std::rethrow_exception(coro.promise().eptr);
+				}
+
+				return std::move(*coro.promise().value);
+			}
+		};
+
+		return awaiter{coro};
+	}
+
+private:
+	handle_type coro{};
+};
+
+template<>
+struct task<void> {
+	struct promise_type : detail::promise_base {
+		auto get_return_object()
+		{
+			return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+		}
+
+		void return_void() const noexcept
+		{
+		}
+	};
+
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	task() = default;
+	explicit task(handle_type h)
+		: coro(h)
+	{
+	}
+	task(task &&other) noexcept
+		: coro(std::exchange(other.coro, {}))
+	{
+	}
+	task &operator=(task &&other) noexcept
+	{
+		if (this != &other) {
+			destroy();
+			coro = std::exchange(other.coro, {});
+		}
+
+		return *this;
+	}
+	task(const task &) = delete;
+	task &operator=(const task &) = delete;
+	~task()
+	{
+		destroy();
+	}
+
+	void destroy() noexcept
+	{
+		if (coro) {
+			coro.destroy();
+			coro = {};
+		}
+	}
+
+	void resume()
+	{
+		coro.resume();
+	}
+
+	bool done() const noexcept
+	{
+		return !coro || coro.done();
+	}
+
+	void result()
+	{
+		if (coro.promise().eptr) {
+			std::rethrow_exception(coro.promise().eptr);
+		}
+	}
+
+	auto operator co_await() noexcept
+	{
+		struct awaiter {
+			handle_type coro;
+
+			bool await_ready() const noexcept
+			{
+				return !coro || coro.done();
+			}
+			auto await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				coro.promise().continuation = h;
+
+				return coro;
+			}
+			void await_resume()
+			{
+				if (coro.promise().eptr) {
+					std::rethrow_exception(coro.promise().eptr);
+				}
+			}
+		};
+
+		return awaiter{coro};
+	}
+
+private:
+	handle_type coro{};
+};
+
+/*
+ * Suspends the current coroutine and hands its handle to `f`, which is
+ * expected to stash it in the userdata of a callback style C request; the
+ * completion callback then resumes the handle from the event loop
+ */
+template<typename F>
+auto suspend_with(F &&f)
+{
+	struct awaiter {
+		std::decay_t<F> func;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			func(h);
+		}
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+	return awaiter{std::forward<F>(f)};
+}
+
+}// namespace rspamd::coro
+
+#endif /* RSPAMD_CORO_UTILS_HXX */
@@ -21,6 +21,7 @@
 #include <string_view>
 #include <string>
 #include "contrib/ankerl/unordered_dense.h"
+#include "local_shared_ptr.hxx"
 
 
 namespace rspamd {
@@ -104,6 +105,71 @@ struct smart_str_hash {
 	}
 };
 
+/*
+ * Maps keys to shared parse artifacts without keeping them alive: entries
+ * merely hold a local_weak_ptr, so an artifact is destroyed as soon as its
+ * last real consumer releases it, whilst repeated lookups within the
+ * artifact's lifetime avoid re-parsing. Expired entries are dropped lazily
+ * on lookup and swept in bulk once insertions outnumber live entries.
+ */
+template<typename Key, typename T,
+		 typename Hash = ankerl::unordered_dense::hash<Key>,
+		 typename Eq = std::equal_to<Key>>
+class weak_parse_cache {
+public:
+	/* Templated to allow transparent lookup, e.g. by a string view */
+	template<typename K>
+	auto get(const K &k) -> local_shared_ptr<T>
+	{
+		auto it = cache.find(k);
+
+		if (it != cache.end()) {
+			auto locked = it->second.lock();
+
+			if (locked) {
+				return locked;
+			}
+
+			cache.erase(it);
+		}
+
+		return {};
+	}
+
+	template<typename K>
+	auto put(K &&k, const local_shared_ptr<T> &artifact) -> void
+	{
+		cache.insert_or_assign(std::forward<K>(k), local_weak_ptr<T>{artifact});
+
+		if (++inserts > cache.size()) {
+			sweep();
+		}
+	}
+
+	auto size() const
+	{
+		return cache.size();
+	}
+
+private:
+	auto sweep() -> void
+	{
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.expired()) {
+				it = cache.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		inserts = 0;
+	}
+
+	ankerl::unordered_dense::map<Key, local_weak_ptr<T>, Hash, Eq> cache;
+	std::size_t inserts = 0;
+};
+
 }// namespace rspamd
 
 #endif//RSPAMD_HASH_UTIL_HXX
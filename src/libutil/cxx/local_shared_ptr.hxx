@@ -382,10 +382,14 @@ public:
 	local_shared_ptr<T> lock() const noexcept
 	{
 		local_shared_ptr<T> tmp;
-		tmp.cnt = cnt;
 
-		if (cnt) {
+		/*
+		 * An expired pointee has already been disposed even if the control
+		 * block is still alive, so locking it must yield an empty pointer
+		 */
+		if (cnt && cnt->shared_count() > 0) {
 			cnt->add_shared();
+			tmp.cnt = cnt;
 			tmp.px = px;
 		}
 
@@ -50,6 +50,33 @@ off_t rspamd_fast_utf8_validate(const unsigned char *data, size_t len)
 	return res.count + 1;// We need to return offset for the first invalid character
 }
 
+size_t rspamd_fast_utf8_enforce(unsigned char *data, size_t len)
+{
+	auto *p = (char *) data;
+	auto remain = len;
+	size_t nrep = 0;
+
+	while (remain > 0) {
+		auto res = impl->validate_utf8_with_errors(p, remain);
+
+		if (res.error == simdutf::error_code::SUCCESS) {
+			break;
+		}
+
+		/*
+		 * Replace the head byte of the invalid sequence and restart past it;
+		 * validation resumes from the error offset, so the input is scanned
+		 * exactly once and each remaining bogus byte is replaced in turn
+		 */
+		p[res.count] = '?';
+		nrep++;
+		p += res.count + 1;
+		remain -= res.count + 1;
+	}
+
+	return nrep;
+}
+
 off_t rspamd_fast_utf8_validate_ref(const unsigned char *data, size_t len)
 {
 	auto res = ref_impl->validate_utf8_with_errors((const char *) data, len);
@@ -15,6 +15,7 @@
  */
 
 #include "util.hxx"
+#include "hash_util.hxx"
 
 #define DOCTEST_CONFIG_IMPLEMENTATION_IN_DLL
 #include "doctest/doctest.h"
@@ -79,4 +80,22 @@ TEST_SUITE("cxx utils")
 			compare_vec(res, std::get<2>(c).second);
 		}
 	}
+
+	TEST_CASE("weak_parse_cache")
+	{
+		weak_parse_cache<std::string, std::string, smart_str_hash, smart_str_equal> cache;
+
+		auto artifact = local_make_shared<std::string>("artifact");
+		cache.put(std::string{"key"}, artifact);
+
+		auto hit = cache.get("key");
+		CHECK(hit.get() == artifact.get());
+		CHECK(cache.get("missing").get() == nullptr);
+
+		/* The cache must not prolong the artifact's lifetime */
+		hit.reset();
+		artifact.reset();
+		CHECK(cache.get("key").get() == nullptr);
+		CHECK(cache.size() == 0);
+	}
 }
\ No newline at end of file
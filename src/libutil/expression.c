@@ -62,6 +62,29 @@ struct rspamd_expression_elt {
 	int flags;
 	int priority;
 	double value;
+	/* Runtime ordering key, recomputed on each resort */
+	double ord;
+};
+
+/*
+ * Flat threaded code form of the ast: a postfix program over a small value
+ * stack, where short circuiting is expressed with explicit jumps; it is
+ * rebuilt whenever the ast branches are resorted by cost
+ */
+enum rspamd_expr_insn_type {
+	EXPR_INSN_ATOM = 0,
+	EXPR_INSN_LIMIT,
+	EXPR_INSN_NOT,
+	EXPR_INSN_BINARY,
+	EXPR_INSN_MERGE, /* a single n-ary chain step */
+	EXPR_INSN_JZ,    /* short circuit of an AND chain */
+	EXPR_INSN_JNZ,   /* short circuit of an OR chain */
+};
+
+struct rspamd_expr_insn {
+	struct rspamd_expression_elt *elt;
+	enum rspamd_expr_insn_type type;
+	unsigned int jmp;
 };
 
 struct rspamd_expression {
@@ -69,6 +92,8 @@ struct rspamd_expression {
 	GArray *expressions;
 	GPtrArray *expression_stack;
 	GNode *ast;
+	GArray *compiled;
+	unsigned int compiled_depth;
 	char *log_id;
 	unsigned int next_resort;
 	unsigned int evals;
@@ -564,6 +589,9 @@ rspamd_expression_destroy(struct rspamd_expression *expr)
 		if (expr->ast) {
 			g_node_destroy(expr->ast);
 		}
+		if (expr->compiled) {
+			g_array_free(expr->compiled, TRUE);
+		}
 		if (expr->log_id) {
 			g_free(expr->log_id);
 		}
@@ -741,48 +769,59 @@ rspamd_ast_priority_traverse(GNode *node, gpointer d)
 				elt->priority = RSPAMD_EXPRESSION_MAX_PRIORITY -
 								expr->subr->priority(elt->p.atom);
 			}
-			elt->p.atom->hits = 0;
 		}
 	}
 
 	return FALSE;
 }
 
-#define ATOM_PRIORITY(a) ((a)->p.atom->hits / ((a)->p.atom->exec_time.mean > 0 ? (a)->p.atom->exec_time.mean * 10000000 : 1.0))
+/*
+ * Expected shortcut gain per cost unit: in an AND chain an atom is valuable
+ * when it misses frequently, in an OR chain - when it hits frequently.
+ * Atoms without a measured execution time yet get a neutral unit cost.
+ */
+static double
+rspamd_ast_atom_ord(struct rspamd_expression_elt *elt,
+					enum rspamd_expression_op op)
+{
+	rspamd_expression_atom_t *atom = elt->p.atom;
+	double selectivity, cost;
+
+	selectivity = atom->evals > 0 ? (double) atom->hits / (double) atom->evals : 0.5;
+	cost = atom->exec_time.mean > 0 ? atom->exec_time.mean : 1e-8;
+
+	if (op == OP_AND) {
+		return (1.0 - selectivity) / cost;
+	}
+
+	return selectivity / cost;
+}
 
 static int
 rspamd_ast_priority_cmp(GNode *a, GNode *b)
 {
 	struct rspamd_expression_elt *ea = a->data, *eb = b->data;
-	double w1, w2;
 
-	if (ea->type == ELT_LIMIT) {
-		return 1;
-	}
-	else if (eb->type == ELT_LIMIT) {
-		return -1;
+	if (ea->priority != eb->priority) {
+		return ea->priority - eb->priority;
 	}
 
-	/* Special logic for atoms */
-	if (ea->type == ELT_ATOM && eb->type == ELT_ATOM &&
-		ea->priority == eb->priority) {
-		w1 = ATOM_PRIORITY(ea);
-		w2 = ATOM_PRIORITY(eb);
-
-		ea->p.atom->hits = 0;
-
-		return w1 - w2;
+	/* Greater expected gain is evaluated first */
+	if (ea->ord > eb->ord) {
+		return -1;
 	}
-	else {
-		return ea->priority - eb->priority;
+	else if (ea->ord < eb->ord) {
+		return 1;
 	}
+
+	return 0;
 }
 
 static gboolean
 rspamd_ast_resort_traverse(GNode *node, gpointer unused)
 {
-	GNode *children, *last;
-	struct rspamd_expression_elt *elt;
+	GNode *children, *last, *cur;
+	struct rspamd_expression_elt *elt, *cur_elt;
 
 	elt = (struct rspamd_expression_elt *) node->data;
 
@@ -792,6 +831,23 @@ rspamd_ast_resort_traverse(GNode *node, gpointer unused)
 	if (elt->type == ELT_OP && elt->p.op.op_flags & RSPAMD_EXPRESSION_LOGICAL) {
 
 		if (node->children) {
+			/* Precompute the op aware ordering keys */
+			cur = node->children;
+			while (cur) {
+				cur_elt = cur->data;
+
+				if (cur_elt->type == ELT_ATOM) {
+					cur_elt->ord = rspamd_ast_atom_ord(cur_elt, elt->p.op.op);
+					/* Decay the window, so stale statistics fade out */
+					cur_elt->p.atom->hits /= 2;
+					cur_elt->p.atom->evals /= 2;
+				}
+				else {
+					cur_elt->ord = 0.0;
+				}
+
+				cur = cur->next;
+			}
 
 			children = node->children;
 			last = g_node_last_sibling(children);
@@ -1171,6 +1227,9 @@ rspamd_parse_expression(const char *line, gsize len,
 	g_node_traverse(e->ast, G_POST_ORDER, G_TRAVERSE_NON_LEAVES, -1,
 					rspamd_ast_resort_traverse, NULL);
 
+	/* Flatten the ast into the threaded code form used for evaluation */
+	rspamd_expr_compile(e);
+
 	if (target) {
 		*target = e;
 		rspamd_mempool_add_destructor(pool,
@@ -1329,6 +1388,42 @@ rspamd_ast_do_nary_op(struct rspamd_expression_elt *elt, double val, double acc)
 	return ret;
 }
 
+static void
+rspamd_expr_process_atom_elt(struct rspamd_expression_elt *elt,
+							 struct rspamd_expr_process_data *process_data)
+{
+	float t1, t2;
+	gboolean calc_ticks;
+
+	if (!(elt->flags & RSPAMD_EXPR_FLAG_PROCESSED)) {
+		/*
+		 * Check once per 256 evaluations approx
+		 */
+		calc_ticks = (rspamd_random_uint64_fast() & 0xff) == 0xff;
+		if (calc_ticks) {
+			t1 = rspamd_get_ticks(TRUE);
+		}
+
+		elt->p.atom->evals++;
+		elt->value = process_data->process_closure(process_data->ud, elt->p.atom);
+
+		if (fabs(elt->value) > DBL_EPSILON) {
+			elt->p.atom->hits++;
+
+			if (process_data->trace) {
+				g_ptr_array_add(process_data->trace, elt->p.atom);
+			}
+		}
+
+		if (calc_ticks) {
+			t2 = rspamd_get_ticks(TRUE);
+			rspamd_set_counter_ema(&elt->p.atom->exec_time, (t2 - t1), 0.5f);
+		}
+
+		elt->flags |= RSPAMD_EXPR_FLAG_PROCESSED;
+	}
+}
+
 static double
 rspamd_ast_process_node(struct rspamd_expression *e, GNode *node,
 						struct rspamd_expr_process_data *process_data)
@@ -1336,42 +1431,14 @@ rspamd_ast_process_node(struct rspamd_expression *e, GNode *node,
 	struct rspamd_expression_elt *elt;
 	GNode *cld;
 	double acc = NAN;
-	float t1, t2;
 	double val;
-	gboolean calc_ticks = FALSE;
 	__attribute__((unused)) const char *op_name = NULL;
 
 	elt = node->data;
 
 	switch (elt->type) {
 	case ELT_ATOM:
-		if (!(elt->flags & RSPAMD_EXPR_FLAG_PROCESSED)) {
-			/*
-			 * Check once per 256 evaluations approx
-			 */
-			calc_ticks = (rspamd_random_uint64_fast() & 0xff) == 0xff;
-			if (calc_ticks) {
-				t1 = rspamd_get_ticks(TRUE);
-			}
-
-			elt->value = process_data->process_closure(process_data->ud, elt->p.atom);
-
-			if (fabs(elt->value) > DBL_EPSILON) {
-				elt->p.atom->hits++;
-
-				if (process_data->trace) {
-					g_ptr_array_add(process_data->trace, elt->p.atom);
-				}
-			}
-
-			if (calc_ticks) {
-				t2 = rspamd_get_ticks(TRUE);
-				rspamd_set_counter_ema(&elt->p.atom->exec_time, (t2 - t1), 0.5f);
-			}
-
-			elt->flags |= RSPAMD_EXPR_FLAG_PROCESSED;
-		}
-
+		rspamd_expr_process_atom_elt(elt, process_data);
 		acc = elt->value;
 		msg_debug_expression_verbose("atom: elt=%s; acc=%.1f", elt->p.atom->str, acc);
 		break;
@@ -1457,6 +1524,148 @@ rspamd_ast_cleanup_traverse(GNode *n, gpointer d)
 	return FALSE;
 }
 
+static void
+rspamd_expr_compile_node(struct rspamd_expression *e, GNode *node,
+						 unsigned int depth)
+{
+	struct rspamd_expression_elt *elt = node->data;
+	struct rspamd_expr_insn insn;
+	GNode *cld;
+
+	memset(&insn, 0, sizeof(insn));
+	insn.elt = elt;
+
+	if (depth + 1 > e->compiled_depth) {
+		e->compiled_depth = depth + 1;
+	}
+
+	switch (elt->type) {
+	case ELT_ATOM:
+		insn.type = EXPR_INSN_ATOM;
+		g_array_append_val(e->compiled, insn);
+		break;
+	case ELT_LIMIT:
+		insn.type = EXPR_INSN_LIMIT;
+		g_array_append_val(e->compiled, insn);
+		break;
+	case ELT_OP:
+		if (elt->p.op.op_flags & RSPAMD_EXPRESSION_NARY) {
+			GArray *jumps = g_array_new(FALSE, FALSE, sizeof(unsigned int));
+			gboolean logical = (elt->p.op.op == OP_AND || elt->p.op.op == OP_OR);
+			unsigned int j;
+
+			cld = node->children;
+			rspamd_expr_compile_node(e, cld, depth);
+
+			for (cld = cld->next; cld != NULL; cld = cld->next) {
+				if (logical) {
+					/* Check the accumulator before evaluating further */
+					j = e->compiled->len;
+					insn.type = elt->p.op.op == OP_AND ? EXPR_INSN_JZ : EXPR_INSN_JNZ;
+					g_array_append_val(e->compiled, insn);
+					g_array_append_val(jumps, j);
+				}
+
+				rspamd_expr_compile_node(e, cld, depth + 1);
+				insn.type = EXPR_INSN_MERGE;
+				g_array_append_val(e->compiled, insn);
+			}
+
+			/* All short circuits land past the end of the chain */
+			for (j = 0; j < jumps->len; j++) {
+				g_array_index(e->compiled, struct rspamd_expr_insn,
+							  g_array_index(jumps, unsigned int, j))
+					.jmp = e->compiled->len;
+			}
+
+			g_array_free(jumps, TRUE);
+		}
+		else if (elt->p.op.op_flags & RSPAMD_EXPRESSION_BINARY) {
+			rspamd_expr_compile_node(e, node->children, depth);
+			rspamd_expr_compile_node(e, node->children->next, depth + 1);
+			insn.type = EXPR_INSN_BINARY;
+			g_array_append_val(e->compiled, insn);
+		}
+		else if (elt->p.op.op_flags & RSPAMD_EXPRESSION_UNARY) {
+			rspamd_expr_compile_node(e, node->children, depth);
+			insn.type = EXPR_INSN_NOT;
+			g_array_append_val(e->compiled, insn);
+		}
+		break;
+	}
+}
+
+static void
+rspamd_expr_compile(struct rspamd_expression *e)
+{
+	if (e->compiled == NULL) {
+		e->compiled = g_array_sized_new(FALSE, FALSE,
+										sizeof(struct rspamd_expr_insn),
+										e->expressions->len);
+	}
+	else {
+		g_array_set_size(e->compiled, 0);
+	}
+
+	e->compiled_depth = 0;
+	rspamd_expr_compile_node(e, e->ast, 0);
+}
+
+static double
+rspamd_expr_process_compiled(struct rspamd_expression *e,
+							 struct rspamd_expr_process_data *process_data)
+{
+	struct rspamd_expr_insn *program, *insn;
+	struct rspamd_expression_elt *elt;
+	double *stack, val;
+	unsigned int i, n, sp = 0;
+	gboolean opt = !(process_data->flags & RSPAMD_EXPRESSION_FLAG_NOOPT);
+
+	program = (struct rspamd_expr_insn *) e->compiled->data;
+	n = e->compiled->len;
+	stack = g_alloca(e->compiled_depth * sizeof(double));
+
+	for (i = 0; i < n; i++) {
+		insn = &program[i];
+		elt = insn->elt;
+
+		switch (insn->type) {
+		case EXPR_INSN_ATOM:
+			rspamd_expr_process_atom_elt(elt, process_data);
+			stack[sp++] = elt->value;
+			break;
+		case EXPR_INSN_LIMIT:
+			stack[sp++] = elt->p.lim;
+			break;
+		case EXPR_INSN_NOT:
+			stack[sp - 1] = rspamd_ast_do_unary_op(elt, stack[sp - 1]);
+			break;
+		case EXPR_INSN_BINARY:
+			val = stack[--sp];
+			stack[sp - 1] = rspamd_ast_do_binary_op(elt, stack[sp - 1], val);
+			break;
+		case EXPR_INSN_MERGE:
+			val = stack[--sp];
+			stack[sp - 1] = rspamd_ast_do_nary_op(elt, val, stack[sp - 1]);
+			break;
+		case EXPR_INSN_JZ:
+			if (opt && stack[sp - 1] == 0) {
+				i = insn->jmp - 1;
+			}
+			break;
+		case EXPR_INSN_JNZ:
+			if (opt && stack[sp - 1] != 0) {
+				i = insn->jmp - 1;
+			}
+			break;
+		}
+	}
+
+	g_assert(sp == 1);
+
+	return stack[0];
+}
+
 double
 rspamd_process_expression_closure(struct rspamd_expression *expr,
 								  rspamd_expression_process_cb cb,
@@ -1483,7 +1692,12 @@ rspamd_process_expression_closure(struct rspamd_expression *expr,
 		*track = pd.trace;
 	}
 
-	ret = rspamd_ast_process_node(expr, expr->ast, &pd);
+	if (expr->compiled != NULL) {
+		ret = rspamd_expr_process_compiled(expr, &pd);
+	}
+	else {
+		ret = rspamd_ast_process_node(expr, expr->ast, &pd);
+	}
 
 	/* Cleanup */
 	g_node_traverse(expr->ast, G_IN_ORDER, G_TRAVERSE_ALL, -1,
@@ -1500,6 +1714,9 @@ rspamd_process_expression_closure(struct rspamd_expression *expr,
 		/* Now set less expensive branches to be evaluated first */
 		g_node_traverse(expr->ast, G_POST_ORDER, G_TRAVERSE_NON_LEAVES, -1,
 						rspamd_ast_resort_traverse, NULL);
+
+		/* The evaluation order has changed, so recompile */
+		rspamd_expr_compile(expr);
 	}
 
 	return ret;
@@ -60,6 +60,8 @@ typedef struct rspamd_expression_atom_s {
 	/* Relative priority */
 	int priority;
 	unsigned int hits;
+	/* Evaluations within the current resort window */
+	unsigned int evals;
 	struct rspamd_counter_data exec_time;
 } rspamd_expression_atom_t;
 
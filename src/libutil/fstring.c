@@ -33,7 +33,13 @@
 
 static const gsize default_initial_size = 16;
 
-#define fstravail(s) ((s)->allocated - (s)->len)
+#define fstralloc(s) ((s)->allocated & ~RSPAMD_FSTRING_STORAGE_MASK)
+#define fstravail(s) (fstralloc(s) - (s)->len)
+
+struct rspamd_fstring_pooled {
+	rspamd_mempool_t *pool;
+	rspamd_fstring_t f;
+};
 
 rspamd_fstring_t *
 rspamd_fstring_new(void)
@@ -91,6 +97,31 @@ rspamd_fstring_new_init(const char *init, gsize len)
 	return s;
 }
 
+rspamd_fstring_t *
+rspamd_fstring_pool_new(rspamd_mempool_t *pool, gsize initial_size)
+{
+	struct rspamd_fstring_pooled *ps;
+	gsize real_size = MAX(default_initial_size, initial_size);
+
+	ps = rspamd_mempool_alloc(pool, sizeof(*ps) + real_size);
+	ps->pool = pool;
+	ps->f.len = 0;
+	ps->f.allocated = real_size | RSPAMD_FSTRING_EXTERNAL | RSPAMD_FSTRING_POOLED;
+
+	return &ps->f;
+}
+
+rspamd_fstring_t *
+rspamd_fstring_init_static(void *storage, gsize size)
+{
+	rspamd_fstring_t *s = storage;
+
+	s->len = 0;
+	s->allocated = size | RSPAMD_FSTRING_EXTERNAL;
+
+	return s;
+}
+
 rspamd_fstring_t *
 rspamd_fstring_assign(rspamd_fstring_t *str, const char *init, gsize len)
 {
@@ -117,6 +148,11 @@ rspamd_fstring_assign(rspamd_fstring_t *str, const char *init, gsize len)
 
 void rspamd_fstring_free(rspamd_fstring_t *str)
 {
+	if (str != NULL && (str->allocated & RSPAMD_FSTRING_EXTERNAL)) {
+		/* Stack or pool storage, nothing to do */
+		return;
+	}
+
 	free(str);
 }
 
@@ -145,7 +181,38 @@ rspamd_fstring_grow(rspamd_fstring_t *str, gsize needed_len)
 	gsize newlen;
 	gpointer nptr;
 
-	newlen = rspamd_fstring_suggest_size(str->len, str->allocated, needed_len);
+	newlen = rspamd_fstring_suggest_size(str->len, fstralloc(str), needed_len);
+
+	if (str->allocated & RSPAMD_FSTRING_POOLED) {
+		/* Regrow from the owning pool; the old copy is merely left to the pool */
+		struct rspamd_fstring_pooled *ps, *nps;
+
+		ps = (struct rspamd_fstring_pooled *) ((char *) str -
+											   offsetof(struct rspamd_fstring_pooled, f));
+		nps = rspamd_mempool_alloc(ps->pool, sizeof(*nps) + newlen);
+		nps->pool = ps->pool;
+		nps->f.len = str->len;
+		nps->f.allocated = newlen | RSPAMD_FSTRING_EXTERNAL | RSPAMD_FSTRING_POOLED;
+		memcpy(nps->f.str, str->str, str->len);
+
+		return &nps->f;
+	}
+	else if (str->allocated & RSPAMD_FSTRING_EXTERNAL) {
+		/* Stack storage overflowed, migrate to the heap */
+		nptr = malloc(newlen + sizeof(*str));
+
+		if (nptr == NULL) {
+			g_error("%s: failed to allocate %" G_GSIZE_FORMAT " bytes",
+					G_STRLOC, newlen + sizeof(*str));
+			abort();
+		}
+
+		memcpy(nptr, str, str->len + sizeof(*str));
+		str = nptr;
+		str->allocated = newlen;
+
+		return str;
+	}
 
 	nptr = realloc(str, newlen + sizeof(*str));
 
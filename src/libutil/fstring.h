@@ -39,6 +39,15 @@ typedef struct f_str_s {
 #define RSPAMD_FSTRING_LEN(s) ((s)->len)
 #define RSPAMD_FSTRING_LIT(lit) rspamd_fstring_new_init((lit), sizeof(lit) - 1)
 
+/*
+ * The two top bits of `allocated` encode the storage type: an external
+ * (stack or pool backed) string is never freed, and a pooled string is
+ * preceded by the owning pool pointer and is regrown from that pool
+ */
+#define RSPAMD_FSTRING_EXTERNAL ((gsize) 1 << (sizeof(gsize) * 8 - 1))
+#define RSPAMD_FSTRING_POOLED ((gsize) 1 << (sizeof(gsize) * 8 - 2))
+#define RSPAMD_FSTRING_STORAGE_MASK (RSPAMD_FSTRING_EXTERNAL | RSPAMD_FSTRING_POOLED)
+
 typedef struct f_str_tok {
 	gsize len;
 	const char *begin;
@@ -67,6 +76,31 @@ rspamd_fstring_t *rspamd_fstring_sized_new(gsize initial_size)
 rspamd_fstring_t *rspamd_fstring_new_init(const char *init, gsize len)
 	G_GNUC_WARN_UNUSED_RESULT;
 
+/**
+ * Create a new fixed length string backed by a memory pool; such a string
+ * lives as long as the pool does: rspamd_fstring_free is a no-op for it and
+ * growing allocates from the same pool
+ */
+rspamd_fstring_t *rspamd_fstring_pool_new(rspamd_mempool_t *pool,
+										  gsize initial_size)
+	G_GNUC_WARN_UNUSED_RESULT;
+
+/**
+ * Initialize an fstring over a caller provided buffer of
+ * `size + sizeof(rspamd_fstring_t)` bytes (typically on stack); growing past
+ * `size` migrates the content to the heap, after which the string behaves
+ * as a regular heap allocated one
+ */
+rspamd_fstring_t *rspamd_fstring_init_static(void *storage, gsize size);
+
+/**
+ * Declares a stack backed fstring `name` with `sz` bytes of inline storage
+ */
+#define RSPAMD_FSTRING_STACK(name, sz)                   \
+	char name##_storage[sizeof(rspamd_fstring_t) + (sz)] \
+		__attribute__((aligned(sizeof(gsize))));         \
+	rspamd_fstring_t *name = rspamd_fstring_init_static(name##_storage, (sz))
+
 /**
  * Assign new value to fixed string
  */
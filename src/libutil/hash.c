@@ -38,6 +38,7 @@ struct rspamd_lru_hash_s {
 	GDestroyNotify key_destroy;
 	GHashFunc hfunc;
 	GEqualFunc eqfunc;
+	unsigned int nresizes;
 
 	khint_t n_buckets, size, n_occupied, upper_bound;
 	khint32_t *flags;
@@ -205,6 +206,11 @@ rspamd_lru_hash_resize(rspamd_lru_hash_t *h,
 		h->n_buckets = new_n_buckets;
 		h->n_occupied = h->size;
 		h->upper_bound = (khint_t) (h->n_buckets * __ac_HASH_UPPER + 0.5);
+
+		if (h->size > 0) {
+			/* Merely count rehashes of a non-empty table */
+			h->nresizes++;
+		}
 	}
 
 	return 0;
@@ -224,10 +230,22 @@ rspamd_lru_hash_put(rspamd_lru_hash_t *h, gpointer key, int *ret)
 				return NULL;
 			}
 		}
-		else if (rspamd_lru_hash_resize(h, h->n_buckets + 1) < 0) {
-			/* expand the hash table */
-			*ret = -1;
-			return NULL;
+		else {
+			khint_t target = h->n_buckets + 1;
+
+			if (h->nresizes >= 3 && h->maxsize > h->n_buckets) {
+				/*
+				 * The table keeps growing by rehashing, so pre-size it for
+				 * the maximum number of elements at once
+				 */
+				target = h->maxsize + h->maxsize / 3;
+			}
+
+			if (rspamd_lru_hash_resize(h, target) < 0) {
+				/* expand the hash table */
+				*ret = -1;
+				return NULL;
+			}
 		}
 	}
 
@@ -713,4 +731,9 @@ unsigned int rspamd_lru_hash_size(rspamd_lru_hash_t *hash)
 unsigned int rspamd_lru_hash_capacity(rspamd_lru_hash_t *hash)
 {
 	return hash->maxsize;
+}
+
+unsigned int rspamd_lru_hash_rehashes(rspamd_lru_hash_t *hash)
+{
+	return hash->nresizes;
 }
\ No newline at end of file
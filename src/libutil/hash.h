@@ -107,6 +107,14 @@ unsigned int rspamd_lru_hash_size(rspamd_lru_hash_t *hash);
  */
 unsigned int rspamd_lru_hash_capacity(rspamd_lru_hash_t *hash);
 
+/**
+ * Returns the number of rehashes of a non-empty table performed so far;
+ * a steadily growing value means that the hash thrashes and should be
+ * created with a larger initial size
+ * @param hash hash object
+ */
+unsigned int rspamd_lru_hash_rehashes(rspamd_lru_hash_t *hash);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,25 +15,67 @@
  */
 
 #include "libev_helper.h"
+#include "util.h"
+
+static struct rspamd_ev_loop_stats ev_stats;
+
+const struct rspamd_ev_loop_stats *
+rspamd_ev_watcher_stats(void)
+{
+	return &ev_stats;
+}
+
+static void
+rspamd_ev_watcher_acct(double duration, double lag)
+{
+	unsigned int idx = 0;
+	double limit = 1e-4;
+
+	while (duration > limit && idx < RSPAMD_EV_STATS_BUCKETS - 1) {
+		limit *= 2.0;
+		idx++;
+	}
+
+	ev_stats.buckets[idx]++;
+	ev_stats.total_calls++;
+	ev_stats.total_time += duration;
+
+	if (duration > ev_stats.max_time) {
+		ev_stats.max_time = duration;
+	}
+
+	if (lag > 0) {
+		/* Smooth the lag, as a single long poll is not interesting */
+		ev_stats.loop_lag = ev_stats.loop_lag * 0.9 + lag * 0.1;
+	}
+}
 
 static void
 rspamd_ev_watcher_io_cb(EV_P_ struct ev_io *w, int revents)
 {
 	struct rspamd_io_ev *ev = (struct rspamd_io_ev *) w->data;
+	/* Loop time is cached on wakeup, so the gap to the real time shows how
+	 * long the preceding callbacks of this iteration have been running */
+	double lag = ev_time() - ev_now(EV_A);
+	double start = rspamd_get_ticks(FALSE);
 
 	ev->cb(ev->io.fd, revents, ev->ud);
+	rspamd_ev_watcher_acct(rspamd_get_ticks(FALSE) - start, lag);
 }
 
 static void
 rspamd_ev_watcher_timer_cb(EV_P_ struct ev_timer *w, int revents)
 {
 	struct rspamd_io_ev *ev = (struct rspamd_io_ev *) w->data;
+	double lag = ev_time() - ev_now(EV_A);
+	double start = rspamd_get_ticks(FALSE);
 
 	/*
 	 * We now call timeout callback in all the cases, as we assume that all
 	 * timeouts are final
 	 */
 	ev->cb(ev->io.fd, EV_TIMER, ev->ud);
+	rspamd_ev_watcher_acct(rspamd_get_ticks(FALSE) - start, lag);
 }
 
 
@@ -40,6 +40,25 @@ struct rspamd_io_ev {
 	ev_tstamp timeout;
 };
 
+/* Number of log2 sized buckets in the callbacks histogram; the first bucket
+ * covers durations up to 100 microseconds */
+#define RSPAMD_EV_STATS_BUCKETS 16
+
+/*
+ * Per-worker event loop statistics: every watcher callback dispatched via
+ * this module is timed, so callbacks that stall the loop can be attributed
+ * when latency rises
+ */
+struct rspamd_ev_loop_stats {
+	uint64_t buckets[RSPAMD_EV_STATS_BUCKETS];
+	uint64_t total_calls;
+	double total_time;
+	double max_time;
+	/* Smoothed delay between the real time and the loop time observed on
+	 * callback entry, reflecting how long loop iterations are blocked */
+	double loop_lag;
+};
+
 /**
  * Initialize watcher similar to event_init
  * @param ev
@@ -91,6 +110,12 @@ void rspamd_ev_watcher_reschedule_at(struct ev_loop *loop,
 									 short what,
 									 ev_tstamp at);
 
+/**
+ * Returns accumulated event loop statistics for this worker
+ * @return
+ */
+const struct rspamd_ev_loop_stats *rspamd_ev_watcher_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
 #include "cryptobox.h"
 #include "contrib/uthash/utlist.h"
 #include "mem_pool_internal.h"
+#include "libserver/mempool_vars_internal.h"
 
 #ifdef WITH_JEMALLOC
 #include <jemalloc/jemalloc.h>
@@ -83,6 +84,14 @@ static khash_t(mempool_entry) *mempool_entries = NULL;
 
 /* Internal statistic */
 static rspamd_mempool_stat_t *mem_pool_stat = NULL;
+#ifdef WITH_MEM_PROFILE
+#ifndef HAVE_ATOMIC_BUILTINS
+#error "ENABLE_MEM_PROFILE requires atomic builtins"
+#endif
+/* Fixed size shared table of the per-tag counters; extra tags are not accounted */
+#define MEM_PROFILE_MAX_TAGS 64
+static struct rspamd_mempool_tag_stat *mem_profile_tags = NULL;
+#endif
 /* Environment variable */
 static gboolean env_checked = FALSE;
 static gboolean always_malloc = FALSE;
@@ -170,6 +179,71 @@ rspamd_mempool_get_entry(const char *loc)
 	return rspamd_mempool_entry_new(loc);
 }
 
+/*
+ * Cache of chunks released by destroyed pools, segregated into power of two
+ * size classes. Workers are single threaded processes, so no locking is
+ * needed; recycling a chunk merely relinks it instead of going through the
+ * system allocator, which matters with the task pools churn
+ */
+#define MEMPOOL_CACHE_MIN_SHIFT 12 /* 4K, a typical chunk is one page */
+#define MEMPOOL_CACHE_MAX_SHIFT 20 /* Chunks above 1M are always released */
+#define MEMPOOL_CACHE_NCLASSES (MEMPOOL_CACHE_MAX_SHIFT - MEMPOOL_CACHE_MIN_SHIFT + 1)
+#define MEMPOOL_CACHE_MAX_BYTES (4UL * 1024 * 1024)
+
+static struct _pool_chain *mempool_chunk_cache[MEMPOOL_CACHE_NCLASSES];
+static gsize mempool_chunk_cache_bytes = 0;
+
+/*
+ * Chunks are filed under the floor of their log2 size, so everything in a
+ * class (and above) is at least as large as the class boundary
+ */
+static struct _pool_chain *
+rspamd_mempool_cache_get(gsize total_size)
+{
+	struct _pool_chain *chain;
+	int cls;
+
+	cls = (int) g_bit_storage(total_size - 1) - MEMPOOL_CACHE_MIN_SHIFT;
+
+	if (cls < 0) {
+		cls = 0;
+	}
+
+	for (; cls < MEMPOOL_CACHE_NCLASSES; cls++) {
+		chain = mempool_chunk_cache[cls];
+
+		if (chain != NULL) {
+			mempool_chunk_cache[cls] = chain->next;
+			mempool_chunk_cache_bytes -= chain->slice_size +
+										 sizeof(struct _pool_chain);
+			chain->next = NULL;
+
+			return chain;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+rspamd_mempool_cache_put(struct _pool_chain *chain)
+{
+	gsize total_size = chain->slice_size + sizeof(struct _pool_chain);
+	int cls;
+
+	cls = (int) g_bit_storage(total_size) - 1 - MEMPOOL_CACHE_MIN_SHIFT;
+
+	if (cls < 0 || cls >= MEMPOOL_CACHE_NCLASSES ||
+		mempool_chunk_cache_bytes + total_size > MEMPOOL_CACHE_MAX_BYTES) {
+		free(chain); /* Not g_free as we use system allocator */
+	}
+	else {
+		chain->next = mempool_chunk_cache[cls];
+		mempool_chunk_cache[cls] = chain;
+		mempool_chunk_cache_bytes += total_size;
+	}
+}
+
 static struct _pool_chain *
 rspamd_mempool_chain_new(gsize size, gsize alignment, enum rspamd_mempool_chain_type pool_type)
 {
@@ -222,6 +296,18 @@ rspamd_mempool_chain_new(gsize size, gsize alignment, enum rspamd_mempool_chain_
 		g_atomic_int_add(&mem_pool_stat->bytes_allocated, total_size);
 	}
 	else {
+		chain = rspamd_mempool_cache_get(total_size);
+
+		if (chain != NULL) {
+			/* Keep the recycled chunk's own slice size, it can be larger */
+			chain->pos = align_ptr(chain->begin, alignment);
+			g_atomic_int_add(&mem_pool_stat->bytes_allocated,
+							 chain->slice_size + sizeof(struct _pool_chain));
+			g_atomic_int_inc(&mem_pool_stat->chunks_allocated);
+
+			return chain;
+		}
+
 #ifdef HAVE_MALLOC_SIZE
 		optimal_size = sys_alloc_size(total_size);
 #endif
@@ -247,6 +333,61 @@ rspamd_mempool_chain_new(gsize size, gsize alignment, enum rspamd_mempool_chain_
 }
 
 
+#ifdef WITH_MEM_PROFILE
+static struct rspamd_mempool_tag_stat *
+rspamd_mempool_tag_stat_find(const char *tagname)
+{
+	struct rspamd_mempool_tag_stat *slot;
+	unsigned int i;
+
+	if (mem_profile_tags == NULL || tagname == NULL || tagname[0] == '\0') {
+		return NULL;
+	}
+
+	for (i = 0; i < MEM_PROFILE_MAX_TAGS; i++) {
+		slot = &mem_profile_tags[i];
+
+		if (g_atomic_int_get(&slot->used)) {
+			if (strcmp(slot->tagname, tagname) == 0) {
+				return slot;
+			}
+		}
+		else {
+			/*
+			 * Claim a free slot; tags are normally seen in the main process
+			 * before forking, so the race between workers here is merely a
+			 * theoretical one
+			 */
+			rspamd_strlcpy(slot->tagname, tagname, sizeof(slot->tagname));
+
+			if (g_atomic_int_compare_and_exchange(&slot->used, 0, 1) ||
+				strcmp(slot->tagname, tagname) == 0) {
+				return slot;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void
+rspamd_mempool_tag_stat_add(struct rspamd_mempool_tag_stat *slot, gsize sz)
+{
+	if (slot != NULL) {
+		__atomic_add_fetch(&slot->live_bytes, (uint64_t) sz, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&slot->total_bytes, (uint64_t) sz, __ATOMIC_RELEASE);
+	}
+}
+
+static void
+rspamd_mempool_tag_stat_sub(struct rspamd_mempool_tag_stat *slot, gsize sz)
+{
+	if (slot != NULL) {
+		__atomic_sub_fetch(&slot->live_bytes, (uint64_t) sz, __ATOMIC_RELEASE);
+	}
+}
+#endif
+
 /**
  * Get the current pool of the specified type, creating the corresponding
  * array if it's absent
@@ -284,19 +425,25 @@ rspamd_mempool_new_(gsize size, const char *tag, int flags, const char *loc)
 {
 	rspamd_mempool_t *new_pool;
 	gpointer map;
+	gsize stat_len = sizeof(rspamd_mempool_stat_t);
+
+#ifdef WITH_MEM_PROFILE
+	/* The tags table is mapped together with the common counters */
+	stat_len += MEM_PROFILE_MAX_TAGS * sizeof(struct rspamd_mempool_tag_stat);
+#endif
 
 	/* Allocate statistic structure if it is not allocated before */
 	if (mem_pool_stat == NULL) {
 #if defined(HAVE_MMAP_ANON)
 		map = mmap(NULL,
-				   sizeof(rspamd_mempool_stat_t),
+				   stat_len,
 				   PROT_READ | PROT_WRITE,
 				   MAP_ANON | MAP_SHARED,
 				   -1,
 				   0);
 		if (map == MAP_FAILED) {
 			msg_err("cannot allocate %z bytes, aborting",
-					sizeof(rspamd_mempool_stat_t));
+					stat_len);
 			abort();
 		}
 		mem_pool_stat = (rspamd_mempool_stat_t *) map;
@@ -306,21 +453,24 @@ rspamd_mempool_new_(gsize size, const char *tag, int flags, const char *loc)
 		fd = open("/dev/zero", O_RDWR);
 		g_assert(fd != -1);
 		map = mmap(NULL,
-				   sizeof(rspamd_mempool_stat_t),
+				   stat_len,
 				   PROT_READ | PROT_WRITE,
 				   MAP_SHARED,
 				   fd,
 				   0);
 		if (map == MAP_FAILED) {
 			msg_err("cannot allocate %z bytes, aborting",
-					sizeof(rspamd_mempool_stat_t));
+					stat_len);
 			abort();
 		}
 		mem_pool_stat = (rspamd_mempool_stat_t *) map;
 #else
 #error No mmap methods are defined
 #endif
-		memset(map, 0, sizeof(rspamd_mempool_stat_t));
+		memset(map, 0, stat_len);
+#ifdef WITH_MEM_PROFILE
+		mem_profile_tags = (struct rspamd_mempool_tag_stat *) (mem_pool_stat + 1);
+#endif
 	}
 
 	if (!env_checked) {
@@ -409,6 +559,17 @@ rspamd_mempool_new_(gsize size, const char *tag, int flags, const char *loc)
 
 	mem_pool_stat->pools_allocated++;
 
+#ifdef WITH_MEM_PROFILE
+	new_pool->priv->tag_stat = rspamd_mempool_tag_stat_find(new_pool->tag.tagname);
+
+	if (new_pool->priv->tag_stat) {
+		g_atomic_int_inc(&new_pool->priv->tag_stat->live_pools);
+		g_atomic_int_inc(&new_pool->priv->tag_stat->total_pools);
+		/* Account the chunk embedded into the pool itself */
+		rspamd_mempool_tag_stat_add(new_pool->priv->tag_stat, size);
+	}
+#endif
+
 	/* Now we can attach one chunk to speed up simple allocations */
 	struct _pool_chain *nchain;
 
@@ -528,6 +689,9 @@ memory_pool_alloc_common(rspamd_mempool_t *pool, gsize size, gsize alignment,
 
 			/* Connect to pool subsystem */
 			rspamd_mempool_append_chain(pool, new, pool_type);
+#ifdef WITH_MEM_PROFILE
+			rspamd_mempool_tag_stat_add(pool->priv->tag_stat, new->slice_size);
+#endif
 			/* No need to align again, aligned by rspamd_mempool_chain_new */
 			tmp = new->pos;
 			new->pos = tmp + size;
@@ -734,6 +898,25 @@ rspamd_mempool_adjust_entry(struct rspamd_mempool_entry_point *e)
 static void
 rspamd_mempool_variables_cleanup(rspamd_mempool_t *pool)
 {
+	if (pool->priv->known_vars_mask != 0) {
+		struct rspamd_mempool_variable *kvar;
+
+		for (unsigned int i = 0; i < RSPAMD_MEMPOOL_KNOWN_VARS; i++) {
+			if (pool->priv->known_vars_mask & (1u << i)) {
+				kvar = &pool->priv->known_vars[i];
+
+				if (kvar->dtor) {
+					kvar->dtor(kvar->data);
+				}
+			}
+		}
+
+		pool->priv->known_vars_mask = 0;
+	}
+
+	/* The slots themselves are allocated from the pool */
+	pool->priv->known_vars = NULL;
+
 	if (pool->priv->variables) {
 		struct rspamd_mempool_variable *var;
 		kh_foreach_value_ptr(pool->priv->variables, var, {
@@ -907,6 +1090,9 @@ void rspamd_mempool_delete(rspamd_mempool_t *pool)
 				g_atomic_int_add(&mem_pool_stat->bytes_allocated,
 								 -((int) cur->slice_size));
 				g_atomic_int_add(&mem_pool_stat->chunks_allocated, -1);
+#ifdef WITH_MEM_PROFILE
+				rspamd_mempool_tag_stat_sub(pool->priv->tag_stat, cur->slice_size);
+#endif
 
 				len = cur->slice_size + sizeof(struct _pool_chain);
 
@@ -916,7 +1102,7 @@ void rspamd_mempool_delete(rspamd_mempool_t *pool)
 				else {
 					/* The last pool is special, it is a part of the initial chunk */
 					if (cur->next != NULL) {
-						free(cur); /* Not g_free as we use system allocator */
+						rspamd_mempool_cache_put(cur);
 					}
 				}
 			}
@@ -924,6 +1110,11 @@ void rspamd_mempool_delete(rspamd_mempool_t *pool)
 	}
 
 	g_atomic_int_inc(&mem_pool_stat->pools_freed);
+#ifdef WITH_MEM_PROFILE
+	if (pool->priv->tag_stat) {
+		g_atomic_int_add(&pool->priv->tag_stat->live_pools, -1);
+	}
+#endif
 	POOL_MTX_UNLOCK();
 	free(pool); /* allocated by posix_memalign */
 }
@@ -948,6 +1139,23 @@ void rspamd_mempool_stat_reset(void)
 	}
 }
 
+#ifdef WITH_MEM_PROFILE
+void rspamd_mempool_tag_stat_foreach(rspamd_mempool_tag_stat_cb cb, gpointer ud)
+{
+	unsigned int i;
+
+	if (mem_profile_tags == NULL) {
+		return;
+	}
+
+	for (i = 0; i < MEM_PROFILE_MAX_TAGS; i++) {
+		if (g_atomic_int_get(&mem_profile_tags[i].used)) {
+			cb(&mem_profile_tags[i], ud);
+		}
+	}
+}
+#endif
+
 gsize rspamd_mempool_suggest_size_(const char *loc)
 {
 	return 0;
@@ -1156,11 +1364,84 @@ void rspamd_mempool_wunlock_rwlock(rspamd_mempool_rwlock_t *lock)
 }
 #endif
 
+/*
+ * Well known variables are resolved to fixed slots instead of being hashed
+ * at runtime; the list must not exceed RSPAMD_MEMPOOL_KNOWN_VARS entries
+ */
+static const char *const rspamd_mempool_known_var_names[] = {
+	RSPAMD_MEMPOOL_AVG_WORDS_LEN,
+	RSPAMD_MEMPOOL_SHORT_WORDS_CNT,
+	RSPAMD_MEMPOOL_HEADERS_HASH,
+	RSPAMD_MEMPOOL_MTA_TAG,
+	RSPAMD_MEMPOOL_MTA_NAME,
+	RSPAMD_MEMPOOL_SPF_DOMAIN,
+	RSPAMD_MEMPOOL_SPF_RECORD,
+	RSPAMD_MEMPOOL_PRINCIPAL_RECIPIENT,
+	RSPAMD_MEMPOOL_PROFILE,
+	RSPAMD_MEMPOOL_MILTER_REPLY,
+	RSPAMD_MEMPOOL_DKIM_SIGNATURE,
+	RSPAMD_MEMPOOL_DMARC_CHECKS,
+	RSPAMD_MEMPOOL_DKIM_BH_CACHE,
+	RSPAMD_MEMPOOL_DKIM_CHECK_RESULTS,
+	RSPAMD_MEMPOOL_DKIM_SIGN_KEY,
+	RSPAMD_MEMPOOL_DKIM_SIGN_SELECTOR,
+	RSPAMD_MEMPOOL_ARC_SIGN_KEY,
+	RSPAMD_MEMPOOL_ARC_SIGN_SELECTOR,
+	RSPAMD_MEMPOOL_STAT_SIGNATURE,
+	RSPAMD_MEMPOOL_FUZZY_RESULT,
+	RSPAMD_MEMPOOL_SPAM_LEARNS,
+	RSPAMD_MEMPOOL_HAM_LEARNS,
+	RSPAMD_MEMPOOL_RE_MAPS_CACHE,
+	RSPAMD_MEMPOOL_HTTP_STAT_BACKEND_RUNTIME,
+	RSPAMD_MEMPOOL_FUZZY_STAT,
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(rspamd_mempool_known_var_names) <=
+				RSPAMD_MEMPOOL_KNOWN_VARS);
+
+static inline int
+rspamd_mempool_known_var_idx(const char *name)
+{
+	/* The first character filter rejects most of the candidates cheaply */
+	for (unsigned int i = 0; i < G_N_ELEMENTS(rspamd_mempool_known_var_names); i++) {
+		if (rspamd_mempool_known_var_names[i][0] == name[0] &&
+			strcmp(rspamd_mempool_known_var_names[i] + 1, name + 1) == 0) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
 void rspamd_mempool_set_variable(rspamd_mempool_t *pool,
 								 const char *name,
 								 gpointer value,
 								 rspamd_mempool_destruct_t destructor)
 {
+	int kidx = rspamd_mempool_known_var_idx(name);
+
+	if (kidx != -1) {
+		struct rspamd_mempool_variable *pvar;
+
+		if (pool->priv->known_vars == NULL) {
+			pool->priv->known_vars = rspamd_mempool_alloc0(pool,
+														   sizeof(*pool->priv->known_vars) *
+															   RSPAMD_MEMPOOL_KNOWN_VARS);
+		}
+
+		pvar = &pool->priv->known_vars[kidx];
+
+		if ((pool->priv->known_vars_mask & (1u << kidx)) && pvar->dtor) {
+			pvar->dtor(pvar->data);
+		}
+
+		pvar->data = value;
+		pvar->dtor = destructor;
+		pool->priv->known_vars_mask |= (1u << kidx);
+
+		return;
+	}
+
 	if (pool->priv->variables == NULL) {
 
 		pool->priv->variables = kh_init(rspamd_mempool_vars_hash);
@@ -1206,6 +1487,16 @@ void rspamd_mempool_set_variable(rspamd_mempool_t *pool,
 gpointer
 rspamd_mempool_get_variable(rspamd_mempool_t *pool, const char *name)
 {
+	int kidx = rspamd_mempool_known_var_idx(name);
+
+	if (kidx != -1) {
+		if (pool->priv->known_vars_mask & (1u << kidx)) {
+			return pool->priv->known_vars[kidx].data;
+		}
+
+		return NULL;
+	}
+
 	if (pool->priv->variables == NULL) {
 		return NULL;
 	}
@@ -1227,6 +1518,18 @@ rspamd_mempool_get_variable(rspamd_mempool_t *pool, const char *name)
 gpointer
 rspamd_mempool_steal_variable(rspamd_mempool_t *pool, const char *name)
 {
+	int kidx = rspamd_mempool_known_var_idx(name);
+
+	if (kidx != -1) {
+		if (pool->priv->known_vars_mask & (1u << kidx)) {
+			pool->priv->known_vars_mask &= ~(1u << kidx);
+
+			return pool->priv->known_vars[kidx].data;
+		}
+
+		return NULL;
+	}
+
 	if (pool->priv->variables == NULL) {
 		return NULL;
 	}
@@ -1248,6 +1551,24 @@ rspamd_mempool_steal_variable(rspamd_mempool_t *pool, const char *name)
 
 void rspamd_mempool_remove_variable(rspamd_mempool_t *pool, const char *name)
 {
+	int kidx = rspamd_mempool_known_var_idx(name);
+
+	if (kidx != -1) {
+		if (pool->priv->known_vars_mask & (1u << kidx)) {
+			struct rspamd_mempool_variable *pvar;
+
+			pvar = &pool->priv->known_vars[kidx];
+
+			if (pvar->dtor) {
+				pvar->dtor(pvar->data);
+			}
+
+			pool->priv->known_vars_mask &= ~(1u << kidx);
+		}
+
+		return;
+	}
+
 	if (pool->priv->variables != NULL) {
 		khiter_t it;
 
@@ -138,6 +138,31 @@ typedef struct memory_pool_stat_s {
 	unsigned int fragmented_size;         /**< fragmentation size								*/
 } rspamd_mempool_stat_t;
 
+#ifdef WITH_MEM_PROFILE
+/**
+ * Per-tag accounting entry available when rspamd is built with
+ * -DENABLE_MEM_PROFILE=ON; counters are shared between all forked processes
+ * and are maintained at chunk granularity
+ */
+struct rspamd_mempool_tag_stat {
+	char tagname[MEMPOOL_TAG_LEN]; /**< pool tag (subsystem name)				*/
+	int used;                      /**< slot is claimed (private)				*/
+	uint64_t live_bytes;           /**< bytes currently held in pool chunks	*/
+	uint64_t total_bytes;          /**< bytes ever attached to pools			*/
+	unsigned int live_pools;       /**< pools currently alive					*/
+	unsigned int total_pools;      /**< pools ever created						*/
+};
+
+typedef void (*rspamd_mempool_tag_stat_cb)(const struct rspamd_mempool_tag_stat *st,
+										   gpointer ud);
+/**
+ * Iterates over the per-tag allocation counters
+ * @param cb callback called for each tag seen so far
+ * @param ud opaque data for the callback
+ */
+void rspamd_mempool_tag_stat_foreach(rspamd_mempool_tag_stat_cb cb, gpointer ud);
+#endif
+
 
 /**
  * Allocate new memory poll
@@ -450,7 +475,7 @@ public:
 	}
 	[[nodiscard]] constexpr T *allocate(std::size_t n)
 	{
-		if (G_MAXSIZE / 2 / sizeof(T) > n) {
+		if (G_MAXSIZE / 2 / sizeof(T) < n) {
 			throw std::runtime_error("integer overflow");
 		}
 		return reinterpret_cast<T *>(rspamd_mempool_alloc(pool, n * sizeof(T)));
@@ -460,7 +485,20 @@ public:
 		/* Do nothing */
 	}
 
+	template<class U>
+	constexpr bool operator==(const mempool_allocator<U> &other) const
+	{
+		return pool == other.pool;
+	}
+	template<class U>
+	constexpr bool operator!=(const mempool_allocator<U> &other) const
+	{
+		return pool != other.pool;
+	}
+
 private:
+	template<class U>
+	friend class mempool_allocator;
 	rspamd_mempool_t *pool;
 };
 
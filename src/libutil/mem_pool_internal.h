@@ -66,16 +66,28 @@ KHASH_INIT(rspamd_mempool_vars_hash,
 		   const char *, struct rspamd_mempool_variable, 1,
 		   kh_str_hash_func, kh_str_hash_equal);
 
+/*
+ * Number of fixed slots for the well-known variables from
+ * mempool_vars_internal.h; those are resolved to indices instead of being
+ * hashed at runtime, while arbitrary names fall back to the variables hash
+ */
+#define RSPAMD_MEMPOOL_KNOWN_VARS 32
+
 struct rspamd_mempool_specific {
 	struct _pool_chain *pools[RSPAMD_MEMPOOL_MAX];
 	struct _pool_destructors *dtors_head, *dtors_tail;
 	GPtrArray *trash_stack;
 	khash_t(rspamd_mempool_vars_hash) * variables;
+	struct rspamd_mempool_variable *known_vars; /**< lazily allocated fixed slots */
+	uint32_t known_vars_mask;                   /**< bitmap of the slots in use	*/
 	struct rspamd_mempool_entry_point *entry;
 	gsize elt_len; /**< size of an element						*/
 	gsize used_memory;
 	unsigned int wasted_memory;
 	int flags;
+#ifdef WITH_MEM_PROFILE
+	struct rspamd_mempool_tag_stat *tag_stat; /**< accounting slot of the pool tag */
+#endif
 };
 
 /**
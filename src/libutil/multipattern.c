@@ -19,9 +19,9 @@
 #include "libutil/str_util.h"
 #include "libcryptobox/cryptobox.h"
 
-#ifdef WITH_HYPERSCAN
 #include "logger.h"
 #include "unix-std.h"
+#ifdef WITH_HYPERSCAN
 #include "hs.h"
 #include "libserver/hyperscan_tools.h"
 #endif
@@ -465,6 +465,130 @@ rspamd_multipattern_try_save_hs(struct rspamd_multipattern *mp,
 }
 #endif
 
+/*
+ * Hashes the pattern set together with the automaton geometry, so cache files
+ * written by an incompatible build (e.g. different ACISM_SIZE) never collide
+ * with ours; mirrors what the hyperscan path does with the platform info
+ */
+static void
+rspamd_multipattern_acism_hash(struct rspamd_multipattern *mp,
+							   unsigned char *out)
+{
+	rspamd_cryptobox_hash_state_t st;
+	const uint32_t salt[2] = {(uint32_t) sizeof(ac_trie_t), 1};
+	unsigned int i;
+
+	rspamd_cryptobox_hash_init(&st, NULL, 0);
+	rspamd_cryptobox_hash_update(&st, (const unsigned char *) salt, sizeof(salt));
+
+	for (i = 0; i < mp->cnt; i++) {
+		const ac_trie_pat_t *pat = &g_array_index(mp->pats, ac_trie_pat_t, i);
+
+		rspamd_cryptobox_hash_update(&st, (const unsigned char *) &pat->len,
+									 sizeof(pat->len));
+		rspamd_cryptobox_hash_update(&st, (const unsigned char *) pat->ptr, pat->len);
+	}
+
+	rspamd_cryptobox_hash_final(&st, out);
+}
+
+static gboolean
+rspamd_multipattern_try_load_acism(struct rspamd_multipattern *mp,
+								   const unsigned char *hash)
+{
+	char fp[PATH_MAX];
+	int fd;
+	struct stat st;
+	void *map;
+
+	if (hs_cache_dir == NULL) {
+		return FALSE;
+	}
+
+	rspamd_snprintf(fp, sizeof(fp), "%s/%*xs.acsm", hs_cache_dir,
+					(int) rspamd_cryptobox_HASHBYTES / 2, hash);
+
+	fd = open(fp, O_RDONLY);
+
+	if (fd == -1) {
+		return FALSE;
+	}
+
+	if (fstat(fd, &st) == -1 || st.st_size <= (goffset) sizeof(ac_trie_t)) {
+		close(fd);
+
+		return FALSE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		return FALSE;
+	}
+
+	/* The mapping ownership is transferred to the trie on success */
+	mp->t = acism_load(map, st.st_size);
+
+	if (mp->t == NULL) {
+		msg_warn("invalid acism cache file %s, removing it", fp);
+		munmap(map, st.st_size);
+		unlink(fp);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+rspamd_multipattern_try_save_acism(struct rspamd_multipattern *mp,
+								   const unsigned char *hash)
+{
+	char fp[PATH_MAX], np[PATH_MAX];
+	unsigned char *bytes;
+	gsize len;
+	int fd;
+
+	if (hs_cache_dir == NULL || mp->t == NULL) {
+		return;
+	}
+
+	rspamd_snprintf(fp, sizeof(fp), "%s%sacsm-XXXXXXXXXXXXX", hs_cache_dir,
+					G_DIR_SEPARATOR_S);
+
+	if ((fd = g_mkstemp_full(fp, O_CREAT | O_EXCL | O_WRONLY, 00644)) != -1) {
+		len = acism_serialized_size(mp->t);
+		bytes = g_malloc(len);
+		acism_serialize(mp->t, bytes);
+
+		if (write(fd, bytes, len) == -1) {
+			msg_warn("cannot write acism cache to %s: %s",
+					 fp, strerror(errno));
+			unlink(fp);
+		}
+		else {
+			fsync(fd);
+
+			rspamd_snprintf(np, sizeof(np), "%s/%*xs.acsm", hs_cache_dir,
+							(int) rspamd_cryptobox_HASHBYTES / 2, hash);
+
+			if (rename(fp, np) == -1) {
+				msg_warn("cannot rename acism cache from %s to %s: %s",
+						 fp, np, strerror(errno));
+				unlink(fp);
+			}
+		}
+
+		g_free(bytes);
+		close(fd);
+	}
+	else {
+		msg_warn("cannot open a temp file %s to write acism cache: %s", fp,
+				 strerror(errno));
+	}
+}
+
 gboolean
 rspamd_multipattern_compile(struct rspamd_multipattern *mp, int flags, GError **err)
 {
@@ -583,7 +707,21 @@ rspamd_multipattern_compile(struct rspamd_multipattern *mp, int flags, GError **
 			}
 		}
 		else {
-			mp->t = acism_create((const ac_trie_pat_t *) mp->pats->data, mp->cnt);
+			unsigned char hash[rspamd_cryptobox_HASHBYTES];
+
+			if (!(flags & RSPAMD_MULTIPATTERN_COMPILE_NO_FS) && hs_cache_dir != NULL) {
+				rspamd_multipattern_acism_hash(mp, hash);
+
+				if (!rspamd_multipattern_try_load_acism(mp, hash)) {
+					mp->t = acism_create((const ac_trie_pat_t *) mp->pats->data,
+										 mp->cnt);
+					rspamd_multipattern_try_save_acism(mp, hash);
+				}
+			}
+			else {
+				mp->t = acism_create((const ac_trie_pat_t *) mp->pats->data,
+									 mp->cnt);
+			}
 		}
 	}
 
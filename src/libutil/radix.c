@@ -38,9 +38,23 @@
 
 INIT_LOG_MODULE(radix)
 
+/*
+ * A compiled read only projection of the trie: the prefix set is flattened
+ * into disjoint intervals, so a longest prefix match becomes a binary search
+ * over a contiguous array touching a couple of cache lines instead of
+ * chasing trie nodes; it is built once after a map is fully loaded and
+ * is dropped on any subsequent insertion
+ */
+struct radix_static_elt {
+	uint8_t start[16]; /* boundary address, network byte order */
+	uintptr_t value;   /* value in effect from this boundary on */
+};
+
 struct radix_tree_compressed {
 	rspamd_mempool_t *pool;
 	struct btrie *tree;
+	struct radix_static_elt *st_elts;
+	gsize st_nelts;
 	const char *name;
 	size_t size;
 	unsigned int duplicates;
@@ -54,6 +68,29 @@ radix_find_compressed(radix_compressed_t *tree, const uint8_t *key, gsize keylen
 
 	g_assert(tree != NULL);
 
+	if (tree->st_nelts > 0 && keylen == sizeof(tree->st_elts->start)) {
+		/* Find the greatest boundary that is not above the key */
+		gsize l = 0, r = tree->st_nelts;
+
+		while (l < r) {
+			gsize mid = (l + r) / 2;
+
+			if (memcmp(tree->st_elts[mid].start, key,
+					   sizeof(tree->st_elts->start)) <= 0) {
+				l = mid + 1;
+			}
+			else {
+				r = mid;
+			}
+		}
+
+		if (l == 0) {
+			return RADIX_NO_VALUE;
+		}
+
+		return tree->st_elts[l - 1].value;
+	}
+
 	ret = btrie_lookup(tree->tree, key, keylen * NBBY);
 
 	if (ret == NULL) {
@@ -82,6 +119,12 @@ radix_insert_compressed(radix_compressed_t *tree,
 	msg_debug_radix("%s: want insert value %p with mask %z, key: %*xs",
 					tree->name, (gpointer) value, keybits - masklen, (int) keylen, key);
 
+	if (tree->st_nelts > 0) {
+		/* The compiled projection no longer matches the trie */
+		tree->st_elts = NULL;
+		tree->st_nelts = 0;
+	}
+
 	old = radix_find_compressed(tree, key, keylen);
 
 	ret = btrie_add_prefix(tree->tree, key, keybits - masklen,
@@ -143,6 +186,8 @@ radix_create_compressed(const char *tree_name)
 	tree->size = 0;
 	tree->duplicates = 0;
 	tree->tree = btrie_init(tree->pool);
+	tree->st_elts = NULL;
+	tree->st_nelts = 0;
 	tree->own_pool = TRUE;
 	tree->name = tree_name;
 
@@ -159,6 +204,8 @@ radix_create_compressed_with_pool(rspamd_mempool_t *pool, const char *tree_name)
 	tree->size = 0;
 	tree->duplicates = 0;
 	tree->tree = btrie_init(tree->pool);
+	tree->st_elts = NULL;
+	tree->st_nelts = 0;
 	tree->own_pool = FALSE;
 	tree->name = tree_name;
 
@@ -207,6 +254,178 @@ radix_find_compressed_addr(radix_compressed_t *tree,
 	return RADIX_NO_VALUE;
 }
 
+struct radix_compile_prefix {
+	uint8_t start[16];
+	uint8_t end[16];
+	uintptr_t value;
+	unsigned int masklen;
+};
+
+static void
+radix_compile_collect_cb(const btrie_oct_t *prefix, unsigned int len,
+						 const void *data, int post, void *user_data)
+{
+	GArray *prefixes = (GArray *) user_data;
+	struct radix_compile_prefix p;
+	unsigned int nbytes = len / NBBY, rem = len % NBBY;
+
+	if (post || data == NULL || len > sizeof(p.start) * NBBY) {
+		return;
+	}
+
+	memset(p.start, 0, sizeof(p.start));
+	memcpy(p.start, prefix, nbytes + (rem ? 1 : 0));
+
+	if (rem) {
+		p.start[nbytes] &= 0xFFu << (NBBY - rem);
+	}
+
+	memset(p.end, 0xFF, sizeof(p.end));
+	memcpy(p.end, p.start, nbytes);
+
+	if (rem) {
+		p.end[nbytes] = p.start[nbytes] | (0xFFu >> rem);
+	}
+
+	p.value = (uintptr_t) data;
+	p.masklen = len;
+	g_array_append_val(prefixes, p);
+}
+
+static int
+radix_compile_prefix_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct radix_compile_prefix *p1 = a, *p2 = b;
+	int r = memcmp(p1->start, p2->start, sizeof(p1->start));
+
+	if (r == 0) {
+		/* A shorter prefix goes first, so the nested one is applied on top */
+		return (int) p1->masklen - (int) p2->masklen;
+	}
+
+	return r;
+}
+
+static void
+radix_compile_emit(GArray *elts, const uint8_t *addr, uintptr_t value)
+{
+	struct radix_static_elt e, *last;
+
+	if (elts->len > 0) {
+		last = &g_array_index(elts, struct radix_static_elt, elts->len - 1);
+
+		if (memcmp(last->start, addr, sizeof(last->start)) == 0) {
+			last->value = value;
+
+			return;
+		}
+
+		if (last->value == value) {
+			/* Merge the adjacent intervals with the same value */
+			return;
+		}
+	}
+
+	memcpy(e.start, addr, sizeof(e.start));
+	e.value = value;
+	g_array_append_val(elts, e);
+}
+
+static gboolean
+radix_compile_addr_inc(uint8_t *addr)
+{
+	int i;
+
+	for (i = 15; i >= 0; i--) {
+		if (++addr[i] != 0) {
+			return TRUE;
+		}
+	}
+
+	/* Overflow, the address was all ones */
+	return FALSE;
+}
+
+void radix_compile_compressed(radix_compressed_t *tree)
+{
+	GArray *prefixes, *elts, *stack;
+	struct radix_compile_prefix *p, *top;
+	uint8_t next[16];
+	unsigned int i;
+
+	g_assert(tree != NULL);
+
+	tree->st_elts = NULL;
+	tree->st_nelts = 0;
+
+	if (tree->size == 0) {
+		return;
+	}
+
+	prefixes = g_array_sized_new(FALSE, FALSE,
+								 sizeof(struct radix_compile_prefix), tree->size);
+	btrie_walk(tree->tree, radix_compile_collect_cb, prefixes);
+	g_array_sort(prefixes, radix_compile_prefix_cmp);
+
+	elts = g_array_sized_new(FALSE, FALSE, sizeof(struct radix_static_elt),
+							 prefixes->len * 2);
+	stack = g_array_new(FALSE, FALSE, sizeof(struct radix_compile_prefix));
+
+	/*
+	 * Sweep over the sorted prefixes keeping the stack of the not yet closed
+	 * ones; a boundary is emitted when a prefix starts and when the innermost
+	 * one ends, reverting to the value of its enclosing prefix
+	 */
+	for (i = 0; i < prefixes->len; i++) {
+		p = &g_array_index(prefixes, struct radix_compile_prefix, i);
+
+		while (stack->len > 0) {
+			top = &g_array_index(stack, struct radix_compile_prefix,
+								 stack->len - 1);
+
+			if (memcmp(top->end, p->start, sizeof(top->end)) >= 0) {
+				break;
+			}
+
+			memcpy(next, top->end, sizeof(next));
+			g_array_set_size(stack, stack->len - 1);
+
+			if (radix_compile_addr_inc(next)) {
+				radix_compile_emit(elts, next,
+								   stack->len > 0 ? g_array_index(stack, struct radix_compile_prefix, stack->len - 1).value : RADIX_NO_VALUE);
+			}
+		}
+
+		radix_compile_emit(elts, p->start, p->value);
+		g_array_append_val(stack, *p);
+	}
+
+	while (stack->len > 0) {
+		top = &g_array_index(stack, struct radix_compile_prefix,
+							 stack->len - 1);
+		memcpy(next, top->end, sizeof(next));
+		g_array_set_size(stack, stack->len - 1);
+
+		if (radix_compile_addr_inc(next)) {
+			radix_compile_emit(elts, next,
+							   stack->len > 0 ? g_array_index(stack, struct radix_compile_prefix, stack->len - 1).value : RADIX_NO_VALUE);
+		}
+	}
+
+	tree->st_elts = rspamd_mempool_alloc(tree->pool,
+										 elts->len * sizeof(struct radix_static_elt));
+	memcpy(tree->st_elts, elts->data,
+		   elts->len * sizeof(struct radix_static_elt));
+	tree->st_nelts = elts->len;
+
+	msg_debug_radix("%s: compiled %ud prefixes into %z intervals",
+					tree->name, prefixes->len, tree->st_nelts);
+
+	g_array_free(prefixes, TRUE);
+	g_array_free(elts, TRUE);
+	g_array_free(stack, TRUE);
+}
+
 int rspamd_radix_add_iplist(const char *list, const char *separators,
 							radix_compressed_t *tree, gconstpointer value,
 							gboolean resolve, const char *tree_name)
@@ -97,6 +97,15 @@ radix_add_generic_iplist(const char *ip_list,
 						 gboolean resolve,
 						 const char *tree_name);
 
+/**
+ * Compile the trie into a read only interval table, turning the longest
+ * prefix match into a binary search over contiguous memory; intended for
+ * maps that are loaded once and then merely looked up. Any subsequent
+ * insertion invalidates the compiled form, falling back to the trie.
+ * @param tree
+ */
+void radix_compile_compressed(radix_compressed_t *tree);
+
 /**
  * Returns number of elements in the tree
  * @param tree
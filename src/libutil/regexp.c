@@ -71,6 +71,8 @@ struct rspamd_regexp_s {
 	int flags;
 	int pcre_flags;
 	int ncaptures;
+	char *prefilter_lit;
+	gsize prefilter_len;
 };
 
 struct rspamd_regexp_cache {
@@ -153,6 +155,10 @@ rspamd_regexp_dtor(rspamd_regexp_t *re)
 			g_free(re->pattern);
 		}
 
+		if (re->prefilter_lit) {
+			g_free(re->prefilter_lit);
+		}
+
 		g_free(re);
 	}
 }
@@ -186,48 +192,17 @@ rspamd_regexp_post_process(rspamd_regexp_t *r)
 	}
 
 #ifdef HAVE_PCRE_JIT
-	unsigned int jit_flags = can_jit ? PCRE2_JIT_COMPLETE : 0;
-	gsize jsz;
-	PCRE2_UCHAR errstr[128];
-	int errcode;
-
 	if (can_jit) {
-		if ((errcode = pcre2_jit_compile(r->re, jit_flags)) < 0) {
-			pcre2_get_error_message(errcode, errstr, G_N_ELEMENTS(errstr));
-			msg_err("jit compilation is not supported: %s; pattern: \"%s\"", errstr, r->pattern);
-			r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
-		}
-		else {
-			if (!(pcre2_pattern_info(r->re, PCRE2_INFO_JITSIZE, &jsz) >= 0 && jsz > 0)) {
-				msg_err("cannot exec pcre2_pattern_info(PCRE2_INFO_JITSIZE) on \"%s\"", r->pattern);
-				r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
-			}
-		}
+		/*
+		 * Defer the actual JIT compilation to the first search: expressions
+		 * that never fire in a worker then cost neither JIT time nor JIT
+		 * memory, and startup does not pay for the whole rule set up front
+		 */
+		r->flags |= RSPAMD_REGEXP_FLAG_JIT_PENDING;
 	}
 	else {
 		r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
 	}
-
-	if (!(r->flags & RSPAMD_REGEXP_FLAG_DISABLE_JIT)) {
-		pcre2_jit_stack_assign(r->mcontext, NULL, global_re_cache->jstack);
-	}
-
-	if (r->raw_re && r->re != r->raw_re && !(r->flags & RSPAMD_REGEXP_FLAG_DISABLE_JIT)) {
-		if ((errcode = pcre2_jit_compile(r->raw_re, jit_flags)) < 0) {
-			pcre2_get_error_message(errcode, errstr, G_N_ELEMENTS(errstr));
-			msg_debug("jit compilation is not supported for raw regexp: %s; pattern: \"%s\"", errstr, r->pattern);
-			r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
-		}
-		else {
-			if (!(pcre2_pattern_info(r->raw_re, PCRE2_INFO_JITSIZE, &jsz) >= 0 && jsz > 0)) {
-				msg_err("cannot exec pcre2_pattern_info(PCRE2_INFO_JITSIZE) on \"%s\"", r->pattern);
-			}
-			else if (!(r->flags & RSPAMD_REGEXP_FLAG_DISABLE_JIT)) {
-				g_assert(r->raw_mcontext != NULL);
-				pcre2_jit_stack_assign(r->raw_mcontext, NULL, global_re_cache->jstack);
-			}
-		}
-	}
 #endif
 
 #else
@@ -319,6 +294,198 @@ rspamd_regexp_post_process(rspamd_regexp_t *r)
 #endif /* WITH_PCRE2 */
 }
 
+/*
+ * Conservatively extracts a mandatory literal from the pattern. The literal is
+ * used as a cheap substring pre-check in rspamd_regexp_search: when the input
+ * does not contain it, the pcre machinery is not invoked at all. That is the
+ * same trick that re_cache plays with hyperscan, extended to ad hoc
+ * expressions created from Lua that bypass re_cache batching. The extraction
+ * gives up on anything that could make a literal optional (alternations,
+ * quantifiers, groups, variable length escapes), so many patterns end up with
+ * no literal at all, which merely means that the fast path is not applied.
+ */
+static void
+rspamd_regexp_extract_prefilter(rspamd_regexp_t *r)
+{
+	static const gsize min_prefilter_len = 4;
+	const char *p = r->pattern, *endp = p + strlen(r->pattern);
+	GString *cur, *best;
+	int depth = 0;
+	gboolean bail = FALSE;
+	gsize i;
+
+	if (r->pcre_flags & PCRE_FLAG(EXTENDED)) {
+		/* Whitespace and comments have special meaning, do not even try */
+		return;
+	}
+
+	cur = g_string_sized_new(16);
+	best = g_string_sized_new(16);
+
+/* Stash the current literal run; runs inside groups are never trusted */
+#define PREFILTER_COMMIT_RUN                          \
+	do {                                              \
+		if (depth == 0 && cur->len > best->len) {     \
+			g_string_assign(best, cur->str);          \
+		}                                             \
+		g_string_truncate(cur, 0);                    \
+	} while (0)
+
+	while (p < endp && !bail) {
+		char c = *p;
+		const char *next = p + 1;
+		gboolean is_literal = FALSE;
+
+		if (c == '\\') {
+			if (next >= endp) {
+				bail = TRUE;
+				break;
+			}
+
+			if (g_ascii_ispunct(*next)) {
+				/* Escaped metacharacter stands for itself */
+				c = *next;
+				next++;
+				is_literal = TRUE;
+			}
+			else if (strchr("xcNpPkgoQE0123456789", *next) != NULL) {
+				/* Escapes that consume a variable amount of characters */
+				bail = TRUE;
+				break;
+			}
+			else {
+				/* Class shorthand or anchor: just breaks the literal run */
+				PREFILTER_COMMIT_RUN;
+				next++;
+			}
+		}
+		else if (c == '(') {
+			if (next < endp && *next == '?' &&
+				next + 1 < endp && strchr(":=!<#P'", next[1]) == NULL) {
+				/* Inline flags, recursion and friends change semantics */
+				bail = TRUE;
+				break;
+			}
+
+			PREFILTER_COMMIT_RUN;
+			depth++;
+		}
+		else if (c == ')') {
+			/* Discard anything gathered inside the group, it can be optional */
+			g_string_truncate(cur, 0);
+			depth--;
+		}
+		else if (c == '|') {
+			if (depth == 0) {
+				/* Top level alternation: nothing is mandatory */
+				bail = TRUE;
+				break;
+			}
+
+			g_string_truncate(cur, 0);
+		}
+		else if (c == '[') {
+			const char *cl = next;
+
+			PREFILTER_COMMIT_RUN;
+
+			/* Skip the character class */
+			if (cl < endp && *cl == '^') {
+				cl++;
+			}
+			if (cl < endp && *cl == ']') {
+				cl++;
+			}
+			while (cl < endp && *cl != ']') {
+				if (*cl == '\\') {
+					cl++;
+				}
+				cl++;
+			}
+
+			if (cl >= endp) {
+				bail = TRUE;
+				break;
+			}
+
+			next = cl + 1;
+		}
+		else if (c == '.' || c == '^' || c == '$' ||
+				 c == '?' || c == '*' || c == '+') {
+			PREFILTER_COMMIT_RUN;
+		}
+		else if (c == '{') {
+			const char *q = next;
+
+			PREFILTER_COMMIT_RUN;
+
+			/* Skip counted repetitions; a stray brace is simply not gathered */
+			while (q < endp && (g_ascii_isdigit(*q) || *q == ',')) {
+				q++;
+			}
+			if (q > next && q < endp && *q == '}') {
+				next = q + 1;
+			}
+		}
+		else {
+			is_literal = TRUE;
+		}
+
+		if (is_literal) {
+			if (next < endp && (*next == '?' || *next == '*')) {
+				/* The quantifier makes this character optional */
+				PREFILTER_COMMIT_RUN;
+			}
+			else if (next < endp && *next == '+') {
+				/* Mandatory at least once, but repetition breaks adjacency */
+				g_string_append_c(cur, c);
+				PREFILTER_COMMIT_RUN;
+			}
+			else if (next < endp && *next == '{') {
+				/* Counted repetition: mandatory merely when the lower bound is not 0 */
+				if (next + 1 < endp && g_ascii_isdigit(next[1]) && next[1] != '0') {
+					g_string_append_c(cur, c);
+				}
+				PREFILTER_COMMIT_RUN;
+			}
+			else {
+				g_string_append_c(cur, c);
+			}
+		}
+
+		p = next;
+	}
+
+	PREFILTER_COMMIT_RUN;
+#undef PREFILTER_COMMIT_RUN
+
+	if (!bail && best->len >= min_prefilter_len) {
+		if (r->pcre_flags & PCRE_FLAG(CASELESS)) {
+			/* The caseless substring search deals with ASCII merely */
+			for (i = 0; i < best->len; i++) {
+				if ((unsigned char) best->str[i] >= 0x80) {
+					bail = TRUE;
+					break;
+				}
+
+				best->str[i] = g_ascii_tolower(best->str[i]);
+			}
+		}
+
+		if (!bail) {
+			r->prefilter_len = best->len;
+			r->prefilter_lit = g_string_free(best, FALSE);
+			best = NULL;
+		}
+	}
+
+	if (best) {
+		g_string_free(best, TRUE);
+	}
+
+	g_string_free(cur, TRUE);
+}
+
 rspamd_regexp_t *
 rspamd_regexp_new_len(const char *pattern, gsize len, const char *flags,
 					  GError **err)
@@ -537,6 +704,10 @@ fin:
 	}
 #endif
 
+	if (!(rspamd_flags & RSPAMD_REGEXP_FLAG_NOOPT)) {
+		rspamd_regexp_extract_prefilter(res);
+	}
+
 	return res;
 }
 
@@ -547,6 +718,23 @@ rspamd_regexp_new(const char *pattern, const char *flags,
 	return rspamd_regexp_new_len(pattern, strlen(pattern), flags, err);
 }
 
+/*
+ * Returns FALSE when the mandatory literal of a regexp is absent in the input,
+ * so the proper match cannot succeed and pcre should not be invoked at all
+ */
+static inline gboolean
+rspamd_regexp_prefilter_pass(const rspamd_regexp_t *re,
+							 const char *mt, gsize remain)
+{
+	if (re->pcre_flags & PCRE_FLAG(CASELESS)) {
+		return rspamd_substring_search_caseless(mt, remain,
+												re->prefilter_lit, re->prefilter_len) != (-1);
+	}
+
+	return rspamd_substring_search(mt, remain,
+								   re->prefilter_lit, re->prefilter_len) != (-1);
+}
+
 #ifndef WITH_PCRE2
 gboolean
 rspamd_regexp_search(const rspamd_regexp_t *re, const char *text, gsize len,
@@ -620,6 +808,11 @@ rspamd_regexp_search(const rspamd_regexp_t *re, const char *text, gsize len,
 		return FALSE;
 	}
 
+	if (re->prefilter_lit != NULL && (end == NULL || *end == NULL) &&
+		!rspamd_regexp_prefilter_pass(re, mt, remain)) {
+		return FALSE;
+	}
+
 	ncaptures = (re->ncaptures + 1) * 3;
 	ovec = g_alloca(sizeof(int) * ncaptures);
 
@@ -710,6 +903,56 @@ rspamd_regexp_search(const rspamd_regexp_t *re, const char *text, gsize len,
 }
 #else
 /* PCRE 2 version */
+
+#ifdef HAVE_PCRE_JIT
+/*
+ * Compile the pattern with the JIT engine on first search; creation merely
+ * marks the regexp as pending, see rspamd_regexp_post_process
+ */
+static void
+rspamd_regexp_jit_compile_lazy(rspamd_regexp_t *r)
+{
+	gsize jsz;
+	PCRE2_UCHAR errstr[128];
+	int errcode;
+
+	r->flags &= ~RSPAMD_REGEXP_FLAG_JIT_PENDING;
+
+	if ((errcode = pcre2_jit_compile(r->re, PCRE2_JIT_COMPLETE)) < 0) {
+		pcre2_get_error_message(errcode, errstr, G_N_ELEMENTS(errstr));
+		msg_err("jit compilation is not supported: %s; pattern: \"%s\"", errstr, r->pattern);
+		r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
+	}
+	else {
+		if (!(pcre2_pattern_info(r->re, PCRE2_INFO_JITSIZE, &jsz) >= 0 && jsz > 0)) {
+			msg_err("cannot exec pcre2_pattern_info(PCRE2_INFO_JITSIZE) on \"%s\"", r->pattern);
+			r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
+		}
+	}
+
+	if (!(r->flags & RSPAMD_REGEXP_FLAG_DISABLE_JIT)) {
+		pcre2_jit_stack_assign(r->mcontext, NULL, global_re_cache->jstack);
+	}
+
+	if (r->raw_re && r->re != r->raw_re && !(r->flags & RSPAMD_REGEXP_FLAG_DISABLE_JIT)) {
+		if ((errcode = pcre2_jit_compile(r->raw_re, PCRE2_JIT_COMPLETE)) < 0) {
+			pcre2_get_error_message(errcode, errstr, G_N_ELEMENTS(errstr));
+			msg_debug("jit compilation is not supported for raw regexp: %s; pattern: \"%s\"", errstr, r->pattern);
+			r->flags |= RSPAMD_REGEXP_FLAG_DISABLE_JIT;
+		}
+		else {
+			if (!(pcre2_pattern_info(r->raw_re, PCRE2_INFO_JITSIZE, &jsz) >= 0 && jsz > 0)) {
+				msg_err("cannot exec pcre2_pattern_info(PCRE2_INFO_JITSIZE) on \"%s\"", r->pattern);
+			}
+			else if (!(r->flags & RSPAMD_REGEXP_FLAG_DISABLE_JIT)) {
+				g_assert(r->raw_mcontext != NULL);
+				pcre2_jit_stack_assign(r->raw_mcontext, NULL, global_re_cache->jstack);
+			}
+		}
+	}
+}
+#endif
+
 gboolean
 rspamd_regexp_search(const rspamd_regexp_t *re, const char *text, gsize len,
 					 const char **start, const char **end, gboolean raw,
@@ -769,6 +1012,18 @@ rspamd_regexp_search(const rspamd_regexp_t *re, const char *text, gsize len,
 		return FALSE;
 	}
 
+	if (re->prefilter_lit != NULL && (end == NULL || *end == NULL) &&
+		!rspamd_regexp_prefilter_pass(re, mt, remain)) {
+		return FALSE;
+	}
+
+#ifdef HAVE_PCRE_JIT
+	if (G_UNLIKELY(re->flags & RSPAMD_REGEXP_FLAG_JIT_PENDING)) {
+		/* Lazy one-off initialisation, so the const cast is benign */
+		rspamd_regexp_jit_compile_lazy((rspamd_regexp_t *) re);
+	}
+#endif
+
 	match_data = pcre2_match_data_create(re->ncaptures + 1, NULL);
 	novec = pcre2_get_ovector_count(match_data);
 	ovec = pcre2_get_ovector_pointer(match_data);
@@ -860,6 +1115,18 @@ rspamd_regexp_get_pattern(const rspamd_regexp_t *re)
 	return re->pattern;
 }
 
+const char *
+rspamd_regexp_get_prefilter_literal(const rspamd_regexp_t *re, gsize *litlen)
+{
+	g_assert(re != NULL);
+
+	if (litlen) {
+		*litlen = re->prefilter_len;
+	}
+
+	return re->prefilter_lit;
+}
+
 unsigned int rspamd_regexp_set_flags(rspamd_regexp_t *re, unsigned int new_flags)
 {
 	unsigned int old_flags;
@@ -35,6 +35,7 @@
 #define RSPAMD_REGEXP_FLAG_DISABLE_JIT (1 << 5)
 #define RSPAMD_REGEXP_FLAG_UTF (1 << 6)
 #define RSPAMD_REGEXP_FLAG_LEFTMOST (1 << 7)
+#define RSPAMD_REGEXP_FLAG_JIT_PENDING (1 << 8)
 
 
 #ifdef __cplusplus
@@ -136,6 +137,16 @@ gpointer rspamd_regexp_get_id(const rspamd_regexp_t *re);
  */
 const char *rspamd_regexp_get_pattern(const rspamd_regexp_t *re);
 
+/**
+ * Get the mandatory literal extracted from the pattern, if any; this literal
+ * is used to pre-filter searches before invoking pcre
+ * @param re
+ * @param litlen output for the literal length (might be NULL)
+ * @return literal string or NULL if the pattern has no suitable literal
+ */
+const char *rspamd_regexp_get_prefilter_literal(const rspamd_regexp_t *re,
+												gsize *litlen);
+
 /**
  * Get PCRE flags for the regexp
  */
@@ -25,6 +25,8 @@
 #define RSPAMD_RRD_DS_COUNT METRIC_ACTION_MAX
 #define RSPAMD_RRD_OLD_DS_COUNT 4
 #define RSPAMD_RRD_RRA_COUNT 4
+/* How often we schedule writeback of the mmapped area, in seconds */
+#define RSPAMD_RRD_SYNC_INTERVAL 30.0
 
 #define msg_err_rrd(...) rspamd_default_log_function(G_LOG_LEVEL_CRITICAL, \
 													 "rrd", file->id,      \
@@ -1224,8 +1226,16 @@ rspamd_rrd_add_record(struct rspamd_rrd_file *file,
 	file->live_head->last_up = seconds;
 	file->live_head->last_up_usec = microseconds;
 
-	/* Sync and invalidate */
-	msync(file->map, file->size, MS_ASYNC | MS_INVALIDATE);
+	/*
+	 * Sync and invalidate merely periodically: the map is MAP_SHARED, so
+	 * readers observe updates immediately, whilst scheduling writeback of
+	 * the whole area on every data point turns each record into a batch of
+	 * tiny IOs; dirty pages are flushed for good when the file is closed
+	 */
+	if (ticks - file->last_sync >= RSPAMD_RRD_SYNC_INTERVAL) {
+		msync(file->map, file->size, MS_ASYNC | MS_INVALIDATE);
+		file->last_sync = ticks;
+	}
 
 	g_free(pdp_new);
 	g_free(pdp_temp);
@@ -1246,6 +1256,7 @@ int rspamd_rrd_close(struct rspamd_rrd_file *file)
 		return -1;
 	}
 
+	msync(file->map, file->size, MS_SYNC);
 	munmap(file->map, file->size);
 	close(file->fd);
 	g_free(file->filename);
@@ -203,8 +203,9 @@ struct rspamd_rrd_file {
 	double *rrd_value;               /* list of rrd values */
 
 	char *filename;
-	uint8_t *map; /* mmapped area */
-	gsize size;   /* its size */
+	uint8_t *map;     /* mmapped area */
+	gsize size;       /* its size */
+	double last_sync; /* the last time writeback was scheduled */
 	gboolean finalized;
 	char *id;
 	int fd;
@@ -28,6 +28,12 @@ void rspamd_fast_utf8_library_init(unsigned flags);
 const char *rspamd_fast_utf8_library_impl_name(void);
 off_t rspamd_fast_utf8_validate(const unsigned char *data, size_t len);
 off_t rspamd_fast_utf8_validate_ref(const unsigned char *data, size_t len);
+/*
+ * Validate and repair utf8 in a single streaming pass: each invalid byte is
+ * replaced with '?' inplace, so the length is preserved; returns the number
+ * of replaced bytes
+ */
+size_t rspamd_fast_utf8_enforce(unsigned char *data, size_t len);
 
 #ifdef __cplusplus
 }
@@ -125,7 +125,7 @@ struct rspamd_shingle *RSPAMD_OPTIMIZE("unroll-loops")
 	rspamd_fstring_t *row;
 	rspamd_stat_token_t *word;
 	uint64_t val;
-	int i, j, k;
+	int i, j;
 	gsize hlen, ilen = 0, beg = 0, widx = 0;
 	enum rspamd_cryptobox_fast_hash_type ht;
 
@@ -210,7 +210,11 @@ struct rspamd_shingle *RSPAMD_OPTIMIZE("unroll-loops")
 		}
 	}
 	else {
-		uint64_t window[SHINGLES_WINDOW * RSPAMD_SHINGLE_SIZE], seed;
+		uint64_t seeds[RSPAMD_SHINGLE_SIZE];
+		uint64_t wh[SHINGLES_WINDOW][RSPAMD_SHINGLE_SIZE];
+		uint64_t *wh_cur, *wh_prev1, *wh_prev2, *wh_tmp;
+		rspamd_stat_token_t **wordv;
+		gsize nwords = 0;
 
 		switch (alg) {
 		case RSPAMD_SHINGLES_XXHASH:
@@ -224,66 +228,81 @@ struct rspamd_shingle *RSPAMD_OPTIMIZE("unroll-loops")
 			break;
 		}
 
-		memset(window, 0, sizeof(window));
-		for (i = 0; i <= ilen; i++) {
-			if (i - beg >= SHINGLES_WINDOW || i == ilen) {
-
-				for (j = 0; j < RSPAMD_SHINGLE_SIZE; j++) {
-					/* Shift hashes window to right */
-					for (k = 0; k < SHINGLES_WINDOW - 1; k++) {
-						window[j * SHINGLES_WINDOW + k] =
-							window[j * SHINGLES_WINDOW + k + 1];
-					}
+		if (input->len == 0) {
+			/* Nothing to hash at all */
+			for (i = 0; i < RSPAMD_SHINGLE_SIZE; i++) {
+				g_free(hashes[i]);
+			}
 
-					word = NULL;
+			if (pool == NULL) {
+				g_free(res);
+			}
 
-					while (widx < input->len) {
-						word = &g_array_index(input, rspamd_stat_token_t, widx);
+			g_free(hashes);
+			rspamd_fstring_free(row);
 
-						if ((word->flags & RSPAMD_STAT_TOKEN_FLAG_SKIPPED) || word->stemmed.len == 0) {
-							widx++;
-						}
-						else {
-							break;
-						}
-					}
+			return NULL;
+		}
 
-					if (word == NULL) {
-						/* Nothing but exceptions */
-						for (i = 0; i < RSPAMD_SHINGLE_SIZE; i++) {
-							g_free(hashes[i]);
-						}
+		/* Materialise seeds and accepted words once instead of per row */
+		for (j = 0; j < RSPAMD_SHINGLE_SIZE; j++) {
+			memcpy(&seeds[j], keys[j], sizeof(seeds[j]));
+		}
 
-						if (pool == NULL) {
-							g_free(res);
-						}
+		wordv = g_malloc(MAX(ilen, 1) * sizeof(*wordv));
 
-						g_free(hashes);
-						rspamd_fstring_free(row);
+		for (i = 0; i < input->len; i++) {
+			word = &g_array_index(input, rspamd_stat_token_t, i);
 
-						return NULL;
-					}
+			if (!((word->flags & RSPAMD_STAT_TOKEN_FLAG_SKIPPED) || word->stemmed.len == 0)) {
+				wordv[nwords++] = word;
+			}
+		}
 
-					/* Insert the last element to the pipe */
-					memcpy(&seed, keys[j], sizeof(seed));
-					window[j * SHINGLES_WINDOW + SHINGLES_WINDOW - 1] =
-						rspamd_cryptobox_fast_hash_specific(ht,
-															word->stemmed.begin, word->stemmed.len,
-															seed);
-					val = 0;
-					for (k = 0; k < SHINGLES_WINDOW; k++) {
-						val ^= window[j * SHINGLES_WINDOW + k] >>
-							   (8 * (SHINGLES_WINDOW - k - 1));
-					}
+		/*
+		 * One word enters the pipe per emitted position, so instead of
+		 * interleaving the word seek, the window shift and the hashing in
+		 * one loop over rows, hash all rows of the current word back to
+		 * back and combine them with the two previous columns in a flat
+		 * pass; both inner loops run over contiguous arrays of
+		 * RSPAMD_SHINGLE_SIZE independent elements, which the vectoriser
+		 * can chew on, and the columns are rotated by pointer instead of
+		 * shifting every row window. The emitted hashes are bit for bit
+		 * the same as before, as they must be: shingles are persisted in
+		 * fuzzy storage.
+		 */
+		memset(wh, 0, sizeof(wh));
+		wh_prev2 = wh[0];
+		wh_prev1 = wh[1];
+		wh_cur = wh[2];
+
+		for (beg = 0; beg < hlen; beg++) {
+			const char *wbeg = "";
+			gsize wlen = 0;
+
+			if (beg < nwords) {
+				wbeg = wordv[beg]->stemmed.begin;
+				wlen = wordv[beg]->stemmed.len;
+			}
 
-					g_assert(hlen > beg);
-					hashes[j][beg] = val;
-				}
+			for (j = 0; j < RSPAMD_SHINGLE_SIZE; j++) {
+				wh_cur[j] = rspamd_cryptobox_fast_hash_specific(ht,
+																wbeg, wlen,
+																seeds[j]);
+			}
 
-				beg++;
-				widx++;
+			for (j = 0; j < RSPAMD_SHINGLE_SIZE; j++) {
+				hashes[j][beg] = (wh_prev2[j] >> 16) ^ (wh_prev1[j] >> 8) ^
+								 wh_cur[j];
 			}
+
+			wh_tmp = wh_prev2;
+			wh_prev2 = wh_prev1;
+			wh_prev1 = wh_cur;
+			wh_cur = wh_tmp;
 		}
+
+		g_free(wordv);
 	}
 
 	/* Now we need to filter all hashes and make a shingles result */
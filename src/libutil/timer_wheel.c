@@ -0,0 +1,254 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "timer_wheel.h"
+#include "utlist.h"
+
+/*
+ * Two levels of 256 slots each: with a granularity of 0.1s the first level
+ * covers 25.6 seconds and the second one about 1.8 hours, which is more than
+ * enough for retransmit and expiration timeouts. Longer delays are clamped
+ * to the wheel horizon, so they can fire early; they cannot fire late.
+ */
+#define WHEEL_SLOTS_BITS 8
+#define WHEEL_SLOTS (1U << WHEEL_SLOTS_BITS)
+#define WHEEL_SLOTS_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_MAX_TICKS (WHEEL_SLOTS * WHEEL_SLOTS - 1)
+
+enum rspamd_wheel_entry_state {
+	RSPAMD_WHEEL_ENTRY_SCHEDULED = 0,
+	RSPAMD_WHEEL_ENTRY_FIRED,
+};
+
+struct rspamd_wheel_entry {
+	rspamd_wheel_cb_t cb;
+	void *ud;
+	uint64_t deadline;                /* In ticks */
+	uint64_t ticks;                   /* Requested delay in ticks, kept for repeat */
+	struct rspamd_wheel_entry **slot; /* Head of the slot list the entry is filed in */
+	enum rspamd_wheel_entry_state state;
+	struct rspamd_wheel_entry *prev, *next;
+};
+
+struct rspamd_timer_wheel {
+	struct rspamd_wheel_entry *level0[WHEEL_SLOTS];
+	struct rspamd_wheel_entry *level1[WHEEL_SLOTS];
+	struct rspamd_wheel_entry *free_entries;
+	uint64_t ticks;
+	gsize nelts;
+	double granularity;
+	ev_timer tick_ev;
+	struct ev_loop *event_loop;
+};
+
+static void
+rspamd_timer_wheel_file(struct rspamd_timer_wheel *wheel,
+						struct rspamd_wheel_entry *entry)
+{
+	uint64_t delta = entry->deadline - wheel->ticks;
+
+	if (delta < WHEEL_SLOTS) {
+		entry->slot = &wheel->level0[entry->deadline & WHEEL_SLOTS_MASK];
+	}
+	else {
+		entry->slot = &wheel->level1[(entry->deadline >> WHEEL_SLOTS_BITS) &
+									 WHEEL_SLOTS_MASK];
+	}
+
+	DL_APPEND(*entry->slot, entry);
+	entry->state = RSPAMD_WHEEL_ENTRY_SCHEDULED;
+}
+
+static void
+rspamd_timer_wheel_unfile(struct rspamd_timer_wheel *wheel,
+						  struct rspamd_wheel_entry *entry)
+{
+	/*
+	 * The slot is remembered at filing time: recomputing it from the
+	 * current tick would point to the wrong level for an entry that has
+	 * crossed the first level horizon since then
+	 */
+	DL_DELETE(*entry->slot, entry);
+}
+
+static void
+rspamd_timer_wheel_tick(EV_P_ ev_timer *w, int revents)
+{
+	struct rspamd_timer_wheel *wheel = (struct rspamd_timer_wheel *) w->data;
+	struct rspamd_wheel_entry *entry;
+
+	wheel->ticks++;
+
+	if ((wheel->ticks & WHEEL_SLOTS_MASK) == 0) {
+		/* The first level has wrapped, cascade one slot of the second one */
+		struct rspamd_wheel_entry *cur =
+			wheel->level1[(wheel->ticks >> WHEEL_SLOTS_BITS) & WHEEL_SLOTS_MASK];
+
+		wheel->level1[(wheel->ticks >> WHEEL_SLOTS_BITS) & WHEEL_SLOTS_MASK] =
+			NULL;
+
+		while (cur != NULL) {
+			struct rspamd_wheel_entry *next = cur->next;
+
+			cur->prev = NULL;
+			cur->next = NULL;
+			rspamd_timer_wheel_file(wheel, cur);
+			cur = next;
+		}
+	}
+
+	/*
+	 * Pop entries one by one re-reading the head, as a callback is free to
+	 * remove any other entry, including the following one
+	 */
+	while ((entry = wheel->level0[wheel->ticks & WHEEL_SLOTS_MASK]) != NULL) {
+		DL_DELETE(wheel->level0[wheel->ticks & WHEEL_SLOTS_MASK], entry);
+		entry->state = RSPAMD_WHEEL_ENTRY_FIRED;
+		wheel->nelts--;
+		entry->cb(entry->ud);
+	}
+
+	if (wheel->nelts == 0) {
+		ev_timer_stop(EV_A, &wheel->tick_ev);
+	}
+}
+
+struct rspamd_timer_wheel *
+rspamd_timer_wheel_new(struct ev_loop *loop, double granularity)
+{
+	struct rspamd_timer_wheel *wheel;
+
+	g_assert(granularity > 0);
+
+	wheel = g_malloc0(sizeof(*wheel));
+	wheel->granularity = granularity;
+	wheel->event_loop = loop;
+	ev_timer_init(&wheel->tick_ev, rspamd_timer_wheel_tick,
+				  granularity, granularity);
+	wheel->tick_ev.data = wheel;
+
+	return wheel;
+}
+
+struct rspamd_wheel_entry *
+rspamd_timer_wheel_insert(struct rspamd_timer_wheel *wheel,
+						  double after,
+						  rspamd_wheel_cb_t cb,
+						  void *ud)
+{
+	struct rspamd_wheel_entry *entry;
+	uint64_t ticks;
+
+	g_assert(cb != NULL);
+
+	if (wheel->free_entries != NULL) {
+		entry = wheel->free_entries;
+		wheel->free_entries = entry->next;
+	}
+	else {
+		entry = g_malloc(sizeof(*entry));
+	}
+
+	ticks = (uint64_t) (after / wheel->granularity + 0.5);
+
+	if (ticks == 0) {
+		ticks = 1;
+	}
+	else if (ticks > WHEEL_MAX_TICKS) {
+		ticks = WHEEL_MAX_TICKS;
+	}
+
+	entry->cb = cb;
+	entry->ud = ud;
+	entry->ticks = ticks;
+	entry->deadline = wheel->ticks + ticks;
+	entry->prev = NULL;
+	entry->next = NULL;
+	rspamd_timer_wheel_file(wheel, entry);
+
+	if (wheel->nelts++ == 0) {
+		ev_now_update_if_cheap(wheel->event_loop);
+		ev_timer_again(wheel->event_loop, &wheel->tick_ev);
+	}
+
+	return entry;
+}
+
+void rspamd_timer_wheel_repeat(struct rspamd_timer_wheel *wheel,
+							   struct rspamd_wheel_entry *entry)
+{
+	if (entry->state == RSPAMD_WHEEL_ENTRY_SCHEDULED) {
+		rspamd_timer_wheel_unfile(wheel, entry);
+		wheel->nelts--;
+	}
+
+	entry->deadline = wheel->ticks + entry->ticks;
+	entry->prev = NULL;
+	entry->next = NULL;
+	rspamd_timer_wheel_file(wheel, entry);
+
+	if (wheel->nelts++ == 0) {
+		ev_now_update_if_cheap(wheel->event_loop);
+		ev_timer_again(wheel->event_loop, &wheel->tick_ev);
+	}
+}
+
+void rspamd_timer_wheel_remove(struct rspamd_timer_wheel *wheel,
+							   struct rspamd_wheel_entry *entry)
+{
+	if (entry->state == RSPAMD_WHEEL_ENTRY_SCHEDULED) {
+		rspamd_timer_wheel_unfile(wheel, entry);
+		wheel->nelts--;
+
+		if (wheel->nelts == 0) {
+			ev_timer_stop(wheel->event_loop, &wheel->tick_ev);
+		}
+	}
+
+	/* Return to the free list */
+	entry->prev = NULL;
+	entry->next = wheel->free_entries;
+	wheel->free_entries = entry;
+}
+
+void rspamd_timer_wheel_destroy(struct rspamd_timer_wheel *wheel)
+{
+	struct rspamd_wheel_entry *entry, *tmp;
+	unsigned int i;
+
+	ev_timer_stop(wheel->event_loop, &wheel->tick_ev);
+
+	for (i = 0; i < WHEEL_SLOTS; i++) {
+		DL_FOREACH_SAFE(wheel->level0[i], entry, tmp)
+		{
+			g_free(entry);
+		}
+		DL_FOREACH_SAFE(wheel->level1[i], entry, tmp)
+		{
+			g_free(entry);
+		}
+	}
+
+	entry = wheel->free_entries;
+
+	while (entry != NULL) {
+		tmp = entry->next;
+		g_free(entry);
+		entry = tmp;
+	}
+
+	g_free(wheel);
+}
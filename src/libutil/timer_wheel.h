@@ -0,0 +1,96 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SRC_LIBUTIL_TIMER_WHEEL_H_
+#define SRC_LIBUTIL_TIMER_WHEEL_H_
+
+#include "config.h"
+#include "contrib/libev/ev.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hierarchical timer wheel for coarse timeouts with O(1) insert and cancel.
+ *
+ * All entries of a wheel are driven by a single repeating libev timer that
+ * ticks at the configured granularity, so a wheel adds exactly one element
+ * to the event loop timer heap regardless of how many timeouts are pending;
+ * the tick timer is merely stopped when the wheel is empty. Entries fire
+ * within one granularity interval after their requested delay, hence the
+ * wheel suits retransmit and expiration timeouts, not exact scheduling.
+ */
+
+struct rspamd_timer_wheel;
+struct rspamd_wheel_entry;
+
+typedef void (*rspamd_wheel_cb_t)(void *ud);
+
+/**
+ * Creates a timer wheel attached to the specified event loop
+ * @param loop event loop used for the tick timer
+ * @param granularity tick period in seconds (e.g. 0.1)
+ * @return opaque wheel structure
+ */
+struct rspamd_timer_wheel *rspamd_timer_wheel_new(struct ev_loop *loop,
+												  double granularity);
+
+/**
+ * Schedules a callback to be invoked after `after` seconds (rounded up to
+ * the wheel granularity). The returned entry is owned by the wheel: it is
+ * invalidated when the callback fires unless it is rescheduled via
+ * `rspamd_timer_wheel_repeat` or removed from within the callback.
+ * @param wheel wheel structure
+ * @param after delay in seconds
+ * @param cb callback to invoke
+ * @param ud opaque data for the callback
+ * @return entry suitable for repeat/remove or NULL on failure
+ */
+struct rspamd_wheel_entry *rspamd_timer_wheel_insert(struct rspamd_timer_wheel *wheel,
+													 double after,
+													 rspamd_wheel_cb_t cb,
+													 void *ud);
+
+/**
+ * Re-arms an entry for another round of its original delay; may merely be
+ * called for a scheduled entry (restarting the countdown) or from within
+ * the entry's callback
+ * @param wheel wheel structure
+ * @param entry entry to re-arm
+ */
+void rspamd_timer_wheel_repeat(struct rspamd_timer_wheel *wheel,
+							   struct rspamd_wheel_entry *entry);
+
+/**
+ * Cancels an entry; the callback will not be invoked. The entry is
+ * disposed by the wheel.
+ * @param wheel wheel structure
+ * @param entry entry to cancel
+ */
+void rspamd_timer_wheel_remove(struct rspamd_timer_wheel *wheel,
+							   struct rspamd_wheel_entry *entry);
+
+/**
+ * Destroys the wheel and all pending entries (callbacks are not invoked)
+ * @param wheel wheel structure
+ */
+void rspamd_timer_wheel_destroy(struct rspamd_timer_wheel *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_LIBUTIL_TIMER_WHEEL_H_ */
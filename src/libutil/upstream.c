@@ -25,6 +25,7 @@
 #include "logger.h"
 #include "contrib/librdns/rdns.h"
 #include "contrib/mumhash/mum.h"
+#include "util.h"
 
 #include <math.h>
 
@@ -55,6 +56,7 @@ struct upstream {
 	unsigned int errors;
 	unsigned int checked;
 	unsigned int dns_requests;
+	struct rspamd_counter_data latency_ctr;
 	int active_idx;
 	unsigned int ttl;
 	char *name;
@@ -102,6 +104,9 @@ struct upstream_list {
 	const struct upstream_limits *limits;
 	enum rspamd_upstream_flag flags;
 	unsigned int cur_elt;
+	/* Latency-weighted rotation state */
+	struct upstream *lw_last;
+	unsigned int lw_probes;
 	enum rspamd_upstream_rotation rot_alg;
 #ifdef UPSTREAMS_THREAD_SAFE
 	rspamd_mutex_t *lock;
@@ -808,6 +813,13 @@ rspamd_upstream_set_inactive(struct upstream_list *ls, struct upstream *upstream
 	RSPAMD_UPSTREAM_UNLOCK(ls);
 }
 
+/* EMA smoothing factor for latency samples */
+static const float latency_ema_alpha = 0.5f;
+/* Do not abandon the current upstream for a peer that is merely ~10% faster */
+static const double latency_hysteresis = 1.1;
+/* Every n-th selection probes another upstream to refresh its latency */
+static const unsigned int latency_probe_ratio = 16;
+
 void rspamd_upstream_fail(struct upstream *upstream,
 						  gboolean addr_failure,
 						  const char *reason)
@@ -826,6 +838,19 @@ void rspamd_upstream_fail(struct upstream *upstream,
 		sec_cur = rspamd_get_ticks(FALSE);
 
 		RSPAMD_UPSTREAM_LOCK(upstream);
+
+		if (upstream->latency_ctr.number > 0) {
+			/*
+			 * Penalise the latency EWMA as well: a failed request is at least
+			 * as slow as a doubled mean, so timing out upstreams drift towards
+			 * the back of the latency-weighted rotation even before they
+			 * accumulate enough errors to be marked as dead
+			 */
+			rspamd_set_counter_ema(&upstream->latency_ctr,
+								   upstream->latency_ctr.mean * 2.0f,
+								   latency_ema_alpha);
+		}
+
 		if (upstream->errors == 0) {
 			/* We have the first error */
 			upstream->last_fail = sec_cur;
@@ -954,6 +979,16 @@ void rspamd_upstream_ok(struct upstream *upstream)
 	RSPAMD_UPSTREAM_UNLOCK(upstream);
 }
 
+void rspamd_upstream_update_latency(struct upstream *upstream, double latency)
+{
+	if (latency > 0 && isfinite(latency)) {
+		RSPAMD_UPSTREAM_LOCK(upstream);
+		rspamd_set_counter_ema(&upstream->latency_ctr, (float) latency,
+							   latency_ema_alpha);
+		RSPAMD_UPSTREAM_UNLOCK(upstream);
+	}
+}
+
 void rspamd_upstream_set_weight(struct upstream *up, unsigned int weight)
 {
 	RSPAMD_UPSTREAM_LOCK(up);
@@ -1325,6 +1360,10 @@ rspamd_upstreams_parse_line_len(struct upstream_list *ups,
 		ups->rot_alg = RSPAMD_UPSTREAM_HASHED;
 		p += sizeof("hash:") - 1;
 	}
+	else if (RSPAMD_LEN_CHECK_STARTS_WITH(p, len, "latency-weighted:")) {
+		ups->rot_alg = RSPAMD_UPSTREAM_LATENCY_WEIGHTED;
+		p += sizeof("latency-weighted:") - 1;
+	}
 
 	while (p < end) {
 		span_len = rspamd_memcspn(p, separators, end - p);
@@ -1420,6 +1459,55 @@ void rspamd_upstreams_destroy(struct upstream_list *ups)
 	}
 }
 
+void rspamd_upstreams_carry_state(struct upstream_list *dst,
+								  struct upstream_list *src)
+{
+	unsigned int i, j;
+	struct upstream *upstream, *old;
+
+	if (dst == NULL || src == NULL) {
+		return;
+	}
+
+	for (i = 0; i < dst->ups->len; i++) {
+		upstream = g_ptr_array_index(dst->ups, i);
+		old = NULL;
+
+		for (j = 0; j < src->ups->len; j++) {
+			struct upstream *cand = g_ptr_array_index(src->ups, j);
+
+			if (g_ascii_strcasecmp(cand->name, upstream->name) == 0) {
+				old = cand;
+				break;
+			}
+		}
+
+		if (old == NULL) {
+			/* A genuinely new entry, let it start with a clean slate */
+			continue;
+		}
+
+		RSPAMD_UPSTREAM_LOCK(upstream);
+		upstream->errors = old->errors;
+		upstream->checked = old->checked;
+		upstream->last_fail = old->last_fail;
+		upstream->latency_ctr = old->latency_ctr;
+		RSPAMD_UPSTREAM_UNLOCK(upstream);
+
+		if (old->active_idx == -1 && upstream->active_idx != -1 &&
+			dst->ups->len > 1) {
+			/* The old entry was dead, so start the new one dead as well */
+			msg_debug_upstream("carry inactive state for upstream %s",
+							   upstream->name);
+			rspamd_upstream_set_inactive(dst, upstream);
+		}
+		else {
+			msg_debug_upstream("carried state for upstream %s: %ud errors",
+							   upstream->name, upstream->errors);
+		}
+	}
+}
+
 static void
 rspamd_upstream_restore_cb(gpointer elt, gpointer ls)
 {
@@ -1539,6 +1627,65 @@ rspamd_upstream_get_round_robin(struct upstream_list *ups,
 	return selected;
 }
 
+static struct upstream *
+rspamd_upstream_get_latency_weighted(struct upstream_list *ups,
+									 struct upstream *except)
+{
+	struct upstream *up, *best = NULL, *last;
+	double best_latency = NAN;
+	unsigned int i;
+
+	/*
+	 * Occasionally fall back to round robin so that slow upstreams still get
+	 * some traffic and their EWMA can recover once they speed up again
+	 */
+	if (++ups->lw_probes >= latency_probe_ratio) {
+		ups->lw_probes = 0;
+
+		return rspamd_upstream_get_round_robin(ups, except, TRUE);
+	}
+
+	RSPAMD_UPSTREAM_LOCK(ups);
+
+	for (i = 0; i < ups->alive->len; i++) {
+		up = g_ptr_array_index(ups->alive, i);
+
+		if (except != NULL && up == except) {
+			continue;
+		}
+
+		if (up->latency_ctr.number == 0) {
+			/* No samples yet, warm this upstream up first */
+			best = up;
+			best_latency = 0;
+			break;
+		}
+
+		if (best == NULL || up->latency_ctr.mean < best_latency) {
+			best = up;
+			best_latency = up->latency_ctr.mean;
+		}
+	}
+
+	/*
+	 * Hysteresis: stick to the previous selection unless somebody is clearly
+	 * faster, otherwise jittery samples would bounce us between replicas
+	 */
+	last = ups->lw_last;
+
+	if (last != NULL && last != best && best != NULL &&
+		last->active_idx != -1 && last != except &&
+		last->latency_ctr.number > 0 &&
+		last->latency_ctr.mean <= best_latency * latency_hysteresis) {
+		best = last;
+	}
+
+	ups->lw_last = best;
+	RSPAMD_UPSTREAM_UNLOCK(ups);
+
+	return best;
+}
+
 /*
  * The key idea of this function is obtained from the following paper:
  * A Fast, Minimal Memory, Consistent Hash Algorithm
@@ -1655,6 +1802,9 @@ rspamd_upstream_get_common(struct upstream_list *ups,
 	case RSPAMD_UPSTREAM_MASTER_SLAVE:
 		up = rspamd_upstream_get_round_robin(ups, except, FALSE);
 		break;
+	case RSPAMD_UPSTREAM_LATENCY_WEIGHTED:
+		up = rspamd_upstream_get_latency_weighted(ups, except);
+		break;
 	case RSPAMD_UPSTREAM_SEQUENTIAL:
 		if (ups->cur_elt >= ups->alive->len) {
 			ups->cur_elt = 0;
@@ -35,6 +35,7 @@ enum rspamd_upstream_rotation {
 	RSPAMD_UPSTREAM_ROUND_ROBIN,
 	RSPAMD_UPSTREAM_MASTER_SLAVE,
 	RSPAMD_UPSTREAM_SEQUENTIAL,
+	RSPAMD_UPSTREAM_LATENCY_WEIGHTED,
 	RSPAMD_UPSTREAM_UNDEF
 };
 
@@ -86,6 +87,12 @@ void rspamd_upstream_fail(struct upstream *upstream, gboolean addr_failure, cons
  */
 void rspamd_upstream_ok(struct upstream *up);
 
+/**
+ * Feed an observed request latency (in seconds) into the per upstream EWMA;
+ * used by the latency-weighted rotation to prefer the fastest replicas
+ */
+void rspamd_upstream_update_latency(struct upstream *up, double latency);
+
 /**
  * Set weight for an upstream
  * @param up
@@ -140,6 +147,17 @@ void rspamd_upstreams_set_rotation(struct upstream_list *ups,
  */
 void rspamd_upstreams_destroy(struct upstream_list *ups);
 
+/**
+ * Carry health and latency state over from an old list to its replacement:
+ * entries are matched by name, matched entries inherit errors, latency EWMA
+ * and the alive flag, whilst new entries start with a clean slate; used to
+ * hot-swap upstream configuration without resetting all upstreams at once
+ * @param dst replacement list
+ * @param src list being replaced
+ */
+void rspamd_upstreams_carry_state(struct upstream_list *dst,
+								  struct upstream_list *src);
+
 /**
  * Returns count of upstreams in a list
  * @param ups
@@ -63,6 +63,11 @@
 #include <glob.h> /* in fact, we require this file ultimately */
 
 #include "zlib.h"
+#ifdef SYS_ZSTD
+#include "zstd.h"
+#else
+#include "contrib/zstd/zstd.h"
+#endif
 #include "contrib/uthash/utlist.h"
 #include "blas-config.h"
 
@@ -2008,6 +2013,82 @@ rspamd_shmem_xmap(const char *fname, unsigned int mode,
 	return map;
 }
 
+unsigned int
+rspamd_zstd_dictionary_id(const void *dict, gsize size)
+{
+	unsigned int id;
+
+	if (dict == NULL || size == 0) {
+		return 0;
+	}
+
+	id = ZSTD_getDictID_fromDict(dict, size);
+
+	if (id == 0) {
+		/*
+		 * Raw content dictionary: derive a stable id from the content, so
+		 * a client and a server pointed at the same file agree on it
+		 */
+		id = (unsigned int) rspamd_cryptobox_fast_hash_specific(
+			RSPAMD_CRYPTOBOX_XXHASH64, dict, size, 0);
+
+		if (id == 0) {
+			id = 1;
+		}
+	}
+
+	return id;
+}
+
+gboolean
+rspamd_madvise_hugepages(void *map, gsize len)
+{
+#ifdef MADV_HUGEPAGE
+	/* Hugepages are 2MB on all platforms we care about */
+	const guintptr huge_size = 2ULL * 1024 * 1024;
+	guintptr start = (guintptr) map, end = start + len;
+
+	/* The advice is honoured for whole hugepage aligned extents merely */
+	start = (start + huge_size - 1) & ~(huge_size - 1);
+	end &= ~(huge_size - 1);
+
+	if (end > start) {
+		/* Advisory: ignored by kernels without THP support */
+		return madvise((void *) start, end - start, MADV_HUGEPAGE) != -1;
+	}
+#endif
+
+	return FALSE;
+}
+
+gsize
+rspamd_get_hugepages_rss(void)
+{
+	gsize ret = 0;
+#ifdef __linux__
+	FILE *f;
+	char buf[256];
+	long kb;
+
+	/* Aggregated over all mappings of the process */
+	f = fopen("/proc/self/smaps_rollup", "r");
+
+	if (f != NULL) {
+		while (fgets(buf, sizeof(buf), f) != NULL) {
+			if (sscanf(buf, "AnonHugePages: %ld kB", &kb) == 1 ||
+				sscanf(buf, "ShmemPmdMapped: %ld kB", &kb) == 1 ||
+				sscanf(buf, "FilePmdMapped: %ld kB", &kb) == 1) {
+				ret += (gsize) kb * 1024;
+			}
+		}
+
+		fclose(f);
+	}
+#endif
+
+	return ret;
+}
+
 /*
  * A(x - 0.5)^4 + B(x - 0.5)^3 + C(x - 0.5)^2 + D(x - 0.5)
  * A = 32,
@@ -446,6 +446,25 @@ gpointer rspamd_file_xmap(const char *fname, unsigned int mode, gsize *size,
 gpointer rspamd_shmem_xmap(const char *fname, unsigned int mode,
 						   gsize *size);
 
+/**
+ * Advise the kernel to back a memory region with transparent hugepages,
+ * reducing TLB pressure for large read-mostly structures. The advice is
+ * applied to the hugepage aligned part of the region merely, so regions
+ * smaller than a hugepage are left alone
+ * @param map start of the region
+ * @param len length of the region
+ * @return TRUE if the advice has been applied
+ */
+gboolean rspamd_madvise_hugepages(void *map, gsize len);
+
+/**
+ * Returns the amount of memory of the current process backed by hugepages
+ * (anonymous, shmem and file backed), as accounted by the kernel; returns
+ * zero where unsupported
+ * @return number of hugepage backed bytes
+ */
+gsize rspamd_get_hugepages_rss(void);
+
 /**
  * Normalize probabilities using polynomial function
  * @param x probability (bias .. 1)
@@ -574,6 +593,17 @@ float rspamd_sum_floats(float *ar, gsize *nelts);
  */
 void rspamd_normalize_path_inplace(char *path, unsigned int len, gsize *nlen);
 
+/**
+ * Returns an identifier of a zstd dictionary: the id embedded into
+ * dictionaries produced by the official trainer, or a stable hash derived
+ * one for raw content dictionaries that carry no header. Never returns 0
+ * for a valid dictionary
+ * @param dict dictionary content
+ * @param size dictionary size
+ * @return dictionary id
+ */
+unsigned int rspamd_zstd_dictionary_id(const void *dict, gsize size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1117,6 +1117,95 @@ void rspamd_plugins_table_push_elt(lua_State *L, const char *field_name,
 	}
 }
 
+static int
+rspamd_lua_bytecode_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+	int fd = *(int *) ud;
+
+	if (write(fd, p, sz) == -1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Tries to load a previously dumped chunk keyed by the source digest, pushing
+ * the compiled function on success; merely returns FALSE when there is no
+ * usable cache so the caller falls back to compiling the source
+ */
+static gboolean
+rspamd_lua_try_load_bytecode(lua_State *L, struct rspamd_config *cfg,
+							 const unsigned char *digest, const char *chunkname)
+{
+	char fp[PATH_MAX];
+	uint8_t *map;
+	gsize len;
+
+	rspamd_snprintf(fp, sizeof(fp), "%s%s%*xs.luabc", cfg->hs_cache_dir,
+					G_DIR_SEPARATOR_S,
+					(int) rspamd_cryptobox_HASHBYTES / 2, digest);
+
+	map = rspamd_file_xmap(fp, PROT_READ, &len, TRUE);
+
+	if (map == NULL) {
+		return FALSE;
+	}
+
+	if (luaL_loadbuffer(L, map, len, chunkname) != 0) {
+		/* Incompatible bytecode, e.g. after a LuaJIT upgrade */
+		msg_info_config("discard stale bytecode cache %s: %s", fp,
+						lua_tostring(L, -1));
+		lua_pop(L, 1);
+		munmap(map, len);
+		unlink(fp);
+
+		return FALSE;
+	}
+
+	munmap(map, len);
+
+	return TRUE;
+}
+
+static void
+rspamd_lua_try_save_bytecode(lua_State *L, struct rspamd_config *cfg,
+							 const unsigned char *digest)
+{
+	char fp[PATH_MAX], np[PATH_MAX];
+	int fd;
+
+	rspamd_snprintf(fp, sizeof(fp), "%s%sluabc-XXXXXXXXXXXXX", cfg->hs_cache_dir,
+					G_DIR_SEPARATOR_S);
+
+	if ((fd = g_mkstemp_full(fp, O_CREAT | O_EXCL | O_WRONLY, 00644)) != -1) {
+		if (lua_dump(L, rspamd_lua_bytecode_writer, &fd) != 0) {
+			msg_warn_config("cannot write bytecode cache to %s: %s",
+							fp, strerror(errno));
+			unlink(fp);
+		}
+		else {
+			fsync(fd);
+
+			rspamd_snprintf(np, sizeof(np), "%s%s%*xs.luabc", cfg->hs_cache_dir,
+							G_DIR_SEPARATOR_S,
+							(int) rspamd_cryptobox_HASHBYTES / 2, digest);
+
+			if (rename(fp, np) == -1) {
+				msg_warn_config("cannot rename bytecode cache from %s to %s: %s",
+								fp, np, strerror(errno));
+				unlink(fp);
+			}
+		}
+
+		close(fd);
+	}
+	else {
+		msg_warn_config("cannot open a temp file %s to write bytecode cache: %s",
+						fp, strerror(errno));
+	}
+}
+
 gboolean
 rspamd_init_lua_filters(struct rspamd_config *cfg, bool force_load, bool strict)
 {
@@ -1174,7 +1263,15 @@ rspamd_init_lua_filters(struct rspamd_config *cfg, bool force_load, bool strict)
 			rspamd_snprintf(lua_fname, strlen(module->path) + 2, "@%s",
 							module->path);
 
-			if (luaL_loadbuffer(L, data, fsize, lua_fname) != 0) {
+			/* Reuse the dumped bytecode if this very source has been seen */
+			gboolean bc_cached = FALSE;
+
+			if (cfg->hs_cache_dir != NULL) {
+				bc_cached = rspamd_lua_try_load_bytecode(L, cfg, digest,
+														 lua_fname);
+			}
+
+			if (!bc_cached && luaL_loadbuffer(L, data, fsize, lua_fname) != 0) {
 				msg_err_config("load of %s failed: %s", module->path,
 							   lua_tostring(L, -1));
 				lua_settop(L, err_idx - 1); /*  Error function */
@@ -1191,6 +1288,10 @@ rspamd_init_lua_filters(struct rspamd_config *cfg, bool force_load, bool strict)
 				continue;
 			}
 
+			if (!bc_cached && cfg->hs_cache_dir != NULL) {
+				rspamd_lua_try_save_bytecode(L, cfg, digest);
+			}
+
 			munmap(data, fsize);
 			g_free(lua_fname);
 
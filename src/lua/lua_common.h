@@ -309,6 +309,7 @@ enum rspamd_lua_task_header_type {
 	RSPAMD_TASK_HEADER_PUSH_FULL,
 	RSPAMD_TASK_HEADER_PUSH_COUNT,
 	RSPAMD_TASK_HEADER_PUSH_HAS,
+	RSPAMD_TASK_HEADER_PUSH_RAW_TEXT,
 };
 
 int rspamd_lua_push_header(lua_State *L,
@@ -430,6 +430,23 @@ end)
  */
 LUA_FUNCTION_DEF(config, add_condition);
 
+/***
+ * @method rspamd_config:add_symbol_guard(symbol, guard)
+ * Adds a native guard for the specified symbol: a cheap predicate over the
+ * task state that is evaluated in C, so the symbol callback is not entered
+ * at all when the guard fails. The guard specification is an optional
+ * leading `!` that negates the predicate followed by `header:<name>`,
+ * `mime` or `empty`.
+ * @param {string} symbol symbol's name
+ * @param {string} guard guard specification
+ * @return {boolean} true if the guard has been added
+ * @example
+
+-- Skip the callback when there is no DKIM signature at all
+rspamd_config:add_symbol_guard('DKIM_CHECK', 'header:DKIM-Signature')
+ */
+LUA_FUNCTION_DEF(config, add_symbol_guard);
+
 /***
  * @method rspamd_config:enable_symbol(symbol)
  * Enables execution for the specified symbol
@@ -862,6 +879,23 @@ LUA_FUNCTION_DEF(config, get_dns_max_requests);
  */
 LUA_FUNCTION_DEF(config, get_dns_timeout);
 
+/***
+ * @method rspamd_config:get_re_hit_stats()
+ * Returns shared hit counters for all cached regexps, aggregated over all
+ * workers since start. Requires `enable_re_hit_stats` to be set in the
+ * options section, otherwise an empty table is returned.
+ * @return {table} pattern -> {checked = number, matched = number} table
+ */
+LUA_FUNCTION_DEF(config, get_re_hit_stats);
+
+/***
+ * @method rspamd_config:get_lua_thread_pool_stats()
+ * Returns recycling telemetry for the Lua coroutines pool of this process
+ * @return {table} table with `allocated`, `reused`, `terminated`, `available`,
+ * `in_use` and `peak_in_use` counters
+ */
+LUA_FUNCTION_DEF(config, get_lua_thread_pool_stats);
+
 static const struct luaL_reg configlib_m[] = {
 	LUA_INTERFACE_DEF(config, get_module_opt),
 	LUA_INTERFACE_DEF(config, get_mempool),
@@ -899,6 +933,7 @@ static const struct luaL_reg configlib_m[] = {
 	LUA_INTERFACE_DEF(config, get_api_version),
 	LUA_INTERFACE_DEF(config, get_key),
 	LUA_INTERFACE_DEF(config, add_condition),
+	LUA_INTERFACE_DEF(config, add_symbol_guard),
 	LUA_INTERFACE_DEF(config, enable_symbol),
 	LUA_INTERFACE_DEF(config, disable_symbol),
 	LUA_INTERFACE_DEF(config, register_regexp),
@@ -937,6 +972,8 @@ static const struct luaL_reg configlib_m[] = {
 	LUA_INTERFACE_DEF(config, get_tld_path),
 	LUA_INTERFACE_DEF(config, get_dns_max_requests),
 	LUA_INTERFACE_DEF(config, get_dns_timeout),
+	LUA_INTERFACE_DEF(config, get_re_hit_stats),
+	LUA_INTERFACE_DEF(config, get_lua_thread_pool_stats),
 	{"__tostring", rspamd_lua_class_tostring},
 	{"__newindex", lua_config_newindex},
 	{NULL, NULL}};
@@ -945,10 +982,12 @@ LUA_FUNCTION_DEF(monitored, alive);
 LUA_FUNCTION_DEF(monitored, latency);
 LUA_FUNCTION_DEF(monitored, offline);
 LUA_FUNCTION_DEF(monitored, total_offline);
+LUA_FUNCTION_DEF(monitored, latency_history);
 
 static const struct luaL_reg monitoredlib_m[] = {
 	LUA_INTERFACE_DEF(monitored, alive),
 	LUA_INTERFACE_DEF(monitored, latency),
+	LUA_INTERFACE_DEF(monitored, latency_history),
 	LUA_INTERFACE_DEF(monitored, offline),
 	LUA_INTERFACE_DEF(monitored, total_offline),
 	{"__tostring", rspamd_lua_class_tostring},
@@ -2966,6 +3005,28 @@ lua_config_add_condition(lua_State *L)
 	return 1;
 }
 
+static int
+lua_config_add_symbol_guard(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_config *cfg = lua_check_config(L, 1);
+	const char *sym = luaL_checkstring(L, 2);
+	const char *guard = luaL_checkstring(L, 3);
+	gboolean ret = FALSE;
+
+	if (cfg && sym && guard) {
+		ret = rspamd_symcache_add_symbol_guard(cfg->cache, sym, guard);
+
+		if (!ret) {
+			msg_err_config("invalid guard specification '%s' for symbol %s",
+						   guard, sym);
+		}
+	}
+
+	lua_pushboolean(L, ret);
+	return 1;
+}
+
 static int
 lua_config_set_peak_cb(lua_State *L)
 {
@@ -4677,6 +4738,83 @@ lua_config_get_dns_timeout(lua_State *L)
 	return 1;
 }
 
+static void
+lua_config_re_hit_stats_cb(rspamd_regexp_t *re,
+						   const struct rspamd_re_cache_hit_stat *st,
+						   gpointer ud)
+{
+	lua_State *L = (lua_State *) ud;
+
+	lua_pushstring(L, rspamd_regexp_get_pattern(re));
+	lua_createtable(L, 0, 2);
+	lua_pushstring(L, "checked");
+	lua_pushinteger(L, (lua_Integer) st->checked);
+	lua_settable(L, -3);
+	lua_pushstring(L, "matched");
+	lua_pushinteger(L, (lua_Integer) st->matched);
+	lua_settable(L, -3);
+	lua_settable(L, -3);
+}
+
+static int
+lua_config_get_re_hit_stats(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_config *cfg = lua_check_config(L, 1);
+
+	if (cfg != NULL) {
+		lua_newtable(L);
+
+		if (cfg->re_cache) {
+			rspamd_re_cache_hit_stats_foreach(cfg->re_cache,
+											  lua_config_re_hit_stats_cb, L);
+		}
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
+static int
+lua_config_get_lua_thread_pool_stats(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_config *cfg = lua_check_config(L, 1);
+	struct lua_thread_pool_stats st;
+
+	if (cfg != NULL && cfg->lua_thread_pool != NULL) {
+		lua_thread_pool_get_stats((struct lua_thread_pool *) cfg->lua_thread_pool,
+								  &st);
+
+		lua_createtable(L, 0, 6);
+		lua_pushstring(L, "allocated");
+		lua_pushinteger(L, (lua_Integer) st.allocated);
+		lua_settable(L, -3);
+		lua_pushstring(L, "reused");
+		lua_pushinteger(L, (lua_Integer) st.reused);
+		lua_settable(L, -3);
+		lua_pushstring(L, "terminated");
+		lua_pushinteger(L, (lua_Integer) st.terminated);
+		lua_settable(L, -3);
+		lua_pushstring(L, "available");
+		lua_pushinteger(L, (lua_Integer) st.available);
+		lua_settable(L, -3);
+		lua_pushstring(L, "in_use");
+		lua_pushinteger(L, (lua_Integer) st.in_use);
+		lua_settable(L, -3);
+		lua_pushstring(L, "peak_in_use");
+		lua_pushinteger(L, (lua_Integer) st.peak_in_use);
+		lua_settable(L, -3);
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static int
 lua_monitored_alive(lua_State *L)
 {
@@ -4741,6 +4879,30 @@ lua_monitored_latency(lua_State *L)
 	return 1;
 }
 
+static int
+lua_monitored_latency_history(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_monitored *m = lua_check_monitored(L, 1);
+	double hist[RSPAMD_MONITORED_LATENCY_SLOTS];
+	unsigned int i, n;
+
+	if (m) {
+		n = rspamd_monitored_latency_history(m, hist);
+		lua_createtable(L, n, 0);
+
+		for (i = 0; i < n; i++) {
+			lua_pushnumber(L, hist[i]);
+			lua_rawseti(L, -2, i + 1);
+		}
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 void luaopen_config(lua_State *L)
 {
 	rspamd_lua_new_class(L, rspamd_config_classname, configlib_m);
@@ -104,6 +104,35 @@ LUA_FUNCTION_DEF(html, get_images);
  */
 LUA_FUNCTION_DEF(html, foreach_tag);
 
+/***
+ * @method html:foreach_tag_cursor(tagname, callback)
+ * Like `foreach_tag`, but the callback receives a single cursor userdata
+ * reused for every visited tag, so traversal does not allocate per node.
+ * The cursor supports all `html_tag` methods, but it is repositioned on each
+ * invocation, hence it should not be stashed by the callback.
+ *
+ * Callback is called with the following attributes:
+ *
+ * - `cursor`: reused html tag cursor
+ * - `content_length`: length of content within a tag
+ * - `is_leaf`: true if a tag has no children
+ *
+ * Callback function should return `true` to **stop** processing and `false` to continue
+ * @return nothing
+ */
+LUA_FUNCTION_DEF(html, foreach_tag_cursor);
+
+/***
+ * @method html:get_attribute_values(tagname, attribute)
+ * Collects the specified attribute from all tags of the given type in a
+ * single call, e.g. all `href` values of `a` tags, avoiding per-node
+ * wrappers entirely.
+ * @param {string} tagname name of tag to examine or `any`
+ * @param {string} attribute attribute name
+ * @return {table} array of attribute values as text views
+ */
+LUA_FUNCTION_DEF(html, get_attribute_values);
+
 /***
  * @method html:get_invisible()
  * Returns invisible content of the HTML data
@@ -116,6 +145,8 @@ static const struct luaL_reg htmllib_m[] = {
 	LUA_INTERFACE_DEF(html, has_property),
 	LUA_INTERFACE_DEF(html, get_images),
 	LUA_INTERFACE_DEF(html, foreach_tag),
+	LUA_INTERFACE_DEF(html, foreach_tag_cursor),
+	LUA_INTERFACE_DEF(html, get_attribute_values),
 	LUA_INTERFACE_DEF(html, get_invisible),
 	{"__tostring", rspamd_lua_class_tostring},
 	{NULL, NULL}};
@@ -398,18 +429,15 @@ lua_html_push_block(lua_State *L, const struct rspamd::html::html_block *bl)
 }
 
 static int
-lua_html_foreach_tag(lua_State *L)
+lua_html_parse_tag_names(lua_State *L, int pos,
+						 ankerl::unordered_dense::set<int> &tags,
+						 bool &any)
 {
-	LUA_TRACE_POINT;
-	auto *hc = lua_check_html(L, 1);
 	const char *tagname;
 	int id;
-	auto any = false;
-	ankerl::unordered_dense::set<int> tags;
-
 
-	if (lua_type(L, 2) == LUA_TSTRING) {
-		tagname = luaL_checkstring(L, 2);
+	if (lua_type(L, pos) == LUA_TSTRING) {
+		tagname = luaL_checkstring(L, pos);
 		if (strcmp(tagname, "any") == 0) {
 			any = true;
 		}
@@ -424,13 +452,13 @@ lua_html_foreach_tag(lua_State *L)
 			tags.insert(id);
 		}
 	}
-	else if (lua_type(L, 2) == LUA_TTABLE) {
-		lua_pushvalue(L, 2);
+	else if (lua_type(L, pos) == LUA_TTABLE) {
+		lua_pushvalue(L, pos);
 
 		for (lua_pushnil(L); lua_next(L, -2); lua_pop(L, 1)) {
 			tagname = luaL_checkstring(L, -1);
 			if (strcmp(tagname, "any") == 0) {
-				any = TRUE;
+				any = true;
 			}
 			else {
 				id = rspamd_html_tag_by_name(tagname);
@@ -445,6 +473,19 @@ lua_html_foreach_tag(lua_State *L)
 		lua_pop(L, 1);
 	}
 
+	return 0;
+}
+
+static int
+lua_html_foreach_tag(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	auto *hc = lua_check_html(L, 1);
+	auto any = false;
+	ankerl::unordered_dense::set<int> tags;
+
+	lua_html_parse_tag_names(L, 2, tags, any);
+
 	if (hc && (any || !tags.empty()) && lua_isfunction(L, 3)) {
 		hc->traverse_all_tags([&](const rspamd::html::html_tag *tag) -> bool {
 			if (tag && (any || tags.contains(tag->id))) {
@@ -491,6 +532,117 @@ lua_html_foreach_tag(lua_State *L)
 	return 0;
 }
 
+static int
+lua_html_foreach_tag_cursor(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	auto *hc = lua_check_html(L, 1);
+	auto any = false;
+	ankerl::unordered_dense::set<int> tags;
+
+	lua_html_parse_tag_names(L, 2, tags, any);
+
+	if (hc && (any || !tags.empty()) && lua_isfunction(L, 3)) {
+		/* A single userdata is allocated and repositioned for every tag */
+		auto *cursor = static_cast<lua_html_tag *>(lua_newuserdata(L, sizeof(lua_html_tag)));
+		cursor->html = hc;
+		cursor->tag = nullptr;
+		rspamd_lua_setclass(L, rspamd_html_tag_classname, -1);
+		auto cursor_idx = lua_gettop(L);
+
+		hc->traverse_all_tags([&](const rspamd::html::html_tag *tag) -> bool {
+			if (tag && (any || tags.contains(tag->id))) {
+				lua_pushcfunction(L, &rspamd_lua_traceback);
+				auto err_idx = lua_gettop(L);
+				lua_pushvalue(L, 3);
+
+				cursor->tag = tag;
+				lua_pushvalue(L, cursor_idx);
+				auto ct = tag->get_content(hc);
+				lua_pushinteger(L, ct.size());
+
+				/* Leaf flag */
+				if (tag->children.empty()) {
+					lua_pushboolean(L, true);
+				}
+				else {
+					lua_pushboolean(L, false);
+				}
+
+				if (lua_pcall(L, 3, 1, err_idx) != 0) {
+					msg_err("error in foreach_tag_cursor callback: %s", lua_tostring(L, -1));
+					lua_settop(L, err_idx - 1);
+					return false;
+				}
+
+				if (lua_toboolean(L, -1)) {
+					lua_settop(L, err_idx - 1);
+					return false;
+				}
+
+				lua_settop(L, err_idx - 1);
+			}
+
+			return true;
+		});
+
+		lua_settop(L, cursor_idx - 1);
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 0;
+}
+
+static int
+lua_html_get_attribute_values(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	auto *hc = lua_check_html(L, 1);
+	const char *tagname = luaL_checkstring(L, 2);
+	gsize alen;
+	const char *attr_name = luaL_checklstring(L, 3, &alen);
+	int id = -1;
+	auto any = false;
+
+	if (hc && tagname && attr_name) {
+		if (strcmp(tagname, "any") == 0) {
+			any = true;
+		}
+		else {
+			id = rspamd_html_tag_by_name(tagname);
+
+			if (id == -1) {
+				return luaL_error(L, "invalid tagname: %s", tagname);
+			}
+		}
+
+		auto comp = rspamd::html::html_component_from_string({attr_name, alen});
+		int i = 1;
+
+		lua_newtable(L);
+
+		hc->traverse_all_tags([&](const rspamd::html::html_tag *tag) -> bool {
+			if (tag && (any || tag->id == id)) {
+				auto maybe_attr = tag->find_component(comp);
+
+				if (maybe_attr) {
+					lua_new_text(L, maybe_attr->data(), maybe_attr->size(), false);
+					lua_rawseti(L, -2, i++);
+				}
+			}
+
+			return true;
+		});
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static int
 lua_html_get_invisible(lua_State *L)
 {
@@ -53,6 +53,12 @@ LUA_FUNCTION_DEF(mempool, add_destructor);
  * Destroys memory pool cleaning all variables and calling all destructors registered (both C and Lua ones)
  */
 LUA_FUNCTION_DEF(mempool, delete);
+/***
+ * @method mempool:stat()
+ * Returns memory usage of the pool: `used_size` is the total of bytes requested
+ * from the pool and `wasted_size` is the slack lost on chunk switches
+ * @return {table} pool memory usage
+ */
 LUA_FUNCTION_DEF(mempool, stat);
 LUA_FUNCTION_DEF(mempool, suggest_size);
 /***
@@ -243,6 +249,11 @@ lua_mempool_stat(lua_State *L)
 	struct memory_pool_s *mempool = rspamd_lua_check_mempool(L, 1);
 
 	if (mempool) {
+		lua_createtable(L, 0, 2);
+		lua_pushinteger(L, rspamd_mempool_get_used_size(mempool));
+		lua_setfield(L, -2, "used_size");
+		lua_pushinteger(L, rspamd_mempool_get_wasted_size(mempool));
+		lua_setfield(L, -2, "wasted_size");
 	}
 	else {
 		lua_pushnil(L);
@@ -17,6 +17,7 @@
 #include "lua_common.h"
 #include "lua_url.h"
 #include "libmime/message.h"
+#include "libmime/mime_parser.h"
 #include "libmime/lang_detection.h"
 #include "libstat/stat_api.h"
 #include "libcryptobox/cryptobox.h"
@@ -124,6 +125,7 @@ LUA_FUNCTION_DEF(textpart, get_lines_count);
  * - `empty_lines`: number of empty lines
  * - `non_ascii_characters`: number of non ascii characters
  * - `ascii_characters`: number of ascii characters
+ * - `invalid_utf8_bytes`: number of bytes replaced whilst enforcing utf8
  * @return {table} table of stats
  */
 LUA_FUNCTION_DEF(textpart, get_stats);
@@ -1349,6 +1351,7 @@ lua_textpart_get_mimepart(lua_State *L)
  * - `empty_lines`: number of empty lines
  * - `non_ascii_characters`: number of non ascii characters
  * - `ascii_characters`: number of ascii characters
+ * - `invalid_utf8_bytes`: number of bytes replaced whilst enforcing utf8
  * @return {table} table of stats
  */
 static int
@@ -1381,6 +1384,9 @@ lua_textpart_get_stats(lua_State *L)
 		lua_pushstring(L, "non_ascii_characters");
 		lua_pushinteger(L, part->non_ascii_chars);
 		lua_settable(L, -3);
+		lua_pushstring(L, "invalid_utf8_bytes");
+		lua_pushinteger(L, part->invalid_utf8_bytes);
+		lua_settable(L, -3);
 		lua_pushstring(L, "capital_letters");
 		lua_pushinteger(L, part->capital_letters);
 		lua_settable(L, -3);
@@ -1409,6 +1415,10 @@ lua_mimepart_get_content(lua_State *L)
 		return 1;
 	}
 
+	if (part->task) {
+		rspamd_mime_part_ensure_parsed_data(part->task, part);
+	}
+
 	t = lua_newuserdata(L, sizeof(*t));
 	rspamd_lua_setclass(L, rspamd_text_classname, -1);
 	t->start = part->parsed_data.begin;
@@ -1454,6 +1464,10 @@ lua_mimepart_get_length(lua_State *L)
 		return 1;
 	}
 
+	if (part->task) {
+		rspamd_mime_part_ensure_parsed_data(part->task, part);
+	}
+
 	lua_pushinteger(L, part->parsed_data.len);
 
 	return 1;
@@ -2049,6 +2063,11 @@ lua_mimepart_get_digest(lua_State *L)
 		return luaL_error(L, "invalid arguments");
 	}
 
+	if (part->task) {
+		/* The canonical digest is calculated over the decoded content */
+		rspamd_mime_part_ensure_parsed_data(part->task, part);
+	}
+
 	memset(digestbuf, 0, sizeof(digestbuf));
 	rspamd_encode_hex_buf(part->digest, sizeof(part->digest),
 						  digestbuf, sizeof(digestbuf));
@@ -47,10 +47,28 @@ LUA_FUNCTION_DEF(shingle, get);
  */
 LUA_FUNCTION_DEF(shingle, get_string);
 
+/***
+ * @method shingle:compare(other)
+ * Compares two shingles in a single C call without materialising tables
+ * @param {shingle} other shingle to compare with
+ * @return {number} similarity from 0.0 (different) to 1.0 (equal)
+ */
+LUA_FUNCTION_DEF(shingle, compare);
+
+/***
+ * @method shingle:distance(other)
+ * Returns the hamming distance over shingle rows
+ * @param {shingle} other shingle to compare with
+ * @return {number} number of rows that differ, from 0 to RSPAMD_SHINGLE_SIZE
+ */
+LUA_FUNCTION_DEF(shingle, distance);
+
 static const struct luaL_reg shinglelib_m[] = {
 	LUA_INTERFACE_DEF(shingle, to_table),
 	LUA_INTERFACE_DEF(shingle, get),
 	LUA_INTERFACE_DEF(shingle, get_string),
+	LUA_INTERFACE_DEF(shingle, compare),
+	LUA_INTERFACE_DEF(shingle, distance),
 	{"__tostring", rspamd_lua_class_tostring},
 	{nullptr, nullptr}};
 
@@ -126,6 +144,37 @@ lua_shingle_get_string(lua_State *L)
 	return 1;
 }
 
+static int
+lua_shingle_compare(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	auto *sh = lua_check_shingle(L, 1);
+	auto *other = lua_check_shingle(L, 2);
+
+	lua_pushnumber(L, rspamd_shingles_compare(sh, other));
+
+	return 1;
+}
+
+static int
+lua_shingle_distance(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	auto *sh = lua_check_shingle(L, 1);
+	auto *other = lua_check_shingle(L, 2);
+	int distance = 0;
+
+	for (int i = 0; i < RSPAMD_SHINGLE_SIZE; i++) {
+		if (sh->hashes[i] != other->hashes[i]) {
+			distance++;
+		}
+	}
+
+	lua_pushinteger(L, distance);
+
+	return 1;
+}
+
 void luaopen_shingle(lua_State *L)
 {
 	rspamd_lua_new_class(L, rspamd_shingle_classname, shinglelib_m);
@@ -160,6 +160,24 @@ LUA_FUNCTION_DEF(task, insert_result);
  */
 LUA_FUNCTION_DEF(task, insert_result_named);
 
+/***
+ * @method task:insert_results([enforce_symbols,]results)
+ * Insert a batch of symbols to the tasks scanning results crossing the
+ * Lua/C boundary merely once. Each element of `results` is an array formed
+ * as `{symbol, weight[, option1, ...]}` with the same semantics as the
+ * arguments of `task:insert_result`.
+ * @param {boolean} enforce_symbols if represented and true, then insert symbols even if they are not registered in the metric
+ * @param {table} results list of symbols to insert
+@example
+local function cb(task)
+	task:insert_results({
+		{'SOME_HEADER', 1.0, 'Got some header'},
+		{'ANOTHER_SYMBOL', 0.5},
+	})
+end
+ */
+LUA_FUNCTION_DEF(task, insert_results);
+
 /***
  * @method task:adjust_result(symbol, score[, option1, ...])
  * Alters the existing symbol's score to a new score. It is not affected by
@@ -421,6 +439,17 @@ LUA_FUNCTION_DEF(task, get_header_full);
  * @return {number} number of header's occurrences or 0 if not found
  */
 LUA_FUNCTION_DEF(task, get_header_count);
+/***
+ * @method task:get_header_text(name[, case_sensitive])
+ * Get raw value of a header as an opaque text view without copying it into
+ * a Lua string; the view is merely valid whilst the task exists, use
+ * `tostring` if a plugin truly needs a standalone copy.
+ * By default headers are searched in caseless matter.
+ * @param {string} name name of header to get
+ * @param {boolean} case_sensitive case sensitiveness flag to search for a header
+ * @return {rspamd_text} raw value of a header as opaque text
+ */
+LUA_FUNCTION_DEF(task, get_header_text);
 /***
  * @method task:get_raw_headers()
  * Get all undecoded headers of a message as a string
@@ -1058,6 +1087,7 @@ LUA_FUNCTION_DEF(task, set_flag);
  * - `skip`: skip task processing
  * - `learn_spam`: learn message as spam
  * - `learn_ham`: learn message as ham
+ * - `learn_auto`: message can be learned automatically
  * - `broken_headers`: header data is broken for a message
  * @param {string} flag to check
  * @return {boolean} true if flags is set
@@ -1255,6 +1285,7 @@ static const struct luaL_reg tasklib_m[] = {
 	LUA_INTERFACE_DEF(task, get_worker),
 	LUA_INTERFACE_DEF(task, insert_result),
 	LUA_INTERFACE_DEF(task, insert_result_named),
+	LUA_INTERFACE_DEF(task, insert_results),
 	LUA_INTERFACE_DEF(task, adjust_result),
 	LUA_INTERFACE_DEF(task, remove_result),
 	LUA_INTERFACE_DEF(task, set_pre_result),
@@ -1277,6 +1308,7 @@ static const struct luaL_reg tasklib_m[] = {
 	LUA_INTERFACE_DEF(task, get_header_raw),
 	LUA_INTERFACE_DEF(task, get_header_full),
 	LUA_INTERFACE_DEF(task, get_header_count),
+	LUA_INTERFACE_DEF(task, get_header_text),
 	LUA_INTERFACE_DEF(task, get_raw_headers),
 	LUA_INTERFACE_DEF(task, get_headers),
 	LUA_INTERFACE_DEF(task, modify_header),
@@ -1388,6 +1420,7 @@ LUA_FUNCTION_DEF(archive, get_files_full);
 LUA_FUNCTION_DEF(archive, is_encrypted);
 LUA_FUNCTION_DEF(archive, is_obfuscated);
 LUA_FUNCTION_DEF(archive, is_unreadable);
+LUA_FUNCTION_DEF(archive, is_truncated);
 LUA_FUNCTION_DEF(archive, get_filename);
 LUA_FUNCTION_DEF(archive, get_size);
 
@@ -1398,6 +1431,7 @@ static const struct luaL_reg archivelib_m[] = {
 	LUA_INTERFACE_DEF(archive, is_encrypted),
 	LUA_INTERFACE_DEF(archive, is_obfuscated),
 	LUA_INTERFACE_DEF(archive, is_unreadable),
+	LUA_INTERFACE_DEF(archive, is_truncated),
 	LUA_INTERFACE_DEF(archive, get_filename),
 	LUA_INTERFACE_DEF(archive, get_size),
 	{"__tostring", rspamd_lua_class_tostring},
@@ -2199,6 +2233,106 @@ lua_task_insert_result_named(lua_State *L)
 	return luaL_error(L, "invalid arguments");
 }
 
+static int
+lua_task_insert_results(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_task *task = lua_check_task(L, 1);
+	enum rspamd_symbol_insert_flags flags = RSPAMD_SYMBOL_INSERT_DEFAULT;
+	int args_pos = 2;
+
+	if (task == NULL) {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	if (lua_isboolean(L, args_pos)) {
+		if (lua_toboolean(L, args_pos)) {
+			flags |= RSPAMD_SYMBOL_INSERT_ENFORCE;
+		}
+
+		args_pos++;
+	}
+
+	luaL_checktype(L, args_pos, LUA_TTABLE);
+
+	gsize nres = rspamd_lua_table_size(L, args_pos);
+
+	for (gsize i = 1; i <= nres; i++) {
+		const char *symbol_name;
+		double weight;
+		struct rspamd_symbol_result *s;
+		gsize elt_len;
+
+		lua_rawgeti(L, args_pos, i);
+
+		if (lua_type(L, -1) != LUA_TTABLE) {
+			lua_pop(L, 1);
+
+			return luaL_error(L, "result element %d is not a table", (int) i);
+		}
+
+		elt_len = rspamd_lua_table_size(L, -1);
+
+		if (elt_len < 2) {
+			lua_pop(L, 1);
+
+			return luaL_error(L, "result element %d lacks symbol or weight",
+							  (int) i);
+		}
+
+		lua_rawgeti(L, -1, 1);
+		symbol_name = rspamd_mempool_strdup(task->task_pool,
+											luaL_checkstring(L, -1));
+		lua_pop(L, 1);
+		lua_rawgeti(L, -1, 2);
+		weight = luaL_checknumber(L, -1);
+		lua_pop(L, 1);
+
+		s = rspamd_task_insert_result_full(task, symbol_name, weight,
+										   NULL, flags, NULL);
+
+		if (s) {
+			if (s->sym == NULL) {
+				msg_info_task("symbol insertion issue: unknown symbol %s",
+							  symbol_name);
+			}
+
+			for (gsize j = 3; j <= elt_len; j++) {
+				lua_rawgeti(L, -1, j);
+
+				if (lua_type(L, -1) == LUA_TSTRING) {
+					gsize optlen;
+					const char *opt = lua_tolstring(L, -1, &optlen);
+
+					rspamd_task_add_result_option(task, s, opt, optlen);
+				}
+				else if (lua_type(L, -1) == LUA_TUSERDATA) {
+					struct rspamd_lua_text *t = lua_check_text(L, -1);
+
+					if (t) {
+						rspamd_task_add_result_option(task, s, t->start,
+													  t->len);
+					}
+				}
+				else {
+					const char *tname = lua_typename(L, lua_type(L, -1));
+					lua_pop(L, 2);
+
+					return luaL_error(L, "not a string option "
+										 "when adding symbol %s: %s type",
+									  s->name, tname);
+				}
+
+				lua_pop(L, 1);
+			}
+		}
+
+		lua_pop(L, 1);
+	}
+
+	return 0;
+}
+
 static int
 lua_task_adjust_result(lua_State *L)
 {
@@ -3054,6 +3188,10 @@ int rspamd_lua_push_header(lua_State *L, struct rspamd_mime_header *rh,
 						   enum rspamd_lua_task_header_type how)
 {
 	LUA_TRACE_POINT;
+
+	/* Headers obtained by direct iteration can still be lazily decoded */
+	rspamd_mime_header_get_decoded(rh);
+
 	switch (how) {
 	case RSPAMD_TASK_HEADER_PUSH_FULL:
 		/* Create new associated table for a header */
@@ -3101,6 +3239,21 @@ int rspamd_lua_push_header(lua_State *L, struct rspamd_mime_header *rh,
 			lua_pushnil(L);
 		}
 		break;
+	case RSPAMD_TASK_HEADER_PUSH_RAW_TEXT:
+		if (rh->raw_len > 0) {
+			struct rspamd_lua_text *t;
+
+			/* Zero-copy view into the message, valid whilst the task is */
+			t = lua_newuserdata(L, sizeof(*t));
+			rspamd_lua_setclass(L, rspamd_text_classname, -1);
+			t->start = rh->raw_value;
+			t->len = rh->raw_len;
+			t->flags = 0;
+		}
+		else {
+			lua_pushnil(L);
+		}
+		break;
 	case RSPAMD_TASK_HEADER_PUSH_COUNT:
 	default:
 		g_assert_not_reached();
@@ -3248,6 +3401,12 @@ lua_task_get_header_count(lua_State *L)
 	return lua_task_get_header_common(L, RSPAMD_TASK_HEADER_PUSH_COUNT);
 }
 
+static int
+lua_task_get_header_text(lua_State *L)
+{
+	return lua_task_get_header_common(L, RSPAMD_TASK_HEADER_PUSH_RAW_TEXT);
+}
+
 static int
 lua_task_has_header(lua_State *L)
 {
@@ -4813,9 +4972,9 @@ lua_push_symbol_result(lua_State *L,
 			lua_settable(L, -3);
 		}
 
-		if (s->options) {
+		if (s->opts_head) {
 			lua_pushstring(L, "options");
-			lua_createtable(L, kh_size(s->options), 0);
+			lua_createtable(L, s->nopts, 0);
 
 			DL_FOREACH(s->opts_head, opt)
 			{
@@ -5609,6 +5768,7 @@ lua_task_has_flag(lua_State *L)
 		LUA_TASK_GET_FLAG(flag, "skip", RSPAMD_TASK_FLAG_SKIP);
 		LUA_TASK_GET_FLAG(flag, "learn_spam", RSPAMD_TASK_FLAG_LEARN_SPAM);
 		LUA_TASK_GET_FLAG(flag, "learn_ham", RSPAMD_TASK_FLAG_LEARN_HAM);
+		LUA_TASK_GET_FLAG(flag, "learn_auto", RSPAMD_TASK_FLAG_LEARN_AUTO);
 		LUA_TASK_GET_FLAG(flag, "greylisted", RSPAMD_TASK_FLAG_GREYLISTED);
 		LUA_TASK_GET_FLAG(flag, "broken_headers",
 						  RSPAMD_TASK_FLAG_BROKEN_HEADERS);
@@ -5620,6 +5780,8 @@ lua_task_has_flag(lua_State *L)
 						  RSPAMD_TASK_FLAG_MIME);
 		LUA_TASK_GET_FLAG(flag, "message_rewrite",
 						  RSPAMD_TASK_FLAG_MESSAGE_REWRITE);
+		LUA_TASK_GET_FLAG(flag, "mem_degraded",
+						  RSPAMD_TASK_FLAG_MEM_DEGRADED);
 		LUA_TASK_GET_PROTOCOL_FLAG(flag, "milter",
 								   RSPAMD_TASK_PROTOCOL_FLAG_MILTER);
 
@@ -5681,6 +5843,10 @@ lua_task_get_flags(lua_State *L)
 					lua_pushstring(L, "learn_ham");
 					lua_rawseti(L, -2, idx++);
 					break;
+				case RSPAMD_TASK_FLAG_LEARN_AUTO:
+					lua_pushstring(L, "learn_auto");
+					lua_rawseti(L, -2, idx++);
+					break;
 				case RSPAMD_TASK_FLAG_GREYLISTED:
 					lua_pushstring(L, "greylisted");
 					lua_rawseti(L, -2, idx++);
@@ -5693,6 +5859,10 @@ lua_task_get_flags(lua_State *L)
 					lua_pushstring(L, "message_rewrite");
 					lua_rawseti(L, -2, idx++);
 					break;
+				case RSPAMD_TASK_FLAG_MEM_DEGRADED:
+					lua_pushstring(L, "mem_degraded");
+					lua_rawseti(L, -2, idx++);
+					break;
 				default:
 					break;
 				}
@@ -7382,6 +7552,22 @@ lua_archive_is_unreadable(lua_State *L)
 	return 1;
 }
 
+static int
+lua_archive_is_truncated(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_archive *arch = lua_check_archive(L);
+
+	if (arch != NULL) {
+		lua_pushboolean(L, (arch->flags & RSPAMD_ARCHIVE_TRUNCATED) ? true : false);
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static int
 lua_archive_get_size(lua_State *L)
 {
@@ -36,30 +36,72 @@ static void thread_entry_free(lua_State *L, struct thread_entry *ent);
 
 struct lua_thread_pool {
 	std::vector<struct thread_entry *> available_items;
+	std::vector<struct thread_entry *> dead_items;
 	lua_State *L;
 	int max_items;
 	struct thread_entry *running_entry;
+	/* Recycling telemetry */
+	uint64_t allocated_cnt;
+	uint64_t reused_cnt;
+	uint64_t terminated_cnt;
+	unsigned int in_use;
+	unsigned int peak_in_use;
 	static const int default_max_items = 100;
+	static const int low_watermark_divisor = 10;
+	/* Dead coroutines are reclaimed in batches of this size */
+	static const unsigned int dead_batch = 16;
 
 	lua_thread_pool(lua_State *L, int max_items = default_max_items)
 		: L(L), max_items(max_items)
 	{
 		running_entry = nullptr;
+		allocated_cnt = 0;
+		reused_cnt = 0;
+		terminated_cnt = 0;
+		in_use = 0;
+		peak_in_use = 0;
 		available_items.reserve(max_items);
 
-		for (auto i = 0; i < MAX(2, max_items / 10); i++) {
+		for (auto i = 0; i < MAX(2, max_items / low_watermark_divisor); i++) {
 			auto *ent = thread_entry_new(L);
+			allocated_cnt++;
 			available_items.push_back(ent);
 		}
 	}
 
 	~lua_thread_pool()
 	{
+		collect_dead();
+
 		for (auto *ent: available_items) {
 			thread_entry_free(L, ent);
 		}
 	}
 
+	/*
+	 * Number of free threads worth retaining: follows the peak of
+	 * simultaneously used threads, so bursts stop allocating fresh
+	 * coroutines, decaying back to the low watermark afterwards
+	 */
+	auto retain_limit() const -> std::size_t
+	{
+		return MIN((std::size_t) max_items,
+				   MAX((std::size_t) MAX(2, max_items / low_watermark_divisor),
+					   (std::size_t) peak_in_use));
+	}
+
+	auto collect_dead() -> void
+	{
+		for (auto *ent: dead_items) {
+			thread_entry_free(L, ent);
+		}
+
+		dead_items.clear();
+
+		/* Let the peak decay towards the current usage */
+		peak_in_use -= (peak_in_use - in_use) / 2;
+	}
+
 	auto get_thread() -> struct thread_entry *
 	{
 		struct thread_entry *ent;
@@ -67,9 +109,17 @@ struct lua_thread_pool {
 		if (!available_items.empty()) {
 			ent = available_items.back();
 			available_items.pop_back();
+			reused_cnt++;
 		}
 		else {
 			ent = thread_entry_new(L);
+			allocated_cnt++;
+		}
+
+		in_use++;
+
+		if (in_use > peak_in_use) {
+			peak_in_use = in_use;
 		}
 
 		running_entry = ent;
@@ -86,7 +136,11 @@ struct lua_thread_pool {
 			running_entry = NULL;
 		}
 
-		if (available_items.size() <= max_items) {
+		if (in_use > 0) {
+			in_use--;
+		}
+
+		if (available_items.size() <= retain_limit()) {
 			thread_entry->cd = NULL;
 			thread_entry->finish_callback = NULL;
 			thread_entry->error_callback = NULL;
@@ -103,7 +157,11 @@ struct lua_thread_pool {
 			msg_debug_lua_threads("%s: removed thread as thread pool has %ud items",
 								  loc,
 								  available_items.size());
-			thread_entry_free(L, thread_entry);
+			dead_items.push_back(thread_entry);
+
+			if (dead_items.size() >= dead_batch) {
+				collect_dead();
+			}
 		}
 	}
 
@@ -111,8 +169,6 @@ struct lua_thread_pool {
 						  const char *loc,
 						  bool enforce) -> void
 	{
-		struct thread_entry *ent = NULL;
-
 		if (!enforce) {
 			/* we should only terminate failed threads */
 			g_assert(lua_status(thread_entry->lua_state) != 0 &&
@@ -123,12 +179,21 @@ struct lua_thread_pool {
 			running_entry = NULL;
 		}
 
+		if (in_use > 0) {
+			in_use--;
+		}
+
+		terminated_cnt++;
+
+		/*
+		 * Dead coroutines are merely parked and reclaimed in a batched
+		 * pass; a replacement is allocated lazily on the next get_thread
+		 */
 		msg_debug_lua_threads("%s: terminated thread entry", loc);
-		thread_entry_free(L, thread_entry);
+		dead_items.push_back(thread_entry);
 
-		if (available_items.size() <= max_items) {
-			ent = thread_entry_new(L);
-			available_items.push_back(ent);
+		if (dead_items.size() >= dead_batch) {
+			collect_dead();
 		}
 	}
 
@@ -175,6 +240,17 @@ void lua_thread_pool_free(struct lua_thread_pool *pool)
 	delete pool;
 }
 
+void lua_thread_pool_get_stats(struct lua_thread_pool *pool,
+							   struct lua_thread_pool_stats *st)
+{
+	st->allocated = pool->allocated_cnt;
+	st->reused = pool->reused_cnt;
+	st->terminated = pool->terminated_cnt;
+	st->available = pool->available_items.size();
+	st->in_use = pool->in_use;
+	st->peak_in_use = pool->peak_in_use;
+}
+
 
 struct thread_entry *
 lua_thread_pool_get_for_task(struct rspamd_task *task)
@@ -50,6 +50,23 @@ lua_thread_pool_new(lua_State *L);
  */
 void lua_thread_pool_free(struct lua_thread_pool *pool);
 
+struct lua_thread_pool_stats {
+	uint64_t allocated;    /* threads created over the pool lifetime */
+	uint64_t reused;       /* threads recycled from the free list */
+	uint64_t terminated;   /* threads removed after a failure */
+	unsigned int available;/* threads currently in the free list */
+	unsigned int in_use;   /* threads currently running or yielded */
+	unsigned int peak_in_use;
+};
+
+/**
+ * Fills recycling telemetry for the pool
+ * @param pool
+ * @param st
+ */
+void lua_thread_pool_get_stats(struct lua_thread_pool *pool,
+							   struct lua_thread_pool_stats *st);
+
 /**
  * Extracts a thread from the list of available ones.
  * It immediately becomes the running one and should be used to run a Lua script/function straight away.
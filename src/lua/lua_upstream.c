@@ -57,6 +57,7 @@ LUA_FUNCTION_DEF(upstream_list, get_upstream_by_hash);
 LUA_FUNCTION_DEF(upstream_list, get_upstream_round_robin);
 LUA_FUNCTION_DEF(upstream_list, get_upstream_master_slave);
 LUA_FUNCTION_DEF(upstream_list, add_watcher);
+LUA_FUNCTION_DEF(upstream_list, carry_state);
 
 static const struct luaL_reg upstream_list_m[] = {
 
@@ -65,6 +66,7 @@ static const struct luaL_reg upstream_list_m[] = {
 	LUA_INTERFACE_DEF(upstream_list, get_upstream_master_slave),
 	LUA_INTERFACE_DEF(upstream_list, all_upstreams),
 	LUA_INTERFACE_DEF(upstream_list, add_watcher),
+	LUA_INTERFACE_DEF(upstream_list, carry_state),
 	{"__tostring", rspamd_lua_class_tostring},
 	{"__gc", lua_upstream_list_destroy},
 	{NULL, NULL}};
@@ -75,6 +77,7 @@ static const struct luaL_reg upstream_list_f[] = {
 /* Upstream functions */
 LUA_FUNCTION_DEF(upstream, ok);
 LUA_FUNCTION_DEF(upstream, fail);
+LUA_FUNCTION_DEF(upstream, update_latency);
 LUA_FUNCTION_DEF(upstream, get_addr);
 LUA_FUNCTION_DEF(upstream, get_name);
 LUA_FUNCTION_DEF(upstream, get_port);
@@ -83,6 +86,7 @@ LUA_FUNCTION_DEF(upstream, destroy);
 static const struct luaL_reg upstream_m[] = {
 	LUA_INTERFACE_DEF(upstream, ok),
 	LUA_INTERFACE_DEF(upstream, fail),
+	LUA_INTERFACE_DEF(upstream, update_latency),
 	LUA_INTERFACE_DEF(upstream, get_addr),
 	LUA_INTERFACE_DEF(upstream, get_port),
 	LUA_INTERFACE_DEF(upstream, get_name),
@@ -212,6 +216,25 @@ lua_upstream_ok(lua_State *L)
 	return 0;
 }
 
+/***
+ * @method upstream:update_latency(latency)
+ * Feeds an observed request latency (in seconds) into the upstream latency EWMA,
+ * used by the `latency-weighted` rotation to prefer the fastest replicas.
+ * @param {number} latency request latency in seconds
+ */
+static int
+lua_upstream_update_latency(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_upstream *up = lua_check_upstream(L, 1);
+
+	if (up && lua_isnumber(L, 2)) {
+		rspamd_upstream_update_latency(up->up, lua_tonumber(L, 2));
+	}
+
+	return 0;
+}
+
 static int
 lua_upstream_destroy(lua_State *L)
 {
@@ -344,6 +367,30 @@ lua_upstream_list_destroy(lua_State *L)
 	return 0;
 }
 
+/***
+ * @method upstream_list:carry_state(old_list)
+ * Carries errors, latency and alive state over from an old list to this one,
+ * matching entries by name; new entries start with a clean slate. Use it when
+ * rebuilding an upstream list on configuration change to avoid resetting the
+ * health of all upstreams at once.
+ * @param {upstream_list} old_list the list being replaced
+ */
+static int
+lua_upstream_list_carry_state(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct upstream_list *upl = lua_check_upstream_list(L);
+	void *ud = rspamd_lua_check_udata(L, 2, rspamd_upstream_list_classname);
+
+	luaL_argcheck(L, ud != NULL, 2, "'upstream_list' expected");
+
+	if (upl && ud) {
+		rspamd_upstreams_carry_state(upl, *(struct upstream_list **) ud);
+	}
+
+	return 0;
+}
+
 /***
  * @method upstream_list:get_upstream_by_hash(key)
  * Get upstream by hash from key
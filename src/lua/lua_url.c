@@ -56,6 +56,7 @@ LUA_FUNCTION_DEF(url, get_raw);
 LUA_FUNCTION_DEF(url, get_tld);
 LUA_FUNCTION_DEF(url, get_flags);
 LUA_FUNCTION_DEF(url, get_flags_num);
+LUA_FUNCTION_DEF(url, get_digests);
 LUA_FUNCTION_DEF(url, get_protocol);
 LUA_FUNCTION_DEF(url, to_table);
 LUA_FUNCTION_DEF(url, is_phished);
@@ -100,6 +101,7 @@ static const struct luaL_reg urllib_m[] = {
 	LUA_INTERFACE_DEF(url, get_count),
 	LUA_INTERFACE_DEF(url, get_flags),
 	LUA_INTERFACE_DEF(url, get_flags_num),
+	LUA_INTERFACE_DEF(url, get_digests),
 	LUA_INTERFACE_DEF(url, get_order),
 	LUA_INTERFACE_DEF(url, get_part_order),
 	LUA_INTERFACE_DEF(url, to_http),
@@ -1042,6 +1044,41 @@ lua_url_get_flags_num(lua_State *L)
 	return 1;
 }
 
+/***
+ * @method url:get_digests()
+ * Get fast digests of the url parts that are commonly used as lookup keys,
+ * derived in a single pass over the url string
+ * @return {table} table with `full`, `host` and `tld` hex string digests
+ */
+static int
+lua_url_get_digests(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_url *url = lua_check_url(L, 1);
+	struct rspamd_url_digests dig;
+	char numbuf[sizeof("18446744073709551615")];
+
+	if (url) {
+		rspamd_url_get_digests(url->url, &dig);
+
+		lua_createtable(L, 0, 3);
+		rspamd_snprintf(numbuf, sizeof(numbuf), "%xL", dig.full_digest);
+		lua_pushstring(L, numbuf);
+		lua_setfield(L, -2, "full");
+		rspamd_snprintf(numbuf, sizeof(numbuf), "%xL", dig.host_digest);
+		lua_pushstring(L, numbuf);
+		lua_setfield(L, -2, "host");
+		rspamd_snprintf(numbuf, sizeof(numbuf), "%xL", dig.tld_digest);
+		lua_pushstring(L, numbuf);
+		lua_setfield(L, -2, "tld");
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static int
 lua_url_get_order(lua_State *L)
 {
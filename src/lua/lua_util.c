@@ -282,6 +282,39 @@ LUA_FUNCTION_DEF(util, strequal_caseless);
  */
 LUA_FUNCTION_DEF(util, strequal_caseless_utf8);
 
+/***
+ * @function util.str_trim(str)
+ * Returns a string (or text) with no trailing and leading spaces
+ * @param {string} str input string or rspamd_text
+ * @return {string} trimmed result; a zero-copy span for rspamd_text input
+ */
+LUA_FUNCTION_DEF(util, str_trim);
+
+/***
+ * @function util.str_split(str[, sep])
+ * Splits a string (or text) into a numeric table by a set of delimiter
+ * characters (whitespace if not specified); empty fields are preserved
+ * @param {string} str input string or rspamd_text
+ * @param {string} sep set of delimiter characters
+ * @return {table} parts; zero-copy spans for rspamd_text input
+ */
+LUA_FUNCTION_DEF(util, str_split);
+
+/***
+ * @function util.str_startswith(str, prefix)
+ * @param {string} str input string or rspamd_text
+ * @param {string} prefix
+ * @return {bool} true if `str` starts with `prefix`
+ */
+LUA_FUNCTION_DEF(util, str_startswith);
+
+/***
+ * @function util.str_endswith(str, suffix)
+ * @param {string} str input string or rspamd_text
+ * @param {string} suffix
+ * @return {bool} true if `str` ends with `suffix`
+ */
+LUA_FUNCTION_DEF(util, str_endswith);
 
 /***
  * @function util.get_ticks()
@@ -699,6 +732,10 @@ static const struct luaL_reg utillib_f[] = {
 	LUA_INTERFACE_DEF(util, transliterate),
 	LUA_INTERFACE_DEF(util, strequal_caseless),
 	LUA_INTERFACE_DEF(util, strequal_caseless_utf8),
+	LUA_INTERFACE_DEF(util, str_trim),
+	LUA_INTERFACE_DEF(util, str_split),
+	LUA_INTERFACE_DEF(util, str_startswith),
+	LUA_INTERFACE_DEF(util, str_endswith),
 	LUA_INTERFACE_DEF(util, get_ticks),
 	LUA_INTERFACE_DEF(util, get_time),
 	LUA_INTERFACE_DEF(util, time_to_string),
@@ -1720,6 +1757,138 @@ lua_util_strequal_caseless_utf8(lua_State *L)
 	return 1;
 }
 
+static inline void
+lua_util_push_text_part(lua_State *L, gboolean is_string,
+						const char *start, gsize len)
+{
+	if (is_string) {
+		lua_pushlstring(L, start, len);
+	}
+	else {
+		/* Zero-copy span into the parent text, which must outlive it */
+		lua_new_text(L, start, len, FALSE);
+	}
+}
+
+static int
+lua_util_str_trim(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t;
+	gboolean is_string = lua_type(L, 1) == LUA_TSTRING;
+
+	t = lua_check_text_or_string(L, 1);
+
+	if (t) {
+		const char *start = t->start, *end = t->start + t->len;
+
+		while (start < end && g_ascii_isspace(*start)) {
+			start++;
+		}
+
+		while (end > start && g_ascii_isspace(*(end - 1))) {
+			end--;
+		}
+
+		lua_util_push_text_part(L, is_string, start, end - start);
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
+static int
+lua_util_str_split(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t;
+	gboolean is_string = lua_type(L, 1) == LUA_TSTRING;
+	const char *sep = " \t\v\f\r\n";
+	gsize seplen = sizeof(" \t\v\f\r\n") - 1;
+	bool sep_tbl[256];
+
+	t = lua_check_text_or_string(L, 1);
+
+	if (!t) {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	if (lua_type(L, 2) == LUA_TSTRING) {
+		sep = lua_tolstring(L, 2, &seplen);
+	}
+
+	/* Separator argument is a set of characters, as in the Lua version */
+	memset(sep_tbl, 0, sizeof(sep_tbl));
+
+	for (gsize i = 0; i < seplen; i++) {
+		sep_tbl[(unsigned char) sep[i]] = true;
+	}
+
+	const char *p = t->start, *end = t->start + t->len, *piece = t->start;
+	int i = 1;
+
+	lua_createtable(L, 8, 0);
+
+	while (p < end) {
+		if (sep_tbl[(unsigned char) *p]) {
+			/* Empty fields are preserved */
+			lua_util_push_text_part(L, is_string, piece, p - piece);
+			lua_rawseti(L, -2, i++);
+			piece = p + 1;
+		}
+
+		p++;
+	}
+
+	lua_util_push_text_part(L, is_string, piece, end - piece);
+	lua_rawseti(L, -2, i);
+
+	return 1;
+}
+
+static int
+lua_util_str_startswith(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t, *prefix;
+
+	t = lua_check_text_or_string(L, 1);
+	prefix = lua_check_text_or_string(L, 2);
+
+	if (t && prefix) {
+		lua_pushboolean(L, t->len >= prefix->len &&
+							   memcmp(t->start, prefix->start, prefix->len) == 0);
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
+static int
+lua_util_str_endswith(lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t, *suffix;
+
+	t = lua_check_text_or_string(L, 1);
+	suffix = lua_check_text_or_string(L, 2);
+
+	if (t && suffix) {
+		lua_pushboolean(L, t->len >= suffix->len &&
+							   memcmp(t->start + (t->len - suffix->len),
+									  suffix->start, suffix->len) == 0);
+	}
+	else {
+		return luaL_error(L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static int
 lua_util_get_ticks(lua_State *L)
 {
@@ -1694,6 +1694,60 @@ rspamd_can_alias_latin(int ch)
 	return latin_confusable.contains(ch);
 }
 
+/*
+ * Checks that a word consists solely of ASCII alphabetic characters,
+ * processing 16 bytes per iteration; such words cannot contribute any
+ * badness, so they are skipped without per-character classification
+ */
+static inline gboolean
+rspamd_chartable_word_is_plain_alpha(const unsigned char *p, gsize len)
+{
+	constexpr uint64_t ones = 0x0101010101010101ULL;
+	constexpr uint64_t highs = 0x8080808080808080ULL;
+	/* SWAR: any byte less than n (for bytes < 0x80 merely) */
+	constexpr auto has_less = [](uint64_t x, uint64_t n) -> uint64_t {
+		return (x - ones * n) & ~x & highs;
+	};
+	/* SWAR: any byte greater than n (n < 0x80) */
+	constexpr auto has_more = [](uint64_t x, uint64_t n) -> uint64_t {
+		return ((x + ones * (127 - n)) | x) & highs;
+	};
+
+	while (len >= 16) {
+		uint64_t w1, w2;
+
+		memcpy(&w1, p, sizeof(w1));
+		memcpy(&w2, p + sizeof(w1), sizeof(w2));
+
+		if ((w1 | w2) & highs) {
+			return FALSE;
+		}
+
+		/* Fold case, then ensure all bytes are within 'a'..'z' */
+		w1 |= ones * 0x20;
+		w2 |= ones * 0x20;
+
+		if (has_less(w1, 'a') || has_more(w1, 'z') ||
+			has_less(w2, 'a') || has_more(w2, 'z')) {
+			return FALSE;
+		}
+
+		p += 16;
+		len -= 16;
+	}
+
+	while (len > 0) {
+		if (!g_ascii_isalpha(*p)) {
+			return FALSE;
+		}
+
+		p++;
+		len--;
+	}
+
+	return TRUE;
+}
+
 static double
 rspamd_chartable_process_word_utf(struct rspamd_task *task,
 								  rspamd_stat_token_t *w,
@@ -1729,8 +1783,17 @@ rspamd_chartable_process_word_utf(struct rspamd_task *task,
 			break;
 		}
 
-		sc = ublock_getCode(uc);
-		cat = u_charType(uc);
+		auto is_ascii = uc < 0x80;
+
+		if (is_ascii) {
+			/* First level: ASCII needs no ICU lookups at all */
+			sc = UBLOCK_BASIC_LATIN;
+			cat = U_UNASSIGNED;
+		}
+		else {
+			sc = ublock_getCode(uc);
+			cat = u_charType(uc);
+		}
 
 		if (!ignore_diacritics) {
 			if (cat == U_NON_SPACING_MARK ||
@@ -1743,7 +1806,7 @@ rspamd_chartable_process_word_utf(struct rspamd_task *task,
 			}
 		}
 
-		if (u_isalpha(uc)) {
+		if (is_ascii ? g_ascii_isalpha(uc) : u_isalpha(uc)) {
 
 			if (sc <= UBLOCK_COMBINING_DIACRITICAL_MARKS ||
 				sc == UBLOCK_LATIN_EXTENDED_ADDITIONAL) {
@@ -1792,7 +1855,7 @@ rspamd_chartable_process_word_utf(struct rspamd_task *task,
 			prev_state = state;
 			state = got_alpha;
 		}
-		else if (u_isdigit(uc)) {
+		else if (is_ascii ? g_ascii_isdigit(uc) : u_isdigit(uc)) {
 			if (state != got_digit) {
 				prev_state = state;
 			}
@@ -1868,6 +1931,11 @@ rspamd_chartable_process_word_ascii(struct rspamd_task *task,
 		return 0.0;
 	}
 
+	/* Fast path: a plain alphabetic ASCII word yields no badness */
+	if (rspamd_chartable_word_is_plain_alpha(p, w->normalized.len)) {
+		return 0.0;
+	}
+
 	/* We assume that w is normalized */
 	while (p < end) {
 		if (g_ascii_isalpha(*p) || *p > 0x7f) {
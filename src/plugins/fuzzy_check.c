@@ -35,6 +35,7 @@
 #include "libserver/maps/map.h"
 #include "libserver/maps/map_helpers.h"
 #include "libmime/images.h"
+#include "libmime/mime_parser.h"
 #include "libserver/worker_util.h"
 #include "libserver/mempool_vars_internal.h"
 #include "fuzzy_wire.h"
@@ -47,6 +48,7 @@
 #include "libstat/stat_api.h"
 #include <math.h>
 #include "libutil/libev_helper.h"
+#include "libutil/hash.h"
 
 #define DEFAULT_SYMBOL "R_FUZZY_HASH"
 #define RSPAMD_FUZZY_SYMBOL_FORBIDDEN "FUZZY_FORBIDDEN"
@@ -58,6 +60,8 @@
 #define DEFAULT_MAX_ERRORS 4
 #define DEFAULT_REVIVE_TIME 60
 #define DEFAULT_PORT 11335
+#define DEFAULT_NEG_CACHE_SIZE 2048
+#define DEFAULT_NEG_CACHE_TTL 10.0
 
 #define RSPAMD_FUZZY_PLUGIN_VERSION RSPAMD_FUZZY_VERSION
 
@@ -97,6 +101,7 @@ struct fuzzy_rule {
 	gboolean skip_unknown;
 	gboolean no_share;
 	gboolean no_subject;
+	gboolean batch_requests;
 	int learn_condition_cb;
 	uint32_t retransmits;
 	struct rspamd_hash_map_helper *skip_map;
@@ -112,6 +117,12 @@ struct fuzzy_ctx {
 	const char *default_symbol;
 	struct rspamd_radix_map_helper *whitelist;
 	struct rspamd_keypair_cache *keypairs_cache;
+	/* Fresh misses (digest -> nothing) to avoid repeat round trips */
+	rspamd_lru_hash_t *negative_cache;
+	/* In-flight checks that concurrent tasks can piggyback on */
+	GHashTable *inflight_digests;
+	unsigned int negative_cache_size;
+	double negative_cache_ttl;
 	unsigned int max_errors;
 	double revive_time;
 	double io_timeout;
@@ -146,6 +157,10 @@ struct fuzzy_client_session {
 	struct fuzzy_rule *rule;
 	struct ev_loop *event_loop;
 	struct rspamd_io_ev ev;
+	/* In-flight digests this session owns or waits upon */
+	GPtrArray *inflight;
+	/* Monotonic time when the commands were sent, for upstream latency */
+	double sent_at;
 	int state;
 	int fd;
 	int retransmits;
@@ -173,6 +188,8 @@ struct fuzzy_learn_session {
 #define FUZZY_CMD_FLAG_SENT (1 << 1)
 #define FUZZY_CMD_FLAG_IMAGE (1 << 2)
 #define FUZZY_CMD_FLAG_CONTENT (1 << 3)
+/* Awaiting the reply of an identical in-flight command from another task */
+#define FUZZY_CMD_FLAG_COALESCED (1 << 4)
 
 #define FUZZY_CHECK_FLAG_NOIMAGES (1 << 0)
 #define FUZZY_CHECK_FLAG_NOATTACHMENTS (1 << 1)
@@ -186,12 +203,59 @@ struct fuzzy_cmd_io {
 	struct rspamd_fuzzy_cmd cmd;
 };
 
+/* Key for both the negative cache and the in-flight registry */
+struct fuzzy_check_digest_key {
+	struct fuzzy_rule *rule;
+	unsigned char digest[rspamd_cryptobox_HASHBYTES];
+};
+
+struct fuzzy_inflight_waiter {
+	struct fuzzy_client_session *session;
+	struct fuzzy_cmd_io *io;
+};
+
+struct fuzzy_inflight_cmd {
+	/* Must be the first member to share the address with the hash key */
+	struct fuzzy_check_digest_key key;
+	struct fuzzy_client_session *owner;
+	GPtrArray *waiters; /* struct fuzzy_inflight_waiter */
+};
+
+static guint
+fuzzy_digest_key_hash(gconstpointer p)
+{
+	return (guint) rspamd_cryptobox_fast_hash(p,
+											  sizeof(struct fuzzy_check_digest_key), rspamd_hash_seed());
+}
+
+static gboolean
+fuzzy_digest_key_equal(gconstpointer a, gconstpointer b)
+{
+	return (memcmp(a, b, sizeof(struct fuzzy_check_digest_key)) == 0);
+}
+
+static void
+fuzzy_inflight_cmd_dtor(gpointer p)
+{
+	struct fuzzy_inflight_cmd *cmd = p;
+
+	g_ptr_array_free(cmd->waiters, TRUE);
+	g_free(cmd);
+}
+
 
 static const char *default_headers = "Subject,Content-Type,Reply-To,X-Mailer";
 
 static void fuzzy_symbol_callback(struct rspamd_task *task,
 								  struct rspamd_symcache_dynamic_item *item,
 								  void *unused);
+static void fuzzy_insert_result(struct fuzzy_client_session *session,
+								const struct rspamd_fuzzy_reply *rep,
+								struct rspamd_fuzzy_cmd *cmd,
+								struct fuzzy_cmd_io *io,
+								unsigned int flag);
+static gboolean fuzzy_check_session_is_completed(struct fuzzy_client_session *session);
+static void fuzzy_check_inflight_cleanup(struct fuzzy_client_session *session);
 
 /* Initialization */
 int fuzzy_check_module_init(struct rspamd_config *cfg,
@@ -501,6 +565,10 @@ fuzzy_parse_rule(struct rspamd_config *cfg, const ucl_object_t *obj,
 		rule->no_subject = ucl_obj_toboolean(value);
 	}
 
+	if ((value = ucl_object_lookup(obj, "batch_requests")) != NULL) {
+		rule->batch_requests = ucl_obj_toboolean(value);
+	}
+
 	if ((value = ucl_object_lookup(obj, "algorithm")) != NULL) {
 		rule->algorithm_str = ucl_object_tostring(value);
 
@@ -714,6 +782,9 @@ int fuzzy_check_module_init(struct rspamd_config *cfg, struct module_ctx **ctx)
 													  NULL, 0);
 	/* TODO: this should match rules count actually */
 	fuzzy_module_ctx->keypairs_cache = rspamd_keypair_cache_new(32);
+	fuzzy_module_ctx->inflight_digests = g_hash_table_new_full(fuzzy_digest_key_hash,
+															   fuzzy_digest_key_equal,
+															   NULL, fuzzy_inflight_cmd_dtor);
 	fuzzy_module_ctx->fuzzy_rules = g_ptr_array_new();
 	fuzzy_module_ctx->cfg = cfg;
 	fuzzy_module_ctx->process_rule_ref = -1;
@@ -726,6 +797,9 @@ int fuzzy_check_module_init(struct rspamd_config *cfg, struct module_ctx **ctx)
 	rspamd_mempool_add_destructor(cfg->cfg_pool,
 								  (rspamd_mempool_destruct_t) rspamd_keypair_cache_destroy,
 								  fuzzy_module_ctx->keypairs_cache);
+	rspamd_mempool_add_destructor(cfg->cfg_pool,
+								  (rspamd_mempool_destruct_t) g_hash_table_destroy,
+								  fuzzy_module_ctx->inflight_digests);
 	rspamd_mempool_add_destructor(cfg->cfg_pool,
 								  (rspamd_mempool_destruct_t) rspamd_ptr_array_free_hard,
 								  fuzzy_module_ctx->fuzzy_rules);
@@ -823,6 +897,24 @@ int fuzzy_check_module_init(struct rspamd_config *cfg, struct module_ctx **ctx)
 							   0,
 							   NULL,
 							   0);
+	rspamd_rcl_add_doc_by_path(cfg,
+							   "fuzzy_check",
+							   "Maximum number of recent misses cached to suppress repeat checks (0 to disable)",
+							   "negative_cache_size",
+							   UCL_INT,
+							   NULL,
+							   0,
+							   NULL,
+							   0);
+	rspamd_rcl_add_doc_by_path(cfg,
+							   "fuzzy_check",
+							   "Time to live for a cached miss",
+							   "negative_cache_ttl",
+							   UCL_TIME,
+							   NULL,
+							   0,
+							   NULL,
+							   0);
 	rspamd_rcl_add_doc_by_path(cfg,
 							   "fuzzy_check",
 							   "Time to lapse before re-resolve faulty upstream",
@@ -1015,6 +1107,15 @@ int fuzzy_check_module_init(struct rspamd_config *cfg, struct module_ctx **ctx)
 							   0,
 							   "false",
 							   0);
+	rspamd_rcl_add_doc_by_path(cfg,
+							   "fuzzy_check.rule",
+							   "Pack several commands into one datagram (requires server support)",
+							   "batch_requests",
+							   UCL_BOOLEAN,
+							   NULL,
+							   0,
+							   "false",
+							   0);
 	rspamd_rcl_add_doc_by_path(cfg,
 							   "fuzzy_check.rule",
 							   "Disable sharing message stats with the fuzzy server",
@@ -1153,6 +1254,35 @@ int fuzzy_check_module_config(struct rspamd_config *cfg, bool validate)
 		fuzzy_module_ctx->revive_time = DEFAULT_REVIVE_TIME;
 	}
 
+	if ((value =
+			 rspamd_config_get_module_opt(cfg, "fuzzy_check",
+										  "negative_cache_size")) != NULL) {
+		fuzzy_module_ctx->negative_cache_size = ucl_obj_toint(value);
+	}
+	else {
+		fuzzy_module_ctx->negative_cache_size = DEFAULT_NEG_CACHE_SIZE;
+	}
+
+	if ((value =
+			 rspamd_config_get_module_opt(cfg, "fuzzy_check",
+										  "negative_cache_ttl")) != NULL) {
+		fuzzy_module_ctx->negative_cache_ttl = ucl_obj_todouble(value);
+	}
+	else {
+		fuzzy_module_ctx->negative_cache_ttl = DEFAULT_NEG_CACHE_TTL;
+	}
+
+	if (fuzzy_module_ctx->negative_cache_size > 0 &&
+		fuzzy_module_ctx->negative_cache_ttl > 0) {
+		fuzzy_module_ctx->negative_cache = rspamd_lru_hash_new_full(
+			fuzzy_module_ctx->negative_cache_size,
+			g_free, NULL,
+			fuzzy_digest_key_hash, fuzzy_digest_key_equal);
+		rspamd_mempool_add_destructor(cfg->cfg_pool,
+									  (rspamd_mempool_destruct_t) rspamd_lru_hash_destroy,
+									  fuzzy_module_ctx->negative_cache);
+	}
+
 	if ((value =
 			 rspamd_config_get_module_opt(cfg, "fuzzy_check",
 										  "whitelist")) != NULL) {
@@ -1354,6 +1484,8 @@ fuzzy_io_fin(void *ud)
 {
 	struct fuzzy_client_session *session = ud;
 
+	fuzzy_check_inflight_cleanup(session);
+
 	if (session->commands) {
 		g_ptr_array_free(session->commands, TRUE);
 	}
@@ -1362,8 +1494,10 @@ fuzzy_io_fin(void *ud)
 		g_ptr_array_free(session->results, TRUE);
 	}
 
-	rspamd_ev_watcher_stop(session->event_loop, &session->ev);
-	close(session->fd);
+	if (session->fd != -1) {
+		rspamd_ev_watcher_stop(session->event_loop, &session->ev);
+		close(session->fd);
+	}
 }
 
 static GArray *
@@ -1394,8 +1528,13 @@ fuzzy_encrypt_cmd(struct fuzzy_rule *rule,
 	memcpy(hdr->pubkey, pk, MIN(pklen, sizeof(hdr->pubkey)));
 	pk = rspamd_pubkey_get_pk(rule->peer_key, &pklen);
 	memcpy(hdr->key_id, pk, MIN(sizeof(hdr->key_id), pklen));
-	rspamd_keypair_cache_process(rule->ctx->keypairs_cache,
-								 rule->local_key, rule->peer_key);
+
+	/* Derive NM merely once per rule: the peer key is fixed */
+	if (rspamd_pubkey_get_nm(rule->peer_key, rule->local_key) == NULL) {
+		rspamd_keypair_cache_process(rule->ctx->keypairs_cache,
+									 rule->local_key, rule->peer_key);
+	}
+
 	rspamd_cryptobox_encrypt_nm_inplace(data, datalen,
 										hdr->nonce, rspamd_pubkey_get_nm(rule->peer_key, rule->local_key),
 										hdr->mac);
@@ -1613,6 +1752,247 @@ fuzzy_cmd_set_cached(struct fuzzy_rule *rule,
 	}
 }
 
+/*
+ * For checks: returns TRUE if a fresh miss for this digest is cached, so the
+ * command can be elided. For modifications: drops the cached miss, as the
+ * hash is about to change.
+ */
+static gboolean
+fuzzy_check_negcache_lookup(struct rspamd_task *task,
+							struct fuzzy_rule *rule,
+							struct fuzzy_cmd_io *io,
+							int c)
+{
+	struct fuzzy_ctx *ctx = rule->ctx;
+	struct fuzzy_check_digest_key key;
+
+	if (ctx->negative_cache == NULL) {
+		return FALSE;
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.rule = rule;
+	memcpy(key.digest, io->cmd.digest, sizeof(key.digest));
+
+	if (c == FUZZY_CHECK) {
+		if (rspamd_lru_hash_lookup(ctx->negative_cache, &key,
+								   (time_t) rspamd_get_calendar_ticks()) != NULL) {
+			msg_debug_fuzzy_check("skip request for %*xs: a fresh miss is cached",
+								  (int) sizeof(io->cmd.digest), io->cmd.digest);
+
+			return TRUE;
+		}
+	}
+	else {
+		rspamd_lru_hash_remove(ctx->negative_cache, &key);
+	}
+
+	return FALSE;
+}
+
+static void
+fuzzy_check_negcache_update(struct fuzzy_client_session *session,
+							struct rspamd_fuzzy_cmd *cmd,
+							const struct rspamd_fuzzy_reply *rep)
+{
+	struct fuzzy_ctx *ctx = session->rule->ctx;
+	struct fuzzy_check_digest_key skey, *key;
+
+	if (ctx->negative_cache == NULL) {
+		return;
+	}
+
+	if (rep->v1.prob > 0.5) {
+		/* The hash has appeared in the storage meanwhile */
+		memset(&skey, 0, sizeof(skey));
+		skey.rule = session->rule;
+		memcpy(skey.digest, cmd->digest, sizeof(skey.digest));
+		rspamd_lru_hash_remove(ctx->negative_cache, &skey);
+	}
+	else if (rep->v1.value == 0) {
+		/* A genuine miss and not an error reply */
+		key = g_malloc0(sizeof(*key));
+		key->rule = session->rule;
+		memcpy(key->digest, cmd->digest, sizeof(key->digest));
+		rspamd_lru_hash_insert(ctx->negative_cache, key, key,
+							   (time_t) rspamd_get_calendar_ticks(),
+							   (unsigned int) ctx->negative_cache_ttl);
+	}
+}
+
+/*
+ * Attach commands whose digest is already in flight from another task as
+ * waiters of that request; returns the number of commands this session has
+ * to send on its own
+ */
+static unsigned int
+fuzzy_check_inflight_register(struct fuzzy_client_session *session)
+{
+	struct fuzzy_ctx *ctx = session->rule->ctx;
+	struct rspamd_task *task = session->task;
+	struct fuzzy_inflight_cmd *cmd;
+	struct fuzzy_inflight_waiter *w;
+	struct fuzzy_check_digest_key key;
+	struct fuzzy_cmd_io *io;
+	unsigned int i, nown = 0;
+
+	if (ctx->inflight_digests == NULL) {
+		return session->commands->len;
+	}
+
+	if (session->inflight == NULL) {
+		session->inflight = g_ptr_array_new();
+	}
+
+	PTR_ARRAY_FOREACH(session->commands, i, io)
+	{
+		if (io->cmd.cmd != FUZZY_CHECK) {
+			nown++;
+			continue;
+		}
+
+		memset(&key, 0, sizeof(key));
+		key.rule = session->rule;
+		memcpy(key.digest, io->cmd.digest, sizeof(key.digest));
+		cmd = g_hash_table_lookup(ctx->inflight_digests, &key);
+
+		if (cmd != NULL) {
+			if (cmd->owner == session) {
+				/*
+				 * A duplicate digest within this very session: making the
+				 * session wait for itself would complete it from inside its
+				 * own reply processing loop, so send the command as our own
+				 */
+				nown++;
+				continue;
+			}
+
+			msg_debug_fuzzy_check("coalesce request for %*xs with an in-flight one",
+								  (int) sizeof(io->cmd.digest), io->cmd.digest);
+			io->flags |= FUZZY_CMD_FLAG_COALESCED;
+			w = g_malloc0(sizeof(*w));
+			w->session = session;
+			w->io = io;
+			g_ptr_array_add(cmd->waiters, w);
+		}
+		else {
+			cmd = g_malloc0(sizeof(*cmd));
+			cmd->key.rule = session->rule;
+			memcpy(cmd->key.digest, io->cmd.digest, sizeof(cmd->key.digest));
+			cmd->owner = session;
+			cmd->waiters = g_ptr_array_new_with_free_func(g_free);
+			g_hash_table_insert(ctx->inflight_digests, &cmd->key, cmd);
+			nown++;
+		}
+
+		g_ptr_array_add(session->inflight, cmd);
+	}
+
+	return nown;
+}
+
+/*
+ * Replay a reply obtained by another task's round trip in the context of a
+ * waiting session
+ */
+static void
+fuzzy_check_process_shared_reply(struct fuzzy_client_session *session,
+								 struct fuzzy_cmd_io *io,
+								 const struct rspamd_fuzzy_reply *rep)
+{
+	struct rspamd_task *task = session->task;
+
+	io->flags |= FUZZY_CMD_FLAG_REPLIED;
+
+	if (rep == NULL) {
+		/* The owner's round trip has failed, share its fate */
+		msg_debug_fuzzy_check("no reply for a coalesced request %*xs",
+							  (int) sizeof(io->cmd.digest), io->cmd.digest);
+
+		return;
+	}
+
+	if (rep->v1.prob > 0.5) {
+		fuzzy_insert_result(session, rep, &io->cmd, io, rep->v1.flag);
+	}
+	else if (rep->v1.value == 403) {
+		rspamd_task_insert_result(task, RSPAMD_FUZZY_SYMBOL_RATELIMITED, 1.0,
+								  session->rule->name);
+	}
+	else if (rep->v1.value == 503) {
+		rspamd_task_insert_result(task, RSPAMD_FUZZY_SYMBOL_FORBIDDEN, 1.0,
+								  session->rule->name);
+	}
+	else if (rep->v1.value == 415) {
+		rspamd_task_insert_result(task, RSPAMD_FUZZY_SYMBOL_ENCRYPTION_REQUIRED, 1.0,
+								  session->rule->name);
+	}
+}
+
+/*
+ * Propagate an owner's reply (or its failure if rep is NULL) to all waiting
+ * sessions and drop the in-flight entry
+ */
+static void
+fuzzy_check_inflight_fanout(struct fuzzy_client_session *session,
+							struct fuzzy_inflight_cmd *cmd,
+							const struct rspamd_fuzzy_reply *rep)
+{
+	struct fuzzy_ctx *ctx = session->rule->ctx;
+	struct fuzzy_inflight_waiter *w;
+	unsigned int i;
+
+	g_hash_table_steal(ctx->inflight_digests, &cmd->key);
+
+	PTR_ARRAY_FOREACH(cmd->waiters, i, w)
+	{
+		g_ptr_array_remove(w->session->inflight, cmd);
+		fuzzy_check_process_shared_reply(w->session, w->io, rep);
+		fuzzy_check_session_is_completed(w->session);
+	}
+
+	fuzzy_inflight_cmd_dtor(cmd);
+}
+
+/*
+ * Detach a session from all in-flight entries it is involved into; entries
+ * it owns are failed over to their waiters
+ */
+static void
+fuzzy_check_inflight_cleanup(struct fuzzy_client_session *session)
+{
+	struct fuzzy_inflight_cmd *cmd;
+	struct fuzzy_inflight_waiter *w;
+	unsigned int i;
+
+	if (session->inflight == NULL) {
+		return;
+	}
+
+	while (session->inflight->len > 0) {
+		cmd = g_ptr_array_index(session->inflight,
+								session->inflight->len - 1);
+		g_ptr_array_remove_index(session->inflight,
+								 session->inflight->len - 1);
+
+		if (cmd->owner == session) {
+			fuzzy_check_inflight_fanout(session, cmd, NULL);
+		}
+		else {
+			PTR_ARRAY_FOREACH(cmd->waiters, i, w)
+			{
+				if (w->session == session) {
+					g_ptr_array_remove_index(cmd->waiters, i);
+					break;
+				}
+			}
+		}
+	}
+
+	g_ptr_array_free(session->inflight, TRUE);
+	session->inflight = NULL;
+}
+
 static gboolean
 fuzzy_rule_check_mimepart(struct rspamd_task *task,
 						  struct fuzzy_rule *rule,
@@ -2188,27 +2568,96 @@ fuzzy_cmd_to_wire(int fd, struct iovec *io)
 	return TRUE;
 }
 
+/*
+ * Limit for a batch datagram; matches the storage input buffer
+ */
+#define FUZZY_BATCH_BYTES_LIMIT 4096
+
 static gboolean
-fuzzy_cmd_vector_to_wire(int fd, GPtrArray *v)
+fuzzy_cmd_batch_flush(int fd, struct iovec *frames, unsigned int cnt)
 {
+	struct rspamd_fuzzy_batch_hdr hdr;
+	uint16_t lens[RSPAMD_FUZZY_BATCH_MAX];
+	unsigned char hdrbuf[sizeof(hdr) + sizeof(lens)];
+	struct iovec iovs[RSPAMD_FUZZY_BATCH_MAX + 1];
+	struct msghdr msg;
 	unsigned int i;
+
+	if (cnt == 1) {
+		/* No reason to pay for the batch framing */
+		return fuzzy_cmd_to_wire(fd, frames);
+	}
+
+	memcpy(hdr.magic, fuzzy_batch_magic, sizeof(hdr.magic));
+	hdr.version = RSPAMD_FUZZY_BATCH_VERSION;
+	hdr.count = cnt;
+
+	for (i = 0; i < cnt; i++) {
+		lens[i] = GUINT16_TO_LE((uint16_t) frames[i].iov_len);
+		iovs[i + 1] = frames[i];
+	}
+
+	memcpy(hdrbuf, &hdr, sizeof(hdr));
+	memcpy(hdrbuf + sizeof(hdr), lens, cnt * sizeof(lens[0]));
+	iovs[0].iov_base = hdrbuf;
+	iovs[0].iov_len = sizeof(hdr) + cnt * sizeof(lens[0]);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iovs;
+	msg.msg_iovlen = cnt + 1;
+
+	while (sendmsg(fd, &msg, 0) == -1) {
+		if (errno == EINTR) {
+			continue;
+		}
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+fuzzy_cmd_vector_to_wire(int fd, struct fuzzy_rule *rule, GPtrArray *v)
+{
+	unsigned int i, nbatched = 0;
 	gboolean all_sent = TRUE, all_replied = TRUE;
 	struct fuzzy_cmd_io *io;
 	gboolean processed = FALSE;
+	struct iovec batch_frames[RSPAMD_FUZZY_BATCH_MAX];
+	gsize batch_bytes = sizeof(struct rspamd_fuzzy_batch_hdr) +
+						RSPAMD_FUZZY_BATCH_MAX * sizeof(uint16_t);
 
 	/* First try to resend unsent commands */
 	for (i = 0; i < v->len; i++) {
 		io = g_ptr_array_index(v, i);
 
-		if (io->flags & FUZZY_CMD_FLAG_REPLIED) {
+		if (io->flags & (FUZZY_CMD_FLAG_REPLIED | FUZZY_CMD_FLAG_COALESCED)) {
+			/* Coalesced commands are replied by another task's request */
 			continue;
 		}
 
 		all_replied = FALSE;
 
 		if (!(io->flags & FUZZY_CMD_FLAG_SENT)) {
-			if (!fuzzy_cmd_to_wire(fd, &io->io)) {
-				return FALSE;
+			if (rule->batch_requests) {
+				/* Pack several frames into one datagram */
+				if (nbatched == RSPAMD_FUZZY_BATCH_MAX ||
+					batch_bytes + io->io.iov_len > FUZZY_BATCH_BYTES_LIMIT) {
+					if (!fuzzy_cmd_batch_flush(fd, batch_frames, nbatched)) {
+						return FALSE;
+					}
+					nbatched = 0;
+					batch_bytes = sizeof(struct rspamd_fuzzy_batch_hdr) +
+								  RSPAMD_FUZZY_BATCH_MAX * sizeof(uint16_t);
+				}
+
+				batch_frames[nbatched++] = io->io;
+				batch_bytes += io->io.iov_len;
+			}
+			else {
+				if (!fuzzy_cmd_to_wire(fd, &io->io)) {
+					return FALSE;
+				}
 			}
 			processed = TRUE;
 			io->flags |= FUZZY_CMD_FLAG_SENT;
@@ -2216,17 +2665,23 @@ fuzzy_cmd_vector_to_wire(int fd, GPtrArray *v)
 		}
 	}
 
+	if (nbatched > 0) {
+		if (!fuzzy_cmd_batch_flush(fd, batch_frames, nbatched)) {
+			return FALSE;
+		}
+	}
+
 	if (all_sent && !all_replied) {
 		/* Now try to resend each command in the vector */
 		for (i = 0; i < v->len; i++) {
 			io = g_ptr_array_index(v, i);
 
-			if (!(io->flags & FUZZY_CMD_FLAG_REPLIED)) {
+			if (!(io->flags & (FUZZY_CMD_FLAG_REPLIED | FUZZY_CMD_FLAG_COALESCED))) {
 				io->flags &= ~FUZZY_CMD_FLAG_SENT;
 			}
 		}
 
-		return fuzzy_cmd_vector_to_wire(fd, v);
+		return fuzzy_cmd_vector_to_wire(fd, rule, v);
 	}
 
 	return processed;
@@ -2245,11 +2700,10 @@ fuzzy_process_reply(unsigned char **pos, int *r, GPtrArray *req,
 	unsigned int i, required_size;
 	struct fuzzy_cmd_io *io;
 	const struct rspamd_fuzzy_reply *rep;
-	struct rspamd_fuzzy_encrypted_reply encrep;
 	gboolean found = FALSE;
 
 	if (rule->peer_key) {
-		required_size = sizeof(encrep);
+		required_size = sizeof(struct rspamd_fuzzy_encrypted_reply);
 	}
 	else {
 		required_size = sizeof(*rep);
@@ -2260,33 +2714,35 @@ fuzzy_process_reply(unsigned char **pos, int *r, GPtrArray *req,
 	}
 
 	if (rule->peer_key) {
-		memcpy(&encrep, p, sizeof(encrep));
+		struct rspamd_fuzzy_encrypted_reply *encrep =
+			(struct rspamd_fuzzy_encrypted_reply *) p;
+
 		*pos += required_size;
 		*r -= required_size;
 
-		/* Try to decrypt reply */
-		rspamd_keypair_cache_process(rule->ctx->keypairs_cache,
-									 rule->local_key, rule->peer_key);
+		if (rspamd_pubkey_get_nm(rule->peer_key, rule->local_key) == NULL) {
+			rspamd_keypair_cache_process(rule->ctx->keypairs_cache,
+										 rule->local_key, rule->peer_key);
+		}
 
-		if (!rspamd_cryptobox_decrypt_nm_inplace((unsigned char *) &encrep.rep,
-												 sizeof(encrep.rep),
-												 encrep.hdr.nonce,
+		/* Decrypt reply in place in the datagram buffer */
+		if (!rspamd_cryptobox_decrypt_nm_inplace((unsigned char *) &encrep->rep,
+												 sizeof(encrep->rep),
+												 encrep->hdr.nonce,
 												 rspamd_pubkey_get_nm(rule->peer_key, rule->local_key),
-												 encrep.hdr.mac)) {
+												 encrep->hdr.mac)) {
 			msg_info("cannot decrypt reply");
 			return NULL;
 		}
 
-		/* Copy decrypted over the input wire */
-		memcpy(p, &encrep.rep, sizeof(encrep.rep));
+		rep = &encrep->rep;
 	}
 	else {
 
 		*pos += required_size;
 		*r -= required_size;
+		rep = (const struct rspamd_fuzzy_reply *) p;
 	}
-
-	rep = (const struct rspamd_fuzzy_reply *) p;
 	/*
 	 * Search for tag
 	 */
@@ -2578,6 +3034,27 @@ fuzzy_check_try_read(struct fuzzy_client_session *session)
 					rep->v1.value);
 			}
 
+			if (cmd->cmd == FUZZY_CHECK) {
+				fuzzy_check_negcache_update(session, cmd, rep);
+
+				if (session->inflight != NULL) {
+					/* Share this reply with the tasks waiting for the digest */
+					struct fuzzy_check_digest_key key;
+					struct fuzzy_inflight_cmd *icmd;
+
+					memset(&key, 0, sizeof(key));
+					key.rule = session->rule;
+					memcpy(key.digest, cmd->digest, sizeof(key.digest));
+					icmd = g_hash_table_lookup(session->rule->ctx->inflight_digests,
+											   &key);
+
+					if (icmd != NULL && icmd->owner == session) {
+						g_ptr_array_remove(session->inflight, icmd);
+						fuzzy_check_inflight_fanout(session, icmd, rep);
+					}
+				}
+			}
+
 			ret = 1;
 		}
 	}
@@ -2694,6 +3171,13 @@ fuzzy_check_session_is_completed(struct fuzzy_client_session *session)
 
 	rspamd_upstream_ok(session->server);
 
+	if (session->sent_at > 0) {
+		/* Includes retransmits, which is the latency clients actually observe */
+		rspamd_upstream_update_latency(session->server,
+									   rspamd_get_ticks(FALSE) - session->sent_at);
+		session->sent_at = 0;
+	}
+
 	for (i = 0; i < session->commands->len; i++) {
 		io = g_ptr_array_index(session->commands, i);
 
@@ -2805,7 +3289,7 @@ fuzzy_check_io_callback(int fd, short what, void *arg)
 			else {
 				if (what & EV_WRITE) {
 					/* Retransmit attempt */
-					if (!fuzzy_cmd_vector_to_wire(fd, session->commands)) {
+					if (!fuzzy_cmd_vector_to_wire(fd, session->rule, session->commands)) {
 						ret = return_error;
 					}
 					else {
@@ -2829,7 +3313,7 @@ fuzzy_check_io_callback(int fd, short what, void *arg)
 		}
 	}
 	else if (what & EV_WRITE) {
-		if (!fuzzy_cmd_vector_to_wire(fd, session->commands)) {
+		if (!fuzzy_cmd_vector_to_wire(fd, session->rule, session->commands)) {
 			ret = return_error;
 		}
 		else {
@@ -3105,7 +3589,7 @@ fuzzy_controller_io_callback(int fd, short what, void *arg)
 	}
 	else if (what & EV_WRITE) {
 		/* Send commands to storage */
-		if (!fuzzy_cmd_vector_to_wire(fd, session->commands)) {
+		if (!fuzzy_cmd_vector_to_wire(fd, session->rule, session->commands)) {
 			session->err.error_message = "write socket error";
 			session->err.error_code = errno;
 			ret = return_error;
@@ -3326,9 +3810,24 @@ fuzzy_generate_commands(struct rspamd_task *task, struct fuzzy_rule *rule,
 																  (unsigned char *) h,
 																  mime_part);
 
-									if (io) {
-										io->flags |= FUZZY_CMD_FLAG_CONTENT;
-										g_ptr_array_add(res, io);
+									if (io && !fuzzy_check_negcache_lookup(task,
+																		   rule, io, c)) {
+										gboolean skip_existing = FALSE;
+
+										/* The Lua part processor may emit repeated hashes */
+										PTR_ARRAY_FOREACH(res, j, cur)
+										{
+											if (memcmp(cur->cmd.digest, io->cmd.digest,
+													   sizeof(io->cmd.digest)) == 0) {
+												skip_existing = TRUE;
+												break;
+											}
+										}
+
+										if (!skip_existing) {
+											io->flags |= FUZZY_CMD_FLAG_CONTENT;
+											g_ptr_array_add(res, io);
+										}
 									}
 								}
 							}
@@ -3347,6 +3846,8 @@ fuzzy_generate_commands(struct rspamd_task *task, struct fuzzy_rule *rule,
 					}
 				}
 				else {
+					/* The canonical digest requires the decoded content */
+					rspamd_mime_part_ensure_parsed_data(task, mime_part);
 					io = fuzzy_cmd_from_data_part(rule, c, flag, value,
 												  task,
 												  mime_part->digest, mime_part);
@@ -3355,6 +3856,10 @@ fuzzy_generate_commands(struct rspamd_task *task, struct fuzzy_rule *rule,
 				if (io) {
 					gboolean skip_existing = FALSE;
 
+					if (fuzzy_check_negcache_lookup(task, rule, io, c)) {
+						continue;
+					}
+
 					PTR_ARRAY_FOREACH(res, j, cur)
 					{
 						if (memcmp(cur->cmd.digest, io->cmd.digest,
@@ -3421,14 +3926,25 @@ register_fuzzy_client_call(struct rspamd_task *task,
 				session->rule = rule;
 				session->results = g_ptr_array_sized_new(32);
 				session->event_loop = task->event_loop;
-
-				rspamd_ev_watcher_init(&session->ev,
-									   sock,
-									   EV_WRITE,
-									   fuzzy_check_io_callback,
-									   session);
-				rspamd_ev_watcher_start(session->event_loop, &session->ev,
-										rule->io_timeout);
+				session->sent_at = rspamd_get_ticks(FALSE);
+
+				if (fuzzy_check_inflight_register(session) > 0) {
+					rspamd_ev_watcher_init(&session->ev,
+										   sock,
+										   EV_WRITE,
+										   fuzzy_check_io_callback,
+										   session);
+					rspamd_ev_watcher_start(session->event_loop, &session->ev,
+											rule->io_timeout);
+				}
+				else {
+					/* Everything is piggybacked on other tasks' requests */
+					msg_debug_fuzzy_check("all %d commands are coalesced with "
+										  "in-flight requests",
+										  session->commands->len);
+					close(sock);
+					session->fd = -1;
+				}
 
 				rspamd_session_add_event(task->s, fuzzy_io_fin, session, M);
 				session->item = rspamd_symcache_get_cur_item(task);
@@ -4670,7 +5186,7 @@ fuzzy_lua_io_callback(int fd, short what, void *arg)
 			else {
 				if (what & EV_WRITE) {
 					/* Retransmit attempt */
-					if (!fuzzy_cmd_vector_to_wire(fd, session->commands)) {
+					if (!fuzzy_cmd_vector_to_wire(fd, session->rule, session->commands)) {
 						fuzzy_lua_push_error(session, "cannot write to socket");
 						ret = return_error;
 					}
@@ -4689,7 +5205,7 @@ fuzzy_lua_io_callback(int fd, short what, void *arg)
 		}
 	}
 	else if (what & EV_WRITE) {
-		if (!fuzzy_cmd_vector_to_wire(fd, session->commands)) {
+		if (!fuzzy_cmd_vector_to_wire(fd, session->rule, session->commands)) {
 			fuzzy_lua_push_error(session, "cannot write to socket");
 			ret = return_error;
 		}
@@ -264,11 +264,48 @@ local function arc_callback(task)
     return
   end
 
+  -- The AMS and all seals are verified concurrently: each dkim_verify call
+  -- issues its own key request and the chain status is decided merely when
+  -- every outstanding callback has returned
+  local pending = 0
+  local seal_domains = {}
+  local trusted_signers = {}
+
+  local function arc_chain_finish()
+    if cbdata.res == 'success' then
+      for _, tr in ipairs(trusted_signers) do
+        -- Whitelisted signer has been found in a valid chain
+        task:cache_set(AR_TRUSTED_CACHE_KEY, tr.aar)
+        task:insert_result(arc_symbols.trusted_allow, tr.mult, tr.option)
+      end
+
+      local index = #arc_sig_headers
+      local sig = cbdata.seals[index]
+      local arc_allow_result = string.format('%s:s=%s:i=%d',
+          seal_domains[index] or sig.d, sig.s, index)
+      task:insert_result(arc_symbols.allow, 1.0, arc_allow_result)
+      task:cache_set('arc-allow', arc_allow_result)
+    else
+      task:insert_result(arc_symbols.reject, 1.0,
+          rspamd_logger.slog('arc chain check failed: %s, %s', cbdata.res,
+              cbdata.errors))
+    end
+  end
+
+  local function arc_cb_done()
+    pending = pending - 1
+    if pending == 0 then
+      arc_chain_finish()
+    end
+  end
+
   local function gen_arc_seal_cb(index, sig)
     return function(_, res, err, domain)
       lua_util.debugm(N, task, 'checked arc seal: %s(%s), %s processed',
           res, err, index)
 
+      seal_domains[index] = domain
+
       if not res then
         cbdata.res = 'fail'
         if err and domain then
@@ -276,55 +313,45 @@ local function arc_callback(task)
         end
       end
 
-      if settings.whitelisted_signers_map and cbdata.res == 'success' then
-        if settings.whitelisted_signers_map:get_key(sig.d) then
-          -- Whitelisted signer has been found in a valid chain
-          local mult = 1.0
-          local cur_aar = cbdata.ars[index]
-          if not cur_aar then
-            rspamd_logger.warnx(task, "cannot find Arc-Authentication-Results for trusted " ..
-                "forwarder %s on i=%s", domain, cbdata.index)
-          else
-            task:cache_set(AR_TRUSTED_CACHE_KEY, cur_aar)
-            local seen_dmarc
-            for _, ar in ipairs(cur_aar.ar) do
-              if ar.dmarc then
-                local dmarc_fwd = ar.dmarc
-                seen_dmarc = true
-                if dmarc_fwd == 'reject' or dmarc_fwd == 'fail' or dmarc_fwd == 'quarantine' then
-                  lua_util.debugm(N, "found rejected dmarc on forwarding")
-                  mult = 0.0
-                elseif dmarc_fwd == 'pass' then
-                  mult = 1.0
-                end
-              elseif ar.spf then
-                local spf_fwd = ar.spf
-                if spf_fwd == 'reject' or spf_fwd == 'fail' or spf_fwd == 'quarantine' then
-                  lua_util.debugm(N, "found rejected spf on forwarding")
-                  if not seen_dmarc then
-                    mult = mult * 0.5
-                  end
+      if settings.whitelisted_signers_map and sig.d and
+          settings.whitelisted_signers_map:get_key(sig.d) then
+        local mult = 1.0
+        local cur_aar = cbdata.ars[index]
+        if not cur_aar then
+          rspamd_logger.warnx(task, "cannot find Arc-Authentication-Results for trusted " ..
+              "forwarder %s on i=%s", domain, index)
+        else
+          local seen_dmarc
+          for _, ar in ipairs(cur_aar.ar) do
+            if ar.dmarc then
+              local dmarc_fwd = ar.dmarc
+              seen_dmarc = true
+              if dmarc_fwd == 'reject' or dmarc_fwd == 'fail' or dmarc_fwd == 'quarantine' then
+                lua_util.debugm(N, "found rejected dmarc on forwarding")
+                mult = 0.0
+              elseif dmarc_fwd == 'pass' then
+                mult = 1.0
+              end
+            elseif ar.spf then
+              local spf_fwd = ar.spf
+              if spf_fwd == 'reject' or spf_fwd == 'fail' or spf_fwd == 'quarantine' then
+                lua_util.debugm(N, "found rejected spf on forwarding")
+                if not seen_dmarc then
+                  mult = mult * 0.5
                 end
               end
             end
           end
-          task:insert_result(arc_symbols.trusted_allow, mult,
-              string.format('%s:s=%s:i=%d', domain, sig.s, index))
+          -- Inserted solely when the whole chain validates
+          table.insert(trusted_signers, {
+            mult = mult,
+            aar = cur_aar,
+            option = string.format('%s:s=%s:i=%d', domain, sig.s, index)
+          })
         end
       end
 
-      if index == #arc_sig_headers then
-        if cbdata.res == 'success' then
-          local arc_allow_result = string.format('%s:s=%s:i=%d',
-              domain, sig.s, index)
-          task:insert_result(arc_symbols.allow, 1.0, arc_allow_result)
-          task:cache_set('arc-allow', arc_allow_result)
-        else
-          task:insert_result(arc_symbols.reject, 1.0,
-              rspamd_logger.slog('seal check failed: %s, %s', cbdata.res,
-                  cbdata.errors))
-        end
-      end
+      arc_cb_done()
     end
   end
 
@@ -338,23 +365,8 @@ local function arc_callback(task)
         table.insert(cbdata.errors, string.format('sig:%s:%s', domain, err))
       end
     end
-    if cbdata.res == 'success' then
-      -- Verify seals
-      for i, sig in ipairs(cbdata.seals) do
-        local ret, lerr = dkim_verify(task, sig.header, gen_arc_seal_cb(i, sig), 'arc-seal')
-        if not ret then
-          cbdata.res = 'fail'
-          table.insert(cbdata.errors, string.format('seal:%s:s=%s:i=%s:%s',
-              sig.d or '', sig.s or '', sig.i or '', lerr))
-          lua_util.debugm(N, task, 'checked arc seal %s: %s(%s), %s processed',
-              sig.d, ret, lerr, i)
-        end
-      end
-    else
-      task:insert_result(arc_symbols['reject'], 1.0,
-          rspamd_logger.slog('signature check failed: %s, %s', cbdata.res,
-              cbdata.errors))
-    end
+
+    arc_cb_done()
   end
 
   --[[
@@ -399,24 +411,39 @@ local function arc_callback(task)
        Status is "pass", and the algorithm is complete.
   ]]--
 
-  local processed = 0
+  -- Keep the decision delayed whilst verification requests are being issued;
+  -- each request is counted before dkim_verify is called, as the callback is
+  -- invoked synchronously when the key is already cached
+  pending = 1
+
   local sig = cbdata.sigs[#cbdata.sigs] -- last AMS
+  pending = pending + 1
   local ret, err = dkim_verify(task, sig.header, arc_signature_cb, 'arc-sign')
 
   if not ret then
+    -- Synchronous failure: the callback has not been and will not be called
+    pending = pending - 1
     cbdata.res = 'fail'
     table.insert(cbdata.errors, string.format('sig:%s:%s', sig.d or '', err))
   else
-    processed = processed + 1
     lua_util.debugm(N, task, 'processed arc signature %s[%s]: %s(%s), %s total',
         sig.d, sig.i, ret, err, #cbdata.seals)
   end
 
-  if processed == 0 then
-    task:insert_result(arc_symbols['reject'], 1.0,
-        rspamd_logger.slog('cannot verify %s of %s signatures: %s',
-            #arc_sig_headers - processed, #arc_sig_headers, cbdata.errors))
+  for i, s in ipairs(cbdata.seals) do
+    pending = pending + 1
+    local sret, lerr = dkim_verify(task, s.header, gen_arc_seal_cb(i, s), 'arc-seal')
+    if not sret then
+      pending = pending - 1
+      cbdata.res = 'fail'
+      table.insert(cbdata.errors, string.format('seal:%s:s=%s:i=%s:%s',
+          s.d or '', s.s or '', s.i or '', lerr))
+      lua_util.debugm(N, task, 'checked arc seal %s: %s(%s), %s processed',
+          s.d, sret, lerr, i)
+    end
   end
+
+  arc_cb_done()
 end
 
 local opts = rspamd_config:get_all_opt('arc')
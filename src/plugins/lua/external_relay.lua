@@ -71,6 +71,28 @@ local config_schema = ts.shape {
   ),
 }
 
+-- Memoisation of per-path conclusions: messages traversing our fixed relay
+-- topology share the Received chain fingerprint, so the chain walk is pure
+-- recomputation after the first message. Only the strategies whose walk
+-- depends solely on fingerprinted inputs (hop IPs and flags) are memoised:
+-- hostname_map and ip_map consult hostnames and reloadable maps per hop, so
+-- their conclusions cannot be keyed by the fingerprint.
+-- Merely positive conclusions (the chosen hop index) are cached
+local max_cached_paths = 1000
+
+local function path_cache_put(cache, key, idx)
+  if cache.n >= max_cached_paths then
+    -- Wipe the cache entirely: it refills quickly and the bound also limits
+    -- staleness when a map behind a rule changes
+    for k in pairs(cache) do
+      cache[k] = nil
+    end
+    cache.n = 0
+  end
+  cache[key] = idx
+  cache.n = cache.n + 1
+end
+
 local function set_from_rcvd(task, rcvd)
   local rcvd_ip = rcvd.real_ip
   if not (rcvd_ip and rcvd_ip:is_valid()) then
@@ -103,6 +125,8 @@ strategies.authenticated = function(rule)
     end
   end
 
+  local path_cache = { n = 0 }
+
   return function(task)
     local user = task:get_user()
     if not user then
@@ -117,10 +141,20 @@ strategies.authenticated = function(rule)
     end
 
     local rcvd_hdrs = task:get_received_headers()
+    local fp = rcvd_hdrs.fingerprint
+    local cached = fp and path_cache[fp]
+    if cached then
+      lua_util.debugm(N, task, 'reuse cached conclusion for path %s: hop %s',
+          fp, cached)
+      return set_from_rcvd(task, rcvd_hdrs[cached])
+    end
     -- Try find end of authentication chain
-    for _, rcvd in ipairs(rcvd_hdrs) do
+    for i, rcvd in ipairs(rcvd_hdrs) do
       if not rcvd.flags.authenticated then
         -- Found unauthenticated hop, use this header
+        if fp then
+          path_cache_put(path_cache, fp, i)
+        end
         return set_from_rcvd(task, rcvd)
       end
     end
@@ -225,6 +259,8 @@ strategies.ip_map = function(rule)
 end
 
 strategies['local'] = function(rule)
+  local path_cache = { n = 0 }
+
   return function(task)
     local from_ip = task:get_from_ip()
     if not from_ip then
@@ -239,11 +275,21 @@ strategies['local'] = function(rule)
 
     local rcvd_hdrs = task:get_received_headers()
     local num_rcvd = #rcvd_hdrs
+    local fp = rcvd_hdrs.fingerprint
+    local cached = fp and path_cache[fp]
+    if cached then
+      lua_util.debugm(N, task, 'reuse cached conclusion for path %s: hop %s',
+          fp, cached)
+      return set_from_rcvd(task, rcvd_hdrs[cached])
+    end
     -- Try find first non-local IP in Received headers
     for i, rcvd in ipairs(rcvd_hdrs) do
       if rcvd.real_ip then
         local rcvd_ip = rcvd.real_ip
         if rcvd_ip and rcvd_ip:is_valid() and (not rcvd_ip:is_local() or i == num_rcvd) then
+          if fp then
+            path_cache_put(path_cache, fp, i)
+          end
           return set_from_rcvd(task, rcvd)
         end
       end
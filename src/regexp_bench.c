@@ -0,0 +1,531 @@
+/*
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Standalone benchmark that compares the regexp engines available in rspamd
+ * (pcre via rspamd_regexp, multipattern and raw hyperscan when compiled in)
+ * on a set of expressions and a corpus of saved message parts. It reports
+ * per-engine throughput and the per-pattern cost distribution of the pcre
+ * engine, which is what one actually pays for expressions that cannot be
+ * batched. Expressions are read one per line in the usual rspamd syntax
+ * (bare pattern or /pattern/flags), the remaining arguments are corpus files
+ * where each file is treated as a single message part.
+ */
+
+#include "config.h"
+#include "rspamd.h"
+#include "libutil/util.h"
+#include "libutil/regexp.h"
+#include "libutil/multipattern.h"
+
+#ifdef WITH_HYPERSCAN
+#include "hs.h"
+#endif
+
+struct rspamd_main *rspamd_main = NULL;
+worker_t *workers[] = {NULL};
+
+static char *patterns_file = NULL;
+static int passes = 10;
+static int top_patterns = 20;
+static gboolean raw_input = FALSE;
+
+static GOptionEntry entries[] =
+	{
+		{"patterns", 'p', 0, G_OPTION_ARG_STRING, &patterns_file,
+		 "File with expressions, one per line", NULL},
+		{"passes", 'n', 0, G_OPTION_ARG_INT, &passes,
+		 "Number of passes over the corpus (default: 10)", NULL},
+		{"top", 't', 0, G_OPTION_ARG_INT, &top_patterns,
+		 "Number of slowest pcre patterns to report (default: 20)", NULL},
+		{"raw", 'r', 0, G_OPTION_ARG_NONE, &raw_input,
+		 "Treat corpus as raw (non utf8) input", NULL},
+		{NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+struct bench_pattern {
+	char *line;
+	rspamd_regexp_t *re;
+	double pcre_time;
+	uint64_t hits;
+};
+
+struct bench_part {
+	char *data;
+	gsize len;
+};
+
+static GPtrArray *
+bench_load_patterns(const char *fname)
+{
+	GPtrArray *res;
+	char *content = NULL, **lines;
+	gsize len;
+	GError *err = NULL;
+	unsigned int i;
+
+	if (!g_file_get_contents(fname, &content, &len, &err)) {
+		fprintf(stderr, "cannot read %s: %s\n", fname, err->message);
+		exit(EXIT_FAILURE);
+	}
+
+	res = g_ptr_array_new();
+	lines = g_strsplit(content, "\n", -1);
+
+	for (i = 0; lines[i] != NULL; i++) {
+		struct bench_pattern *bp;
+		char *line = g_strstrip(lines[i]);
+		rspamd_regexp_t *re;
+
+		if (*line == '\0' || *line == '#') {
+			continue;
+		}
+
+		re = rspamd_regexp_new(line, NULL, &err);
+
+		if (re == NULL) {
+			fprintf(stderr, "skip invalid expression '%s': %s\n", line,
+					err ? err->message : "unknown error");
+			g_clear_error(&err);
+			continue;
+		}
+
+		bp = g_malloc0(sizeof(*bp));
+		bp->line = g_strdup(line);
+		bp->re = re;
+		g_ptr_array_add(res, bp);
+	}
+
+	g_strfreev(lines);
+	g_free(content);
+
+	return res;
+}
+
+static GPtrArray *
+bench_load_corpus(char **fnames, int nfnames, gsize *total_len)
+{
+	GPtrArray *res;
+	int i;
+
+	res = g_ptr_array_new();
+	*total_len = 0;
+
+	for (i = 0; i < nfnames; i++) {
+		struct bench_part *part;
+		char *content = NULL;
+		gsize len;
+		GError *err = NULL;
+
+		if (!g_file_get_contents(fnames[i], &content, &len, &err)) {
+			fprintf(stderr, "cannot read %s: %s\n", fnames[i], err->message);
+			g_clear_error(&err);
+			continue;
+		}
+
+		if (len == 0) {
+			g_free(content);
+			continue;
+		}
+
+		part = g_malloc0(sizeof(*part));
+		part->data = content;
+		part->len = len;
+		g_ptr_array_add(res, part);
+		*total_len += len;
+	}
+
+	return res;
+}
+
+static double
+bench_pcre(GPtrArray *pats, GPtrArray *parts)
+{
+	double total = 0.0;
+	unsigned int i, j;
+	int pass;
+
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < pats->len; i++) {
+			struct bench_pattern *bp = g_ptr_array_index(pats, i);
+			double t0 = rspamd_get_ticks(FALSE);
+
+			for (j = 0; j < parts->len; j++) {
+				struct bench_part *part = g_ptr_array_index(parts, j);
+
+				if (rspamd_regexp_search(bp->re, part->data, part->len,
+										 NULL, NULL, raw_input, NULL)) {
+					bp->hits++;
+				}
+			}
+
+			bp->pcre_time += rspamd_get_ticks(FALSE) - t0;
+		}
+	}
+
+	for (i = 0; i < pats->len; i++) {
+		struct bench_pattern *bp = g_ptr_array_index(pats, i);
+
+		total += bp->pcre_time;
+	}
+
+	return total;
+}
+
+static int
+bench_mp_cb(struct rspamd_multipattern *mp, unsigned int strnum,
+			int match_start, int match_pos,
+			const char *text, gsize len, void *context)
+{
+	uint64_t *hits = context;
+
+	hits[strnum]++;
+
+	return 0;
+}
+
+static double
+bench_multipattern(GPtrArray *pats, GPtrArray *parts, uint64_t *hits)
+{
+	struct rspamd_multipattern *mp;
+	GError *err = NULL;
+	double t0, elapsed;
+	unsigned int i, j;
+	int pass, flags = RSPAMD_MULTIPATTERN_RE;
+
+	if (!raw_input) {
+		flags |= RSPAMD_MULTIPATTERN_UTF8;
+	}
+
+	mp = rspamd_multipattern_create_sized(pats->len, flags);
+
+	for (i = 0; i < pats->len; i++) {
+		struct bench_pattern *bp = g_ptr_array_index(pats, i);
+
+		rspamd_multipattern_add_pattern(mp,
+										rspamd_regexp_get_pattern(bp->re), flags);
+	}
+
+	if (!rspamd_multipattern_compile(mp, RSPAMD_MULTIPATTERN_COMPILE_NO_FS, &err)) {
+		fprintf(stderr, "cannot compile multipattern: %s\n",
+				err ? err->message : "unknown error");
+		g_clear_error(&err);
+		rspamd_multipattern_destroy(mp);
+
+		return -1.0;
+	}
+
+	t0 = rspamd_get_ticks(FALSE);
+
+	for (pass = 0; pass < passes; pass++) {
+		for (j = 0; j < parts->len; j++) {
+			struct bench_part *part = g_ptr_array_index(parts, j);
+
+			rspamd_multipattern_lookup(mp, part->data, part->len,
+									   bench_mp_cb, hits, NULL);
+		}
+	}
+
+	elapsed = rspamd_get_ticks(FALSE) - t0;
+	rspamd_multipattern_destroy(mp);
+
+	return elapsed;
+}
+
+#ifdef WITH_HYPERSCAN
+/*
+ * Extracts the bare pattern and translates the flags that hyperscan
+ * understands; everything else is ignored as hs has no equivalent
+ */
+static const char *
+bench_hs_pattern(const struct bench_pattern *bp, unsigned int *flags)
+{
+	const char *line = bp->line;
+	unsigned int fl = 0;
+
+	if (*line == '/') {
+		const char *last_sep = strrchr(line + 1, '/');
+
+		if (last_sep != NULL) {
+			const char *c;
+
+			for (c = last_sep + 1; *c != '\0'; c++) {
+				if (*c == 'i') {
+					fl |= HS_FLAG_CASELESS;
+				}
+				else if (*c == 'u') {
+					fl |= HS_FLAG_UTF8;
+				}
+				else if (*c == 's') {
+					fl |= HS_FLAG_DOTALL;
+				}
+				else if (*c == 'm') {
+					fl |= HS_FLAG_MULTILINE;
+				}
+			}
+		}
+	}
+
+	*flags = fl;
+
+	return rspamd_regexp_get_pattern(bp->re);
+}
+
+static int
+bench_hs_cb(unsigned int id, unsigned long long from,
+			unsigned long long to, unsigned int flags, void *ud)
+{
+	uint64_t *hits = ud;
+
+	hits[id]++;
+
+	return 0;
+}
+
+static double
+bench_hyperscan(GPtrArray *pats, GPtrArray *parts, uint64_t *hits,
+				unsigned int *ncompiled)
+{
+	hs_database_t *db = NULL;
+	hs_scratch_t *scratch = NULL;
+	hs_compile_error_t *hs_err = NULL;
+	hs_platform_info_t plt;
+	const char **hs_pats;
+	unsigned int *hs_flags, *hs_ids, n = 0;
+	double t0, elapsed;
+	unsigned int i, j;
+	int pass;
+
+	if (hs_valid_platform() != HS_SUCCESS ||
+		hs_populate_platform(&plt) != HS_SUCCESS) {
+		return -1.0;
+	}
+
+	hs_pats = g_malloc(pats->len * sizeof(*hs_pats));
+	hs_flags = g_malloc(pats->len * sizeof(*hs_flags));
+	hs_ids = g_malloc(pats->len * sizeof(*hs_ids));
+
+	for (i = 0; i < pats->len; i++) {
+		struct bench_pattern *bp = g_ptr_array_index(pats, i);
+		unsigned int fl;
+		const char *pat = bench_hs_pattern(bp, &fl);
+		hs_database_t *test_db = NULL;
+
+		/* Check each expression separately, falling back to prefilter mode */
+		if (hs_compile(pat, fl, HS_MODE_BLOCK, &plt, &test_db,
+					   &hs_err) != HS_SUCCESS) {
+			hs_free_compile_error(hs_err);
+			fl |= HS_FLAG_PREFILTER;
+
+			if (hs_compile(pat, fl, HS_MODE_BLOCK, &plt, &test_db,
+						   &hs_err) != HS_SUCCESS) {
+				fprintf(stderr, "hyperscan cannot compile '%s': %s\n",
+						bp->line, hs_err->message);
+				hs_free_compile_error(hs_err);
+				continue;
+			}
+		}
+
+		hs_free_database(test_db);
+		hs_pats[n] = pat;
+		hs_flags[n] = fl;
+		hs_ids[n] = i;
+		n++;
+	}
+
+	*ncompiled = n;
+
+	if (n == 0 ||
+		hs_compile_multi(hs_pats, hs_flags, hs_ids, n, HS_MODE_BLOCK,
+						 &plt, &db, &hs_err) != HS_SUCCESS) {
+		if (n > 0) {
+			fprintf(stderr, "hyperscan cannot compile the full set: %s\n",
+					hs_err->message);
+			hs_free_compile_error(hs_err);
+		}
+
+		g_free(hs_pats);
+		g_free(hs_flags);
+		g_free(hs_ids);
+
+		return -1.0;
+	}
+
+	g_free(hs_pats);
+	g_free(hs_flags);
+	g_free(hs_ids);
+
+	if (hs_alloc_scratch(db, &scratch) != HS_SUCCESS) {
+		hs_free_database(db);
+
+		return -1.0;
+	}
+
+	t0 = rspamd_get_ticks(FALSE);
+
+	for (pass = 0; pass < passes; pass++) {
+		for (j = 0; j < parts->len; j++) {
+			struct bench_part *part = g_ptr_array_index(parts, j);
+
+			hs_scan(db, part->data, part->len, 0, scratch, bench_hs_cb, hits);
+		}
+	}
+
+	elapsed = rspamd_get_ticks(FALSE) - t0;
+
+	hs_free_scratch(scratch);
+	hs_free_database(db);
+
+	return elapsed;
+}
+#endif
+
+static int
+bench_time_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct bench_pattern *pa = *(const struct bench_pattern **) a,
+							   *pb = *(const struct bench_pattern **) b;
+
+	if (pa->pcre_time > pb->pcre_time) {
+		return -1;
+	}
+	else if (pa->pcre_time < pb->pcre_time) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+bench_double_cmp(gconstpointer a, gconstpointer b)
+{
+	const double da = *(const double *) a, db = *(const double *) b;
+
+	return (da > db) - (da < db);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	GPtrArray *pats, *parts;
+	GArray *times;
+	uint64_t *hits;
+	gsize corpus_len;
+	double pcre_total, mp_total, scanned_mb;
+	unsigned int i;
+
+	context = g_option_context_new("corpus_file [corpus_file...] - benchmark regexp engines");
+	g_option_context_add_main_entries(context, entries, NULL);
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "option parsing failed: %s\n", error->message);
+		exit(EXIT_FAILURE);
+	}
+
+	if (patterns_file == NULL || argc < 2 || passes <= 0) {
+		fprintf(stderr, "usage: rspamd-regexp-bench -p patterns_file corpus_file [corpus_file...]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	rspamd_main = g_malloc0(sizeof(*rspamd_main));
+	rspamd_main->server_pool = rspamd_mempool_new(rspamd_mempool_suggest_size(),
+												  NULL, 0);
+	rspamd_main->logger = rspamd_log_open_emergency(rspamd_main->server_pool,
+													RSPAMD_LOG_FLAG_RSPAMADM);
+	rspamd_log_set_log_level(rspamd_main->logger, G_LOG_LEVEL_MESSAGE);
+	g_log_set_default_handler(rspamd_glib_log_function, rspamd_main->logger);
+	rspamd_multipattern_library_init(NULL);
+
+	pats = bench_load_patterns(patterns_file);
+	parts = bench_load_corpus(argv + 1, argc - 1, &corpus_len);
+
+	if (pats->len == 0 || parts->len == 0) {
+		fprintf(stderr, "nothing to do: %d patterns, %d corpus parts\n",
+				pats->len, parts->len);
+		exit(EXIT_FAILURE);
+	}
+
+	scanned_mb = (double) corpus_len * passes / (1024.0 * 1024.0);
+	printf("corpus: %d parts, %.2f MiB; %d expressions; %d passes\n",
+		   parts->len, (double) corpus_len / (1024.0 * 1024.0),
+		   pats->len, passes);
+
+	/* PCRE: each expression scans the whole corpus on its own */
+	pcre_total = bench_pcre(pats, parts);
+	printf("pcre: %.3f s total, %.2f MiB/s per expression stream\n",
+		   pcre_total, scanned_mb * pats->len / pcre_total);
+
+	/* Multipattern: all expressions in a single batched scan */
+	hits = g_malloc0(pats->len * sizeof(*hits));
+	mp_total = bench_multipattern(pats, parts, hits);
+
+	if (mp_total > 0) {
+		printf("multipattern (%s): %.3f s total, %.2f MiB/s\n",
+			   rspamd_multipattern_has_hyperscan() ? "hyperscan" : "acism/pcre",
+			   mp_total, scanned_mb / mp_total);
+	}
+
+	g_free(hits);
+
+#ifdef WITH_HYPERSCAN
+	{
+		unsigned int ncompiled = 0;
+		double hs_total;
+
+		hits = g_malloc0(pats->len * sizeof(*hits));
+		hs_total = bench_hyperscan(pats, parts, hits, &ncompiled);
+
+		if (hs_total > 0) {
+			printf("hyperscan: %u/%d expressions compiled, %.3f s total, %.2f MiB/s\n",
+				   ncompiled, pats->len, hs_total, scanned_mb / hs_total);
+		}
+
+		g_free(hits);
+	}
+#endif
+
+	/* Per-pattern pcre cost distribution */
+	times = g_array_sized_new(FALSE, FALSE, sizeof(double), pats->len);
+
+	for (i = 0; i < pats->len; i++) {
+		struct bench_pattern *bp = g_ptr_array_index(pats, i);
+
+		g_array_append_val(times, bp->pcre_time);
+	}
+
+	g_array_sort(times, bench_double_cmp);
+	printf("pcre per expression cost over the whole run: "
+		   "min %.3f ms, median %.3f ms, mean %.3f ms, max %.3f ms\n",
+		   g_array_index(times, double, 0) * 1000.0,
+		   g_array_index(times, double, times->len / 2) * 1000.0,
+		   pcre_total / pats->len * 1000.0,
+		   g_array_index(times, double, times->len - 1) * 1000.0);
+	g_array_free(times, TRUE);
+
+	g_ptr_array_sort(pats, bench_time_cmp);
+	printf("slowest expressions:\n");
+
+	for (i = 0; i < pats->len && i < (unsigned int) top_patterns; i++) {
+		struct bench_pattern *bp = g_ptr_array_index(pats, i);
+
+		printf("%3d. %8.3f ms %6.1f%% %8" G_GUINT64_FORMAT " hits  %s\n",
+			   i + 1, bp->pcre_time * 1000.0,
+			   bp->pcre_time / pcre_total * 100.0,
+			   bp->hits, bp->line);
+	}
+
+	return 0;
+}
@@ -28,6 +28,9 @@ extern struct rspamadm_command statconvert_command;
 extern struct rspamadm_command fuzzyconvert_command;
 extern struct rspamadm_command signtool_command;
 extern struct rspamadm_command lua_command;
+extern struct rspamadm_command tldcompile_command;
+extern struct rspamadm_command logcat_command;
+extern struct rspamadm_command ztrain_command;
 
 const struct rspamadm_command *commands[] = {
 	&help_command,
@@ -40,6 +43,9 @@ const struct rspamadm_command *commands[] = {
 	&fuzzyconvert_command,
 	&signtool_command,
 	&lua_command,
+	&tldcompile_command,
+	&logcat_command,
+	&ztrain_command,
 	NULL};
 
 
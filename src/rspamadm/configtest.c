@@ -24,6 +24,7 @@ static gboolean quiet = FALSE;
 static char *config = NULL;
 static gboolean strict = FALSE;
 static gboolean skip_template = FALSE;
+static gboolean profile = FALSE;
 extern struct rspamd_main *rspamd_main;
 /* Defined in modules.c */
 extern module_t *modules[];
@@ -51,6 +52,8 @@ static GOptionEntry entries[] = {
 	 "Stop on any error in config", NULL},
 	{"skip-template", 'T', 0, G_OPTION_ARG_NONE, &skip_template,
 	 "Do not apply Jinja templates", NULL},
+	{"profile", 'p', 0, G_OPTION_ARG_NONE, &profile,
+	 "Print timings of the startup phases as JSON", NULL},
 	{NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
 
 static const char *
@@ -64,6 +67,7 @@ rspamadm_configtest_help(gboolean full_help, const struct rspamadm_command *cmd)
 				   "Where options are:\n\n"
 				   "-q: quiet output\n"
 				   "-c: config file to test\n"
+				   "-p: print timings of the startup phases as JSON\n"
 				   "--help: shows available options and commands";
 	}
 	else {
@@ -88,6 +92,7 @@ rspamadm_configtest(int argc, char **argv, const struct rspamadm_command *cmd)
 	gboolean ret = TRUE;
 	worker_t **pworker;
 	const uint64_t *log_cnt;
+	double ticks = 0.0;
 
 	context = g_option_context_new(
 		"configtest - perform configuration file test");
@@ -129,28 +134,50 @@ rspamadm_configtest(int argc, char **argv, const struct rspamadm_command *cmd)
 	cfg->compiled_workers = workers;
 	cfg->cfg_name = config;
 
+	if (profile) {
+		rspamd_config_profile_enable();
+	}
+
+	ticks = rspamd_get_ticks(FALSE);
+
 	if (!rspamd_config_read(cfg, cfg->cfg_name, config_logger, rspamd_main,
 							ucl_vars, skip_template, lua_env)) {
 		ret = FALSE;
 	}
 	else {
+		rspamd_config_profile_add("config_read", rspamd_get_ticks(FALSE) - ticks);
+
 		/* Do post-load actions */
+		ticks = rspamd_get_ticks(FALSE);
 		rspamd_lua_post_load_config(cfg);
+		rspamd_config_profile_add("lua_post_load", rspamd_get_ticks(FALSE) - ticks);
+
+		ticks = rspamd_get_ticks(FALSE);
 
 		if (!rspamd_init_filters(rspamd_main->cfg, false, strict)) {
 			ret = FALSE;
 		}
 
+		rspamd_config_profile_add("modules_init", rspamd_get_ticks(FALSE) - ticks);
+
 		if (ret) {
+			ticks = rspamd_get_ticks(FALSE);
 			ret = rspamd_config_post_load(cfg, RSPAMD_CONFIG_INIT_SYMCACHE);
+			rspamd_config_profile_add("post_load",
+									  rspamd_get_ticks(FALSE) - ticks);
 		}
 
+		ticks = rspamd_get_ticks(FALSE);
+
 		if (ret && !rspamd_symcache_validate(cfg->cache,
 											 cfg,
 											 FALSE)) {
 			ret = FALSE;
 		}
 
+		rspamd_config_profile_add("symcache_validate",
+								  rspamd_get_ticks(FALSE) - ticks);
+
 		if (ret) {
 			if (rspamd_lua_require_function(cfg->lua_state, "lua_cfg_utils", "check_configuration_errors")) {
 				GError *err = NULL;
@@ -184,6 +211,18 @@ rspamadm_configtest(int argc, char **argv, const struct rspamadm_command *cmd)
 		rspamd_printf("syntax %s\n", ret ? "OK" : "BAD");
 	}
 
+	if (profile) {
+		ucl_object_t *prof = rspamd_config_profile_export();
+		unsigned char *out = ucl_object_emit(prof, UCL_EMIT_JSON);
+
+		if (out != NULL) {
+			rspamd_printf("%s\n", (char *) out);
+			free(out);
+		}
+
+		ucl_object_unref(prof);
+	}
+
 	if (!ret) {
 		exit(EXIT_FAILURE);
 	}
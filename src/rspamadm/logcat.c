@@ -0,0 +1,181 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "util.h"
+#include "rspamd.h"
+#include "rspamadm.h"
+#include "unix-std.h"
+#include "libserver/logger/logger_private.h"
+
+static void rspamadm_logcat(int argc, char **argv,
+							const struct rspamadm_command *cmd);
+static const char *rspamadm_logcat_help(gboolean full_help,
+										const struct rspamadm_command *cmd);
+
+/* Sanity limit for a single log record */
+#define LOGCAT_MAX_REC (16 * 1024 * 1024)
+
+struct rspamadm_command logcat_command = {
+	.name = "logcat",
+	.flags = 0,
+	.help = rspamadm_logcat_help,
+	.run = rspamadm_logcat,
+	.lua_subrs = NULL,
+};
+
+static GOptionEntry entries[] = {
+	{NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+static const char *
+rspamadm_logcat_help(gboolean full_help, const struct rspamadm_command *cmd)
+{
+	const char *help_str;
+
+	if (full_help) {
+		help_str = "Format rspamd binary logs\n\n"
+				   "Usage: rspamadm logcat [file ...]\n"
+				   "Reads log files written with the 'log_binary' logging "
+				   "option (or stdin when no files are given)\n"
+				   "and prints them in the standard text format";
+	}
+	else {
+		help_str = "Format rspamd binary logs";
+	}
+
+	return help_str;
+}
+
+static gboolean
+rspamadm_logcat_file(FILE *in, const char *fname)
+{
+	struct rspamd_logger_bin_rec hdr;
+	char timebuf[64];
+	char *payload = NULL;
+	gsize payload_alloc = 0;
+
+	while (fread(&hdr, sizeof(hdr), 1, in) == 1) {
+		gsize plen;
+		const char *ptype, *id, *module, *function, *message;
+		struct tm tms;
+
+		if (hdr.magic != RSPAMD_LOGGER_BIN_MAGIC ||
+			hdr.len < sizeof(hdr) || hdr.len > LOGCAT_MAX_REC ||
+			hdr.len != sizeof(hdr) + hdr.ptype_len + hdr.id_len +
+						   hdr.module_len + hdr.function_len + hdr.mlen) {
+			rspamd_fprintf(stderr, "%s: invalid record, truncated or not "
+								   "a binary log\n",
+						   fname);
+			g_free(payload);
+
+			return FALSE;
+		}
+
+		plen = hdr.len - sizeof(hdr);
+
+		if (plen > payload_alloc) {
+			payload = g_realloc(payload, plen);
+			payload_alloc = plen;
+		}
+
+		if (plen > 0 && fread(payload, plen, 1, in) != 1) {
+			rspamd_fprintf(stderr, "%s: truncated record\n", fname);
+			g_free(payload);
+
+			return FALSE;
+		}
+
+		ptype = payload;
+		id = ptype + hdr.ptype_len;
+		module = id + hdr.id_len;
+		function = module + hdr.module_len;
+		message = function + hdr.function_len;
+
+		rspamd_localtime((time_t) hdr.ts, &tms);
+		strftime(timebuf, sizeof(timebuf), "%F %H:%M:%S", &tms);
+
+		rspamd_printf("%s [%s] #%d(%*s) ",
+					  timebuf,
+					  rspamd_get_log_severity_string(hdr.level_flags),
+					  hdr.pid,
+					  (int) hdr.ptype_len, ptype);
+
+		if (hdr.id_len > 0) {
+			rspamd_printf("<%*s>; ", (int) hdr.id_len, id);
+		}
+		if (hdr.module_len > 0) {
+			rspamd_printf("%*s; ", (int) hdr.module_len, module);
+		}
+		if (hdr.function_len > 0) {
+			rspamd_printf("%*s: ", (int) hdr.function_len, function);
+		}
+
+		rspamd_printf("%*s\n", (int) hdr.mlen, message);
+	}
+
+	g_free(payload);
+
+	return TRUE;
+}
+
+static void
+rspamadm_logcat(int argc, char **argv, const struct rspamadm_command *cmd)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	int i, ret = 0;
+
+	context = g_option_context_new("logcat - format rspamd binary logs");
+	g_option_context_set_summary(context,
+								 "Summary:\n  Rspamd administration utility version " RVERSION
+								 "\n  Release id: " RID);
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_set_ignore_unknown_options(context, TRUE);
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		rspamd_fprintf(stderr, "option parsing failed: %s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+
+	if (argc == 1) {
+		if (!rspamadm_logcat_file(stdin, "stdin")) {
+			ret = EXIT_FAILURE;
+		}
+	}
+	else {
+		for (i = 1; i < argc; i++) {
+			FILE *in = fopen(argv[i], "r");
+
+			if (in == NULL) {
+				rspamd_fprintf(stderr, "cannot open %s: %s\n", argv[i],
+							   strerror(errno));
+				ret = EXIT_FAILURE;
+				continue;
+			}
+
+			if (!rspamadm_logcat_file(in, argv[i])) {
+				ret = EXIT_FAILURE;
+			}
+
+			fclose(in);
+		}
+	}
+
+	exit(ret);
+}
@@ -0,0 +1,130 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "rspamadm.h"
+#include "libserver/url_tld_dfa.h"
+#include "unix-std.h"
+
+static char *input = NULL;
+static char *output = NULL;
+static gboolean quiet = FALSE;
+
+static void rspamadm_tldcompile(int argc, char **argv,
+								const struct rspamadm_command *cmd);
+static const char *rspamadm_tldcompile_help(gboolean full_help,
+											const struct rspamadm_command *cmd);
+
+struct rspamadm_command tldcompile_command = {
+	.name = "tldcompile",
+	.flags = 0,
+	.help = rspamadm_tldcompile_help,
+	.run = rspamadm_tldcompile,
+	.lua_subrs = NULL,
+};
+
+static GOptionEntry entries[] = {
+	{"input", 'i', 0, G_OPTION_ARG_FILENAME, &input,
+	 "Input TLD file in the publicsuffix format", NULL},
+	{"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+	 "Output file (input file name with '.dfa' suffix by default)", NULL},
+	{"quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet,
+	 "Suppress output", NULL},
+	{NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+static const char *
+rspamadm_tldcompile_help(gboolean full_help, const struct rspamadm_command *cmd)
+{
+	const char *help_str;
+
+	if (full_help) {
+		help_str = "Compile a TLD file into a binary DFA\n\n"
+				   "Usage: rspamadm tldcompile -i <tld_file> [-o <output>]\n"
+				   "Where options are:\n\n"
+				   "-i: input TLD file in the publicsuffix format\n"
+				   "-o: output file, <input>.dfa if not specified\n"
+				   "-q: suppress output\n"
+				   "--help: shows available options and commands\n\n"
+				   "Workers map the compiled file read-only when it exists "
+				   "next to the TLD file and is not older than it";
+	}
+	else {
+		help_str = "Compile a TLD file into a binary DFA";
+	}
+
+	return help_str;
+}
+
+static void
+rspamadm_tldcompile(int argc, char **argv, const struct rspamadm_command *cmd)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	struct rspamd_tld_dfa *dfa;
+	char *out_file;
+
+	context = g_option_context_new("tldcompile - compile TLD file into a binary DFA");
+	g_option_context_set_summary(context,
+								 "Summary:\n  Rspamd administration utility version " RVERSION
+								 "\n  Release id: " RID);
+	g_option_context_add_main_entries(context, entries, NULL);
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		rspamd_fprintf(stderr, "option parsing failed: %s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+
+	if (input == NULL) {
+		rspamd_fprintf(stderr, "no input file specified\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (output == NULL) {
+		output = g_strdup_printf("%s.dfa", input);
+	}
+
+	if (!rspamd_tld_dfa_compile(input, output, &error)) {
+		rspamd_fprintf(stderr, "cannot compile %s: %s\n", input,
+					   error->message);
+		g_error_free(error);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Sanity load of what has just been written */
+	dfa = rspamd_tld_dfa_load(output, &error);
+
+	if (dfa == NULL) {
+		rspamd_fprintf(stderr, "compiled DFA %s is broken: %s\n", output,
+					   error->message);
+		g_error_free(error);
+		unlink(output);
+		exit(EXIT_FAILURE);
+	}
+
+	rspamd_tld_dfa_unload(dfa);
+
+	if (!quiet) {
+		struct stat st;
+
+		if (stat(output, &st) != -1) {
+			rspamd_printf("compiled %s from %s (%L bytes)\n", output, input,
+						  (int64_t) st.st_size);
+		}
+	}
+}
@@ -0,0 +1,284 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "libutil/util.h"
+#include "cryptobox.h"
+#include "khash.h"
+#include "rspamadm.h"
+#include "unix-std.h"
+
+#ifdef SYS_ZSTD
+#include "zstd.h"
+#else
+#include "contrib/zstd/zstd.h"
+#endif
+
+static void rspamadm_ztrain(int argc, char **argv,
+							const struct rspamadm_command *cmd);
+static const char *rspamadm_ztrain_help(gboolean full_help,
+										const struct rspamadm_command *cmd);
+
+static char *output = "zstd.dict";
+static gint64 max_size = 112640; /* Matches the default of the zstd trainer */
+static gint64 min_count = 2;
+static gboolean quiet = FALSE;
+
+struct rspamadm_command ztrain_command = {
+	.name = "ztrain",
+	.flags = 0,
+	.help = rspamadm_ztrain_help,
+	.run = rspamadm_ztrain,
+	.lua_subrs = NULL,
+};
+
+static GOptionEntry entries[] = {
+	{"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+	 "Output dictionary file (zstd.dict by default)", NULL},
+	{"max-size", 'S', 0, G_OPTION_ARG_INT64, &max_size,
+	 "Maximum dictionary size in bytes (110 KiB by default)", NULL},
+	{"min-count", 'm', 0, G_OPTION_ARG_INT64, &min_count,
+	 "Minimum occurrences of a fragment to consider it (2 by default)", NULL},
+	{"quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet,
+	 "Suppress output", NULL},
+	{NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+static const char *
+rspamadm_ztrain_help(gboolean full_help, const struct rspamadm_command *cmd)
+{
+	const char *help_str;
+
+	if (full_help) {
+		help_str = "Train a zstd dictionary from sample payloads\n\n"
+				   "Usage: rspamadm ztrain [-o <dict>] [-S <size>] <sample> [<sample>...]\n"
+				   "Where options are:\n\n"
+				   "-o: output dictionary file (zstd.dict by default)\n"
+				   "-S: maximum dictionary size in bytes (110 KiB by default)\n"
+				   "-m: minimum occurrences of a fragment to consider it\n"
+				   "-q: suppress output\n"
+				   "--help: shows available options and commands\n\n"
+				   "Samples are captured protocol replies or mail headers, one\n"
+				   "payload per file. The result is a raw content dictionary: point\n"
+				   "zstd_input_dictionary/zstd_output_dictionary in the options\n"
+				   "section and rspamc --dictionary at the same file";
+	}
+	else {
+		help_str = "Train a zstd dictionary from sample payloads";
+	}
+
+	return help_str;
+}
+
+/*
+ * Without the full zstd trainer sources we build a raw content dictionary:
+ * fragments that repeat across samples are emitted as plain content, least
+ * valuable first, as zstd treats the tail of a raw dictionary as the most
+ * important part. For line oriented payloads (protocol replies, headers)
+ * this captures the shared boilerplate that makes small messages compress
+ * poorly without a dictionary
+ */
+#define ZTRAIN_MIN_FRAGMENT 8
+#define ZTRAIN_MAX_FRAGMENT 2048
+
+#define ztrain_ftok_hash(t) ((khint_t) rspamd_cryptobox_fast_hash((t).begin, (t).len, 0))
+#define ztrain_ftok_equal(a, b) ((a).len == (b).len && \
+								 memcmp((a).begin, (b).begin, (a).len) == 0)
+KHASH_INIT(ztrain_frags, rspamd_ftok_t, unsigned int, true,
+		   ztrain_ftok_hash, ztrain_ftok_equal);
+
+struct ztrain_candidate {
+	rspamd_ftok_t frag;
+	gsize score;
+};
+
+static void
+rspamadm_ztrain_sample(khash_t(ztrain_frags) * frags, const char *data,
+					   gsize len)
+{
+	const char *p = data, *end = data + len, *line;
+	rspamd_ftok_t tok;
+	khiter_t k;
+	int r;
+
+	while (p < end) {
+		line = p;
+
+		while (p < end && *p != '\n') {
+			p++;
+		}
+
+		if (p < end) {
+			/* Include the line terminator, it is a part of the boilerplate */
+			p++;
+		}
+
+		tok.begin = line;
+		tok.len = p - line;
+
+		if (tok.len < ZTRAIN_MIN_FRAGMENT || tok.len > ZTRAIN_MAX_FRAGMENT) {
+			continue;
+		}
+
+		k = kh_put(ztrain_frags, frags, tok, &r);
+
+		if (r == 0) {
+			kh_value(frags, k)++;
+		}
+		else {
+			kh_value(frags, k) = 1;
+		}
+	}
+}
+
+static int
+rspamadm_ztrain_cand_cmp(const void *p1, const void *p2)
+{
+	const struct ztrain_candidate *c1 = p1, *c2 = p2;
+
+	if (c1->score != c2->score) {
+		return c1->score > c2->score ? -1 : 1;
+	}
+
+	/* Stable output for equal scores */
+	if (c1->frag.len != c2->frag.len) {
+		return c1->frag.len > c2->frag.len ? -1 : 1;
+	}
+
+	return memcmp(c1->frag.begin, c2->frag.begin, c1->frag.len);
+}
+
+static void
+rspamadm_ztrain(int argc, char **argv, const struct rspamadm_command *cmd)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	khash_t(ztrain_frags) *frags;
+	GPtrArray *maps;
+	GArray *candidates;
+	struct ztrain_candidate cand;
+	rspamd_ftok_t tok;
+	unsigned int cnt, nselected = 0, i;
+	gsize total_samples = 0, dict_len = 0, map_len;
+	gpointer map;
+	FILE *out;
+
+	context = g_option_context_new(
+		"ztrain - train a zstd dictionary from sample payloads");
+	g_option_context_set_summary(context,
+								 "Summary:\n  Rspamd administration utility version " RVERSION
+								 "\n  Release id: " RID);
+	g_option_context_add_main_entries(context, entries, NULL);
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "option parsing failed: %s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+
+	if (argc < 2) {
+		fprintf(stderr, "no sample files specified\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (max_size <= ZTRAIN_MIN_FRAGMENT) {
+		fprintf(stderr, "invalid maximum dictionary size\n");
+		exit(EXIT_FAILURE);
+	}
+
+	frags = kh_init(ztrain_frags);
+	maps = g_ptr_array_new();
+
+	/* Fragments reference the mapped samples, so keep the maps till the end */
+	for (i = 1; i < (unsigned int) argc; i++) {
+		map = rspamd_file_xmap(argv[i], PROT_READ, &map_len, TRUE);
+
+		if (map == NULL) {
+			fprintf(stderr, "cannot open %s: %s\n", argv[i], strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		rspamadm_ztrain_sample(frags, map, map_len);
+		g_ptr_array_add(maps, map);
+		total_samples += map_len;
+	}
+
+	candidates = g_array_new(FALSE, FALSE, sizeof(struct ztrain_candidate));
+
+	kh_foreach(frags, tok, cnt, {
+		if (cnt >= (unsigned int) min_count) {
+			cand.frag = tok;
+			/* Bytes saved if all repetitions become back references */
+			cand.score = (gsize)(cnt - 1) * tok.len;
+			g_array_append_val(candidates, cand);
+		}
+	});
+
+	if (candidates->len == 0) {
+		rspamd_fprintf(stderr, "no repeated fragments found in %z bytes of samples\n",
+					   total_samples);
+		exit(EXIT_FAILURE);
+	}
+
+	g_array_sort(candidates, rspamadm_ztrain_cand_cmp);
+
+	for (i = 0; i < candidates->len; i++) {
+		cand = g_array_index(candidates, struct ztrain_candidate, i);
+
+		if (dict_len + cand.frag.len > (gsize) max_size) {
+			break;
+		}
+
+		dict_len += cand.frag.len;
+		nselected++;
+	}
+
+	out = fopen(output, "w");
+
+	if (out == NULL) {
+		fprintf(stderr, "cannot open %s: %s\n", output, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	/* Least valuable fragments first, see above */
+	for (i = nselected; i > 0; i--) {
+		cand = g_array_index(candidates, struct ztrain_candidate, i - 1);
+
+		if (fwrite(cand.frag.begin, cand.frag.len, 1, out) != 1) {
+			fprintf(stderr, "cannot write %s: %s\n", output, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fclose(out);
+
+	if (!quiet) {
+		map = rspamd_file_xmap(output, PROT_READ, &map_len, TRUE);
+		g_assert(map != NULL);
+		rspamd_printf("trained dictionary %s: %z bytes, %d fragments "
+					  "(out of %d candidates, %z bytes of samples), id: %ud\n",
+					  output, map_len, nselected, candidates->len,
+					  total_samples,
+					  rspamd_zstd_dictionary_id(map, map_len));
+		munmap(map, map_len);
+	}
+
+	/* The sample mappings are reclaimed on exit */
+	g_array_free(candidates, TRUE);
+	g_ptr_array_free(maps, TRUE);
+	kh_destroy(ztrain_frags, frags);
+}
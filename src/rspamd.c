@@ -318,7 +318,7 @@ reread_config(struct rspamd_main *rspamd_main)
 					RSPAMD_CONFIG_INIT_LIBS | RSPAMD_CONFIG_INIT_URL;
 
 	rspamd_symcache_save(rspamd_main->cfg->cache);
-	tmp_cfg = rspamd_config_new(RSPAMD_CONFIG_INIT_DEFAULT);
+	tmp_cfg = rspamd_config_new(RSPAMD_CONFIG_INIT_NO_DOC_STRINGS);
 	tmp_cfg->libs_ctx = rspamd_main->cfg->libs_ctx;
 	REF_RETAIN(tmp_cfg->libs_ctx);
 	cfg_file = rspamd_mempool_strdup(tmp_cfg->cfg_pool,
@@ -340,6 +340,8 @@ reread_config(struct rspamd_main *rspamd_main)
 	else {
 		rspamd_log_close(old_logger);
 		msg_info_main("replacing config");
+		/* Carry over symbols stats for unchanged symbols to keep ordering warm */
+		rspamd_symcache_inherit_stats(tmp_cfg->cache, old_cfg->cache);
 		REF_RELEASE(old_cfg);
 		rspamd_main->cfg->rspamd_user = rspamd_user;
 		rspamd_main->cfg->rspamd_group = rspamd_group;
@@ -387,6 +389,32 @@ rspamd_fork_delayed(struct rspamd_worker_conf *cf,
 					struct rspamd_main *rspamd_main)
 {
 	struct waiting_worker *nw;
+	double now = rspamd_get_calendar_ticks(), delay;
+
+	/*
+	 * A fork from the main process inherits all loaded state, so a replacement
+	 * worker is warm immediately; respawn at once after an isolated crash and
+	 * back off exponentially merely when workers crash in a loop
+	 */
+	if (now - cf->last_respawn > SOFT_FORK_TIME * 10) {
+		cf->respawn_count = 0;
+	}
+
+	cf->last_respawn = now;
+
+	if (cf->respawn_count == 0) {
+		delay = 0.0;
+	}
+	else {
+		delay = MIN(SOFT_FORK_TIME * (1U << (cf->respawn_count - 1)), 60.0);
+		msg_info_main("respawn of process %s delayed by %.1f seconds: "
+					  "%d respawns in a row",
+					  g_quark_to_string(cf->type),
+					  delay,
+					  cf->respawn_count);
+	}
+
+	cf->respawn_count++;
 
 	nw = g_malloc0(sizeof(*nw));
 	nw->cf = cf;
@@ -394,7 +422,7 @@ rspamd_fork_delayed(struct rspamd_worker_conf *cf,
 	nw->rspamd_main = rspamd_main;
 	REF_RETAIN(cf);
 	nw->wait_ev.data = nw;
-	ev_timer_init(&nw->wait_ev, rspamd_fork_delayed_cb, SOFT_FORK_TIME, 0.0);
+	ev_timer_init(&nw->wait_ev, rspamd_fork_delayed_cb, delay, 0.0);
 	ev_timer_start(rspamd_main->event_loop, &nw->wait_ev);
 }
 
@@ -1198,6 +1226,8 @@ rspamd_cld_handler(EV_P_ ev_child *w, struct rspamd_main *rspamd_main,
 		close(wrk->srv_pipe[0]);
 	}
 
+	rspamd_control_ring_destroy(wrk);
+
 	if (!rspamd_main->wanna_die) {
 		cmd.type = RSPAMD_CONTROL_CHILD_CHANGE;
 		cmd.cmd.child_change.what = rspamd_child_terminated;
@@ -1437,7 +1467,7 @@ int main(int argc, char **argv, char **env)
 		rspamd_main->stat->avg_time.avg_time[i] = NAN;
 	}
 
-	rspamd_main->cfg = rspamd_config_new(RSPAMD_CONFIG_INIT_DEFAULT);
+	rspamd_main->cfg = rspamd_config_new(RSPAMD_CONFIG_INIT_NO_DOC_STRINGS);
 	rspamd_main->spairs = g_hash_table_new_full(rspamd_spair_hash,
 												rspamd_spair_equal, g_free, rspamd_spair_close);
 	rspamd_main->start_mtx = rspamd_mempool_get_mutex(rspamd_main->server_pool);
@@ -1549,9 +1579,10 @@ int main(int argc, char **argv, char **env)
 	msg_info_main("cpu features: %s",
 				  rspamd_main->cfg->libs_ctx->crypto_ctx->cpu_extensions);
 	msg_info_main("cryptobox configuration: curve25519(libsodium), "
-				  "chacha20(%s), poly1305(libsodium), siphash(libsodium), blake2(libsodium), base64(%s)",
+				  "chacha20(%s), poly1305(libsodium), siphash(libsodium), blake2(libsodium), base64(%s), fasthash(%s)",
 				  rspamd_main->cfg->libs_ctx->crypto_ctx->chacha20_impl,
-				  rspamd_main->cfg->libs_ctx->crypto_ctx->base64_impl);
+				  rspamd_main->cfg->libs_ctx->crypto_ctx->base64_impl,
+				  rspamd_main->cfg->libs_ctx->crypto_ctx->fasthash_impl);
 	msg_info_main("libottery prf: %s", ottery_get_impl_name());
 	msg_info_main("simdutf implementation: %s", rspamd_fast_utf8_library_impl_name());
 
@@ -126,6 +126,8 @@ struct rspamd_worker {
 	ev_child cld_ev;                                  /**< to allow reaping								*/
 	rspamd_worker_term_cb term_handler;               /**< custom term handler						*/
 	GHashTable *control_events_pending;               /**< control events pending indexed by ptr		*/
+	gpointer control_ring;                            /**< shared ring for fire-and-forget control commands */
+	int control_doorbell;                             /**< eventfd to signal control ring activity		*/
 };
 
 struct rspamd_abstract_worker_ctx {
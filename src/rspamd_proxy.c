@@ -147,6 +147,8 @@ struct rspamd_proxy_ctx {
 	gboolean discard_on_reject;
 	/* Quarantine messages instead of rejecting them */
 	gboolean quarantine_on_reject;
+	/* Scan envelope + headers on EOH and reject conclusive spam early */
+	gboolean milter_early_scan;
 	/* Milter spam header */
 	char *spam_header;
 	/* CA name that can be used for client certificates */
@@ -838,6 +840,15 @@ init_rspamd_proxy(struct rspamd_config *cfg)
 									  G_STRUCT_OFFSET(struct rspamd_proxy_ctx, milter),
 									  0,
 									  "Accept milter connections, not HTTP");
+	rspamd_rcl_register_worker_option(cfg,
+									  type,
+									  "milter_early_scan",
+									  rspamd_rcl_parse_struct_boolean,
+									  ctx,
+									  G_STRUCT_OFFSET(struct rspamd_proxy_ctx, milter_early_scan),
+									  0,
+									  "Scan envelope and headers on end-of-headers and reject "
+									  "conclusive spam before the body is transferred");
 	rspamd_rcl_register_worker_option(cfg,
 									  type,
 									  "discard_on_reject",
@@ -1126,11 +1137,18 @@ proxy_session_dtor(struct rspamd_proxy_session *session)
 	g_free(session);
 }
 
+/*
+ * Per-process zstd contexts reused across messages; the proxy is single
+ * threaded, so it is safe to keep them in statics and it avoids
+ * allocation of the context internals for each message
+ */
+static ZSTD_CCtx *proxy_zstd_cctx = NULL;
+static ZSTD_DStream *proxy_zstd_dstream = NULL;
+
 static void
 proxy_request_compress(struct rspamd_http_message *msg)
 {
 	unsigned int flags;
-	ZSTD_CCtx *zctx;
 	rspamd_fstring_t *body;
 	const char *in;
 	gsize inlen;
@@ -1150,20 +1168,22 @@ proxy_request_compress(struct rspamd_http_message *msg)
 			return;
 		}
 
+		if (proxy_zstd_cctx == NULL) {
+			proxy_zstd_cctx = ZSTD_createCCtx();
+		}
+
 		body = rspamd_fstring_sized_new(ZSTD_compressBound(inlen));
-		zctx = ZSTD_createCCtx();
-		body->len = ZSTD_compressCCtx(zctx, body->str, body->allocated,
+		/* ZSTD_compressCCtx resets the context on each call */
+		body->len = ZSTD_compressCCtx(proxy_zstd_cctx, body->str, body->allocated,
 									  in, inlen, 1);
 
 		if (ZSTD_isError(body->len)) {
 			msg_err("compression error");
 			rspamd_fstring_free(body);
-			ZSTD_freeCCtx(zctx);
 
 			return;
 		}
 
-		ZSTD_freeCCtx(zctx);
 		rspamd_http_message_set_body_from_fstring_steal(msg, body);
 		rspamd_http_message_add_header(msg, COMPRESSION_HEADER, "zstd");
 	}
@@ -1175,7 +1195,6 @@ proxy_request_decompress(struct rspamd_http_message *msg)
 	rspamd_fstring_t *body;
 	const char *in;
 	gsize inlen, outlen, r;
-	ZSTD_DStream *zstream;
 	ZSTD_inBuffer zin;
 	ZSTD_outBuffer zout;
 
@@ -1186,8 +1205,11 @@ proxy_request_decompress(struct rspamd_http_message *msg)
 			return;
 		}
 
-		zstream = ZSTD_createDStream();
-		ZSTD_initDStream(zstream);
+		if (proxy_zstd_dstream == NULL) {
+			proxy_zstd_dstream = ZSTD_createDStream();
+		}
+
+		ZSTD_initDStream(proxy_zstd_dstream);
 
 		zin.pos = 0;
 		zin.src = in;
@@ -1203,11 +1225,10 @@ proxy_request_decompress(struct rspamd_http_message *msg)
 		zout.size = outlen;
 
 		while (zin.pos < zin.size) {
-			r = ZSTD_decompressStream(zstream, &zout, &zin);
+			r = ZSTD_decompressStream(proxy_zstd_dstream, &zout, &zin);
 
 			if (ZSTD_isError(r)) {
 				msg_err("Decompression error: %s", ZSTD_getErrorName(r));
-				ZSTD_freeDStream(zstream);
 				rspamd_fstring_free(body);
 
 				return;
@@ -1223,12 +1244,126 @@ proxy_request_decompress(struct rspamd_http_message *msg)
 		}
 
 		body->len = zout.pos;
-		ZSTD_freeDStream(zstream);
 		rspamd_http_message_set_body_from_fstring_steal(msg, body);
 		rspamd_http_message_remove_header(msg, COMPRESSION_HEADER);
 	}
 }
 
+/*
+ * Resolves an early scan performed on EOH: reject and soft reject verdicts
+ * are conclusive and are replied at once, saving the body transfer; any
+ * other verdict tells the MTA to continue, so the message is buffered and
+ * fully scanned at the end as usual. Returns TRUE when the early phase has
+ * been handled and the results must not be applied; the protocol does not
+ * allow header modifications before the end of message, so conclusive
+ * verdicts send merely the SMTP reply
+ */
+static gboolean
+rspamd_proxy_milter_early_continue(struct rspamd_proxy_session *session,
+								   const ucl_object_t *results)
+{
+	struct rspamd_milter_session *rms = session->client_milter_conn;
+	const ucl_object_t *elt, *smtp_res = NULL;
+	struct rspamd_action *action = NULL;
+	rspamd_fstring_t *rcode, *xcode, *reply = NULL;
+
+	if (rms == NULL || !rms->early_scan_phase) {
+		return FALSE;
+	}
+
+	rms->early_scan_phase = FALSE;
+
+	if (results != NULL &&
+		(elt = ucl_object_lookup(results, "action")) != NULL) {
+		action = rspamd_config_get_action(session->ctx->cfg,
+										  ucl_object_tostring(elt));
+	}
+
+	if (action == NULL ||
+		(action->action_type != METRIC_ACTION_REJECT &&
+		 action->action_type != METRIC_ACTION_SOFT_REJECT) ||
+		(action->action_type == METRIC_ACTION_REJECT &&
+		 session->ctx->quarantine_on_reject)) {
+		/* Quarantine can be applied at the end of message merely */
+		msg_debug_session("early scan is not conclusive; "
+						  "wait for the message body");
+		rspamd_milter_send_action(rms, RSPAMD_MILTER_CONTINUE);
+
+		return TRUE;
+	}
+
+	msg_info_session("early scan verdict %s is conclusive; "
+					 "reply before the body transfer",
+					 action->name);
+
+	elt = ucl_object_lookup(results, "messages");
+
+	if (elt) {
+		smtp_res = ucl_object_lookup(elt, "smtp_message");
+	}
+
+	if (smtp_res) {
+		gsize len = 0;
+		const char *m = ucl_object_tolstring(smtp_res, &len);
+
+		reply = rspamd_fstring_new_init(m, len);
+	}
+
+	if (action->action_type == METRIC_ACTION_REJECT) {
+		if (session->ctx->discard_on_reject) {
+			rspamd_milter_send_action(rms, RSPAMD_MILTER_DISCARD);
+
+			if (reply) {
+				rspamd_fstring_free(reply);
+			}
+
+			return TRUE;
+		}
+
+		rcode = rspamd_fstring_new_init(RSPAMD_MILTER_RCODE_REJECT,
+										sizeof(RSPAMD_MILTER_RCODE_REJECT) - 1);
+		xcode = rspamd_fstring_new_init(RSPAMD_MILTER_XCODE_REJECT,
+										sizeof(RSPAMD_MILTER_XCODE_REJECT) - 1);
+
+		if (!reply) {
+			if (session->ctx->reject_message == NULL) {
+				reply = rspamd_fstring_new_init(
+					RSPAMD_MILTER_REJECT_MESSAGE,
+					sizeof(RSPAMD_MILTER_REJECT_MESSAGE) - 1);
+			}
+			else {
+				reply = rspamd_fstring_new_init(session->ctx->reject_message,
+												strlen(session->ctx->reject_message));
+			}
+		}
+	}
+	else {
+		rcode = rspamd_fstring_new_init(RSPAMD_MILTER_RCODE_TEMPFAIL,
+										sizeof(RSPAMD_MILTER_RCODE_TEMPFAIL) - 1);
+		xcode = rspamd_fstring_new_init(RSPAMD_MILTER_XCODE_TEMPFAIL,
+										sizeof(RSPAMD_MILTER_XCODE_TEMPFAIL) - 1);
+
+		if (!reply) {
+			if (session->ctx->tempfail_message == NULL) {
+				reply = rspamd_fstring_new_init(
+					RSPAMD_MILTER_TEMPFAIL_MESSAGE,
+					sizeof(RSPAMD_MILTER_TEMPFAIL_MESSAGE) - 1);
+			}
+			else {
+				reply = rspamd_fstring_new_init(session->ctx->tempfail_message,
+												strlen(session->ctx->tempfail_message));
+			}
+		}
+	}
+
+	rspamd_milter_set_reply(rms, rcode, xcode, reply);
+	rspamd_fstring_free(rcode);
+	rspamd_fstring_free(xcode);
+	rspamd_fstring_free(reply);
+
+	return TRUE;
+}
+
 static struct rspamd_proxy_session *
 proxy_session_refresh(struct rspamd_proxy_session *session)
 {
@@ -1501,6 +1636,12 @@ proxy_open_mirror_connections(struct rspamd_proxy_session *session)
 			if (session->fname) {
 				rspamd_http_message_add_header(msg, "File", session->fname);
 			}
+			else if (rspamd_http_message_get_body(msg, NULL) != NULL &&
+					 !rspamd_http_message_body_to_shared(msg)) {
+				/* Milter spooled bodies live in a plain buffer */
+				msg_warn_session("cannot spool message to shared memory, "
+								 "fallback to copying");
+			}
 
 			msg->method = HTTP_GET;
 			rspamd_http_connection_write_message_shared(bk_conn->backend_conn,
@@ -1696,9 +1837,15 @@ proxy_backend_master_finish_handler(struct rspamd_http_connection *conn,
 	rspamd_upstream_ok(bk_conn->up);
 
 	if (session->client_milter_conn) {
+		gboolean early_continue = rspamd_proxy_milter_early_continue(session,
+																	 session->master_conn->results);
+
 		nsession = proxy_session_refresh(session);
 
-		if (body_offset > 0) {
+		if (early_continue) {
+			/* CONTINUE was sent; the full scan happens at the end of message */
+		}
+		else if (body_offset > 0) {
 			rspamd_milter_send_task_results(nsession->client_milter_conn,
 											session->master_conn->results,
 											msg->body_buf.begin + body_offset,
@@ -1784,9 +1931,15 @@ rspamd_proxy_scan_self_reply(struct rspamd_task *task)
 	}
 
 	if (session->client_milter_conn) {
+		gboolean early_continue = rspamd_proxy_milter_early_continue(session,
+																	 session->master_conn->results);
+
 		nsession = proxy_session_refresh(session);
 
-		if (task->flags & RSPAMD_TASK_FLAG_MESSAGE_REWRITE) {
+		if (early_continue) {
+			/* CONTINUE was sent; the full scan happens at the end of message */
+		}
+		else if (task->flags & RSPAMD_TASK_FLAG_MESSAGE_REWRITE) {
 			const char *start;
 			goffset len, hdr_off;
 
@@ -1902,28 +2055,48 @@ rspamd_proxy_self_scan(struct rspamd_proxy_session *session)
 	task->resolver = session->ctx->resolver;
 	task->s = rspamd_session_create(task->task_pool, rspamd_proxy_task_fin,
 									NULL, (event_finalizer_t) rspamd_task_free, task);
-	data = rspamd_http_message_get_body(msg, &len);
 
-	if (session->backend->settings_id) {
-		rspamd_http_message_remove_header(msg, "Settings-ID");
-		rspamd_http_message_add_header(msg, "Settings-ID",
-									   session->backend->settings_id);
-	}
+	if (msg != NULL) {
+		data = rspamd_http_message_get_body(msg, &len);
 
-	/* Process message */
-	if (!rspamd_protocol_handle_request(task, msg)) {
-		msg_err_task("cannot handle request: %e", task->err);
-		task->flags |= RSPAMD_TASK_FLAG_SKIP;
-	}
-	else {
-		if (task->cmd == CMD_PING || task->cmd == CMD_METRICS) {
+		if (session->backend->settings_id) {
+			rspamd_http_message_remove_header(msg, "Settings-ID");
+			rspamd_http_message_add_header(msg, "Settings-ID",
+										   session->backend->settings_id);
+		}
+
+		/* Process message */
+		if (!rspamd_protocol_handle_request(task, msg)) {
+			msg_err_task("cannot handle request: %e", task->err);
 			task->flags |= RSPAMD_TASK_FLAG_SKIP;
 		}
 		else {
-			if (!rspamd_task_load_message(task, msg, data, len)) {
-				msg_err_task("cannot load message: %e", task->err);
+			if (task->cmd == CMD_PING || task->cmd == CMD_METRICS) {
 				task->flags |= RSPAMD_TASK_FLAG_SKIP;
 			}
+			else {
+				if (!rspamd_task_load_message(task, msg, data, len)) {
+					msg_err_task("cannot load message: %e", task->err);
+					task->flags |= RSPAMD_TASK_FLAG_SKIP;
+				}
+			}
+		}
+	}
+	else if (session->client_milter_conn) {
+		/* Milter fast path: apply the session onto the task directly */
+		if (!rspamd_milter_to_task(session->client_milter_conn, task)) {
+			msg_err_task("cannot load message from milter session");
+			task->flags |= RSPAMD_TASK_FLAG_SKIP;
+		}
+		else if (session->backend->settings_id) {
+			task->settings_elt = rspamd_config_find_settings_name_ref(
+				task->cfg, session->backend->settings_id,
+				strlen(session->backend->settings_id));
+
+			if (task->settings_elt == NULL) {
+				msg_warn_task("unknown settings id: %s",
+							  session->backend->settings_id);
+			}
 		}
 	}
 
@@ -2094,6 +2267,12 @@ proxy_send_master_message(struct rspamd_proxy_session *session)
 			if (session->fname) {
 				rspamd_http_message_add_header(msg, "File", session->fname);
 			}
+			else if (rspamd_http_message_get_body(msg, NULL) != NULL &&
+					 !rspamd_http_message_body_to_shared(msg)) {
+				/* Milter spooled bodies live in a plain buffer */
+				msg_warn_session("cannot spool message to shared memory, "
+								 "fallback to copying");
+			}
 
 			msg->method = HTTP_GET;
 
@@ -2248,7 +2427,7 @@ proxy_milter_finish_handler(int fd,
 
 	session->client_milter_conn = rms;
 
-	if (rms->message == NULL || rms->message->len == 0) {
+	if (!rspamd_milter_has_message(rms)) {
 		msg_info_session("finished milter connection");
 		proxy_backend_close_connection(session->master_conn);
 		REF_RELEASE(session);
@@ -2259,13 +2438,29 @@ proxy_milter_finish_handler(int fd,
 														 sizeof(*session->master_conn));
 		}
 
-		msg = rspamd_milter_to_http(rms);
 		session->master_conn->s = session;
 		session->master_conn->name = "master";
-		session->client_message = msg;
 
-		proxy_open_mirror_connections(session);
-		proxy_send_master_message(session);
+		if (session->ctx->default_upstream &&
+			session->ctx->default_upstream->self_scan &&
+			session->ctx->mirrors->len == 0) {
+			/*
+			 * Self-scan without mirrors: the message never leaves this
+			 * process, so scan it straight from the milter session instead
+			 * of materialising an http message. Milter sessions carry no
+			 * Host header, hence the default upstream is the only possible
+			 * backend here.
+			 */
+			session->backend = session->ctx->default_upstream;
+			rspamd_proxy_self_scan(session);
+		}
+		else {
+			msg = rspamd_milter_to_http(rms);
+			session->client_message = msg;
+
+			proxy_open_mirror_connections(session);
+			proxy_send_master_message(session);
+		}
 	}
 }
 
@@ -2472,6 +2667,7 @@ start_rspamd_proxy(struct rspamd_worker *worker)
 	ctx->milter_ctx.reject_message = ctx->reject_message;
 	ctx->milter_ctx.quarantine_message = ctx->quarantine_message;
 	ctx->milter_ctx.tempfail_message = ctx->tempfail_message;
+	ctx->milter_ctx.early_scan = ctx->milter_early_scan;
 	ctx->milter_ctx.cfg = ctx->cfg;
 	rspamd_milter_init_library(&ctx->milter_ctx);
 
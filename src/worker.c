@@ -244,6 +244,9 @@ rspamd_worker_error_handler(struct rspamd_http_connection *conn, GError *err)
 		msg_info_task("abnormally closing connection from: %s, error: %e",
 					  rspamd_inet_address_to_string_pretty(task->client_addr), err);
 
+		/* The connection is in an unknown state, do not try to reuse it */
+		task->protocol_flags &= ~RSPAMD_TASK_PROTOCOL_FLAG_KEEP_ALIVE;
+
 		if (task->processed_stages & RSPAMD_TASK_STAGE_REPLIED) {
 			/* Terminate session immediately */
 			rspamd_session_destroy(task->s);
@@ -308,10 +311,41 @@ rspamd_worker_finish_handler(struct rspamd_http_connection *conn,
 
 	if (task) {
 		if (task->processed_stages & RSPAMD_TASK_STAGE_REPLIED) {
-			/* We are done here */
-			msg_debug_task("normally closing connection from: %s",
-						   rspamd_inet_address_to_string(task->client_addr));
-			rspamd_session_destroy(task->s);
+			if (task->protocol_flags & RSPAMD_TASK_PROTOCOL_FLAG_KEEP_ALIVE) {
+				/*
+				 * The client has requested keep-alive, so take the socket and
+				 * the connection back from the task being destroyed and wait
+				 * for the next request on the same connection
+				 */
+				struct rspamd_worker_session *nsession;
+
+				nsession = g_malloc0(sizeof(*nsession));
+				nsession->magic = G_MAXINT64;
+				nsession->ctx = (struct rspamd_worker_ctx *) task->worker->ctx;
+				nsession->worker = task->worker;
+				nsession->fd = task->sock;
+				nsession->addr = rspamd_inet_address_copy(task->client_addr, NULL);
+				nsession->http_conn = task->http_conn;
+
+				rspamd_http_connection_ref(task->http_conn);
+				/* Avoid closing of the fd on task destruction */
+				task->sock = -1;
+
+				msg_debug_task("keeping connection from %s alive after reply",
+							   rspamd_inet_address_to_string(nsession->addr));
+				/* Task destruction resets the connection */
+				rspamd_session_destroy(task->s);
+
+				rspamd_http_connection_read_message(nsession->http_conn,
+													nsession,
+													nsession->ctx->timeout);
+			}
+			else {
+				/* We are done here */
+				msg_debug_task("normally closing connection from: %s",
+							   rspamd_inet_address_to_string(task->client_addr));
+				rspamd_session_destroy(task->s);
+			}
 		}
 		else if (task->processed_stages & RSPAMD_TASK_STAGE_DONE) {
 			rspamd_session_pending(task->s);
@@ -331,6 +365,55 @@ rspamd_worker_finish_handler(struct rspamd_http_connection *conn,
 	return 0;
 }
 
+/*
+ * Reply with a soft deferral and close the connection, so the MTA retries
+ * later instead of the worker queueing the task internally
+ */
+static void
+rspamd_worker_defer_client(struct rspamd_worker *worker, int nfd,
+						   rspamd_inet_addr_t *addr)
+{
+	static const char defer_reply[] =
+		"HTTP/1.1 429 Too Many Requests\r\n"
+		"Connection: close\r\n"
+		"Retry-After: 1\r\n"
+		"Content-Length: 27\r\n"
+		"\r\n"
+		"{\"error\":\"Try again later\"}";
+
+	(void) !write(nfd, defer_reply, sizeof(defer_reply) - 1);
+	close(nfd);
+	rspamd_inet_address_free(addr);
+}
+
+/*
+ * Refill the accept token bucket and try to take a single token from it
+ */
+static gboolean
+rspamd_worker_accept_limit_check(struct rspamd_worker_ctx *ctx)
+{
+	ev_tstamp now = ev_now(ctx->event_loop);
+
+	if (ctx->max_accept_rate == 0) {
+		return TRUE;
+	}
+
+	/* Burst is limited by one second worth of tokens */
+	ctx->accept_tokens = MIN((double) ctx->max_accept_rate,
+							 ctx->accept_tokens +
+								 (now - ctx->accept_last_filled) *
+									 (double) ctx->max_accept_rate);
+	ctx->accept_last_filled = now;
+
+	if (ctx->accept_tokens >= 1.0) {
+		ctx->accept_tokens -= 1.0;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 /*
  * Accept new connection and construct task
  */
@@ -345,13 +428,6 @@ accept_socket(EV_P_ ev_io *w, int revents)
 
 	ctx = worker->ctx;
 
-	if (ctx->max_tasks != 0 && worker->nconns > ctx->max_tasks) {
-		msg_info_ctx("current tasks is now: %uD while maximum is: %uD",
-					 worker->nconns,
-					 ctx->max_tasks);
-		return;
-	}
-
 	if ((nfd =
 			 rspamd_accept_from_socket(w->fd, &addr,
 									   rspamd_worker_throttle_accept_events, worker->accept_events)) == -1) {
@@ -365,6 +441,27 @@ accept_socket(EV_P_ ev_io *w, int revents)
 		return;
 	}
 
+	if (ctx->max_tasks != 0 && worker->nconns > ctx->max_tasks) {
+		msg_info_ctx("current tasks is now: %uD while maximum is: %uD; "
+					 "defer connection from %s",
+					 worker->nconns,
+					 ctx->max_tasks,
+					 rspamd_inet_address_to_string(addr));
+		rspamd_worker_defer_client(worker, nfd, addr);
+
+		return;
+	}
+
+	if (!rspamd_worker_accept_limit_check(ctx)) {
+		msg_info_ctx("accept rate is over the limit of %uD connections per "
+					 "second; defer connection from %s",
+					 ctx->max_accept_rate,
+					 rspamd_inet_address_to_string(addr));
+		rspamd_worker_defer_client(worker, nfd, addr);
+
+		return;
+	}
+
 	session = g_malloc0(sizeof(*session));
 	session->magic = G_MAXINT64;
 	session->addr = addr;
@@ -384,7 +481,12 @@ accept_socket(EV_P_ ev_io *w, int revents)
 		rspamd_worker_finish_handler,
 		http_opts);
 
+#ifndef HAVE_ATOMIC_BUILTINS
 	worker->srv->stat->connections_count++;
+#else
+	__atomic_add_fetch(&worker->srv->stat->connections_count,
+					   1, __ATOMIC_RELEASE);
+#endif
 	rspamd_http_connection_set_max_size(session->http_conn,
 										ctx->cfg->max_message);
 
@@ -462,6 +564,17 @@ init_worker(struct rspamd_config *cfg)
 									  RSPAMD_CL_FLAG_INT_32,
 									  "Maximum count of parallel tasks processed by a single worker process");
 
+	rspamd_rcl_register_worker_option(cfg,
+									  type,
+									  "max_accept_rate",
+									  rspamd_rcl_parse_struct_integer,
+									  ctx,
+									  G_STRUCT_OFFSET(struct rspamd_worker_ctx,
+													  max_accept_rate),
+									  RSPAMD_CL_FLAG_INT_32,
+									  "Maximum number of connections accepted per second, "
+									  "the rest are deferred (0, unlimited, by default)");
+
 	rspamd_rcl_register_worker_option(cfg,
 									  type,
 									  "keypair",
@@ -490,6 +603,13 @@ start_worker(struct rspamd_worker *worker)
 	rspamd_symcache_start_refresh(worker->srv->cfg->cache, ctx->event_loop,
 								  worker);
 
+	if (ctx->cfg->cpu_sampler_hz > 0) {
+		if (!rspamd_symcache_activate_sampler(ctx->cfg->cpu_sampler_hz)) {
+			msg_warn("cannot activate CPU sampler at %ud Hz",
+					 ctx->cfg->cpu_sampler_hz);
+		}
+	}
+
 	ctx->task_timeout = rspamd_worker_check_and_adjust_timeout(ctx->cfg, ctx->task_timeout);
 
 	ctx->resolver = rspamd_dns_resolver_init(worker->srv->logger,
@@ -47,6 +47,11 @@ struct rspamd_worker_ctx {
 	gboolean encrypted_only;
 	/* Limit of tasks */
 	uint32_t max_tasks;
+	/* Limit of accepted connections per second (0 for unlimited) */
+	uint32_t max_accept_rate;
+	/* Token bucket of the accept limiter */
+	double accept_tokens;
+	ev_tstamp accept_last_filled;
 	/* Maximum time for task processing */
 	ev_tstamp task_timeout;
 	/* Encryption key */
@@ -32,6 +32,29 @@ context("Regexp unit tests", function()
     end
   end)
   
+  test("Regexp prefiltered match", function()
+    -- Patterns with a mandatory literal exercise the substring pre-check
+    local cases = {
+      {'/viagra now/i', 'buy VIAGRA NOW cheap', true},
+      {'/viagra now/i', 'buy cialis now cheap', false},
+      {'\\d+ bottles of beer', '99 bottles of beer', true},
+      {'\\d+ bottles of beer', '99 bottles of wine', false},
+      {'foo(bar)?bazil', 'xfoobazilx', true},
+      {'foo(bar)?bazil', 'xfoobarx', false},
+      {'price\\: \\$\\d+', 'price: $100', true},
+      {'abcd{2,3}e', 'xabcddde', true},
+    }
+
+    for _,c in ipairs(cases) do
+      local r = re.create_cached(c[1])
+      assert_not_nil(r, "cannot parse " .. c[1])
+      local res = r:match(c[2])
+
+      assert_equal(res, c[3], string.format("'%s' doesn't match with '%s'",
+        c[2], c[1]))
+    end
+  end)
+
   test("Regexp capture", function()
     local cases = {
       {'Body=(\\S+)(?: Fuz1=(\\S+))?(?: Fuz2=(\\S+))?', 
@@ -19,8 +19,14 @@
 #include "fstring.h"
 #include "ottery.h"
 #include "cryptobox.h"
+#include "chacha20/chacha.h"
 #include "unix-std.h"
 
+/* The portable implementation, used as the reference for the accelerated ones */
+void chacha_ref(const chacha_key *key, const chacha_iv *iv,
+				const unsigned char *in, unsigned char *out, size_t inlen,
+				size_t rounds);
+
 static const int mapping_size = 64 * 8192 + 1;
 static const int max_seg = 32;
 static const int random_fuzz_cnt = 10000;
@@ -322,3 +328,60 @@ void rspamd_cryptobox_test_func(void)
 		}
 	}
 }
+
+void rspamd_cryptobox_chacha_test_func(void)
+{
+	void *map;
+	unsigned char *begin, *end;
+	unsigned char *out_selected, *out_ref;
+	chacha_key key;
+	chacha_iv iv;
+	const char *selected;
+	double t1, t2, t_selected, t_ref;
+	gsize buflen;
+	int i;
+	static const int bench_iters = 10;
+
+	map = create_mapping(mapping_size, &begin, &end);
+	buflen = end - begin;
+	out_selected = g_malloc(buflen);
+	out_ref = g_malloc(buflen);
+
+	ottery_rand_bytes(begin, buflen);
+	ottery_rand_bytes(key.b, sizeof(key.b));
+	ottery_rand_bytes(iv.b, sizeof(iv.b));
+
+	/* Whatever the CPU detection has picked for this machine */
+	selected = chacha_load();
+	t1 = rspamd_get_ticks(TRUE);
+	for (i = 0; i < bench_iters; i++) {
+		chacha(&key, &iv, begin, out_selected, buflen, 20);
+	}
+	t2 = rspamd_get_ticks(TRUE);
+	t_selected = t2 - t1;
+
+	/* The same stream through the portable implementation */
+	t1 = rspamd_get_ticks(TRUE);
+	for (i = 0; i < bench_iters; i++) {
+		chacha_ref(&key, &iv, begin, out_ref, buflen, 20);
+	}
+	t2 = rspamd_get_ticks(TRUE);
+	t_ref = t2 - t1;
+
+	/* Accelerated kernels must be byte identical to the reference one */
+	g_assert(memcmp(out_selected, out_ref, buflen) == 0);
+
+	/* Uneven lengths to cover the vectorised/scalar tail boundary */
+	for (i = 1; i < 2048; i += 259) {
+		chacha(&key, &iv, begin, out_selected, i, 20);
+		chacha_ref(&key, &iv, begin, out_ref, i, 20);
+		g_assert(memcmp(out_selected, out_ref, i) == 0);
+	}
+
+	msg_info("chacha (%s): %.0f; chacha (generic): %.0f",
+			 selected, t_selected, t_ref);
+
+	g_free(out_selected);
+	g_free(out_ref);
+	munmap(map, mapping_size + getpagesize() * 3);
+}
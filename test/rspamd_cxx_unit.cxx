@@ -26,6 +26,7 @@
 #include "rspamd_cxx_unit_dkim.hxx"
 #include "rspamd_cxx_unit_cryptobox.hxx"
 #include "rspamd_cxx_unit_rfc2047.hxx"
+#include "rspamd_cxx_unit_coro.hxx"
 
 static gboolean verbose = false;
 static const GOptionEntry entries[] =
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Detached unit tests for the coroutine utils */
+
+#ifndef RSPAMD_RSPAMD_CXX_UNIT_CORO_HXX
+#define RSPAMD_RSPAMD_CXX_UNIT_CORO_HXX
+
+#define DOCTEST_CONFIG_IMPLEMENTATION_IN_DLL
+#include "doctest/doctest.h"
+
+#include "libutil/cxx/coro_utils.hxx"
+#include "libutil/mem_pool.h"
+
+#include <stdexcept>
+
+using rspamd::coro::suspend_with;
+using rspamd::coro::task;
+
+static task<int> coro_test_value()
+{
+	co_return 42;
+}
+
+static task<int> coro_test_nested()
+{
+	auto inner = coro_test_value();
+	auto v = co_await inner;
+
+	co_return v + 1;
+}
+
+static task<int> coro_test_pool_backed(rspamd_mempool_t *pool, int v)
+{
+	(void) pool;
+	co_return v * 2;
+}
+
+static task<void> coro_test_throwing()
+{
+	throw std::runtime_error("expected");
+	co_return;
+}
+
+static task<int> coro_test_suspending(std::coroutine_handle<> *saved)
+{
+	co_await suspend_with([&](std::coroutine_handle<> h) {
+		*saved = h;
+	});
+
+	co_return 7;
+}
+
+TEST_SUITE("rspamd_coro")
+{
+
+	TEST_CASE("task returns value")
+	{
+		auto t = coro_test_value();
+		CHECK(!t.done());
+		t.resume();
+		CHECK(t.done());
+		CHECK(t.result() == 42);
+	}
+
+	TEST_CASE("nested tasks use symmetric transfer")
+	{
+		auto t = coro_test_nested();
+		t.resume();
+		CHECK(t.done());
+		CHECK(t.result() == 43);
+	}
+
+	TEST_CASE("pool backed frames")
+	{
+		auto *pool = rspamd_mempool_new(rspamd_mempool_suggest_size(),
+										"coro-test", 0);
+		auto t = coro_test_pool_backed(pool, 21);
+		t.resume();
+		CHECK(t.done());
+		CHECK(t.result() == 42);
+		/* Frame is destroyed before the pool, the memory stays with the pool */
+		t.destroy();
+		rspamd_mempool_delete(pool);
+	}
+
+	TEST_CASE("exceptions are rethrown from result")
+	{
+		auto t = coro_test_throwing();
+		t.resume();
+		CHECK(t.done());
+		CHECK_THROWS_AS(t.result(), std::runtime_error);
+	}
+
+	TEST_CASE("suspend_with resumes from a callback")
+	{
+		std::coroutine_handle<> saved{};
+		auto t = coro_test_suspending(&saved);
+
+		t.resume();
+		CHECK(!t.done());
+		REQUIRE(saved);
+		/* Pretend to be the completion callback from the event loop */
+		saved.resume();
+		CHECK(t.done());
+		CHECK(t.result() == 7);
+	}
+}
+
+#endif
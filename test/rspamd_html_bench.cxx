@@ -0,0 +1,184 @@
+/*
+ * Copyright 2025 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark for the HTML/CSS parsing pipeline.
+ *
+ * Replays a corpus of real HTML parts (plus raw CSS files distinguished by
+ * the .css suffix) through html_process_input and parse_css, reporting
+ * ns per input byte together with pool allocation counters, so regressions
+ * in the parse hot path are visible before release.
+ *
+ * Usage: rspamd-html-bench [corpus_dir] [iterations]
+ *
+ * Without a corpus directory a small built-in sample is processed, which
+ * is merely useful as a smoke check of the harness itself.
+ */
+
+#include "config.h"
+#include "rspamd.h"
+#include "libserver/html/html.hxx"
+#include "libserver/css/css_parser.hxx"
+#include "libserver/task.h"
+#include "libutil/mem_pool.h"
+#include "contrib/fmt/include/fmt/core.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+static const char builtin_sample[] =
+	"<!DOCTYPE html><html><head>"
+	"<style>.hdr { color: #1e3482; } #foot { display: none; } p { font-size: 12pt }</style>"
+	"</head><body>"
+	"<div class=\"hdr\">Lorem ipsum dolor sit amet, consectetur adipiscing elit</div>"
+	"<p>sed do eiusmod tempor incididunt ut labore et dolore magna aliqua</p>"
+	"<a href=\"http://example.com/some/path?q=1\">example</a>"
+	"<div id=\"foot\">invisible footer text</div>"
+	"</body></html>";
+
+struct bench_sample {
+	std::string name;
+	std::string data;
+	bool is_css;
+};
+
+static double
+bench_sample_once(const bench_sample &s)
+{
+	auto *pool = rspamd_mempool_new(rspamd_mempool_suggest_size(),
+									"html_bench", 0);
+	struct rspamd_task fake_task;
+	memset(&fake_task, 0, sizeof(fake_task));
+	fake_task.task_pool = pool;
+
+	double elapsed;
+
+	if (s.is_css) {
+		auto start = rspamd_get_ticks(FALSE);
+		auto res = rspamd::css::parse_css(pool, {s.data.data(), s.data.size()},
+										  nullptr);
+		elapsed = rspamd_get_ticks(FALSE) - start;
+		(void) res;
+	}
+	else {
+		GByteArray *tmp = g_byte_array_sized_new(s.data.size());
+		g_byte_array_append(tmp, (const uint8_t *) s.data.data(), s.data.size());
+
+		auto start = rspamd_get_ticks(FALSE);
+		auto *hc = rspamd::html::html_process_input(&fake_task, tmp, nullptr,
+													nullptr, nullptr, true, nullptr);
+		elapsed = rspamd_get_ticks(FALSE) - start;
+
+		g_assert(hc != nullptr);
+		g_byte_array_free(tmp, TRUE);
+	}
+
+	rspamd_mempool_delete(pool);
+
+	return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	const char *corpus_dir = argc > 1 ? argv[1] : nullptr;
+	auto iters = argc > 2 ? strtoul(argv[2], nullptr, 10) : 16UL;
+
+	std::vector<bench_sample> samples;
+
+	if (corpus_dir != nullptr && corpus_dir[0] != '\0') {
+		GError *err = nullptr;
+		auto *dir = g_dir_open(corpus_dir, 0, &err);
+
+		if (dir == nullptr) {
+			fmt::print(stderr, "cannot open corpus directory {}: {}\n",
+					   corpus_dir, err ? err->message : "unknown error");
+
+			return EXIT_FAILURE;
+		}
+
+		const char *fname;
+
+		while ((fname = g_dir_read_name(dir)) != nullptr) {
+			auto path = fmt::format("{}/{}", corpus_dir, fname);
+			char *content;
+			gsize len;
+
+			if (g_file_get_contents(path.c_str(), &content, &len, nullptr)) {
+				samples.push_back({fname, std::string{content, len},
+								   g_str_has_suffix(fname, ".css") == TRUE});
+				g_free(content);
+			}
+		}
+
+		g_dir_close(dir);
+	}
+	else {
+		samples.push_back({"builtin", std::string{builtin_sample,
+												  sizeof(builtin_sample) - 1},
+						   false});
+	}
+
+	if (samples.empty()) {
+		fmt::print(stderr, "no samples found in {}\n", corpus_dir);
+
+		return EXIT_FAILURE;
+	}
+
+	rspamd_url_init(nullptr);
+
+	rspamd_mempool_stat_t st_before, st_after;
+	rspamd_mempool_stat(&st_before);
+
+	double total_time = 0.0;
+	std::size_t total_bytes = 0;
+
+	for (const auto &s: samples) {
+		if (s.data.empty()) {
+			continue;
+		}
+
+		/* Take the best of the iterations to filter scheduling noise */
+		auto best = std::numeric_limits<double>::max();
+
+		for (auto i = 0UL; i < iters; i++) {
+			best = MIN(best, bench_sample_once(s));
+		}
+
+		total_time += best;
+		total_bytes += s.data.size();
+
+		fmt::print("{}: {} bytes, {:.2f} ns/byte\n",
+				   s.name, s.data.size(),
+				   best * 1e9 / (double) s.data.size());
+	}
+
+	rspamd_mempool_stat(&st_after);
+
+	if (total_bytes > 0) {
+		fmt::print("total: {} samples, {} bytes, {:.2f} ns/byte\n",
+				   samples.size(), total_bytes,
+				   total_time * 1e9 / (double) total_bytes);
+	}
+
+	fmt::print("pool chunks allocated: {}, pool bytes allocated: {}, "
+			   "oversized chunks: {}\n",
+			   st_after.chunks_allocated - st_before.chunks_allocated,
+			   st_after.bytes_allocated - st_before.bytes_allocated,
+			   st_after.oversized_chunks - st_before.oversized_chunks);
+
+	return EXIT_SUCCESS;
+}
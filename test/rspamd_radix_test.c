@@ -372,5 +372,71 @@ void rspamd_radix_test_func(void)
 			   diff / ((double) nelts * lookup_cycles / lookup_divisor));
 	rspamd_mempool_delete(pool);
 
+	/*
+	 * Compiled interval table: must agree with the plain trie on both hits
+	 * and misses
+	 */
+	radix_compressed_t *rt = radix_create_compressed("compile-test");
+	uint8_t(*sample)[16];
+	uintptr_t *expected;
+	const gsize nsample = 64 * 1024;
+
+	msg_notice("radix compiled table consistency and performance (%z elts)",
+			   nelts);
+
+	for (i = 0; i < nelts; i++) {
+		radix_insert_compressed(rt, addrs[i].addr6, sizeof(addrs[i].addr6),
+								128 - addrs[i].mask6, i + 1);
+	}
+
+	sample = g_malloc(nsample * sizeof(*sample));
+	expected = g_malloc(nsample * sizeof(*expected));
+
+	for (i = 0; i < nsample; i++) {
+		if (i % 2 == 0) {
+			memcpy(sample[i], addrs[rspamd_random_uint64_fast() % nelts].addr6,
+				   sizeof(sample[i]));
+		}
+		else {
+			ottery_rand_bytes(sample[i], sizeof(sample[i]));
+		}
+
+		expected[i] = radix_find_compressed(rt, sample[i], sizeof(sample[i]));
+	}
+
+	ts1 = rspamd_get_ticks(TRUE);
+	radix_compile_compressed(rt);
+	ts2 = rspamd_get_ticks(TRUE);
+
+	msg_notice("Compiled %hz elements in %.0f ticks", nelts, ts2 - ts1);
+
+	for (i = 0; i < nsample; i++) {
+		g_assert(radix_find_compressed(rt, sample[i], sizeof(sample[i])) ==
+				 expected[i]);
+	}
+
+	ts1 = rspamd_get_ticks(TRUE);
+	for (lc = 0; lc < lookup_cycles && all_good; lc++) {
+		for (i = 0; i < nsample / lookup_divisor; i++) {
+			check = rspamd_random_uint64_fast() % nsample;
+
+			if (radix_find_compressed(rt, sample[check],
+									  sizeof(sample[check])) != expected[check]) {
+				all_good = FALSE;
+			}
+		}
+	}
+	g_assert(all_good);
+	ts2 = rspamd_get_ticks(TRUE);
+	diff = (ts2 - ts1);
+
+	msg_notice("Checked %hz compiled lookups in %.0f ticks (%.2f ticks per lookup)",
+			   nsample * lookup_cycles / lookup_divisor, diff,
+			   diff / ((double) nsample * lookup_cycles / lookup_divisor));
+
+	g_free(sample);
+	g_free(expected);
+	radix_destroy_compressed(rt);
+
 	g_free(addrs);
 }
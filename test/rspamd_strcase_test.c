@@ -0,0 +1,130 @@
+/*
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "rspamd.h"
+#include "ottery.h"
+#include "cryptobox.h"
+#include "tests.h"
+
+static const char *test_headers[] = {
+	"From",
+	"Subject",
+	"Received",
+	"Message-ID",
+	"Content-Type",
+	"DKIM-Signature",
+	"X-Spam-Status",
+	"List-Unsubscribe",
+	"Content-Transfer-Encoding",
+	"Authentication-Results",
+};
+
+static const int bench_iters = 1000000;
+
+/*
+ * Byte at a time lowercase + hash, the shape of the kernel before fusing;
+ * kept here merely as a benchmark baseline
+ */
+static uint64_t
+rspamd_icase_hash_ref(const char *in, gsize len, uint64_t seed)
+{
+	rspamd_cryptobox_fast_hash_state_t st;
+	const uint8_t *s = (const uint8_t *) in;
+	unsigned char buf[8];
+	gsize i = 0;
+
+	rspamd_cryptobox_fast_hash_init(&st, seed);
+
+	while (i < len) {
+		gsize j, blen = MIN(len - i, sizeof(buf));
+
+		memset(buf, 0, sizeof(buf));
+
+		for (j = 0; j < blen; j++) {
+			buf[j] = lc_map[s[i + j]];
+		}
+
+		rspamd_cryptobox_fast_hash_update(&st, buf, sizeof(buf));
+		i += blen;
+	}
+
+	return rspamd_cryptobox_fast_hash_final(&st);
+}
+
+void rspamd_strcase_test_func(void)
+{
+	unsigned char inbuf[512], lcbuf[512];
+	char *lc;
+	uint64_t h, acc = 0;
+	double t1, t2, t_fused, t_ref;
+	gsize len;
+	unsigned int i, j;
+
+	/* Case insensitivity on the real header names */
+	for (i = 0; i < G_N_ELEMENTS(test_headers); i++) {
+		len = strlen(test_headers[i]);
+		lc = g_ascii_strdown(test_headers[i], len);
+
+		g_assert(rspamd_icase_hash(test_headers[i], len, 0xdeadbabe) ==
+				 rspamd_icase_hash(lc, len, 0xdeadbabe));
+		g_free(lc);
+	}
+
+	/* Equivalence with the lc_map reference on random bytes, including
+	 * non ascii and block boundary lengths */
+	for (i = 0; i < 1000; i++) {
+		len = 1 + ottery_rand_range(sizeof(inbuf) - 1);
+		ottery_rand_bytes(inbuf, len);
+
+		for (j = 0; j < len; j++) {
+			lcbuf[j] = lc_map[inbuf[j]];
+		}
+
+		h = rspamd_icase_hash((const char *) inbuf, len, 0xdeadbabe);
+		g_assert(h == rspamd_icase_hash((const char *) lcbuf, len, 0xdeadbabe));
+	}
+
+	/* Benchmark on typical header name lengths */
+	t1 = rspamd_get_ticks(TRUE);
+
+	for (i = 0; i < bench_iters; i++) {
+		for (j = 0; j < G_N_ELEMENTS(test_headers); j++) {
+			acc ^= rspamd_icase_hash(test_headers[j],
+									 strlen(test_headers[j]), i);
+		}
+	}
+
+	t2 = rspamd_get_ticks(TRUE);
+	t_fused = t2 - t1;
+
+	t1 = rspamd_get_ticks(TRUE);
+
+	for (i = 0; i < bench_iters; i++) {
+		for (j = 0; j < G_N_ELEMENTS(test_headers); j++) {
+			acc ^= rspamd_icase_hash_ref(test_headers[j],
+										 strlen(test_headers[j]), i);
+		}
+	}
+
+	t2 = rspamd_get_ticks(TRUE);
+	t_ref = t2 - t1;
+
+	/* Consume the accumulator so the loops are not elided */
+	msg_info("fused icase hash: %.2f sec, byte wise reference: %.2f sec "
+			 "(%.2fx) for %d hashes (acc: %uL)",
+			 t_fused, t_ref, t_ref / t_fused,
+			 bench_iters * (int) G_N_ELEMENTS(test_headers), acc);
+}
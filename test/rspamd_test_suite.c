@@ -80,7 +80,10 @@ int main(int argc, char **argv)
 	g_test_add_func("/rspamd/shingles", rspamd_shingles_test_func);
 	g_test_add_func("/rspamd/lua", rspamd_lua_test_func);
 	g_test_add_func("/rspamd/cryptobox", rspamd_cryptobox_test_func);
+	g_test_add_func("/rspamd/cryptobox_chacha", rspamd_cryptobox_chacha_test_func);
 	g_test_add_func("/rspamd/heap", rspamd_heap_test_func);
+	g_test_add_func("/rspamd/strcase", rspamd_strcase_test_func);
+	g_test_add_func("/rspamd/wheel", rspamd_wheel_test_func);
 	g_test_add_func("/rspamd/lua_pcall", rspamd_lua_lua_pcall_vs_resume_test_func);
 
 #if 0
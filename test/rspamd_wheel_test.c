@@ -0,0 +1,143 @@
+/*-
+ * Copyright 2026 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include "rspamd.h"
+#include "libutil/timer_wheel.h"
+#include "tests.h"
+
+extern struct ev_loop *event_loop;
+
+static const double test_granularity = 0.005;
+
+struct wheel_test_ctx {
+	struct rspamd_timer_wheel *wheel;
+	unsigned int fired;
+	unsigned int cancelled_fired;
+	unsigned int repeats_left;
+	unsigned int expected;
+	struct rspamd_wheel_entry *victim;
+	ev_tstamp first_fire;
+};
+
+static struct wheel_test_ctx test_ctx;
+
+static void
+wheel_fired_cb(void *ud)
+{
+	struct wheel_test_ctx *ctx = ud;
+
+	ctx->fired++;
+
+	if (ctx->first_fire == 0) {
+		ctx->first_fire = ev_time();
+	}
+
+	if (ctx->victim != NULL) {
+		/* A callback must be able to cancel any other pending entry */
+		rspamd_timer_wheel_remove(ctx->wheel, ctx->victim);
+		ctx->victim = NULL;
+	}
+
+	if (ctx->fired == ctx->expected) {
+		ev_break(event_loop, EVBREAK_ALL);
+	}
+}
+
+static void
+wheel_cancelled_cb(void *ud)
+{
+	struct wheel_test_ctx *ctx = ud;
+
+	ctx->cancelled_fired++;
+}
+
+static void
+wheel_repeat_cb(void *ud)
+{
+	struct wheel_test_ctx *ctx = ud;
+
+	ctx->fired++;
+
+	if (ctx->repeats_left > 0) {
+		ctx->repeats_left--;
+		/* Entry is passed through the test context */
+		rspamd_timer_wheel_repeat(ctx->wheel, ctx->victim);
+	}
+	else if (ctx->fired == ctx->expected) {
+		ev_break(event_loop, EVBREAK_ALL);
+	}
+}
+
+void rspamd_wheel_test_func(void)
+{
+	struct rspamd_timer_wheel *wheel;
+	struct rspamd_wheel_entry *entry;
+	unsigned int i;
+	ev_tstamp start;
+
+	wheel = rspamd_timer_wheel_new(event_loop, test_granularity);
+
+	/* Insert and cancel: the callback must never be invoked */
+	memset(&test_ctx, 0, sizeof(test_ctx));
+	test_ctx.wheel = wheel;
+	entry = rspamd_timer_wheel_insert(wheel, 0.01, wheel_cancelled_cb,
+									  &test_ctx);
+	g_assert(entry != NULL);
+	rspamd_timer_wheel_remove(wheel, entry);
+
+	/*
+	 * A bunch of short timers plus one beyond the first level horizon to
+	 * exercise cascading, plus one that is cancelled from a callback
+	 */
+	test_ctx.expected = 100;
+	test_ctx.victim = rspamd_timer_wheel_insert(wheel, 0.5,
+												wheel_cancelled_cb, &test_ctx);
+
+	for (i = 0; i < test_ctx.expected - 1; i++) {
+		g_assert(rspamd_timer_wheel_insert(wheel,
+										   0.01 + 0.001 * (double) i,
+										   wheel_fired_cb, &test_ctx) != NULL);
+	}
+
+	/* Level0 covers 256 * granularity = 1.28s, so this one cascades */
+	g_assert(rspamd_timer_wheel_insert(wheel, 1.5, wheel_fired_cb,
+									   &test_ctx) != NULL);
+
+	start = ev_time();
+	ev_run(event_loop, 0);
+
+	g_assert(test_ctx.fired == test_ctx.expected);
+	g_assert(test_ctx.cancelled_fired == 0);
+	g_assert(test_ctx.first_fire - start < 0.5);
+	g_assert(ev_time() - start >= 1.5 - test_granularity);
+
+	/* Repeating entry: must fire several times and then stop */
+	memset(&test_ctx, 0, sizeof(test_ctx));
+	test_ctx.wheel = wheel;
+	test_ctx.repeats_left = 4;
+	test_ctx.expected = 5;
+	test_ctx.victim = rspamd_timer_wheel_insert(wheel, 0.02,
+												wheel_repeat_cb, &test_ctx);
+	g_assert(test_ctx.victim != NULL);
+
+	ev_run(event_loop, 0);
+
+	g_assert(test_ctx.fired == test_ctx.expected);
+	rspamd_timer_wheel_remove(wheel, test_ctx.victim);
+
+	rspamd_timer_wheel_destroy(wheel);
+}
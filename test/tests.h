@@ -40,8 +40,15 @@ void rspamd_lua_test_func(void);
 
 void rspamd_cryptobox_test_func(void);
 
+void rspamd_cryptobox_chacha_test_func(void);
+
 void rspamd_heap_test_func(void);
 
+void rspamd_strcase_test_func(void);
+
+/* Timer wheel test */
+void rspamd_wheel_test_func(void);
+
 void rspamd_lua_lua_pcall_vs_resume_test_func(void);
 
 #ifdef __cplusplus
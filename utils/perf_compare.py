@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""
+Compare two JSON result files produced by rspamd-perf-bench and fail when
+some kernel regressed beyond the given threshold.
+
+Usage: perf_compare.py baseline.json current.json [-t threshold_percent]
+
+Exit code is 0 when every kernel is within the threshold, 1 otherwise, so
+the script can gate a CI job:
+
+    cmake --build build --target run-perf-bench
+    ./utils/perf_compare.py baseline.json build/test/perf_bench.json -t 10
+"""
+
+import argparse
+import json
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare rspamd-perf-bench results')
+    parser.add_argument('baseline', help='baseline results (JSON)')
+    parser.add_argument('current', help='current results (JSON)')
+    parser.add_argument('-t', '--threshold', type=float, default=10.0,
+                        help='regression threshold in percent (default: 10)')
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    with open(args.current) as f:
+        current = json.load(f)
+
+    regressed = False
+
+    for kernel in sorted(baseline):
+        if kernel not in current:
+            print('%-16s missing in current results' % kernel)
+            continue
+
+        old, new = baseline[kernel], current[kernel]
+        delta = (new - old) / old * 100.0 if old > 0 else 0.0
+        mark = ''
+
+        if delta > args.threshold:
+            mark = ' REGRESSED'
+            regressed = True
+
+        print('%-16s %8.2f -> %8.2f ns/byte (%+6.1f%%)%s' %
+              (kernel, old, new, delta, mark))
+
+    for kernel in sorted(set(current) - set(baseline)):
+        print('%-16s new kernel: %.2f ns/byte' % (kernel, current[kernel]))
+
+    return 1 if regressed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())